@@ -1,10 +1,21 @@
 LOCAL_PATH := $(call my-dir)
-include $(CLEAR_VARS)
 
-LOCAL_SRC_FILES :=       \
+libstagefrighthw_src_files :=       \
     SprdOMXPlugin.cpp    \
     SprdOMXComponent.cpp \
-    SprdSimpleOMXComponent.cpp
+    SprdSimpleOMXComponent.cpp \
+    SprdVspScheduler.cpp \
+    SprdIonArena.cpp \
+    SprdIovaCache.cpp \
+    SprdStripePool.cpp \
+    SprdEncoderInputRing.cpp \
+    SprdOutputPacker.cpp \
+    SprdDumpWriter.cpp \
+    SprdCodecMetrics.cpp
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(libstagefrighthw_src_files)
 
 LOCAL_C_INCLUDES += $(GPU_GRALLOC_INCLUDES)
 
@@ -45,3 +56,39 @@ endif
 
 include $(BUILD_SHARED_LIBRARY)
 
+# The same library for x86 Linux hosts, against the fake libmemion and
+# libui of omx-components/mock, so omx_core and the components can be
+# loaded and driven off target.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(libstagefrighthw_src_files)
+
+LOCAL_C_INCLUDES:= \
+    frameworks/native/include/media/hardware \
+    vendor/sprd/external/kernel-headers      \
+    $(LOCAL_PATH)/include                    \
+    $(LOCAL_PATH)/include/openmax
+
+LOCAL_C_INCLUDES += $(GPU_GRALLOC_INCLUDES)
+
+LOCAL_SHARED_LIBRARIES :=       \
+    libmemion                   \
+    libutils                    \
+    libcutils                   \
+    libui                       \
+    libstagefright_foundation   \
+    liblog
+
+LOCAL_LDLIBS := -ldl -lpthread
+
+LOCAL_MODULE := libstagefrighthw
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+LOCAL_CFLAGS:= -DLOG_TAG=\"host.libstagefright\"
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+################################################################################
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
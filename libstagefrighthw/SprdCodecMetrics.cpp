@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdCodecMetrics"
+#include <utils/Log.h>
+
+#include "include/SprdCodecMetrics.h"
+
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+#include <utils/Timers.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace android {
+
+static const char *kCounterNames[SprdCodecMetrics::kNumCounters] = {
+    "input", "frames", "copy_bytes", "iova_maps", "sw_fallbacks", "errors",
+};
+
+static const char *kHistogramNames[SprdCodecMetrics::kNumHistograms] = {
+    "engine", "engine_wait", "queue_wait",
+};
+
+static bool isPropertyTrue(const char *key) {
+    char value[PROPERTY_VALUE_MAX];
+    property_get(key, value, "false");
+    return !strcmp(value, "true");
+}
+
+// Whether thread tid of this process has exited.
+static bool threadExited(int32_t tid) {
+    return syscall(__NR_tgkill, getpid(), tid, 0) < 0 && errno == ESRCH;
+}
+
+// static
+int64_t SprdCodecMetrics::nowUs() {
+    return systemTime(SYSTEM_TIME_MONOTONIC) / 1000ll;
+}
+
+SprdCodecMetrics::SprdCodecMetrics(const char *name)
+    : mName(name),
+      mTraceFile(NULL) {
+    memset(mShards, 0, sizeof(mShards));
+    memset(&mOverflow, 0, sizeof(mOverflow));
+
+    // Read for every component so verbose logging can be switched on
+    // without restarting the media server.
+    mVerbose = isPropertyTrue("vendor.omx.verbose");
+
+    if (isPropertyTrue("vendor.omx.metrics.trace")) {
+        char path[128];
+        snprintf(path, sizeof(path), "/data/misc/media/metrics_%s_%p_%lld.trc",
+                name, (void *)this, (long long)nowUs());
+        mTraceFile = fopen(path, "wb");
+        if (mTraceFile == NULL) {
+            ALOGW("unable to open %s", path);
+        } else {
+            char header[8 + 64];
+            memset(header, 0, sizeof(header));
+            memcpy(header, "SPRDTRC1", 8);
+            strncpy(header + 8, name, 63);
+            fwrite(header, 1, sizeof(header), mTraceFile);
+
+            for (size_t i = 0; i < kMaxShards; ++i) {
+                mShards[i].mTrace = new TraceEvent[kTraceEventsPerShard];
+            }
+            mOverflow.mTrace = new TraceEvent[kTraceEventsPerShard];
+            ALOGI("tracing %s to %s", name, path);
+        }
+    }
+}
+
+SprdCodecMetrics::~SprdCodecMetrics() {
+    dump();
+
+    for (size_t i = 0; i < kMaxShards; ++i) {
+        if (mTraceFile != NULL) {
+            flushTrace(&mShards[i]);
+        }
+        delete[] mShards[i].mTrace;
+        mShards[i].mTrace = NULL;
+    }
+    if (mTraceFile != NULL) {
+        flushTrace(&mOverflow);
+    }
+    delete[] mOverflow.mTrace;
+    mOverflow.mTrace = NULL;
+
+    if (mTraceFile != NULL) {
+        fclose(mTraceFile);
+        mTraceFile = NULL;
+    }
+}
+
+// NULL if every shard belongs to a live thread other than the caller.
+SprdCodecMetrics::Shard *SprdCodecMetrics::getShard() {
+    int32_t tid = gettid();
+
+    for (size_t i = 0; i < kMaxShards; ++i) {
+        if (android_atomic_acquire_load(&mShards[i].mOwner) == tid) {
+            return &mShards[i];
+        }
+    }
+
+    for (size_t i = 0; i < kMaxShards; ++i) {
+        if (android_atomic_acquire_load(&mShards[i].mOwner) == 0
+                && android_atomic_cmpxchg(0, tid, &mShards[i].mOwner) == 0) {
+            return &mShards[i];
+        }
+    }
+
+    // Take over the shard of a thread that has gone, e.g. a decode or
+    // binder thread of an earlier session; what it counted stays.
+    for (size_t i = 0; i < kMaxShards; ++i) {
+        int32_t owner = android_atomic_acquire_load(&mShards[i].mOwner);
+        if (threadExited(owner)
+                && android_atomic_cmpxchg(owner, tid, &mShards[i].mOwner) == 0) {
+            return &mShards[i];
+        }
+    }
+
+    return NULL;
+}
+
+// static
+void SprdCodecMetrics::countIn(Shard *shard, Counter counter, int64_t delta) {
+    shard->mCounters[counter] += delta;
+}
+
+// static
+void SprdCodecMetrics::recordIn(Shard *shard, Histogram histogram, int64_t us) {
+    size_t bucket = 0;
+    if (us > 0) {
+        bucket = 64 - __builtin_clzll((uint64_t)us);
+        if (bucket >= kNumBuckets) {
+            bucket = kNumBuckets - 1;
+        }
+    }
+
+    shard->mCount[histogram]++;
+    shard->mSumUs[histogram] += us;
+    shard->mLastUs[histogram] = us;
+    if (us > shard->mMaxUs[histogram]) {
+        shard->mMaxUs[histogram] = us;
+    }
+    shard->mBuckets[histogram][bucket]++;
+}
+
+void SprdCodecMetrics::count(Counter counter, int64_t delta) {
+    Shard *shard = getShard();
+    if (CC_UNLIKELY(shard == NULL)) {
+        Mutex::Autolock autoLock(mOverflowLock);
+        countIn(&mOverflow, counter, delta);
+        if (mOverflow.mTrace != NULL) {
+            trace(&mOverflow, 0, counter, delta);
+        }
+        return;
+    }
+
+    countIn(shard, counter, delta);
+    if (CC_UNLIKELY(shard->mTrace != NULL)) {
+        trace(shard, 0, counter, delta);
+    }
+}
+
+void SprdCodecMetrics::record(Histogram histogram, int64_t us) {
+    Shard *shard = getShard();
+    if (CC_UNLIKELY(shard == NULL)) {
+        Mutex::Autolock autoLock(mOverflowLock);
+        recordIn(&mOverflow, histogram, us);
+        if (mOverflow.mTrace != NULL) {
+            trace(&mOverflow, 1, histogram, us);
+        }
+        return;
+    }
+
+    recordIn(shard, histogram, us);
+    if (CC_UNLIKELY(shard->mTrace != NULL)) {
+        trace(shard, 1, histogram, us);
+    }
+}
+
+int64_t SprdCodecMetrics::lastUs(Histogram histogram) {
+    Shard *shard = getShard();
+    if (shard == NULL) {
+        Mutex::Autolock autoLock(mOverflowLock);
+        return mOverflow.mLastUs[histogram];
+    }
+    return shard->mLastUs[histogram];
+}
+
+void SprdCodecMetrics::trace(Shard *shard, int16_t kind, int16_t id, int64_t value) {
+    TraceEvent *event = &shard->mTrace[shard->mTraceCount++];
+    event->mTimeUs = nowUs();
+    event->mThread = gettid();
+    event->mKind = kind;
+    event->mId = id;
+    event->mValue = value;
+
+    if (shard->mTraceCount == kTraceEventsPerShard) {
+        flushTrace(shard);
+    }
+}
+
+// Shards flush from their own threads; stdio keeps each fwrite whole.
+void SprdCodecMetrics::flushTrace(Shard *shard) {
+    if (shard->mTraceCount > 0) {
+        fwrite(shard->mTrace, sizeof(TraceEvent), shard->mTraceCount, mTraceFile);
+        shard->mTraceCount = 0;
+    }
+}
+
+void SprdCodecMetrics::snapshot(Snapshot *snapshot) const {
+    memset(snapshot, 0, sizeof(*snapshot));
+
+    Mutex::Autolock autoLock(mOverflowLock);
+    for (size_t i = 0; i <= kMaxShards; ++i) {
+        const Shard &shard = i < kMaxShards ? mShards[i] : mOverflow;
+
+        for (size_t c = 0; c < kNumCounters; ++c) {
+            snapshot->mCounters[c] += shard.mCounters[c];
+        }
+
+        for (size_t h = 0; h < kNumHistograms; ++h) {
+            HistogramSnapshot *histogram = &snapshot->mHistograms[h];
+            histogram->mCount += shard.mCount[h];
+            histogram->mSumUs += shard.mSumUs[h];
+            if (shard.mMaxUs[h] > histogram->mMaxUs) {
+                histogram->mMaxUs = shard.mMaxUs[h];
+            }
+            for (size_t b = 0; b < kNumBuckets; ++b) {
+                histogram->mBuckets[b] += shard.mBuckets[h][b];
+            }
+        }
+    }
+}
+
+// static
+int64_t SprdCodecMetrics::percentileUs(const HistogramSnapshot &histogram, int percent) {
+    if (histogram.mCount == 0) {
+        return 0;
+    }
+
+    int64_t target = (histogram.mCount * percent + 99) / 100;
+    int64_t seen = 0;
+    for (size_t b = 0; b < kNumBuckets; ++b) {
+        seen += histogram.mBuckets[b];
+        if (seen >= target) {
+            int64_t bound = b == 0 ? 0 : (1ll << b) - 1;
+            return bound < histogram.mMaxUs ? bound : histogram.mMaxUs;
+        }
+    }
+    return histogram.mMaxUs;
+}
+
+void SprdCodecMetrics::dump() const {
+    Snapshot snapshot;
+    this->snapshot(&snapshot);
+
+    if (snapshot.mCounters[kCounterInputBuffers] == 0
+            && snapshot.mCounters[kCounterFrames] == 0) {
+        return;
+    }
+
+    AString counters;
+    for (size_t c = 0; c < kNumCounters; ++c) {
+        counters.append(c == 0 ? "" : ", ");
+        counters.append(kCounterNames[c]);
+        counters.append(" ");
+        counters.append((long long)snapshot.mCounters[c]);
+    }
+    ALOGI("%s: %s", mName.c_str(), counters.c_str());
+
+    for (size_t h = 0; h < kNumHistograms; ++h) {
+        const HistogramSnapshot &histogram = snapshot.mHistograms[h];
+        if (histogram.mCount == 0) {
+            continue;
+        }
+        ALOGI("%s: %s %lld samples, avg %lld us, p50 %lld us, p95 %lld us, max %lld us",
+                mName.c_str(), kHistogramNames[h], (long long)histogram.mCount,
+                (long long)(histogram.mSumUs / histogram.mCount),
+                (long long)percentileUs(histogram, 50),
+                (long long)percentileUs(histogram, 95),
+                (long long)histogram.mMaxUs);
+    }
+}
+
+}  // namespace android
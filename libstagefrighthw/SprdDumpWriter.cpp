@@ -0,0 +1,331 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdDumpWriter"
+#include <utils/Log.h>
+
+#include "include/SprdDumpWriter.h"
+#include "include/SprdStripePool.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+#include <utils/Timers.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace android {
+
+// The codec thread signals after every unit, but without the lock, so a
+// wakeup can be missed; the writer looks at the ring this often anyway.
+static const int64_t kPollNs = 20000000ll;
+
+static int64_t getPropertyInt(const char *key, int64_t defaultValue) {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get(key, value, "") <= 0) {
+        return defaultValue;
+    }
+    return strtoll(value, NULL, 10);
+}
+
+bool SprdDumpWriter::UnitRing::push(Unit *unit) {
+    int32_t tail = mTail;
+    int32_t head = android_atomic_acquire_load(&mHead);
+
+    if ((uint32_t)tail - (uint32_t)head == kNumUnits) {
+        return false;
+    }
+
+    mSlots[tail & (kNumUnits - 1)] = unit;
+    android_atomic_release_store((int32_t)((uint32_t)tail + 1), &mTail);
+
+    return true;
+}
+
+bool SprdDumpWriter::UnitRing::pop(Unit **unit) {
+    int32_t head = mHead;
+    int32_t tail = android_atomic_acquire_load(&mTail);
+
+    if (head == tail) {
+        return false;
+    }
+
+    *unit = mSlots[head & (kNumUnits - 1)];
+    android_atomic_release_store((int32_t)((uint32_t)head + 1), &mHead);
+
+    return true;
+}
+
+SprdDumpWriter::SprdDumpWriter(const char *path)
+    : mPath(path),
+      mEvery(1),
+      mStartUs(0),
+      mEndUs(0),
+      mMaxFileBytes(0),
+      mMaxFiles(2),
+      mMaxQueueBytes(0),
+      mIdleCount(0),
+      mCreatedUs(systemTime(SYSTEM_TIME_MONOTONIC) / 1000ll),
+      mCount(0),
+      mDropped(0),
+      mAllocated(0),
+      mFile(NULL),
+      mFileIndex(-1),
+      mFileBytes(0),
+      mWrittenBytes(0),
+      mLastWasConfig(false),
+      mDone(false),
+      mThreadStarted(false) {
+    mEvery = getPropertyInt("vendor.omx.dump.every", 1);
+    if (mEvery < 1) {
+        mEvery = 1;
+    }
+    mStartUs = getPropertyInt("vendor.omx.dump.start_ms", 0) * 1000ll;
+    int64_t durationUs = getPropertyInt("vendor.omx.dump.duration_ms", 0) * 1000ll;
+    mEndUs = durationUs > 0 ? mStartUs + durationUs : 0;
+    mMaxFileBytes = getPropertyInt("vendor.omx.dump.max_mb", 0) << 20;
+    mMaxFiles = getPropertyInt("vendor.omx.dump.files", 2);
+    if (mMaxFiles < 1) {
+        mMaxFiles = 1;
+    }
+    mMaxQueueBytes = getPropertyInt("vendor.omx.dump.queue_mb", 64) << 20;
+
+    for (int32_t i = 0; i < kNumUnits; ++i) {
+        mUnits[i].mData = NULL;
+        mUnits[i].mSize = 0;
+        mUnits[i].mCapacity = 0;
+        mUnits[i].mFlags = 0;
+        CHECK(mFree.push(&mUnits[i]));
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    if (pthread_create(&mThread, &attr, ThreadWrapper, this) == 0) {
+        mThreadStarted = true;
+    } else {
+        ALOGW("%s: pthread_create failed, dump disabled", mPath.c_str());
+    }
+    pthread_attr_destroy(&attr);
+
+    ALOGI("dumping to %s, every %d, window %lld-%lld ms, %zu MB x %d files",
+            mPath.c_str(), mEvery, (long long)(mStartUs / 1000), (long long)(mEndUs / 1000),
+            mMaxFileBytes >> 20, mMaxFiles);
+}
+
+SprdDumpWriter::~SprdDumpWriter() {
+    if (mThreadStarted) {
+        {
+            Mutex::Autolock autoLock(mLock);
+            mDone = true;
+            mCondition.signal();
+        }
+
+        void *dummy;
+        pthread_join(mThread, &dummy);
+    }
+
+    if (mFile != NULL) {
+        fclose(mFile);
+        mFile = NULL;
+    }
+    for (int32_t i = 0; i < kNumUnits; ++i) {
+        free(mUnits[i].mData);
+    }
+
+    ALOGI("%s: %lld bytes written, %lld of %lld frames dropped",
+            mPath.c_str(), (long long)mWrittenBytes, (long long)mDropped, (long long)mCount);
+}
+
+bool SprdDumpWriter::keep(uint32_t flags) {
+    if (flags & kFlagCodecConfig) {
+        return true;
+    }
+    int64_t index = mCount++;
+
+    if (mStartUs > 0 || mEndUs > 0) {
+        int64_t elapsedUs = systemTime(SYSTEM_TIME_MONOTONIC) / 1000ll - mCreatedUs;
+        if (elapsedUs < mStartUs || (mEndUs > 0 && elapsedUs >= mEndUs)) {
+            return false;
+        }
+    }
+    return index % mEvery == 0;
+}
+
+// The smallest free unit that holds size bytes, NULL if the writer has not
+// given enough back yet.
+SprdDumpWriter::Unit *SprdDumpWriter::takeUnit(size_t size) {
+    Unit *unit;
+    while (mFree.pop(&unit)) {
+        mIdle[mIdleCount++] = unit;
+    }
+    if (mIdleCount == 0) {
+        return NULL;
+    }
+
+    int32_t best = -1;
+    for (int32_t i = 0; i < mIdleCount; ++i) {
+        if (mIdle[i]->mCapacity >= size
+                && (best < 0 || mIdle[i]->mCapacity < mIdle[best]->mCapacity)) {
+            best = i;
+        }
+    }
+
+    if (best < 0) {
+        // The frame size went up: the idle units are all too small, so
+        // give their memory back before growing one of them.
+        for (int32_t i = 0; i < mIdleCount; ++i) {
+            free(mIdle[i]->mData);
+            mIdle[i]->mData = NULL;
+            mAllocated -= mIdle[i]->mCapacity;
+            mIdle[i]->mCapacity = 0;
+        }
+        if (mAllocated + size > mMaxQueueBytes) {
+            return NULL;
+        }
+        best = 0;
+        mIdle[best]->mData = (uint8_t *)malloc(size);
+        if (mIdle[best]->mData == NULL) {
+            return NULL;
+        }
+        mIdle[best]->mCapacity = size;
+        mAllocated += size;
+    }
+
+    unit = mIdle[best];
+    mIdle[best] = mIdle[--mIdleCount];
+    return unit;
+}
+
+void SprdDumpWriter::write(const void *prefix, size_t prefixSize,
+        const void *data, size_t size, uint32_t flags) {
+    if (!mThreadStarted || data == NULL || size == 0 || !keep(flags)) {
+        return;
+    }
+
+    Unit *unit = takeUnit(prefixSize + size);
+    if (unit == NULL) {
+        if (mDropped++ == 0) {
+            ALOGW("%s: writer behind, dropping frames", mPath.c_str());
+        }
+        return;
+    }
+
+    if (prefixSize > 0) {
+        memcpy(unit->mData, prefix, prefixSize);
+    }
+    // Dumped buffers are often uncached ION memory; read it with the
+    // stripe workers rather than at one core's bandwidth.
+    SprdStripePool::getInstance()->copy(unit->mData + prefixSize, data, size);
+    unit->mSize = prefixSize + size;
+    unit->mFlags = flags;
+
+    CHECK(mQueued.push(unit));
+    mCondition.signal();
+}
+
+// static
+void *SprdDumpWriter::ThreadWrapper(void *me) {
+    static_cast<SprdDumpWriter *>(me)->threadLoop();
+    return NULL;
+}
+
+void SprdDumpWriter::threadLoop() {
+    androidSetThreadPriority(0, ANDROID_PRIORITY_BACKGROUND);
+
+    for (;;) {
+        drain();
+
+        Mutex::Autolock autoLock(mLock);
+        if (mDone) {
+            break;
+        }
+        mCondition.waitRelative(mLock, kPollNs);
+    }
+
+    // Units queued before mDone was set.
+    drain();
+}
+
+void SprdDumpWriter::drain() {
+    Unit *unit;
+    while (mQueued.pop(&unit)) {
+        writeUnit(unit);
+        CHECK(mFree.push(unit));
+    }
+}
+
+bool SprdDumpWriter::openFile(int32_t index) {
+    if (mFile != NULL) {
+        fclose(mFile);
+        mFile = NULL;
+    }
+
+    AString path(mPath);
+    if (index > 0) {
+        path.append(".");
+        path.append(index);
+    }
+
+    mFileIndex = index;
+    mFileBytes = 0;
+    mFile = fopen(path.c_str(), "wb");
+    if (mFile == NULL) {
+        ALOGE("unable to open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    ALOGV("writing %s", path.c_str());
+    return true;
+}
+
+void SprdDumpWriter::writeUnit(const Unit *unit) {
+    bool config = unit->mFlags & kFlagCodecConfig;
+    if (config) {
+        // A run of parameter set units replaces the previous one.
+        if (!mLastWasConfig) {
+            mConfig.clear();
+        }
+        mConfig.appendArray(unit->mData, unit->mSize);
+    }
+    mLastWasConfig = config;
+
+    if (mFileIndex < 0) {
+        if (!openFile(0)) {
+            return;
+        }
+    } else if (mMaxFileBytes > 0 && mFileBytes > 0
+            && mFileBytes + unit->mSize > mMaxFileBytes) {
+        if (!openFile((mFileIndex + 1) % mMaxFiles)) {
+            return;
+        }
+        if (!config && !mConfig.isEmpty()) {
+            mFileBytes += fwrite(mConfig.array(), 1, mConfig.size(), mFile);
+        }
+    }
+
+    if (mFile == NULL) {
+        return;
+    }
+
+    size_t written = fwrite(unit->mData, 1, unit->mSize, mFile);
+    mFileBytes += written;
+    mWrittenBytes += written;
+}
+
+}  // namespace android
@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdEncoderInputRing"
+#include <utils/Log.h>
+
+#include "include/SprdEncoderInputRing.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <cutils/properties.h>
+
+#include <stdlib.h>
+
+namespace android {
+
+SprdEncoderInputRing::SprdEncoderInputRing(
+        const char *name, PrepareFunc prepare, void *cookie)
+    : mName(name),
+      mPrepare(prepare),
+      mCookie(cookie),
+      mSlotCount(2),
+      mThreadStarted(false),
+      mExit(false),
+      mOpen(false) {
+    char value[PROPERTY_VALUE_MAX];
+    property_get("vendor.omx.enc_input_slots", value, "2");
+    mSlotCount = atoi(value);
+    if (mSlotCount < 1) {
+        mSlotCount = 1;
+    } else if (mSlotCount > kMaxSlots) {
+        mSlotCount = kMaxSlots;
+    }
+
+    for (int32_t i = 0; i < kMaxSlots; ++i) {
+        mSlots[i].mHeader = NULL;
+        mSlots[i].mState = kFree;
+    }
+
+    if (mSlotCount > 1) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+        if (pthread_create(&mThread, &attr, ThreadWrapper, this) == 0) {
+            mThreadStarted = true;
+        } else {
+            ALOGW("%s: pthread_create failed, preparing inputs inline", mName.c_str());
+            mSlotCount = 1;
+        }
+        pthread_attr_destroy(&attr);
+    }
+
+    ALOGI("%s: %d input slots", mName.c_str(), mSlotCount);
+}
+
+SprdEncoderInputRing::~SprdEncoderInputRing() {
+    if (!mThreadStarted) {
+        return;
+    }
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        mExit = true;
+        mWorkCondition.signal();
+    }
+
+    void *dummy;
+    pthread_join(mThread, &dummy);
+}
+
+// static
+void *SprdEncoderInputRing::ThreadWrapper(void *me) {
+    static_cast<SprdEncoderInputRing *>(me)->threadEntry();
+    return NULL;
+}
+
+void SprdEncoderInputRing::threadEntry() {
+    Mutex::Autolock autoLock(mLock);
+
+    while (!mExit) {
+        if (mQueue.empty()) {
+            mWorkCondition.wait(mLock);
+            continue;
+        }
+
+        int32_t index = *mQueue.begin();
+        mQueue.erase(mQueue.begin());
+
+        Slot *slot = &mSlots[index];
+        slot->mState = kPreparing;
+
+        mLock.unlock();
+        bool ok = (*mPrepare)(mCookie, slot->mHeader, index);
+        mLock.lock();
+
+        slot->mState = ok ? kReady : kFailed;
+        mDoneCondition.broadcast();
+    }
+}
+
+int32_t SprdEncoderInputRing::findSlotLocked(OMX_BUFFERHEADERTYPE *header) const {
+    for (int32_t i = 0; i < mSlotCount; ++i) {
+        if (mSlots[i].mState != kFree && mSlots[i].mHeader == header) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int32_t SprdEncoderInputRing::findFreeSlotLocked() const {
+    for (int32_t i = 0; i < mSlotCount; ++i) {
+        if (mSlots[i].mState == kFree) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int32_t SprdEncoderInputRing::acquire(OMX_BUFFERHEADERTYPE *header) {
+    Mutex::Autolock autoLock(mLock);
+
+    int32_t index = findSlotLocked(header);
+    if (index >= 0 && mSlots[index].mState == kQueued) {
+        // Not started yet; the caller is about to wait for it anyway.
+        for (List<int32_t>::iterator it = mQueue.begin(); it != mQueue.end(); ++it) {
+            if (*it == index) {
+                mQueue.erase(it);
+                break;
+            }
+        }
+        mSlots[index].mState = kFree;
+        index = -1;
+    }
+
+    if (index >= 0) {
+        Slot *slot = &mSlots[index];
+        while (slot->mState == kPreparing) {
+            mDoneCondition.wait(mLock);
+        }
+        CHECK(slot->mState == kReady || slot->mState == kFailed);
+
+        if (slot->mState == kFailed) {
+            slot->mState = kFree;
+            slot->mHeader = NULL;
+            return -1;
+        }
+        slot->mState = kAcquired;
+        return index;
+    }
+
+    index = findFreeSlotLocked();
+    if (index < 0) {
+        // Every slot holds some later frame, e.g. this one arrived before
+        // the ring was opened. Drop one; it is prepared again when its
+        // turn comes.
+        waitIdleLocked();
+        for (int32_t i = 0; i < mSlotCount; ++i) {
+            if (mSlots[i].mState == kReady || mSlots[i].mState == kFailed) {
+                mSlots[i].mState = kFree;
+                mSlots[i].mHeader = NULL;
+                index = i;
+                break;
+            }
+        }
+        CHECK(index >= 0);
+    }
+
+    Slot *slot = &mSlots[index];
+    slot->mHeader = header;
+    slot->mState = kPreparing;
+
+    mLock.unlock();
+    bool ok = (*mPrepare)(mCookie, header, index);
+    mLock.lock();
+
+    if (!ok) {
+        slot->mState = kFree;
+        slot->mHeader = NULL;
+        mDoneCondition.broadcast();
+        return -1;
+    }
+
+    slot->mState = kAcquired;
+    mDoneCondition.broadcast();
+    return index;
+}
+
+void SprdEncoderInputRing::release(int32_t index) {
+    Mutex::Autolock autoLock(mLock);
+
+    CHECK(index >= 0 && index < mSlotCount);
+    CHECK_EQ((int)mSlots[index].mState, (int)kAcquired);
+    mSlots[index].mState = kFree;
+    mSlots[index].mHeader = NULL;
+}
+
+bool SprdEncoderInputRing::prefetch(OMX_BUFFERHEADERTYPE *header) {
+    if (!mThreadStarted) {
+        return false;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    if (!mOpen) {
+        return false;
+    }
+
+    if (findSlotLocked(header) >= 0) {
+        return true;
+    }
+
+    int32_t index = findFreeSlotLocked();
+    if (index < 0) {
+        return false;
+    }
+
+    mSlots[index].mHeader = header;
+    mSlots[index].mState = kQueued;
+    mQueue.push_back(index);
+    mWorkCondition.signal();
+    return true;
+}
+
+void SprdEncoderInputRing::waitIdleLocked() {
+    for (;;) {
+        bool busy = !mQueue.empty();
+        for (int32_t i = 0; i < mSlotCount && !busy; ++i) {
+            busy = mSlots[i].mState == kPreparing;
+        }
+        if (!busy) {
+            return;
+        }
+        mDoneCondition.wait(mLock);
+    }
+}
+
+void SprdEncoderInputRing::open() {
+    Mutex::Autolock autoLock(mLock);
+    mOpen = true;
+}
+
+void SprdEncoderInputRing::waitIdle() {
+    Mutex::Autolock autoLock(mLock);
+    waitIdleLocked();
+}
+
+void SprdEncoderInputRing::discard() {
+    Mutex::Autolock autoLock(mLock);
+    mOpen = false;
+
+    // Frames not started yet are dropped rather than prepared.
+    for (List<int32_t>::iterator it = mQueue.begin(); it != mQueue.end(); ++it) {
+        mSlots[*it].mState = kFree;
+        mSlots[*it].mHeader = NULL;
+    }
+    mQueue.clear();
+    waitIdleLocked();
+
+    for (int32_t i = 0; i < mSlotCount; ++i) {
+        mSlots[i].mState = kFree;
+        mSlots[i].mHeader = NULL;
+    }
+}
+
+}  // namespace android
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdIonArena"
+#include <utils/Log.h>
+
+#include "include/SprdIonArena.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+
+#include <errno.h>
+#include <string.h>
+
+namespace android {
+
+#define SPRD_ION_DEV "/dev/ion"
+
+// Regions start on a page so their engine addresses stay page aligned.
+static const size_t kRegionAlign = 4096;
+// Blocks are sized in these steps and are never smaller than kMinBlockSize,
+// so the per-frame mbinfo/ctuinfo regions pack into the first block.
+static const size_t kBlockAlign = 1024 * 1024;
+static const size_t kMinBlockSize = 2 * 1024 * 1024;
+
+static size_t alignUp(size_t size, size_t align) {
+    return (size + align - 1) & ~(align - 1);
+}
+
+SprdIonArena::SprdIonArena(const char *name, unsigned int heapMask,
+        MapFunc map, UnmapFunc unmap, void *cookie)
+    : mName(name),
+      mHeapMask(heapMask),
+      mMap(map),
+      mUnmap(unmap),
+      mCookie(cookie),
+      mInUse(0),
+      mMapped(0),
+      mInUseHighWater(0),
+      mMappedHighWater(0),
+      mSequenceHighWater(0),
+      mCompactPending(false) {
+}
+
+SprdIonArena::~SprdIonArena() {
+    // releaseAll() has to run while the codec can still unmap.
+    CHECK(mBlocks.isEmpty());
+}
+
+status_t SprdIonArena::addBlock(size_t size) {
+    size_t blockSize = alignUp(size, kBlockAlign);
+    if (blockSize < kMinBlockSize) {
+        blockSize = kMinBlockSize;
+    }
+
+    sp<MemIon> mem = new MemIon(SPRD_ION_DEV, blockSize, MemIon::NO_CACHING, mHeapMask);
+    int fd = mem->getHeapID();
+    if (fd < 0 && blockSize != size) {
+        // Large contiguous blocks are the first to fail on carveout heaps.
+        blockSize = size;
+        mem = new MemIon(SPRD_ION_DEV, blockSize, MemIon::NO_CACHING, mHeapMask);
+        fd = mem->getHeapID();
+    }
+    if (fd < 0) {
+        ALOGE("%s: unable to allocate %zu bytes, fd %d", mName.c_str(), blockSize, fd);
+        return NO_MEMORY;
+    }
+
+    unsigned long phy_addr;
+    size_t buffer_size;
+    int ret;
+    if (mMap != NULL) {
+        ret = (*mMap)(mCookie, fd, &phy_addr, &buffer_size);
+    } else {
+        ret = mem->get_phy_addr_from_ion(&phy_addr, &buffer_size);
+    }
+    if (ret < 0) {
+        ALOGE("%s: get phy addr fail %d(%s)", mName.c_str(), ret, strerror(errno));
+        return UNKNOWN_ERROR;
+    }
+
+    Block block;
+    block.mMem = mem;
+    block.mVirt = (uint8_t *)mem->getBase();
+    block.mPhy = phy_addr;
+    block.mSize = buffer_size;
+    block.mUsed = 0;
+    mBlocks.push_back(block);
+
+    mMapped += buffer_size;
+    if (mMapped > mMappedHighWater) {
+        mMappedHighWater = mMapped;
+    }
+
+    ALOGI("%s: block %zu, 0x%lx - %p - %zu", mName.c_str(), mBlocks.size() - 1,
+            block.mPhy, block.mVirt, block.mSize);
+    return OK;
+}
+
+void SprdIonArena::freeBlocks() {
+    for (size_t i = 0; i < mBlocks.size(); ++i) {
+        Block &block = mBlocks.editItemAt(i);
+        if (mUnmap != NULL) {
+            (*mUnmap)(mCookie, block.mPhy, block.mSize);
+        }
+        block.mMem.clear();
+    }
+    mBlocks.clear();
+    mMapped = 0;
+}
+
+status_t SprdIonArena::alloc(size_t size, Region *region) {
+    if (mCompactPending) {
+        // The previous sequence needed several blocks; serve the next one
+        // from a single block large enough for all of it.
+        mCompactPending = false;
+        size_t total = mSequenceHighWater > size ? mSequenceHighWater : size;
+        freeBlocks();
+        status_t err = addBlock(total);
+        if (err != OK) {
+            return err;
+        }
+        mSequenceHighWater = 0;
+    }
+
+    size_t alignedSize = alignUp(size, kRegionAlign);
+
+    Block *block = NULL;
+    for (size_t i = 0; i < mBlocks.size(); ++i) {
+        Block &candidate = mBlocks.editItemAt(i);
+        if (candidate.mSize - candidate.mUsed >= size) {
+            block = &candidate;
+            break;
+        }
+    }
+
+    if (block == NULL) {
+        status_t err = addBlock(alignedSize);
+        if (err != OK) {
+            return err;
+        }
+        block = &mBlocks.editItemAt(mBlocks.size() - 1);
+    }
+
+    region->mVirt = block->mVirt + block->mUsed;
+    region->mPhy = block->mPhy + block->mUsed;
+    region->mSize = size;
+
+    size_t consumed = alignedSize;
+    if (block->mUsed + consumed > block->mSize) {
+        consumed = block->mSize - block->mUsed;
+    }
+    block->mUsed += consumed;
+
+    mInUse += consumed;
+    if (mInUse > mInUseHighWater) {
+        mInUseHighWater = mInUse;
+    }
+    if (mInUse > mSequenceHighWater) {
+        mSequenceHighWater = mInUse;
+    }
+
+    ALOGV("%s: region 0x%lx - %p - %zu", mName.c_str(),
+            region->mPhy, region->mVirt, region->mSize);
+    return OK;
+}
+
+void SprdIonArena::reset() {
+    for (size_t i = 0; i < mBlocks.size(); ++i) {
+        mBlocks.editItemAt(i).mUsed = 0;
+    }
+    mInUse = 0;
+
+    mCompactPending = mBlocks.size() > 1;
+    if (!mCompactPending) {
+        mSequenceHighWater = 0;
+    }
+}
+
+void SprdIonArena::releaseAll() {
+    if (mBlocks.isEmpty()) {
+        return;
+    }
+
+    ALOGI("%s: high water %zu bytes in use, %zu bytes mapped",
+            mName.c_str(), mInUseHighWater, mMappedHighWater);
+
+    freeBlocks();
+    mInUse = 0;
+    mSequenceHighWater = 0;
+    mCompactPending = false;
+}
+
+}  // namespace android
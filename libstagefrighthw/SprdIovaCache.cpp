@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdIovaCache"
+#include <utils/Log.h>
+
+#include "include/SprdIovaCache.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <cutils/properties.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+namespace android {
+
+// Camera HALs cycle through 4 to 8 buffers; leave room for a few more.
+static const int kDefaultCapacity = 12;
+
+SprdIovaCache::SprdIovaCache(
+        const char *name, MapFunc map, UnmapFunc unmap, void *cookie)
+    : mName(name),
+      mMap(map),
+      mUnmap(unmap),
+      mCookie(cookie),
+      mUseSerial(0),
+      mHits(0),
+      mMisses(0) {
+    char value[PROPERTY_VALUE_MAX];
+    property_get("vendor.omx.iova_cache_size", value, "");
+    int capacity = value[0] ? atoi(value) : kDefaultCapacity;
+    // A single entry still saves the remap while the same buffer repeats.
+    mCapacity = capacity > 0 ? capacity : 1;
+}
+
+SprdIovaCache::~SprdIovaCache() {
+    // flush() has to run while the codec can still unmap.
+    CHECK(mEntries.isEmpty());
+}
+
+void SprdIovaCache::reserve(size_t capacity) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mCapacity < capacity) {
+        ALOGI("%s: raising capacity from %zu to %zu", mName.c_str(), mCapacity, capacity);
+        mCapacity = capacity;
+    }
+}
+
+void SprdIovaCache::removeEntryLocked(size_t index) {
+    const Entry &entry = mEntries.valueAt(index);
+    ALOGV("%s: unmap ino %llu, iova 0x%lx", mName.c_str(),
+            (unsigned long long)mEntries.keyAt(index), entry.mIova);
+    (*mUnmap)(mCookie, entry.mIova, entry.mSize);
+    mEntries.removeItemsAt(index);
+}
+
+int SprdIovaCache::map(int fd, unsigned long *iova, size_t *size) {
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        ALOGE("%s: fstat fd %d failed: %s", mName.c_str(), fd, strerror(errno));
+        return -1;
+    }
+    uint64_t key = (uint64_t)st.st_ino;
+
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mEntries.indexOfKey(key);
+    if (index >= 0) {
+        Entry &entry = mEntries.editValueAt(index);
+        if (entry.mDev == st.st_dev) {
+            entry.mLastUse = ++mUseSerial;
+            *iova = entry.mIova;
+            *size = entry.mSize;
+            mHits++;
+            return 0;
+        }
+        removeEntryLocked(index);
+    }
+
+    if (mEntries.size() >= mCapacity) {
+        size_t oldest = 0;
+        for (size_t i = 1; i < mEntries.size(); ++i) {
+            if (mEntries.valueAt(i).mLastUse < mEntries.valueAt(oldest).mLastUse) {
+                oldest = i;
+            }
+        }
+        removeEntryLocked(oldest);
+    }
+
+    Entry entry;
+    int ret = (*mMap)(mCookie, fd, &entry.mIova, &entry.mSize);
+    if (ret < 0) {
+        return ret;
+    }
+    entry.mDev = st.st_dev;
+    entry.mLastUse = ++mUseSerial;
+    mEntries.add(key, entry);
+    mMisses++;
+
+    ALOGV("%s: map fd %d ino %llu, iova 0x%lx, size %zu", mName.c_str(), fd,
+            (unsigned long long)key, entry.mIova, entry.mSize);
+
+    *iova = entry.mIova;
+    *size = entry.mSize;
+    return 0;
+}
+
+void SprdIovaCache::invalidate(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        return;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mEntries.indexOfKey((uint64_t)st.st_ino);
+    if (index >= 0 && mEntries.valueAt(index).mDev == st.st_dev) {
+        removeEntryLocked(index);
+    }
+}
+
+void SprdIovaCache::flush() {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mHits + mMisses > 0) {
+        ALOGI("%s: flushing %zu mappings, %llu hits, %llu misses", mName.c_str(),
+                mEntries.size(), (unsigned long long)mHits, (unsigned long long)mMisses);
+    }
+
+    while (!mEntries.isEmpty()) {
+        removeEntryLocked(mEntries.size() - 1);
+    }
+    mHits = 0;
+    mMisses = 0;
+}
+
+}  // namespace android
@@ -77,6 +77,16 @@ void *SprdOMXComponent::libHandle() const {
     return mLibHandle;
 }
 
+void SprdOMXComponent::rebindClient(
+        const OMX_CALLBACKTYPE *callbacks,
+        OMX_PTR appData,
+        OMX_COMPONENTTYPE **component) {
+    mCallbacks = callbacks;
+    mComponent->pApplicationPrivate = appData;
+
+    *component = mComponent;
+}
+
 OMX_ERRORTYPE SprdOMXComponent::initCheck() const {
     return OMX_ErrorNone;
 }
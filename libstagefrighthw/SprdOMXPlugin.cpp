@@ -51,7 +51,7 @@ SprdOMXPlugin::SprdOMXPlugin()
        rl.rlim_cur = 0;
        rl.rlim_max = 0;
        ALOGI("set nocorefile for mediacodec before");
-       if(prlimit(getpid(),4,&rl,NULL) == 0) {
+       if(prlimit(getpid(),RLIMIT_CORE,&rl,NULL) == 0) {
            ALOGE("prlimit(RLIMIT_CORE) failed for pid %d",getpid());
        }
        ALOGI("set nocorefile for mediacodec end");
@@ -94,6 +94,7 @@ OMX_ERRORTYPE SprdOMXPlugin::AddCore(const char* coreName)
             while (OMX_ErrorNone == ((*(core->mComponentNameEnum))(tmpComponentName, OMX_MAX_STRINGNAME_SIZE, tmpIndex))) {
                 tmpIndex++;
             ALOGI("OMX IL core %s: declares component %s", coreName, tmpComponentName);
+                IndexComponent(core, tmpComponentName);
             }
             core->mNumComponents = tmpIndex;
             ALOGI("OMX IL core %s: contains %ld components", coreName, core->mNumComponents);
@@ -108,6 +109,49 @@ OMX_ERRORTYPE SprdOMXPlugin::AddCore(const char* coreName)
     return OMX_ErrorNone;
 }
 
+void SprdOMXPlugin::IndexComponent(SprdOMXCore *core, const char *name) {
+    String8 key(name);
+    if (mComponentIndex.indexOfKey(key) >= 0) {
+        // An earlier core already provides this name and keeps serving it.
+        ALOGW("component %s is declared by more than one core", name);
+        return;
+    }
+
+    SprdOMXComponentInfo info;
+    info.mCore = core;
+
+    OMX_U32 numRoles = 0;
+    if (core->mGetRolesOfComponentHandle != NULL
+            && (*(core->mGetRolesOfComponentHandle))(
+                    const_cast<OMX_STRING>(name), &numRoles, NULL) == OMX_ErrorNone
+            && numRoles > 0) {
+        OMX_U8 **array = new OMX_U8 *[numRoles];
+        for (OMX_U32 i = 0; i < numRoles; ++i) {
+            array[i] = new OMX_U8[OMX_MAX_STRINGNAME_SIZE];
+        }
+
+        OMX_U32 numRoles2 = numRoles;
+        OMX_ERRORTYPE err = (*(core->mGetRolesOfComponentHandle))(
+                const_cast<OMX_STRING>(name), &numRoles2, array);
+
+        CHECK_EQ(err, OMX_ErrorNone);
+        CHECK_EQ(numRoles, numRoles2);
+
+        for (OMX_U32 i = 0; i < numRoles; ++i) {
+            info.mRoles.push(String8((const char *)array[i]));
+
+            delete[] array[i];
+            array[i] = NULL;
+        }
+
+        delete[] array;
+        array = NULL;
+    }
+
+    mComponentNames.push(key);
+    mComponentIndex.add(key, info);
+}
+
 SprdOMXPlugin::~SprdOMXPlugin() {
     for (OMX_U32 i = 0; i < mCores.size(); i++) {
        if (mCores[i] != NULL && mCores[i]->mLibHandle != NULL) {
@@ -124,33 +168,28 @@ OMX_ERRORTYPE SprdOMXPlugin::makeComponentInstance(
         const OMX_CALLBACKTYPE *callbacks,
         OMX_PTR appData,
         OMX_COMPONENTTYPE **component) {
-    for (OMX_U32 i = 0; i < mCores.size(); i++) {
-        if (mCores[i] != NULL) {
-            if (mCores[i]->mLibHandle == NULL) {
-                continue;
-            }
+    ssize_t index = mComponentIndex.indexOfKey(String8(name));
+    if (index < 0) {
+        return OMX_ErrorInvalidComponentName;
+    }
 
-            OMX_ERRORTYPE omx_res = (*(mCores[i]->mGetHandle))(
-                reinterpret_cast<OMX_HANDLETYPE *>(component),
-                const_cast<char *>(name),
-                appData, const_cast<OMX_CALLBACKTYPE *>(callbacks));
-            if(omx_res == OMX_ErrorNone) {
-                Mutex::Autolock autoLock(mMutex);
-                SprdOMX comp;
+    SprdOMXCore *core = mComponentIndex.valueAt(index).mCore;
+    OMX_ERRORTYPE omx_res = (*(core->mGetHandle))(
+        reinterpret_cast<OMX_HANDLETYPE *>(component),
+        const_cast<char *>(name),
+        appData, const_cast<OMX_CALLBACKTYPE *>(callbacks));
+    if (omx_res != OMX_ErrorNone) {
+        return omx_res;
+    }
 
-                comp.mComponent = *component;
-                comp.mCore = mCores[i];
+    Mutex::Autolock autoLock(mMutex);
+    SprdOMX comp;
 
-                mComponents.push_back(comp);
-                return OMX_ErrorNone;
-            }
-            else if(omx_res == OMX_ErrorInsufficientResources)
-                {
-                return omx_res;
-                }
-        }
-    }
-    return OMX_ErrorInvalidComponentName;
+    comp.mComponent = *component;
+    comp.mCore = core;
+
+    mComponents.push_back(comp);
+    return OMX_ErrorNone;
 }
 
 OMX_ERRORTYPE SprdOMXPlugin::destroyComponentInstance(
@@ -173,61 +212,29 @@ OMX_ERRORTYPE SprdOMXPlugin::enumerateComponents(
         OMX_STRING name,
         size_t size,
         OMX_U32 index) {
-    // returning components
-    OMX_U32 relativeIndex = index;
-    for (OMX_U32 i = 0; i < mCores.size(); i++) {
-        if (mCores[i]->mLibHandle == NULL) {
-           continue;
-        }
-        if (relativeIndex < mCores[i]->mNumComponents) return ((*(mCores[i]->mComponentNameEnum))(name, size, relativeIndex));
-        else relativeIndex -= mCores[i]->mNumComponents;
+    if (index >= mComponentNames.size()) {
+        return OMX_ErrorNoMore;
+    }
+
+    strncpy(name, mComponentNames[index].string(), size);
+    if (size > 0) {
+        name[size - 1] = '\0';
     }
-    return OMX_ErrorNoMore;
+    return OMX_ErrorNone;
 }
 
 OMX_ERRORTYPE SprdOMXPlugin::getRolesOfComponent(
         const char *name,
         Vector<String8> *roles) {
     roles->clear();
-    for (OMX_U32 j = 0; j < mCores.size(); j++) {
-        if (mCores[j]->mLibHandle == NULL) {
-           continue;
-        }
-
-        OMX_U32 numRoles;
-        OMX_ERRORTYPE err = (*(mCores[j]->mGetRolesOfComponentHandle))(
-                const_cast<OMX_STRING>(name), &numRoles, NULL);
-
-        if (err != OMX_ErrorNone) {
-            continue;
-        }
 
-        if (numRoles > 0) {
-            OMX_U8 **array = new OMX_U8 *[numRoles];
-            for (OMX_U32 i = 0; i < numRoles; ++i) {
-                array[i] = new OMX_U8[OMX_MAX_STRINGNAME_SIZE];
-            }
-
-            OMX_U32 numRoles2 = numRoles;
-            err = (*(mCores[j]->mGetRolesOfComponentHandle))(
-                    const_cast<OMX_STRING>(name), &numRoles2, array);
-
-            CHECK_EQ(err, OMX_ErrorNone);
-            CHECK_EQ(numRoles, numRoles2);
-
-            for (OMX_U32 i = 0; i < numRoles; ++i) {
-                String8 s((const char *)array[i]);
-                roles->push(s);
-
-                delete[] array[i];
-                array[i] = NULL;
-            }
-
-            delete[] array;
-            array = NULL;
-        }
+    ssize_t index = mComponentIndex.indexOfKey(String8(name));
+    if (index < 0) {
+        return OMX_ErrorInvalidComponent;
     }
 
+    *roles = mComponentIndex.valueAt(index).mRoles;
+
     if (roles->empty()) {
         return OMX_ErrorInvalidComponent;
     } else {
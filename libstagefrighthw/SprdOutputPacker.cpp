@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdOutputPacker"
+#include <utils/Log.h>
+
+#include "include/SprdOutputPacker.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace android {
+
+static const size_t kExtraDataHeaderSize = offsetof(OMX_OTHER_EXTRADATATYPE, data);
+
+static size_t align4(size_t size) {
+    return (size + 3) & ~(size_t)3;
+}
+
+SprdOutputPacker::SprdOutputPacker()
+    : mMaxFrames(0),
+      mHeader(NULL),
+      mGeneration(0),
+      mLargestFrame(0),
+      mSetAside(NULL),
+      mSetAsideCapacity(0),
+      mSetAsideSize(0),
+      mSetAsideReady(false) {
+    memset(&mSetAsideInfo, 0, sizeof(mSetAsideInfo));
+}
+
+SprdOutputPacker::~SprdOutputPacker() {
+    free(mSetAside);
+}
+
+void SprdOutputPacker::setMaxFrames(OMX_U32 maxFrames) {
+    CHECK(mFrames.empty());
+    mMaxFrames = maxFrames;
+}
+
+size_t SprdOutputPacker::extraDataSize(size_t frames) const {
+    // Up to 3 bytes to align the first section behind the payload, the
+    // frame list, then the OMX_ExtraDataNone terminator.
+    return 3
+            + align4(kExtraDataHeaderSize + offsetof(SprdPackedFrameList, frames)
+                    + frames * sizeof(SprdPackedFrameInfo))
+            + align4(kExtraDataHeaderSize);
+}
+
+OMX_U8 *SprdOutputPacker::tail(const OMX_BUFFERHEADERTYPE *header) const {
+    return header->pBuffer + header->nOffset + header->nFilledLen;
+}
+
+size_t SprdOutputPacker::room(const OMX_BUFFERHEADERTYPE *header) const {
+    size_t used = header->nOffset + header->nFilledLen + extraDataSize(mMaxFrames);
+    return header->nAllocLen > used ? header->nAllocLen - used : 0;
+}
+
+OMX_U8 *SprdOutputPacker::frameTarget(const OMX_BUFFERHEADERTYPE *header, size_t size) {
+    CHECK(!mSetAsideReady);
+
+    size_t used = header->nOffset + header->nFilledLen;
+    size_t left = header->nAllocLen > used ? header->nAllocLen - used : 0;
+    if (mFrames.empty()) {
+        // Returned without the frame list if that does not fit as well.
+        return size <= left ? tail(header) : NULL;
+    }
+    if (size <= room(header)) {
+        return tail(header);
+    }
+
+    size_t emptyFree = header->nAllocLen > header->nOffset
+            ? header->nAllocLen - header->nOffset : 0;
+    if (size > emptyFree) {
+        return NULL;
+    }
+    if (size > mSetAsideCapacity) {
+        OMX_U8 *setAside = (OMX_U8 *)realloc(mSetAside, size);
+        if (setAside == NULL) {
+            return NULL;
+        }
+        mSetAside = setAside;
+        mSetAsideCapacity = size;
+    }
+    mSetAsideSize = size;
+    return mSetAside;
+}
+
+bool SprdOutputPacker::append(
+        OMX_BUFFERHEADERTYPE *header, OMX_TICKS timeUs, OMX_U32 size, OMX_U32 flags) {
+    CHECK(mHeader == NULL || mHeader == header);
+
+    if (mSetAsideSize > 0) {
+        CHECK_EQ((size_t)size, mSetAsideSize);
+        memset(&mSetAsideInfo, 0, sizeof(mSetAsideInfo));
+        mSetAsideInfo.nTimeStamp = timeUs;
+        mSetAsideInfo.nSize = size;
+        mSetAsideInfo.nFlags = flags;
+        mSetAsideReady = true;
+        mSetAsideSize = 0;
+        return false;
+    }
+
+    if (mFrames.empty()) {
+        header->nTimeStamp = timeUs;
+        header->nFlags = 0;
+    }
+    mHeader = header;
+
+    SprdPackedFrameInfo info;
+    memset(&info, 0, sizeof(info));
+    info.nTimeStamp = timeUs;
+    info.nOffset = header->nFilledLen;
+    info.nSize = size;
+    info.nFlags = flags;
+    mFrames.push_back(info);
+    if (size > mLargestFrame) {
+        mLargestFrame = size;
+    }
+
+    header->nFilledLen += size;
+    return true;
+}
+
+OMX_U32 SprdOutputPacker::placeSetAside(OMX_BUFFERHEADERTYPE *header) {
+    CHECK(mSetAsideReady);
+    CHECK(mFrames.empty());
+    CHECK_LE((size_t)header->nOffset + header->nFilledLen + mSetAsideInfo.nSize,
+            (size_t)header->nAllocLen);
+
+    memcpy(tail(header), mSetAside, mSetAsideInfo.nSize);
+    mSetAsideReady = false;
+    append(header, mSetAsideInfo.nTimeStamp, mSetAsideInfo.nSize, mSetAsideInfo.nFlags);
+    return mSetAsideInfo.nFlags;
+}
+
+bool SprdOutputPacker::isFull(const OMX_BUFFERHEADERTYPE *header, size_t nextSize) const {
+    return mFrames.size() >= mMaxFrames || room(header) < nextSize;
+}
+
+void SprdOutputPacker::finish(OMX_BUFFERHEADERTYPE *header) {
+    CHECK(mHeader == header);
+    CHECK(!mFrames.empty());
+
+    size_t frames = mFrames.size();
+    size_t listSize = offsetof(SprdPackedFrameList, frames) + frames * sizeof(SprdPackedFrameInfo);
+    size_t offset = align4(header->nOffset + header->nFilledLen);
+    if (offset + align4(kExtraDataHeaderSize + listSize) + align4(kExtraDataHeaderSize)
+            > (size_t)header->nAllocLen) {
+        // frameTarget() only lets a frame leave too little room for the
+        // list when it is alone in the buffer.
+        CHECK_EQ(frames, 1u);
+        header->nFlags |= mFrames.itemAt(0).nFlags;
+        ALOGV("finish, one frame of %u bytes without the frame list", header->nFilledLen);
+
+        mFrames.clear();
+        mLargestFrame = 0;
+        mHeader = NULL;
+        ++mGeneration;
+        return;
+    }
+
+    OMX_OTHER_EXTRADATATYPE *extra = (OMX_OTHER_EXTRADATATYPE *)(header->pBuffer + offset);
+    extra->nSize = align4(kExtraDataHeaderSize + listSize);
+    extra->nVersion.s.nVersionMajor = 1;
+    extra->nVersion.s.nVersionMinor = 0;
+    extra->nVersion.s.nRevision = 0;
+    extra->nVersion.s.nStep = 0;
+    extra->nPortIndex = 1;
+    extra->eType = OMX_ExtraDataSprdFrameList;
+    extra->nDataSize = listSize;
+
+    // The list sits at a 4-byte boundary only, so it is copied in.
+    OMX_U32 count[2] = { (OMX_U32)frames, 0 };
+    memcpy(extra->data, count, sizeof(count));
+    memcpy(extra->data + offsetof(SprdPackedFrameList, frames),
+            mFrames.array(), frames * sizeof(SprdPackedFrameInfo));
+
+    OMX_OTHER_EXTRADATATYPE *terminator =
+        (OMX_OTHER_EXTRADATATYPE *)((OMX_U8 *)extra + extra->nSize);
+    memset(terminator, 0, align4(kExtraDataHeaderSize));
+    terminator->nSize = align4(kExtraDataHeaderSize);
+    terminator->nVersion = extra->nVersion;
+    terminator->nPortIndex = extra->nPortIndex;
+    terminator->eType = OMX_ExtraDataNone;
+
+    // A packed buffer is a sync frame only if it starts with one.
+    OMX_U32 flags = 0;
+    for (size_t i = 0; i < frames; ++i) {
+        flags |= mFrames.itemAt(i).nFlags;
+    }
+    if (!(mFrames.itemAt(0).nFlags & OMX_BUFFERFLAG_SYNCFRAME)) {
+        flags &= ~OMX_BUFFERFLAG_SYNCFRAME;
+    }
+    header->nFlags |= flags | OMX_BUFFERFLAG_EXTRADATA;
+
+    ALOGV("finish, %zu frames, %u bytes", frames, header->nFilledLen);
+
+    mFrames.clear();
+    mLargestFrame = 0;
+    mHeader = NULL;
+    ++mGeneration;
+}
+
+// static
+bool SprdOutputPacker::writeStartCode(OMX_U8 *frame, size_t size) {
+    static const OMX_U8 kStartCode[] = { 0x00, 0x00, 0x00, 0x01 };
+
+    if (size < sizeof(kStartCode)) {
+        return false;
+    }
+    memcpy(frame, kStartCode, sizeof(kStartCode));
+    return true;
+}
+
+void SprdOutputPacker::finishPending() {
+    if (mHeader != NULL) {
+        finish(mHeader);
+    }
+}
+
+void SprdOutputPacker::reset() {
+    mFrames.clear();
+    mLargestFrame = 0;
+    mSetAsideSize = 0;
+    mSetAsideReady = false;
+    mHeader = NULL;
+    ++mGeneration;
+}
+
+}  // namespace android
@@ -19,10 +19,15 @@
 #include <utils/Log.h>
 
 #include "include/SprdSimpleOMXComponent.h"
+#include "include/SprdStripePool.h"
 
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/ALooper.h>
 #include <media/stagefright/foundation/AMessage.h>
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+
+#include <stdlib.h>
 
 namespace android {
 
@@ -32,19 +37,57 @@ SprdSimpleOMXComponent::SprdSimpleOMXComponent(
     OMX_PTR appData,
     OMX_COMPONENTTYPE **component)
     : SprdOMXComponent(name, callbacks, appData, component),
+      mMetrics(name),
       mLooper(new ALooper),
       mHandler(new AHandlerReflector<SprdSimpleOMXComponent>(this)),
       mState(OMX_StateLoaded),
-      mTargetState(OMX_StateLoaded) {
+      mTargetState(OMX_StateLoaded),
+      mBufferRingEnabled(true),
+      mDrainPending(0),
+      mDecodeThreadStarted(false),
+      mDecodeThreadExit(false),
+      mDecodeBusy(false),
+      mInHardware(false),
+      mSectionUnlocked(false),
+      mDecodePending(0),
+      mVspScheduled(false),
+      mVspCore(SprdVspScheduler::kCoreDecoder),
+      mVspPriority(SprdVspScheduler::kPriorityNormal),
+      mVspSessionId(-1),
+      mOutputPackingEnabled(false),
+      mBatchMaxBuffers(1),
+      mBatchLatencyUs(5000),
+      mDoneGeneration(0),
+      mDelivering(false),
+      mPackedFlushGeneration(-1) {
+    char value[PROPERTY_VALUE_MAX];
+    property_get("vendor.omx.cb_batch_max", value, "1");
+    mBatchMaxBuffers = atoi(value);
+    property_get("vendor.omx.cb_batch_us", value, "5000");
+    mBatchLatencyUs = atoi(value);
+    // 0 posts one AMessage per buffer, as before the rings, for A/B runs.
+    property_get("vendor.omx.buffer_ring", value, "1");
+    mBufferRingEnabled = atoi(value) != 0;
+
     mLooper->setName(name);
     mLooper->registerHandler(mHandler);
 
+    // Reposted for every batch of buffers, never modified after this.
+    mDrainMsg = new AMessage(kWhatDrainBuffers, mHandler);
+
     mLooper->start(
         false, // runOnCallingThread
         false, // canCallJava
         ANDROID_PRIORITY_FOREGROUND);
 }
 
+SprdSimpleOMXComponent::~SprdSimpleOMXComponent() {
+    // Normally already gone through prepareForDestruction(), but not when
+    // the component is dropped after a failed initCheck().
+    stopDecodeThread();
+    releaseVspSession();
+}
+
 void SprdSimpleOMXComponent::prepareForDestruction() {
     // The looper's queue may still contain messages referencing this
     // object. Make sure those are flushed before returning so that
@@ -52,12 +95,258 @@ void SprdSimpleOMXComponent::prepareForDestruction() {
 
     mLooper->unregisterHandler(mHandler->id());
     mLooper->stop();
+
+    stopDecodeThread();
+    releaseVspSession();
+}
+
+void SprdSimpleOMXComponent::setBufferRingEnabled(bool enabled) {
+    mBufferRingEnabled = enabled;
+}
+
+void SprdSimpleOMXComponent::enableVspScheduling(SprdVspScheduler::Core core) {
+    mVspScheduled = true;
+    mVspCore = core;
+}
+
+void SprdSimpleOMXComponent::disableVspScheduling() {
+    mVspScheduled = false;
+    releaseVspSession();
+}
+
+void SprdSimpleOMXComponent::setVspPriority(SprdVspScheduler::Priority priority) {
+    mVspPriority = priority;
+    if (mVspSessionId >= 0) {
+        SprdVspScheduler::getInstance()->setPriority(mVspSessionId, priority);
+    }
+}
+
+void SprdSimpleOMXComponent::getVspLoad(
+        int32_t *width, int32_t *height, int32_t *fps) const {
+    *width = 0;
+    *height = 0;
+    *fps = 0;
+
+    for (size_t i = 0; i < mPorts.size(); ++i) {
+        const OMX_PARAM_PORTDEFINITIONTYPE &def = mPorts.itemAt(i).mDef;
+        if (def.eDomain != OMX_PortDomainVideo) {
+            continue;
+        }
+
+        int32_t w = def.format.video.nFrameWidth;
+        int32_t h = def.format.video.nFrameHeight;
+        if ((int64_t)w * h > (int64_t)*width * *height) {
+            *width = w;
+            *height = h;
+        }
+
+        int32_t f = def.format.video.xFramerate >> 16;
+        if (f > *fps) {
+            *fps = f;
+        }
+    }
+}
+
+bool SprdSimpleOMXComponent::admitVspSession() {
+    if (!mVspScheduled || mVspSessionId >= 0) {
+        return true;
+    }
+
+    int32_t width, height, fps;
+    getVspLoad(&width, &height, &fps);
+
+    return SprdVspScheduler::getInstance()->registerSession(
+            name(), mVspCore, width, height, fps, mVspPriority, &mVspSessionId) == OK;
+}
+
+void SprdSimpleOMXComponent::releaseVspSession() {
+    if (mVspSessionId < 0) {
+        return;
+    }
+
+    SprdVspScheduler::getInstance()->unregisterSession(mVspSessionId);
+    mVspSessionId = -1;
+}
+
+void SprdSimpleOMXComponent::enableOutputPacking() {
+    mOutputPackingEnabled = true;
+}
+
+void SprdSimpleOMXComponent::startDecodeThread() {
+    CHECK(!mDecodeThreadStarted);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    if (pthread_create(&mDecodeThread, &attr, DecodeThreadWrapper, this) == 0) {
+        mDecodeThreadStarted = true;
+    } else {
+        ALOGW("startDecodeThread, pthread_create failed, decoding on the looper");
+    }
+    pthread_attr_destroy(&attr);
+}
+
+void SprdSimpleOMXComponent::stopDecodeThread() {
+    if (!mDecodeThreadStarted) {
+        return;
+    }
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        mDecodeThreadExit = true;
+        mDecodeCondition.signal();
+    }
+
+    void *dummy;
+    pthread_join(mDecodeThread, &dummy);
+    mDecodeThreadStarted = false;
+}
+
+// static
+void *SprdSimpleOMXComponent::DecodeThreadWrapper(void *me) {
+    ((SprdSimpleOMXComponent *)me)->decodeThreadEntry();
+    return NULL;
+}
+
+void SprdSimpleOMXComponent::decodeThreadEntry() {
+    Mutex::Autolock autoLock(mLock);
+
+    while (!mDecodeThreadExit) {
+        if (mDecodePending == 0) {
+            mDecodeCondition.wait(mLock);
+            continue;
+        }
+
+        uint32_t pending = mDecodePending;
+        mDecodePending = 0;
+        mDecodeBusy = true;
+
+        prepareDeferredBuffers();
+
+        if (pending & (1 << kInputPortIndex)) {
+            onQueueFilled(kInputPortIndex);
+        }
+        if (pending & (1 << kOutputPortIndex)) {
+            onQueueFilled(kOutputPortIndex);
+        }
+        schedulePackedFlush();
+
+        mDecodeBusy = false;
+        mDecodeIdleCondition.broadcast();
+    }
+}
+
+void SprdSimpleOMXComponent::queueFilled(OMX_U32 portIndex) {
+    if (!mDecodeThreadStarted) {
+        onQueueFilled(portIndex);
+        schedulePackedFlush();
+        return;
+    }
+
+    mDecodePending |= 1 << portIndex;
+    mDecodeCondition.signal();
+}
+
+void SprdSimpleOMXComponent::prepareDeferredBuffers() {
+    for (size_t i = 0; i < mDeferredPrepareBuffers.size(); ++i) {
+        onDecodePrepare(mDeferredPrepareBuffers.itemAt(i));
+    }
+    mDeferredPrepareBuffers.clear();
+}
+
+void SprdSimpleOMXComponent::waitForDecodeIdle() {
+    while (mDecodeThreadStarted && (mDecodeBusy || mDecodePending != 0)) {
+        mDecodeIdleCondition.wait(mLock);
+    }
+}
+
+void SprdSimpleOMXComponent::waitForSectionLocked() {
+    while (mSectionUnlocked) {
+        mSectionCondition.wait(mLock);
+    }
+}
+
+SprdSimpleOMXComponent::HardwareSection::HardwareSection(
+        SprdSimpleOMXComponent *component)
+    : mComponent(component),
+      mUnlocked(false),
+      mStartUs(0) {
+    if (mComponent->mDecodeThreadStarted
+            && pthread_equal(pthread_self(), mComponent->mDecodeThread)) {
+        mComponent->mInHardware = true;
+        mComponent->mSectionUnlocked = true;
+        mComponent->mLock.unlock();
+        mUnlocked = true;
+    }
+
+    mStartUs = SprdCodecMetrics::nowUs();
+    if (mComponent->mVspSessionId >= 0) {
+        // Nothing else runs on the looper meanwhile, but binder calls
+        // such as setConfig() should not wait for another session's frame.
+        // Commands are handled on the looper and cannot run either, and
+        // the calls that touch ports or buffers wait for the lock to come
+        // back, so onQueueFilled() finds its buffers as it left them.
+        if (!mUnlocked) {
+            mComponent->mSectionUnlocked = true;
+            mComponent->mLock.unlock();
+        }
+        SprdVspScheduler::getInstance()->acquireEngine(mComponent->mVspSessionId);
+        if (!mUnlocked) {
+            mComponent->mLock.lock();
+            mComponent->mSectionUnlocked = false;
+            mComponent->mSectionCondition.broadcast();
+        }
+
+        int64_t waitStartUs = mStartUs;
+        mStartUs = SprdCodecMetrics::nowUs();
+        mComponent->mMetrics.record(
+                SprdCodecMetrics::kHistogramEngineWait, mStartUs - waitStartUs);
+    }
+}
+
+SprdSimpleOMXComponent::HardwareSection::~HardwareSection() {
+    mComponent->mMetrics.record(
+            SprdCodecMetrics::kHistogramEngineTime, SprdCodecMetrics::nowUs() - mStartUs);
+
+    if (mComponent->mVspSessionId >= 0) {
+        SprdVspScheduler::getInstance()->releaseEngine(mComponent->mVspSessionId);
+    }
+
+    if (!mUnlocked) {
+        return;
+    }
+
+    mComponent->mLock.lock();
+    mComponent->mInHardware = false;
+    mComponent->mSectionUnlocked = false;
+    mComponent->mSectionCondition.broadcast();
+
+    // Before onQueueFilled() can pick up what arrived meanwhile.
+    mComponent->prepareDeferredBuffers();
+
+    for (size_t i = 0; i < mComponent->mDeferredFillBuffers.size(); ++i) {
+        mComponent->onFillThisBuffer(mComponent->mDeferredFillBuffers.itemAt(i));
+    }
+    mComponent->mDeferredFillBuffers.clear();
 }
 
 OMX_ERRORTYPE SprdSimpleOMXComponent::sendCommand(
     OMX_COMMANDTYPE cmd, OMX_U32 param, OMX_PTR data) {
     CHECK(data == NULL);
 
+    if (mBufferRingEnabled) {
+        // Through the ring as well, so buffers queued before the command
+        // are handled before it and those queued after it after it.
+        BufferRing::Entry entry;
+        entry.mKind = BufferRing::kCommand;
+        entry.mHeader = NULL;
+        entry.mCmd = cmd;
+        entry.mParam = param;
+        mClientRing.push(entry);
+        signalBufferDrain();
+        return OMX_ErrorNone;
+    }
+
     sp<AMessage> msg = new AMessage(kWhatSendCommand, mHandler);
     msg->setInt32("cmd", cmd);
     msg->setInt32("param", param);
@@ -111,6 +400,7 @@ OMX_ERRORTYPE SprdSimpleOMXComponent::getParameter(
 OMX_ERRORTYPE SprdSimpleOMXComponent::setParameter(
     OMX_INDEXTYPE index, const OMX_PTR params) {
     Mutex::Autolock autoLock(mLock);
+    waitForSectionLocked();
 
     CHECK(isSetParameterAllowed(index, params));
 
@@ -139,6 +429,23 @@ OMX_ERRORTYPE SprdSimpleOMXComponent::internalGetParameter(
         return OMX_ErrorNone;
     }
 
+    case OMX_IndexParamOutputPacking:
+    {
+        SprdOutputPackingParams *packingParams = (SprdOutputPackingParams *)params;
+
+        if (!mOutputPackingEnabled) {
+            return OMX_ErrorUnsupportedIndex;
+        }
+        if (packingParams->nSize < sizeof(SprdOutputPackingParams)
+                || packingParams->nPortIndex != kOutputPortIndex) {
+            return OMX_ErrorBadParameter;
+        }
+
+        packingParams->nMaxFrames = mOutputPacker.maxFrames();
+
+        return OMX_ErrorNone;
+    }
+
     default:
         return OMX_ErrorUnsupportedIndex;
     }
@@ -177,6 +484,26 @@ OMX_ERRORTYPE SprdSimpleOMXComponent::internalSetParameter(
         return OMX_ErrorNone;
     }
 
+    case OMX_IndexParamOutputPacking:
+    {
+        const SprdOutputPackingParams *packingParams =
+            (const SprdOutputPackingParams *)params;
+
+        if (!mOutputPackingEnabled) {
+            return OMX_ErrorUnsupportedIndex;
+        }
+        if (packingParams->nSize < sizeof(SprdOutputPackingParams)
+                || packingParams->nPortIndex != kOutputPortIndex) {
+            return OMX_ErrorBadParameter;
+        }
+
+        ALOGI("%s, pack up to %u frames per output buffer",
+                name(), packingParams->nMaxFrames);
+        mOutputPacker.setMaxFrames(packingParams->nMaxFrames);
+
+        return OMX_ErrorNone;
+    }
+
     default:
         return OMX_ErrorUnsupportedIndex;
     }
@@ -190,6 +517,7 @@ OMX_ERRORTYPE SprdSimpleOMXComponent::useBuffer(
     OMX_U8 *ptr,
     BufferPrivateStruct* bufferPrivate) {
     Mutex::Autolock autoLock(mLock);
+    waitForSectionLocked();
     CHECK_LT(portIndex, mPorts.size());
 
     PortInfo *port = &mPorts.editItemAt(portIndex);
@@ -231,20 +559,8 @@ OMX_ERRORTYPE SprdSimpleOMXComponent::internalUseBuffer(
     (*header)->nOutputPortIndex = portIndex;
     (*header)->nInputPortIndex = portIndex;
 
-    PortInfo *port = &mPorts.editItemAt(portIndex);
-
-    port->mBuffers.push();
-
-    BufferInfo *buffer =
-        &port->mBuffers.editItemAt(port->mBuffers.size() - 1);
     ALOGI("internalUseBuffer, header=0x%p, pBuffer=0x%p, size=%d",*header, ptr, size);
-    buffer->mHeader = *header;
-    buffer->mOwnedByUs = false;
-
-    if (port->mBuffers.size() == port->mDef.nBufferCountActual) {
-        port->mDef.bPopulated = OMX_TRUE;
-        checkTransitions();
-    }
+    addBuffer(portIndex, *header);
 
     return OMX_ErrorNone;
 }
@@ -275,8 +591,10 @@ OMX_ERRORTYPE SprdSimpleOMXComponent::allocateBuffer(
         return err;
     }
 
-    CHECK((*header)->pPlatformPrivate == NULL);
-    (*header)->pPlatformPrivate = ptr;
+    BufferPlatformPrivate *platformPrivate =
+        (BufferPlatformPrivate *)(*header)->pPlatformPrivate;
+    CHECK(platformPrivate->mAllocation == NULL);
+    platformPrivate->mAllocation = ptr;
 
     return OMX_ErrorNone;
 }
@@ -285,62 +603,76 @@ OMX_ERRORTYPE SprdSimpleOMXComponent::freeBuffer(
     OMX_U32 portIndex,
     OMX_BUFFERHEADERTYPE *header) {
     Mutex::Autolock autoLock(mLock);
+    waitForSectionLocked();
 
     CHECK_LT(portIndex, mPorts.size());
 
     PortInfo *port = &mPorts.editItemAt(portIndex);
 
-    bool found = false;
-    for (size_t i = 0; i < port->mBuffers.size(); ++i) {
-        BufferInfo *buffer = &port->mBuffers.editItemAt(i);
+    BufferInfo *buffer = findBufferInfo(portIndex, header);
+    CHECK(buffer != NULL);
+    CHECK(!buffer->mOwnedByUs);
 
-        if (buffer->mHeader == header) {
-            CHECK(!buffer->mOwnedByUs);
+    BufferPlatformPrivate *platformPrivate =
+        (BufferPlatformPrivate *)header->pPlatformPrivate;
+    size_t index = platformPrivate->mIndex;
 
-            if (header->pPlatformPrivate != NULL) {
-                // This buffer's data was allocated by us.
-                if(portIndex == OMX_DirOutput) {
-                    delete[] (OMX_U8*)(header->pPlatformPrivate);
-                    header->pPlatformPrivate = NULL;
-                    header->pBuffer = NULL;
-                } else {
-                    CHECK(header->pPlatformPrivate == header->pBuffer);
+    if (platformPrivate->mAllocation != NULL) {
+        // This buffer's data was allocated by us.
+        if(portIndex == OMX_DirOutput) {
+            delete[] platformPrivate->mAllocation;
+            header->pBuffer = NULL;
+        } else {
+            CHECK(platformPrivate->mAllocation == header->pBuffer);
 
-                    delete[] header->pBuffer;
-                    header->pBuffer = NULL;
-                }
-            }
+            delete[] header->pBuffer;
+            header->pBuffer = NULL;
+        }
+    }
 
-            if(header->pInputPortPrivate != NULL) {
-                delete (BufferCtrlStruct*)(header->pInputPortPrivate);
-                header->pInputPortPrivate = NULL;
-            }
+    delete platformPrivate;
+    header->pPlatformPrivate = NULL;
 
-            if(header->pOutputPortPrivate != NULL) {
-                delete (BufferCtrlStruct*)(header->pOutputPortPrivate);
-                header->pOutputPortPrivate = NULL;
-            }
+    if(header->pInputPortPrivate != NULL) {
+        delete (BufferCtrlStruct*)(header->pInputPortPrivate);
+        header->pInputPortPrivate = NULL;
+    }
 
-            delete header;
-            header = NULL;
+    if(header->pOutputPortPrivate != NULL) {
+        delete (BufferCtrlStruct*)(header->pOutputPortPrivate);
+        header->pOutputPortPrivate = NULL;
+    }
 
-            port->mBuffers.removeAt(i);
-            port->mDef.bPopulated = OMX_FALSE;
+    delete header;
+    header = NULL;
 
-            checkTransitions();
+    port->mBuffers.removeAt(index);
+    port->mDef.bPopulated = OMX_FALSE;
 
-            found = true;
-            break;
-        }
+    // Buffers behind the removed one moved down by one slot.
+    for (size_t i = index; i < port->mBuffers.size(); ++i) {
+        OMX_BUFFERHEADERTYPE *moved = port->mBuffers.itemAt(i).mHeader;
+        ((BufferPlatformPrivate *)moved->pPlatformPrivate)->mIndex = i;
     }
 
-    CHECK(found);
+    checkTransitions();
 
     return OMX_ErrorNone;
 }
 
 OMX_ERRORTYPE SprdSimpleOMXComponent::emptyThisBuffer(
     OMX_BUFFERHEADERTYPE *buffer) {
+    onInputBufferArrived(buffer);
+
+    if (mBufferRingEnabled) {
+        BufferRing::Entry entry;
+        entry.mKind = BufferRing::kEmptyBuffer;
+        entry.mHeader = buffer;
+        mClientRing.push(entry);
+        signalBufferDrain();
+        return OMX_ErrorNone;
+    }
+
     sp<AMessage> msg = new AMessage(kWhatEmptyThisBuffer, mHandler);
     msg->setPointer("header", buffer);
     msg->post();
@@ -350,6 +682,15 @@ OMX_ERRORTYPE SprdSimpleOMXComponent::emptyThisBuffer(
 
 OMX_ERRORTYPE SprdSimpleOMXComponent::fillThisBuffer(
     OMX_BUFFERHEADERTYPE *buffer) {
+    if (mBufferRingEnabled) {
+        BufferRing::Entry entry;
+        entry.mKind = BufferRing::kFillBuffer;
+        entry.mHeader = buffer;
+        mClientRing.push(entry);
+        signalBufferDrain();
+        return OMX_ErrorNone;
+    }
+
     sp<AMessage> msg = new AMessage(kWhatFillThisBuffer, mHandler);
     msg->setPointer("header", buffer);
     msg->post();
@@ -357,6 +698,24 @@ OMX_ERRORTYPE SprdSimpleOMXComponent::fillThisBuffer(
     return OMX_ErrorNone;
 }
 
+void SprdSimpleOMXComponent::signalBufferDrain() {
+    // Order the ring push before reading mDrainPending, pairing with the
+    // barrier in kWhatDrainBuffers, so a header is never left behind.
+    android_memory_barrier();
+
+    // Only the first push after the looper started draining posts a
+    // message, later ones ride along with it.
+    if (android_atomic_cmpxchg(0, 1, &mDrainPending) == 0) {
+        mDrainMsg->post();
+    }
+}
+
+void SprdSimpleOMXComponent::signalQueueFilled(OMX_U32 portIndex) {
+    sp<AMessage> msg = new AMessage(kWhatQueueFilled, mHandler);
+    msg->setInt32("port", portIndex);
+    msg->post();
+}
+
 OMX_ERRORTYPE SprdSimpleOMXComponent::getState(OMX_STATETYPE *state) {
     Mutex::Autolock autoLock(mLock);
 
@@ -375,6 +734,7 @@ void SprdSimpleOMXComponent::onMessageReceived(const sp<AMessage> &msg) {
         CHECK(msg->findInt32("cmd", &cmd));
         CHECK(msg->findInt32("param", &param));
 
+        waitForDecodeIdle();
         onSendCommand((OMX_COMMANDTYPE)cmd, (OMX_U32)param);
         break;
     }
@@ -384,80 +744,140 @@ void SprdSimpleOMXComponent::onMessageReceived(const sp<AMessage> &msg) {
         OMX_BUFFERHEADERTYPE *header;
         CHECK(msg->findPointer("header", (void **)&header));
 
-        CHECK(mState == OMX_StateExecuting && mTargetState == mState);
-
-        PortInfo *port = editPortInfo(kInputPortIndex);
-
-        bool found = false;
-
-        for (size_t j = 0; j < port->mBuffers.size(); ++j) {
-            BufferInfo *buffer = &port->mBuffers.editItemAt(j);
-
-            if (buffer->mHeader == header) {
-                CHECK(!buffer->mOwnedByUs);
+        onEmptyThisBuffer(header);
+        break;
+    }
 
-                buffer->mOwnedByUs = true;
+    case kWhatFillThisBuffer:
+    {
+        OMX_BUFFERHEADERTYPE *header;
+        CHECK(msg->findPointer("header", (void **)&header));
 
-                port->mQueue.push_back(buffer);
+        onFillThisBuffer(header);
+        break;
+    }
 
-                onDecodePrepare(buffer->mHeader);
+    case kWhatDrainBuffers:
+    {
+        // Clear the flag before looking at the rings: anything pushed
+        // after this point posts a new drain message.
+        android_atomic_release_store(0, &mDrainPending);
+        android_memory_barrier();
+
+        // In submission order, so an ETB/FTB never passes another one or
+        // a command.
+        BufferRing::Entry entry;
+        while (mClientRing.pop(&entry)) {
+            switch (entry.mKind) {
+            case BufferRing::kEmptyBuffer:
+                onEmptyThisBuffer(entry.mHeader);
+                break;
 
-                onQueueFilled(OMX_DirInput);
+            case BufferRing::kFillBuffer:
+                onFillThisBuffer(entry.mHeader);
+                break;
 
-                found = true;
+            case BufferRing::kCommand:
+                waitForDecodeIdle();
+                onSendCommand(entry.mCmd, entry.mParam);
                 break;
             }
         }
+        break;
+    }
+
+    case kWhatQueueFilled:
+    {
+        int32_t portIndex;
+        CHECK(msg->findInt32("port", &portIndex));
 
-        CHECK(found);
+        if (mState == OMX_StateExecuting && mTargetState == mState) {
+            queueFilled(portIndex);
+        }
         break;
     }
 
-    case kWhatFillThisBuffer:
+    case kWhatDeliverDone:
     {
-        OMX_BUFFERHEADERTYPE *header;
-        CHECK(msg->findPointer("header", (void **)&header));
+        int32_t generation;
+        CHECK(msg->findInt32("generation", &generation));
 
-        CHECK(mState == OMX_StateExecuting && mTargetState == mState);
+        Mutex::Autolock doneLock(mDoneLock);
+        if (generation == mDoneGeneration) {
+            deliverPendingDone();
+        }
+        break;
+    }
 
-        PortInfo *port = editPortInfo(kOutputPortIndex);
+    case kWhatFlushPacked:
+    {
+        int32_t generation;
+        CHECK(msg->findInt32("generation", &generation));
 
-        bool found = false;
+        waitForDecodeIdle();
+        if (generation == mOutputPacker.generation()) {
+            flushPackedOutput();
+        }
+        break;
+    }
 
-        for (size_t j = 0; j < port->mBuffers.size(); ++j) {
-            BufferInfo *buffer = &port->mBuffers.editItemAt(j);
+    default:
+        TRESPASS();
+        break;
+    }
+}
 
-            if (buffer->mHeader == header) {
-                CHECK(!buffer->mOwnedByUs);
+void SprdSimpleOMXComponent::onEmptyThisBuffer(OMX_BUFFERHEADERTYPE *header) {
+    CHECK(mState == OMX_StateExecuting && mTargetState == mState);
 
-                buffer->mOwnedByUs = true;
+    BufferInfo *buffer = findBufferInfo(kInputPortIndex, header);
+    CHECK(buffer != NULL);
+    CHECK(!buffer->mOwnedByUs);
 
-                BufferCtrlStruct *pBufCtrl = (BufferCtrlStruct *)(header->pOutputPortPrivate);
-                if(pBufCtrl != NULL && pBufCtrl->iRefCount > 0) {
-                    pBufCtrl->iRefCount--;
-                }
-                if(pBufCtrl != NULL)
-                    ALOGI("fillThisBuffer, buffer: 0x%p, header: 0x%p, iRefCount: %d",buffer, header,pBufCtrl->iRefCount);
+    buffer->mOwnedByUs = true;
+    buffer->mQueuedUs = SprdCodecMetrics::nowUs();
+
+    editPortInfo(kInputPortIndex)->mQueue.push_back(buffer);
 
-                mThreadLock.lock();
-                port->mQueue.push_back(buffer);
-                mThreadLock.unlock();
+    // The decode thread may be inside the engine, which onDecodePrepare()
+    // is free to use.
+    if (mDecodeThreadStarted) {
+        mDeferredPrepareBuffers.push_back(header);
+    } else {
+        onDecodePrepare(header);
+    }
 
-                onQueueFilled(OMX_DirOutput);
+    queueFilled(OMX_DirInput);
+}
 
-                found = true;
-                break;
-            }
-        }
+void SprdSimpleOMXComponent::onFillThisBuffer(OMX_BUFFERHEADERTYPE *header) {
+    CHECK(mState == OMX_StateExecuting && mTargetState == mState);
 
-        CHECK(found);
-        break;
+    if (mInHardware) {
+        // The engine callbacks own the output queue and the refcounts
+        // until the hardware section closes.
+        mDeferredFillBuffers.push_back(header);
+        return;
     }
 
-    default:
-        TRESPASS();
-        break;
+    BufferInfo *buffer = findBufferInfo(kOutputPortIndex, header);
+    CHECK(buffer != NULL);
+    CHECK(!buffer->mOwnedByUs);
+
+    buffer->mOwnedByUs = true;
+
+    BufferCtrlStruct *pBufCtrl = (BufferCtrlStruct *)(header->pOutputPortPrivate);
+    if(pBufCtrl != NULL && pBufCtrl->iRefCount > 0) {
+        pBufCtrl->iRefCount--;
     }
+    if(pBufCtrl != NULL)
+        SPRD_FRAME_LOGI("fillThisBuffer, buffer: 0x%p, header: 0x%p, iRefCount: %d",buffer, header,pBufCtrl->iRefCount);
+
+    mThreadLock.lock();
+    editPortInfo(kOutputPortIndex)->mQueue.push_back(buffer);
+    mThreadLock.unlock();
+
+    queueFilled(OMX_DirOutput);
 }
 
 void SprdSimpleOMXComponent::onSendCommand(
@@ -504,6 +924,11 @@ void SprdSimpleOMXComponent::onChangeState(OMX_STATETYPE state) {
             notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
             return;
         }
+        if (!admitVspSession())
+        {
+            notify(OMX_EventError, OMX_ErrorInsufficientResources, 0, NULL);
+            return;
+        }
         break;
     case OMX_StateIdle:
         if(state != OMX_StateLoaded && state != OMX_StateExecuting)
@@ -559,8 +984,14 @@ void SprdSimpleOMXComponent::onPortEnable(OMX_U32 portIndex, bool enable) {
         port->mDef.bEnabled = OMX_FALSE;
         port->mTransition = PortInfo::DISABLING;
 
+        if (portIndex == kInputPortIndex) {
+            mDeferredPrepareBuffers.clear();
+        }
+        onPortDisablePrepare(portIndex);
+
         if (portIndex == kOutputPortIndex) {
             mThreadLock.lock();
+            mOutputPacker.finishPending();
         }
 
         for (size_t i = 0; i < port->mBuffers.size(); ++i) {
@@ -590,6 +1021,14 @@ void SprdSimpleOMXComponent::onPortEnable(OMX_U32 portIndex, bool enable) {
 
     } else {
         port->mTransition = PortInfo::ENABLING;
+
+        if (mVspSessionId >= 0) {
+            // Port reconfiguration is where a resolution change lands.
+            int32_t width, height, fps;
+            getVspLoad(&width, &height, &fps);
+            SprdVspScheduler::getInstance()->updateSession(
+                    mVspSessionId, width, height, fps);
+        }
     }
 
     checkTransitions();
@@ -616,6 +1055,9 @@ void SprdSimpleOMXComponent::onPortFlush(
 
     if (portIndex == kOutputPortIndex) {
         mThreadLock.lock();
+        mOutputPacker.reset();
+    } else {
+        mDeferredPrepareBuffers.clear();
     }
 
     onPortFlushPrepare(portIndex);
@@ -721,6 +1163,7 @@ void SprdSimpleOMXComponent::checkTransitions() {
 
             if (mState == OMX_StateLoaded) {
                 onReset();
+                releaseVspSession();
             }
 
             notify(OMX_EventCmdComplete, OMX_CommandStateSet, mState, NULL);
@@ -762,24 +1205,334 @@ void SprdSimpleOMXComponent::addPort(const OMX_PARAM_PORTDEFINITIONTYPE &def) {
     info->mTransition = PortInfo::NONE;
 }
 
-void SprdSimpleOMXComponent:: ConvertFlexYUVToPlanar(
-        uint8_t *dst, size_t dstStride, size_t dstVStride,
-        struct android_ycbcr *ycbcr, int32_t width, int32_t height) {
-    const uint8_t *src = (const uint8_t *)ycbcr->y;
-    const uint8_t *srcU = (const uint8_t *)ycbcr->cb;
-    const uint8_t *srcV = (const uint8_t *)ycbcr->cr;
-    uint8_t *dstU = dst + dstVStride * dstStride;
-    uint8_t *dstV = dstU + (dstVStride >> 1) * (dstStride >> 1);
+SprdSimpleOMXComponent::BufferInfo *SprdSimpleOMXComponent::addBuffer(
+    OMX_U32 portIndex, OMX_BUFFERHEADERTYPE *header) {
+    PortInfo *port = editPortInfo(portIndex);
 
-    for (size_t y = height; y > 0; --y) {
+    port->mBuffers.push();
+
+    size_t index = port->mBuffers.size() - 1;
+    BufferInfo *buffer = &port->mBuffers.editItemAt(index);
+    buffer->mHeader = header;
+    buffer->mOwnedByUs = false;
+    buffer->mQueuePrev = NULL;
+    buffer->mQueueNext = NULL;
+    buffer->mQueued = false;
+    buffer->mQueuedUs = 0;
+
+    BufferPlatformPrivate *platformPrivate = new BufferPlatformPrivate;
+    platformPrivate->mPortIndex = portIndex;
+    platformPrivate->mIndex = index;
+    platformPrivate->mAllocation = NULL;
+    header->pPlatformPrivate = platformPrivate;
+
+    if (port->mBuffers.size() == port->mDef.nBufferCountActual) {
+        port->mDef.bPopulated = OMX_TRUE;
+        checkTransitions();
+    }
+
+    return buffer;
+}
+
+void SprdSimpleOMXComponent::notify(
+        OMX_EVENTTYPE event, OMX_U32 data1, OMX_U32 data2, OMX_PTR data) {
+    {
+        Mutex::Autolock doneLock(mDoneLock);
+        deliverPendingDone();
+
+        // Another thread may still be calling back buffers queued before
+        // this event.
+        while (mDelivering && !pthread_equal(mDeliveringThread, pthread_self())) {
+            mDoneCondition.wait(mDoneLock);
+        }
+    }
+
+    SprdOMXComponent::notify(event, data1, data2, data);
+}
+
+void SprdSimpleOMXComponent::notifyEmptyBufferDone(OMX_BUFFERHEADERTYPE *header) {
+    BufferInfo *buffer = findBufferInfo(kInputPortIndex, header);
+    if (buffer != NULL && buffer->mQueuedUs > 0) {
+        mMetrics.record(SprdCodecMetrics::kHistogramQueueWait,
+                SprdCodecMetrics::nowUs() - buffer->mQueuedUs);
+        buffer->mQueuedUs = 0;
+    }
+    mMetrics.count(SprdCodecMetrics::kCounterInputBuffers);
+
+    queueDone(header, false /* fill */);
+}
+
+void SprdSimpleOMXComponent::notifyFillBufferDone(OMX_BUFFERHEADERTYPE *header) {
+    if (header->nFilledLen > 0) {
+        mMetrics.count(SprdCodecMetrics::kCounterFrames);
+    }
+
+    queueDone(header, true /* fill */);
+}
+
+void SprdSimpleOMXComponent::queueDone(OMX_BUFFERHEADERTYPE *header, bool fill) {
+    Mutex::Autolock doneLock(mDoneLock);
+
+    DoneCallback callback;
+    callback.mHeader = header;
+    callback.mFill = fill;
+    mPendingDone.push_back(callback);
+
+    if (mBatchMaxBuffers <= 1
+            || mPendingDone.size() >= mBatchMaxBuffers
+            || (fill && (header->nFlags & OMX_BUFFERFLAG_EOS))) {
+        deliverPendingDone();
+    } else if (mPendingDone.size() == 1) {
+        sp<AMessage> msg = new AMessage(kWhatDeliverDone, mHandler);
+        msg->setInt32("generation", mDoneGeneration);
+        msg->post(mBatchLatencyUs);
+    }
+}
+
+// Called with mDoneLock held, which is dropped around the callbacks so a
+// client may call back into the component from them. Callbacks queued
+// while one thread delivers are delivered by that thread.
+void SprdSimpleOMXComponent::deliverPendingDone() {
+    if (mPendingDone.empty() || mDelivering) {
+        return;
+    }
+
+    mDelivering = true;
+    mDeliveringThread = pthread_self();
+    ++mDoneGeneration;
+
+    while (!mPendingDone.empty()) {
+        Vector<DoneCallback> callbacks = mPendingDone;
+        mPendingDone.clear();
+
+        mDoneLock.unlock();
+        for (size_t i = 0; i < callbacks.size(); ++i) {
+            const DoneCallback &callback = callbacks.itemAt(i);
+            if (callback.mFill) {
+                SprdOMXComponent::notifyFillBufferDone(callback.mHeader);
+            } else {
+                SprdOMXComponent::notifyEmptyBufferDone(callback.mHeader);
+            }
+        }
+        mDoneLock.lock();
+    }
+
+    mDelivering = false;
+    mDoneCondition.broadcast();
+}
+
+// Bounds how long a partly packed output buffer waits for more frames.
+void SprdSimpleOMXComponent::schedulePackedFlush() {
+    if (mOutputPacker.frameCount() == 0
+            || mPackedFlushGeneration == mOutputPacker.generation()) {
+        return;
+    }
+
+    int64_t latencyUs;
+    {
+        Mutex::Autolock doneLock(mDoneLock);
+        latencyUs = mBatchLatencyUs;
+    }
+
+    mPackedFlushGeneration = mOutputPacker.generation();
+    sp<AMessage> msg = new AMessage(kWhatFlushPacked, mHandler);
+    msg->setInt32("generation", mPackedFlushGeneration);
+    msg->post(latencyUs);
+}
+
+void SprdSimpleOMXComponent::flushPackedOutput() {
+    OMX_BUFFERHEADERTYPE *header = mOutputPacker.pending();
+    if (header == NULL || mOutputPacker.frameCount() == 0) {
+        return;
+    }
+
+    BufferInfo *buffer = findBufferInfo(kOutputPortIndex, header);
+    CHECK(buffer != NULL && buffer->mOwnedByUs);
+
+    mThreadLock.lock();
+    mOutputPacker.finish(header);
+    editPortInfo(kOutputPortIndex)->mQueue.erase(buffer);
+    buffer->mOwnedByUs = false;
+    mThreadLock.unlock();
+
+    notifyFillBufferDone(header);
+}
+
+void SprdSimpleOMXComponent::packOutputFrame(OMX_TICKS timeUs, OMX_U32 size, OMX_U32 flags) {
+    PortQueue &outQueue = getPortQueue(kOutputPortIndex);
+    CHECK(!outQueue.empty());
+    OMX_BUFFERHEADERTYPE *header = (*outQueue.begin())->mHeader;
+
+    if (mOutputPacker.append(header, timeUs, size, flags)
+            && !(flags & OMX_BUFFERFLAG_EOS)
+            && !mOutputPacker.isFull(header, mOutputPacker.largestFrame())) {
+        return;
+    }
+
+    flushPackedOutput();
+    placeSetAsideFrame();
+}
+
+bool SprdSimpleOMXComponent::placeSetAsideFrame() {
+    if (!mOutputPacker.hasSetAside()) {
+        return true;
+    }
+
+    PortQueue &outQueue = getPortQueue(kOutputPortIndex);
+    if (outQueue.empty()) {
+        return false;
+    }
+
+    OMX_BUFFERHEADERTYPE *header = (*outQueue.begin())->mHeader;
+    header->nTimeStamp = 0;
+    header->nFlags = 0;
+    header->nOffset = 0;
+    header->nFilledLen = 0;
+    OMX_U32 flags = mOutputPacker.placeSetAside(header);
+    if ((flags & OMX_BUFFERFLAG_EOS)
+            || mOutputPacker.isFull(header, mOutputPacker.largestFrame())) {
+        flushPackedOutput();
+    }
+    return true;
+}
+
+OMX_ERRORTYPE SprdSimpleOMXComponent::getConfig(
+        OMX_INDEXTYPE index, OMX_PTR params) {
+    if (index == (OMX_INDEXTYPE)OMX_IndexConfigCallbackBatching) {
+        SprdCallbackBatchingParams *batchingParams = (SprdCallbackBatchingParams *)params;
+        if (batchingParams->nSize < sizeof(SprdCallbackBatchingParams)) {
+            return OMX_ErrorBadParameter;
+        }
+
+        Mutex::Autolock doneLock(mDoneLock);
+        batchingParams->nMaxBuffers = mBatchMaxBuffers;
+        batchingParams->nMaxLatencyUs = mBatchLatencyUs;
+        return OMX_ErrorNone;
+    }
+
+    if (index != (OMX_INDEXTYPE)OMX_IndexConfigCodecMetrics) {
+        return SprdOMXComponent::getConfig(index, params);
+    }
+
+    SprdCodecMetricsParams *metricsParams = (SprdCodecMetricsParams *)params;
+    if (metricsParams->nSize < sizeof(SprdCodecMetricsParams)) {
+        return OMX_ErrorBadParameter;
+    }
+
+    SprdCodecMetrics::Snapshot snapshot;
+    mMetrics.snapshot(&snapshot);
+
+    for (size_t c = 0; c < SprdCodecMetrics::kNumCounters; ++c) {
+        metricsParams->nCounters[c] = snapshot.mCounters[c];
+    }
+    for (size_t h = 0; h < SprdCodecMetrics::kNumHistograms; ++h) {
+        const SprdCodecMetrics::HistogramSnapshot &histogram = snapshot.mHistograms[h];
+        metricsParams->nSamples[h] = histogram.mCount;
+        metricsParams->nAvgUs[h] = histogram.mCount ? histogram.mSumUs / histogram.mCount : 0;
+        metricsParams->nP50Us[h] = SprdCodecMetrics::percentileUs(histogram, 50);
+        metricsParams->nP95Us[h] = SprdCodecMetrics::percentileUs(histogram, 95);
+        metricsParams->nMaxUs[h] = histogram.mMaxUs;
+    }
+
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE SprdSimpleOMXComponent::setConfig(
+        OMX_INDEXTYPE index, const OMX_PTR params) {
+    if (index != (OMX_INDEXTYPE)OMX_IndexConfigCallbackBatching) {
+        return SprdOMXComponent::setConfig(index, params);
+    }
+
+    const SprdCallbackBatchingParams *batchingParams =
+        (const SprdCallbackBatchingParams *)params;
+    if (batchingParams->nSize < sizeof(SprdCallbackBatchingParams)) {
+        return OMX_ErrorBadParameter;
+    }
+
+    Mutex::Autolock doneLock(mDoneLock);
+    mBatchMaxBuffers = batchingParams->nMaxBuffers;
+    mBatchLatencyUs = batchingParams->nMaxLatencyUs;
+    if (mBatchMaxBuffers <= 1) {
+        deliverPendingDone();
+    }
+
+    return OMX_ErrorNone;
+}
+
+OMX_ERRORTYPE SprdSimpleOMXComponent::getExtensionIndex(
+        const char *name, OMX_INDEXTYPE *index) {
+    if (!strcmp(name, SPRD_INDEX_CONFIG_CODEC_METRICS)) {
+        *index = (OMX_INDEXTYPE)OMX_IndexConfigCodecMetrics;
+        return OMX_ErrorNone;
+    }
+    if (!strcmp(name, SPRD_INDEX_CONFIG_CALLBACK_BATCHING)) {
+        *index = (OMX_INDEXTYPE)OMX_IndexConfigCallbackBatching;
+        return OMX_ErrorNone;
+    }
+    if (mOutputPackingEnabled && !strcmp(name, SPRD_INDEX_PARAM_OUTPUT_PACKING)) {
+        *index = (OMX_INDEXTYPE)OMX_IndexParamOutputPacking;
+        return OMX_ErrorNone;
+    }
+    return SprdOMXComponent::getExtensionIndex(name, index);
+}
+
+SprdSimpleOMXComponent::BufferInfo *SprdSimpleOMXComponent::findBufferInfo(
+    OMX_U32 portIndex, OMX_BUFFERHEADERTYPE *header) {
+    if (header == NULL || header->pPlatformPrivate == NULL) {
+        return NULL;
+    }
+
+    const BufferPlatformPrivate *platformPrivate =
+        (const BufferPlatformPrivate *)header->pPlatformPrivate;
+    PortInfo *port = editPortInfo(portIndex);
+
+    if (platformPrivate->mPortIndex != portIndex
+            || platformPrivate->mIndex >= port->mBuffers.size()) {
+        return NULL;
+    }
+
+    BufferInfo *buffer = &port->mBuffers.editItemAt(platformPrivate->mIndex);
+    return buffer->mHeader == header ? buffer : NULL;
+}
+
+namespace {
+
+struct FlexYUVJob {
+    uint8_t *mDst;
+    size_t mDstStride;
+    size_t mDstVStride;
+    const struct android_ycbcr *mYCbCr;
+    int32_t mWidth;
+};
+
+}  // namespace
+
+// Rows [begin, end) of the luma plane and the chroma rows under them;
+// begin is even.
+static void ConvertFlexYUVStripe(void *cookie, int32_t begin, int32_t end) {
+    const FlexYUVJob *job = static_cast<const FlexYUVJob *>(cookie);
+    const struct android_ycbcr *ycbcr = job->mYCbCr;
+    size_t dstStride = job->mDstStride;
+    size_t width = job->mWidth;
+
+    const uint8_t *src = (const uint8_t *)ycbcr->y + begin * ycbcr->ystride;
+    uint8_t *dst = job->mDst + begin * dstStride;
+    for (int32_t y = begin; y < end; ++y) {
         memcpy(dst, src, width);
         dst += dstStride;
         src += ycbcr->ystride;
     }
 
+    int32_t chromaBegin = begin >> 1;
+    const uint8_t *srcU = (const uint8_t *)ycbcr->cb + chromaBegin * ycbcr->cstride;
+    const uint8_t *srcV = (const uint8_t *)ycbcr->cr + chromaBegin * ycbcr->cstride;
+    uint8_t *dstU = job->mDst + job->mDstVStride * dstStride + chromaBegin * (dstStride >> 1);
+    uint8_t *dstV = job->mDst + job->mDstVStride * dstStride
+            + (job->mDstVStride >> 1) * (dstStride >> 1) + chromaBegin * (dstStride >> 1);
+
     if (ycbcr->cstride == ycbcr->ystride >> 1 && ycbcr->chroma_step == 1) {
         // planar
-        for (size_t y = height >> 1; y > 0; --y) {
+        for (int32_t y = chromaBegin; y < (end >> 1); ++y) {
             memcpy(dstU, srcU, width >> 1);
             dstU += dstStride >> 1;
             srcU += ycbcr->cstride;
@@ -789,7 +1542,7 @@ void SprdSimpleOMXComponent:: ConvertFlexYUVToPlanar(
         }
     } else {
         // arbitrary
-        for (size_t y = height >> 1; y > 0; --y) {
+        for (int32_t y = chromaBegin; y < (end >> 1); ++y) {
             for (size_t x = width >> 1; x > 0; --x) {
                 *dstU++ = *srcU;
                 *dstV++ = *srcV;
@@ -804,6 +1557,22 @@ void SprdSimpleOMXComponent:: ConvertFlexYUVToPlanar(
     }
 }
 
+// static
+void SprdSimpleOMXComponent:: ConvertFlexYUVToPlanar(
+        uint8_t *dst, size_t dstStride, size_t dstVStride,
+        struct android_ycbcr *ycbcr, int32_t width, int32_t height) {
+    FlexYUVJob job;
+    job.mDst = dst;
+    job.mDstStride = dstStride;
+    job.mDstVStride = dstVStride;
+    job.mYCbCr = ycbcr;
+    job.mWidth = width;
+
+    // Stripes start on even rows so each one owns whole chroma rows.
+    SprdStripePool::getInstance()->run(
+            ConvertFlexYUVStripe, &job, height, width * 3, 2);
+}
+
 void SprdSimpleOMXComponent::onQueueFilled(OMX_U32 portIndex) {
 }
 
@@ -817,10 +1586,16 @@ void SprdSimpleOMXComponent::onPortEnableCompleted(
 void SprdSimpleOMXComponent::onPortFlushPrepare(OMX_U32 portIndex) {
 }
 
+void SprdSimpleOMXComponent::onPortDisablePrepare(OMX_U32 portIndex) {
+    if (portIndex == kInputPortIndex) {
+        onPortFlushPrepare(portIndex);
+    }
+}
+
 void SprdSimpleOMXComponent::drainOneOutputBuffer(OMX_S32 picId, OMX_PTR pBufferHeader, OMX_U64 pts) {
 }
 
-List<SprdSimpleOMXComponent::BufferInfo *> &
+SprdSimpleOMXComponent::PortQueue &
 SprdSimpleOMXComponent::getPortQueue(OMX_U32 portIndex) {
     CHECK_LT(portIndex, mPorts.size());
     return mPorts.editItemAt(portIndex).mQueue;
@@ -832,7 +1607,160 @@ SprdSimpleOMXComponent::PortInfo *SprdSimpleOMXComponent::editPortInfo(
     return &mPorts.editItemAt(portIndex);
 }
 
+unsigned long SprdSimpleOMXComponent::getInputStreamAddr(
+        const OMX_BUFFERHEADERTYPE *header) const {
+    BufferCtrlStruct *pBufCtrl = (BufferCtrlStruct *)header->pInputPortPrivate;
+    if (pBufCtrl == NULL || pBufCtrl->phyAddr == 0 || header->nOffset != 0) {
+        return 0;
+    }
+    return pBufCtrl->phyAddr;
+}
+
+void SprdSimpleOMXComponent::onInputBufferArrived(OMX_BUFFERHEADERTYPE *header) {
+}
+
 void SprdSimpleOMXComponent::onDecodePrepare(OMX_BUFFERHEADERTYPE *header) {
 }
 
+void SprdSimpleOMXComponent::BufferRing::push(const Entry &entry) {
+    if (!android_atomic_acquire_load(&mOverflowing) && pushRing(entry)) {
+        return;
+    }
+
+    // Only reachable with more than kCapacity entries in flight. Once
+    // overflowing, everything goes to the list until the consumer has
+    // emptied the ring and taken the list over.
+    Mutex::Autolock autoLock(mOverflowLock);
+    if (!mOverflowing) {
+        ALOGW("BufferRing full, overflowing");
+    }
+    mOverflow.push_back(entry);
+    android_atomic_release_store(1, &mOverflowing);
+}
+
+bool SprdSimpleOMXComponent::BufferRing::pop(Entry *entry) {
+    if (mTakenIndex < mTaken.size()) {
+        *entry = mTaken.itemAt(mTakenIndex++);
+        return true;
+    }
+
+    if (popRing(entry)) {
+        return true;
+    }
+
+    // Once the ring is empty, whatever overflowed comes next.
+    mTaken.clear();
+    mTakenIndex = 0;
+    {
+        Mutex::Autolock autoLock(mOverflowLock);
+        if (mOverflow.isEmpty()) {
+            return false;
+        }
+        // The ring may have filled up since it looked empty. Whatever is
+        // in it was pushed before the list, and nothing is pushed to it
+        // while the list is in use.
+        if (popRing(entry)) {
+            return true;
+        }
+        mTaken = mOverflow;
+        mOverflow.clear();
+        android_atomic_release_store(0, &mOverflowing);
+    }
+
+    *entry = mTaken.itemAt(mTakenIndex++);
+    return true;
+}
+
+bool SprdSimpleOMXComponent::BufferRing::pushRing(const Entry &entry) {
+    int32_t tail = mTail;
+    int32_t head = android_atomic_acquire_load(&mHead);
+
+    if ((uint32_t)tail - (uint32_t)head == kCapacity) {
+        return false;
+    }
+
+    mSlots[tail & (kCapacity - 1)] = entry;
+    android_atomic_release_store((int32_t)((uint32_t)tail + 1), &mTail);
+
+    return true;
+}
+
+bool SprdSimpleOMXComponent::BufferRing::popRing(Entry *entry) {
+    int32_t head = mHead;
+    int32_t tail = android_atomic_acquire_load(&mTail);
+
+    if (head == tail) {
+        return false;
+    }
+
+    *entry = mSlots[head & (kCapacity - 1)];
+    android_atomic_release_store((int32_t)((uint32_t)head + 1), &mHead);
+
+    return true;
+}
+
+void SprdSimpleOMXComponent::PortQueue::push_back(BufferInfo *info) {
+    CHECK(!info->mQueued);
+
+    info->mQueued = true;
+    info->mQueuePrev = mTail;
+    info->mQueueNext = NULL;
+
+    if (mTail != NULL) {
+        mTail->mQueueNext = info;
+    } else {
+        mHead = info;
+    }
+    mTail = info;
+    ++mSize;
+}
+
+SprdSimpleOMXComponent::PortQueue::iterator
+SprdSimpleOMXComponent::PortQueue::erase(iterator it) {
+    BufferInfo *info = *it;
+    iterator next(info->mQueueNext);
+
+    erase(info);
+
+    return next;
+}
+
+void SprdSimpleOMXComponent::PortQueue::erase(BufferInfo *info) {
+    CHECK(info->mQueued);
+
+    if (info->mQueuePrev != NULL) {
+        info->mQueuePrev->mQueueNext = info->mQueueNext;
+    } else {
+        mHead = info->mQueueNext;
+    }
+
+    if (info->mQueueNext != NULL) {
+        info->mQueueNext->mQueuePrev = info->mQueuePrev;
+    } else {
+        mTail = info->mQueuePrev;
+    }
+
+    info->mQueuePrev = NULL;
+    info->mQueueNext = NULL;
+    info->mQueued = false;
+    --mSize;
+}
+
+void SprdSimpleOMXComponent::PortQueue::clear() {
+    BufferInfo *info = mHead;
+
+    while (info != NULL) {
+        BufferInfo *next = info->mQueueNext;
+
+        info->mQueuePrev = NULL;
+        info->mQueueNext = NULL;
+        info->mQueued = false;
+        info = next;
+    }
+
+    mHead = NULL;
+    mTail = NULL;
+    mSize = 0;
+}
+
 }  // namespace android
@@ -0,0 +1,299 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdStripePool"
+#include <utils/Log.h>
+
+#include "include/SprdStripePool.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <cutils/properties.h>
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace android {
+
+// Memory one stripe should touch: small enough to stay in the L2 of the
+// core working on it, large enough that handing it out is cheap.
+static const size_t kStripeBytes = 256 * 1024;
+
+// Smaller passes run on the calling thread; waking the workers would cost
+// more than it saves.
+static const size_t kMinParallelBytes = 512 * 1024;
+
+// Granularity of copy().
+static const size_t kCopyChunk = 64 * 1024;
+
+// static
+SprdStripePool *SprdStripePool::getInstance() {
+    // Never destroyed: the workers run until the process exits.
+    static SprdStripePool *sInstance = new SprdStripePool;
+    return sInstance;
+}
+
+SprdStripePool::SprdStripePool()
+    : mThreadCount(1),
+      mWorkers(0),
+      mExit(false) {
+    char value[PROPERTY_VALUE_MAX];
+    property_get("vendor.omx.stripe_threads", value, "");
+    int32_t count = value[0] ? atoi(value) : (int32_t)sysconf(_SC_NPROCESSORS_ONLN);
+
+    startWorkers(count);
+    ALOGI("%d stripe threads", mThreadCount);
+}
+
+SprdStripePool::SprdStripePool(int32_t threadCount)
+    : mThreadCount(1),
+      mWorkers(0),
+      mExit(false) {
+    startWorkers(threadCount);
+}
+
+SprdStripePool::~SprdStripePool() {
+    Mutex::Autolock autoLock(mLock);
+    mExit = true;
+    mWorkCondition.broadcast();
+    while (mWorkers > 0) {
+        mExitCondition.wait(mLock);
+    }
+}
+
+void SprdStripePool::startWorkers(int32_t threadCount) {
+    if (threadCount < 1) {
+        threadCount = 1;
+    } else if (threadCount > kMaxThreads) {
+        threadCount = kMaxThreads;
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    Mutex::Autolock autoLock(mLock);
+    for (int32_t i = 1; i < threadCount; ++i) {
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, WorkerWrapper, this) != 0) {
+            ALOGW("unable to start stripe thread %d", i);
+            break;
+        }
+        mWorkers++;
+    }
+    mThreadCount = mWorkers + 1;
+
+    pthread_attr_destroy(&attr);
+}
+
+// static
+void *SprdStripePool::WorkerWrapper(void *me) {
+    static_cast<SprdStripePool *>(me)->workerLoop();
+    return NULL;
+}
+
+void SprdStripePool::workerLoop() {
+    char value[PROPERTY_VALUE_MAX];
+    property_get("vendor.omx.stripe_cpus", value, "");
+    unsigned long mask = value[0] ? strtoul(value, NULL, 16) : 0;
+    if (mask != 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (size_t cpu = 0; cpu < sizeof(mask) * 8 && cpu < CPU_SETSIZE; ++cpu) {
+            if (mask & (1ul << cpu)) {
+                CPU_SET(cpu, &set);
+            }
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            ALOGW("unable to set affinity 0x%lx: %s", mask, strerror(errno));
+        }
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    for (;;) {
+        while (mJobs.empty() && !mExit) {
+            mWorkCondition.wait(mLock);
+        }
+        if (mJobs.empty()) {
+            if (--mWorkers == 0) {
+                mExitCondition.signal();
+            }
+            return;
+        }
+
+        Job *job = *mJobs.begin();
+        int32_t begin, end;
+        CHECK(takeStripeLocked(job, &begin, &end));
+        runStripe(job, begin, end);
+    }
+}
+
+bool SprdStripePool::takeStripeLocked(Job *job, int32_t *begin, int32_t *end) {
+    if (job->mNext >= job->mRows) {
+        return false;
+    }
+
+    *begin = job->mNext;
+    *end = job->mNext + job->mStripeRows;
+    if (*end >= job->mRows) {
+        *end = job->mRows;
+        // Nothing left to hand out; the job only waits for its stripes.
+        for (List<Job *>::iterator it = mJobs.begin(); it != mJobs.end(); ++it) {
+            if (*it == job) {
+                mJobs.erase(it);
+                break;
+            }
+        }
+    }
+    job->mNext = *end;
+    return true;
+}
+
+// Called and returns with mLock held.
+void SprdStripePool::runStripe(Job *job, int32_t begin, int32_t end) {
+    mLock.unlock();
+    (*job->mFunc)(job->mCookie, begin, end);
+    mLock.lock();
+
+    if (--job->mPending == 0) {
+        job->mDone.signal();
+    }
+}
+
+void SprdStripePool::run(
+        StripeFunc func, void *cookie, int32_t rows, size_t rowBytes, int32_t align) {
+    if (rows <= 0) {
+        return;
+    }
+    if (align < 1) {
+        align = 1;
+    }
+
+    if (mThreadCount <= 1 || rows <= align || (size_t)rows * rowBytes < kMinParallelBytes) {
+        (*func)(cookie, 0, rows);
+        return;
+    }
+
+    int32_t stripeRows = rowBytes > 0 ? kStripeBytes / rowBytes : rows;
+    // At least one stripe per thread.
+    int32_t fairShare = (rows + mThreadCount - 1) / mThreadCount;
+    if (stripeRows > fairShare) {
+        stripeRows = fairShare;
+    }
+    stripeRows = (stripeRows + align - 1) / align * align;
+    if (stripeRows < align) {
+        stripeRows = align;
+    }
+
+    Job job;
+    job.mFunc = func;
+    job.mCookie = cookie;
+    job.mRows = rows;
+    job.mStripeRows = stripeRows;
+    job.mNext = 0;
+    job.mPending = (rows + stripeRows - 1) / stripeRows;
+
+    Mutex::Autolock autoLock(mLock);
+    mJobs.push_back(&job);
+    mWorkCondition.broadcast();
+
+    // The caller works on its own job, so it finishes even if every
+    // worker is busy with somebody else's.
+    int32_t begin, end;
+    while (takeStripeLocked(&job, &begin, &end)) {
+        runStripe(&job, begin, end);
+    }
+    while (job.mPending > 0) {
+        job.mDone.wait(mLock);
+    }
+}
+
+// static
+void SprdStripePool::Run(void *pool, StripeFunc func, void *cookie,
+        int32_t rows, size_t rowBytes, int32_t align) {
+    static_cast<SprdStripePool *>(pool)->run(func, cookie, rows, rowBytes, align);
+}
+
+namespace {
+
+struct CopyJob {
+    uint8_t *mDst;
+    const uint8_t *mSrc;
+    size_t mSize;
+};
+
+struct PadJob {
+    uint8_t *mDst;
+    size_t mDstWidth;
+    const uint8_t *mSrc;
+    size_t mWidth;
+    size_t mUnit;
+};
+
+}  // namespace
+
+static void CopyStripe(void *cookie, int32_t begin, int32_t end) {
+    const CopyJob *job = static_cast<const CopyJob *>(cookie);
+    size_t offset = begin * kCopyChunk;
+    size_t size = end * kCopyChunk;
+    if (size > job->mSize) {
+        size = job->mSize;
+    }
+    memcpy(job->mDst + offset, job->mSrc + offset, size - offset);
+}
+
+static void PadStripe(void *cookie, int32_t begin, int32_t end) {
+    const PadJob *job = static_cast<const PadJob *>(cookie);
+    for (int32_t y = begin; y < end; ++y) {
+        uint8_t *dst = job->mDst + y * job->mDstWidth;
+        memcpy(dst, job->mSrc + y * job->mWidth, job->mWidth);
+
+        const uint8_t *last = dst + job->mWidth - job->mUnit;
+        if (job->mUnit == 1) {
+            memset(dst + job->mWidth, *last, job->mDstWidth - job->mWidth);
+            continue;
+        }
+        for (size_t x = job->mWidth; x + job->mUnit <= job->mDstWidth; x += job->mUnit) {
+            memcpy(dst + x, last, job->mUnit);
+        }
+    }
+}
+
+void SprdStripePool::copy(void *dst, const void *src, size_t size) {
+    CopyJob job;
+    job.mDst = static_cast<uint8_t *>(dst);
+    job.mSrc = static_cast<const uint8_t *>(src);
+    job.mSize = size;
+    run(CopyStripe, &job, (size + kCopyChunk - 1) / kCopyChunk, 2 * kCopyChunk);
+}
+
+void SprdStripePool::copyPadded(uint8_t *dst, size_t dstWidth, const uint8_t *src,
+        size_t width, int32_t rows, size_t unit) {
+    CHECK(width >= unit && width <= dstWidth);
+
+    PadJob job;
+    job.mDst = dst;
+    job.mDstWidth = dstWidth;
+    job.mSrc = src;
+    job.mWidth = width;
+    job.mUnit = unit;
+    run(PadStripe, &job, rows, width + dstWidth);
+}
+
+}  // namespace android
@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdVspScheduler"
+#include <utils/Log.h>
+
+#include "include/SprdVspScheduler.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <cutils/properties.h>
+#include <utils/Timers.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace android {
+
+// Assumed when a port does not advertise a frame rate.
+static const int32_t kDefaultFps = 30;
+
+static int64_t nowUs() {
+    return systemTime(SYSTEM_TIME_MONOTONIC) / 1000ll;
+}
+
+// static
+SprdVspScheduler *SprdVspScheduler::getInstance() {
+    static SprdVspScheduler sInstance;
+    return &sInstance;
+}
+
+SprdVspScheduler::SprdVspScheduler()
+    : mNextSessionId(0),
+      mBudget(0),
+      mAgingJobs(0),
+      mSharedCore(false) {
+    for (size_t i = 0; i < kNumCores; ++i) {
+        mEngineOwner[i] = -1;
+    }
+
+    // What the cores sustain depends on the VSP generation and its clock,
+    // so admission control stays off unless the platform sets a budget.
+    char value[PROPERTY_VALUE_MAX];
+    property_get("vendor.vsp.mb_budget", value, "0");
+    mBudget = atoll(value);
+
+    property_get("vendor.vsp.aging_jobs", value, "4");
+    mAgingJobs = atoi(value);
+
+    property_get("vendor.vsp.shared_core", value, "false");
+    mSharedCore = !strcmp(value, "true");
+
+    ALOGI("VSP budget %lld MB/s, aging after %d jobs, %s core", (long long)mBudget,
+            mAgingJobs, mSharedCore ? "shared" : "decoder/encoder");
+}
+
+// static
+int64_t SprdVspScheduler::computeMbPerSec(int32_t width, int32_t height, int32_t fps) {
+    if (fps <= 0) {
+        fps = kDefaultFps;
+    }
+    int64_t mbs = (int64_t)((width + 15) / 16) * ((height + 15) / 16);
+    return mbs * fps;
+}
+
+int64_t SprdVspScheduler::loadLocked() const {
+    int64_t load = 0;
+    for (size_t i = 0; i < mSessions.size(); ++i) {
+        const Session &session = mSessions.valueAt(i);
+        if (session.mPriority != kPriorityBackground) {
+            load += session.mMbPerSec;
+        }
+    }
+    return load;
+}
+
+int64_t SprdVspScheduler::load() const {
+    Mutex::Autolock autoLock(mLock);
+    return loadLocked();
+}
+
+int64_t SprdVspScheduler::budget() const {
+    Mutex::Autolock autoLock(mLock);
+    return mBudget;
+}
+
+void SprdVspScheduler::setBudget(int64_t budget) {
+    Mutex::Autolock autoLock(mLock);
+    mBudget = budget;
+}
+
+int32_t SprdVspScheduler::agingJobs() const {
+    Mutex::Autolock autoLock(mLock);
+    return mAgingJobs;
+}
+
+void SprdVspScheduler::setAgingJobs(int32_t jobs) {
+    Mutex::Autolock autoLock(mLock);
+    mAgingJobs = jobs;
+    mCondition.broadcast();
+}
+
+status_t SprdVspScheduler::registerSession(
+        const char *name, Core core, int32_t width, int32_t height, int32_t fps,
+        Priority priority, int32_t *sessionId) {
+    Mutex::Autolock autoLock(mLock);
+
+    Session session;
+    session.mName = name;
+    session.mCore = mSharedCore ? kCoreDecoder : core;
+    session.mMbPerSec = computeMbPerSec(width, height, fps);
+    session.mPeriodUs = 1000000ll / (fps > 0 ? fps : kDefaultFps);
+    session.mPriority = priority;
+    session.mDeadlineUs = 0;
+    session.mSubmitUs = 0;
+    session.mWaiting = false;
+    session.mPassedOver = 0;
+    session.mJobs = 0;
+    session.mEngineTimeUs = 0;
+    session.mMaxEngineTimeUs = 0;
+
+    int64_t load = loadLocked();
+    if (mBudget > 0 && priority != kPriorityBackground
+            && load + session.mMbPerSec > mBudget) {
+        ALOGW("rejecting %s %dx%d@%d: %lld + %lld MB/s exceeds budget %lld",
+                name, width, height, fps, (long long)load,
+                (long long)session.mMbPerSec, (long long)mBudget);
+        return INVALID_OPERATION;
+    }
+
+    *sessionId = mNextSessionId++;
+    mSessions.add(*sessionId, session);
+
+    ALOGI("admitted %s %dx%d@%d priority %d core %d as session %d, load %lld/%lld MB/s",
+            name, width, height, fps, priority, session.mCore, *sessionId,
+            (long long)(load + session.mMbPerSec), (long long)mBudget);
+    return OK;
+}
+
+void SprdVspScheduler::unregisterSession(int32_t sessionId) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mSessions.indexOfKey(sessionId);
+    if (index < 0) {
+        return;
+    }
+
+    const Session &session = mSessions.valueAt(index);
+    CHECK(!session.mWaiting);
+    CHECK_NE(mEngineOwner[session.mCore], sessionId);
+
+    ALOGI("session %d (%s) done: %lld jobs, engine time avg %lld us max %lld us",
+            sessionId, session.mName.c_str(), (long long)session.mJobs,
+            (long long)(session.mJobs ? session.mEngineTimeUs / session.mJobs : 0),
+            (long long)session.mMaxEngineTimeUs);
+
+    mSessions.removeItemsAt(index);
+    mCondition.broadcast();
+}
+
+void SprdVspScheduler::updateSession(
+        int32_t sessionId, int32_t width, int32_t height, int32_t fps) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mSessions.indexOfKey(sessionId);
+    if (index < 0) {
+        return;
+    }
+
+    Session &session = mSessions.editValueAt(index);
+    session.mMbPerSec = computeMbPerSec(width, height, fps);
+    session.mPeriodUs = 1000000ll / (fps > 0 ? fps : kDefaultFps);
+
+    int64_t load = loadLocked();
+    if (mBudget > 0 && load > mBudget) {
+        ALOGW("session %d (%s) now %dx%d@%d, VSP overcommitted: %lld/%lld MB/s",
+                sessionId, session.mName.c_str(), width, height, fps,
+                (long long)load, (long long)mBudget);
+    }
+}
+
+void SprdVspScheduler::setPriority(int32_t sessionId, Priority priority) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mSessions.indexOfKey(sessionId);
+    if (index < 0) {
+        return;
+    }
+
+    mSessions.editValueAt(index).mPriority = priority;
+    mCondition.broadcast();
+}
+
+int32_t SprdVspScheduler::effectivePriorityLocked(const Session &session) const {
+    int32_t priority = session.mPriority;
+    if (mAgingJobs > 0) {
+        priority += session.mPassedOver / mAgingJobs;
+    }
+    return priority < kPriorityRealtime ? priority : kPriorityRealtime;
+}
+
+// Only depends on state changed under mLock, never on the time, so all
+// waiters agree on who is next.
+bool SprdVspScheduler::isNextLocked(int32_t sessionId) const {
+    const Session &self = mSessions.valueFor(sessionId);
+    int32_t selfPriority = effectivePriorityLocked(self);
+
+    for (size_t i = 0; i < mSessions.size(); ++i) {
+        const Session &other = mSessions.valueAt(i);
+        if (!other.mWaiting || other.mCore != self.mCore
+                || mSessions.keyAt(i) == sessionId) {
+            continue;
+        }
+        int32_t otherPriority = effectivePriorityLocked(other);
+        if (otherPriority != selfPriority) {
+            if (otherPriority > selfPriority) {
+                return false;
+            }
+            continue;
+        }
+        if (other.mDeadlineUs < self.mDeadlineUs
+                || (other.mDeadlineUs == self.mDeadlineUs
+                        && mSessions.keyAt(i) < sessionId)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SprdVspScheduler::acquireEngine(int32_t sessionId) {
+    Mutex::Autolock autoLock(mLock);
+
+    ssize_t index = mSessions.indexOfKey(sessionId);
+    CHECK_GE(index, 0);
+
+    int64_t now = nowUs();
+    Core core;
+    {
+        Session &session = mSessions.editValueAt(index);
+        core = session.mCore;
+        // One frame period after the previous job, but a session that fell
+        // behind does not get to bank its missed deadlines.
+        int64_t deadline = session.mDeadlineUs + session.mPeriodUs;
+        session.mDeadlineUs = deadline > now ? deadline : now;
+        session.mWaiting = true;
+        session.mPassedOver = 0;
+    }
+
+    while (mEngineOwner[core] >= 0 || !isNextLocked(sessionId)) {
+        mCondition.wait(mLock);
+    }
+
+    for (size_t i = 0; i < mSessions.size(); ++i) {
+        Session &other = mSessions.editValueAt(i);
+        if (other.mWaiting && other.mCore == core && mSessions.keyAt(i) != sessionId) {
+            other.mPassedOver++;
+        }
+    }
+
+    Session &session = mSessions.editValueFor(sessionId);
+    session.mWaiting = false;
+    session.mPassedOver = 0;
+    session.mSubmitUs = nowUs();
+    mEngineOwner[core] = sessionId;
+
+    ALOGV("session %d got the engine after %lld us", sessionId,
+            (long long)(session.mSubmitUs - now));
+}
+
+void SprdVspScheduler::releaseEngine(int32_t sessionId) {
+    Mutex::Autolock autoLock(mLock);
+
+    Session &session = mSessions.editValueFor(sessionId);
+    CHECK_EQ(mEngineOwner[session.mCore], sessionId);
+    mEngineOwner[session.mCore] = -1;
+
+    int64_t engineTimeUs = nowUs() - session.mSubmitUs;
+    session.mJobs++;
+    session.mEngineTimeUs += engineTimeUs;
+    if (engineTimeUs > session.mMaxEngineTimeUs) {
+        session.mMaxEngineTimeUs = engineTimeUs;
+    }
+    if (engineTimeUs > session.mPeriodUs) {
+        ALOGV("session %d (%s) engine call took %lld us, period %lld us",
+                sessionId, session.mName.c_str(), (long long)engineTimeUs,
+                (long long)session.mPeriodUs);
+    }
+
+    mCondition.broadcast();
+}
+
+}  // namespace android
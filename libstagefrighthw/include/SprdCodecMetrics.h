@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPRD_CODEC_METRICS_H_
+
+#define SPRD_CODEC_METRICS_H_
+
+#include <stdio.h>
+
+#include <OMX_Types.h>
+#include <OMX_Core.h>
+
+#include <cutils/compiler.h>
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/threads.h>
+
+namespace android {
+
+// Per-frame log lines of a SprdSimpleOMXComponent. The arguments are not
+// even evaluated unless vendor.omx.verbose was "true" when the component
+// was created.
+#define SPRD_FRAME_LOGI(...)                                \
+    do {                                                    \
+        if (CC_UNLIKELY(mMetrics.verbose())) {              \
+            ALOGI(__VA_ARGS__);                             \
+        }                                                   \
+    } while (0)
+
+// Counters and latency histograms of one component instance. Every thread
+// that records into it claims a shard of its own on first use, so the
+// frame path never takes a lock; readers add the shards up and may miss a
+// frame that is being recorded at that moment. Shards of threads that
+// have exited are handed on to new ones. Should more threads record at
+// once than there are shards, the extra ones share an overflow shard
+// under a lock.
+//
+// With vendor.omx.metrics.trace set to "true", every sample is also
+// appended to a binary trace in /data/misc/media (see TraceEvent).
+struct SprdCodecMetrics {
+    enum Counter {
+        kCounterInputBuffers,   // input buffers returned to the client
+        kCounterFrames,         // output buffers returned with data
+        kCounterCopyBytes,      // bitstream/picture bytes copied by the CPU
+        kCounterIovaMaps,       // IOMMU mappings created on the frame path
+        kCounterSwFallbacks,    // switches from the engine to a software codec
+        kCounterErrors,         // frames the codec returned an error for
+        kNumCounters,
+    };
+
+    enum Histogram {
+        kHistogramEngineTime,   // one engine call
+        kHistogramEngineWait,   // waiting for the VSP scheduler
+        kHistogramQueueWait,    // input buffer held by the component
+        kNumHistograms,
+    };
+
+    enum {
+        // Bucket i holds samples in [2^(i-1), 2^i) us, the last one is
+        // open ended.
+        kNumBuckets = 24,
+        kMaxShards = 4,
+        kTraceEventsPerShard = 128,
+    };
+
+    struct HistogramSnapshot {
+        int64_t mCount;
+        int64_t mSumUs;
+        int64_t mMaxUs;
+        int64_t mBuckets[kNumBuckets];
+    };
+
+    struct Snapshot {
+        int64_t mCounters[kNumCounters];
+        HistogramSnapshot mHistograms[kNumHistograms];
+    };
+
+    // Record of the binary trace. The file starts with the 8 byte magic
+    // "SPRDTRC1" and the 64 byte NUL padded component name.
+    struct TraceEvent {
+        int64_t mTimeUs;        // CLOCK_MONOTONIC
+        int32_t mThread;
+        int16_t mKind;          // 0: counter, 1: histogram
+        int16_t mId;            // Counter or Histogram
+        int64_t mValue;         // delta or microseconds
+    };
+
+    explicit SprdCodecMetrics(const char *name);
+    ~SprdCodecMetrics();
+
+    void count(Counter counter, int64_t delta = 1);
+    void record(Histogram histogram, int64_t us);
+
+    // Last sample the calling thread recorded, 0 if none.
+    int64_t lastUs(Histogram histogram);
+
+    void snapshot(Snapshot *snapshot) const;
+
+    // Upper bound of the bucket holding the given percentile.
+    static int64_t percentileUs(const HistogramSnapshot &histogram, int percent);
+
+    // Writes a one line summary per histogram to the log.
+    void dump() const;
+
+    static int64_t nowUs();
+
+    bool verbose() const { return mVerbose; }
+
+private:
+    struct Shard {
+        volatile int32_t mOwner; // tid, 0 while free
+        int64_t mCounters[kNumCounters];
+        int64_t mCount[kNumHistograms];
+        int64_t mSumUs[kNumHistograms];
+        int64_t mMaxUs[kNumHistograms];
+        int64_t mLastUs[kNumHistograms];
+        int64_t mBuckets[kNumHistograms][kNumBuckets];
+
+        TraceEvent *mTrace; // NULL unless tracing
+        size_t mTraceCount;
+    };
+
+    AString mName;
+    bool mVerbose;
+    Shard mShards[kMaxShards];
+    FILE *mTraceFile;
+
+    // Taken by threads that found no shard of their own.
+    mutable Mutex mOverflowLock;
+    Shard mOverflow;
+
+    Shard *getShard();
+    static void countIn(Shard *shard, Counter counter, int64_t delta);
+    static void recordIn(Shard *shard, Histogram histogram, int64_t us);
+    void trace(Shard *shard, int16_t kind, int16_t id, int64_t value);
+    void flushTrace(Shard *shard);
+
+    DISALLOW_EVIL_CONSTRUCTORS(SprdCodecMetrics);
+};
+
+// Payload of OMX_IndexConfigCodecMetrics. Latencies are in microseconds,
+// the percentiles are bucket bounds and only accurate to a factor of two.
+struct SprdCodecMetricsParams {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_S64 nCounters[SprdCodecMetrics::kNumCounters];
+    OMX_S64 nSamples[SprdCodecMetrics::kNumHistograms];
+    OMX_S64 nAvgUs[SprdCodecMetrics::kNumHistograms];
+    OMX_S64 nP50Us[SprdCodecMetrics::kNumHistograms];
+    OMX_S64 nP95Us[SprdCodecMetrics::kNumHistograms];
+    OMX_S64 nMaxUs[SprdCodecMetrics::kNumHistograms];
+};
+
+}  // namespace android
+
+#endif  // SPRD_CODEC_METRICS_H_
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPRD_DUMP_WRITER_H_
+
+#define SPRD_DUMP_WRITER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+#include <pthread.h>
+#include <stdio.h>
+
+namespace android {
+
+// Writes the YUV and bitstream dumps of a component on a thread of its
+// own. write() copies the data into a reusable unit and hands it over
+// through a lock-free ring, so the codec thread never touches the file
+// system; when the writer falls behind, units are dropped and counted
+// rather than stalling the codec.
+//
+// Shared by all dumps of the process:
+//   vendor.omx.dump.every        keep every Nth unit (default 1)
+//   vendor.omx.dump.start_ms     skip units for this long after creation
+//   vendor.omx.dump.duration_ms  then keep units for this long (0: no end)
+//   vendor.omx.dump.max_mb       rotate files at this size (0: no cap)
+//   vendor.omx.dump.files        number of files rotated through (default 2)
+//   vendor.omx.dump.queue_mb     memory for queued units (default 64)
+struct SprdDumpWriter {
+    enum {
+        // Parameter sets: never sampled out, and repeated at the head of
+        // every rotated file so that each one decodes on its own.
+        kFlagCodecConfig = 1,
+    };
+
+    explicit SprdDumpWriter(const char *path);
+
+    // Writes out whatever is still queued.
+    ~SprdDumpWriter();
+
+    void write(const void *data, size_t size, uint32_t flags = 0) {
+        write(NULL, 0, data, size, flags);
+    }
+
+    // Queues prefix and data as one unit, e.g. an IVF frame header and the
+    // frame, so that sampling keeps or drops them together.
+    void write(const void *prefix, size_t prefixSize,
+            const void *data, size_t size, uint32_t flags = 0);
+
+private:
+    enum {
+        kNumUnits = 8,  // power of two
+    };
+
+    struct Unit {
+        uint8_t *mData;
+        size_t mSize;
+        size_t mCapacity;
+        uint32_t mFlags;
+    };
+
+    // Single producer, single consumer, like SprdSimpleOMXComponent's.
+    struct UnitRing {
+        UnitRing() : mHead(0), mTail(0) {}
+
+        bool push(Unit *unit);
+        bool pop(Unit **unit);
+
+    private:
+        volatile int32_t mHead; // written by the consumer
+        volatile int32_t mTail; // written by the producer
+        Unit *mSlots[kNumUnits];
+    };
+
+    AString mPath;
+
+    int32_t mEvery;
+    int64_t mStartUs;
+    int64_t mEndUs;         // 0: no end
+    size_t mMaxFileBytes;   // 0: no cap
+    int32_t mMaxFiles;
+    size_t mMaxQueueBytes;
+
+    // Producer side.
+    Unit mUnits[kNumUnits];
+    UnitRing mQueued;       // codec thread -> writer
+    UnitRing mFree;         // writer -> codec thread
+    Unit *mIdle[kNumUnits]; // taken from mFree, not queued yet
+    int32_t mIdleCount;
+    int64_t mCreatedUs;
+    int64_t mCount;         // non-config units offered to write()
+    int64_t mDropped;
+    size_t mAllocated;
+
+    // Writer side.
+    FILE *mFile;
+    int32_t mFileIndex;
+    size_t mFileBytes;
+    int64_t mWrittenBytes;
+    bool mLastWasConfig;
+    Vector<uint8_t> mConfig; // latest parameter sets
+
+    Mutex mLock;
+    Condition mCondition;
+    bool mDone;
+    bool mThreadStarted;
+    pthread_t mThread;
+
+    bool keep(uint32_t flags);
+    Unit *takeUnit(size_t size);
+
+    static void *ThreadWrapper(void *me);
+    void threadLoop();
+    void drain();
+    void writeUnit(const Unit *unit);
+    bool openFile(int32_t index);
+
+    DISALLOW_EVIL_CONSTRUCTORS(SprdDumpWriter);
+};
+
+}  // namespace android
+
+#endif  // SPRD_DUMP_WRITER_H_
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPRD_ENCODER_INPUT_RING_H_
+
+#define SPRD_ENCODER_INPUT_RING_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/List.h>
+#include <utils/threads.h>
+
+#include <OMX_Core.h>
+#include <pthread.h>
+
+namespace android {
+
+// Staging slots for the input frames of a hardware encoder, plus a thread
+// that prepares them (mapping, colour conversion, copies into the engine
+// buffer) ahead of time. While the engine encodes the frame in one slot,
+// the next inputs are prepared into the others as soon as the client
+// queues them, so a frame costs about max(preparation, encode) instead of
+// their sum.
+//
+// The component owns the memory of the slots; the ring only decides which
+// slot holds which buffer header and who may touch it. A slot is touched
+// by one thread at a time: the ring thread while it is being prepared,
+// the component from acquire() to release().
+//
+// vendor.omx.enc_input_slots sets the number of slots (default 2). With a
+// single slot no thread is started and every frame is prepared in
+// acquire(), as before.
+struct SprdEncoderInputRing {
+    // Prepares the frame in header into slot. Returns false if the frame
+    // cannot be encoded.
+    typedef bool (*PrepareFunc)(void *cookie, OMX_BUFFERHEADERTYPE *header, int32_t slot);
+
+    enum {
+        kMaxSlots = 4,
+    };
+
+    SprdEncoderInputRing(const char *name, PrepareFunc prepare, void *cookie);
+    ~SprdEncoderInputRing();
+
+    int32_t slotCount() const { return mSlotCount; }
+
+    // Returns the slot holding the prepared frame of header, preparing it
+    // on the calling thread if nobody has started yet, or -1 if the frame
+    // could not be prepared.
+    int32_t acquire(OMX_BUFFERHEADERTYPE *header);
+
+    // Hands the slot back once the engine is done reading it.
+    void release(int32_t slot);
+
+    // Queues header for preparation on the ring thread. Returns false if
+    // every slot is taken or the ring is not open. Safe to call from any
+    // thread, e.g. the client's in emptyThisBuffer().
+    bool prefetch(OMX_BUFFERHEADERTYPE *header);
+
+    // Allows prefetch() until the next discard(). Called from
+    // onQueueFilled() once the encoder is set up.
+    void open();
+
+    // Waits until nothing is queued or being prepared.
+    void waitIdle();
+
+    // Closes the ring and forgets every prepared frame. Must be called
+    // before the input buffers go back to the client on a flush, port
+    // disable or reset, so the ring no longer reads them.
+    void discard();
+
+private:
+    enum State {
+        kFree,
+        kQueued,
+        kPreparing,
+        kReady,
+        kFailed,
+        kAcquired,
+    };
+
+    struct Slot {
+        OMX_BUFFERHEADERTYPE *mHeader;
+        State mState;
+    };
+
+    AString mName;
+    PrepareFunc mPrepare;
+    void *mCookie;
+    int32_t mSlotCount;
+
+    Mutex mLock;
+    Condition mWorkCondition;
+    Condition mDoneCondition;
+    Slot mSlots[kMaxSlots];
+    List<int32_t> mQueue;   // slots waiting for the ring thread, oldest first
+
+    pthread_t mThread;
+    bool mThreadStarted;
+    bool mExit;
+    bool mOpen;
+
+    int32_t findSlotLocked(OMX_BUFFERHEADERTYPE *header) const;
+    int32_t findFreeSlotLocked() const;
+    void waitIdleLocked();
+
+    static void *ThreadWrapper(void *me);
+    void threadEntry();
+
+    DISALLOW_EVIL_CONSTRUCTORS(SprdEncoderInputRing);
+};
+
+}  // namespace android
+
+#endif  // SPRD_ENCODER_INPUT_RING_H_
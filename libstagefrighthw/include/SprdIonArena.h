@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPRD_ION_ARENA_H_
+
+#define SPRD_ION_ARENA_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/Errors.h>
+#include <utils/Vector.h>
+#include "MemIon.h"
+
+namespace android {
+
+// Per-component pool of mapped ION memory for the codec working buffers
+// (extra, mbinfo, ctuinfo). Regions are carved out of a few large blocks
+// that are allocated and IOMMU-mapped once, and handed out again after
+// reset() instead of going back to ION on every sequence header.
+struct SprdIonArena {
+    // Maps a block for the engine. Returns < 0 on failure.
+    typedef int (*MapFunc)(void *cookie, int fd, unsigned long *iova, size_t *size);
+    typedef void (*UnmapFunc)(void *cookie, unsigned long iova, size_t size);
+
+    struct Region {
+        Region() : mVirt(NULL), mPhy(0), mSize(0) {}
+
+        uint8_t *mVirt;
+        unsigned long mPhy;
+        size_t mSize;
+    };
+
+    // Without map/unmap functions, blocks are addressed by their physical
+    // address from ION.
+    SprdIonArena(const char *name, unsigned int heapMask,
+            MapFunc map, UnmapFunc unmap, void *cookie);
+    ~SprdIonArena();
+
+    status_t alloc(size_t size, Region *region);
+
+    // Starts a new sequence: every region handed out so far is forgotten
+    // and its memory becomes available again. Blocks stay allocated and
+    // mapped. If the last sequence spilled over several blocks, they are
+    // merged into one on the next alloc().
+    void reset();
+
+    // Unmaps and frees all blocks. Must run while the map cookie (the
+    // codec handle) is still valid.
+    void releaseAll();
+
+    size_t inUseHighWater() const { return mInUseHighWater; }
+    size_t mappedHighWater() const { return mMappedHighWater; }
+
+private:
+    struct Block {
+        sp<MemIon> mMem;
+        uint8_t *mVirt;
+        unsigned long mPhy;
+        size_t mSize;
+        size_t mUsed;
+    };
+
+    AString mName;
+    unsigned int mHeapMask;
+    MapFunc mMap;
+    UnmapFunc mUnmap;
+    void *mCookie;
+
+    Vector<Block> mBlocks;
+    size_t mInUse;
+    size_t mMapped;
+    size_t mInUseHighWater;
+    size_t mMappedHighWater;
+    size_t mSequenceHighWater;
+    bool mCompactPending;
+
+    status_t addBlock(size_t size);
+    void freeBlocks();
+
+    DISALLOW_EVIL_CONSTRUCTORS(SprdIonArena);
+};
+
+}  // namespace android
+
+#endif  // SPRD_ION_ARENA_H_
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPRD_IOVA_CACHE_H_
+
+#define SPRD_IOVA_CACHE_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/KeyedVector.h>
+#include <utils/threads.h>
+
+#include <sys/types.h>
+
+namespace android {
+
+// Keeps the IOMMU mappings of buffers that a component receives by fd
+// (camera and gralloc metadata buffers, deinterlace targets) instead of
+// mapping and unmapping them around every frame. Entries are keyed by the
+// dma-buf inode, which unlike the fd number identifies the buffer itself,
+// and the least recently used mapping is dropped once the cache is full.
+struct SprdIovaCache {
+    typedef int (*MapFunc)(void *cookie, int fd, unsigned long *iova, size_t *size);
+    typedef void (*UnmapFunc)(void *cookie, unsigned long iova, size_t size);
+
+    // The capacity is read from vendor.omx.iova_cache_size.
+    SprdIovaCache(const char *name, MapFunc map, UnmapFunc unmap, void *cookie);
+    ~SprdIovaCache();
+
+    // Keeps at least capacity mappings, whatever vendor.omx.iova_cache_size
+    // says, for owners that have that many buffers in flight at once.
+    void reserve(size_t capacity);
+
+    // Returns < 0 if the buffer cannot be mapped.
+    int map(int fd, unsigned long *iova, size_t *size);
+
+    // Drops the mapping of the buffer behind fd, if any. Call before the
+    // owner of the buffer frees it.
+    void invalidate(int fd);
+
+    // Drops every mapping. Must run while the map cookie (the codec
+    // handle) is still valid.
+    void flush();
+
+private:
+    struct Entry {
+        dev_t mDev;
+        unsigned long mIova;
+        size_t mSize;
+        uint64_t mLastUse;
+    };
+
+    Mutex mLock;
+    AString mName;
+    MapFunc mMap;
+    UnmapFunc mUnmap;
+    void *mCookie;
+    size_t mCapacity;
+
+    KeyedVector<uint64_t, Entry> mEntries;
+    uint64_t mUseSerial;
+    uint64_t mHits;
+    uint64_t mMisses;
+
+    void removeEntryLocked(size_t index);
+
+    DISALLOW_EVIL_CONSTRUCTORS(SprdIovaCache);
+};
+
+}  // namespace android
+
+#endif  // SPRD_IOVA_CACHE_H_
@@ -62,6 +62,14 @@ struct SprdOMXComponent : public RefBase {
     void setLibHandle(void *libHandle);
     void *libHandle() const;
 
+    // Hands an instance that was constructed ahead of time over to a new
+    // client. Only valid while the component is still in OMX_StateLoaded
+    // and has never notified anyone.
+    void rebindClient(
+        const OMX_CALLBACKTYPE *callbacks,
+        OMX_PTR appData,
+        OMX_COMPONENTTYPE **component);
+
     virtual void prepareForDestruction() {}
 
 protected:
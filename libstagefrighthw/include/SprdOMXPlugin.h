@@ -19,7 +19,9 @@
 #define SPRD_OMX_PLUGIN_H_
 
 #include <OMXPluginBase.h>
+#include <utils/KeyedVector.h>
 #include <utils/Mutex.h>
+#include <utils/String8.h>
 #include <utils/Vector.h>
 
 namespace android {
@@ -50,6 +52,13 @@ struct SprdOMXCore {
     OMX_U32 mNumComponents;
 };
 
+// Where a component name lives and which roles it declares, collected
+// once when its core is added.
+struct SprdOMXComponentInfo {
+    SprdOMXCore *mCore;
+    Vector<String8> mRoles;
+};
+
 struct SprdOMX {
     OMX_COMPONENTTYPE *mComponent;
     SprdOMXCore *mCore;
@@ -84,7 +93,13 @@ private:
     Vector<SprdOMXCore*> mCores;
     Vector<SprdOMX> mComponents;
 
+    // Components of all cores in enumeration order, and the merged
+    // name->core index. Both are only written from the constructor.
+    Vector<String8> mComponentNames;
+    KeyedVector<String8, SprdOMXComponentInfo> mComponentIndex;
+
     OMX_ERRORTYPE AddCore(const char* coreName);
+    void IndexComponent(SprdOMXCore *core, const char *name);
 
     SprdOMXPlugin(const SprdOMXPlugin &);
     SprdOMXPlugin &operator=(const SprdOMXPlugin &);
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPRD_OUTPUT_PACKER_H_
+
+#define SPRD_OUTPUT_PACKER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Vector.h>
+
+#include <OMX_Core.h>
+
+namespace android {
+
+// Extradata type of the frame list of a packed output buffer.
+#define OMX_ExtraDataSprdFrameList ((OMX_EXTRADATATYPE)0x7F000001)
+
+// One entry of the frame list. nOffset is relative to the header's
+// nOffset; nFlags holds the per-frame OMX_BUFFERFLAG_* bits.
+struct SprdPackedFrameInfo {
+    OMX_S64 nTimeStamp;
+    OMX_U32 nOffset;
+    OMX_U32 nSize;
+    OMX_U32 nFlags;
+    OMX_U32 nReserved;
+};
+
+// Data of the OMX_ExtraDataSprdFrameList extradata.
+struct SprdPackedFrameList {
+    OMX_U32 nFrames;
+    OMX_U32 nReserved;
+    SprdPackedFrameInfo frames[1];
+};
+
+// Payload of OMX_IndexParamOutputPacking. nMaxFrames of 0 or 1 returns
+// one frame per buffer, as without the extension.
+struct SprdOutputPackingParams {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_U32 nMaxFrames;
+};
+
+// Packs up to maxFrames() complete frames back to back into one output
+// buffer. The buffer stays at the head of the output queue while frames
+// are added; finish() then writes the timestamp, offset and size of each
+// frame as OMX_ExtraDataSprdFrameList extradata behind the payload, sets
+// OMX_BUFFERFLAG_EXTRADATA and leaves the header ready for
+// FillBufferDone. nTimeStamp of the header is that of the first frame.
+//
+// Components that only learn a frame's size once it is produced, like
+// the encoders, write it at frameTarget(). A frame that does not fit
+// behind the ones packed so far is set aside there instead; the buffer
+// then goes back without it and placeSetAside() starts the next buffer
+// with it.
+struct SprdOutputPacker {
+    SprdOutputPacker();
+    ~SprdOutputPacker();
+
+    void setMaxFrames(OMX_U32 maxFrames);
+    OMX_U32 maxFrames() const { return mMaxFrames; }
+    bool enabled() const { return mMaxFrames > 1; }
+
+    // Frames added to the buffer being packed.
+    size_t frameCount() const { return mFrames.size(); }
+
+    // The buffer being packed, NULL if none.
+    OMX_BUFFERHEADERTYPE *pending() const { return mHeader; }
+
+    // Changes whenever a buffer is finished or dropped.
+    int32_t generation() const { return mGeneration; }
+
+    // Where the next frame of header goes, and how many bytes it may take
+    // once room for the frame list of a full buffer is set aside.
+    OMX_U8 *tail(const OMX_BUFFERHEADERTYPE *header) const;
+    size_t room(const OMX_BUFFERHEADERTYPE *header) const;
+
+    // Where a frame of size bytes for header has to be written: tail(header)
+    // if it fits, the set-aside buffer if it only fits into an empty
+    // buffer, NULL if it is larger than header can ever hold. Without
+    // packing this is the start of the buffer or NULL.
+    OMX_U8 *frameTarget(const OMX_BUFFERHEADERTYPE *header, size_t size);
+
+    // Accounts a frame of size bytes the component wrote at
+    // frameTarget(header) or tail(header). Returns false if the frame was
+    // set aside; header is then complete and has to be finished.
+    bool append(OMX_BUFFERHEADERTYPE *header, OMX_TICKS timeUs, OMX_U32 size, OMX_U32 flags);
+
+    // A set-aside frame waits for the next buffer.
+    bool hasSetAside() const { return mSetAsideReady; }
+
+    // Starts the empty buffer header with the set-aside frame and returns
+    // its flags.
+    OMX_U32 placeSetAside(OMX_BUFFERHEADERTYPE *header);
+
+    // Whether header should go back now: the frame limit is reached or
+    // a frame of up to nextSize bytes would not fit any more.
+    bool isFull(const OMX_BUFFERHEADERTYPE *header, size_t nextSize) const;
+
+    // The largest frame in the buffer being packed, as the size to expect
+    // for the next one.
+    size_t largestFrame() const { return mLargestFrame; }
+
+    // Writes the frame list and forgets the buffer. A single frame that
+    // leaves no room for the list goes back as a plain buffer.
+    void finish(OMX_BUFFERHEADERTYPE *header);
+
+    // Writes the 00 00 00 01 start code over the first bytes of an
+    // encoded H.264/H.265 frame of size bytes, e.g. into the copy at
+    // frameTarget(). Returns false, leaving the frame alone, if it is too
+    // short to hold one.
+    static bool writeStartCode(OMX_U8 *frame, size_t size);
+
+    // Finishes the buffer being packed, if any, e.g. before the port is
+    // disabled and the buffer goes back as it is.
+    void finishPending();
+
+    // Drops the frames packed so far and any set-aside frame, e.g. when
+    // the port is flushed.
+    void reset();
+
+private:
+    OMX_U32 mMaxFrames;
+    OMX_BUFFERHEADERTYPE *mHeader;
+    int32_t mGeneration;
+    Vector<SprdPackedFrameInfo> mFrames;
+    size_t mLargestFrame;
+
+    OMX_U8 *mSetAside;
+    size_t mSetAsideCapacity;
+    size_t mSetAsideSize; // written at frameTarget(), not yet appended
+    bool mSetAsideReady;
+    SprdPackedFrameInfo mSetAsideInfo;
+
+    size_t extraDataSize(size_t frames) const;
+
+    DISALLOW_EVIL_CONSTRUCTORS(SprdOutputPacker);
+};
+
+}  // namespace android
+
+#endif  // SPRD_OUTPUT_PACKER_H_
@@ -19,21 +19,39 @@
 #define SPRD_SIMPLE_OMX_COMPONENT_H_
 
 #include "SprdOMXComponent.h"
+#include "SprdCodecMetrics.h"
+#include "SprdOutputPacker.h"
+#include "SprdVspScheduler.h"
 
 #include <media/stagefright/foundation/AHandlerReflector.h>
 #include <utils/RefBase.h>
 #include <utils/threads.h>
 #include <utils/Vector.h>
 
+#include <pthread.h>
+
 namespace android {
 
 struct ALooper;
+struct AMessage;
 
 struct CodecProfileLevel {
     OMX_U32 mProfile;
     OMX_U32 mLevel;
 };
 
+// Payload of OMX_IndexConfigCallbackBatching. EmptyBufferDone and
+// FillBufferDone are held back until nMaxBuffers are pending or the
+// oldest has waited nMaxLatencyUs, then delivered back to back. Events,
+// EOS and port commands deliver whatever is pending first. nMaxBuffers
+// of 0 or 1 delivers every callback at once.
+struct SprdCallbackBatchingParams {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nMaxBuffers;
+    OMX_U32 nMaxLatencyUs;
+};
+
 struct SprdSimpleOMXComponent : public SprdOMXComponent {
     SprdSimpleOMXComponent(
             const char *name,
@@ -55,12 +73,113 @@ struct SprdSimpleOMXComponent : public SprdOMXComponent {
 
         int32_t mPicId;
         int32_t mNodeId;
+
+        int64_t mQueuedUs; // when the input buffer arrived
+
+        // Links owned by the PortQueue the buffer currently sits in.
+        BufferInfo *mQueuePrev;
+        BufferInfo *mQueueNext;
+        bool mQueued;
+    };
+
+    // Intrusive FIFO of BufferInfo. Mirrors the subset of List<> the
+    // components use, but links the buffers through BufferInfo itself so
+    // that queueing and dequeueing never allocates. A buffer can only be
+    // in one PortQueue at a time.
+    struct PortQueue {
+        struct iterator {
+            iterator() : mInfo(NULL) {}
+            explicit iterator(BufferInfo *info) : mInfo(info) {}
+
+            BufferInfo *operator*() const { return mInfo; }
+            iterator &operator++() { mInfo = mInfo->mQueueNext; return *this; }
+            iterator operator++(int) { iterator tmp(*this); ++(*this); return tmp; }
+            bool operator==(const iterator &other) const { return mInfo == other.mInfo; }
+            bool operator!=(const iterator &other) const { return mInfo != other.mInfo; }
+
+        private:
+            BufferInfo *mInfo;
+        };
+
+        PortQueue() : mHead(NULL), mTail(NULL), mSize(0) {}
+
+        bool empty() const { return mSize == 0; }
+        size_t size() const { return mSize; }
+
+        iterator begin() const { return iterator(mHead); }
+        iterator end() const { return iterator(); }
+
+        void push_back(BufferInfo *info);
+        iterator erase(iterator it);
+        void erase(BufferInfo *info);
+        void clear();
+
+    private:
+        BufferInfo *mHead;
+        BufferInfo *mTail;
+        size_t mSize;
+    };
+
+    // Stored in OMX_BUFFERHEADERTYPE::pPlatformPrivate of every header we
+    // hand out, so that a header can be mapped back to its BufferInfo
+    // without walking PortInfo::mBuffers.
+    struct BufferPlatformPrivate {
+        OMX_U32 mPortIndex;
+        size_t mIndex;
+        OMX_U8 *mAllocation; // non-NULL if the data was allocated by us
+    };
+
+    // Single-producer/single-consumer queue carrying buffers and commands
+    // from emptyThisBuffer()/fillThisBuffer()/sendCommand() to the looper
+    // thread, in the order they were issued. The IL client serializes
+    // calls into a component, so there is only ever one producer; the
+    // looper is the only consumer. Pushes go to a lock-free ring; once it
+    // is full they go to a locked overflow list until the looper has taken
+    // that over, so later entries never pass earlier ones.
+    struct BufferRing {
+        enum {
+            kCapacity = 128, // must be a power of two
+        };
+
+        enum Kind {
+            kEmptyBuffer,
+            kFillBuffer,
+            kCommand,
+        };
+
+        struct Entry {
+            Kind mKind;
+            OMX_BUFFERHEADERTYPE *mHeader; // kEmptyBuffer, kFillBuffer
+            OMX_COMMANDTYPE mCmd;          // kCommand
+            OMX_U32 mParam;                // kCommand
+        };
+
+        BufferRing() : mHead(0), mTail(0), mOverflowing(0), mTakenIndex(0) {}
+
+        void push(const Entry &entry);
+        bool pop(Entry *entry);
+
+    private:
+        Entry mSlots[kCapacity];
+        volatile int32_t mHead; // next slot to pop, written by the consumer
+        volatile int32_t mTail; // next slot to push, written by the producer
+
+        Mutex mOverflowLock;
+        Vector<Entry> mOverflow;
+        volatile int32_t mOverflowing; // mOverflow is in use
+
+        // Overflow entries the consumer took over; popped before the ring.
+        Vector<Entry> mTaken;
+        size_t mTakenIndex;
+
+        bool pushRing(const Entry &entry);
+        bool popRing(Entry *entry);
     };
 
     struct PortInfo {
         OMX_PARAM_PORTDEFINITIONTYPE mDef;
         Vector<BufferInfo> mBuffers;
-        List<BufferInfo *> mQueue;
+        PortQueue mQueue;
 
         enum {
             NONE,
@@ -75,12 +194,99 @@ struct SprdSimpleOMXComponent : public SprdOMXComponent {
     List<BufferInfo *> mDeinterInputBufQueue;
 
     PortInfo *editPortInfo(OMX_U32 portIndex);
-    List<BufferInfo *> &getPortQueue(OMX_U32 portIndex);
+    PortQueue &getPortQueue(OMX_U32 portIndex);
+    BufferInfo *findBufferInfo(OMX_U32 portIndex, OMX_BUFFERHEADERTYPE *header);
     virtual void drainOneOutputBuffer(OMX_S32 picId, OMX_PTR pBufferHeader, OMX_U64 pts);
 
 protected:
+    virtual ~SprdSimpleOMXComponent();
+
+    // Engine time, scheduler wait and buffer latencies are recorded by the
+    // base class; components add what only they can see (copies, IOVA
+    // mappings, errors, software fallbacks).
+    SprdCodecMetrics mMetrics;
+
+    // Configured through OMX_IndexParamOutputPacking once the component
+    // called enableOutputPacking(). Reset when the output port is flushed;
+    // a partly packed buffer is finished before the port is disabled, or
+    // once it has been held for the callback batching latency.
+    SprdOutputPacker mOutputPacker;
+
+    // Brackets a blocking engine call made from onQueueFilled(). When the
+    // decode thread is running, the component lock is dropped for the
+    // duration so the looper keeps accepting buffers while the hardware is
+    // busy. Output buffers returned meanwhile are queued once the section
+    // closes, commands wait until the decode thread is idle. Without the
+    // decode thread the lock is only dropped while waiting for the
+    // scheduler to hand out the core. Either way useBuffer(), freeBuffer()
+    // and setParameter() wait until the section has the lock back.
+    struct HardwareSection {
+        explicit HardwareSection(SprdSimpleOMXComponent *component);
+        ~HardwareSection();
+
+    private:
+        SprdSimpleOMXComponent *mComponent;
+        bool mUnlocked;
+        int64_t mStartUs;
+
+        DISALLOW_EVIL_CONSTRUCTORS(HardwareSection);
+    };
+
+    // Has onQueueFilled(portIndex) run again on the component's thread,
+    // e.g. once a worker the component runs itself finished a frame. Safe
+    // to call from any thread; ignored unless the component is executing.
+    void signalQueueFilled(OMX_U32 portIndex);
+
+    // With the rings off every emptyThisBuffer()/fillThisBuffer() posts
+    // its own AMessage. vendor.omx.buffer_ring=0 sets the default; call
+    // from the constructor, before any buffer is exchanged.
+    void setBufferRingEnabled(bool enabled);
+
+    // Moves onQueueFilled() off the looper onto a dedicated decode thread.
+    // Call from the constructor, before any buffer is exchanged.
+    void startDecodeThread();
+
+    // Registers the component with the SprdVspScheduler. The session is
+    // admitted on Loaded->Idle using the video port sizes (the transition
+    // fails with OMX_ErrorInsufficientResources if a VSP budget is set and
+    // exhausted), and every HardwareSection then waits for its turn on the
+    // core. Call from the constructor of VSP backed components.
+    void enableVspScheduling(SprdVspScheduler::Core core);
+    void disableVspScheduling(); // e.g. after falling back to a software codec
+    void setVspPriority(SprdVspScheduler::Priority priority);
+
+    // Lets the client pack several frames into one output buffer through
+    // OMX_IndexParamOutputPacking. Call from the constructor of components
+    // whose onQueueFilled() uses mOutputPacker.
+    void enableOutputPacking();
+
+    // Hands a frame written at mOutputPacker.frameTarget() of the head
+    // output buffer to the packer. The buffer goes back once it is full or
+    // the frame carries EOS, and without the frame if it had to be set
+    // aside; the next queued buffer then starts with it.
+    void packOutputFrame(OMX_TICKS timeUs, OMX_U32 size, OMX_U32 flags);
+
+    // Starts the head output buffer with the set-aside frame, if any.
+    // Returns false while that frame waits for an output buffer.
+    bool placeSetAsideFrame();
 
     void addPort(const OMX_PARAM_PORTDEFINITIONTYPE &def);
+    BufferInfo *addBuffer(OMX_U32 portIndex, OMX_BUFFERHEADERTYPE *header);
+
+    // Hide the SprdOMXComponent versions to account for the buffers and
+    // to batch the callbacks. notify() delivers pending callbacks first so
+    // that events never overtake the buffers they refer to.
+    void notify(
+            OMX_EVENTTYPE event,
+            OMX_U32 data1, OMX_U32 data2, OMX_PTR data);
+    void notifyEmptyBufferDone(OMX_BUFFERHEADERTYPE *header);
+    void notifyFillBufferDone(OMX_BUFFERHEADERTYPE *header);
+
+    // Engine address of an input buffer the component allocated from ION
+    // itself, so the engine can read the bitstream in place. Returns 0 for
+    // client memory or data not starting at the head of the buffer, which
+    // then has to be copied into the stream buffer.
+    unsigned long getInputStreamAddr(const OMX_BUFFERHEADERTYPE *header) const;
 
     void ConvertFlexYUVToPlanar(
             uint8_t *dst, size_t dstStride, size_t dstVStride,
@@ -92,6 +298,18 @@ protected:
     virtual OMX_ERRORTYPE internalSetParameter(
             OMX_INDEXTYPE index, const OMX_PTR params);
 
+    // Handle OMX_IndexConfigCodecMetrics and
+    // OMX_IndexConfigCallbackBatching. Components that override these
+    // forward the two indices here.
+    virtual OMX_ERRORTYPE getConfig(
+            OMX_INDEXTYPE index, OMX_PTR params);
+
+    virtual OMX_ERRORTYPE setConfig(
+            OMX_INDEXTYPE index, const OMX_PTR params);
+
+    virtual OMX_ERRORTYPE getExtensionIndex(
+            const char *name, OMX_INDEXTYPE *index);
+
     virtual OMX_ERRORTYPE useBuffer(
             OMX_BUFFERHEADERTYPE **buffer,
             OMX_U32 portIndex,
@@ -123,8 +341,23 @@ protected:
     virtual void onQueueFilled(OMX_U32 portIndex);
     virtual void onPortFlushCompleted(OMX_U32 portIndex);
     virtual void onPortEnableCompleted(OMX_U32 portIndex, bool enabled);
+    // Called before the buffers of a port go back to the client on a
+    // flush, and before the input buffers go back on a port disable.
     virtual void onPortFlushPrepare(OMX_U32 portIndex);
+    // Called before the buffers of either port go back to the client on a
+    // port disable. Calls onPortFlushPrepare() for the input port; override
+    // to also stop work that writes into the output buffers.
+    virtual void onPortDisablePrepare(OMX_U32 portIndex);
     virtual void onReset();
+
+    // Called on the client's thread, without the component lock, as soon
+    // as an input buffer arrives and before it is queued on the port.
+    // Must not touch the port queues or anything mLock guards.
+    virtual void onInputBufferArrived(OMX_BUFFERHEADERTYPE *header);
+
+    // Called for every input buffer before onQueueFilled() can see it.
+    // With the decode thread running it is called on that thread, so it
+    // may use the engine.
     virtual void onDecodePrepare(OMX_BUFFERHEADERTYPE *header);
 
 private:
@@ -132,6 +365,15 @@ private:
         kWhatSendCommand,
         kWhatEmptyThisBuffer,
         kWhatFillThisBuffer,
+        kWhatDrainBuffers,
+        kWhatDeliverDone,
+        kWhatQueueFilled,
+        kWhatFlushPacked,
+    };
+
+    struct DoneCallback {
+        OMX_BUFFERHEADERTYPE *mHeader;
+        bool mFill;
     };
 
     Mutex mLock;
@@ -144,6 +386,47 @@ private:
 
     Vector<PortInfo> mPorts;
 
+    bool mBufferRingEnabled;
+    BufferRing mClientRing;
+    volatile int32_t mDrainPending;
+    sp<AMessage> mDrainMsg;
+
+    pthread_t mDecodeThread;
+    bool mDecodeThreadStarted;
+    bool mDecodeThreadExit;
+    bool mDecodeBusy;
+    bool mInHardware;
+    // A HardwareSection gave up mLock; calls that add, remove or redefine
+    // buffers wait until it has it back.
+    bool mSectionUnlocked;
+    Condition mSectionCondition;
+    uint32_t mDecodePending; // bitmask of ports waiting for onQueueFilled()
+    Condition mDecodeCondition;
+    Condition mDecodeIdleCondition;
+    Vector<OMX_BUFFERHEADERTYPE *> mDeferredFillBuffers;
+    Vector<OMX_BUFFERHEADERTYPE *> mDeferredPrepareBuffers; // for the decode thread
+
+    bool mVspScheduled;
+    SprdVspScheduler::Core mVspCore;
+    SprdVspScheduler::Priority mVspPriority;
+    int32_t mVspSessionId; // -1 while not admitted
+
+    bool mOutputPackingEnabled;
+
+    // Callback batching. mDoneLock guards the pending list, which the
+    // deinterlace threads add to without mLock. It is not held across the
+    // client callbacks; one thread at a time delivers, in queue order.
+    Mutex mDoneLock;
+    Condition mDoneCondition; // signalled when a delivery ends
+    Vector<DoneCallback> mPendingDone;
+    uint32_t mBatchMaxBuffers;
+    int64_t mBatchLatencyUs;
+    int32_t mDoneGeneration; // tells stale kWhatDeliverDone apart
+    bool mDelivering;
+    pthread_t mDeliveringThread;
+
+    int32_t mPackedFlushGeneration; // packer generation kWhatFlushPacked was posted for
+
     bool isSetParameterAllowed(
             OMX_INDEXTYPE index, const OMX_PTR params) const;
 
@@ -169,6 +452,25 @@ private:
     void onPortEnable(OMX_U32 portIndex, bool enable);
     void onPortFlush(OMX_U32 portIndex, bool sendFlushComplete);
 
+    void getVspLoad(int32_t *width, int32_t *height, int32_t *fps) const;
+    bool admitVspSession();
+    void releaseVspSession();
+
+    void signalBufferDrain();
+    void queueDone(OMX_BUFFERHEADERTYPE *header, bool fill);
+    void deliverPendingDone();
+    void schedulePackedFlush();
+    void flushPackedOutput();
+    void queueFilled(OMX_U32 portIndex);
+    void waitForDecodeIdle();
+    void waitForSectionLocked();
+    void prepareDeferredBuffers();
+    void stopDecodeThread();
+    static void *DecodeThreadWrapper(void *me);
+    void decodeThreadEntry();
+    void onEmptyThisBuffer(OMX_BUFFERHEADERTYPE *header);
+    void onFillThisBuffer(OMX_BUFFERHEADERTYPE *header);
+
     DISALLOW_EVIL_CONSTRUCTORS(SprdSimpleOMXComponent);
 };
 
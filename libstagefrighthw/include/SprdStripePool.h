@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPRD_STRIPE_POOL_H_
+
+#define SPRD_STRIPE_POOL_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/List.h>
+#include <utils/threads.h>
+
+#include <pthread.h>
+
+namespace android {
+
+// Process-wide worker threads for the per-frame CPU passes of the codecs
+// (colour conversion, copies into the engine input buffer, padding, the
+// restart interval bands of the MJPEG decoder). A pass is split into
+// horizontal stripes of whole rows that the workers and the calling thread
+// process together.
+//
+// vendor.omx.stripe_threads sets the number of threads including the
+// caller (default: online CPUs, at most kMaxThreads; 1 turns the pool
+// off). vendor.omx.stripe_cpus, a hex CPU mask, pins the workers, e.g. to
+// the big cluster.
+struct SprdStripePool {
+    typedef void (*StripeFunc)(void *cookie, int32_t begin, int32_t end);
+
+    enum {
+        kMaxThreads = 8,
+    };
+
+    static SprdStripePool *getInstance();
+
+    // A pool of its own with threadCount threads, the caller included,
+    // for tests and benchmarks. The codecs share getInstance().
+    explicit SprdStripePool(int32_t threadCount);
+    ~SprdStripePool();
+
+    // Calls func on ranges that cover [0, rows) and start at multiples of
+    // align, then returns. rowBytes, the memory one row reads and writes,
+    // sizes the stripes; small passes run on the calling thread only.
+    void run(StripeFunc func, void *cookie, int32_t rows, size_t rowBytes, int32_t align = 1);
+
+    // run() with the pool as cookie, for code that takes a run function,
+    // such as the SprdColorConvert frame helpers.
+    static void Run(void *pool, StripeFunc func, void *cookie,
+            int32_t rows, size_t rowBytes, int32_t align);
+
+    void copy(void *dst, const void *src, size_t size);
+
+    // Copies rows of width bytes into rows of dstWidth bytes and fills the
+    // rest of each row by repeating its last unit bytes (1 for luma, 2 for
+    // interleaved chroma).
+    void copyPadded(uint8_t *dst, size_t dstWidth, const uint8_t *src, size_t width,
+            int32_t rows, size_t unit);
+
+    int32_t threadCount() const { return mThreadCount; }
+
+private:
+    struct Job {
+        StripeFunc mFunc;
+        void *mCookie;
+        int32_t mRows;
+        int32_t mStripeRows;
+        int32_t mNext;      // first row not handed out yet
+        int32_t mPending;   // stripes not finished yet
+        Condition mDone;
+    };
+
+    Mutex mLock;
+    Condition mWorkCondition;
+    Condition mExitCondition;
+    List<Job *> mJobs;      // jobs with stripes left to hand out
+    int32_t mThreadCount;
+    int32_t mWorkers;       // worker threads still running
+    bool mExit;
+
+    SprdStripePool();
+
+    void startWorkers(int32_t threadCount);
+    bool takeStripeLocked(Job *job, int32_t *begin, int32_t *end);
+    void runStripe(Job *job, int32_t begin, int32_t end);
+
+    static void *WorkerWrapper(void *me);
+    void workerLoop();
+
+    DISALLOW_EVIL_CONSTRUCTORS(SprdStripePool);
+};
+
+}  // namespace android
+
+#endif  // SPRD_STRIPE_POOL_H_
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPRD_VSP_SCHEDULER_H_
+
+#define SPRD_VSP_SCHEDULER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <media/stagefright/foundation/AString.h>
+#include <utils/Errors.h>
+#include <utils/KeyedVector.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// Process-wide arbiter for the VSP cores shared by all hardware codec
+// sessions. Sessions are optionally admitted against a macroblocks-per-
+// second budget. Engine calls on one core are handed out one at a time,
+// highest priority first and earliest deadline first within a priority;
+// sessions on different cores do not wait for each other. A waiting job
+// moves up one priority for every agingJobs() jobs that get the core
+// ahead of it, so a busy realtime session delays but never starves the
+// others.
+struct SprdVspScheduler {
+    enum Priority {
+        kPriorityBackground = 0, // thumbnails and other offline work
+        kPriorityNormal     = 1, // playback and recording
+        kPriorityRealtime   = 2, // VoLTE / video call
+    };
+
+    // Decoding and encoding run on cores of their own, unless
+    // vendor.vsp.shared_core is "true" for platforms with a single VSP.
+    enum Core {
+        kCoreDecoder = 0,
+        kCoreEncoder = 1,
+        kNumCores,
+    };
+
+    static SprdVspScheduler *getInstance();
+
+    // Returns INVALID_OPERATION if admitting the session would exceed the
+    // budget. Background sessions are always admitted.
+    status_t registerSession(
+            const char *name, Core core, int32_t width, int32_t height, int32_t fps,
+            Priority priority, int32_t *sessionId);
+    void unregisterSession(int32_t sessionId);
+
+    // Updates the load of an admitted session, e.g. after a resolution
+    // change. The session is kept even if the budget is now exceeded.
+    void updateSession(int32_t sessionId, int32_t width, int32_t height, int32_t fps);
+    void setPriority(int32_t sessionId, Priority priority);
+
+    // Brackets one engine call. acquireEngine() blocks until no other
+    // session is inside the session's core and no more urgent job is
+    // waiting for it.
+    void acquireEngine(int32_t sessionId);
+    void releaseEngine(int32_t sessionId);
+
+    // Macroblocks per second currently admitted, and the budget (<= 0
+    // means admission control is off, the default). The budget comes
+    // from vendor.vsp.mb_budget; setBudget() overrides it, e.g. with a
+    // figure derived from the platform capability.
+    int64_t load() const;
+    int64_t budget() const;
+    void setBudget(int64_t budget);
+
+    // Jobs that may pass a waiting one before it moves up a priority;
+    // <= 0 keeps priorities strict. From vendor.vsp.aging_jobs, 4 by
+    // default.
+    int32_t agingJobs() const;
+    void setAgingJobs(int32_t jobs);
+
+private:
+    struct Session {
+        AString mName;
+        Core mCore;
+        int64_t mMbPerSec;
+        int64_t mPeriodUs;
+        Priority mPriority;
+
+        int64_t mDeadlineUs;    // of the waiting or running job
+        int64_t mSubmitUs;      // when the running job got the engine
+        bool mWaiting;
+        int32_t mPassedOver;    // jobs granted ahead of the waiting one
+
+        int64_t mJobs;
+        int64_t mEngineTimeUs;
+        int64_t mMaxEngineTimeUs;
+    };
+
+    mutable Mutex mLock;
+    Condition mCondition;
+
+    KeyedVector<int32_t, Session> mSessions;
+    int32_t mNextSessionId;
+    int32_t mEngineOwner[kNumCores]; // session inside the core, -1 if idle
+    int64_t mBudget;
+    int32_t mAgingJobs;
+    bool mSharedCore;
+
+    SprdVspScheduler();
+
+    static int64_t computeMbPerSec(int32_t width, int32_t height, int32_t fps);
+    int64_t loadLocked() const;
+    int32_t effectivePriorityLocked(const Session &session) const;
+    bool isNextLocked(int32_t sessionId) const;
+
+    DISALLOW_EVIL_CONSTRUCTORS(SprdVspScheduler);
+};
+
+}  // namespace android
+
+#endif  // SPRD_VSP_SCHEDULER_H_
@@ -295,6 +295,14 @@ typedef enum OMX_INDEXTYPE {
     OMX_IndexConfigDecSceneMode     =0x7F000025,
 #define SPRD_INDEX_PARAM_PREPARE_APB "OMX.google.android.index.prepareForAdaptivePlayback"
     OMX_IndexParamPrepareForAdaptivePlayback    =0x7F000026,
+#define SPRD_INDEX_CONFIG_CODEC_METRICS "OMX.sprd.index.CodecMetrics"
+    OMX_IndexConfigCodecMetrics     =0x7F000027,
+#define SPRD_INDEX_CONFIG_CALLBACK_BATCHING "OMX.sprd.index.CallbackBatching"
+    OMX_IndexConfigCallbackBatching     =0x7F000028,
+#define SPRD_INDEX_PARAM_OUTPUT_PACKING "OMX.sprd.index.OutputPacking"
+    OMX_IndexParamOutputPacking     =0x7F000029,
+#define SPRD_INDEX_PARAM_DECODE_SCALE "OMX.sprd.index.DecodeScale"
+    OMX_IndexParamDecodeScale     =0x7F00002A,
 
     OMX_IndexMax = 0x7FFFFFFF
 
@@ -0,0 +1,229 @@
+LOCAL_PATH := $(call my-dir)
+
+# Host tests of the pieces of libstagefrighthw that do not need a device.
+# Run with: atest --host <module>, or
+#   $ANDROID_HOST_OUT/nativetest64/<module>/<module>
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES :=                  \
+    SprdVspScheduler_test.cpp       \
+    ../SprdVspScheduler.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/../include
+
+LOCAL_SHARED_LIBRARIES :=       \
+    libutils                    \
+    libcutils                   \
+    libstagefright_foundation   \
+    liblog
+
+LOCAL_MODULE := SprdVspScheduler_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES :=                  \
+    SprdStripePool_test.cpp         \
+    ../SprdStripePool.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/../include
+
+LOCAL_STATIC_LIBRARIES := libsprd_colorconvert
+
+LOCAL_SHARED_LIBRARIES :=       \
+    libutils                    \
+    libcutils                   \
+    libstagefright_foundation   \
+    liblog
+
+LOCAL_MODULE := SprdStripePool_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES :=                  \
+    SprdEncoderInputRing_test.cpp   \
+    ../SprdEncoderInputRing.cpp
+
+LOCAL_C_INCLUDES :=                 \
+    $(LOCAL_PATH)/../include        \
+    $(LOCAL_PATH)/../include/openmax
+
+LOCAL_SHARED_LIBRARIES :=       \
+    libutils                    \
+    libcutils                   \
+    libstagefright_foundation   \
+    liblog
+
+LOCAL_MODULE := SprdEncoderInputRing_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES :=                  \
+    SprdOutputPacker_test.cpp       \
+    ../SprdOutputPacker.cpp
+
+LOCAL_C_INCLUDES :=                 \
+    $(LOCAL_PATH)/../include        \
+    $(LOCAL_PATH)/../include/openmax
+
+LOCAL_SHARED_LIBRARIES :=       \
+    libutils                    \
+    libcutils                   \
+    libstagefright_foundation   \
+    liblog
+
+LOCAL_MODULE := SprdOutputPacker_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+# Against the memfd backed libmemion of omx-components/mock.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES :=                  \
+    SprdIonArena_test.cpp           \
+    ../SprdIonArena.cpp
+
+LOCAL_C_INCLUDES :=                         \
+    vendor/sprd/external/kernel-headers     \
+    $(LOCAL_PATH)/../include
+
+LOCAL_SHARED_LIBRARIES :=       \
+    libmemion                   \
+    libutils                    \
+    libcutils                   \
+    libstagefright_foundation   \
+    liblog
+
+LOCAL_MODULE := SprdIonArena_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+# SprdSimpleOMXComponent on the looper and on the decode thread, against
+# an engine that sleeps for the hardware time.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := SprdDecodeThread_test.cpp
+
+LOCAL_C_INCLUDES :=                 \
+    $(LOCAL_PATH)/../include        \
+    $(LOCAL_PATH)/../include/openmax
+
+LOCAL_SHARED_LIBRARIES :=       \
+    libstagefrighthw            \
+    libutils                    \
+    libcutils                   \
+    libstagefright_foundation   \
+    liblog
+
+LOCAL_MODULE := SprdDecodeThread_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+################################################################################
+
+# Encoder input passes on 1 to 8 stripe threads:
+#   sprd_stripe_pool_bench [width height [frames]]
+# Run the device build for real numbers; a host only shows the scaling its
+# own CPUs allow.
+
+sprd_stripe_pool_bench_src_files := \
+    SprdStripePool_bench.cpp        \
+    ../SprdStripePool.cpp
+
+sprd_stripe_pool_bench_shared_libraries := \
+    libutils                    \
+    libcutils                   \
+    libstagefright_foundation   \
+    liblog
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(sprd_stripe_pool_bench_src_files)
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../include
+LOCAL_STATIC_LIBRARIES := libsprd_colorconvert
+LOCAL_SHARED_LIBRARIES := $(sprd_stripe_pool_bench_shared_libraries)
+LOCAL_CFLAGS := -O2
+
+LOCAL_MODULE := sprd_stripe_pool_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(sprd_stripe_pool_bench_src_files)
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../include
+LOCAL_STATIC_LIBRARIES := libsprd_colorconvert
+LOCAL_SHARED_LIBRARIES := $(sprd_stripe_pool_bench_shared_libraries)
+LOCAL_CFLAGS := -O2
+
+LOCAL_MODULE := sprd_stripe_pool_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
+
+################################################################################
+
+# Per-buffer EmptyThisBuffer/FillThisBuffer cost, buffer rings against one
+# AMessage per buffer, on a component that returns everything at once:
+#   sprd_etb_ftb_bench [buffers [rounds]]
+# vendor.omx.buffer_ring=0 gives the AMessage path to real components.
+
+sprd_etb_ftb_bench_shared_libraries := \
+    libstagefrighthw            \
+    libutils                    \
+    libcutils                   \
+    libstagefright_foundation   \
+    liblog
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := SprdSimpleOMXComponent_bench.cpp
+LOCAL_C_INCLUDES :=                 \
+    $(LOCAL_PATH)/../include        \
+    $(LOCAL_PATH)/../include/openmax
+LOCAL_SHARED_LIBRARIES := $(sprd_etb_ftb_bench_shared_libraries)
+LOCAL_CFLAGS := -O2
+
+LOCAL_MODULE := sprd_etb_ftb_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := SprdSimpleOMXComponent_bench.cpp
+LOCAL_C_INCLUDES :=                 \
+    $(LOCAL_PATH)/../include        \
+    $(LOCAL_PATH)/../include/openmax
+LOCAL_SHARED_LIBRARIES := $(sprd_etb_ftb_bench_shared_libraries)
+LOCAL_CFLAGS := -O2
+
+LOCAL_MODULE := sprd_etb_ftb_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
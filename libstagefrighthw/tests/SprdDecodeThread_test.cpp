@@ -0,0 +1,494 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdDecodeThread_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <OMX_Component.h>
+#include <OMX_Core.h>
+
+#include <utils/Timers.h>
+#include <utils/threads.h>
+
+#include "SprdSimpleOMXComponent.h"
+
+namespace android {
+
+static const OMX_U32 kNumBuffers = 4;
+
+template<class T>
+static void InitOMXParams(T *params) {
+    params->nSize = sizeof(T);
+    params->nVersion.s.nVersionMajor = 1;
+    params->nVersion.s.nVersionMinor = 0;
+    params->nVersion.s.nRevision = 0;
+    params->nVersion.s.nStep = 0;
+}
+
+static int64_t nowMs() {
+    return systemTime(SYSTEM_TIME_MONOTONIC) / 1000000;
+}
+
+// Stands in for the VSP: a decode call blocks for the hardware time, like
+// the engines of omx-components/mock with VSPMOCK_LATENCY_US set.
+struct MockEngine {
+    MockEngine(int32_t latencyUs) : mLatencyUs(latencyUs), mBusy(false), mFrames(0) {}
+
+    void decode() {
+        {
+            Mutex::Autolock autoLock(mLock);
+            mBusy = true;
+            mCondition.broadcast();
+        }
+        usleep(mLatencyUs);
+        {
+            Mutex::Autolock autoLock(mLock);
+            mBusy = false;
+            mFrames++;
+            mCondition.broadcast();
+        }
+    }
+
+    void waitUntilBusy() {
+        Mutex::Autolock autoLock(mLock);
+        while (!mBusy) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    int32_t frames() {
+        Mutex::Autolock autoLock(mLock);
+        return mFrames;
+    }
+
+    const int32_t mLatencyUs;
+
+private:
+    Mutex mLock;
+    Condition mCondition;
+    bool mBusy;
+    int32_t mFrames;
+};
+
+// Decodes one input buffer into one output buffer per engine call, the
+// way the hardware decoders bracket the engine with a HardwareSection.
+struct SleepingDecoder : public SprdSimpleOMXComponent {
+    SleepingDecoder(
+            const OMX_CALLBACKTYPE *callbacks,
+            OMX_PTR appData,
+            OMX_COMPONENTTYPE **component,
+            MockEngine *engine,
+            bool decodeThread,
+            bool vspScheduled)
+        : SprdSimpleOMXComponent("OMX.sprd.test.sleeping_decoder", callbacks, appData, component),
+          mEngine(engine) {
+        OMX_PARAM_PORTDEFINITIONTYPE def;
+        InitOMXParams(&def);
+        def.eDir = OMX_DirInput;
+        def.nBufferCountMin = kNumBuffers;
+        def.nBufferCountActual = kNumBuffers;
+        def.nBufferSize = 4096;
+        def.bEnabled = OMX_TRUE;
+        def.bPopulated = OMX_FALSE;
+        def.eDomain = OMX_PortDomainOther;
+        def.bBuffersContiguous = OMX_FALSE;
+        def.nBufferAlignment = 1;
+        def.format.other.eFormat = OMX_OTHER_FormatBinary;
+
+        def.nPortIndex = kInputPortIndex;
+        addPort(def);
+
+        def.nPortIndex = kOutputPortIndex;
+        def.eDir = OMX_DirOutput;
+        addPort(def);
+
+        if (decodeThread) {
+            startDecodeThread();
+        }
+        if (vspScheduled) {
+            enableVspScheduling(SprdVspScheduler::kCoreDecoder);
+        }
+    }
+
+protected:
+    virtual void onQueueFilled(OMX_U32 /* portIndex */) {
+        PortQueue &inQueue = getPortQueue(kInputPortIndex);
+        PortQueue &outQueue = getPortQueue(kOutputPortIndex);
+
+        while (!inQueue.empty() && !outQueue.empty()) {
+            BufferInfo *inInfo = *inQueue.begin();
+            BufferInfo *outInfo = *outQueue.begin();
+            inQueue.erase(inQueue.begin());
+            outQueue.erase(outQueue.begin());
+
+            {
+                HardwareSection section(this);
+                mEngine->decode();
+            }
+
+            outInfo->mHeader->nFilledLen = 1;
+            outInfo->mHeader->nOffset = 0;
+            outInfo->mHeader->nFlags = inInfo->mHeader->nFlags;
+            outInfo->mHeader->nTimeStamp = inInfo->mHeader->nTimeStamp;
+
+            inInfo->mOwnedByUs = false;
+            notifyEmptyBufferDone(inInfo->mHeader);
+            outInfo->mOwnedByUs = false;
+            notifyFillBufferDone(outInfo->mHeader);
+        }
+    }
+
+private:
+    MockEngine *mEngine;
+
+    DISALLOW_EVIL_CONSTRUCTORS(SleepingDecoder);
+};
+
+class SprdDecodeThreadTest : public ::testing::TestWithParam<bool> {
+protected:
+    SprdDecodeThreadTest()
+        : mVspScheduled(false),
+          mHandle(NULL),
+          mState(OMX_StateLoaded),
+          mFlushed(0),
+          mEmptied(0) {}
+
+    static OMX_ERRORTYPE OnEvent(
+            OMX_HANDLETYPE, OMX_PTR appData, OMX_EVENTTYPE event,
+            OMX_U32 data1, OMX_U32 data2, OMX_PTR) {
+        SprdDecodeThreadTest *me = static_cast<SprdDecodeThreadTest *>(appData);
+        Mutex::Autolock autoLock(me->mLock);
+        if (event == OMX_EventCmdComplete && data1 == OMX_CommandStateSet) {
+            me->mState = (OMX_STATETYPE)data2;
+        } else if (event == OMX_EventCmdComplete && data1 == OMX_CommandFlush) {
+            me->mFlushed++;
+        }
+        me->mCondition.broadcast();
+        return OMX_ErrorNone;
+    }
+
+    static OMX_ERRORTYPE OnEmptyBufferDone(
+            OMX_HANDLETYPE, OMX_PTR appData, OMX_BUFFERHEADERTYPE *) {
+        SprdDecodeThreadTest *me = static_cast<SprdDecodeThreadTest *>(appData);
+        Mutex::Autolock autoLock(me->mLock);
+        me->mEmptied++;
+        me->mCondition.broadcast();
+        return OMX_ErrorNone;
+    }
+
+    static OMX_ERRORTYPE OnFillBufferDone(
+            OMX_HANDLETYPE, OMX_PTR appData, OMX_BUFFERHEADERTYPE *header) {
+        SprdDecodeThreadTest *me = static_cast<SprdDecodeThreadTest *>(appData);
+        Mutex::Autolock autoLock(me->mLock);
+        me->mFilled.push_back(header);
+        if (header->nFilledLen > 0) {
+            me->mTimeStamps.push_back(header->nTimeStamp);
+        }
+        me->mCondition.broadcast();
+        return OMX_ErrorNone;
+    }
+
+    void start(int32_t latencyUs) {
+        static const OMX_CALLBACKTYPE kCallbacks = {
+            OnEvent, OnEmptyBufferDone, OnFillBufferDone,
+        };
+
+        mEngine = new MockEngine(latencyUs);
+        mComponent = new SleepingDecoder(&kCallbacks, this, &mHandle, mEngine, GetParam(), mVspScheduled);
+
+        OMX_SendCommand(mHandle, OMX_CommandStateSet, OMX_StateIdle, NULL);
+        for (OMX_U32 i = 0; i < kNumBuffers; ++i) {
+            ASSERT_EQ(OMX_ErrorNone,
+                    OMX_AllocateBuffer(mHandle, &mIn[i], kInputPortIndex, NULL, 4096));
+            ASSERT_EQ(OMX_ErrorNone,
+                    OMX_AllocateBuffer(mHandle, &mOut[i], kOutputPortIndex, NULL, 4096));
+        }
+        waitForState(OMX_StateIdle);
+        OMX_SendCommand(mHandle, OMX_CommandStateSet, OMX_StateExecuting, NULL);
+        waitForState(OMX_StateExecuting);
+    }
+
+    virtual void TearDown() {
+        if (mComponent == NULL) {
+            return;
+        }
+
+        OMX_SendCommand(mHandle, OMX_CommandStateSet, OMX_StateIdle, NULL);
+        waitForState(OMX_StateIdle);
+        OMX_SendCommand(mHandle, OMX_CommandStateSet, OMX_StateLoaded, NULL);
+        for (OMX_U32 i = 0; i < kNumBuffers; ++i) {
+            OMX_FreeBuffer(mHandle, kInputPortIndex, mIn[i]);
+            if (mOut[i] != NULL) {
+                OMX_FreeBuffer(mHandle, kOutputPortIndex, mOut[i]);
+            }
+        }
+        waitForState(OMX_StateLoaded);
+
+        mComponent->prepareForDestruction();
+        mComponent.clear();
+        delete mEngine;
+    }
+
+    void emptyBuffer(OMX_U32 index, OMX_TICKS timeStamp) {
+        mIn[index]->nFilledLen = 1;
+        mIn[index]->nOffset = 0;
+        mIn[index]->nFlags = 0;
+        mIn[index]->nTimeStamp = timeStamp;
+        ASSERT_EQ(OMX_ErrorNone, OMX_EmptyThisBuffer(mHandle, mIn[index]));
+    }
+
+    void waitForState(OMX_STATETYPE state) {
+        Mutex::Autolock autoLock(mLock);
+        while (mState != state) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    void waitForBuffers(size_t emptied, size_t filled) {
+        Mutex::Autolock autoLock(mLock);
+        while (mEmptied < emptied || mFilled.size() < filled) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    bool mVspScheduled;
+    MockEngine *mEngine;
+    sp<SprdOMXComponent> mComponent;
+    OMX_COMPONENTTYPE *mHandle;
+    OMX_BUFFERHEADERTYPE *mIn[kNumBuffers];
+    OMX_BUFFERHEADERTYPE *mOut[kNumBuffers];
+
+    Mutex mLock;
+    Condition mCondition;
+    OMX_STATETYPE mState;
+    int32_t mFlushed;
+    size_t mEmptied;
+    std::vector<OMX_BUFFERHEADERTYPE *> mFilled;
+    std::vector<OMX_TICKS> mTimeStamps;
+};
+
+// VSPMOCK_LATENCY_US sets the hardware time per frame, as for the mock
+// engines; 2 ms by default.
+TEST_P(SprdDecodeThreadTest, EveryFrameInOrder) {
+    const char *latency = getenv("VSPMOCK_LATENCY_US");
+    start(latency != NULL ? atoi(latency) : 2000);
+
+    // Keep every buffer in flight and recycle them as they come back.
+    const size_t kFrames = 60;
+    for (OMX_U32 i = 0; i < kNumBuffers; ++i) {
+        ASSERT_EQ(OMX_ErrorNone, OMX_FillThisBuffer(mHandle, mOut[i]));
+        emptyBuffer(i, i * 33333);
+    }
+    for (size_t frame = kNumBuffers; frame < kFrames; ++frame) {
+        OMX_BUFFERHEADERTYPE *out;
+        waitForBuffers(frame - kNumBuffers + 1, frame - kNumBuffers + 1);
+        {
+            Mutex::Autolock autoLock(mLock);
+            out = mFilled[frame - kNumBuffers];
+        }
+        ASSERT_EQ(OMX_ErrorNone, OMX_FillThisBuffer(mHandle, out));
+        emptyBuffer(frame % kNumBuffers, frame * 33333);
+    }
+    waitForBuffers(kFrames, kFrames);
+
+    EXPECT_EQ((int32_t)kFrames, mEngine->frames());
+    ASSERT_EQ(kFrames, mTimeStamps.size());
+    for (size_t i = 0; i < kFrames; ++i) {
+        EXPECT_EQ((OMX_TICKS)(i * 33333), mTimeStamps[i]) << "frame " << i;
+    }
+}
+
+// The component lock is only given up for the engine when decoding on
+// the decode thread; on the looper, binder calls wait for the frame.
+TEST_P(SprdDecodeThreadTest, GetParameterDuringEngineCall) {
+    const int32_t kLatencyMs = 200;
+    start(kLatencyMs * 1000);
+
+    ASSERT_EQ(OMX_ErrorNone, OMX_FillThisBuffer(mHandle, mOut[0]));
+    emptyBuffer(0, 0);
+    mEngine->waitUntilBusy();
+
+    int64_t startMs = nowMs();
+    OMX_PARAM_PORTDEFINITIONTYPE def;
+    InitOMXParams(&def);
+    def.nPortIndex = kInputPortIndex;
+    ASSERT_EQ(OMX_ErrorNone, OMX_GetParameter(mHandle, OMX_IndexParamPortDefinition, &def));
+    int64_t elapsedMs = nowMs() - startMs;
+
+    if (GetParam()) {
+        EXPECT_LT(elapsedMs, kLatencyMs / 2);
+    } else {
+        EXPECT_GE(elapsedMs, kLatencyMs / 2);
+    }
+    waitForBuffers(1, 1);
+}
+
+// Buffers handed over while the engine is busy are queued and decoded
+// once it is done; nothing is lost or returned twice.
+TEST_P(SprdDecodeThreadTest, BuffersArriveDuringEngineCall) {
+    const int32_t kLatencyMs = 50;
+    start(kLatencyMs * 1000);
+
+    ASSERT_EQ(OMX_ErrorNone, OMX_FillThisBuffer(mHandle, mOut[0]));
+    emptyBuffer(0, 0);
+    mEngine->waitUntilBusy();
+
+    for (OMX_U32 i = 1; i < kNumBuffers; ++i) {
+        ASSERT_EQ(OMX_ErrorNone, OMX_FillThisBuffer(mHandle, mOut[i]));
+        emptyBuffer(i, i);
+    }
+    waitForBuffers(kNumBuffers, kNumBuffers);
+
+    EXPECT_EQ((int32_t)kNumBuffers, mEngine->frames());
+    ASSERT_EQ((size_t)kNumBuffers, mTimeStamps.size());
+    for (size_t i = 0; i < kNumBuffers; ++i) {
+        EXPECT_EQ((OMX_TICKS)i, mTimeStamps[i]);
+    }
+}
+
+// A flush sent mid-frame completes once the engine returns, with every
+// buffer back with the client.
+TEST_P(SprdDecodeThreadTest, FlushDuringEngineCall) {
+    const int32_t kLatencyMs = 100;
+    start(kLatencyMs * 1000);
+
+    for (OMX_U32 i = 0; i < kNumBuffers; ++i) {
+        ASSERT_EQ(OMX_ErrorNone, OMX_FillThisBuffer(mHandle, mOut[i]));
+    }
+    for (OMX_U32 i = 0; i < kNumBuffers; ++i) {
+        emptyBuffer(i, i);
+    }
+    mEngine->waitUntilBusy();
+
+    ASSERT_EQ(OMX_ErrorNone, OMX_SendCommand(mHandle, OMX_CommandFlush, kInputPortIndex, NULL));
+    ASSERT_EQ(OMX_ErrorNone, OMX_SendCommand(mHandle, OMX_CommandFlush, kOutputPortIndex, NULL));
+    {
+        Mutex::Autolock autoLock(mLock);
+        while (mFlushed < 2) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    EXPECT_EQ((size_t)kNumBuffers, mEmptied);
+    EXPECT_EQ((size_t)kNumBuffers, mFilled.size());
+    EXPECT_GE(mTimeStamps.size(), 1u);
+}
+
+// Buffers and commands are handled in the order they were sent: a flush
+// returns the input queued before it but not the one queued after it,
+// even when both wait behind the same engine call.
+TEST_P(SprdDecodeThreadTest, BufferSentAfterFlushIsDecoded) {
+    const int32_t kLatencyMs = 100;
+    start(kLatencyMs * 1000);
+
+    ASSERT_EQ(OMX_ErrorNone, OMX_FillThisBuffer(mHandle, mOut[0]));
+    emptyBuffer(0, 0);
+    mEngine->waitUntilBusy();
+
+    emptyBuffer(1, 1);
+    ASSERT_EQ(OMX_ErrorNone, OMX_SendCommand(mHandle, OMX_CommandFlush, kInputPortIndex, NULL));
+    emptyBuffer(2, 2);
+    {
+        Mutex::Autolock autoLock(mLock);
+        while (mFlushed < 1) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    ASSERT_EQ(OMX_ErrorNone, OMX_FillThisBuffer(mHandle, mOut[1]));
+    {
+        Mutex::Autolock autoLock(mLock);
+        while (mTimeStamps.size() < 2) {
+            ASSERT_EQ(OK, mCondition.waitRelative(mLock, 2000000000ll))
+                    << "buffer sent after the flush was flushed";
+        }
+    }
+
+    EXPECT_EQ(2, mEngine->frames());
+    Mutex::Autolock autoLock(mLock);
+    EXPECT_EQ(3u, mEmptied);
+    EXPECT_EQ((OMX_TICKS)0, mTimeStamps[0]);
+    EXPECT_EQ((OMX_TICKS)2, mTimeStamps[1]);
+}
+
+struct FreeBufferJob {
+    OMX_COMPONENTTYPE *mHandle;
+    OMX_BUFFERHEADERTYPE *mHeader;
+    int64_t mDoneMs;
+};
+
+static void *freeBuffer(void *arg) {
+    FreeBufferJob *job = (FreeBufferJob *)arg;
+    OMX_FreeBuffer(job->mHandle, kOutputPortIndex, job->mHeader);
+    job->mDoneMs = nowMs();
+    return NULL;
+}
+
+// While a section waits for another session's turn on the core the
+// component lock is free for getParameter(), but a buffer the client
+// frees meanwhile only goes once the section has the lock back.
+TEST_P(SprdDecodeThreadTest, FreeBufferWaitsForScheduledSection) {
+    const int32_t kHoldMs = 150;
+    SprdVspScheduler *scheduler = SprdVspScheduler::getInstance();
+    int32_t holder;
+    ASSERT_EQ(OK, scheduler->registerSession("holder", SprdVspScheduler::kCoreDecoder,
+            320, 240, 30, SprdVspScheduler::kPriorityRealtime, &holder));
+    mVspScheduled = true;
+    start(1000);
+
+    scheduler->acquireEngine(holder);
+    ASSERT_EQ(OMX_ErrorNone, OMX_FillThisBuffer(mHandle, mOut[0]));
+    emptyBuffer(0, 0);
+    usleep(20000);
+
+    int64_t startMs = nowMs();
+    OMX_PARAM_PORTDEFINITIONTYPE def;
+    InitOMXParams(&def);
+    def.nPortIndex = kInputPortIndex;
+    ASSERT_EQ(OMX_ErrorNone, OMX_GetParameter(mHandle, OMX_IndexParamPortDefinition, &def));
+    EXPECT_LT(nowMs() - startMs, kHoldMs / 2);
+
+    FreeBufferJob job = { mHandle, mOut[1], 0 };
+    mOut[1] = NULL;
+    pthread_t thread;
+    pthread_create(&thread, NULL, freeBuffer, &job);
+
+    usleep(kHoldMs * 1000);
+    int64_t releaseMs = nowMs();
+    scheduler->releaseEngine(holder);
+
+    pthread_join(thread, NULL);
+    EXPECT_GE(job.mDoneMs, releaseMs);
+
+    waitForBuffers(1, 1);
+    scheduler->unregisterSession(holder);
+}
+
+INSTANTIATE_TEST_CASE_P(Looper, SprdDecodeThreadTest, ::testing::Values(false));
+INSTANTIATE_TEST_CASE_P(DecodeThread, SprdDecodeThreadTest, ::testing::Values(true));
+
+}  // namespace android
@@ -0,0 +1,349 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdEncoderInputRing_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <map>
+
+#include <cutils/atomic.h>
+#include <utils/threads.h>
+
+#include "SprdEncoderInputRing.h"
+
+namespace android {
+
+// Stands in for the prepareInput() of the encoders. It records which
+// header every slot was prepared with and on which thread, and can hold
+// the preparation of one header until the test lets it go.
+struct Preparer {
+    Preparer() : mGate(NULL), mInGate(false), mFail(NULL) {
+        for (int32_t i = 0; i < SprdEncoderInputRing::kMaxSlots; ++i) {
+            mSlots[i] = NULL;
+        }
+    }
+
+    static bool Prepare(void *cookie, OMX_BUFFERHEADERTYPE *header, int32_t slot) {
+        return static_cast<Preparer *>(cookie)->prepare(header, slot);
+    }
+
+    bool prepare(OMX_BUFFERHEADERTYPE *header, int32_t slot) {
+        Mutex::Autolock autoLock(mLock);
+        mSlots[slot] = header;
+        mCounts[header]++;
+        mThreads[header] = pthread_self();
+        while (mGate == header) {
+            mInGate = true;
+            mCondition.broadcast();
+            mCondition.wait(mLock);
+        }
+        mInGate = false;
+        return header != mFail;
+    }
+
+    void close(OMX_BUFFERHEADERTYPE *header) {
+        Mutex::Autolock autoLock(mLock);
+        mGate = header;
+    }
+
+    void waitInGate() {
+        Mutex::Autolock autoLock(mLock);
+        while (!mInGate) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    void open() {
+        Mutex::Autolock autoLock(mLock);
+        mGate = NULL;
+        mCondition.broadcast();
+    }
+
+    int32_t count(OMX_BUFFERHEADERTYPE *header) {
+        Mutex::Autolock autoLock(mLock);
+        return mCounts[header];
+    }
+
+    pthread_t thread(OMX_BUFFERHEADERTYPE *header) {
+        Mutex::Autolock autoLock(mLock);
+        return mThreads[header];
+    }
+
+    OMX_BUFFERHEADERTYPE *slot(int32_t index) {
+        Mutex::Autolock autoLock(mLock);
+        return mSlots[index];
+    }
+
+    void fail(OMX_BUFFERHEADERTYPE *header) {
+        Mutex::Autolock autoLock(mLock);
+        mFail = header;
+    }
+
+private:
+    Mutex mLock;
+    Condition mCondition;
+    OMX_BUFFERHEADERTYPE *mGate;
+    bool mInGate;
+    OMX_BUFFERHEADERTYPE *mFail;
+    OMX_BUFFERHEADERTYPE *mSlots[SprdEncoderInputRing::kMaxSlots];
+    std::map<OMX_BUFFERHEADERTYPE *, int32_t> mCounts;
+    std::map<OMX_BUFFERHEADERTYPE *, pthread_t> mThreads;
+};
+
+class SprdEncoderInputRingTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        memset(mHeaders, 0, sizeof(mHeaders));
+        mRing = new SprdEncoderInputRing("test", Preparer::Prepare, &mPreparer);
+        // vendor.omx.enc_input_slots is left at its default.
+        ASSERT_EQ(2, mRing->slotCount());
+        mRing->open();
+    }
+
+    virtual void TearDown() {
+        mPreparer.open();
+        delete mRing;
+    }
+
+    OMX_BUFFERHEADERTYPE mHeaders[8];
+    Preparer mPreparer;
+    SprdEncoderInputRing *mRing;
+};
+
+TEST_F(SprdEncoderInputRingTest, PreparesPrefetchedFrameOnRingThread) {
+    OMX_BUFFERHEADERTYPE *a = &mHeaders[0];
+
+    EXPECT_TRUE(mRing->prefetch(a));
+    mRing->waitIdle();
+
+    int32_t slot = mRing->acquire(a);
+    ASSERT_GE(slot, 0);
+    EXPECT_EQ(a, mPreparer.slot(slot));
+    EXPECT_EQ(1, mPreparer.count(a));
+    EXPECT_FALSE(pthread_equal(pthread_self(), mPreparer.thread(a)));
+    mRing->release(slot);
+}
+
+TEST_F(SprdEncoderInputRingTest, PrefetchNeedsOpenRingAndFreeSlot) {
+    mRing->discard();
+    EXPECT_FALSE(mRing->prefetch(&mHeaders[0]));
+
+    mRing->open();
+    EXPECT_TRUE(mRing->prefetch(&mHeaders[0]));
+    EXPECT_TRUE(mRing->prefetch(&mHeaders[0]));
+    EXPECT_TRUE(mRing->prefetch(&mHeaders[1]));
+    EXPECT_FALSE(mRing->prefetch(&mHeaders[2]));
+    mRing->waitIdle();
+    EXPECT_EQ(1, mPreparer.count(&mHeaders[0]));
+}
+
+// A frame still waiting for the busy ring thread is taken back and
+// prepared by acquire() itself, once.
+TEST_F(SprdEncoderInputRingTest, AcquireTakesBackQueuedFrame) {
+    OMX_BUFFERHEADERTYPE *a = &mHeaders[0];
+    OMX_BUFFERHEADERTYPE *b = &mHeaders[1];
+
+    mPreparer.close(a);
+    EXPECT_TRUE(mRing->prefetch(a));
+    mPreparer.waitInGate();
+    EXPECT_TRUE(mRing->prefetch(b));
+
+    int32_t slot = mRing->acquire(b);
+    ASSERT_GE(slot, 0);
+    EXPECT_EQ(b, mPreparer.slot(slot));
+    EXPECT_TRUE(pthread_equal(pthread_self(), mPreparer.thread(b)));
+
+    mPreparer.open();
+    mRing->waitIdle();
+    EXPECT_EQ(1, mPreparer.count(b));
+    mRing->release(slot);
+
+    slot = mRing->acquire(a);
+    ASSERT_GE(slot, 0);
+    EXPECT_EQ(a, mPreparer.slot(slot));
+    EXPECT_EQ(1, mPreparer.count(a));
+    mRing->release(slot);
+}
+
+// With every slot holding a later frame, acquire() drops a prepared one
+// and that frame is prepared again when its turn comes.
+TEST_F(SprdEncoderInputRingTest, AcquireStealsReadySlotWhenFull) {
+    OMX_BUFFERHEADERTYPE *a = &mHeaders[0];
+    OMX_BUFFERHEADERTYPE *b = &mHeaders[1];
+    OMX_BUFFERHEADERTYPE *c = &mHeaders[2];
+
+    EXPECT_TRUE(mRing->prefetch(a));
+    EXPECT_TRUE(mRing->prefetch(b));
+    mRing->waitIdle();
+
+    int32_t slot = mRing->acquire(c);
+    ASSERT_GE(slot, 0);
+    EXPECT_EQ(c, mPreparer.slot(slot));
+    mRing->release(slot);
+
+    int32_t kept = 0;
+    OMX_BUFFERHEADERTYPE *order[2] = { a, b };
+    for (int32_t i = 0; i < 2; ++i) {
+        int32_t count = mPreparer.count(order[i]);
+        slot = mRing->acquire(order[i]);
+        ASSERT_GE(slot, 0);
+        EXPECT_EQ(order[i], mPreparer.slot(slot));
+        if (mPreparer.count(order[i]) == count) {
+            kept++;
+        }
+        mRing->release(slot);
+    }
+    EXPECT_EQ(1, kept);
+}
+
+// The steal waits for a frame the ring thread is still preparing rather
+// than taking its slot.
+TEST_F(SprdEncoderInputRingTest, StealWaitsForPreparingSlot) {
+    OMX_BUFFERHEADERTYPE *a = &mHeaders[0];
+    OMX_BUFFERHEADERTYPE *b = &mHeaders[1];
+    OMX_BUFFERHEADERTYPE *c = &mHeaders[2];
+
+    EXPECT_TRUE(mRing->prefetch(a));
+    mRing->waitIdle();
+    mPreparer.close(b);
+    EXPECT_TRUE(mRing->prefetch(b));
+    mPreparer.waitInGate();
+
+    struct Acquirer {
+        static void *Run(void *me) {
+            Acquirer *acquirer = static_cast<Acquirer *>(me);
+            acquirer->mSlot = acquirer->mRing->acquire(acquirer->mHeader);
+            return NULL;
+        }
+        SprdEncoderInputRing *mRing;
+        OMX_BUFFERHEADERTYPE *mHeader;
+        int32_t mSlot;
+    } acquirer = { mRing, c, -2 };
+
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, NULL, Acquirer::Run, &acquirer));
+    usleep(50000);
+    EXPECT_EQ(0, mPreparer.count(c));
+
+    mPreparer.open();
+    pthread_join(thread, NULL);
+    ASSERT_GE(acquirer.mSlot, 0);
+    EXPECT_EQ(c, mPreparer.slot(acquirer.mSlot));
+    mRing->release(acquirer.mSlot);
+}
+
+TEST_F(SprdEncoderInputRingTest, FailedPreparationFreesSlot) {
+    OMX_BUFFERHEADERTYPE *a = &mHeaders[0];
+
+    mPreparer.fail(a);
+    EXPECT_TRUE(mRing->prefetch(a));
+    mRing->waitIdle();
+    EXPECT_EQ(-1, mRing->acquire(a));
+
+    // Both slots are free again.
+    EXPECT_TRUE(mRing->prefetch(&mHeaders[1]));
+    EXPECT_TRUE(mRing->prefetch(&mHeaders[2]));
+    mRing->waitIdle();
+}
+
+// discard() drops what is queued and returns only once the frame being
+// prepared is done, so the buffers can go back to the client.
+TEST_F(SprdEncoderInputRingTest, DiscardWaitsForPreparingFrame) {
+    OMX_BUFFERHEADERTYPE *a = &mHeaders[0];
+    OMX_BUFFERHEADERTYPE *b = &mHeaders[1];
+
+    mPreparer.close(a);
+    EXPECT_TRUE(mRing->prefetch(a));
+    mPreparer.waitInGate();
+    EXPECT_TRUE(mRing->prefetch(b));
+
+    struct Discarder {
+        static void *Run(void *me) {
+            Discarder *discarder = static_cast<Discarder *>(me);
+            discarder->mRing->discard();
+            android_atomic_release_store(1, &discarder->mDone);
+            return NULL;
+        }
+        SprdEncoderInputRing *mRing;
+        volatile int32_t mDone;
+    } discarder = { mRing, 0 };
+
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, NULL, Discarder::Run, &discarder));
+    usleep(50000);
+    EXPECT_EQ(0, android_atomic_acquire_load(&discarder.mDone));
+
+    mPreparer.open();
+    pthread_join(thread, NULL);
+    EXPECT_EQ(0, mPreparer.count(b));
+    EXPECT_FALSE(mRing->prefetch(b));
+
+    // Nothing survives the discard.
+    mRing->open();
+    int32_t slot = mRing->acquire(a);
+    ASSERT_GE(slot, 0);
+    EXPECT_EQ(2, mPreparer.count(a));
+    mRing->release(slot);
+}
+
+// The client's thread queues buffers while the looper encodes them in
+// order and now and then flushes, as with emptyThisBuffer() racing
+// onQueueFilled() and onPortFlushPrepare().
+TEST_F(SprdEncoderInputRingTest, PrefetchRacesAcquireAndDiscard) {
+    static const int32_t kFrames = 2000;
+
+    struct Client {
+        static void *Run(void *me) {
+            Client *client = static_cast<Client *>(me);
+            for (int32_t i = 0; i < kFrames; ++i) {
+                client->mRing->prefetch(&client->mHeaders[i % 8]);
+                if ((i & 7) == 0) {
+                    usleep(10);
+                }
+            }
+            return NULL;
+        }
+        SprdEncoderInputRing *mRing;
+        OMX_BUFFERHEADERTYPE *mHeaders;
+    } client = { mRing, mHeaders };
+
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, NULL, Client::Run, &client));
+    for (int32_t i = 0; i < kFrames; ++i) {
+        OMX_BUFFERHEADERTYPE *header = &mHeaders[i % 8];
+        int32_t slot = mRing->acquire(header);
+        ASSERT_GE(slot, 0);
+        ASSERT_EQ(header, mPreparer.slot(slot));
+        mRing->release(slot);
+
+        if (i % 97 == 0) {
+            mRing->discard();
+            mRing->open();
+        }
+    }
+    pthread_join(thread, NULL);
+    mRing->discard();
+}
+
+}  // namespace android
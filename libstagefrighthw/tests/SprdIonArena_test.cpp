@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdIonArena_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <vector>
+
+#include "SprdIonArena.h"
+#include "sprd_ion.h"
+
+namespace android {
+
+static const size_t kMB = 1024 * 1024;
+static const int kMaster = 0;
+
+// Maps blocks through the fake IOMMU of the mock libmemion, the way the
+// decoders go through their engine's get_iova/free_iova.
+struct Mapper {
+    Mapper() : mMaps(0), mUnmaps(0), mFail(false) {}
+
+    static int Map(void *cookie, int fd, unsigned long *iova, size_t *size) {
+        Mapper *me = static_cast<Mapper *>(cookie);
+        if (me->mFail) {
+            return -1;
+        }
+        me->mMaps++;
+        return MemIon::Get_iova(kMaster, fd, iova, size);
+    }
+
+    static void Unmap(void *cookie, unsigned long iova, size_t size) {
+        Mapper *me = static_cast<Mapper *>(cookie);
+        me->mUnmaps++;
+        MemIon::Free_iova(kMaster, iova, size);
+    }
+
+    int32_t mMaps;
+    int32_t mUnmaps;
+    bool mFail;
+};
+
+class SprdIonArenaTest : public ::testing::Test {
+protected:
+    SprdIonArenaTest()
+        : mArena("test", ION_HEAP_ID_MASK_SYSTEM, Mapper::Map, Mapper::Unmap, &mMapper) {
+    }
+
+    virtual void SetUp() {
+        mLiveBuffers = MemIon::Live_buffer_count();
+        mMappedIovas = MemIon::Mapped_iova_count();
+    }
+
+    virtual void TearDown() {
+        mArena.releaseAll();
+        EXPECT_EQ(mMapper.mMaps, mMapper.mUnmaps);
+        EXPECT_EQ(mLiveBuffers, MemIon::Live_buffer_count());
+        EXPECT_EQ(mMappedIovas, MemIon::Mapped_iova_count());
+    }
+
+    // One sequence of a 1080p AVC stream: extra memory, then an mbinfo
+    // region per reference frame.
+    void allocSequence(std::vector<SprdIonArena::Region> *regions, size_t extra,
+            size_t mbinfo, size_t frames) {
+        regions->clear();
+        SprdIonArena::Region region;
+        ASSERT_EQ(OK, mArena.alloc(extra, &region));
+        regions->push_back(region);
+        for (size_t i = 0; i < frames; ++i) {
+            ASSERT_EQ(OK, mArena.alloc(mbinfo, &region));
+            regions->push_back(region);
+        }
+    }
+
+    Mapper mMapper;
+    SprdIonArena mArena;
+    size_t mLiveBuffers;
+    size_t mMappedIovas;
+};
+
+static void expectDisjoint(const std::vector<SprdIonArena::Region> &regions) {
+    for (size_t i = 0; i < regions.size(); ++i) {
+        EXPECT_EQ(0u, regions[i].mPhy % 4096) << "region " << i;
+        for (size_t j = i + 1; j < regions.size(); ++j) {
+            bool apart = regions[i].mPhy + regions[i].mSize <= regions[j].mPhy
+                    || regions[j].mPhy + regions[j].mSize <= regions[i].mPhy;
+            EXPECT_TRUE(apart) << "regions " << i << " and " << j;
+            EXPECT_TRUE(regions[i].mVirt + regions[i].mSize <= regions[j].mVirt
+                    || regions[j].mVirt + regions[j].mSize <= regions[i].mVirt);
+        }
+    }
+}
+
+TEST_F(SprdIonArenaTest, RegionsShareOneMappedBlock) {
+    std::vector<SprdIonArena::Region> regions;
+    allocSequence(&regions, 300000, 34816, 17);
+
+    EXPECT_EQ(1, mMapper.mMaps);
+    EXPECT_EQ(mLiveBuffers + 1, MemIon::Live_buffer_count());
+    expectDisjoint(regions);
+
+    // The regions are backed by the memfd and do not overlap in memory.
+    for (size_t i = 0; i < regions.size(); ++i) {
+        memset(regions[i].mVirt, (int)i + 1, regions[i].mSize);
+    }
+    for (size_t i = 0; i < regions.size(); ++i) {
+        EXPECT_EQ((int)i + 1, regions[i].mVirt[0]);
+        EXPECT_EQ((int)i + 1, regions[i].mVirt[regions[i].mSize - 1]);
+    }
+}
+
+TEST_F(SprdIonArenaTest, ResetReusesBlocks) {
+    std::vector<SprdIonArena::Region> first;
+    allocSequence(&first, 300000, 34816, 17);
+    size_t mapped = mArena.mappedHighWater();
+
+    for (int32_t sequence = 0; sequence < 10; ++sequence) {
+        mArena.reset();
+        std::vector<SprdIonArena::Region> next;
+        allocSequence(&next, 300000, 34816, 17);
+        for (size_t i = 0; i < first.size(); ++i) {
+            EXPECT_EQ(first[i].mPhy, next[i].mPhy);
+            EXPECT_EQ(first[i].mVirt, next[i].mVirt);
+        }
+    }
+
+    EXPECT_EQ(1, mMapper.mMaps);
+    EXPECT_EQ(0, mMapper.mUnmaps);
+    EXPECT_EQ(mapped, mArena.mappedHighWater());
+}
+
+// A resolution switch to a larger stream spills into a second block;
+// the sequence after it is served from one block of the combined size.
+TEST_F(SprdIonArenaTest, SpilledSequenceIsCompacted) {
+    std::vector<SprdIonArena::Region> regions;
+    allocSequence(&regions, 300000, 34816, 4);
+    EXPECT_EQ(1, mMapper.mMaps);
+
+    // The 3 MB extra region gets a block of its own, and the last mbinfo
+    // regions no longer fit into the first block.
+    mArena.reset();
+    allocSequence(&regions, 3 * kMB, 139264, 17);
+    EXPECT_EQ(3, mMapper.mMaps);
+    expectDisjoint(regions);
+    size_t inUse = mArena.inUseHighWater();
+    EXPECT_GE(inUse, 3 * kMB + 17 * 139264);
+
+    mArena.reset();
+    allocSequence(&regions, 3 * kMB, 139264, 17);
+    EXPECT_EQ(4, mMapper.mMaps);
+    EXPECT_EQ(3, mMapper.mUnmaps);
+    EXPECT_EQ(mLiveBuffers + 1, MemIon::Live_buffer_count());
+    expectDisjoint(regions);
+
+    // And stays there.
+    mArena.reset();
+    allocSequence(&regions, 3 * kMB, 139264, 17);
+    EXPECT_EQ(4, mMapper.mMaps);
+    EXPECT_EQ(inUse, mArena.inUseHighWater());
+}
+
+TEST_F(SprdIonArenaTest, HighWaterMarks) {
+    SprdIonArena::Region region;
+    ASSERT_EQ(OK, mArena.alloc(5000, &region));
+    EXPECT_EQ(8192u, mArena.inUseHighWater());
+    EXPECT_EQ(2 * kMB, mArena.mappedHighWater());
+
+    ASSERT_EQ(OK, mArena.alloc(3 * kMB, &region));
+    EXPECT_EQ(8192u + 3 * kMB, mArena.inUseHighWater());
+    EXPECT_EQ(2 * kMB + 3 * kMB, mArena.mappedHighWater());
+
+    // Neither mark goes down with a smaller sequence.
+    mArena.reset();
+    ASSERT_EQ(OK, mArena.alloc(4096, &region));
+    EXPECT_EQ(8192u + 3 * kMB, mArena.inUseHighWater());
+    EXPECT_GE(mArena.mappedHighWater(), 5 * kMB);
+}
+
+TEST_F(SprdIonArenaTest, MapFailure) {
+    mMapper.mFail = true;
+    SprdIonArena::Region region;
+    EXPECT_NE(OK, mArena.alloc(4096, &region));
+    EXPECT_EQ(mLiveBuffers, MemIon::Live_buffer_count());
+
+    mMapper.mFail = false;
+    EXPECT_EQ(OK, mArena.alloc(4096, &region));
+    EXPECT_EQ(1, mMapper.mMaps);
+}
+
+// Without an IOMMU the blocks are addressed by their ION physical address.
+TEST(SprdIonArenaPhysicalTest, UsesIonPhysicalAddress) {
+    size_t liveBuffers = MemIon::Live_buffer_count();
+    size_t mappedIovas = MemIon::Mapped_iova_count();
+
+    SprdIonArena arena("test", ION_HEAP_ID_MASK_MM, NULL, NULL, NULL);
+    SprdIonArena::Region first;
+    SprdIonArena::Region second;
+    ASSERT_EQ(OK, arena.alloc(100, &first));
+    ASSERT_EQ(OK, arena.alloc(100, &second));
+    EXPECT_NE(0u, first.mPhy);
+    EXPECT_EQ(first.mPhy + 4096, second.mPhy);
+    EXPECT_EQ(first.mVirt + 4096, second.mVirt);
+    EXPECT_EQ(mappedIovas, MemIon::Mapped_iova_count());
+
+    arena.releaseAll();
+    EXPECT_EQ(liveBuffers, MemIon::Live_buffer_count());
+}
+
+}  // namespace android
@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdOutputPacker_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <stddef.h>
+#include <string.h>
+
+#include <vector>
+
+#include <OMX_Other.h>
+
+#include "SprdOutputPacker.h"
+
+namespace android {
+
+static const size_t kHeaderSize = offsetof(OMX_OTHER_EXTRADATATYPE, data);
+
+static size_t align4(size_t size) {
+    return (size + 3) & ~(size_t)3;
+}
+
+// What finish() writes behind the payload of a buffer of frames frames,
+// at most; room() holds this back for maxFrames().
+static size_t extraDataSize(size_t frames) {
+    return 3
+            + align4(kHeaderSize + offsetof(SprdPackedFrameList, frames)
+                    + frames * sizeof(SprdPackedFrameInfo))
+            + align4(kHeaderSize);
+}
+
+struct Buffer {
+    explicit Buffer(size_t size) : mData(size, 0xee) {
+        memset(&mHeader, 0, sizeof(mHeader));
+        mHeader.pBuffer = &mData[0];
+        mHeader.nAllocLen = size;
+    }
+
+    std::vector<OMX_U8> mData;
+    OMX_BUFFERHEADERTYPE mHeader;
+};
+
+// Writes a frame of size bytes of value where the packer wants it, the
+// way the encoders copy theirs out of the stream buffer.
+static bool writeFrame(
+        SprdOutputPacker *packer, Buffer *buffer, OMX_TICKS timeUs,
+        size_t size, OMX_U8 value, OMX_U32 flags = OMX_BUFFERFLAG_ENDOFFRAME) {
+    OMX_U8 *target = packer->frameTarget(&buffer->mHeader, size);
+    if (target == NULL) {
+        return false;
+    }
+    memset(target, value, size);
+    packer->append(&buffer->mHeader, timeUs, size, flags);
+    return true;
+}
+
+static const OMX_OTHER_EXTRADATATYPE *frameList(const Buffer &buffer) {
+    const OMX_BUFFERHEADERTYPE &h = buffer.mHeader;
+    return (const OMX_OTHER_EXTRADATATYPE *)
+            (h.pBuffer + align4(h.nOffset + h.nFilledLen));
+}
+
+static SprdPackedFrameInfo frameInfo(const Buffer &buffer, size_t i) {
+    SprdPackedFrameInfo info;
+    memcpy(&info, frameList(buffer)->data + offsetof(SprdPackedFrameList, frames)
+            + i * sizeof(SprdPackedFrameInfo), sizeof(info));
+    return info;
+}
+
+TEST(SprdOutputPackerTest, WritesFrameListBehindPayload) {
+    SprdOutputPacker packer;
+    packer.setMaxFrames(4);
+    Buffer buffer(4096);
+
+    ASSERT_TRUE(writeFrame(&packer, &buffer, 1000, 101, 1,
+            OMX_BUFFERFLAG_ENDOFFRAME | OMX_BUFFERFLAG_SYNCFRAME));
+    ASSERT_TRUE(writeFrame(&packer, &buffer, 2000, 57, 2));
+    packer.finish(&buffer.mHeader);
+
+    const OMX_BUFFERHEADERTYPE &h = buffer.mHeader;
+    EXPECT_EQ(158u, h.nFilledLen);
+    EXPECT_EQ(1000, h.nTimeStamp);
+    EXPECT_TRUE(h.nFlags & OMX_BUFFERFLAG_EXTRADATA);
+    EXPECT_TRUE(h.nFlags & OMX_BUFFERFLAG_SYNCFRAME);
+    EXPECT_EQ(1, h.pBuffer[100]);
+    EXPECT_EQ(2, h.pBuffer[101]);
+
+    const OMX_OTHER_EXTRADATATYPE *extra = frameList(buffer);
+    EXPECT_EQ(OMX_ExtraDataSprdFrameList, extra->eType);
+    OMX_U32 frames;
+    memcpy(&frames, extra->data, sizeof(frames));
+    EXPECT_EQ(2u, frames);
+    EXPECT_EQ(0u, frameInfo(buffer, 0).nOffset);
+    EXPECT_EQ(101u, frameInfo(buffer, 0).nSize);
+    EXPECT_EQ(101u, frameInfo(buffer, 1).nOffset);
+    EXPECT_EQ(57u, frameInfo(buffer, 1).nSize);
+    EXPECT_EQ(2000, frameInfo(buffer, 1).nTimeStamp);
+
+    const OMX_OTHER_EXTRADATATYPE *terminator =
+        (const OMX_OTHER_EXTRADATATYPE *)((const OMX_U8 *)extra + extra->nSize);
+    EXPECT_EQ(OMX_ExtraDataNone, terminator->eType);
+    EXPECT_LE((size_t)((const OMX_U8 *)terminator - h.pBuffer) + align4(kHeaderSize),
+            (size_t)h.nAllocLen);
+
+    EXPECT_EQ(NULL, packer.pending());
+    EXPECT_EQ(0u, packer.frameCount());
+}
+
+TEST(SprdOutputPackerTest, StopsAtFrameLimit) {
+    SprdOutputPacker packer;
+    packer.setMaxFrames(3);
+    Buffer buffer(4096);
+
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_FALSE(packer.isFull(&buffer.mHeader, 10));
+        ASSERT_TRUE(writeFrame(&packer, &buffer, i, 10, i));
+    }
+    EXPECT_TRUE(packer.isFull(&buffer.mHeader, 10));
+}
+
+// A frame that takes exactly the room left goes behind the others; one
+// byte more has to wait for the next buffer.
+TEST(SprdOutputPackerTest, FillsBufferToTheLastByte) {
+    SprdOutputPacker packer;
+    packer.setMaxFrames(8);
+    Buffer buffer(1024);
+
+    ASSERT_TRUE(writeFrame(&packer, &buffer, 0, 100, 1));
+    size_t room = packer.room(&buffer.mHeader);
+    EXPECT_EQ(1024 - 100 - extraDataSize(8), room);
+
+    EXPECT_EQ(packer.tail(&buffer.mHeader), packer.frameTarget(&buffer.mHeader, room));
+    packer.append(&buffer.mHeader, 1, room, OMX_BUFFERFLAG_ENDOFFRAME);
+    EXPECT_EQ(0u, packer.room(&buffer.mHeader));
+    EXPECT_TRUE(packer.isFull(&buffer.mHeader, 1));
+
+    // Still room for the list of 2 of the 8 frames.
+    packer.finish(&buffer.mHeader);
+    EXPECT_EQ(100 + room, buffer.mHeader.nFilledLen);
+    EXPECT_TRUE(buffer.mHeader.nFlags & OMX_BUFFERFLAG_EXTRADATA);
+}
+
+TEST(SprdOutputPackerTest, SetsAsideFrameThatDoesNotFit) {
+    SprdOutputPacker packer;
+    packer.setMaxFrames(8);
+    Buffer first(1024);
+    Buffer second(1024);
+
+    ASSERT_TRUE(writeFrame(&packer, &first, 1000, 600, 1));
+    size_t size = packer.room(&first.mHeader) + 1;
+    OMX_U8 *target = packer.frameTarget(&first.mHeader, size);
+    ASSERT_TRUE(target != NULL);
+    EXPECT_NE(packer.tail(&first.mHeader), target);
+    memset(target, 2, size);
+    EXPECT_FALSE(packer.append(&first.mHeader, 2000, size,
+            OMX_BUFFERFLAG_ENDOFFRAME | OMX_BUFFERFLAG_EOS));
+    EXPECT_TRUE(packer.hasSetAside());
+
+    // The first buffer goes back with its one frame only.
+    EXPECT_EQ(600u, first.mHeader.nFilledLen);
+    EXPECT_EQ(1u, packer.frameCount());
+    EXPECT_EQ(0xee, first.mData[600]);
+    packer.finish(&first.mHeader);
+    EXPECT_FALSE(first.mHeader.nFlags & OMX_BUFFERFLAG_EOS);
+
+    OMX_U32 flags = packer.placeSetAside(&second.mHeader);
+    EXPECT_TRUE(flags & OMX_BUFFERFLAG_EOS);
+    EXPECT_FALSE(packer.hasSetAside());
+    EXPECT_EQ(size, second.mHeader.nFilledLen);
+    EXPECT_EQ(2000, second.mHeader.nTimeStamp);
+    EXPECT_EQ(2, second.mData[0]);
+    EXPECT_EQ(2, second.mData[size - 1]);
+
+    packer.finish(&second.mHeader);
+    EXPECT_TRUE(second.mHeader.nFlags & OMX_BUFFERFLAG_EOS);
+    EXPECT_EQ(size, frameInfo(second, 0).nSize);
+}
+
+// A frame alone in the buffer may use the space of the frame list; the
+// buffer then goes back without one.
+TEST(SprdOutputPackerTest, ReturnsLoneFrameWithoutFrameList) {
+    SprdOutputPacker packer;
+    packer.setMaxFrames(8);
+    Buffer buffer(1024);
+
+    ASSERT_TRUE(writeFrame(&packer, &buffer, 1000, 1022, 1,
+            OMX_BUFFERFLAG_ENDOFFRAME | OMX_BUFFERFLAG_SYNCFRAME));
+    EXPECT_TRUE(packer.isFull(&buffer.mHeader, packer.largestFrame()));
+    packer.finish(&buffer.mHeader);
+
+    EXPECT_EQ(1022u, buffer.mHeader.nFilledLen);
+    EXPECT_FALSE(buffer.mHeader.nFlags & OMX_BUFFERFLAG_EXTRADATA);
+    EXPECT_TRUE(buffer.mHeader.nFlags & OMX_BUFFERFLAG_SYNCFRAME);
+    EXPECT_EQ(0xee, buffer.mData[1022]);
+    EXPECT_EQ(NULL, packer.pending());
+}
+
+// The same for a set-aside frame that fills the next buffer.
+TEST(SprdOutputPackerTest, PlacesLargeSetAsideFrameAlone) {
+    SprdOutputPacker packer;
+    packer.setMaxFrames(8);
+    Buffer first(1024);
+    Buffer second(1024);
+
+    ASSERT_TRUE(writeFrame(&packer, &first, 0, 100, 1));
+    ASSERT_TRUE(writeFrame(&packer, &first, 1, 1024, 2));
+    EXPECT_TRUE(packer.hasSetAside());
+    packer.finish(&first.mHeader);
+
+    packer.placeSetAside(&second.mHeader);
+    EXPECT_TRUE(packer.isFull(&second.mHeader, packer.largestFrame()));
+    packer.finish(&second.mHeader);
+    EXPECT_EQ(1024u, second.mHeader.nFilledLen);
+    EXPECT_FALSE(second.mHeader.nFlags & OMX_BUFFERFLAG_EXTRADATA);
+}
+
+TEST(SprdOutputPackerTest, RejectsFrameLargerThanBuffer) {
+    SprdOutputPacker packer;
+    packer.setMaxFrames(8);
+    Buffer buffer(1024);
+
+    EXPECT_EQ(NULL, packer.frameTarget(&buffer.mHeader, 1025));
+
+    ASSERT_TRUE(writeFrame(&packer, &buffer, 0, 100, 1));
+    EXPECT_EQ(NULL, packer.frameTarget(&buffer.mHeader, 1025));
+    EXPECT_FALSE(packer.hasSetAside());
+
+    buffer.mHeader.nOffset = 16;
+    EXPECT_EQ(NULL, packer.frameTarget(&buffer.mHeader, 1024 - 15));
+}
+
+// Without packing every frame has the buffer to itself.
+TEST(SprdOutputPackerTest, UnpackedFrameTakesWholeBuffer) {
+    SprdOutputPacker packer;
+    Buffer buffer(1024);
+
+    EXPECT_FALSE(packer.enabled());
+    EXPECT_EQ(buffer.mHeader.pBuffer, packer.frameTarget(&buffer.mHeader, 1024));
+    EXPECT_EQ(NULL, packer.frameTarget(&buffer.mHeader, 1025));
+}
+
+TEST(SprdOutputPackerTest, ResetDropsSetAsideFrame) {
+    SprdOutputPacker packer;
+    packer.setMaxFrames(8);
+    Buffer buffer(1024);
+
+    ASSERT_TRUE(writeFrame(&packer, &buffer, 0, 900, 1));
+    ASSERT_TRUE(writeFrame(&packer, &buffer, 1, 900, 2));
+    EXPECT_TRUE(packer.hasSetAside());
+
+    int32_t generation = packer.generation();
+    packer.reset();
+    EXPECT_FALSE(packer.hasSetAside());
+    EXPECT_EQ(0u, packer.frameCount());
+    EXPECT_EQ(NULL, packer.pending());
+    EXPECT_NE(generation, packer.generation());
+    EXPECT_EQ(0u, packer.largestFrame());
+}
+
+TEST(SprdOutputPackerTest, WritesStartCodeOnlyIntoFramesThatHoldOne) {
+    OMX_U8 frame[8];
+    memset(frame, 0xff, sizeof(frame));
+
+    EXPECT_FALSE(SprdOutputPacker::writeStartCode(frame, 3));
+    EXPECT_EQ(0xff, frame[0]);
+    EXPECT_EQ(0xff, frame[2]);
+
+    EXPECT_TRUE(SprdOutputPacker::writeStartCode(frame, 4));
+    EXPECT_EQ(0x00, frame[0]);
+    EXPECT_EQ(0x00, frame[1]);
+    EXPECT_EQ(0x00, frame[2]);
+    EXPECT_EQ(0x01, frame[3]);
+    EXPECT_EQ(0xff, frame[4]);
+}
+
+}  // namespace android
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Per-buffer cost of EmptyThisBuffer/FillThisBuffer on a component that
+// returns every buffer as soon as onQueueFilled() sees it, with the
+// lock-free buffer rings and with one AMessage per buffer as before them.
+//
+//   sprd_etb_ftb_bench [buffers [rounds]]
+//
+// The default is 16 buffers per port over 20000 rounds. "etb"/"ftb" are
+// the time the client spends inside each call, "round trip" the time from
+// the first call of a round until every buffer came back, per buffer.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <OMX_Component.h>
+#include <OMX_Core.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <utils/Timers.h>
+#include <utils/threads.h>
+
+#include "SprdSimpleOMXComponent.h"
+
+using namespace android;
+
+template<class T>
+static void InitOMXParams(T *params) {
+    params->nSize = sizeof(T);
+    params->nVersion.s.nVersionMajor = 1;
+    params->nVersion.s.nVersionMinor = 0;
+    params->nVersion.s.nRevision = 0;
+    params->nVersion.s.nStep = 0;
+}
+
+struct PassthroughComponent : public SprdSimpleOMXComponent {
+    PassthroughComponent(
+            const OMX_CALLBACKTYPE *callbacks,
+            OMX_PTR appData,
+            OMX_COMPONENTTYPE **component,
+            OMX_U32 buffers,
+            bool bufferRing)
+        : SprdSimpleOMXComponent("OMX.sprd.bench.passthrough", callbacks, appData, component) {
+        setBufferRingEnabled(bufferRing);
+
+        OMX_PARAM_PORTDEFINITIONTYPE def;
+        InitOMXParams(&def);
+        def.eDir = OMX_DirInput;
+        def.nBufferCountMin = buffers;
+        def.nBufferCountActual = buffers;
+        def.nBufferSize = 4096;
+        def.bEnabled = OMX_TRUE;
+        def.bPopulated = OMX_FALSE;
+        def.eDomain = OMX_PortDomainOther;
+        def.bBuffersContiguous = OMX_FALSE;
+        def.nBufferAlignment = 1;
+        def.format.other.eFormat = OMX_OTHER_FormatBinary;
+
+        def.nPortIndex = kInputPortIndex;
+        addPort(def);
+
+        def.nPortIndex = kOutputPortIndex;
+        def.eDir = OMX_DirOutput;
+        addPort(def);
+    }
+
+protected:
+    virtual void onQueueFilled(OMX_U32 /* portIndex */) {
+        PortQueue &inQueue = getPortQueue(kInputPortIndex);
+        while (!inQueue.empty()) {
+            BufferInfo *inInfo = *inQueue.begin();
+            inInfo->mOwnedByUs = false;
+            inQueue.erase(inQueue.begin());
+            notifyEmptyBufferDone(inInfo->mHeader);
+        }
+
+        PortQueue &outQueue = getPortQueue(kOutputPortIndex);
+        while (!outQueue.empty()) {
+            BufferInfo *outInfo = *outQueue.begin();
+            outInfo->mHeader->nFilledLen = 0;
+            outInfo->mOwnedByUs = false;
+            outQueue.erase(outQueue.begin());
+            notifyFillBufferDone(outInfo->mHeader);
+        }
+    }
+
+private:
+    DISALLOW_EVIL_CONSTRUCTORS(PassthroughComponent);
+};
+
+struct Client {
+    Client() : mState(OMX_StateLoaded), mEmptied(0), mFilled(0) {}
+
+    Mutex mLock;
+    Condition mCondition;
+    OMX_STATETYPE mState;
+    size_t mEmptied;
+    size_t mFilled;
+
+    static OMX_ERRORTYPE OnEvent(
+            OMX_HANDLETYPE, OMX_PTR appData, OMX_EVENTTYPE event,
+            OMX_U32 data1, OMX_U32 data2, OMX_PTR) {
+        Client *me = static_cast<Client *>(appData);
+        if (event == OMX_EventCmdComplete && data1 == OMX_CommandStateSet) {
+            Mutex::Autolock autoLock(me->mLock);
+            me->mState = (OMX_STATETYPE)data2;
+            me->mCondition.signal();
+        }
+        return OMX_ErrorNone;
+    }
+
+    static OMX_ERRORTYPE OnEmptyBufferDone(
+            OMX_HANDLETYPE, OMX_PTR appData, OMX_BUFFERHEADERTYPE *) {
+        Client *me = static_cast<Client *>(appData);
+        Mutex::Autolock autoLock(me->mLock);
+        me->mEmptied++;
+        me->mCondition.signal();
+        return OMX_ErrorNone;
+    }
+
+    static OMX_ERRORTYPE OnFillBufferDone(
+            OMX_HANDLETYPE, OMX_PTR appData, OMX_BUFFERHEADERTYPE *) {
+        Client *me = static_cast<Client *>(appData);
+        Mutex::Autolock autoLock(me->mLock);
+        me->mFilled++;
+        me->mCondition.signal();
+        return OMX_ErrorNone;
+    }
+
+    void waitForState(OMX_STATETYPE state) {
+        Mutex::Autolock autoLock(mLock);
+        while (mState != state) {
+            mCondition.wait(mLock);
+        }
+    }
+
+    void waitForBuffers(size_t emptied, size_t filled) {
+        Mutex::Autolock autoLock(mLock);
+        while (mEmptied < emptied || mFilled < filled) {
+            mCondition.wait(mLock);
+        }
+    }
+};
+
+struct Result {
+    double mEtbNs;
+    double mFtbNs;
+    double mRoundTripNs;
+};
+
+static Result run(bool bufferRing, OMX_U32 buffers, int32_t rounds) {
+    static const OMX_CALLBACKTYPE kCallbacks = {
+        Client::OnEvent, Client::OnEmptyBufferDone, Client::OnFillBufferDone,
+    };
+
+    Client client;
+    OMX_COMPONENTTYPE *handle;
+    sp<SprdOMXComponent> component =
+            new PassthroughComponent(&kCallbacks, &client, &handle, buffers, bufferRing);
+
+    OMX_BUFFERHEADERTYPE **in = new OMX_BUFFERHEADERTYPE *[buffers];
+    OMX_BUFFERHEADERTYPE **out = new OMX_BUFFERHEADERTYPE *[buffers];
+
+    OMX_SendCommand(handle, OMX_CommandStateSet, OMX_StateIdle, NULL);
+    for (OMX_U32 i = 0; i < buffers; ++i) {
+        CHECK_EQ(OMX_AllocateBuffer(handle, &in[i], kInputPortIndex, NULL, 4096),
+                OMX_ErrorNone);
+        CHECK_EQ(OMX_AllocateBuffer(handle, &out[i], kOutputPortIndex, NULL, 4096),
+                OMX_ErrorNone);
+    }
+    client.waitForState(OMX_StateIdle);
+    OMX_SendCommand(handle, OMX_CommandStateSet, OMX_StateExecuting, NULL);
+    client.waitForState(OMX_StateExecuting);
+
+    nsecs_t etb = 0;
+    nsecs_t ftb = 0;
+    nsecs_t roundTrip = 0;
+    for (int32_t round = 0; round < rounds; ++round) {
+        nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+        for (OMX_U32 i = 0; i < buffers; ++i) {
+            in[i]->nFilledLen = 1;
+            in[i]->nOffset = 0;
+            in[i]->nFlags = 0;
+            OMX_EmptyThisBuffer(handle, in[i]);
+        }
+        nsecs_t mid = systemTime(SYSTEM_TIME_MONOTONIC);
+        for (OMX_U32 i = 0; i < buffers; ++i) {
+            OMX_FillThisBuffer(handle, out[i]);
+        }
+        nsecs_t end = systemTime(SYSTEM_TIME_MONOTONIC);
+
+        client.waitForBuffers((size_t)(round + 1) * buffers, (size_t)(round + 1) * buffers);
+
+        etb += mid - start;
+        ftb += end - mid;
+        roundTrip += systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    }
+
+    OMX_SendCommand(handle, OMX_CommandStateSet, OMX_StateIdle, NULL);
+    client.waitForState(OMX_StateIdle);
+    OMX_SendCommand(handle, OMX_CommandStateSet, OMX_StateLoaded, NULL);
+    for (OMX_U32 i = 0; i < buffers; ++i) {
+        OMX_FreeBuffer(handle, kInputPortIndex, in[i]);
+        OMX_FreeBuffer(handle, kOutputPortIndex, out[i]);
+    }
+    client.waitForState(OMX_StateLoaded);
+
+    component->prepareForDestruction();
+    component.clear();
+    delete[] in;
+    delete[] out;
+
+    double count = (double)rounds * buffers;
+    Result result;
+    result.mEtbNs = etb / count;
+    result.mFtbNs = ftb / count;
+    result.mRoundTripNs = roundTrip / count / 2;
+    return result;
+}
+
+int main(int argc, char **argv) {
+    int32_t buffers = 16;
+    int32_t rounds = 20000;
+    if (argc >= 2) {
+        buffers = atoi(argv[1]);
+    }
+    if (argc >= 3) {
+        rounds = atoi(argv[2]);
+    }
+    if (buffers <= 0 || buffers > 64 || rounds <= 0) {
+        fprintf(stderr, "usage: %s [buffers (1-64) [rounds]]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%d buffers per port, %d rounds\n", buffers, rounds);
+    printf("%-10s %10s %10s %16s\n", "path", "etb ns", "ftb ns", "round trip ns");
+
+    // One untimed run to start the threads and fault the heap in.
+    run(true, buffers, rounds / 10 + 1);
+
+    Result message = run(false, buffers, rounds);
+    Result ring = run(true, buffers, rounds);
+    printf("%-10s %10.0f %10.0f %16.0f\n", "amessage", message.mEtbNs, message.mFtbNs,
+            message.mRoundTripNs);
+    printf("%-10s %10.0f %10.0f %16.0f\n", "ring", ring.mEtbNs, ring.mFtbNs,
+            ring.mRoundTripNs);
+    return 0;
+}
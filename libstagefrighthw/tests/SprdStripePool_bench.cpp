@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs the encoder input passes on stripe pools of 1 to 8 threads and
+// prints the time per frame and the speedup over one thread.
+//
+//   sprd_stripe_pool_bench [width height [frames]]
+//
+// The default is 3840x2160 over 50 frames. Scaling is bounded by the
+// online CPUs and, for the copies, by memory bandwidth.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <utils/Timers.h>
+
+#include "SprdColorConvert.h"
+#include "SprdStripePool.h"
+
+using namespace android;
+
+struct Frame {
+    int32_t mWidth;
+    int32_t mHeight;
+    uint8_t *mRGB;
+    uint8_t *mYUV;
+    uint8_t *mPadded;
+};
+
+static void runRGB(SprdStripePool *pool, Frame *frame) {
+    SprdConvertRGBFrameToSemiPlanar(frame->mRGB, kSprdRgbLayoutRGBA, kSprdColorBT601Limited,
+            frame->mWidth, frame->mHeight, frame->mYUV, frame->mWidth, frame->mHeight,
+            kSprdChromaVU, SprdStripePool::Run, pool);
+}
+
+static void runI420(SprdStripePool *pool, Frame *frame) {
+    // The RGB buffer doubles as the I420 source.
+    SprdConvertI420FrameToSemiPlanar(frame->mRGB, frame->mWidth, frame->mHeight,
+            frame->mYUV, frame->mWidth, frame->mHeight, kSprdChromaVU,
+            SprdStripePool::Run, pool);
+}
+
+static void runCopy(SprdStripePool *pool, Frame *frame) {
+    pool->copy(frame->mYUV, frame->mRGB, (size_t)frame->mWidth * frame->mHeight * 3 / 2);
+}
+
+// Luma padded by 16 columns, as for a width that is not a multiple of 16.
+static void runPad(SprdStripePool *pool, Frame *frame) {
+    pool->copyPadded(frame->mPadded, frame->mWidth + 16, frame->mYUV, frame->mWidth,
+            frame->mHeight, 1);
+}
+
+static const struct {
+    const char *mName;
+    void (*mRun)(SprdStripePool *pool, Frame *frame);
+} kPasses[] = {
+    { "rgba->nv21", runRGB },
+    { "i420->nv21", runI420 },
+    { "copy", runCopy },
+    { "pad luma", runPad },
+};
+
+int main(int argc, char **argv) {
+    Frame frame;
+    frame.mWidth = 3840;
+    frame.mHeight = 2160;
+    int32_t frames = 50;
+    if (argc >= 3) {
+        frame.mWidth = atoi(argv[1]);
+        frame.mHeight = atoi(argv[2]);
+    }
+    if (argc >= 4) {
+        frames = atoi(argv[3]);
+    }
+    if (frame.mWidth <= 0 || frame.mHeight <= 0 || frames <= 0
+            || (frame.mWidth & 1) || (frame.mHeight & 1)) {
+        fprintf(stderr, "usage: %s [width height [frames]], even sizes\n", argv[0]);
+        return 1;
+    }
+
+    size_t pixels = (size_t)frame.mWidth * frame.mHeight;
+    frame.mRGB = (uint8_t *)malloc(pixels * 4);
+    frame.mYUV = (uint8_t *)malloc(pixels * 3 / 2);
+    frame.mPadded = (uint8_t *)malloc((size_t)(frame.mWidth + 16) * frame.mHeight);
+    for (size_t i = 0; i < pixels * 4; ++i) {
+        frame.mRGB[i] = (uint8_t)(i * 2654435761u >> 24);
+    }
+    memset(frame.mYUV, 0, pixels * 3 / 2);
+    memset(frame.mPadded, 0, (size_t)(frame.mWidth + 16) * frame.mHeight);
+
+    printf("%dx%d, %d frames, %ld online CPUs, %s kernels\n", frame.mWidth, frame.mHeight,
+            frames, sysconf(_SC_NPROCESSORS_ONLN), SprdColorConvertKernelName());
+    printf("%-12s %7s %10s %8s\n", "pass", "threads", "ms/frame", "speedup");
+
+    for (size_t p = 0; p < sizeof(kPasses) / sizeof(kPasses[0]); ++p) {
+        double single = 0;
+        for (int32_t threads = 1; threads <= SprdStripePool::kMaxThreads; ++threads) {
+            SprdStripePool pool(threads);
+
+            // One untimed frame to fault the pages in and wake the workers.
+            (*kPasses[p].mRun)(&pool, &frame);
+
+            nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+            for (int32_t i = 0; i < frames; ++i) {
+                (*kPasses[p].mRun)(&pool, &frame);
+            }
+            double ms = (systemTime(SYSTEM_TIME_MONOTONIC) - start) / 1e6 / frames;
+            if (threads == 1) {
+                single = ms;
+            }
+
+            printf("%-12s %7d %10.3f %7.2fx\n", kPasses[p].mName, pool.threadCount(), ms,
+                    single / ms);
+        }
+    }
+
+    free(frame.mRGB);
+    free(frame.mYUV);
+    free(frame.mPadded);
+    return 0;
+}
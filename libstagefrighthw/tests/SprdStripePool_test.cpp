@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdStripePool_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <utils/threads.h>
+
+#include "SprdColorConvert.h"
+#include "SprdStripePool.h"
+
+namespace android {
+
+struct Coverage {
+    Mutex mLock;
+    std::vector<int32_t> mHits;
+    int32_t mAlign;
+    bool mMisaligned;
+};
+
+static void countRows(void *cookie, int32_t begin, int32_t end) {
+    Coverage *coverage = static_cast<Coverage *>(cookie);
+    Mutex::Autolock autoLock(coverage->mLock);
+    if (begin % coverage->mAlign != 0) {
+        coverage->mMisaligned = true;
+    }
+    for (int32_t i = begin; i < end; ++i) {
+        coverage->mHits[i]++;
+    }
+}
+
+static void fillRandom(std::vector<uint8_t> *buffer, uint32_t seed) {
+    srand(seed);
+    for (size_t i = 0; i < buffer->size(); ++i) {
+        (*buffer)[i] = rand() & 0xff;
+    }
+}
+
+class SprdStripePoolTest : public ::testing::TestWithParam<int32_t> {
+};
+
+TEST_P(SprdStripePoolTest, EveryRowOnceOnAlignedStripes) {
+    SprdStripePool pool(GetParam());
+    ASSERT_EQ(GetParam(), pool.threadCount());
+
+    static const int32_t kRows[] = { 1, 2, 7, 64, 1080, 2161 };
+    static const int32_t kAligns[] = { 1, 2, 16 };
+    for (size_t r = 0; r < sizeof(kRows) / sizeof(kRows[0]); ++r) {
+        for (size_t a = 0; a < sizeof(kAligns) / sizeof(kAligns[0]); ++a) {
+            Coverage coverage;
+            coverage.mHits.assign(kRows[r], 0);
+            coverage.mAlign = kAligns[a];
+            coverage.mMisaligned = false;
+
+            // Rows big enough that the pass is split.
+            pool.run(countRows, &coverage, kRows[r], 64 * 1024, kAligns[a]);
+
+            EXPECT_FALSE(coverage.mMisaligned);
+            for (int32_t i = 0; i < kRows[r]; ++i) {
+                ASSERT_EQ(1, coverage.mHits[i]) << "row " << i << " of " << kRows[r]
+                        << ", align " << kAligns[a];
+            }
+        }
+    }
+}
+
+TEST_P(SprdStripePoolTest, CopyMatchesMemcpy) {
+    SprdStripePool pool(GetParam());
+
+    static const size_t kSizes[] = { 0, 1, 65535, 65536, 65537, 3 * 1024 * 1024 + 5 };
+    for (size_t s = 0; s < sizeof(kSizes) / sizeof(kSizes[0]); ++s) {
+        std::vector<uint8_t> src(kSizes[s] + 1);
+        fillRandom(&src, kSizes[s]);
+        std::vector<uint8_t> dst(kSizes[s] + 1, 0xa5);
+
+        pool.copy(&dst[0], &src[0], kSizes[s]);
+
+        ASSERT_EQ(0, memcmp(&src[0], &dst[0], kSizes[s])) << "size " << kSizes[s];
+        ASSERT_EQ(0xa5, dst[kSizes[s]]) << "size " << kSizes[s];
+    }
+}
+
+TEST_P(SprdStripePoolTest, CopyPaddedRepeatsLastUnit) {
+    SprdStripePool pool(GetParam());
+
+    // A 4K luma plane padded by 8 and its chroma plane padded by one pair.
+    static const struct {
+        size_t mWidth;
+        size_t mDstWidth;
+        int32_t mRows;
+        size_t mUnit;
+    } kCases[] = {
+        { 3832, 3840, 2160, 1 },
+        { 3838, 3840, 1080, 2 },
+        { 17, 32, 9, 1 },
+    };
+
+    for (size_t c = 0; c < sizeof(kCases) / sizeof(kCases[0]); ++c) {
+        size_t width = kCases[c].mWidth;
+        size_t dstWidth = kCases[c].mDstWidth;
+        int32_t rows = kCases[c].mRows;
+        size_t unit = kCases[c].mUnit;
+
+        std::vector<uint8_t> src(width * rows);
+        fillRandom(&src, c);
+        std::vector<uint8_t> dst(dstWidth * rows);
+        std::vector<uint8_t> ref(dstWidth * rows);
+        for (int32_t y = 0; y < rows; ++y) {
+            for (size_t x = 0; x < dstWidth; ++x) {
+                size_t sx = x < width ? x : width - unit + (x - width) % unit;
+                ref[y * dstWidth + x] = src[y * width + sx];
+            }
+        }
+
+        pool.copyPadded(&dst[0], dstWidth, &src[0], width, rows, unit);
+
+        ASSERT_TRUE(ref == dst) << "case " << c;
+    }
+}
+
+// What the encoders run: the striped frame conversion must give the
+// bytes of the serial one.
+TEST_P(SprdStripePoolTest, StripedConversionMatchesSerial) {
+    SprdStripePool pool(GetParam());
+
+    const int32_t width = 1920;
+    const int32_t height = 1088;
+    const int32_t dstWidth = 1920;
+    const int32_t dstHeight = 1088;
+
+    std::vector<uint8_t> rgb(width * height * 4);
+    fillRandom(&rgb, 1);
+    std::vector<uint8_t> serial(dstWidth * dstHeight * 3 / 2);
+    std::vector<uint8_t> striped(serial.size());
+
+    SprdConvertRGBFrameToSemiPlanar(&rgb[0], kSprdRgbLayoutRGBA, kSprdColorBT601Limited,
+            width, height, &serial[0], dstWidth, dstHeight, kSprdChromaVU);
+    SprdConvertRGBFrameToSemiPlanar(&rgb[0], kSprdRgbLayoutRGBA, kSprdColorBT601Limited,
+            width, height, &striped[0], dstWidth, dstHeight, kSprdChromaVU,
+            SprdStripePool::Run, &pool);
+    ASSERT_TRUE(serial == striped);
+
+    std::vector<uint8_t> i420(width * height * 3 / 2);
+    fillRandom(&i420, 2);
+    SprdConvertI420FrameToSemiPlanar(&i420[0], width, height,
+            &serial[0], dstWidth, dstHeight, kSprdChromaUV);
+    SprdConvertI420FrameToSemiPlanar(&i420[0], width, height,
+            &striped[0], dstWidth, dstHeight, kSprdChromaUV, SprdStripePool::Run, &pool);
+    ASSERT_TRUE(serial == striped);
+}
+
+struct SharedPass {
+    SprdStripePool *mPool;
+    Coverage mCoverage;
+};
+
+static void *runShared(void *arg) {
+    SharedPass *pass = static_cast<SharedPass *>(arg);
+    for (int32_t i = 0; i < 50; ++i) {
+        pass->mPool->run(countRows, &pass->mCoverage, 256, 64 * 1024, 2);
+    }
+    return NULL;
+}
+
+// Several components share the pool; every pass still covers its rows
+// exactly once.
+TEST_P(SprdStripePoolTest, ConcurrentCallers) {
+    SprdStripePool pool(GetParam());
+
+    SharedPass passes[4];
+    pthread_t threads[4];
+    for (size_t i = 0; i < 4; ++i) {
+        passes[i].mPool = &pool;
+        passes[i].mCoverage.mHits.assign(256, 0);
+        passes[i].mCoverage.mAlign = 2;
+        passes[i].mCoverage.mMisaligned = false;
+        pthread_create(&threads[i], NULL, runShared, &passes[i]);
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < 4; ++i) {
+        EXPECT_FALSE(passes[i].mCoverage.mMisaligned);
+        for (int32_t row = 0; row < 256; ++row) {
+            ASSERT_EQ(50, passes[i].mCoverage.mHits[row]) << "caller " << i << " row " << row;
+        }
+    }
+}
+
+INSTANTIATE_TEST_CASE_P(Threads, SprdStripePoolTest, ::testing::Range(1, 9));
+
+}  // namespace android
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdVspScheduler_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+#include "SprdVspScheduler.h"
+
+namespace android {
+
+// Stands in for the VSP: counts the sessions inside each core, and the
+// most it ever saw at once.
+struct MockEngine {
+    MockEngine() {
+        for (size_t i = 0; i < SprdVspScheduler::kNumCores; ++i) {
+            mInside[i] = 0;
+            mMaxInside[i] = 0;
+        }
+    }
+
+    // One frame of frameUs on the core of the session.
+    void run(int32_t sessionId, SprdVspScheduler::Core core, useconds_t frameUs) {
+        SprdVspScheduler::getInstance()->acquireEngine(sessionId);
+        {
+            Mutex::Autolock autoLock(mLock);
+            if (++mInside[core] > mMaxInside[core]) {
+                mMaxInside[core] = mInside[core];
+            }
+            mOrder.push_back(sessionId);
+            mCondition.broadcast();
+        }
+        usleep(frameUs);
+        {
+            Mutex::Autolock autoLock(mLock);
+            --mInside[core];
+        }
+        SprdVspScheduler::getInstance()->releaseEngine(sessionId);
+    }
+
+    // Waits up to timeoutUs for count sessions to be inside core at once.
+    bool waitInside(SprdVspScheduler::Core core, int32_t count, int64_t timeoutUs) {
+        Mutex::Autolock autoLock(mLock);
+        while (mInside[core] < count) {
+            if (mCondition.waitRelative(mLock, timeoutUs * 1000ll) != OK) {
+                return mInside[core] >= count;
+            }
+        }
+        return true;
+    }
+
+    Mutex mLock;
+    Condition mCondition;
+    int32_t mInside[SprdVspScheduler::kNumCores];
+    int32_t mMaxInside[SprdVspScheduler::kNumCores];
+    Vector<int32_t> mOrder;
+};
+
+struct Job {
+    MockEngine *mEngine;
+    int32_t mSessionId;
+    SprdVspScheduler::Core mCore;
+    int32_t mFrames;
+    useconds_t mFrameUs;
+};
+
+static void *runJob(void *arg) {
+    Job *job = (Job *)arg;
+    for (int32_t i = 0; i < job->mFrames; ++i) {
+        job->mEngine->run(job->mSessionId, job->mCore, job->mFrameUs);
+    }
+    return NULL;
+}
+
+class SprdVspSchedulerTest : public ::testing::Test {
+protected:
+    virtual void SetUp() {
+        mScheduler = SprdVspScheduler::getInstance();
+        mSavedBudget = mScheduler->budget();
+        mSavedAgingJobs = mScheduler->agingJobs();
+    }
+
+    virtual void TearDown() {
+        for (size_t i = 0; i < mSessions.size(); ++i) {
+            mScheduler->unregisterSession(mSessions.itemAt(i));
+        }
+        mScheduler->setBudget(mSavedBudget);
+        mScheduler->setAgingJobs(mSavedAgingJobs);
+    }
+
+    status_t add(SprdVspScheduler::Core core, int32_t width, int32_t height, int32_t fps,
+            SprdVspScheduler::Priority priority, int32_t *sessionId) {
+        status_t err = mScheduler->registerSession(
+                "test", core, width, height, fps, priority, sessionId);
+        if (err == OK) {
+            mSessions.push_back(*sessionId);
+        }
+        return err;
+    }
+
+    SprdVspScheduler *mScheduler;
+    int64_t mSavedBudget;
+    int32_t mSavedAgingJobs;
+    Vector<int32_t> mSessions;
+};
+
+TEST_F(SprdVspSchedulerTest, AdmissionIsOffByDefault) {
+    ASSERT_LE(mScheduler->budget(), 0);
+
+    int32_t id;
+    EXPECT_EQ(OK, add(SprdVspScheduler::kCoreDecoder, 3840, 2160, 60,
+            SprdVspScheduler::kPriorityNormal, &id));
+    EXPECT_EQ(OK, add(SprdVspScheduler::kCoreEncoder, 1920, 1080, 120,
+            SprdVspScheduler::kPriorityNormal, &id));
+    EXPECT_EQ(OK, add(SprdVspScheduler::kCoreEncoder, 3840, 2160, 30,
+            SprdVspScheduler::kPriorityNormal, &id));
+}
+
+TEST_F(SprdVspSchedulerTest, BudgetRejectsOnlyForegroundOverload) {
+    // 1080p30 is 244800 MB/s.
+    mScheduler->setBudget(300000);
+
+    int32_t id;
+    EXPECT_EQ(OK, add(SprdVspScheduler::kCoreDecoder, 1920, 1080, 30,
+            SprdVspScheduler::kPriorityNormal, &id));
+    EXPECT_EQ(INVALID_OPERATION, add(SprdVspScheduler::kCoreEncoder, 1920, 1080, 30,
+            SprdVspScheduler::kPriorityNormal, &id));
+    EXPECT_EQ(OK, add(SprdVspScheduler::kCoreDecoder, 1920, 1080, 30,
+            SprdVspScheduler::kPriorityBackground, &id));
+}
+
+TEST_F(SprdVspSchedulerTest, SameCoreIsSerialised) {
+    MockEngine engine;
+    Job jobs[3];
+    pthread_t threads[3];
+
+    for (size_t i = 0; i < 3; ++i) {
+        jobs[i].mEngine = &engine;
+        jobs[i].mCore = SprdVspScheduler::kCoreDecoder;
+        jobs[i].mFrames = 20;
+        jobs[i].mFrameUs = 500;
+        ASSERT_EQ(OK, add(jobs[i].mCore, 1280, 720, 30,
+                SprdVspScheduler::kPriorityNormal, &jobs[i].mSessionId));
+    }
+    for (size_t i = 0; i < 3; ++i) {
+        pthread_create(&threads[i], NULL, runJob, &jobs[i]);
+    }
+    for (size_t i = 0; i < 3; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    EXPECT_EQ(1, engine.mMaxInside[SprdVspScheduler::kCoreDecoder]);
+    EXPECT_EQ(60u, engine.mOrder.size());
+}
+
+TEST_F(SprdVspSchedulerTest, CoresRunConcurrently) {
+    MockEngine engine;
+    Job decode = { &engine, -1, SprdVspScheduler::kCoreDecoder, 1, 200000 };
+    Job encode = { &engine, -1, SprdVspScheduler::kCoreEncoder, 1, 200000 };
+    ASSERT_EQ(OK, add(decode.mCore, 3840, 2160, 30,
+            SprdVspScheduler::kPriorityNormal, &decode.mSessionId));
+    ASSERT_EQ(OK, add(encode.mCore, 1920, 1080, 30,
+            SprdVspScheduler::kPriorityNormal, &encode.mSessionId));
+
+    pthread_t decodeThread, encodeThread;
+    pthread_create(&decodeThread, NULL, runJob, &decode);
+    ASSERT_TRUE(engine.waitInside(SprdVspScheduler::kCoreDecoder, 1, 1000000));
+
+    // The encoder gets its core while the decoder still holds its own.
+    pthread_create(&encodeThread, NULL, runJob, &encode);
+    EXPECT_TRUE(engine.waitInside(SprdVspScheduler::kCoreEncoder, 1, 100000));
+    {
+        Mutex::Autolock autoLock(engine.mLock);
+        EXPECT_EQ(1, engine.mInside[SprdVspScheduler::kCoreDecoder]);
+    }
+
+    pthread_join(decodeThread, NULL);
+    pthread_join(encodeThread, NULL);
+}
+
+TEST_F(SprdVspSchedulerTest, UrgentJobGoesFirst) {
+    MockEngine engine;
+    Job holder = { &engine, -1, SprdVspScheduler::kCoreDecoder, 1, 100000 };
+    Job normal = { &engine, -1, SprdVspScheduler::kCoreDecoder, 1, 1000 };
+    Job realtime = { &engine, -1, SprdVspScheduler::kCoreDecoder, 1, 1000 };
+    ASSERT_EQ(OK, add(holder.mCore, 1920, 1080, 30,
+            SprdVspScheduler::kPriorityNormal, &holder.mSessionId));
+    ASSERT_EQ(OK, add(normal.mCore, 1920, 1080, 30,
+            SprdVspScheduler::kPriorityNormal, &normal.mSessionId));
+    ASSERT_EQ(OK, add(realtime.mCore, 640, 480, 15,
+            SprdVspScheduler::kPriorityRealtime, &realtime.mSessionId));
+
+    pthread_t threads[3];
+    pthread_create(&threads[0], NULL, runJob, &holder);
+    ASSERT_TRUE(engine.waitInside(SprdVspScheduler::kCoreDecoder, 1, 1000000));
+
+    // Both queue up behind the holder, the normal one first.
+    pthread_create(&threads[1], NULL, runJob, &normal);
+    usleep(20000);
+    pthread_create(&threads[2], NULL, runJob, &realtime);
+
+    for (size_t i = 0; i < 3; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    ASSERT_EQ(3u, engine.mOrder.size());
+    EXPECT_EQ(holder.mSessionId, engine.mOrder.itemAt(0));
+    EXPECT_EQ(realtime.mSessionId, engine.mOrder.itemAt(1));
+    EXPECT_EQ(normal.mSessionId, engine.mOrder.itemAt(2));
+}
+
+// Returns where sessionId first got the core in engine.mOrder, -1 if never.
+static ssize_t firstGrant(const MockEngine &engine, int32_t sessionId) {
+    for (size_t i = 0; i < engine.mOrder.size(); ++i) {
+        if (engine.mOrder.itemAt(i) == sessionId) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Two realtime sessions keep the core busy; a background job gets it once
+// agingJobs() jobs per priority level passed it, not after they are done.
+TEST_F(SprdVspSchedulerTest, WaitingJobAgesPastBusyRealtimeSessions) {
+    const int32_t kAgingJobs = 2;
+    mScheduler->setAgingJobs(kAgingJobs);
+
+    MockEngine engine;
+    Job realtime[2];
+    for (size_t i = 0; i < 2; ++i) {
+        realtime[i].mEngine = &engine;
+        realtime[i].mCore = SprdVspScheduler::kCoreDecoder;
+        realtime[i].mFrames = 30;
+        realtime[i].mFrameUs = 2000;
+        // 1000 fps keeps the deadlines of both close to the present.
+        ASSERT_EQ(OK, add(realtime[i].mCore, 320, 240, 1000,
+                SprdVspScheduler::kPriorityRealtime, &realtime[i].mSessionId));
+    }
+    Job background = { &engine, -1, SprdVspScheduler::kCoreDecoder, 1, 1000 };
+    ASSERT_EQ(OK, add(background.mCore, 320, 240, 1000,
+            SprdVspScheduler::kPriorityBackground, &background.mSessionId));
+
+    pthread_t threads[3];
+    pthread_create(&threads[0], NULL, runJob, &realtime[0]);
+    pthread_create(&threads[1], NULL, runJob, &realtime[1]);
+    ASSERT_TRUE(engine.waitInside(SprdVspScheduler::kCoreDecoder, 1, 1000000));
+    pthread_create(&threads[2], NULL, runJob, &background);
+
+    for (size_t i = 0; i < 3; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    ASSERT_EQ(61u, engine.mOrder.size());
+    ssize_t grant = firstGrant(engine, background.mSessionId);
+    ASSERT_GE(grant, 0);
+    // Background to realtime takes 2 * kAgingJobs jobs; then it has the
+    // earliest deadline. Allow for the jobs granted before it queued up.
+    EXPECT_LE(grant, 2 * kAgingJobs + 4);
+}
+
+// With aging off the same background job only gets the core once the
+// realtime sessions no longer keep it busy.
+TEST_F(SprdVspSchedulerTest, StrictPriorityWithoutAging) {
+    mScheduler->setAgingJobs(0);
+
+    MockEngine engine;
+    Job realtime[2];
+    for (size_t i = 0; i < 2; ++i) {
+        realtime[i].mEngine = &engine;
+        realtime[i].mCore = SprdVspScheduler::kCoreDecoder;
+        realtime[i].mFrames = 20;
+        realtime[i].mFrameUs = 2000;
+        ASSERT_EQ(OK, add(realtime[i].mCore, 320, 240, 1000,
+                SprdVspScheduler::kPriorityRealtime, &realtime[i].mSessionId));
+    }
+    Job background = { &engine, -1, SprdVspScheduler::kCoreDecoder, 1, 1000 };
+    ASSERT_EQ(OK, add(background.mCore, 320, 240, 1000,
+            SprdVspScheduler::kPriorityBackground, &background.mSessionId));
+
+    pthread_t threads[3];
+    pthread_create(&threads[0], NULL, runJob, &realtime[0]);
+    pthread_create(&threads[1], NULL, runJob, &realtime[1]);
+    ASSERT_TRUE(engine.waitInside(SprdVspScheduler::kCoreDecoder, 1, 1000000));
+    pthread_create(&threads[2], NULL, runJob, &background);
+
+    for (size_t i = 0; i < 3; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    ASSERT_EQ(41u, engine.mOrder.size());
+    // Only the tail of one session leaves gaps it can use.
+    EXPECT_GE(firstGrant(engine, background.mSessionId), 30);
+}
+
+}  // namespace android
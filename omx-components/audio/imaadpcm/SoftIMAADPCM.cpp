@@ -47,6 +47,7 @@ SoftIMAADPCM::SoftIMAADPCM(
     CHECK(!strcmp(name, "OMX.google.imaadpcm.decoder"));
 
     initPorts();
+    enableOutputPacking();
 }
 
 SoftIMAADPCM::~SoftIMAADPCM() {
@@ -232,8 +233,8 @@ void SoftIMAADPCM::onQueueFilled(OMX_U32 portIndex) {
         return;
     }
 
-    List<BufferInfo *> &inQueue = getPortQueue(0);
-    List<BufferInfo *> &outQueue = getPortQueue(1);
+    PortQueue &inQueue = getPortQueue(0);
+    PortQueue &outQueue = getPortQueue(1);
 
     while (!inQueue.empty() && !outQueue.empty()) {
         BufferInfo *inInfo = *inQueue.begin();
@@ -242,6 +243,23 @@ void SoftIMAADPCM::onQueueFilled(OMX_U32 portIndex) {
         BufferInfo *outInfo = *outQueue.begin();
         OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
 
+        int samples_per_frame;
+        samples_per_frame = ((mBlockAlign / mNumChannels - 4) << 1) + 1;
+        size_t outSize = inHeader->nFilledLen / mBlockAlign
+                * samples_per_frame * mNumChannels * sizeof(int16_t);
+
+        if (mOutputPacker.frameCount() > 0
+                && ((inHeader->nFlags & OMX_BUFFERFLAG_EOS)
+                    || mOutputPacker.room(outHeader) < outSize)) {
+            // Send what was packed so far before EOS or a block of samples
+            // that no longer fits.
+            mOutputPacker.finish(outHeader);
+            outInfo->mOwnedByUs = false;
+            outQueue.erase(outQueue.begin());
+            notifyFillBufferDone(outHeader);
+            continue;
+        }
+
         if (inHeader->nFlags & OMX_BUFFERFLAG_EOS) {
             inQueue.erase(inQueue.begin());
             inInfo->mOwnedByUs = false;
@@ -256,8 +274,6 @@ void SoftIMAADPCM::onQueueFilled(OMX_U32 portIndex) {
             return;
         }
 
-        int samples_per_frame;
-        samples_per_frame = ((mBlockAlign / mNumChannels - 4) << 1) + 1;
         if (inHeader->nFilledLen%mBlockAlign != 0) {
             ALOGW("WARNING! input buffer corrupt, len=%d, ba=%d", inHeader->nFilledLen, mBlockAlign);
         }
@@ -271,7 +287,12 @@ void SoftIMAADPCM::onQueueFilled(OMX_U32 portIndex) {
         const uint8_t *inputPtr = inHeader->pBuffer + inHeader->nOffset;
         int inputLength = inHeader->nFilledLen;
 
-        int16_t *outputPtr = reinterpret_cast<int16_t *>(outHeader->pBuffer);
+        if (mOutputPacker.frameCount() == 0) {
+            outHeader->nOffset = 0;
+            outHeader->nFilledLen = 0;
+        }
+
+        int16_t *outputPtr = reinterpret_cast<int16_t *>(mOutputPacker.tail(outHeader));
         int frames = 0;
         while (inputLength >= mBlockAlign) {
             DecodeIMAADPCM(
@@ -283,10 +304,15 @@ void SoftIMAADPCM::onQueueFilled(OMX_U32 portIndex) {
             frames += samples_per_frame;
         }
 
-        outHeader->nTimeStamp = inHeader->nTimeStamp;
-        outHeader->nOffset = 0;
-        outHeader->nFilledLen = frames * mNumChannels * sizeof(int16_t);
-        outHeader->nFlags = 0;
+        if (mOutputPacker.enabled()) {
+            mOutputPacker.append(outHeader, inHeader->nTimeStamp,
+                    frames * mNumChannels * sizeof(int16_t), 0);
+        } else {
+            outHeader->nTimeStamp = inHeader->nTimeStamp;
+            outHeader->nOffset = 0;
+            outHeader->nFilledLen = frames * mNumChannels * sizeof(int16_t);
+            outHeader->nFlags = 0;
+        }
 
         inInfo->mOwnedByUs = false;
         inQueue.erase(inQueue.begin());
@@ -294,6 +320,14 @@ void SoftIMAADPCM::onQueueFilled(OMX_U32 portIndex) {
         notifyEmptyBufferDone(inHeader);
         inHeader = NULL;
 
+        if (mOutputPacker.enabled()) {
+            // Keep the buffer while another input of the same size fits.
+            if (!mOutputPacker.isFull(outHeader, outSize)) {
+                continue;
+            }
+            mOutputPacker.finish(outHeader);
+        }
+
         outInfo->mOwnedByUs = false;
         outQueue.erase(outQueue.begin());
         outInfo = NULL;
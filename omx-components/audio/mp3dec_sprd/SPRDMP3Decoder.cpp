@@ -30,8 +30,20 @@
 #include <media/stagefright/foundation/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SPRD_MP3_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SPRD_MP3_SSE2
+#endif
+
 namespace android {
 
+// Header bits that frames of one stream share: everything but padding,
+// private, mode extension, copyright, original and emphasis.
+static const uint32_t kFrameHeaderMask = 0xfffffcc0;
+
 template<class T>
 static void InitOMXParams(T *params) {
     params->nSize = sizeof(T);
@@ -50,15 +62,17 @@ SPRDMP3Decoder::SPRDMP3Decoder(
       mNumChannels(2),
       mSamplingRate(44100),
       mBitRate(0),
-      mNextMdBegin(0),
-      mPreFilledLen(0),
       mMaxFrameBuf(NULL),
+      mStagedLen(0),
+      mStagedFrameLen(0),
+      mStagedFromHead(0),
       mLastInTimeUs(0),
       mAnchorTimeUs(0),
       mNumFramesOutput(0),
+      mInputStarted(false),
+      mInputEOS(false),
       mEOSFlag(false),
       mSignalledError(false),
-      mInputEosUnDecode(false),
       mLibHandle(NULL),
       mOutputPortSettingsChange(NONE),
       mMP3_ARM_DEC_Construct(NULL),
@@ -69,17 +83,18 @@ SPRDMP3Decoder::SPRDMP3Decoder(
     ret = openDecoder("libomx_mp3dec_sprd.so");
     CHECK_EQ(ret, true);
     initPorts();
+    enableOutputPacking();
     initDecoder();
 }
 
 SPRDMP3Decoder::~SPRDMP3Decoder() {
-    delete mLeftBuf;
+    delete[] mLeftBuf;
     mLeftBuf = NULL;
 
-    delete mRightBuf;
+    delete[] mRightBuf;
     mRightBuf = NULL;
 
-    delete mMaxFrameBuf;
+    delete[] mMaxFrameBuf;
     mMaxFrameBuf = NULL;
 
     mMP3_ARM_DEC_Deconstruct((void const **)&mMP3DecHandle);
@@ -138,7 +153,7 @@ void SPRDMP3Decoder::initDecoder() {
     mRightBuf = new uint16_t[MP3_DEC_FRAME_LEN];
 
     //Temporary source data frame buffer.
-    mMaxFrameBuf = new uint8_t[MP3_MAX_DATA_FRAME_LEN];
+    mMaxFrameBuf = new uint8_t[MP3_MAX_DATA_FRAME_LEN + kNextHeaderBytes];
 
     int32_t ret = mMP3_ARM_DEC_Construct(&mMP3DecHandle);
     ALOGI("MP3_ARM_DEC_Construct=%d", ret);
@@ -146,7 +161,7 @@ void SPRDMP3Decoder::initDecoder() {
     //Init sprd mp3 decoder
     mMP3_ARM_DEC_InitDecoder(mMP3DecHandle);
 
-    mIsFirst = true;
+    memset(&mFrameHeader, 0, sizeof(mFrameHeader));
     mFirstFrame = true;
 }
 
@@ -293,8 +308,9 @@ static uint32_t U32_AT(const uint8_t *ptr) {
 }
 
 static bool getMPEGAudioFrameSize(
-        uint32_t header,int *out_sampling_rate, int *out_channels,
-        int *out_bitrate) {
+        uint32_t header, size_t *frame_size, int *out_sampling_rate,
+        int *out_channels, int *out_bitrate) {
+    *frame_size = 0;
 
     if (out_sampling_rate) {
         *out_sampling_rate = 0;
@@ -371,6 +387,8 @@ static bool getMPEGAudioFrameSize(
             *out_bitrate = bitrate;
         }
 
+        *frame_size = (12000 * bitrate / sampling_rate + padding) * 4;
+
     } else {
         // layer II or III
 
@@ -404,6 +422,14 @@ static bool getMPEGAudioFrameSize(
         if (out_bitrate) {
             *out_bitrate = bitrate;
         }
+
+        if (version == 3 /* V1 */) {
+            *frame_size = 144000 * bitrate / sampling_rate + padding;
+        } else {
+            // V2 or V2.5
+            size_t tmp = (layer == 1 /* L3 */) ? 72000 : 144000;
+            *frame_size = tmp * bitrate / sampling_rate + padding;
+        }
     }
 
     if (out_sampling_rate) {
@@ -419,65 +445,52 @@ static bool getMPEGAudioFrameSize(
     return true;
 }
 
-uint32_t SPRDMP3Decoder::getCurFrameBitRate(uint8_t *frameBuf) {
-    uint32_t header = 0;
-    uint32_t bitrate = 0;
+// Measures the frame at frameBuf. False if it does not start with a
+// header we can take the size from, e.g. a free format one.
+bool SPRDMP3Decoder::parseFrameHeader(const uint8_t *frameBuf, size_t *frameLen) {
+    uint32_t header = U32_AT(frameBuf);
+    if ((header & 0xffe00000) != 0xffe00000) {
+        return false;
+    }
 
-    if (frameBuf) {
-        header = (frameBuf[0]<<24)|(frameBuf[1]<<16)|(frameBuf[2]<<8)|frameBuf[3];
+    if ((header & kFrameHeaderMask) != mFrameHeader.mHeader) {
+        size_t frameSize;
+        int samplingRate, numChannels, bitRate;
+        if (!getMPEGAudioFrameSize(header & kFrameHeaderMask, &frameSize,
+                &samplingRate, &numChannels, &bitRate)) {
+            return false;
+        }
 
-        unsigned layer = (header >> 17) & 3;
-        unsigned bitrate_index = (header >> 12) & 0x0f;
-        unsigned version = (header >> 19) & 3;
-
-        if (layer == 3) {
-            // layer I
-            static const int kBitrateV1[] = {
-                32, 64, 96, 128, 160, 192, 224, 256,
-                288, 320, 352, 384, 416, 448
-            };
-
-            static const int kBitrateV2[] = {
-                32, 48, 56, 64, 80, 96, 112, 128,
-                144, 160, 176, 192, 224, 256
-            };
-
-            bitrate =
-                (version == 3 /* V1 */)
-                ? kBitrateV1[bitrate_index - 1]
-                : kBitrateV2[bitrate_index - 1];
+        mFrameHeader.mHeader = header & kFrameHeaderMask;
+        mFrameHeader.mSamplingRate = samplingRate;
+        mFrameHeader.mNumChannels = numChannels;
+        mFrameHeader.mBitRate = bitRate;
+        mFrameHeader.mFrameSize = frameSize;
+        // Layer I pads with a 4 byte slot, II and III with one byte.
+        mFrameHeader.mSlotSize = ((header >> 17) & 3) == 3 ? 4 : 1;
+    }
 
-        } else {
-            // layer II or III
-            static const int kBitrateV1L2[] = {
-                32, 48, 56, 64, 80, 96, 112, 128,
-                160, 192, 224, 256, 320, 384
-            };
-
-            static const int kBitrateV1L3[] = {
-                32, 40, 48, 56, 64, 80, 96, 112,
-                128, 160, 192, 224, 256, 320
-            };
-
-            static const int kBitrateV2[] = {
-                8, 16, 24, 32, 40, 48, 56, 64,
-                80, 96, 112, 128, 144, 160
-            };
-
-            if (version == 3 /* V1 */) {
-                bitrate = (layer == 2 /* L2 */)
-                          ? kBitrateV1L2[bitrate_index - 1]
-                          : kBitrateV1L3[bitrate_index - 1];
-            } else {
-                // V2 (or 2.5)
-                bitrate = kBitrateV2[bitrate_index - 1];
-            }
+    *frameLen = mFrameHeader.mFrameSize;
+    if (header & 0x200) {
+        *frameLen += mFrameHeader.mSlotSize;
+    }
+    return true;
+}
+
+// Offset of the first frame header in data, or of the last bytes that
+// could still begin one once more data follows.
+size_t SPRDMP3Decoder::findFrameHeader(const uint8_t *data, size_t size) {
+    size_t frameLen;
+    for (size_t i = 0; i + 4 <= size; ++i) {
+        if (data[i] == 0xff && (data[i + 1] & 0xe0) == 0xe0
+                && parseFrameHeader(data + i, &frameLen)) {
+            return i;
         }
     }
-    return bitrate;
+    return size < 3 ? 0 : size - 3;
 }
 
-uint32_t SPRDMP3Decoder::getNextMdBegin(uint8_t *frameBuf) {
+uint32_t SPRDMP3Decoder::getNextMdBegin(const uint8_t *frameBuf) {
     uint32_t header = 0;
     uint32_t result = 0;
     uint32_t offset = 0;
@@ -512,37 +525,157 @@ uint32_t SPRDMP3Decoder::getNextMdBegin(uint8_t *frameBuf) {
     return result;
 }
 
+// Interleaves the decoder's left and right channels, eight samples per
+// step where NEON or SSE2 is available.
+static void interleaveChannels(const uint16_t *left, const uint16_t *right,
+        uint16_t *dst, size_t count) {
+    size_t i = 0;
+#if defined(SPRD_MP3_NEON)
+    for (; i + 8 <= count; i += 8) {
+        uint16x8x2_t lr;
+        lr.val[0] = vld1q_u16(left + i);
+        lr.val[1] = vld1q_u16(right + i);
+        vst2q_u16(dst + 2 * i, lr);
+    }
+#elif defined(SPRD_MP3_SSE2)
+    for (; i + 8 <= count; i += 8) {
+        __m128i l = _mm_loadu_si128((const __m128i *)(left + i));
+        __m128i r = _mm_loadu_si128((const __m128i *)(right + i));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi16(l, r));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 8), _mm_unpackhi_epi16(l, r));
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[2 * i] = left[i];
+        dst[2 * i + 1] = right[i];
+    }
+}
+
+// Copies size bytes of input that start skip bytes past what has been
+// read, across as many queued buffers as it takes. False if they are
+// not all queued yet; *eos then says whether more input will follow.
+bool SPRDMP3Decoder::peekInput(size_t skip, uint8_t *data, size_t size, bool *eos) {
+    PortQueue &inQueue = getPortQueue(0);
+
+    *eos = false;
+    for (PortQueue::iterator it = inQueue.begin(); it != inQueue.end(); ++it) {
+        const OMX_BUFFERHEADERTYPE *header = (*it)->mHeader;
+        size_t avail = header->nFilledLen;
+
+        if (skip >= avail) {
+            skip -= avail;
+        } else {
+            size_t len = avail - skip < size ? avail - skip : size;
+            memcpy(data, header->pBuffer + header->nOffset + skip, len);
+            data += len;
+            size -= len;
+            skip = 0;
+        }
+
+        if (size == 0) {
+            return true;
+        }
+        if (header->nFlags & OMX_BUFFERFLAG_EOS) {
+            *eos = true;
+            return false;
+        }
+    }
+    return false;
+}
+
+void SPRDMP3Decoder::consumeInput(OMX_BUFFERHEADERTYPE *inHeader, size_t size) {
+    inHeader->nOffset += size;
+    inHeader->nFilledLen -= size;
+}
+
+// Copies up to size bytes from the head of inHeader behind what is staged.
+void SPRDMP3Decoder::stageInput(OMX_BUFFERHEADERTYPE *inHeader, size_t size) {
+    if (size > inHeader->nFilledLen) {
+        size = inHeader->nFilledLen;
+    }
+    memcpy(mMaxFrameBuf + mStagedLen, inHeader->pBuffer + inHeader->nOffset, size);
+    consumeInput(inHeader, size);
+    mStagedLen += size;
+    mStagedFromHead += size;
+}
+
+// Drops the staged frame once decoded. What was staged past it goes back
+// to the input buffer it came from if that is still at the head, so the
+// frames after it are decoded where they lie again.
+void SPRDMP3Decoder::unstageFrame(OMX_BUFFERHEADERTYPE *inHeader) {
+    size_t rest = mStagedLen - mStagedFrameLen;
+
+    if (rest > 0 && inHeader != NULL && rest <= mStagedFromHead) {
+        inHeader->nOffset -= rest;
+        inHeader->nFilledLen += rest;
+        rest = 0;
+    }
+    memmove(mMaxFrameBuf, mMaxFrameBuf + mStagedFrameLen, rest);
+    mStagedLen = rest;
+    mStagedFrameLen = 0;
+    if (mStagedFromHead > rest) {
+        mStagedFromHead = rest;
+    }
+
+    if (mStagedLen == 0 && mInputEOS) {
+        mEOSFlag = true;
+    }
+}
+
+// Whether every input buffer is queued with us, so no more input can
+// arrive before one goes back.
+bool SPRDMP3Decoder::inputStarved() {
+    return getPortQueue(0).size() >= editPortInfo(0)->mDef.nBufferCountActual;
+}
+
+void SPRDMP3Decoder::returnOutputBuffer(BufferInfo *outInfo) {
+    PortQueue &outQueue = getPortQueue(1);
+    OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+
+    if (mOutputPacker.frameCount() > 0) {
+        mOutputPacker.finish(outHeader);
+    }
+
+    outInfo->mOwnedByUs = false;
+    outQueue.erase(outInfo);
+    notifyFillBufferDone(outHeader);
+}
+
+// Input buffers may hold any number of frames, or parts of them. Each
+// frame is decoded where it lies once the header of the one after it is
+// in; the decoder needs that frame's main_data_begin. Frames are written
+// back to back into the output buffer while more input is at hand, and
+// the buffer goes back once it is full or the input runs dry.
 void SPRDMP3Decoder::onQueueFilled(OMX_U32 portIndex) {
-    int newRate=0;
-    int newChannel=0;
-    int newBitRate=0;
-    bool config_status=false;
     if (mSignalledError || mOutputPortSettingsChange != NONE) {
         return;
     }
 
-    List<BufferInfo *> &inQueue = getPortQueue(0);
-    List<BufferInfo *> &outQueue = getPortQueue(1);
+    PortQueue &inQueue = getPortQueue(0);
+    PortQueue &outQueue = getPortQueue(1);
 
-    while ((!inQueue.empty() || mInputEosUnDecode) && !outQueue.empty()) {
-        BufferInfo *inInfo = NULL;
-        OMX_BUFFERHEADERTYPE *inHeader = NULL;
-        if (!inQueue.empty()) {
-            inInfo = *inQueue.begin();
-            inHeader = inInfo->mHeader;
-        }
+    // Frames written to the output buffer at the head of outQueue.
+    size_t outFrames = 0;
 
+    while (!outQueue.empty()) {
         BufferInfo *outInfo = *outQueue.begin();
         OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
 
+        if (mOutputPacker.frameCount() > 0
+                && (mEOSFlag || mOutputPacker.room(outHeader) < kMaxFrameBytes)) {
+            returnOutputBuffer(outInfo);
+            continue;
+        }
+        if (outFrames > 0
+                && (mEOSFlag || outHeader->nAllocLen - outHeader->nOffset
+                        - outHeader->nFilledLen < kMaxFrameBytes)) {
+            returnOutputBuffer(outInfo);
+            outFrames = 0;
+            continue;
+        }
+
         if (mEOSFlag) {
-            if (inHeader) {
-                inQueue.erase(inQueue.begin());
-                inInfo->mOwnedByUs = false;
-                notifyEmptyBufferDone(inHeader);
-            }
-            mInputEosUnDecode = false;
-            if (!mIsFirst) {
+            if (!mFirstFrame) {
                 // pad the end of the stream with 529 samples, since that many samples
                 // were trimmed off the beginning when decoding started
                 outHeader->nFilledLen = kPVMP3DecoderDelay * mNumChannels * sizeof(int16_t);
@@ -552,6 +685,7 @@ void SPRDMP3Decoder::onQueueFilled(OMX_U32 portIndex) {
                 // to add any padding at the end either.
                 outHeader->nFilledLen = 0;
             }
+            outHeader->nOffset = 0;
             outHeader->nTimeStamp = mLastInTimeUs;
             outHeader->nFlags = OMX_BUFFERFLAG_EOS;
 
@@ -560,106 +694,240 @@ void SPRDMP3Decoder::onQueueFilled(OMX_U32 portIndex) {
             notifyFillBufferDone(outHeader);
             return;
         }
-        if (inHeader && inHeader->nOffset == 0) {
-            mAnchorTimeUs = inHeader->nTimeStamp;
-            mNumFramesOutput = 0;
-        } else if (!inHeader && mInputEosUnDecode){
-            mNumFramesOutput = 0;
+
+        if (inQueue.empty() && !mInputEOS) {
+            break;
         }
 
-        FRAME_DEC_T inputParam ;
-        OUTPUT_FRAME_T outputFrame ;
-        uint32_t decoderRet = 0;
-        size_t numOutBytes = 0;
+        // Past the EOS buffer only what is staged is left.
+        BufferInfo *inInfo = mInputEOS ? NULL : *inQueue.begin();
+        OMX_BUFFERHEADERTYPE *inHeader = inInfo ? inInfo->mHeader : NULL;
 
-        memset(&inputParam, 0, sizeof(FRAME_DEC_T));
-        memset(&outputFrame, 0, sizeof(OUTPUT_FRAME_T));
+        if (inHeader && inHeader->nFilledLen == 0) {
+            bool eos = (inHeader->nFlags & OMX_BUFFERFLAG_EOS) != 0;
 
-        if (mIsFirst) {
-            mIsFirst = false;
-            mFirstFrame = true;
-            mPreFilledLen = inHeader->nFilledLen;
-            if (mMaxFrameBuf && mPreFilledLen <= MP3_MAX_DATA_FRAME_LEN) {
-                memcpy(mMaxFrameBuf, inHeader->pBuffer + inHeader->nOffset, mPreFilledLen);
-                mLastInTimeUs = mAnchorTimeUs;
+            inQueue.erase(inQueue.begin());
+            inInfo->mOwnedByUs = false;
+            notifyEmptyBufferDone(inHeader);
+            mInputStarted = false;
+            mStagedFromHead = 0;
+
+            if (eos) {
+                mInputEOS = true;
+                mEOSFlag = mStagedLen == 0;
             }
+            continue;
+        }
 
-            if (inHeader->nFlags & OMX_BUFFERFLAG_EOS) {
-                mEOSFlag = true;
+        const uint8_t *frame;
+        size_t frameLen;
+        size_t frameInput = 0;  // bytes of the frame still in the input buffer
+        bool measured = true;
+
+        // The start of the next frame, for its main_data_begin.
+        uint8_t next[kNextHeaderBytes];
+        bool haveNext;
+        bool eos = false;
+
+        if (mStagedLen > 0) {
+            if (mStagedFrameLen == 0) {
+                // Only part of a header so far; complete it to learn the
+                // size of the frame.
+                if (mStagedLen < 4) {
+                    if (inHeader == NULL) {
+                        ALOGW("dropping %zu bytes after the last frame", mStagedLen);
+                        mStagedLen = 0;
+                        mEOSFlag = true;
+                    } else {
+                        stageInput(inHeader, 4 - mStagedLen);
+                    }
+                    continue;
+                }
+                if (!parseFrameHeader(mMaxFrameBuf, &mStagedFrameLen)) {
+                    // Not a header after all; look again one byte on.
+                    ALOGV("lost sync, skipping 1 byte");
+                    --mStagedLen;
+                    memmove(mMaxFrameBuf, mMaxFrameBuf + 1, mStagedLen);
+                    mStagedFromHead = mStagedFromHead < mStagedLen ? mStagedFromHead : mStagedLen;
+                    continue;
+                }
+            }
+
+            if (mStagedLen < mStagedFrameLen) {
+                if (inHeader == NULL) {
+                    ALOGW("dropping a frame cut short by the end of the stream");
+                    mStagedLen = 0;
+                    mEOSFlag = true;
+                } else {
+                    stageInput(inHeader, mStagedFrameLen - mStagedLen);
+                    mInputStarted = true;
+                }
+                continue;
+            }
+
+            frame = mMaxFrameBuf;
+            measured = parseFrameHeader(frame, &frameLen);
+            frameLen = mStagedFrameLen;
+
+            size_t staged = mStagedLen - frameLen;
+            if (staged > sizeof(next)) {
+                staged = sizeof(next);
+            }
+            memcpy(next, frame + frameLen, staged);
+            if (staged == sizeof(next)) {
+                haveNext = true;
+            } else if (inHeader == NULL) {
+                haveNext = false;
+                eos = true;
             } else {
-                mEOSFlag = false;
-                inInfo->mOwnedByUs = false;
-                inQueue.erase(inQueue.begin());
-                inInfo = NULL;
-                notifyEmptyBufferDone(inHeader);
-                inHeader = NULL;
+                haveNext = peekInput(0, next + staged, sizeof(next) - staged, &eos);
+            }
+        } else {
+            if (inHeader == NULL) {
+                mEOSFlag = true;
+                continue;
+            }
+            if (!mInputStarted) {
+                mInputStarted = true;
+                mAnchorTimeUs = inHeader->nTimeStamp;
+                mNumFramesOutput = 0;
+            }
+
+            frame = inHeader->pBuffer + inHeader->nOffset;
+            if (inHeader->nFilledLen < 4) {
+                if (!(inHeader->nFlags & OMX_BUFFERFLAG_EOS)) {
+                    // The header goes on in the next buffer.
+                    mStagedFrameLen = 0;
+                    stageInput(inHeader, inHeader->nFilledLen);
+                } else {
+                    ALOGW("dropping %u bytes after the last frame", inHeader->nFilledLen);
+                    consumeInput(inHeader, inHeader->nFilledLen);
+                }
                 continue;
             }
+
+            measured = parseFrameHeader(frame, &frameLen);
+            if (!measured) {
+                if ((U32_AT(frame) & 0xffe0f000) != 0xffe00000) {
+                    size_t skip = 1 + findFrameHeader(frame + 1, inHeader->nFilledLen - 1);
+                    ALOGW("lost sync, skipping %zu bytes", skip);
+                    consumeInput(inHeader, skip);
+                    continue;
+                }
+                // Free format; leave it to the decoder, the rest of the
+                // buffer as one frame.
+                frameLen = inHeader->nFilledLen;
+            } else if (frameLen > inHeader->nFilledLen) {
+                if (!(inHeader->nFlags & OMX_BUFFERFLAG_EOS)) {
+                    mStagedFrameLen = frameLen;
+                    stageInput(inHeader, inHeader->nFilledLen);
+                    continue;
+                }
+                frameLen = inHeader->nFilledLen;
+            }
+            frameInput = frameLen;
+
+            haveNext = peekInput(frameInput, next, sizeof(next), &eos);
         }
 
-        inputParam.frame_buf_ptr = mMaxFrameBuf;
-        inputParam.frame_len = mPreFilledLen;
-        //Get current frame bitrate.
-        mBitRate = getCurFrameBitRate(inputParam.frame_buf_ptr);
-        if ((!inHeader && mInputEosUnDecode)
-                || (inHeader && (inHeader->nFlags & OMX_BUFFERFLAG_EOS) && inHeader->nFilledLen == 0)
-                || (inHeader && (inHeader->nFlags & OMX_BUFFERFLAG_EOS) && mFirstFrame)) {
-            mEOSFlag = true;
-            mNextMdBegin = 0;
-        } else {
-            if (inHeader->nFlags & OMX_BUFFERFLAG_EOS) {
-                mInputEosUnDecode = true;
+        if (!haveNext && !eos) {
+            if (!inputStarved()) {
+                break;
+            }
+            // The client has no buffers left to send the next header in;
+            // stage what we have so it gets them back.
+            if (frameInput == 0 || frameLen <= MP3_MAX_DATA_FRAME_LEN) {
+                if (frameInput > 0) {
+                    mStagedFrameLen = frameLen;
+                }
+                stageInput(inHeader, mStagedFrameLen + sizeof(next) - mStagedLen);
+                continue;
             }
-            mEOSFlag = false;
-            mNextMdBegin = getNextMdBegin(inHeader->pBuffer + inHeader->nOffset);
+            ALOGW("input starved, decoding without the next header");
+        }
+        uint32_t nextMdBegin = haveNext ? getNextMdBegin(next) : 0;
+
+        if (measured && (mFrameHeader.mSamplingRate != mSamplingRate
+                || mFrameHeader.mNumChannels != mNumChannels)) {
+            ALOGI("Send OMX_EventPortSettingsChanged [%d %d] to [%d %d]",
+                    mSamplingRate, mNumChannels,
+                    mFrameHeader.mSamplingRate, mFrameHeader.mNumChannels);
+            if (mOutputPacker.frameCount() > 0 || outFrames > 0) {
+                returnOutputBuffer(outInfo);
+            }
+            mSamplingRate = mFrameHeader.mSamplingRate;
+            mNumChannels = mFrameHeader.mNumChannels;
+            notify(OMX_EventPortSettingsChanged, 1, 0, NULL);
+            mOutputPortSettingsChange = AWAITING_DISABLED;
+            return;
         }
-        inputParam.next_begin = mNextMdBegin;
+
+        FRAME_DEC_T inputParam ;
+        OUTPUT_FRAME_T outputFrame ;
+        uint32_t decoderRet = 0;
+
+        memset(&inputParam, 0, sizeof(FRAME_DEC_T));
+        memset(&outputFrame, 0, sizeof(OUTPUT_FRAME_T));
+
+        mBitRate = measured ? mFrameHeader.mBitRate : 0;
+
+        inputParam.frame_buf_ptr = const_cast<uint8_t *>(frame);
+        inputParam.frame_len = frameLen;
+        inputParam.next_begin = nextMdBegin;
         inputParam.bitrate = mBitRate; //kbps
 
-        newRate=0;
-        newChannel=0;
-        uint32_t header = U32_AT(inputParam.frame_buf_ptr);
-        config_status=getMPEGAudioFrameSize(header,&newRate,&newChannel,&newBitRate);
         //Config decoded output frame params.
         outputFrame.pcm_data_l_ptr = mLeftBuf;
         outputFrame.pcm_data_r_ptr = mRightBuf;
         mMP3_ARM_DEC_DecodeFrame(mMP3DecHandle, &inputParam,&outputFrame, &decoderRet);
+
+        if (frameInput > 0) {
+            consumeInput(inHeader, frameInput);
+        } else {
+            unstageFrame(inHeader);
+        }
+
+        if (mOutputPacker.frameCount() == 0 && outFrames == 0) {
+            outHeader->nOffset = 0;
+            outHeader->nFilledLen = 0;
+        }
+        uint16_t * pOutputBuffer = reinterpret_cast<uint16_t *>(mOutputPacker.tail(outHeader));
+        size_t numOutBytes;
+
         if(decoderRet != MP3_ARM_DEC_ERROR_NONE) { //decoder error
             ALOGE("MP3 decoder returned error %d, substituting silence", decoderRet);
-            outputFrame.pcm_bytes = 1152; //samples number
-        }else{
-            if(true==config_status){
-                if((newRate!=mSamplingRate)|| (newChannel != mNumChannels)){
-                    ALOGI("Send OMX_EventPortSettingsChanged [%d %d] to [%d %d]",
-                        mSamplingRate,mNumChannels,newRate,newChannel);
-                    if(newRate!=0){
-                        mSamplingRate = newRate;
-                    }
-                    mNumChannels = newChannel;
-                    notify(OMX_EventPortSettingsChanged, 1, 0, NULL);
-                    mOutputPortSettingsChange = AWAITING_DISABLED;
-                    continue;
-                }
-            }
+            outputFrame.pcm_bytes = MP3_DEC_FRAME_LEN; //samples number
+            numOutBytes = outputFrame.pcm_bytes * mNumChannels * sizeof(int16_t);
+            memset(pOutputBuffer, 0, numOutBytes);
+        } else if (2 == mNumChannels) {
+            numOutBytes = outputFrame.pcm_bytes * sizeof(int16_t) * 2;
+            interleaveChannels(mLeftBuf, mRightBuf, pOutputBuffer, outputFrame.pcm_bytes);
+        } else {
+            numOutBytes = outputFrame.pcm_bytes * sizeof(int16_t);
+            memcpy(pOutputBuffer, mLeftBuf, numOutBytes);
         }
-        uint16_t * pOutputBuffer = reinterpret_cast<uint16_t *>(outHeader->pBuffer);
 
-        if(decoderRet != MP3_ARM_DEC_ERROR_NONE) {
-            numOutBytes = outputFrame.pcm_bytes * sizeof(int16_t) *2;
-            memset(outHeader->pBuffer, 0, numOutBytes);
-        } else {
-            for(int i=0; i<outputFrame.pcm_bytes; i++) {
-                if (2 == mNumChannels) {
-                    numOutBytes = outputFrame.pcm_bytes * sizeof(int16_t) *2;
-                    pOutputBuffer[2*i] = mLeftBuf[i];
-                    pOutputBuffer[2*i+1] = mRightBuf[i];
-                } else {
-                    numOutBytes = outputFrame.pcm_bytes * sizeof(int16_t);
-                    pOutputBuffer[i] = mLeftBuf[i];
-                }
+        OMX_TICKS timeUs = mAnchorTimeUs + (mNumFramesOutput * 1000000ll) / mSamplingRate;
+        mLastInTimeUs = timeUs;
+        mNumFramesOutput += outputFrame.pcm_bytes;
+
+        if (mOutputPacker.frameCount() > 0) {
+            mOutputPacker.append(outHeader, timeUs, numOutBytes, 0);
+            if (mOutputPacker.isFull(outHeader, kMaxFrameBytes)) {
+                returnOutputBuffer(outInfo);
             }
+            continue;
+        }
+
+        if (outFrames > 0) {
+            outHeader->nFilledLen += numOutBytes;
+            ++outFrames;
+            continue;
         }
 
+        outHeader->nTimeStamp = timeUs;
+        outHeader->nFlags = 0;
+
         if (mFirstFrame) {
             mFirstFrame = false;
             // The decoder delay is 529 samples, so trim that many samples off
@@ -667,52 +935,37 @@ void SPRDMP3Decoder::onQueueFilled(OMX_U32 portIndex) {
             // decoder have zero delay, which the rest of the pipeline assumes.
             outHeader->nOffset = kPVMP3DecoderDelay * mNumChannels * sizeof(int16_t);
 
-            if(numOutBytes<outHeader->nOffset){
-                outHeader->nFilledLen = 0;
-                ALOGW("onQueueFilled set nFilledLen to 0",__LINE__);
-            }else{
-                outHeader->nFilledLen = numOutBytes - outHeader->nOffset;
+            if (numOutBytes <= outHeader->nOffset) {
+                ALOGI("onQueueFilled, numOutBytes:%zu <= outHeader->nOffset:%u, continue",
+                        numOutBytes, outHeader->nOffset);
+                outHeader->nOffset = 0;
+                continue;
             }
+            outHeader->nFilledLen = numOutBytes - outHeader->nOffset;
         } else {
-            outHeader->nOffset = 0;
             outHeader->nFilledLen = numOutBytes;
         }
-        ALOGV("outHeader, numOutBytes:%d, offset:%d, filledlen:%d",numOutBytes,outHeader->nOffset,outHeader->nFilledLen);
-        outHeader->nTimeStamp =
-            mLastInTimeUs
-            + (mNumFramesOutput * 1000000ll) / mSamplingRate;
-
-        outHeader->nFlags = 0;
-
-        mNumFramesOutput += outputFrame.pcm_bytes;
-
-        if(mEOSFlag == false) {
-            if (inHeader) {
-                mPreFilledLen = inHeader->nFilledLen;
-                if (mMaxFrameBuf && mPreFilledLen <= MP3_MAX_DATA_FRAME_LEN) {
-                    memcpy(mMaxFrameBuf, inHeader->pBuffer + inHeader->nOffset, mPreFilledLen);
-                    mLastInTimeUs = mAnchorTimeUs;
-                }
-
-                inInfo->mOwnedByUs = false;
-                inQueue.erase(inQueue.begin());
-                inInfo = NULL;
-                notifyEmptyBufferDone(inHeader);
-                inHeader = NULL;
+        ALOGV("outHeader, numOutBytes:%zu, offset:%u, filledlen:%u",
+                numOutBytes, outHeader->nOffset, outHeader->nFilledLen);
+
+        if (mOutputPacker.enabled()) {
+            // Becomes the first frame of the packed buffer.
+            OMX_U32 size = outHeader->nFilledLen;
+            outHeader->nFilledLen = 0;
+            mOutputPacker.append(outHeader, timeUs, size, 0);
+            if (mOutputPacker.isFull(outHeader, kMaxFrameBytes)) {
+                returnOutputBuffer(outInfo);
             }
-        }
-
-        if (numOutBytes <= outHeader->nOffset) {
-            ALOGI("onQueueFilled, numOutBytes:%d <= outHeader->nOffset:%ld, continue", numOutBytes, outHeader->nOffset);
             continue;
         }
 
-        outInfo->mOwnedByUs = false;
-        outQueue.erase(outQueue.begin());
-        outInfo = NULL;
-        notifyFillBufferDone(outHeader);
-        outHeader = NULL;
+        outFrames = 1;
+    }
 
+    // Nothing more to decode for now; what has been decoded goes out.
+    // Packed buffers wait to be filled, as the client asked for.
+    if (outFrames > 0) {
+        returnOutputBuffer(*outQueue.begin());
     }
 }
 
@@ -721,18 +974,19 @@ void SPRDMP3Decoder::onPortFlushPrepare(OMX_U32 portIndex) {
         ALOGI("onPortFlushPrepare.");
         // Make sure that the next buffer output does not still
         // depend on fragments from the last one decoded.
-        mNextMdBegin = 0;
-        mPreFilledLen = 0;
+        mStagedLen = 0;
+        mStagedFrameLen = 0;
+        mStagedFromHead = 0;
+        mInputStarted = false;
         if (mLeftBuf) memset(mLeftBuf, 0, MP3_DEC_FRAME_LEN<<1);
         if (mRightBuf) memset(mRightBuf, 0, MP3_DEC_FRAME_LEN<<1);
         mMP3_ARM_DEC_InitDecoder(mMP3DecHandle);
-        mIsFirst = true;
         mFirstFrame = true;
     }
 }
 void SPRDMP3Decoder::onPortFlushCompleted(OMX_U32 portIndex) {
     if (portIndex == 0) {
-        mInputEosUnDecode = false;
+        mInputEOS = false;
         mEOSFlag = false;
     }
     // TODO
@@ -814,7 +1068,11 @@ bool SPRDMP3Decoder::openDecoder(const char* libName) {
 
 void SPRDMP3Decoder::onReset() {
     // TODO
-    mInputEosUnDecode = false;
+    mStagedLen = 0;
+    mStagedFrameLen = 0;
+    mStagedFromHead = 0;
+    mInputStarted = false;
+    mInputEOS = false;
     mEOSFlag = false;
     ALOGI("onReset.");
 }
@@ -23,7 +23,7 @@
 
 namespace android {
 
-#define MP3_MAX_DATA_FRAME_LEN  (1536)  //unit by bytes
+#define MP3_MAX_DATA_FRAME_LEN  (2881)  //unit by bytes, largest layer I-III frame
 #define MP3_DEC_FRAME_LEN       (1152)  //pcm samples number
 
 struct SPRDMP3Decoder : public SprdSimpleOMXComponent {
@@ -50,30 +50,55 @@ protected:
 private:
     enum {
         kNumBuffers = 4,
-        kOutputBufferSize = 4608 * 2,
-        kPVMP3DecoderDelay = 529 // frames
+        kFramesPerOutputBuffer = 4,
+        kMaxFrameBytes = MP3_DEC_FRAME_LEN * 2 * sizeof(int16_t), // stereo
+        kOutputBufferSize = kMaxFrameBytes * kFramesPerOutputBuffer,
+        kPVMP3DecoderDelay = 529, // frames
+        kNextHeaderBytes = 8,     // of the next frame, for getNextMdBegin()
+    };
+
+    // The fields of the last frame header parsed. Headers of a stream
+    // rarely change, so most frames are measured with one compare.
+    struct FrameHeader {
+        uint32_t mHeader;   // masked with kFrameHeaderMask
+        int32_t mSamplingRate;
+        int32_t mNumChannels;
+        int32_t mBitRate;   // kbps
+        size_t mFrameSize;  // without the padding slot
+        size_t mSlotSize;
     };
 
     int32_t mNumChannels;
     int32_t mSamplingRate;
     int32_t mBitRate;
-    uint16_t mNextMdBegin;
-    int32_t mPreFilledLen;
 
     void *mMP3DecHandle;
     uint16_t *mLeftBuf;  //output pcm buffer
     uint16_t *mRightBuf;
+
+    // A frame that straddles input buffers, put together here with the
+    // start of the next one. Frames that lie within one buffer are
+    // decoded where they are. mStagedFrameLen is 0 until the header is
+    // complete; mStagedFromHead counts the bytes at the end that came
+    // from the input buffer at the head of the queue.
     uint8_t *mMaxFrameBuf;
+    size_t mStagedLen;
+    size_t mStagedFrameLen;
+    size_t mStagedFromHead;
+
+    FrameHeader mFrameHeader;
 
     int64_t mLastInTimeUs;
     int64_t mAnchorTimeUs;
     int64_t mNumFramesOutput;
 
-    bool mIsFirst;
+    // Whether the input buffer at the head of the queue has been read
+    // from; its timestamp anchors the frames that start in it.
+    bool mInputStarted;
+    bool mInputEOS;     // the EOS buffer went back; only staged input is left
     bool mEOSFlag;
     bool mFirstFrame;
     bool mSignalledError;
-    bool mInputEosUnDecode;
     void* mLibHandle;
 
     FT_MP3_ARM_DEC_Construct mMP3_ARM_DEC_Construct;
@@ -90,8 +115,15 @@ private:
     void initPorts();
     void initDecoder();
 
-    uint32_t getNextMdBegin(uint8_t *frameBuf);
-    uint32_t getCurFrameBitRate(uint8_t *frameBuf);
+    bool parseFrameHeader(const uint8_t *frameBuf, size_t *frameLen);
+    size_t findFrameHeader(const uint8_t *data, size_t size);
+    uint32_t getNextMdBegin(const uint8_t *frameBuf);
+    bool peekInput(size_t skip, uint8_t *data, size_t size, bool *eos);
+    void consumeInput(OMX_BUFFERHEADERTYPE *inHeader, size_t size);
+    void stageInput(OMX_BUFFERHEADERTYPE *inHeader, size_t size);
+    void unstageFrame(OMX_BUFFERHEADERTYPE *inHeader);
+    bool inputStarved();
+    void returnOutputBuffer(BufferInfo *outInfo);
     bool openDecoder(const char* libName);
 
     DISALLOW_EVIL_CONSTRUCTORS(SPRDMP3Decoder);
@@ -408,8 +408,8 @@ void SprdMP3Encoder::onQueueFilled(OMX_U32 /* portIndex */) {
                 copy_need = numBytesPerInputFrame ;
                 mMp3_enc_init = true ;
        }
-    List<BufferInfo *> &inQueue = getPortQueue(0);
-    List<BufferInfo *> &outQueue = getPortQueue(1);
+    PortQueue &inQueue = getPortQueue(0);
+    PortQueue &outQueue = getPortQueue(1);
 
     for (;;) {
         // We do the following until we run out of buffers.
@@ -0,0 +1,136 @@
+LOCAL_PATH := $(call my-dir)
+
+# Host builds of the engine libraries, the deinterlacer core, libmemion
+# and the GraphicBufferMapper of libui, exporting the same symbols as the
+# device ones, so the components can be loaded and driven on an x86 Linux
+# host. See MockVspEngine.h for the environment variables that set
+# latency, error injection and DPB behaviour.
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    libmemion/MemIon.cpp
+
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/libmemion
+
+LOCAL_SHARED_LIBRARIES := \
+    libutils                \
+    liblog
+
+LOCAL_MODULE := libmemion
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+# GraphicBufferMapper over the dma-buf fds of libmemion buffers, for the
+# components that lock native output buffers.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    libui/GraphicBufferMapper.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/libui/include \
+    $(TOP)/vendor/sprd/external/drivers/gpu
+
+# The components include both <ui/Rect.h> and "Rect.h".
+LOCAL_EXPORT_C_INCLUDE_DIRS := \
+    $(LOCAL_PATH)/libui/include \
+    $(LOCAL_PATH)/libui/include/ui
+
+LOCAL_SHARED_LIBRARIES := \
+    libutils                \
+    libcutils               \
+    liblog
+
+LOCAL_MODULE := libui
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    MockVspEngine.cpp \
+    MockAvcDecEngine.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/libmemion \
+    $(LOCAL_PATH)/../video/avc/dec/hw
+
+LOCAL_SHARED_LIBRARIES := \
+    libmemion               \
+    libutils                \
+    liblog
+
+LOCAL_MODULE := libomx_avcdec_hw_sprd
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    MockVspEngine.cpp \
+    MockAvcEncEngine.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/libmemion \
+    $(LOCAL_PATH)/../video/avc/enc
+
+LOCAL_SHARED_LIBRARIES := \
+    libmemion               \
+    libutils                \
+    liblog
+
+LOCAL_MODULE := libomx_avcenc_hw_sprd
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    MockVspEngine.cpp \
+    MockHevcDecEngine.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/libmemion \
+    $(LOCAL_PATH)/../video/hevc/dec
+
+LOCAL_STATIC_LIBRARIES := libsprd_bitstream
+
+LOCAL_SHARED_LIBRARIES := \
+    libmemion               \
+    libutils                \
+    liblog
+
+LOCAL_MODULE := libomx_hevcdec_hw_sprd
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+# Linked into the host libstagefright_sprd_deintl in place of the
+# register-level core/vsp sources.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    MockVspEngine.cpp \
+    MockDeintEngine.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/libmemion \
+    $(LOCAL_PATH)/../video/vpp/deintl/core/vsp
+
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)
+
+LOCAL_MODULE := libsprd_deint_mock
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_STATIC_LIBRARY)
@@ -0,0 +1,613 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host stand-in for libomx_avcdec_hw_sprd.so. It parses just enough of the
+// stream (NAL types, SPS dimensions) to drive SPRDAVCDecoder through its
+// real paths: extra/mbinfo memory callbacks on a new sequence, a DPB that
+// binds and unbinds output buffers as the hardware does, display reorder,
+// the deinterlacer for field coded streams, and the configured latency and
+// errors of MockVspEngine.h. No picture is actually decoded.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MockAvcDecEngine"
+#include <utils/Log.h>
+#include <utils/Vector.h>
+
+#include "MockVspEngine.h"
+#include "avc_dec_api.h"
+
+#include <string.h>
+
+using namespace android;
+
+namespace {
+
+const int kVspMaster = 0;
+const size_t kMaxSpsSize = 256;
+
+// Exp-Golomb reader over an unescaped RBSP; reads past the end return 0.
+struct BitReader {
+    BitReader(const uint8 *data, size_t size)
+        : mData(data), mSize(size), mPos(0) {}
+
+    uint32 bit() {
+        if (mPos >= mSize * 8) {
+            mPos++;
+            return 0;
+        }
+        uint32 b = (mData[mPos >> 3] >> (7 - (mPos & 7))) & 1;
+        mPos++;
+        return b;
+    }
+
+    uint32 bits(int n) {
+        uint32 v = 0;
+        while (n-- > 0) {
+            v = (v << 1) | bit();
+        }
+        return v;
+    }
+
+    uint32 ue() {
+        int zeros = 0;
+        while (bit() == 0 && zeros < 32) {
+            zeros++;
+        }
+        return ((1u << zeros) - 1) + bits(zeros);
+    }
+
+    int32 se() {
+        uint32 v = ue();
+        return (v & 1) ? (int32)((v + 1) / 2) : -(int32)(v / 2);
+    }
+
+    bool overrun() const { return mPos > mSize * 8; }
+
+private:
+    const uint8 *mData;
+    size_t mSize;
+    size_t mPos;
+};
+
+struct Picture {
+    void *mHeader;
+    uint8 *mY;
+    int32 mPicId;
+    uint64 mPts;
+    bool mIsRef;
+    bool mPending;   // decoded, not yet handed out for display
+};
+
+struct MockAvcDecoder {
+    AVCHandle *mHandle;
+    MockVspConfig mConfig;
+    uint32_t mSeed;
+    int64_t mFrames;
+
+    bool mSawSPS;
+    bool mSawPPS;
+    bool mHaveInfo;
+    H264SwDecInfo mInfo;
+
+    bool mNewSeq;
+    bool mMemInited;
+    bool mSizeConfirmed;
+
+    bool mHaveCur;
+    Picture mCur;
+
+    // Every picture the engine holds a bind on, in decode order.
+    Vector<Picture> mHeld;
+};
+
+MockAvcDecoder *getDecoder(AVCHandle *avcHandle) {
+    return avcHandle != NULL ? (MockAvcDecoder *)avcHandle->videoDecoderData : NULL;
+}
+
+size_t unescape(const uint8 *nal, size_t size, uint8 *out, size_t outSize) {
+    size_t n = 0;
+    int zeros = 0;
+    for (size_t i = 0; i < size && n < outSize; ++i) {
+        if (zeros >= 2 && nal[i] == 3) {
+            zeros = 0;
+            continue;
+        }
+        zeros = nal[i] == 0 ? zeros + 1 : 0;
+        out[n++] = nal[i];
+    }
+    return n;
+}
+
+void skipScalingList(BitReader *br, int size) {
+    int32 lastScale = 8;
+    int32 nextScale = 8;
+    for (int j = 0; j < size; ++j) {
+        if (nextScale != 0) {
+            nextScale = (lastScale + br->se() + 256) % 256;
+        }
+        lastScale = nextScale == 0 ? lastScale : nextScale;
+    }
+}
+
+bool parseSps(const uint8 *nal, size_t size, H264SwDecInfo *info) {
+    uint8 rbsp[kMaxSpsSize];
+    size_t rbspSize = unescape(nal + 1, size - 1, rbsp, sizeof(rbsp));
+    BitReader br(rbsp, rbspSize);
+
+    uint32 profile = br.bits(8);
+    br.bits(16);   // constraint flags, level_idc
+    br.ue();       // seq_parameter_set_id
+
+    uint32 chromaFormat = 1;
+    if (profile == 100 || profile == 110 || profile == 122 || profile == 244
+            || profile == 44 || profile == 83 || profile == 86 || profile == 118
+            || profile == 128 || profile == 138 || profile == 139
+            || profile == 134 || profile == 135) {
+        chromaFormat = br.ue();
+        if (chromaFormat == 3) {
+            br.bit();
+        }
+        br.ue();   // bit_depth_luma_minus8
+        br.ue();   // bit_depth_chroma_minus8
+        br.bit();  // qpprime_y_zero_transform_bypass_flag
+        if (br.bit()) {
+            for (int i = 0; i < (chromaFormat != 3 ? 8 : 12); ++i) {
+                if (br.bit()) {
+                    skipScalingList(&br, i < 6 ? 16 : 64);
+                }
+            }
+        }
+    }
+
+    br.ue();   // log2_max_frame_num_minus4
+    uint32 pocType = br.ue();
+    if (pocType == 0) {
+        br.ue();
+    } else if (pocType == 1) {
+        br.bit();
+        br.se();
+        br.se();
+        uint32 cycle = br.ue();
+        for (uint32 i = 0; i < cycle && i < 256; ++i) {
+            br.se();
+        }
+    }
+
+    uint32 numRefFrames = br.ue();
+    br.bit();  // gaps_in_frame_num_value_allowed_flag
+    uint32 widthMbs = br.ue() + 1;
+    uint32 heightMapUnits = br.ue() + 1;
+    uint32 frameMbsOnly = br.bit();
+    if (!frameMbsOnly) {
+        br.bit();
+    }
+    br.bit();  // direct_8x8_inference_flag
+
+    uint32 cropLeft = 0, cropRight = 0, cropTop = 0, cropBottom = 0;
+    uint32 croppingFlag = br.bit();
+    if (croppingFlag) {
+        cropLeft = br.ue();
+        cropRight = br.ue();
+        cropTop = br.ue();
+        cropBottom = br.ue();
+    }
+
+    if (br.overrun() || widthMbs > 512 || heightMapUnits > 512) {
+        return false;
+    }
+
+    memset(info, 0, sizeof(*info));
+    info->profile = profile;
+    info->picWidth = widthMbs * 16;
+    info->picHeight = heightMapUnits * 16 * (2 - frameMbsOnly);
+    info->numRefFrames = numRefFrames;
+    info->frame_mb_only = frameMbsOnly;
+    // Field pictures come out as interleaved frames for SPRDDeinterlace.
+    info->need_deinterlace = !frameMbsOnly;
+    info->parWidth = 1;
+    info->parHeight = 1;
+    info->colorPrimaries = 2;
+    info->transfer = 2;
+    info->matrixCoefficients = 2;
+
+    uint32 cropUnitX = chromaFormat == 0 || chromaFormat == 3 ? 1 : 2;
+    uint32 cropUnitY = (chromaFormat == 1 ? 2 : 1) * (2 - frameMbsOnly);
+    info->croppingFlag = croppingFlag;
+    info->cropParams.cropLeftOffset = cropLeft * cropUnitX;
+    info->cropParams.cropOutWidth = info->picWidth - (cropLeft + cropRight) * cropUnitX;
+    info->cropParams.cropTopOffset = cropTop * cropUnitY;
+    info->cropParams.cropOutHeight = info->picHeight - (cropTop + cropBottom) * cropUnitY;
+    return true;
+}
+
+void unbindIfDone(MockAvcDecoder *dec, size_t index) {
+    const Picture &pic = dec->mHeld.itemAt(index);
+    if (pic.mIsRef || pic.mPending) {
+        return;
+    }
+    if (dec->mHandle->VSP_unbindCb != NULL) {
+        (*dec->mHandle->VSP_unbindCb)(dec->mHandle->userdata, pic.mHeader);
+    }
+    dec->mHeld.removeAt(index);
+}
+
+void releaseAll(MockAvcDecoder *dec) {
+    while (!dec->mHeld.empty()) {
+        Picture &pic = dec->mHeld.editItemAt(0);
+        pic.mIsRef = false;
+        pic.mPending = false;
+        unbindIfDone(dec, 0);
+    }
+}
+
+// The pending picture with the lowest timestamp, or -1.
+ssize_t nextToDisplay(MockAvcDecoder *dec) {
+    ssize_t best = -1;
+    for (size_t i = 0; i < dec->mHeld.size(); ++i) {
+        const Picture &pic = dec->mHeld.itemAt(i);
+        if (pic.mPending && (best < 0 || pic.mPts < dec->mHeld.itemAt(best).mPts)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+size_t pendingCount(MockAvcDecoder *dec) {
+    size_t count = 0;
+    for (size_t i = 0; i < dec->mHeld.size(); ++i) {
+        count += dec->mHeld.itemAt(i).mPending ? 1 : 0;
+    }
+    return count;
+}
+
+Picture popDisplay(MockAvcDecoder *dec, ssize_t index) {
+    Picture pic = dec->mHeld.itemAt(index);
+    dec->mHeld.editItemAt(index).mPending = false;
+    unbindIfDone(dec, index);
+    return pic;
+}
+
+void fillPicture(MockAvcDecoder *dec, const Picture &pic) {
+    size_t lumaSize = dec->mInfo.picWidth * dec->mInfo.picHeight;
+    memset(pic.mY, 16 + (dec->mFrames & 0x7f), lumaSize);
+    memset(pic.mY + lumaSize, 128, lumaSize / 2);
+}
+
+MMDecRet decodePicture(MockAvcDecoder *dec, bool idr, MMDecOutput *pOutput) {
+    if (idr) {
+        for (size_t i = dec->mHeld.size(); i-- > 0;) {
+            dec->mHeld.editItemAt(i).mIsRef = false;
+            unbindIfDone(dec, i);
+        }
+    }
+
+    Picture pic = dec->mCur;
+    pic.mIsRef = true;
+    pic.mPending = true;
+    dec->mHaveCur = false;
+
+    if (dec->mConfig.mFill && dec->mSizeConfirmed && pic.mY != NULL) {
+        fillPicture(dec, pic);
+    }
+    dec->mSizeConfirmed = true;
+
+    if (dec->mHandle->VSP_bindCb != NULL) {
+        (*dec->mHandle->VSP_bindCb)(dec->mHandle->userdata, pic.mHeader);
+    }
+    dec->mHeld.push_back(pic);
+
+    // Sliding window over the reference pictures.
+    uint32 maxRefs = dec->mInfo.numRefFrames > 0 ? dec->mInfo.numRefFrames : 1;
+    uint32 refs = 0;
+    for (size_t i = dec->mHeld.size(); i-- > 0;) {
+        Picture &held = dec->mHeld.editItemAt(i);
+        if (held.mIsRef && ++refs > maxRefs) {
+            held.mIsRef = false;
+            unbindIfDone(dec, i);
+        }
+    }
+
+    if (pendingCount(dec) > (size_t)dec->mConfig.mReorder) {
+        Picture out = popDisplay(dec, nextToDisplay(dec));
+        pOutput->pOutFrameY = out.mY;
+        pOutput->pOutFrameU = out.mY != NULL
+                ? out.mY + dec->mInfo.picWidth * dec->mInfo.picHeight : NULL;
+        pOutput->pOutFrameV = NULL;
+        pOutput->frame_width = dec->mInfo.picWidth;
+        pOutput->frame_height = dec->mInfo.picHeight;
+        pOutput->pts = out.mPts;
+        pOutput->pBufferHeader = out.mHeader;
+        pOutput->mPicId = out.mPicId;
+        pOutput->frameEffective = 1;
+    }
+
+    return MMDEC_OK;
+}
+
+}  // namespace
+
+extern "C" {
+
+MMDecRet H264DecInit(AVCHandle *avcHandle, MMCodecBuffer * /* pBuffer */,
+                     MMDecVideoFormat * /* pVideoFormat */) {
+    if (avcHandle == NULL) {
+        return MMDEC_PARAM_ERROR;
+    }
+
+    MockAvcDecoder *dec = new MockAvcDecoder;
+    dec->mHandle = avcHandle;
+    MockVspLoadConfig(&dec->mConfig, MMDEC_STREAM_ERROR);
+    dec->mSeed = 1;
+    dec->mFrames = 0;
+    dec->mSawSPS = false;
+    dec->mSawPPS = false;
+    dec->mHaveInfo = false;
+    memset(&dec->mInfo, 0, sizeof(dec->mInfo));
+    dec->mNewSeq = false;
+    dec->mMemInited = false;
+    dec->mSizeConfirmed = false;
+    dec->mHaveCur = false;
+
+    avcHandle->videoDecoderData = dec;
+    return MMDEC_OK;
+}
+
+MMDecRet H264DecMemInit(AVCHandle *avcHandle, MMCodecBuffer *pBuffer) {
+    MockAvcDecoder *dec = getDecoder(avcHandle);
+    if (dec == NULL || pBuffer == NULL) {
+        return MMDEC_PARAM_ERROR;
+    }
+    dec->mMemInited = true;
+    return MMDEC_OK;
+}
+
+MMDecRet H264DecSetParameter(AVCHandle *avcHandle, MMDecVideoFormat * /* pVideoFormat */) {
+    return getDecoder(avcHandle) != NULL ? MMDEC_OK : MMDEC_INVALID_STATUS;
+}
+
+MMDecRet H264GetCodecCapability(AVCHandle *avcHandle, MMDecCapability *Capability) {
+    MockAvcDecoder *dec = getDecoder(avcHandle);
+    if (dec == NULL) {
+        return MMDEC_INVALID_STATUS;
+    }
+    Capability->profile = AVC_HIGH;
+    Capability->level = AVC_LEVEL5_1;
+    Capability->max_width = dec->mConfig.mMaxWidth;
+    Capability->max_height = dec->mConfig.mMaxHeight;
+    Capability->support_1080i = 1;
+    return MMDEC_OK;
+}
+
+MMDecRet H264DecGetNALType(AVCHandle * /* avcHandle */, uint8 *bitstream, int size,
+                           int *nal_type, int *nal_ref_idc) {
+    size_t nalSize;
+    int32_t offset = MockVspNextNal(bitstream, size, 0, &nalSize);
+    if (offset < 0 || nalSize == 0) {
+        return MMDEC_ERROR;
+    }
+    *nal_type = bitstream[offset] & 0x1f;
+    *nal_ref_idc = (bitstream[offset] >> 5) & 0x3;
+    return MMDEC_OK;
+}
+
+MMDecRet H264DecGetInfo(AVCHandle *avcHandle, H264SwDecInfo *pDecInfo) {
+    MockAvcDecoder *dec = getDecoder(avcHandle);
+    if (dec == NULL || !dec->mHaveInfo) {
+        return MMDEC_ERROR;
+    }
+    *pDecInfo = dec->mInfo;
+    pDecInfo->has_b_frames = dec->mConfig.mReorder;
+    return MMDEC_OK;
+}
+
+void H264Dec_SetCurRecPic(AVCHandle *avcHandle, uint8 *pFrameY,
+                          uint8 * /* pFrameY_phy */, void *pBufferHeader, int32 picId) {
+    MockAvcDecoder *dec = getDecoder(avcHandle);
+    if (dec == NULL) {
+        return;
+    }
+    dec->mCur.mHeader = pBufferHeader;
+    dec->mCur.mY = pFrameY;
+    dec->mCur.mPicId = picId;
+    dec->mCur.mPts = 0;
+    dec->mHaveCur = true;
+}
+
+MMDecRet H264DecDecode(AVCHandle *avcHandle, MMDecInput *pInput, MMDecOutput *pOutput) {
+    MockAvcDecoder *dec = getDecoder(avcHandle);
+    if (dec == NULL) {
+        return MMDEC_INVALID_STATUS;
+    }
+
+    pOutput->frameEffective = 0;
+    pOutput->reqNewBuf = 0;
+    pOutput->err_MB_num = 0;
+
+    if (pInput->pStream == NULL) {
+        // Secure input cannot be parsed on the host.
+        return MMDEC_NOT_SUPPORTED;
+    }
+
+    bool sawSlice = false;
+    bool idr = false;
+    size_t offset = 0;
+    size_t nalSize;
+    int32_t start;
+    while ((start = MockVspNextNal(pInput->pStream, pInput->dataLen, offset, &nalSize)) >= 0) {
+        const uint8 *nal = pInput->pStream + start;
+        offset = start + nalSize;
+        if (nalSize == 0) {
+            continue;
+        }
+
+        switch (nal[0] & 0x1f) {
+            case 1:
+            case 5:
+                sawSlice = true;
+                idr = idr || (nal[0] & 0x1f) == 5;
+                break;
+            case 7:
+            {
+                H264SwDecInfo info;
+                if (!parseSps(nal, nalSize, &info)) {
+                    ALOGW("unparsable SPS");
+                    return MMDEC_STREAM_ERROR;
+                }
+                if (!dec->mHaveInfo || info.picWidth != dec->mInfo.picWidth
+                        || info.picHeight != dec->mInfo.picHeight
+                        || info.numRefFrames != dec->mInfo.numRefFrames) {
+                    ALOGI("new sequence %ux%u, %u refs",
+                            info.picWidth, info.picHeight, info.numRefFrames);
+                    dec->mNewSeq = true;
+                    dec->mSizeConfirmed = false;
+                }
+                dec->mInfo = info;
+                dec->mHaveInfo = true;
+                dec->mSawSPS = true;
+                break;
+            }
+            case 8:
+                dec->mSawPPS = true;
+                break;
+            default:
+                break;
+        }
+    }
+
+    pOutput->sawSPS = dec->mSawSPS;
+    pOutput->sawPPS = dec->mSawPPS;
+
+    if (!sawSlice) {
+        return MMDEC_OK;
+    }
+    if (!dec->mSawSPS || !dec->mSawPPS) {
+        return MMDEC_STREAM_ERROR;
+    }
+    if (pInput->expected_IVOP && !idr) {
+        return MMDEC_FRAME_SEEK_IVOP;
+    }
+
+    if (dec->mNewSeq || !dec->mMemInited) {
+        dec->mNewSeq = false;
+        dec->mMemInited = false;
+
+        uint32 mbs = (dec->mInfo.picWidth / 16) * (dec->mInfo.picHeight / 16);
+        if (avcHandle->VSP_extMemCb == NULL
+                || (*avcHandle->VSP_extMemCb)(avcHandle->userdata, mbs * 384 + 0x10000) != 0
+                || !dec->mMemInited) {
+            return MMDEC_MEMORY_ERROR;
+        }
+
+        uint32 refs = dec->mInfo.numRefFrames > 0 ? dec->mInfo.numRefFrames : 1;
+        for (uint32 i = 0; i <= refs && avcHandle->VSP_mbinfoMemCb != NULL; ++i) {
+            unsigned long phy;
+            if ((*avcHandle->VSP_mbinfoMemCb)(avcHandle->userdata, mbs * 32, &phy) != 0) {
+                return MMDEC_MEMORY_ERROR;
+            }
+        }
+    }
+
+    if (!dec->mHaveCur) {
+        ALOGE("no reconstruction picture set");
+        return MMDEC_ERROR;
+    }
+    dec->mCur.mPts = pInput->nTimeStamp;
+
+    dec->mFrames++;
+    MockVspSpendFrameTime(dec->mConfig, &dec->mSeed);
+    if (MockVspInjectError(dec->mConfig, dec->mFrames)) {
+        ALOGV("frame %lld fails with %d", (long long)dec->mFrames, dec->mConfig.mErrorCode);
+        return (MMDecRet)dec->mConfig.mErrorCode;
+    }
+
+    return decodePicture(dec, idr, pOutput);
+}
+
+MMDecRet H264Dec_GetLastDspFrm(AVCHandle *avcHandle, void **pOutput,
+                               int32 *picId, uint64 *pts) {
+    MockAvcDecoder *dec = getDecoder(avcHandle);
+    if (dec == NULL) {
+        return MMDEC_ERROR;
+    }
+
+    ssize_t index = nextToDisplay(dec);
+    if (index < 0) {
+        return MMDEC_ERROR;
+    }
+
+    Picture pic = popDisplay(dec, index);
+    *pOutput = pic.mHeader;
+    *picId = pic.mPicId;
+    *pts = pic.mPts;
+    return MMDEC_OK;
+}
+
+void H264Dec_ReleaseRefBuffers(AVCHandle *avcHandle) {
+    MockAvcDecoder *dec = getDecoder(avcHandle);
+    if (dec != NULL) {
+        releaseAll(dec);
+    }
+}
+
+MMDecRet H264Dec_InitStructForNewSeq(AVCHandle *avcHandle) {
+    MockAvcDecoder *dec = getDecoder(avcHandle);
+    if (dec == NULL) {
+        return MMDEC_INVALID_STATUS;
+    }
+    releaseAll(dec);
+    dec->mHaveCur = false;
+    return MMDEC_OK;
+}
+
+MMDecRet H264DecRelease(AVCHandle *avcHandle) {
+    MockAvcDecoder *dec = getDecoder(avcHandle);
+    if (dec == NULL) {
+        return MMDEC_OK;
+    }
+
+    if (!dec->mHeld.empty()) {
+        ALOGW("release with %zu pictures still bound", dec->mHeld.size());
+    }
+    releaseAll(dec);
+
+    ALOGI("released after %lld frames", (long long)dec->mFrames);
+    delete dec;
+    avcHandle->videoDecoderData = NULL;
+    return MMDEC_OK;
+}
+
+int H264Dec_get_iova(AVCHandle *avcHandle, int fd, unsigned long *iova, size_t *size) {
+    MockAvcDecoder *dec = getDecoder(avcHandle);
+    if (dec == NULL) {
+        return -1;
+    }
+    return MockVspGetIova(dec->mConfig, kVspMaster, fd, iova, size);
+}
+
+int H264Dec_free_iova(AVCHandle * /* avcHandle */, unsigned long iova, size_t size) {
+    return MockVspFreeIova(kVspMaster, iova, size);
+}
+
+int H264Dec_get_IOMMU_status(AVCHandle *avcHandle) {
+    MockAvcDecoder *dec = getDecoder(avcHandle);
+    return dec != NULL && dec->mConfig.mIOMMUEnabled ? 0 : -1;
+}
+
+int H264DecNeedToSwitchToSwDecoder(AVCHandle * /* avcHandle */) {
+    return 0;
+}
+
+}  // extern "C"
@@ -0,0 +1,384 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Host stand-in for libomx_avcenc_hw_sprd.so. Headers are a valid baseline
+// SPS/PPS for the configured size; frames are a single slice NAL unit
+// whose size follows the configured bitrate, with I frames at the
+// configured period or on request. The input picture is never read.
+// Frames alternate between the two bitstream buffers given at init, as
+// the hardware does when both are set.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MockAvcEncEngine"
+#include <utils/Log.h>
+
+#include "MockVspEngine.h"
+#include "avc_enc_api.h"
+
+#include <string.h>
+
+using namespace android;
+
+namespace {
+
+const int kVspEncMaster = 1;
+
+struct BitWriter {
+    BitWriter(uint8 *data, size_t size)
+        : mData(data), mSize(size), mPos(0) {
+        memset(data, 0, size);
+    }
+
+    void bit(uint32 b) {
+        if ((mPos >> 3) < mSize && b) {
+            mData[mPos >> 3] |= 0x80 >> (mPos & 7);
+        }
+        mPos++;
+    }
+
+    void bits(uint32 v, int n) {
+        while (n-- > 0) {
+            bit((v >> n) & 1);
+        }
+    }
+
+    void ue(uint32 v) {
+        uint32 code = v + 1;
+        int len = 0;
+        for (uint32 t = code; t > 1; t >>= 1) {
+            len++;
+        }
+        bits(0, len);
+        bits(code, len + 1);
+    }
+
+    void se(int32 v) {
+        ue(v > 0 ? 2 * v - 1 : -2 * v);
+    }
+
+    // rbsp_trailing_bits; returns the size in bytes.
+    size_t finish() {
+        bit(1);
+        while (mPos & 7) {
+            bit(0);
+        }
+        return mPos >> 3;
+    }
+
+private:
+    uint8 *mData;
+    size_t mSize;
+    size_t mPos;
+};
+
+struct MockAvcEncoder {
+    MockVspConfig mConfig;
+    uint32_t mSeed;
+    int64_t mFrames;
+    int64_t mSinceIdr;
+
+    MMCodecBuffer mStream[2];
+    int32 mStreamCount;
+    int32 mNextStream;
+
+    MMEncVideoInfo mVideoInfo;
+    MMEncConfig mConf;
+    bool mInited;
+};
+
+MockAvcEncoder *getEncoder(AVCHandle *avcHandle) {
+    return avcHandle != NULL ? (MockAvcEncoder *)avcHandle->videoEncoderData : NULL;
+}
+
+// The stream buffer for the next output, or NULL before init.
+MMCodecBuffer *nextStream(MockAvcEncoder *enc) {
+    if (enc->mStreamCount == 0) {
+        return NULL;
+    }
+    MMCodecBuffer *stream = &enc->mStream[enc->mNextStream];
+    enc->mNextStream = (enc->mNextStream + 1) % enc->mStreamCount;
+    return stream;
+}
+
+size_t writeStartCode(uint8 *p, uint8 nalHeader) {
+    p[0] = 0;
+    p[1] = 0;
+    p[2] = 0;
+    p[3] = 1;
+    p[4] = nalHeader;
+    return 5;
+}
+
+size_t writeSps(MockAvcEncoder *enc, uint8 *p, size_t size) {
+    size_t n = writeStartCode(p, 0x67);
+
+    uint32 width = enc->mVideoInfo.frame_width;
+    uint32 height = enc->mVideoInfo.frame_height;
+    uint32 widthMbs = (width + 15) / 16;
+    uint32 heightMbs = (height + 15) / 16;
+
+    BitWriter bw(p + n, size - n);
+    bw.bits(AVC_BASELINE, 8);
+    bw.bits(0xc0, 8);         // constraint_set0/1
+    bw.bits(AVC_LEVEL3_1, 8);
+    bw.ue(0);                 // seq_parameter_set_id
+    bw.ue(0);                 // log2_max_frame_num_minus4
+    bw.ue(2);                 // pic_order_cnt_type
+    bw.ue(1);                 // max_num_ref_frames
+    bw.bit(0);                // gaps_in_frame_num_value_allowed_flag
+    bw.ue(widthMbs - 1);
+    bw.ue(heightMbs - 1);
+    bw.bit(1);                // frame_mbs_only_flag
+    bw.bit(1);                // direct_8x8_inference_flag
+    bool crop = widthMbs * 16 != width || heightMbs * 16 != height;
+    bw.bit(crop);
+    if (crop) {
+        bw.ue(0);
+        bw.ue((widthMbs * 16 - width) / 2);
+        bw.ue(0);
+        bw.ue((heightMbs * 16 - height) / 2);
+    }
+    bw.bit(0);                // vui_parameters_present_flag
+    return n + bw.finish();
+}
+
+size_t writePps(uint8 *p, size_t size) {
+    size_t n = writeStartCode(p, 0x68);
+
+    BitWriter bw(p + n, size - n);
+    bw.ue(0);                 // pic_parameter_set_id
+    bw.ue(0);                 // seq_parameter_set_id
+    bw.bit(0);                // entropy_coding_mode_flag
+    bw.bit(0);                // bottom_field_pic_order_in_frame_present_flag
+    bw.ue(0);                 // num_slice_groups_minus1
+    bw.ue(0);                 // num_ref_idx_l0_default_active_minus1
+    bw.ue(0);                 // num_ref_idx_l1_default_active_minus1
+    bw.bit(0);                // weighted_pred_flag
+    bw.bits(0, 2);            // weighted_bipred_idc
+    bw.se(0);                 // pic_init_qp_minus26
+    bw.se(0);                 // pic_init_qs_minus26
+    bw.se(0);                 // chroma_qp_index_offset
+    bw.bit(1);                // deblocking_filter_control_present_flag
+    bw.bit(0);                // constrained_intra_pred_flag
+    bw.bit(0);                // redundant_pic_cnt_present_flag
+    return n + bw.finish();
+}
+
+// Size of the next frame: the bitrate's share per frame, I frames four
+// times that of P frames.
+size_t frameSize(MockAvcEncoder *enc, const MMEncIn *pInput, bool idr) {
+    uint32 bitrate = pInput->ischangebitrate && pInput->bitrate > 0
+            ? pInput->bitrate : enc->mConf.targetBitRate;
+    uint32 frameRate = enc->mConf.FrameRate > 0 ? enc->mConf.FrameRate : 30;
+
+    size_t size;
+    if (bitrate > 0) {
+        size = bitrate / frameRate / 8;
+    } else {
+        size = enc->mVideoInfo.frame_width * enc->mVideoInfo.frame_height / 16;
+    }
+    if (idr) {
+        size *= 4;
+    }
+    return size < 16 ? 16 : size;
+}
+
+}  // namespace
+
+extern "C" {
+
+MMEncRet H264EncGetCodecCapability(AVCHandle *avcHandle, MMEncCapability *Capability) {
+    MockAvcEncoder *enc = getEncoder(avcHandle);
+    if (enc == NULL) {
+        return MMENC_INVALID_STATUS;
+    }
+    Capability->profile = AVC_BASELINE;
+    Capability->level = AVC_LEVEL3_1;
+    Capability->max_width = enc->mConfig.mMaxWidth;
+    Capability->max_height = enc->mConfig.mMaxHeight;
+    return MMENC_OK;
+}
+
+MMEncRet H264EncPreInit(AVCHandle *avcHandle, MMCodecBuffer * /* pInterMemBfr */) {
+    if (avcHandle == NULL) {
+        return MMENC_PARAM_ERROR;
+    }
+
+    MockAvcEncoder *enc = new MockAvcEncoder;
+    memset(enc, 0, sizeof(*enc));
+    MockVspLoadConfig(&enc->mConfig, MMENC_HW_ERROR);
+    enc->mSeed = 1;
+    enc->mConf.FrameRate = 30;
+
+    avcHandle->videoEncoderData = enc;
+    return MMENC_OK;
+}
+
+MMEncRet H264EncInit(AVCHandle *avcHandle, MMCodecBuffer * /* pExtaMemBfr */,
+                     MMCodecBuffer *pBitstreamBfr, MMCodecBuffer *pBitstreamBfrPn,
+                     MMEncVideoInfo *pVideoFormat) {
+    MockAvcEncoder *enc = getEncoder(avcHandle);
+    if (enc == NULL) {
+        return MMENC_INVALID_STATUS;
+    }
+    if (pBitstreamBfr == NULL || pBitstreamBfr->common_buffer_ptr == NULL
+            || pVideoFormat == NULL) {
+        return MMENC_PARAM_ERROR;
+    }
+
+    enc->mStream[0] = *pBitstreamBfr;
+    enc->mStreamCount = 1;
+    if (pBitstreamBfrPn != NULL && pBitstreamBfrPn->common_buffer_ptr != NULL
+            && pBitstreamBfrPn->size > 0) {
+        enc->mStream[1] = *pBitstreamBfrPn;
+        enc->mStreamCount = 2;
+    }
+    enc->mNextStream = 0;
+    enc->mVideoInfo = *pVideoFormat;
+    enc->mFrames = 0;
+    enc->mSinceIdr = 0;
+    enc->mInited = true;
+
+    ALOGI("init %dx%d, %d stream buffers",
+            pVideoFormat->frame_width, pVideoFormat->frame_height, enc->mStreamCount);
+    return MMENC_OK;
+}
+
+MMEncRet H264EncSetConf(AVCHandle *avcHandle, MMEncConfig *pConf) {
+    MockAvcEncoder *enc = getEncoder(avcHandle);
+    if (enc == NULL) {
+        return MMENC_INVALID_STATUS;
+    }
+    enc->mConf = *pConf;
+    return MMENC_OK;
+}
+
+MMEncRet H264EncGetConf(AVCHandle *avcHandle, MMEncConfig *pConf) {
+    MockAvcEncoder *enc = getEncoder(avcHandle);
+    if (enc == NULL) {
+        return MMENC_INVALID_STATUS;
+    }
+    *pConf = enc->mConf;
+    return MMENC_OK;
+}
+
+MMEncRet H264EncGenHeader(AVCHandle *avcHandle, MMEncOut *pOutput, int is_sps) {
+    MockAvcEncoder *enc = getEncoder(avcHandle);
+    if (enc == NULL || !enc->mInited) {
+        return MMENC_INVALID_STATUS;
+    }
+
+    MMCodecBuffer *stream = nextStream(enc);
+    if (stream->size < 64) {
+        return MMENC_OUTPUT_BUFFER_OVERFLOW;
+    }
+
+    if (avcHandle->VSP_FlushBSCache != NULL) {
+        (*avcHandle->VSP_FlushBSCache)(avcHandle->userData);
+    }
+
+    pOutput->pOutBuf = stream->common_buffer_ptr;
+    pOutput->pheaderBuf = stream->common_buffer_ptr;
+    pOutput->strmSize = is_sps
+            ? writeSps(enc, stream->common_buffer_ptr, stream->size)
+            : writePps(stream->common_buffer_ptr, stream->size);
+    pOutput->vopType = 0;
+    return MMENC_OK;
+}
+
+MMEncRet H264EncStrmEncode(AVCHandle *avcHandle, MMEncIn *pInput, MMEncOut *pOutput) {
+    MockAvcEncoder *enc = getEncoder(avcHandle);
+    if (enc == NULL || !enc->mInited) {
+        return MMENC_INVALID_STATUS;
+    }
+
+    pOutput->strmSize = 0;
+    pOutput->pOutBuf = NULL;
+
+    if (pInput->p_src_y == NULL && pInput->p_src_y_phy == NULL) {
+        return MMENC_PARAM_ERROR;
+    }
+
+    // PFrames is the number of P frames between two I frames.
+    bool idr = enc->mFrames == 0 || pInput->needIVOP
+            || (enc->mConf.PFrames != 0xffffffff && enc->mSinceIdr > (int64_t)enc->mConf.PFrames);
+
+    enc->mFrames++;
+    MockVspSpendFrameTime(enc->mConfig, &enc->mSeed);
+    if (MockVspInjectError(enc->mConfig, enc->mFrames)) {
+        ALOGV("frame %lld fails with %d", (long long)enc->mFrames, enc->mConfig.mErrorCode);
+        return (MMEncRet)enc->mConfig.mErrorCode;
+    }
+
+    MMCodecBuffer *stream = nextStream(enc);
+    size_t size = frameSize(enc, pInput, idr);
+    if (size + 5 > stream->size) {
+        ALOGW("frame of %zu bytes overflows the %u byte stream buffer", size, stream->size);
+        size = stream->size - 5;
+    }
+
+    if (avcHandle->VSP_FlushBSCache != NULL) {
+        (*avcHandle->VSP_FlushBSCache)(avcHandle->userData);
+    }
+
+    // Filler without zero bytes, so no start code emulation.
+    uint8 *p = stream->common_buffer_ptr;
+    size_t n = writeStartCode(p, idr ? 0x65 : 0x41);
+    memset(p + n, 0xaa, size);
+
+    enc->mSinceIdr = idr ? 1 : enc->mSinceIdr + 1;
+
+    pOutput->pOutBuf = p;
+    pOutput->pheaderBuf = NULL;
+    pOutput->strmSize = n + size;
+    pOutput->vopType = idr ? 0 : 1;
+    return MMENC_OK;
+}
+
+MMEncRet H264EncRelease(AVCHandle *avcHandle) {
+    MockAvcEncoder *enc = getEncoder(avcHandle);
+    if (enc == NULL) {
+        return MMENC_OK;
+    }
+
+    ALOGI("released after %lld frames", (long long)enc->mFrames);
+    delete enc;
+    avcHandle->videoEncoderData = NULL;
+    return MMENC_OK;
+}
+
+int H264Enc_get_iova(AVCHandle *avcHandle, int fd, unsigned long *iova, size_t *size) {
+    MockAvcEncoder *enc = getEncoder(avcHandle);
+    if (enc == NULL) {
+        return -1;
+    }
+    return MockVspGetIova(enc->mConfig, kVspEncMaster, fd, iova, size);
+}
+
+int H264Enc_free_iova(AVCHandle * /* avcHandle */, unsigned long iova, size_t size) {
+    return MockVspFreeIova(kVspEncMaster, iova, size);
+}
+
+int H264Enc_get_IOMMU_status(AVCHandle *avcHandle) {
+    MockAvcEncoder *enc = getEncoder(avcHandle);
+    return enc != NULL && enc->mConfig.mIOMMUEnabled ? 0 : -1;
+}
+
+int H264Enc_NeedAlign(AVCHandle * /* avcHandle */) {
+    return 0;
+}
+
+}  // extern "C"
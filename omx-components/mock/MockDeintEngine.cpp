@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Host stand-in for the VSP deinterlacer core that SPRDDeinterlace links
+// statically (core/vsp/vsp_deint_api.c). Frames are not touched: each
+// process call validates its parameters and spends the configured
+// MockVspEngine.h latency, so the deinterlace thread of SPRDAVCDecoder
+// runs its real buffer handoff on a host.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MockDeintEngine"
+#include <utils/Log.h>
+
+#include "MockVspEngine.h"
+#include "vpp_drv_interface.h"
+
+using namespace android;
+
+namespace {
+
+// The deinterlacer is a path of the VSP, so it maps through the same
+// IOMMU master as the decoders.
+const int kVspMaster = 0;
+
+struct MockDeinter {
+    MockVspConfig mConfig;
+    uint32_t mSeed;
+    int64_t mFrames;
+};
+
+// The device core keeps the register mapping in s_vsp_Vaddr_base; the
+// mock keeps its state there.
+MockDeinter *getDeinter(VPPObject *vo) {
+    return vo != NULL ? (MockDeinter *)vo->s_vsp_Vaddr_base : NULL;
+}
+
+}  // namespace
+
+int32 vpp_deint_init(VPPObject *vo) {
+    if (vo == NULL) {
+        return -1;
+    }
+
+    MockDeinter *deint = new MockDeinter;
+    MockVspLoadConfig(&deint->mConfig, -1);
+    deint->mSeed = 1;
+    deint->mFrames = 0;
+
+    memset(vo, 0, sizeof(VPPObject));
+    vo->s_vsp_Vaddr_base = (uint_32or64)deint;
+    vo->s_vsp_fd = -1;
+    return 0;
+}
+
+int32 vpp_deint_release(VPPObject *vo) {
+    MockDeinter *deint = getDeinter(vo);
+    if (deint != NULL) {
+        ALOGI("released after %lld frames", (long long)deint->mFrames);
+        delete deint;
+        vo->s_vsp_Vaddr_base = 0;
+    }
+    return 0;
+}
+
+int32 vpp_deint_process(VPPObject *vo, unsigned long src_frame,
+                        unsigned long ref_frame, unsigned long dst_frame,
+                        uint32 frame_no, DEINT_PARAMS_T *params) {
+    MockDeinter *deint = getDeinter(vo);
+    if (deint == NULL || params == NULL) {
+        return -1;
+    }
+
+    ALOGV("process: src 0x%lx, ref 0x%lx, dst 0x%lx, frame %u, %ux%u",
+            src_frame, ref_frame, dst_frame, frame_no, params->width, params->height);
+    if (src_frame == 0 || dst_frame == 0 || (frame_no > 0 && ref_frame == 0)
+            || params->width == 0 || params->height == 0) {
+        ALOGE("bad parameters for frame %u", frame_no);
+        return -1;
+    }
+
+    deint->mFrames++;
+    MockVspSpendFrameTime(deint->mConfig, &deint->mSeed);
+    if (MockVspInjectError(deint->mConfig, deint->mFrames)) {
+        ALOGV("frame %u fails", frame_no);
+        return -1;
+    }
+    return 0;
+}
+
+int vpp_deint_get_iova(VPPObject *vo, int fd, unsigned long *iova, size_t *size) {
+    MockDeinter *deint = getDeinter(vo);
+    if (deint == NULL) {
+        return -1;
+    }
+    return MockVspGetIova(deint->mConfig, kVspMaster, fd, iova, size);
+}
+
+int vpp_deint_free_iova(VPPObject * /* vo */, unsigned long iova, size_t size) {
+    return MockVspFreeIova(kVspMaster, iova, size);
+}
+
+int vpp_deint_get_IOMMU_status(VPPObject *vo) {
+    MockDeinter *deint = getDeinter(vo);
+    return deint != NULL && deint->mConfig.mIOMMUEnabled ? 0 : -1;
+}
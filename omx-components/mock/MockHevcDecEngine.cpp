@@ -0,0 +1,463 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Host stand-in for libomx_hevcdec_hw_sprd.so, built the same way as
+// MockAvcDecEngine.cpp: parameter sets are parsed with libsprd_bitstream
+// for the picture size and DPB depth, the extra and CTU info callbacks run
+// on a new sequence, and output buffers are bound and unbound as the
+// hardware does. No picture is actually decoded.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MockHevcDecEngine"
+#include <utils/Log.h>
+#include <utils/Vector.h>
+
+#include "MockVspEngine.h"
+#include "SprdBitstream.h"
+#include "hevc_dec_api.h"
+
+#include <string.h>
+
+using namespace android;
+
+namespace {
+
+const int kVspMaster = 0;
+
+struct Picture {
+    void *mHeader;
+    uint8 *mY;
+    unsigned long mPhy;
+    int32 mPicId;
+    int32 mPts;
+    bool mIsRef;
+    bool mPending;   // decoded, not yet handed out for display
+};
+
+struct MockHevcDecoder {
+    HEVCHandle *mHandle;
+    MockVspConfig mConfig;
+    uint32_t mSeed;
+    int64_t mFrames;
+
+    bool mSawVPS;
+    bool mSawSPS;
+    bool mSawPPS;
+    bool mHaveInfo;
+    H265SwDecInfo mInfo;
+    uint32 mMaxRefs;
+
+    bool mNewSeq;
+    bool mMemInited;
+    bool mSizeConfirmed;
+
+    bool mHaveCur;
+    Picture mCur;
+
+    // Every picture the engine holds a bind on, in decode order.
+    Vector<Picture> mHeld;
+};
+
+MockHevcDecoder *getDecoder(HEVCHandle *hevcHandle) {
+    return hevcHandle != NULL ? (MockHevcDecoder *)hevcHandle->videoDecoderData : NULL;
+}
+
+bool parseSps(const uint8 *nal, size_t size, H265SwDecInfo *info, uint32 *maxRefs) {
+    SprdHevcSps sps;
+    if (!SprdParseHevcSps(nal, size, &sps) || sps.mCodedWidth > 8192
+            || sps.mCodedHeight > 8192) {
+        return false;
+    }
+
+    memset(info, 0, sizeof(*info));
+    info->profile = sps.mPtl.mProfileIdc;
+    info->picWidth = sps.mCodedWidth;
+    info->picHeight = sps.mCodedHeight;
+    info->videoRange = sps.mSignal.mFullRange;
+    info->colorPrimaries = sps.mSignal.mPrimaries;
+    info->transfer = sps.mSignal.mTransfer;
+    info->matrixCoefficients = sps.mSignal.mMatrixCoeffs;
+    info->parWidth = sps.mSarWidth != 0 ? sps.mSarWidth : 1;
+    info->parHeight = sps.mSarHeight != 0 ? sps.mSarHeight : 1;
+    info->croppingFlag = sps.mCropLeft || sps.mCropRight || sps.mCropTop || sps.mCropBottom;
+    info->cropParams.cropLeftOffset = sps.mCropLeft;
+    info->cropParams.cropOutWidth = sps.mCodedWidth - sps.mCropLeft - sps.mCropRight;
+    info->cropParams.cropTopOffset = sps.mCropTop;
+    info->cropParams.cropOutHeight = sps.mCodedHeight - sps.mCropTop - sps.mCropBottom;
+    info->numFrames = sps.mMaxDecPicBuffering;
+
+    *maxRefs = sps.mMaxDecPicBuffering > 1 ? sps.mMaxDecPicBuffering - 1 : 1;
+    return true;
+}
+
+void unbindIfDone(MockHevcDecoder *dec, size_t index) {
+    const Picture &pic = dec->mHeld.itemAt(index);
+    if (pic.mIsRef || pic.mPending) {
+        return;
+    }
+    if (dec->mHandle->VSP_unbindCb != NULL) {
+        unsigned long phy = pic.mPhy;
+        (*dec->mHandle->VSP_unbindCb)(dec->mHandle->userdata, pic.mHeader, &phy);
+    }
+    dec->mHeld.removeAt(index);
+}
+
+void releaseAll(MockHevcDecoder *dec) {
+    while (!dec->mHeld.empty()) {
+        Picture &pic = dec->mHeld.editItemAt(0);
+        pic.mIsRef = false;
+        pic.mPending = false;
+        unbindIfDone(dec, 0);
+    }
+}
+
+// The pending picture with the lowest timestamp, or -1.
+ssize_t nextToDisplay(MockHevcDecoder *dec) {
+    ssize_t best = -1;
+    for (size_t i = 0; i < dec->mHeld.size(); ++i) {
+        const Picture &pic = dec->mHeld.itemAt(i);
+        if (pic.mPending && (best < 0 || pic.mPts < dec->mHeld.itemAt(best).mPts)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+size_t pendingCount(MockHevcDecoder *dec) {
+    size_t count = 0;
+    for (size_t i = 0; i < dec->mHeld.size(); ++i) {
+        count += dec->mHeld.itemAt(i).mPending ? 1 : 0;
+    }
+    return count;
+}
+
+Picture popDisplay(MockHevcDecoder *dec, ssize_t index) {
+    Picture pic = dec->mHeld.itemAt(index);
+    dec->mHeld.editItemAt(index).mPending = false;
+    unbindIfDone(dec, index);
+    return pic;
+}
+
+void fillPicture(MockHevcDecoder *dec, const Picture &pic) {
+    size_t lumaSize = dec->mInfo.picWidth * dec->mInfo.picHeight;
+    memset(pic.mY, 16 + (dec->mFrames & 0x7f), lumaSize);
+    memset(pic.mY + lumaSize, 128, lumaSize / 2);
+}
+
+MMDecRet decodePicture(MockHevcDecoder *dec, bool idr, MMDecOutput *pOutput) {
+    if (idr) {
+        for (size_t i = dec->mHeld.size(); i-- > 0;) {
+            dec->mHeld.editItemAt(i).mIsRef = false;
+            unbindIfDone(dec, i);
+        }
+    }
+
+    Picture pic = dec->mCur;
+    pic.mIsRef = true;
+    pic.mPending = true;
+    dec->mHaveCur = false;
+
+    if (dec->mConfig.mFill && dec->mSizeConfirmed && pic.mY != NULL) {
+        fillPicture(dec, pic);
+    }
+    dec->mSizeConfirmed = true;
+
+    // The component reports the address the hardware would write to.
+    pic.mPhy = 0;
+    if (dec->mHandle->VSP_bindCb != NULL) {
+        (*dec->mHandle->VSP_bindCb)(dec->mHandle->userdata, pic.mHeader, &pic.mPhy);
+    }
+    dec->mHeld.push_back(pic);
+
+    // The oldest reference pictures drop out of the RPS.
+    uint32 refs = 0;
+    for (size_t i = dec->mHeld.size(); i-- > 0;) {
+        Picture &held = dec->mHeld.editItemAt(i);
+        if (held.mIsRef && ++refs > dec->mMaxRefs) {
+            held.mIsRef = false;
+            unbindIfDone(dec, i);
+        }
+    }
+
+    if (pendingCount(dec) > (size_t)dec->mConfig.mReorder) {
+        Picture out = popDisplay(dec, nextToDisplay(dec));
+        pOutput->pOutFrameY = out.mY;
+        pOutput->pOutFrameU = out.mY != NULL
+                ? out.mY + dec->mInfo.picWidth * dec->mInfo.picHeight : NULL;
+        pOutput->pOutFrameV = NULL;
+        pOutput->frame_width = dec->mInfo.picWidth;
+        pOutput->frame_height = dec->mInfo.picHeight;
+        pOutput->pts = out.mPts;
+        pOutput->pBufferHeader = out.mHeader;
+        pOutput->mPicId = out.mPicId;
+        pOutput->frameEffective = 1;
+    }
+
+    return MMDEC_OK;
+}
+
+}  // namespace
+
+extern "C" {
+
+MMDecRet H265DecInit(HEVCHandle *hevcHandle, MMCodecBuffer * /* pBuffer */,
+                     MMDecVideoFormat * /* pVideoFormat */) {
+    if (hevcHandle == NULL) {
+        return MMDEC_PARAM_ERROR;
+    }
+
+    MockHevcDecoder *dec = new MockHevcDecoder;
+    dec->mHandle = hevcHandle;
+    MockVspLoadConfig(&dec->mConfig, MMDEC_STREAM_ERROR);
+    dec->mSeed = 1;
+    dec->mFrames = 0;
+    dec->mSawVPS = false;
+    dec->mSawSPS = false;
+    dec->mSawPPS = false;
+    dec->mHaveInfo = false;
+    memset(&dec->mInfo, 0, sizeof(dec->mInfo));
+    dec->mMaxRefs = 1;
+    dec->mNewSeq = false;
+    dec->mMemInited = false;
+    dec->mSizeConfirmed = false;
+    dec->mHaveCur = false;
+
+    hevcHandle->videoDecoderData = dec;
+    return MMDEC_OK;
+}
+
+MMDecRet H265DecMemInit(HEVCHandle *hevcHandle, MMCodecBuffer *pBuffer) {
+    MockHevcDecoder *dec = getDecoder(hevcHandle);
+    if (dec == NULL || pBuffer == NULL) {
+        return MMDEC_PARAM_ERROR;
+    }
+    dec->mMemInited = true;
+    return MMDEC_OK;
+}
+
+MMDecRet H265DecSetParameter(HEVCHandle *hevcHandle, MMDecVideoFormat * /* pVideoFormat */) {
+    return getDecoder(hevcHandle) != NULL ? MMDEC_OK : MMDEC_INVALID_STATUS;
+}
+
+MMDecRet H265GetCodecCapability(HEVCHandle *hevcHandle, MMDecCapability *Capability) {
+    MockHevcDecoder *dec = getDecoder(hevcHandle);
+    if (dec == NULL) {
+        return MMDEC_INVALID_STATUS;
+    }
+    Capability->profile = AVC_MAIN;
+    Capability->level = AVC_LEVEL5_1;
+    Capability->max_width = dec->mConfig.mMaxWidth;
+    Capability->max_height = dec->mConfig.mMaxHeight;
+    return MMDEC_OK;
+}
+
+MMDecRet H265DecGetNALType(HEVCHandle * /* hevcHandle */, uint8 *bitstream, int size,
+                           int *nal_type, int *nal_ref_idc) {
+    size_t nalSize;
+    int32_t offset = MockVspNextNal(bitstream, size, 0, &nalSize);
+    if (offset < 0 || nalSize < 2) {
+        return MMDEC_ERROR;
+    }
+    *nal_type = SprdHevcNalType(bitstream + offset);
+    *nal_ref_idc = 0;
+    return MMDEC_OK;
+}
+
+MMDecRet H265DecGetInfo(HEVCHandle *hevcHandle, H265SwDecInfo *pDecInfo) {
+    MockHevcDecoder *dec = getDecoder(hevcHandle);
+    if (dec == NULL || !dec->mHaveInfo) {
+        return MMDEC_ERROR;
+    }
+    *pDecInfo = dec->mInfo;
+    return MMDEC_OK;
+}
+
+void H265Dec_SetCurRecPic(HEVCHandle *hevcHandle, uint8 *pFrameY, void *pBufferHeader,
+                          int32 picId) {
+    MockHevcDecoder *dec = getDecoder(hevcHandle);
+    if (dec == NULL) {
+        return;
+    }
+    dec->mCur.mHeader = pBufferHeader;
+    dec->mCur.mY = pFrameY;
+    dec->mCur.mPicId = picId;
+    dec->mCur.mPts = 0;
+    dec->mHaveCur = true;
+}
+
+MMDecRet H265DecDecode(HEVCHandle *hevcHandle, MMDecInput *pInput, MMDecOutput *pOutput) {
+    MockHevcDecoder *dec = getDecoder(hevcHandle);
+    if (dec == NULL) {
+        return MMDEC_INVALID_STATUS;
+    }
+
+    pOutput->frameEffective = 0;
+    pOutput->reqNewBuf = 0;
+    pOutput->err_MB_num = 0;
+
+    if (pInput->pStream == NULL) {
+        // Secure input cannot be parsed on the host.
+        return MMDEC_NOT_SUPPORTED;
+    }
+
+    bool sawSlice = false;
+    bool idr = false;
+    size_t offset = 0;
+    size_t nalSize;
+    int32_t start;
+    while ((start = MockVspNextNal(pInput->pStream, pInput->dataLen, offset, &nalSize)) >= 0) {
+        const uint8 *nal = pInput->pStream + start;
+        offset = start + nalSize;
+        if (nalSize < 2) {
+            continue;
+        }
+
+        int type = SprdHevcNalType(nal);
+        if (type <= 9 || (type >= 16 && type <= 21)) {
+            sawSlice = true;
+            idr = idr || type == 19 || type == 20;
+        } else if (type == kHevcNalVps) {
+            dec->mSawVPS = true;
+        } else if (type == kHevcNalSps) {
+            H265SwDecInfo info;
+            uint32 maxRefs;
+            if (!parseSps(nal, nalSize, &info, &maxRefs)) {
+                ALOGW("unparsable SPS");
+                return MMDEC_STREAM_ERROR;
+            }
+            if (!dec->mHaveInfo || info.picWidth != dec->mInfo.picWidth
+                    || info.picHeight != dec->mInfo.picHeight
+                    || info.numFrames != dec->mInfo.numFrames) {
+                ALOGI("new sequence %ux%u, %u frames in the DPB",
+                        info.picWidth, info.picHeight, info.numFrames);
+                dec->mNewSeq = true;
+                dec->mSizeConfirmed = false;
+            }
+            dec->mInfo = info;
+            dec->mMaxRefs = maxRefs;
+            dec->mHaveInfo = true;
+            dec->mSawSPS = true;
+        } else if (type == kHevcNalPps) {
+            dec->mSawPPS = true;
+        }
+    }
+
+    if (!sawSlice) {
+        return MMDEC_OK;
+    }
+    if (!dec->mSawVPS || !dec->mSawSPS || !dec->mSawPPS) {
+        return MMDEC_STREAM_ERROR;
+    }
+    if (pInput->expected_IVOP && !idr) {
+        return MMDEC_FRAME_SEEK_IVOP;
+    }
+
+    if (dec->mNewSeq || !dec->mMemInited) {
+        dec->mNewSeq = false;
+        dec->mMemInited = false;
+
+        // 64x64 CTUs.
+        uint32 ctus = ((dec->mInfo.picWidth + 63) / 64) * ((dec->mInfo.picHeight + 63) / 64);
+        if (hevcHandle->VSP_extMemCb == NULL
+                || (*hevcHandle->VSP_extMemCb)(hevcHandle->userdata, ctus * 6144 + 0x10000) != 0
+                || !dec->mMemInited) {
+            return MMDEC_MEMORY_ERROR;
+        }
+
+        for (uint32 i = 0; i <= dec->mMaxRefs && hevcHandle->VSP_ctuinfoMemCb != NULL; ++i) {
+            unsigned long phy;
+            if ((*hevcHandle->VSP_ctuinfoMemCb)(hevcHandle->userdata, ctus * 64, &phy) != 0) {
+                return MMDEC_MEMORY_ERROR;
+            }
+        }
+    }
+
+    if (!dec->mHaveCur) {
+        ALOGE("no reconstruction picture set");
+        return MMDEC_ERROR;
+    }
+    dec->mCur.mPts = pInput->pts;
+
+    dec->mFrames++;
+    MockVspSpendFrameTime(dec->mConfig, &dec->mSeed);
+    if (MockVspInjectError(dec->mConfig, dec->mFrames)) {
+        ALOGV("frame %lld fails with %d", (long long)dec->mFrames, dec->mConfig.mErrorCode);
+        return (MMDecRet)dec->mConfig.mErrorCode;
+    }
+
+    return decodePicture(dec, idr, pOutput);
+}
+
+MMDecRet H265Dec_GetLastDspFrm(HEVCHandle *hevcHandle, void **pOutput, int32 *picId) {
+    MockHevcDecoder *dec = getDecoder(hevcHandle);
+    if (dec == NULL) {
+        return MMDEC_ERROR;
+    }
+
+    ssize_t index = nextToDisplay(dec);
+    if (index < 0) {
+        return MMDEC_ERROR;
+    }
+
+    Picture pic = popDisplay(dec, index);
+    *pOutput = pic.mHeader;
+    *picId = pic.mPicId;
+    return MMDEC_OK;
+}
+
+void H265Dec_ReleaseRefBuffers(HEVCHandle *hevcHandle) {
+    MockHevcDecoder *dec = getDecoder(hevcHandle);
+    if (dec != NULL) {
+        releaseAll(dec);
+    }
+}
+
+MMDecRet H265DecRelease(HEVCHandle *hevcHandle) {
+    MockHevcDecoder *dec = getDecoder(hevcHandle);
+    if (dec == NULL) {
+        return MMDEC_OK;
+    }
+
+    if (!dec->mHeld.empty()) {
+        ALOGW("release with %zu pictures still bound", dec->mHeld.size());
+    }
+    releaseAll(dec);
+
+    ALOGI("released after %lld frames", (long long)dec->mFrames);
+    delete dec;
+    hevcHandle->videoDecoderData = NULL;
+    return MMDEC_OK;
+}
+
+int H265Dec_get_iova(HEVCHandle *hevcHandle, int fd, unsigned long *iova, size_t *size) {
+    MockHevcDecoder *dec = getDecoder(hevcHandle);
+    if (dec == NULL) {
+        return -1;
+    }
+    return MockVspGetIova(dec->mConfig, kVspMaster, fd, iova, size);
+}
+
+int H265Dec_free_iova(HEVCHandle * /* hevcHandle */, unsigned long iova, size_t size) {
+    return MockVspFreeIova(kVspMaster, iova, size);
+}
+
+int H265Dec_get_IOMMU_status(HEVCHandle *hevcHandle) {
+    MockHevcDecoder *dec = getDecoder(hevcHandle);
+    return dec != NULL && dec->mConfig.mIOMMUEnabled ? 0 : -1;
+}
+
+}  // extern "C"
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MockVspEngine"
+#include <utils/Log.h>
+
+#include "MockVspEngine.h"
+#include "MemIon.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+namespace android {
+
+static int64_t envInt(const char *name, int64_t defaultValue) {
+    const char *value = getenv(name);
+    if (value == NULL || *value == '\0') {
+        return defaultValue;
+    }
+    return strtoll(value, NULL, 0);
+}
+
+void MockVspLoadConfig(MockVspConfig *config, int32_t defaultErrorCode) {
+    config->mLatencyUs = envInt("VSPMOCK_LATENCY_US", 0);
+    config->mJitterUs = envInt("VSPMOCK_JITTER_US", 0);
+    config->mErrorEvery = envInt("VSPMOCK_ERROR_EVERY", 0);
+    config->mErrorCode = envInt("VSPMOCK_ERROR", defaultErrorCode);
+    config->mIOMMUEnabled = envInt("VSPMOCK_IOMMU", 1) != 0;
+    config->mReorder = envInt("VSPMOCK_REORDER", 0);
+    config->mMaxWidth = envInt("VSPMOCK_MAX_WIDTH", 1920);
+    config->mMaxHeight = envInt("VSPMOCK_MAX_HEIGHT", 1088);
+    config->mFill = envInt("VSPMOCK_FILL", 0) != 0;
+
+    if (config->mReorder < 0) {
+        config->mReorder = 0;
+    }
+
+    ALOGI("latency %lld+%lld us, error every %d (%d), iommu %d, reorder %d, max %dx%d, fill %d",
+            (long long)config->mLatencyUs, (long long)config->mJitterUs,
+            config->mErrorEvery, config->mErrorCode, config->mIOMMUEnabled,
+            config->mReorder, config->mMaxWidth, config->mMaxHeight, config->mFill);
+}
+
+void MockVspSpendFrameTime(const MockVspConfig &config, uint32_t *seed) {
+    int64_t us = config.mLatencyUs;
+    if (config.mJitterUs > 0) {
+        *seed = *seed * 1103515245u + 12345u;
+        us += (*seed >> 8) % (uint32_t)(config.mJitterUs + 1);
+    }
+    if (us > 0) {
+        usleep(us);
+    }
+}
+
+bool MockVspInjectError(const MockVspConfig &config, int64_t frameIndex) {
+    return config.mErrorEvery > 0 && frameIndex % config.mErrorEvery == 0;
+}
+
+int MockVspGetIova(const MockVspConfig &config, int master, int fd,
+        unsigned long *iova, size_t *size) {
+    if (!config.mIOMMUEnabled) {
+        return -1;
+    }
+    return MemIon::Get_iova(master, fd, iova, size);
+}
+
+int MockVspFreeIova(int master, unsigned long iova, size_t size) {
+    return MemIon::Free_iova(master, iova, size);
+}
+
+int32_t MockVspNextNal(const uint8_t *data, size_t size, size_t offset, size_t *nalSize) {
+    size_t i = offset;
+    while (i + 3 <= size && !(data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1)) {
+        ++i;
+    }
+    if (i + 3 > size) {
+        return -1;
+    }
+
+    size_t start = i + 3;
+    size_t end = start;
+    while (end + 3 <= size && !(data[end] == 0 && data[end + 1] == 0
+            && (data[end + 2] == 1 || (data[end + 2] == 0 && end + 3 < size
+                    && data[end + 3] == 1)))) {
+        ++end;
+    }
+    if (end + 3 > size) {
+        end = size;
+    }
+
+    *nalSize = end - start;
+    return (int32_t)start;
+}
+
+}  // namespace android
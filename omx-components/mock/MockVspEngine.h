@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MOCK_VSP_ENGINE_H_
+
+#define MOCK_VSP_ENGINE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// Behaviour shared by the host mock engines, read from the environment
+// when an engine instance is created:
+//
+//   VSPMOCK_LATENCY_US  time one frame takes on the "hardware" (default 0)
+//   VSPMOCK_JITTER_US   random extra time per frame, up to this (default 0)
+//   VSPMOCK_ERROR_EVERY every Nth frame fails (default 0, never)
+//   VSPMOCK_ERROR       return code of a failed frame (default: the
+//                       engine's stream or hardware error)
+//   VSPMOCK_IOMMU       0 reports the IOMMU as off, so components fall back
+//                       to physical addresses (default 1)
+//   VSPMOCK_REORDER     decoders: frames held back for display order
+//                       (default 0)
+//   VSPMOCK_MAX_WIDTH, VSPMOCK_MAX_HEIGHT  reported capability
+//                       (default 1920x1088)
+//   VSPMOCK_FILL        1 writes a pattern into decoded pictures, which
+//                       costs a real frame write per frame (default 0)
+struct MockVspConfig {
+    int64_t mLatencyUs;
+    int64_t mJitterUs;
+    int32_t mErrorEvery;
+    int32_t mErrorCode;
+    bool mIOMMUEnabled;
+    int32_t mReorder;
+    int32_t mMaxWidth;
+    int32_t mMaxHeight;
+    bool mFill;
+};
+
+void MockVspLoadConfig(MockVspConfig *config, int32_t defaultErrorCode);
+
+// Blocks for the configured per-frame latency.
+void MockVspSpendFrameTime(const MockVspConfig &config, uint32_t *seed);
+
+// Whether the frameIndex-th frame (counting from 1) is to fail.
+bool MockVspInjectError(const MockVspConfig &config, int64_t frameIndex);
+
+// IOVA mapping through the fake MemIon allocator; master identifies the
+// engine as the IOMMU master id does on the device.
+int MockVspGetIova(const MockVspConfig &config, int master, int fd,
+        unsigned long *iova, size_t *size);
+int MockVspFreeIova(int master, unsigned long iova, size_t size);
+
+// Start code scanning over an Annex B stream: returns the offset of the
+// next NAL unit payload at or after offset and its size, or -1.
+int32_t MockVspNextNal(const uint8_t *data, size_t size, size_t offset, size_t *nalSize);
+
+}  // namespace android
+
+#endif  // MOCK_VSP_ENGINE_H_
@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MockMemIon"
+#include <utils/Log.h>
+
+#include "MemIon.h"
+
+#include <utils/Mutex.h>
+#include <utils/Vector.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace android {
+
+namespace {
+
+const unsigned long kPhyBase = 0x80000000UL;
+const unsigned long kIovaBase = 0x10000000UL;
+const unsigned long kPageMask = 4095;
+
+// One buffer as seen by the fake allocator, whatever fd refers to it.
+struct BufferEntry {
+    dev_t mDev;
+    ino_t mIno;
+    size_t mSize;
+    unsigned long mPhy;
+};
+
+// One mapping of a buffer into the address space of an IOMMU master.
+struct IovaEntry {
+    int mMaster;
+    dev_t mDev;
+    ino_t mIno;
+    size_t mSize;
+    unsigned long mIova;
+    int mRefs;
+};
+
+struct FakeAllocator {
+    FakeAllocator()
+        : mNextPhy(kPhyBase),
+          mNextIova(kIovaBase),
+          mLiveBuffers(0) {
+    }
+
+    ~FakeAllocator() {
+        for (size_t i = 0; i < mIovas.size(); ++i) {
+            const IovaEntry &entry = mIovas.itemAt(i);
+            ALOGW("leaked iova 0x%lx (%zu bytes, %d refs) of master %d",
+                    entry.mIova, entry.mSize, entry.mRefs, entry.mMaster);
+        }
+        if (mLiveBuffers > 0) {
+            ALOGW("%zu buffers still allocated", mLiveBuffers);
+        }
+    }
+
+    Mutex mLock;
+    unsigned long mNextPhy;
+    unsigned long mNextIova;
+    size_t mLiveBuffers;
+    Vector<BufferEntry> mBuffers;
+    Vector<IovaEntry> mIovas;
+
+    static unsigned long pageAlign(size_t size) {
+        return ((unsigned long)size + kPageMask) & ~kPageMask;
+    }
+
+    int stat(int fd, struct stat *st) {
+        if (fd < 0 || fstat(fd, st) != 0) {
+            ALOGE("fstat of fd %d failed: %s", fd, strerror(errno));
+            return -1;
+        }
+        return 0;
+    }
+
+    // The fake physical address of a buffer; a recycled inode of another
+    // size gets a fresh address.
+    int phyAddr(int fd, unsigned long *phy, size_t *size) {
+        struct stat st;
+        if (stat(fd, &st) != 0) {
+            return -1;
+        }
+
+        Mutex::Autolock autoLock(mLock);
+        for (size_t i = 0; i < mBuffers.size(); ++i) {
+            BufferEntry &entry = mBuffers.editItemAt(i);
+            if (entry.mDev == st.st_dev && entry.mIno == st.st_ino) {
+                if (entry.mSize != (size_t)st.st_size) {
+                    entry.mSize = st.st_size;
+                    entry.mPhy = mNextPhy;
+                    mNextPhy += pageAlign(entry.mSize);
+                }
+                *phy = entry.mPhy;
+                *size = entry.mSize;
+                return 0;
+            }
+        }
+
+        BufferEntry entry;
+        entry.mDev = st.st_dev;
+        entry.mIno = st.st_ino;
+        entry.mSize = st.st_size;
+        entry.mPhy = mNextPhy;
+        mNextPhy += pageAlign(entry.mSize);
+        mBuffers.push_back(entry);
+
+        *phy = entry.mPhy;
+        *size = entry.mSize;
+        return 0;
+    }
+
+    int mapIova(int master, int fd, unsigned long *iova, size_t *size) {
+        struct stat st;
+        if (stat(fd, &st) != 0) {
+            return -1;
+        }
+
+        Mutex::Autolock autoLock(mLock);
+        for (size_t i = 0; i < mIovas.size(); ++i) {
+            IovaEntry &entry = mIovas.editItemAt(i);
+            if (entry.mMaster == master && entry.mDev == st.st_dev
+                    && entry.mIno == st.st_ino) {
+                ++entry.mRefs;
+                *iova = entry.mIova;
+                *size = entry.mSize;
+                return 0;
+            }
+        }
+
+        IovaEntry entry;
+        entry.mMaster = master;
+        entry.mDev = st.st_dev;
+        entry.mIno = st.st_ino;
+        entry.mSize = st.st_size;
+        entry.mIova = mNextIova;
+        entry.mRefs = 1;
+        mNextIova += pageAlign(entry.mSize);
+        mIovas.push_back(entry);
+
+        ALOGV("map master %d, fd %d -> 0x%lx, %zu bytes", master, fd, entry.mIova, entry.mSize);
+
+        *iova = entry.mIova;
+        *size = entry.mSize;
+        return 0;
+    }
+
+    int unmapIova(int master, unsigned long iova, size_t size) {
+        Mutex::Autolock autoLock(mLock);
+        for (size_t i = 0; i < mIovas.size(); ++i) {
+            IovaEntry &entry = mIovas.editItemAt(i);
+            if (entry.mMaster == master && entry.mIova == iova) {
+                if (entry.mSize != size) {
+                    ALOGW("unmap 0x%lx with size %zu, mapped %zu", iova, size, entry.mSize);
+                }
+                if (--entry.mRefs == 0) {
+                    mIovas.removeAt(i);
+                }
+                return 0;
+            }
+        }
+
+        ALOGE("unmap of unknown iova 0x%lx, master %d", iova, master);
+        return -1;
+    }
+};
+
+FakeAllocator gAllocator;
+
+int createMemfd(const char *name) {
+#ifdef __NR_memfd_create
+    return syscall(__NR_memfd_create, name, 0x0001 /* MFD_CLOEXEC */);
+#else
+    (void)name;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+}  // namespace
+
+MemIon::MemIon()
+    : mFD(-1),
+      mSize(0),
+      mBase(MAP_FAILED),
+      mFlags(0),
+      mDevice(NULL) {
+}
+
+MemIon::MemIon(const char *device, size_t size, uint32_t flags, uint32_t memory_type)
+    : mFD(-1),
+      mSize(0),
+      mBase(MAP_FAILED),
+      mFlags(flags),
+      mDevice(device) {
+    ALOGV("alloc %zu bytes, flags 0x%x, heap 0x%x", size, flags, memory_type);
+
+    size_t alignedSize = FakeAllocator::pageAlign(size);
+    int fd = createMemfd("mock-ion");
+    if (fd < 0) {
+        ALOGE("memfd_create failed: %s", strerror(errno));
+        return;
+    }
+    if (ftruncate(fd, alignedSize) != 0) {
+        ALOGE("ftruncate(%zu) failed: %s", alignedSize, strerror(errno));
+        close(fd);
+        return;
+    }
+
+    mFD = fd;
+    mSize = alignedSize;
+    if (!(flags & DONT_MAP_LOCALLY)) {
+        int prot = PROT_READ | ((flags & READ_ONLY) ? 0 : PROT_WRITE);
+        mBase = mmap(NULL, alignedSize, prot, MAP_SHARED, fd, 0);
+        if (mBase == MAP_FAILED) {
+            ALOGE("mmap(%zu) failed: %s", alignedSize, strerror(errno));
+        }
+    }
+
+    Mutex::Autolock autoLock(gAllocator.mLock);
+    ++gAllocator.mLiveBuffers;
+}
+
+MemIon::~MemIon() {
+    if (mBase != MAP_FAILED) {
+        munmap(mBase, mSize);
+    }
+    if (mFD >= 0) {
+        close(mFD);
+
+        Mutex::Autolock autoLock(gAllocator.mLock);
+        --gAllocator.mLiveBuffers;
+    }
+}
+
+int MemIon::getHeapID() const {
+    return mFD;
+}
+
+void *MemIon::getBase() const {
+    return mBase;
+}
+
+size_t MemIon::getSize() const {
+    return mSize;
+}
+
+uint32_t MemIon::getFlags() const {
+    return mFlags;
+}
+
+const char *MemIon::getDevice() const {
+    return mDevice;
+}
+
+int MemIon::get_phy_addr_from_ion(unsigned long *phy_addr, size_t *size) {
+    return Get_phy_addr_from_ion(mFD, phy_addr, size);
+}
+
+int MemIon::get_iova(int master_id, unsigned long *iova, size_t *size) {
+    return Get_iova(master_id, mFD, iova, size);
+}
+
+int MemIon::free_iova(int master_id, unsigned long iova, size_t size) {
+    return Free_iova(master_id, iova, size);
+}
+
+int MemIon::flush_ion_buffer(void * /* v_addr */, void * /* p_addr */, size_t /* size */) {
+    return mFD >= 0 ? 0 : -1;
+}
+
+int MemIon::invalid_ion_buffer() {
+    return mFD >= 0 ? 0 : -1;
+}
+
+// static
+int MemIon::Get_phy_addr_from_ion(int buffer_fd, unsigned long *phy_addr, size_t *size) {
+    return gAllocator.phyAddr(buffer_fd, phy_addr, size);
+}
+
+// static
+int MemIon::Get_iova(int master_id, int buffer_fd, unsigned long *iova, size_t *size) {
+    return gAllocator.mapIova(master_id, buffer_fd, iova, size);
+}
+
+// static
+int MemIon::Free_iova(int master_id, unsigned long iova, size_t size) {
+    return gAllocator.unmapIova(master_id, iova, size);
+}
+
+// static
+int MemIon::Flush_ion_buffer(
+        int buffer_fd, void * /* v_addr */, void * /* p_addr */, size_t /* size */) {
+    return buffer_fd >= 0 ? 0 : -1;
+}
+
+// static
+int MemIon::Invalid_ion_buffer(int buffer_fd) {
+    return buffer_fd >= 0 ? 0 : -1;
+}
+
+// static
+int MemIon::Sync_ion_buffer(int buffer_fd) {
+    return buffer_fd >= 0 ? 0 : -1;
+}
+
+// static
+size_t MemIon::Mapped_iova_count() {
+    Mutex::Autolock autoLock(gAllocator.mLock);
+    return gAllocator.mIovas.size();
+}
+
+// static
+size_t MemIon::Live_buffer_count() {
+    Mutex::Autolock autoLock(gAllocator.mLock);
+    return gAllocator.mLiveBuffers;
+}
+
+}  // namespace android
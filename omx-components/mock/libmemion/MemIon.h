@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MOCK_MEM_ION_H_
+
+#define MOCK_MEM_ION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+// Host stand-in for vendor/sprd/modules/libmemion. Buffers are memfd
+// regions mapped into the process; physical addresses and IOVAs come from
+// a process-wide fake allocator that hands the same address to every fd
+// of one buffer, so addresses stay stable across dup() and binder-style
+// fd passing. Cache maintenance is a no-op since memfd memory is coherent.
+class MemIon : public RefBase {
+public:
+    enum {
+        READ_ONLY = 0x00000001,
+        DONT_MAP_LOCALLY = 0x00000100,
+        NO_CACHING = 0x00000200
+    };
+
+    MemIon();
+    MemIon(const char *device, size_t size, uint32_t flags, uint32_t memory_type);
+    virtual ~MemIon();
+
+    int getHeapID() const;
+    void *getBase() const;
+    size_t getSize() const;
+    uint32_t getFlags() const;
+    const char *getDevice() const;
+
+    int get_phy_addr_from_ion(unsigned long *phy_addr, size_t *size);
+    int get_iova(int master_id, unsigned long *iova, size_t *size);
+    int free_iova(int master_id, unsigned long iova, size_t size);
+    int flush_ion_buffer(void *v_addr, void *p_addr, size_t size);
+    int invalid_ion_buffer();
+
+    static int Get_phy_addr_from_ion(int buffer_fd, unsigned long *phy_addr, size_t *size);
+    static int Get_iova(int master_id, int buffer_fd, unsigned long *iova, size_t *size);
+    static int Free_iova(int master_id, unsigned long iova, size_t size);
+    static int Flush_ion_buffer(int buffer_fd, void *v_addr, void *p_addr, size_t size);
+    static int Invalid_ion_buffer(int buffer_fd);
+    static int Sync_ion_buffer(int buffer_fd);
+
+    // Fake allocator state, for leak checks at the end of a run: IOVA
+    // mappings still held and buffers still alive.
+    static size_t Mapped_iova_count();
+    static size_t Live_buffer_count();
+
+private:
+    int mFD;
+    size_t mSize;
+    void *mBase;
+    uint32_t mFlags;
+    const char *mDevice;
+
+    MemIon(const MemIon &);
+    MemIon &operator=(const MemIon &);
+};
+
+}  // namespace android
+
+#endif  // MOCK_MEM_ION_H_
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "MockGraphicBufferMapper"
+#include <utils/Log.h>
+
+#include <ui/GraphicBufferMapper.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gralloc_public.h"
+
+namespace android {
+
+GraphicBufferMapper &GraphicBufferMapper::get() {
+    static GraphicBufferMapper sInstance;
+    return sInstance;
+}
+
+status_t GraphicBufferMapper::lock(buffer_handle_t handle, uint32_t /* usage */,
+        const Rect & /* bounds */, void **vaddr) {
+    if (handle == NULL || vaddr == NULL) {
+        return BAD_VALUE;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    ssize_t index = mMappings.indexOfKey(handle);
+    if (index >= 0) {
+        ALOGE("handle %p is already locked", handle);
+        return INVALID_OPERATION;
+    }
+
+    int fd = ADP_BUFFD(handle);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ALOGE("handle %p: bad share fd %d", handle, fd);
+        return BAD_VALUE;
+    }
+
+    void *base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        ALOGE("mmap of fd %d failed: %s", fd, strerror(errno));
+        return NO_MEMORY;
+    }
+
+    Mapping mapping;
+    mapping.mBase = base;
+    mapping.mSize = st.st_size;
+    mMappings.add(handle, mapping);
+    *vaddr = base;
+    return OK;
+}
+
+status_t GraphicBufferMapper::lockYCbCr(buffer_handle_t handle, uint32_t usage,
+        const Rect &bounds, android_ycbcr *ycbcr) {
+    void *vaddr;
+    status_t err = lock(handle, usage, bounds, &vaddr);
+    if (err != OK) {
+        return err;
+    }
+
+    size_t lumaSize = (size_t)bounds.width() * bounds.height();
+    memset(ycbcr, 0, sizeof(*ycbcr));
+    ycbcr->y = vaddr;
+    ycbcr->cb = (uint8_t *)vaddr + lumaSize;
+    ycbcr->cr = (uint8_t *)vaddr + lumaSize + 1;
+    ycbcr->ystride = bounds.width();
+    ycbcr->cstride = bounds.width();
+    ycbcr->chroma_step = 2;
+    return OK;
+}
+
+status_t GraphicBufferMapper::unlock(buffer_handle_t handle) {
+    Mutex::Autolock autoLock(mLock);
+    ssize_t index = mMappings.indexOfKey(handle);
+    if (index < 0) {
+        ALOGE("handle %p is not locked", handle);
+        return BAD_VALUE;
+    }
+    const Mapping &mapping = mMappings.valueAt(index);
+    munmap(mapping.mBase, mapping.mSize);
+    mMappings.removeItemsAt(index);
+    return OK;
+}
+
+}  // namespace android
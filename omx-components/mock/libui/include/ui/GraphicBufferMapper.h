@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MOCK_UI_GRAPHIC_BUFFER_MAPPER_H_
+
+#define MOCK_UI_GRAPHIC_BUFFER_MAPPER_H_
+
+#include <stdint.h>
+#include <system/graphics.h>
+#include <cutils/native_handle.h>
+#include <utils/Errors.h>
+#include <utils/KeyedVector.h>
+#include <utils/threads.h>
+#include <ui/Rect.h>
+
+namespace android {
+
+// Host stand-in for libui's GraphicBufferMapper. A handle is a gralloc
+// private handle whose share fd is a memfd from the fake MemIon; lock()
+// maps it and unlock() unmaps it. lockYCbCr() describes the buffer as
+// NV12 at the locked size.
+class GraphicBufferMapper {
+public:
+    static GraphicBufferMapper &get();
+
+    status_t lock(buffer_handle_t handle, uint32_t usage, const Rect &bounds, void **vaddr);
+    status_t lockYCbCr(buffer_handle_t handle, uint32_t usage, const Rect &bounds,
+            android_ycbcr *ycbcr);
+    status_t unlock(buffer_handle_t handle);
+
+private:
+    struct Mapping {
+        void *mBase;
+        size_t mSize;
+    };
+
+    GraphicBufferMapper() {}
+
+    Mutex mLock;
+    KeyedVector<buffer_handle_t, Mapping> mMappings;
+
+    GraphicBufferMapper(const GraphicBufferMapper &);
+    GraphicBufferMapper &operator=(const GraphicBufferMapper &);
+};
+
+}  // namespace android
+
+#endif  // MOCK_UI_GRAPHIC_BUFFER_MAPPER_H_
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MOCK_UI_RECT_H_
+
+#define MOCK_UI_RECT_H_
+
+#include <stdint.h>
+
+namespace android {
+
+// Host stand-in for the part of frameworks/native ui/Rect.h the
+// components use: a lock region.
+class Rect {
+public:
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+
+    Rect() : left(0), top(0), right(0), bottom(0) {}
+    Rect(int32_t w, int32_t h) : left(0), top(0), right(w), bottom(h) {}
+    Rect(int32_t l, int32_t t, int32_t r, int32_t b) : left(l), top(t), right(r), bottom(b) {}
+
+    int32_t getWidth() const { return right - left; }
+    int32_t getHeight() const { return bottom - top; }
+    int32_t width() const { return getWidth(); }
+    int32_t height() const { return getHeight(); }
+    bool isEmpty() const { return width() <= 0 || height() <= 0; }
+};
+
+}  // namespace android
+
+#endif  // MOCK_UI_RECT_H_
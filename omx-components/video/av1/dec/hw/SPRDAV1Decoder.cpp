@@ -117,6 +117,13 @@ SPRDAV1Decoder::SPRDAV1Decoder(
     mDumpStrmEnabled = !strcmp(value_dump, "true");
     ALOGI("%s, mDumpYUVEnabled: %d, mDumpStrmEnabled: %d", __FUNCTION__, mDumpYUVEnabled, mDumpStrmEnabled);
 
+    property_get("vendor.av1dec.async", value_dump, "false");
+    if (!strcmp(value_dump, "true")) {
+        startDecodeThread();
+    }
+
+    enableVspScheduling(SprdVspScheduler::kCoreDecoder);
+
 
     CHECK_EQ(initDecoder(), (status_t)OK);
 
@@ -136,7 +143,7 @@ SPRDAV1Decoder::SPRDAV1Decoder(
     if(mDumpYUVEnabled) {
         char s1[100];
         sprintf(s1,"/data/misc/media/video_out_%p_%lld.yuv",(void *)this,start_decode);
-        mFile_yuv = fopen(s1, "wb");
+        mFile_yuv = new SprdDumpWriter(s1);
         ALOGI("yuv file name %s",s1);
     }
 
@@ -146,8 +153,8 @@ SPRDAV1Decoder::SPRDAV1Decoder(
                                 0x00,0x3c,0x00,0x00,0x01,0x00,0x00,0x00,0x00,0x10,0x0e,0x00,0x00,0x00,0x00,0x00};
         sprintf(s2,"/data/misc/media/video_es_%p_%lld.ivf",(void *)this,start_decode);
         ALOGI("bs file name %s",s2);
-        mFile_bs = fopen(s2, "wb");
-        fwrite(ivf_header,1,32,mFile_bs);
+        mFile_bs = new SprdDumpWriter(s2);
+        mFile_bs->write(ivf_header, 32, SprdDumpWriter::kFlagCodecConfig);
     }
 }
 
@@ -159,23 +166,19 @@ SPRDAV1Decoder::~SPRDAV1Decoder() {
     delete mHandle;
     mHandle = NULL;
 
-    List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
-    List<BufferInfo *> &inQueue = getPortQueue(kInputPortIndex);
+    PortQueue &outQueue = getPortQueue(kOutputPortIndex);
+    PortQueue &inQueue = getPortQueue(kInputPortIndex);
     CHECK(outQueue.empty());
     CHECK(inQueue.empty());
 
     if(mDumpYUVEnabled) {
-        if (mFile_yuv) {
-            fclose(mFile_yuv);
-            mFile_yuv = NULL;
-        }
+        delete mFile_yuv;
+        mFile_yuv = NULL;
     }
 
     if(mDumpStrmEnabled) {
-        if (mFile_bs) {
-            fclose(mFile_bs);
-            mFile_bs = NULL;
-        }
+        delete mFile_bs;
+        mFile_bs = NULL;
     }
     instances--;
 }
@@ -474,6 +477,7 @@ OMX_ERRORTYPE SPRDAV1Decoder::internalSetParameter(
 
         if (defParams->nBufferCountActual == 1) {
             mThumbnailMode = OMX_TRUE;
+            setVspPriority(SprdVspScheduler::kPriorityBackground);
         } else {
             if (defParams->nBufferCountActual < port->mDef.nBufferCountMin) {
                 ALOGW("component requires at least %u buffers (%u requested)",
@@ -598,20 +602,8 @@ OMX_ERRORTYPE SPRDAV1Decoder::internalUseBuffer(
         }
     }
 
-    PortInfo *port = editPortInfo(portIndex);
-
-    port->mBuffers.push();
-
-    BufferInfo *buffer =
-        &port->mBuffers.editItemAt(port->mBuffers.size() - 1);
     ALOGI("internalUseBuffer, portIndex= %d, header=%p, pBuffer=%p, size=%d", portIndex, *header, ptr, size);
-    buffer->mHeader = *header;
-    buffer->mOwnedByUs = false;
-
-    if (port->mBuffers.size() == port->mDef.nBufferCountActual) {
-        port->mDef.bPopulated = OMX_TRUE;
-        checkTransitions();
-    }
+    addBuffer(portIndex, *header);
 
     return OMX_ErrorNone;
 }
@@ -693,6 +685,10 @@ OMX_ERRORTYPE SPRDAV1Decoder::getConfig(
         return OMX_ErrorNone;
     }
 
+    case OMX_IndexConfigCodecMetrics:
+    case OMX_IndexConfigCallbackBatching:
+        return SprdSimpleOMXComponent::getConfig(index, params);
+
     default:
         return OMX_ErrorUnsupportedIndex;
     }
@@ -708,6 +704,7 @@ OMX_ERRORTYPE SPRDAV1Decoder::setConfig(
 
         if (*pEnable == OMX_TRUE) {
             mThumbnailMode = OMX_TRUE;
+            setVspPriority(SprdVspScheduler::kPriorityBackground);
         }
 
         ALOGI("setConfig, mThumbnailMode = %d", mThumbnailMode);
@@ -724,6 +721,9 @@ OMX_ERRORTYPE SPRDAV1Decoder::setConfig(
     case OMX_IndexConfigDecSceneMode:
     {
         int *pDecSceneMode = (int *)params;
+        if (*pDecSceneMode == 3) { // VoLTE
+            setVspPriority(SprdVspScheduler::kPriorityRealtime);
+        }
 
         ALOGI("%s,%d,setConfig, pDecSceneMode = %d",__FUNCTION__,__LINE__, *pDecSceneMode);
         return OMX_ErrorNone;
@@ -736,17 +736,14 @@ OMX_ERRORTYPE SPRDAV1Decoder::setConfig(
 
 void SPRDAV1Decoder::dump_strm(uint8 *pBuffer, int32 aInBufSize) {
     if(mDumpStrmEnabled) {
-        uint32 tmp = 0;
-        fwrite(&aInBufSize, 1,4, mFile_bs);
-        fwrite(&tmp, 1,4, mFile_bs);
-        fwrite(&tmp, 1,4, mFile_bs);
-        fwrite(pBuffer,1,aInBufSize,mFile_bs);
+        uint32 frame_header[3] = {(uint32)aInBufSize, 0, 0};
+        mFile_bs->write(frame_header, sizeof(frame_header), pBuffer, aInBufSize);
     }
 }
 
 void SPRDAV1Decoder::dump_yuv(uint8 *pBuffer, int32 aInBufSize) {
     if(mDumpYUVEnabled) {
-        fwrite(pBuffer,1,aInBufSize,mFile_yuv);
+        mFile_yuv->write(pBuffer, aInBufSize);
     }
 }
 
@@ -759,8 +756,8 @@ void SPRDAV1Decoder::onQueueFilled(OMX_U32 portIndex) {
         return;
     }
 
-    List<BufferInfo *> &inQueue = getPortQueue(kInputPortIndex);
-    List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
+    PortQueue &inQueue = getPortQueue(kInputPortIndex);
+    PortQueue &outQueue = getPortQueue(kOutputPortIndex);
 
     while (!mStopDecode && (mEOSStatus != INPUT_DATA_AVAILABLE || !inQueue.empty())
             && (outQueue.size() != 0 )) {
@@ -773,7 +770,7 @@ void SPRDAV1Decoder::onQueueFilled(OMX_U32 portIndex) {
         OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
 
         OMX_BUFFERHEADERTYPE *outHeader = NULL;
-        List<BufferInfo *>::iterator itBuffer;
+        PortQueue::iterator itBuffer;
         BufferCtrlStruct *pBufCtrl = NULL;
         size_t count = 0;
         uint32_t queueSize = 0;
@@ -792,7 +789,7 @@ void SPRDAV1Decoder::onQueueFilled(OMX_U32 portIndex) {
                 return;
             }
             if(count >= queueSize) {
-                ALOGI("onQueueFilled, get outQueue buffer, return, count=%zd, queue_size=%d",count, queueSize);
+                SPRD_FRAME_LOGI("onQueueFilled, get outQueue buffer, return, count=%zd, queue_size=%d",count, queueSize);
                 return;
             }
 
@@ -809,7 +806,7 @@ void SPRDAV1Decoder::onQueueFilled(OMX_U32 portIndex) {
             count++;
         } while (pBufCtrl->iRefCount > 0);
 
-        ALOGI("%s, %d, outHeader:%p, inHeader: %p, len: %d, nOffset: %d, time: %lld, EOS: %d",
+        SPRD_FRAME_LOGI("%s, %d, outHeader:%p, inHeader: %p, len: %d, nOffset: %d, time: %lld, EOS: %d",
               __FUNCTION__, __LINE__,outHeader,inHeader, inHeader->nFilledLen,
               inHeader->nOffset, inHeader->nTimeStamp,inHeader->nFlags & OMX_BUFFERFLAG_EOS);
 
@@ -835,7 +832,7 @@ void SPRDAV1Decoder::onQueueFilled(OMX_U32 portIndex) {
         uint32_t copyLen = 0;
         uint32_t add_startcode_len = 0;
 
-        ALOGI("%x,%x,%x,%x\n",bitstream[0],bitstream[1],bitstream[2],bitstream[3]);
+        SPRD_FRAME_LOGI("%x,%x,%x,%x\n",bitstream[0],bitstream[1],bitstream[2],bitstream[3]);
         dec_in.pStream = mPbuf_stream_v;
 
 
@@ -851,6 +848,7 @@ void SPRDAV1Decoder::onQueueFilled(OMX_U32 portIndex) {
 
         if (mPbuf_stream_v != NULL) {
             memcpy(mPbuf_stream_v , bitstream, bufferSize);
+            mMetrics.count(SprdCodecMetrics::kCounterCopyBytes, bufferSize);
         }
 
         dec_in.dataLen = bufferSize;
@@ -892,11 +890,13 @@ void SPRDAV1Decoder::onQueueFilled(OMX_U32 portIndex) {
 
         dump_strm(mPbuf_stream_v, dec_in.dataLen);
 
-        int64_t start_decode = systemTime();
-        MMDecRet decRet = (*mAV1DecDecode)(mHandle, &dec_in,&dec_out);
-        int64_t end_decode = systemTime();
-        ALOGI("%s, %d, decRet: %d, %dms, dec_out.frameEffective: %d, needIVOP: %d, in {%p, 0x%lx}, consume byte: %u, flag:0x%x, pts:%lld",
-              __FUNCTION__, __LINE__, decRet, (unsigned int)((end_decode-start_decode) / 1000000L),
+        MMDecRet decRet;
+        {
+            HardwareSection section(this);
+            decRet = (*mAV1DecDecode)(mHandle, &dec_in,&dec_out);
+        }
+        SPRD_FRAME_LOGI("%s, %d, decRet: %d, %dms, dec_out.frameEffective: %d, needIVOP: %d, in {%p, 0x%lx}, consume byte: %u, flag:0x%x, pts:%lld",
+              __FUNCTION__, __LINE__, decRet, (unsigned int)(mMetrics.lastUs(SprdCodecMetrics::kHistogramEngineTime) / 1000),
               dec_out.frameEffective, mNeedIVOP, dec_in.pStream, dec_in.pStream_phy, dec_in.dataLen, inHeader->nFlags, dec_out.pts);
 
 
@@ -908,6 +908,7 @@ void SPRDAV1Decoder::onQueueFilled(OMX_U32 portIndex) {
 
         if (decRet != MMDEC_OK) {
             ALOGE("failed to support this format.");
+            mMetrics.count(SprdCodecMetrics::kCounterErrors);
             notify(OMX_EventError, OMX_ErrorFormatNotDetected, 0, NULL);
             mSignalledError = true;
             return;
@@ -999,25 +1000,21 @@ bool SPRDAV1Decoder::handlePortSettingChangeEvent(const AV1SwDecInfo *info) {
 
 void SPRDAV1Decoder::drainOneOutputBuffer(int32_t picId, void* pBufferHeader, uint64 pts) {
 
-    List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
+    PortQueue &outQueue = getPortQueue(kOutputPortIndex);
 
-    List<BufferInfo *>::iterator it = outQueue.begin();
-    while ((*it)->mHeader != (OMX_BUFFERHEADERTYPE*)pBufferHeader && it != outQueue.end()) {
-        ++it;
-    }
-    CHECK((*it)->mHeader == (OMX_BUFFERHEADERTYPE*)pBufferHeader);
+    BufferInfo *outInfo = findBufferInfo(kOutputPortIndex, (OMX_BUFFERHEADERTYPE*)pBufferHeader);
+    CHECK(outInfo != NULL && outInfo->mQueued);
 
-    BufferInfo *outInfo = *it;
     OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
 
     outHeader->nFilledLen = mPictureSize;
     outHeader->nTimeStamp = (OMX_TICKS)pts;
 
-    ALOGI("%s, %d, outHeader: %p, outHeader->pBuffer: %p, outHeader->nOffset: %d, outHeader->nFlags: %d, outHeader->nTimeStamp: %lld",
+    SPRD_FRAME_LOGI("%s, %d, outHeader: %p, outHeader->pBuffer: %p, outHeader->nOffset: %d, outHeader->nFlags: %d, outHeader->nTimeStamp: %lld",
           __FUNCTION__, __LINE__, outHeader , outHeader->pBuffer, outHeader->nOffset, outHeader->nFlags, outHeader->nTimeStamp);
 
     outInfo->mOwnedByUs = false;
-    outQueue.erase(it);
+    outQueue.erase(outInfo);
     outInfo = NULL;
 
     BufferCtrlStruct* pOutBufCtrl= (BufferCtrlStruct*)(outHeader->pOutputPortPrivate);
@@ -1028,10 +1025,8 @@ void SPRDAV1Decoder::drainOneOutputBuffer(int32_t picId, void* pBufferHeader, ui
 bool SPRDAV1Decoder::drainAllOutputBuffers() {
     ALOGI("%s, %d", __FUNCTION__, __LINE__);
 
-    List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
+    PortQueue &outQueue = getPortQueue(kOutputPortIndex);
     BufferInfo *outInfo;
-    List<BufferInfo *>::iterator it;
-    List<BufferInfo *>::iterator it_end;
     OMX_BUFFERHEADERTYPE *outHeader;
 
     uint8* pbuffer;
@@ -1044,22 +1039,14 @@ bool SPRDAV1Decoder::drainAllOutputBuffers() {
             return false;
         }
 
-
-        it = outQueue.begin();
-        it_end = outQueue.end();
-
-
         if (MMDEC_OK == (*mAV1Dec_GetLastDspFrm)(mHandle,(void**)&pbuffer,&pBufferHeader, &pts) ) {
-            while ((*it)->mHeader != (OMX_BUFFERHEADERTYPE*)pBufferHeader && it != it_end) {
-                ++it;
-            }
-            CHECK((*it)->mHeader == (OMX_BUFFERHEADERTYPE*)pBufferHeader);
-            outInfo = *it;
+            outInfo = findBufferInfo(kOutputPortIndex, (OMX_BUFFERHEADERTYPE*)pBufferHeader);
+            CHECK(outInfo != NULL && outInfo->mQueued);
             outHeader = outInfo->mHeader;
             outHeader->nFilledLen = mPictureSize;
 
         } else {
-            outInfo = *it;
+            outInfo = *outQueue.begin();
             outHeader = outInfo->mHeader;
             outHeader->nTimeStamp = 0;
             outHeader->nFilledLen = 0;
@@ -1068,7 +1055,7 @@ bool SPRDAV1Decoder::drainAllOutputBuffers() {
         }
 
 
-        outQueue.erase(it);
+        outQueue.erase(outInfo);
         outInfo->mOwnedByUs = false;
         BufferCtrlStruct* pOutBufCtrl= (BufferCtrlStruct*)(outHeader->pOutputPortPrivate);
         pOutBufCtrl->iRefCount++;
@@ -1226,6 +1213,8 @@ OMX_ERRORTYPE SPRDAV1Decoder::getExtensionIndex(
         ALOGI("getExtensionIndex:%s",SPRD_INDEX_CONFIG_DEC_SCENE_MODE);
         *index = (OMX_INDEXTYPE) OMX_IndexConfigDecSceneMode;
         return OMX_ErrorNone;
+    } else if (!strcmp(name, SPRD_INDEX_CONFIG_CODEC_METRICS)) {
+        return SprdSimpleOMXComponent::getExtensionIndex(name, index);
     }
     return OMX_ErrorNotImplemented;
 }
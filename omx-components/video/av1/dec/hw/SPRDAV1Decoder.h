@@ -18,6 +18,7 @@
 #define SPRD_AV1_DECODER_H_
 
 #include "SprdSimpleOMXComponent.h"
+#include "SprdDumpWriter.h"
 #include <utils/KeyedVector.h>
 #include "MemIon.h"
 #include "av1_dec_api.h"
@@ -146,8 +147,8 @@ private:
     OMX_BOOL iUseAndroidNativeBuffer[2];
     MMDecCapability mCapability;
 
-    FILE* mFile_yuv;
-    FILE* mFile_bs;
+    SprdDumpWriter *mFile_yuv;
+    SprdDumpWriter *mFile_bs;
 
     OMX_ERRORTYPE mInitCheck;
 
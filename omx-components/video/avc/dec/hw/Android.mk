@@ -53,9 +53,54 @@ LOCAL_SHARED_LIBRARIES := \
     libcutils                  \
     libstagefright_sprd_deintl
 
+LOCAL_STATIC_LIBRARIES := libsprd_bitstream
+
 LOCAL_MODULE := libstagefright_sprd_h264dec
 LOCAL_MODULE_TAGS := optional
 LOCAL_PROPRIETARY_MODULE := true
 
 include $(BUILD_SHARED_LIBRARY)
 
+
+# Host build against the engine, libmemion and libui of
+# omx-components/mock; the deinterlacer is the mock one as well.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    SPRDAVCDecoder.cpp \
+    avc_utils_sprd.cpp \
+
+LOCAL_C_INCLUDES := \
+    frameworks/av/media/libstagefright/include                    \
+    frameworks/native/include/media/hardware                      \
+    frameworks/av/include/media/stagefright/foundation/           \
+    $(LOCAL_PATH)/../../../../../libstagefrighthw/include         \
+    $(LOCAL_PATH)/../../../../../libstagefrighthw/include/openmax \
+    $(LOCAL_PATH)/../../../../../../../external/kernel-headers    \
+    $(LOCAL_PATH)/../../../vpp/deintl/component                   \
+    $(LOCAL_PATH)/../../../vpp/deintl/core/vsp
+
+LOCAL_C_INCLUDES += $(TOP)/vendor/sprd/external/drivers/gpu
+LOCAL_C_INCLUDES += $(TOP)/system/core/libion/kernel-headers
+
+LOCAL_CFLAGS := -DOSCL_EXPORT_REF= -DOSCL_IMPORT_REF=
+
+LOCAL_SHARED_LIBRARIES := \
+    libstagefright_foundation  \
+    libstagefrighthw           \
+    libutils                   \
+    libui                      \
+    libmemion                  \
+    liblog                     \
+    libcutils                  \
+    libstagefright_sprd_deintl
+
+LOCAL_STATIC_LIBRARIES := libsprd_bitstream
+
+LOCAL_LDLIBS := -ldl -lpthread
+
+LOCAL_MODULE := libstagefright_sprd_h264dec
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_SHARED_LIBRARY)
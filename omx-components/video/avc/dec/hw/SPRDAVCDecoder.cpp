@@ -32,6 +32,7 @@
 #include <sys/prctl.h>
 #include <cutils/properties.h>
 #include "avc_utils_sprd.h"
+#include "SprdBitstream.h"
 
 #include "gralloc_public.h"
 #include "sprd_ion.h"
@@ -125,7 +126,7 @@ SPRDAVCDecoder::SPRDAVCDecoder(
       mPbuf_stream_v(NULL),
       mPbuf_stream_p(0),
       mPbuf_stream_size(0),
-      mPmem_extra(NULL),
+      mIonArena(NULL),
       mPbuf_extra_v(NULL),
       mPbuf_extra_p(0),
       mPbuf_extra_size(0),
@@ -134,8 +135,10 @@ SPRDAVCDecoder::SPRDAVCDecoder(
       mDecoderSawPPS(false),
       mSPSData(NULL),
       mSPSDataSize(0),
+      mSPSDataCapacity(0),
       mPPSData(NULL),
       mPPSDataSize(0),
+      mPPSDataCapacity(0),
       mIsResume(false),
       mSecureFlag(false),
       mAllocInput(false),
@@ -207,6 +210,11 @@ SPRDAVCDecoder::SPRDAVCDecoder(
     mDumpStrmEnabled = !strcmp(value_dump, "true");
     ALOGI("%s, mDumpYUVEnabled: %d, mDumpStrmEnabled: %d", __FUNCTION__, mDumpYUVEnabled, mDumpStrmEnabled);
 
+    property_get("vendor.h264dec.async", value_dump, "false");
+    if (!strcmp(value_dump, "true")) {
+        startDecodeThread();
+    }
+
     if(mDecoderSwFlag) {
         CHECK_EQ(initDecoder(), (status_t)OK);
     } else {
@@ -223,14 +231,25 @@ SPRDAVCDecoder::SPRDAVCDecoder(
         }
     }
 
+    if (!mDecoderSwFlag) {
+        enableVspScheduling(SprdVspScheduler::kCoreDecoder);
+    }
+
+    // Let the engine read the bitstream straight from the input buffers
+    // when the client asks us to allocate them.
+    property_get("vendor.h264dec.zerocopy", value_dump, "false");
+    mAllocInput = !mSecureFlag && !mDecoderSwFlag && !strcmp(value_dump, "true");
+
     mSPSData = (uint8_t *)malloc(H264_HEADER_SIZE);
     mPPSData = (uint8_t *)malloc(H264_HEADER_SIZE);
     if (mSPSData == NULL || mPPSData == NULL) {
         mInitCheck = OMX_ErrorInsufficientResources;
+    } else {
+        mSPSDataCapacity = H264_HEADER_SIZE;
+        mPPSDataCapacity = H264_HEADER_SIZE;
     }
 
     for (int i = 0; i < 17; i++) {
-        mPmem_mbinfo[i] = NULL;
         mPbuf_mbinfo_v[i] = NULL;
         mPbuf_mbinfo_p[i] = 0;
         mPbuf_mbinfo_size[i] = 0;
@@ -257,7 +276,7 @@ SPRDAVCDecoder::SPRDAVCDecoder(
     if(mDumpYUVEnabled){
         char s1[100];
         sprintf(s1,"/data/misc/media/video_out_%p_%lld.yuv",(void *)this,start_decode);
-        mFile_yuv = fopen(s1, "wb");
+        mFile_yuv = new SprdDumpWriter(s1);
         ALOGI("yuv file name %s",s1);
     }
 
@@ -265,7 +284,7 @@ SPRDAVCDecoder::SPRDAVCDecoder(
         char s2[100];
         sprintf(s2,"/data/misc/media/video_es_%p_%lld.h264",(void *)this,start_decode);
         ALOGI("bs file name %s",s2);
-        mFile_bs = fopen(s2, "wb");
+        mFile_bs = new SprdDumpWriter(s2);
     }
 }
 
@@ -300,23 +319,19 @@ SPRDAVCDecoder::~SPRDAVCDecoder() {
     delete mHandle;
     mHandle = NULL;
 
-    List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
-    List<BufferInfo *> &inQueue = getPortQueue(kInputPortIndex);
+    PortQueue &outQueue = getPortQueue(kOutputPortIndex);
+    PortQueue &inQueue = getPortQueue(kInputPortIndex);
     CHECK(outQueue.empty());
     CHECK(inQueue.empty());
 
     if(mDumpYUVEnabled){
-        if (mFile_yuv) {
-           fclose(mFile_yuv);
-           mFile_yuv = NULL;
-       }
+        delete mFile_yuv;
+        mFile_yuv = NULL;
     }
 
     if(mDumpStrmEnabled){
-       if (mFile_bs) {
-           fclose(mFile_bs);
-          mFile_bs = NULL;
-      }
+       delete mFile_bs;
+       mFile_bs = NULL;
    }
     instances--;
 }
@@ -527,26 +542,20 @@ status_t SPRDAVCDecoder::initDecoder() {
 void SPRDAVCDecoder::releaseDecoder() {
     releaseStreamBuffer();
 
-    if (mPbuf_extra_v != NULL) {
-        if (mIOMMUEnabled) {
-            (*mH264DecFreeIOVA)(mHandle, mPbuf_extra_p, mPbuf_extra_size);
-        }
-        mPmem_extra.clear();
-        mPbuf_extra_v = NULL;
-        mPbuf_extra_p = 0;
-        mPbuf_extra_size = 0;
+    if (mIonArena != NULL) {
+        mIonArena->releaseAll();
+        delete mIonArena;
+        mIonArena = NULL;
     }
 
+    mPbuf_extra_v = NULL;
+    mPbuf_extra_p = 0;
+    mPbuf_extra_size = 0;
+
     for (int i = 0; i < 17; i++) {
-        if (mPbuf_mbinfo_v[i]) {
-            if (mIOMMUEnabled) {
-                (*mH264DecFreeIOVA)(mHandle, mPbuf_mbinfo_p[i], mPbuf_mbinfo_size[i]);
-            }
-            mPmem_mbinfo[i].clear();
-            mPbuf_mbinfo_v[i] = NULL;
-            mPbuf_mbinfo_p[i] = 0;
-            mPbuf_mbinfo_size[i] = 0;
-        }
+        mPbuf_mbinfo_v[i] = NULL;
+        mPbuf_mbinfo_p[i] = 0;
+        mPbuf_mbinfo_size[i] = 0;
     }
     mPbuf_mbinfo_idx = 0;
 
@@ -793,6 +802,7 @@ OMX_ERRORTYPE SPRDAVCDecoder::internalSetParameter(
 
         if (defParams->nBufferCountActual == 1) {
             mThumbnailMode = OMX_TRUE;
+            setVspPriority(SprdVspScheduler::kPriorityBackground);
         } else {
             if (defParams->nBufferCountActual < port->mDef.nBufferCountMin) {
                 ALOGW("component requires at least %u buffers (%u requested)",
@@ -937,7 +947,7 @@ OMX_ERRORTYPE SPRDAVCDecoder::internalUseBuffer(
                 pBufCtrl->pMem = ((BufferPrivateStruct*)bufferPrivate)->pMem;
                 pBufCtrl->phyAddr = ((BufferPrivateStruct*)bufferPrivate)->phyAddr;
                 pBufCtrl->bufferSize = ((BufferPrivateStruct*)bufferPrivate)->bufferSize;
-                pBufCtrl->bufferFd = 0;
+                pBufCtrl->bufferFd = ((BufferPrivateStruct*)bufferPrivate)->bufferFd;
             } else {
                 pBufCtrl->pMem = NULL;
                 pBufCtrl->phyAddr = 0;
@@ -947,20 +957,8 @@ OMX_ERRORTYPE SPRDAVCDecoder::internalUseBuffer(
         }
     }
 
-    PortInfo *port = editPortInfo(portIndex);
-
-    port->mBuffers.push();
-
-    BufferInfo *buffer =
-        &port->mBuffers.editItemAt(port->mBuffers.size() - 1);
     ALOGI("internalUseBuffer, portIndex= %d, header=%p, pBuffer=%p, size=%d", portIndex, *header, ptr, size);
-    buffer->mHeader = *header;
-    buffer->mOwnedByUs = false;
-
-    if (port->mBuffers.size() == port->mDef.nBufferCountActual) {
-        port->mDef.bPopulated = OMX_TRUE;
-        checkTransitions();
-    }
+    addBuffer(portIndex, *header);
 
     return OMX_ErrorNone;
 }
@@ -979,20 +977,31 @@ OMX_ERRORTYPE SPRDAVCDecoder::allocateBuffer(
             size_t bufferSize = 0;
             void *pBuffer = NULL;
             size_t size64word = (size + 1024*4 - 1) & ~(1024*4 - 1);
-            int fd;
+            int fd, ret;
 
-            if (mAllocInput)
-                pMem = new MemIon(SPRD_ION_DEV, size64word, MemIon::NO_CACHING, ION_HEAP_ID_MASK_MM);
-            else
+            if (mSecureFlag)
                 pMem = new MemIon(SPRD_ION_DEV, size64word, MemIon::NO_CACHING, ION_HEAP_ID_MASK_MM | ION_FLAG_SECURE);
+            else if (mIOMMUEnabled)
+                pMem = new MemIon(SPRD_ION_DEV, size64word, MemIon::NO_CACHING, ION_HEAP_ID_MASK_SYSTEM);
+            else
+                pMem = new MemIon(SPRD_ION_DEV, size64word, MemIon::NO_CACHING, ION_HEAP_ID_MASK_MM);
             fd = pMem->getHeapID();
             if(fd < 0) {
                 ALOGE("%s, Failed to alloc input pmem buffer", __FUNCTION__);
+                delete pMem;
                 return OMX_ErrorInsufficientResources;
             }
 
-            if(pMem->get_phy_addr_from_ion(&phyAddr, &bufferSize)) {
+            if (!mSecureFlag && mIOMMUEnabled) {
+                ret = (*mH264DecGetIOVA)(mHandle, fd, &phyAddr, &bufferSize);
+                if(ret) {
+                    ALOGE("%s, input H264DecGetIOVA Failed: %d(%s)", __FUNCTION__, ret, strerror(errno));
+                    delete pMem;
+                    return OMX_ErrorInsufficientResources;
+                }
+            } else if(pMem->get_phy_addr_from_ion(&phyAddr, &bufferSize)) {
                 ALOGE("%s, input get_phy_addr_from_ion fail", __FUNCTION__);
+                delete pMem;
                 return OMX_ErrorInsufficientResources;
             }
 
@@ -1001,6 +1010,7 @@ OMX_ERRORTYPE SPRDAVCDecoder::allocateBuffer(
             bufferPrivate->pMem = pMem;
             bufferPrivate->phyAddr = phyAddr;
             bufferPrivate->bufferSize = bufferSize;
+            bufferPrivate->bufferFd = fd;
 
             ALOGI("%s, allocate input buffer from MemIon, virAddr: %p, phyAddr: 0x%lx, size: %zd",
                     __FUNCTION__, pBuffer, phyAddr, bufferSize);
@@ -1040,6 +1050,7 @@ OMX_ERRORTYPE SPRDAVCDecoder::allocateBuffer(
             fd = pMem->getHeapID();
             if(fd < 0) {
                 ALOGE("Failed to alloc outport pmem buffer");
+                delete pMem;
                 return OMX_ErrorInsufficientResources;
             }
 
@@ -1047,11 +1058,13 @@ OMX_ERRORTYPE SPRDAVCDecoder::allocateBuffer(
                 ret = (*mH264DecGetIOVA)(mHandle, fd, &phyAddr, &bufferSize);
                 if(ret) {
                     ALOGE("H264DecGetIOVA Failed: %d(%s)", ret, strerror(errno));
+                    delete pMem;
                     return OMX_ErrorInsufficientResources;
                 }
             } else {
                 if(pMem->get_phy_addr_from_ion(&phyAddr, &bufferSize)) {
                     ALOGE("get_phy_addr_from_ion fail");
+                    delete pMem;
                     return OMX_ErrorInsufficientResources;
                 }
             }
@@ -1087,6 +1100,9 @@ OMX_ERRORTYPE SPRDAVCDecoder::freeBuffer(
             BufferCtrlStruct* pBufCtrl= (BufferCtrlStruct*)(header->pInputPortPrivate);
             if(pBufCtrl != NULL && pBufCtrl->pMem != NULL) {
                 ALOGI("freeBuffer, intput phyAddr: 0x%lx", pBufCtrl->phyAddr);
+                if (!mSecureFlag && mIOMMUEnabled && pBufCtrl->phyAddr > 0) {
+                    (*mH264DecFreeIOVA)(mHandle, pBufCtrl->phyAddr, pBufCtrl->bufferSize);
+                }
                 pBufCtrl->pMem.clear();
                 return SprdSimpleOMXComponent::freeBuffer(portIndex, header);
             } else {
@@ -1102,6 +1118,9 @@ OMX_ERRORTYPE SPRDAVCDecoder::freeBuffer(
     {
         BufferCtrlStruct* pBufCtrl= (BufferCtrlStruct*)(header->pOutputPortPrivate);
         if(pBufCtrl != NULL) {
+            if (mDeintl != NULL && pBufCtrl->bufferFd > 0) {
+                mDeintl->invalidateIova(pBufCtrl->bufferFd);
+            }
             if (mIOMMUEnabled && pBufCtrl->phyAddr > 0) {
                 ALOGI("freeBuffer,phyAddr: 0x%lx", pBufCtrl->phyAddr);
                 if (mDeintl && mDecoderSwFlag){
@@ -1171,6 +1190,10 @@ OMX_ERRORTYPE SPRDAVCDecoder::getConfig(
 
         return OMX_ErrorNone;
     }
+    case OMX_IndexConfigCodecMetrics:
+    case OMX_IndexConfigCallbackBatching:
+        return SprdSimpleOMXComponent::getConfig(index, params);
+
     default:
         return OMX_ErrorUnsupportedIndex;
     }
@@ -1186,6 +1209,7 @@ OMX_ERRORTYPE SPRDAVCDecoder::setConfig(
 
         if (*pEnable == OMX_TRUE) {
             mThumbnailMode = OMX_TRUE;
+            setVspPriority(SprdVspScheduler::kPriorityBackground);
         }
 
         ALOGI("setConfig, mThumbnailMode = %d", mThumbnailMode);
@@ -1237,8 +1261,10 @@ OMX_ERRORTYPE SPRDAVCDecoder::setConfig(
     {
         int *pDecSceneMode = (int *)params;
         mDecSceneMode = *pDecSceneMode;
-        if(mDecSceneMode == 3)
+        if(mDecSceneMode == 3) {
             mChangeToSwDec = true;
+            setVspPriority(SprdVspScheduler::kPriorityRealtime);
+        }
 #ifdef CONFIG_AFBC_SUPPORT
         if(mDecSceneMode == 4) {
             mUsage = GRALLOC_USAGE_CURSOR | GRALLOC_USAGE_SW_WRITE_NEVER;
@@ -1256,13 +1282,13 @@ OMX_ERRORTYPE SPRDAVCDecoder::setConfig(
 
 void SPRDAVCDecoder::dump_strm(uint8 *pBuffer, int32 aInBufSize) {
     if(mDumpStrmEnabled) {
-        fwrite(pBuffer,1,aInBufSize,mFile_bs);
+        mFile_bs->write(pBuffer, aInBufSize);
     }
 }
 
 void SPRDAVCDecoder::dump_yuv(uint8 *pBuffer, int32 aInBufSize) {
     if(mDumpYUVEnabled) {
-        fwrite(pBuffer,1,aInBufSize,mFile_yuv);
+        mFile_yuv->write(pBuffer, aInBufSize);
     }
 }
 
@@ -1287,6 +1313,7 @@ void SPRDAVCDecoder::onQueueFilled(OMX_U32 portIndex) {
     if(mChangeToSwDec) {
 
         mChangeToSwDec = false;
+        mMetrics.count(SprdCodecMetrics::kCounterSwFallbacks);
 
         ALOGI("%s, %d, change to sw decoder, mThumbnailMode: %d",
               __FUNCTION__, __LINE__, mThumbnailMode);
@@ -1294,6 +1321,9 @@ void SPRDAVCDecoder::onQueueFilled(OMX_U32 portIndex) {
         if (mIOMMUEnabled && (!mIsInterlacedSequence || !mNeedDeinterlace || mThumbnailMode)) {
             freeOutputBufferIOVA();
         }
+        if (mIOMMUEnabled && mAllocInput) {
+            freeInputBufferIOVA();
+        }
 
         releaseDecoder();
         if(3 == mDecSceneMode){// for VoLTE mode
@@ -1315,6 +1345,7 @@ void SPRDAVCDecoder::onQueueFilled(OMX_U32 portIndex) {
         }
 
         mDecoderSwFlag = true;
+        disableVspScheduling();
 
         if(initDecoder() != OK) {
             ALOGE("onQueueFilled, init sw decoder failed.");
@@ -1329,8 +1360,8 @@ void SPRDAVCDecoder::onQueueFilled(OMX_U32 portIndex) {
         }
     }
 
-    List<BufferInfo *> &inQueue = getPortQueue(kInputPortIndex);
-    List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
+    PortQueue &inQueue = getPortQueue(kInputPortIndex);
+    PortQueue &outQueue = getPortQueue(kOutputPortIndex);
 
     while (!mStopDecode && (mEOSStatus != INPUT_DATA_AVAILABLE || !inQueue.empty())
             && (outQueue.size() != 0 || (mDeintl && !mDecOutputBufQueue.empty()))) {
@@ -1348,18 +1379,14 @@ void SPRDAVCDecoder::onQueueFilled(OMX_U32 portIndex) {
         OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
 
         OMX_BUFFERHEADERTYPE *outHeader = NULL;
-        List<BufferInfo *>::iterator itBuffer;
         BufferCtrlStruct *pBufCtrl = NULL;
         size_t count = 0;
         uint32_t queueSize = 0;
 
         {
             Mutex::Autolock autoLock(mThreadLock);
-            if (mDeintl) {
-                itBuffer = mDecOutputBufQueue.begin();
-            } else {
-                itBuffer = outQueue.begin();
-            }
+            List<BufferInfo *>::iterator itNode = mDecOutputBufQueue.begin();
+            PortQueue::iterator itBuffer = outQueue.begin();
 
             do {
                 if (mDeintl) {
@@ -1369,11 +1396,15 @@ void SPRDAVCDecoder::onQueueFilled(OMX_U32 portIndex) {
                 }
 
                 if(count >= queueSize) {
-                    ALOGI("onQueueFilled, get outQueue buffer, return, count=%zd, queue_size=%d",count, queueSize);
+                    SPRD_FRAME_LOGI("onQueueFilled, get outQueue buffer, return, count=%zd, queue_size=%d",count, queueSize);
                     return;
                 }
 
-                outHeader = (*itBuffer)->mHeader;
+                if (mDeintl) {
+                    outHeader = (*itNode++)->mHeader;
+                } else {
+                    outHeader = (*itBuffer++)->mHeader;
+                }
                 pBufCtrl= (BufferCtrlStruct*)(outHeader->pOutputPortPrivate);
                 if(pBufCtrl == NULL) {
                     ALOGE("onQueueFilled, pBufCtrl == NULL, fail");
@@ -1382,11 +1413,10 @@ void SPRDAVCDecoder::onQueueFilled(OMX_U32 portIndex) {
                     return;
                 }
 
-                itBuffer++;
                 count++;
             } while (pBufCtrl->iRefCount > 0);
         }
-        ALOGI("%s, %d, outHeader:%p, inHeader: %p, len: %d, nOffset: %d, time: %lld, EOS: %d",
+        SPRD_FRAME_LOGI("%s, %d, outHeader:%p, inHeader: %p, len: %d, nOffset: %d, time: %lld, EOS: %d",
               __FUNCTION__, __LINE__,outHeader,inHeader, inHeader->nFilledLen,
               inHeader->nOffset, inHeader->nTimeStamp,inHeader->nFlags & OMX_BUFFERFLAG_EOS);
 
@@ -1435,7 +1465,19 @@ void SPRDAVCDecoder::onQueueFilled(OMX_U32 portIndex) {
             }
         }
 
-        if (!mSecureFlag) {
+        // Buffers we allocated ourselves are handed to the engine as they
+        // are; anything that needs rewriting or lives in client memory goes
+        // through the stream buffer.
+        unsigned long inPhyAddr = 0;
+        if (mAllocInput && !mDecoderSwFlag && !mThumbnailMode
+                && bitstream == inHeader->pBuffer + inHeader->nOffset) {
+            inPhyAddr = getInputStreamAddr(inHeader);
+        }
+
+        if (inPhyAddr != 0) {
+            dec_in.pStream = bitstream;
+            dec_in.pStream_phy = inPhyAddr;
+        } else if (!mSecureFlag) {
             dec_in.pStream = mPbuf_stream_v;
             dec_in.pStream_phy = mPbuf_stream_p;
         } else {
@@ -1451,7 +1493,7 @@ void SPRDAVCDecoder::onQueueFilled(OMX_U32 portIndex) {
 
         dec_out.frameEffective = 0;
 
-        if (!mSecureFlag) {
+        if (!mSecureFlag && inPhyAddr == 0) {
             if(mThumbnailMode) {
                 uint32_t  iIndex = 0;
                 uint32_t  iRemainedBitstream;
@@ -1484,6 +1526,7 @@ void SPRDAVCDecoder::onQueueFilled(OMX_U32 portIndex) {
 
             if (mPbuf_stream_v != NULL) {
                 memcpy(mPbuf_stream_v + add_startcode_len, bitstream, copyLen);
+                mMetrics.count(SprdCodecMetrics::kCounterCopyBytes, copyLen);
             }
 
             dec_in.dataLen = copyLen + add_startcode_len;
@@ -1553,13 +1596,15 @@ void SPRDAVCDecoder::onQueueFilled(OMX_U32 portIndex) {
             }
         }
 
-        dump_strm(mPbuf_stream_v, dec_in.dataLen);
+        dump_strm(inPhyAddr != 0 ? bitstream : mPbuf_stream_v, dec_in.dataLen);
 
-        int64_t start_decode = systemTime();
-        MMDecRet decRet = (*mH264DecDecode)(mHandle, &dec_in,&dec_out);
-        int64_t end_decode = systemTime();
-        ALOGI("%s, %d, decRet: %d, %dms, dec_out.frameEffective: %d, needIVOP: %d, in {%p, 0x%lx}, consume byte: %u, flag:0x%x, SPS:%d, PPS:%d, pts:%lld",
-              __FUNCTION__, __LINE__, decRet, (unsigned int)((end_decode-start_decode) / 1000000L),
+        MMDecRet decRet;
+        {
+            HardwareSection section(this);
+            decRet = (*mH264DecDecode)(mHandle, &dec_in,&dec_out);
+        }
+        SPRD_FRAME_LOGI("%s, %d, decRet: %d, %dms, dec_out.frameEffective: %d, needIVOP: %d, in {%p, 0x%lx}, consume byte: %u, flag:0x%x, SPS:%d, PPS:%d, pts:%lld",
+              __FUNCTION__, __LINE__, decRet, (unsigned int)(mMetrics.lastUs(SprdCodecMetrics::kHistogramEngineTime) / 1000),
               dec_out.frameEffective, mNeedIVOP, dec_in.pStream, dec_in.pStream_phy, dec_in.dataLen, inHeader->nFlags,dec_out.sawSPS,dec_out.sawPPS, dec_out.pts);
 
         mDecoderSawSPS = dec_out.sawSPS;
@@ -1575,6 +1620,7 @@ void SPRDAVCDecoder::onQueueFilled(OMX_U32 portIndex) {
             mNeedIVOP = false;
         } else {
             mNeedIVOP = true;
+            mMetrics.count(SprdCodecMetrics::kCounterErrors);
             if (decRet == MMDEC_MEMORY_ERROR) {
                 ALOGE("failed to allocate memory.");
                 if (mDecoderSwFlag) {
@@ -1801,25 +1847,21 @@ bool SPRDAVCDecoder::handleCropRectEvent(const CropParams *crop) {
 
 void SPRDAVCDecoder::drainOneOutputBuffer(int32_t picId, void* pBufferHeader, uint64 pts) {
 
-    List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
+    PortQueue &outQueue = getPortQueue(kOutputPortIndex);
 
-    List<BufferInfo *>::iterator it = outQueue.begin();
-    while ((*it)->mHeader != (OMX_BUFFERHEADERTYPE*)pBufferHeader && it != outQueue.end()) {
-        ++it;
-    }
-    CHECK((*it)->mHeader == (OMX_BUFFERHEADERTYPE*)pBufferHeader);
+    BufferInfo *outInfo = findBufferInfo(kOutputPortIndex, (OMX_BUFFERHEADERTYPE*)pBufferHeader);
+    CHECK(outInfo != NULL && outInfo->mQueued);
 
-    BufferInfo *outInfo = *it;
     OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
 
     outHeader->nFilledLen = mPictureSize;
     outHeader->nTimeStamp = (OMX_TICKS)pts;
 
-    ALOGI("%s, %d, outHeader: %p, outHeader->pBuffer: %p, outHeader->nOffset: %d, outHeader->nFlags: %d, outHeader->nTimeStamp: %lld",
+    SPRD_FRAME_LOGI("%s, %d, outHeader: %p, outHeader->pBuffer: %p, outHeader->nOffset: %d, outHeader->nFlags: %d, outHeader->nTimeStamp: %lld",
           __FUNCTION__, __LINE__, outHeader , outHeader->pBuffer, outHeader->nOffset, outHeader->nFlags, outHeader->nTimeStamp);
 
     outInfo->mOwnedByUs = false;
-    outQueue.erase(it);
+    outQueue.erase(outInfo);
     outInfo = NULL;
 
     BufferCtrlStruct* pOutBufCtrl= (BufferCtrlStruct*)(outHeader->pOutputPortPrivate);
@@ -1830,10 +1872,9 @@ void SPRDAVCDecoder::drainOneOutputBuffer(int32_t picId, void* pBufferHeader, ui
 bool SPRDAVCDecoder::drainAllOutputBuffers() {
     ALOGI("%s, %d", __FUNCTION__, __LINE__);
 
-    List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
+    PortQueue &outQueue = getPortQueue(kOutputPortIndex);
     BufferInfo *outInfo;
     List<BufferInfo *>::iterator it;
-    List<BufferInfo *>::iterator it_end;
     OMX_BUFFERHEADERTYPE *outHeader;
 
     int32_t picId;
@@ -1849,25 +1890,24 @@ bool SPRDAVCDecoder::drainAllOutputBuffers() {
             return false;
         }
 
-        if(mDeintl) {
-            it = mDecOutputBufQueue.begin();
-            it_end = mDecOutputBufQueue.end();
-        } else {
-            it = outQueue.begin();
-            it_end = outQueue.end();
-        }
+        it = mDecOutputBufQueue.begin();
 
         if (mHeadersDecoded && MMDEC_OK == (*mH264Dec_GetLastDspFrm)(mHandle, &pBufferHeader, &picId, &pts) ) {
-            while ((*it)->mHeader != (OMX_BUFFERHEADERTYPE*)pBufferHeader && it != it_end) {
-                ++it;
+            if(mDeintl) {
+                while ((*it)->mHeader != (OMX_BUFFERHEADERTYPE*)pBufferHeader && it != mDecOutputBufQueue.end()) {
+                    ++it;
+                }
+                CHECK((*it)->mHeader == (OMX_BUFFERHEADERTYPE*)pBufferHeader);
+                outInfo = *it;
+            } else {
+                outInfo = findBufferInfo(kOutputPortIndex, (OMX_BUFFERHEADERTYPE*)pBufferHeader);
+                CHECK(outInfo != NULL && outInfo->mQueued);
             }
-            CHECK((*it)->mHeader == (OMX_BUFFERHEADERTYPE*)pBufferHeader);
-            outInfo = *it;
             outHeader = outInfo->mHeader;
             outHeader->nFilledLen = mPictureSize;
 
         } else {
-            outInfo = *it;
+            outInfo = mDeintl ? *it : *outQueue.begin();
             outHeader = outInfo->mHeader;
             outHeader->nTimeStamp = 0;
             outHeader->nFilledLen = 0;
@@ -1886,7 +1926,7 @@ bool SPRDAVCDecoder::drainAllOutputBuffers() {
                  mDecOutputBufQueue.erase(it);
             }
         } else {
-            outQueue.erase(it);
+            outQueue.erase(outInfo);
             outInfo->mOwnedByUs = false;
             BufferCtrlStruct* pOutBufCtrl= (BufferCtrlStruct*)(outHeader->pOutputPortPrivate);
             pOutBufCtrl->iRefCount++;
@@ -2022,6 +2062,33 @@ void  SPRDAVCDecoder::DrainOneOutputBuffercallback(void* decoder, int32_t picId,
     return static_cast<SPRDAVCDecoder *>(decoder)->drainOneOutputBuffer(picId, pBufferHeader, pts);
 }
 
+// static
+int SPRDAVCDecoder::IonArenaMapWrapper(
+    void *cookie, int fd, unsigned long *iova, size_t *size) {
+    SPRDAVCDecoder *decoder = static_cast<SPRDAVCDecoder *>(cookie);
+    return (*decoder->mH264DecGetIOVA)(decoder->mHandle, fd, iova, size);
+}
+
+// static
+void SPRDAVCDecoder::IonArenaUnmapWrapper(
+    void *cookie, unsigned long iova, size_t size) {
+    SPRDAVCDecoder *decoder = static_cast<SPRDAVCDecoder *>(cookie);
+    (*decoder->mH264DecFreeIOVA)(decoder->mHandle, iova, size);
+}
+
+SprdIonArena *SPRDAVCDecoder::getIonArena() {
+    if (mIonArena == NULL) {
+        if (mIOMMUEnabled) {
+            mIonArena = new SprdIonArena("avc_dec", ION_HEAP_ID_MASK_SYSTEM,
+                    IonArenaMapWrapper, IonArenaUnmapWrapper, this);
+        } else {
+            unsigned int memory_type = mSecureFlag ? ION_HEAP_ID_MASK_MM | ION_FLAG_SECURE : ION_HEAP_ID_MASK_MM;
+            mIonArena = new SprdIonArena("avc_dec", memory_type, NULL, NULL, this);
+        }
+    }
+    return mIonArena;
+}
+
 int SPRDAVCDecoder::VSP_malloc_cb(unsigned int size_extra) {
 
     ALOGI("%s, %d, mDecoderSwFlag: %d, mPictureSize: %d, size_extra: %d",
@@ -2055,52 +2122,32 @@ int SPRDAVCDecoder::VSP_malloc_cb(unsigned int size_extra) {
         extra_mem[SW_CACHABLE].common_buffer_ptr_phy = 0;
         extra_mem[SW_CACHABLE].size = size_extra;
     } else {
-        mPbuf_mbinfo_idx = 0;
+        // A new sequence: the engine is done with the previous extra and
+        // mbinfo buffers, so their arena space is handed out again.
+        SprdIonArena *arena = getIonArena();
+        arena->reset();
 
-        if (mPbuf_extra_v != NULL) {
-            if (mIOMMUEnabled) {
-                (*mH264DecFreeIOVA)(mHandle, mPbuf_extra_p, mPbuf_extra_size);
-            }
-            mPmem_extra.clear();
-            mPbuf_extra_v = NULL;
-            mPbuf_extra_p = 0;
-            mPbuf_extra_size = 0;
+        for (int i = 0; i < 17; i++) {
+            mPbuf_mbinfo_v[i] = NULL;
+            mPbuf_mbinfo_p[i] = 0;
+            mPbuf_mbinfo_size[i] = 0;
         }
+        mPbuf_mbinfo_idx = 0;
 
-        if (mIOMMUEnabled) {
-            mPmem_extra = new MemIon(SPRD_ION_DEV, size_extra, MemIon::NO_CACHING, ION_HEAP_ID_MASK_SYSTEM);
-        } else {
-            unsigned int memory_type = mSecureFlag ? ION_HEAP_ID_MASK_MM | ION_FLAG_SECURE : ION_HEAP_ID_MASK_MM;
-            mPmem_extra = new MemIon(SPRD_ION_DEV, size_extra, MemIon::NO_CACHING, memory_type);
+        SprdIonArena::Region region;
+        if (arena->alloc(size_extra, &region) != OK) {
+            ALOGE("%s: unable to allocate extra buffer", __FUNCTION__);
+            return -1;
         }
-        int fd = mPmem_extra->getHeapID();
-        if(fd >= 0) {
-            int ret;
-            unsigned long phy_addr;
-            size_t buffer_size;
-
-            if (mIOMMUEnabled) {
-                ret = (*mH264DecGetIOVA)(mHandle, fd, &phy_addr, &buffer_size);
-            } else {
-                ret = mPmem_extra->get_phy_addr_from_ion(&phy_addr, &buffer_size);
-            }
-            if(ret < 0) {
-                ALOGE ("mPmem_extra: get phy addr fail %d(%s)", ret, strerror(errno));
-                return -1;
-            }
 
-            mPbuf_extra_p =phy_addr;
-            mPbuf_extra_size = buffer_size;
-            mPbuf_extra_v = (uint8_t *)mPmem_extra->getBase();
-            ALOGI("pmem 0x%lx - %p - %zd", mPbuf_extra_p, mPbuf_extra_v, mPbuf_extra_size);
+        mPbuf_extra_p = region.mPhy;
+        mPbuf_extra_size = region.mSize;
+        mPbuf_extra_v = region.mVirt;
+        ALOGI("pmem 0x%lx - %p - %zd", mPbuf_extra_p, mPbuf_extra_v, mPbuf_extra_size);
 
-            extra_mem[HW_NO_CACHABLE].common_buffer_ptr = mPbuf_extra_v;
-            extra_mem[HW_NO_CACHABLE].common_buffer_ptr_phy = mPbuf_extra_p;
-            extra_mem[HW_NO_CACHABLE].size = size_extra;
-        } else {
-            ALOGE ("mPmem_extra: getHeapID fail %d", fd);
-            return -1;
-        }
+        extra_mem[HW_NO_CACHABLE].common_buffer_ptr = mPbuf_extra_v;
+        extra_mem[HW_NO_CACHABLE].common_buffer_ptr_phy = mPbuf_extra_p;
+        extra_mem[HW_NO_CACHABLE].size = size_extra;
     }
 
     (*mH264DecMemInit)(((SPRDAVCDecoder *)this)->mHandle, extra_mem);
@@ -2116,49 +2163,28 @@ int SPRDAVCDecoder::VSP_malloc_mbinfo_cb(unsigned int size_mbinfo, unsigned long
 
     ALOGI("%s, %d, idx: %d, size_mbinfo: %d", __FUNCTION__, __LINE__, idx, size_mbinfo);
 
-    if (mPbuf_mbinfo_v[idx] != NULL) {
-        if (mIOMMUEnabled) {
-            (*mH264DecFreeIOVA)(mHandle, mPbuf_mbinfo_p[idx], mPbuf_mbinfo_size[idx]);
-        }
-        mPmem_mbinfo[idx].clear();
-        mPbuf_mbinfo_v[idx] = NULL;
-        mPbuf_mbinfo_p[idx] = 0;
-        mPbuf_mbinfo_size[idx] = 0;
-    }
-
-    if (mIOMMUEnabled) {
-        mPmem_mbinfo[idx] = new MemIon(SPRD_ION_DEV, size_mbinfo, MemIon::NO_CACHING, ION_HEAP_ID_MASK_SYSTEM);
-    } else {
-        unsigned int memory_type = mSecureFlag ? ION_HEAP_ID_MASK_MM | ION_FLAG_SECURE : ION_HEAP_ID_MASK_MM;
-        mPmem_mbinfo[idx] = new MemIon(SPRD_ION_DEV, size_mbinfo, MemIon::NO_CACHING, memory_type);
+    if (idx >= 17) {
+        ALOGE("%s: too many mbinfo buffers", __FUNCTION__);
+        return -1;
     }
-    int fd = mPmem_mbinfo[idx]->getHeapID();
-    if(fd >= 0) {
-        int ret;
-        unsigned long phy_addr;
-        size_t buffer_size;
 
-        if (mIOMMUEnabled) {
-            ret = (*mH264DecGetIOVA)(mHandle, fd, &phy_addr, &buffer_size);
-        } else {
-            ret = mPmem_mbinfo[idx]->get_phy_addr_from_ion(&phy_addr, &buffer_size);
-        }
-        if(ret < 0) {
-            ALOGE ("mPmem_mbinfo[%d]: get phy addr fail %d(%s)", idx, ret, strerror(errno));
+    // Slots are only handed out once per sequence, but a slot that is
+    // requested again keeps its region if it is still large enough.
+    if (mPbuf_mbinfo_v[idx] == NULL || mPbuf_mbinfo_size[idx] < size_mbinfo) {
+        SprdIonArena::Region region;
+        if (getIonArena()->alloc(size_mbinfo, &region) != OK) {
+            ALOGE("mbinfo[%d]: unable to allocate %u bytes", idx, size_mbinfo);
             return -1;
         }
 
-        mPbuf_mbinfo_p[idx] =phy_addr;
-        mPbuf_mbinfo_size[idx] = buffer_size;
-        mPbuf_mbinfo_v[idx] = (uint8_t *)mPmem_mbinfo[idx]->getBase();
+        mPbuf_mbinfo_p[idx] = region.mPhy;
+        mPbuf_mbinfo_size[idx] = region.mSize;
+        mPbuf_mbinfo_v[idx] = region.mVirt;
         ALOGI("pmem 0x%lx - %p - %zd", mPbuf_mbinfo_p[idx], mPbuf_mbinfo_v[idx], mPbuf_mbinfo_size[idx]);
-
-        *pPhyAddr = phy_addr;
-    } else {
-        ALOGE ("mPmem_mbinfo[%d]: getHeapID fail %d", idx, fd);
-        return -1;
     }
 
+    *pPhyAddr = mPbuf_mbinfo_p[idx];
+
     mPbuf_mbinfo_idx++;
 
     return 0;
@@ -2223,6 +2249,8 @@ OMX_ERRORTYPE SPRDAVCDecoder::getExtensionIndex(
     } else if (!strcmp(name, SPRD_INDEX_PARAM_PREPARE_APB)) {
         *index = (OMX_INDEXTYPE) OMX_IndexParamPrepareForAdaptivePlayback;
         return OMX_ErrorNone;
+    } else if (!strcmp(name, SPRD_INDEX_CONFIG_CODEC_METRICS)) {
+        return SprdSimpleOMXComponent::getExtensionIndex(name, index);
     }
     return OMX_ErrorNotImplemented;
 }
@@ -2370,41 +2398,81 @@ bool SPRDAVCDecoder::openDecoder(const char* libName) {
     return true;
 }
 
+// Keeps a copy of codec config that will be fed again after a flush; the
+// buffer only ever grows, so a stream with large parameter sets is copied
+// in full rather than dropped.
+static bool storeCodecConfig(uint8_t **data, uint32_t *capacity, uint32_t *size,
+        const uint8_t *src, uint32_t srcSize) {
+    if (srcSize > *capacity) {
+        uint8_t *grown = (uint8_t *)realloc(*data, srcSize);
+        if (grown == NULL) {
+            ALOGE("%s, failed to grow config buffer to %u", __FUNCTION__, srcSize);
+            return false;
+        }
+        *data = grown;
+        *capacity = srcSize;
+    }
+    memcpy(*data, src, srcSize);
+    *size = srcSize;
+    return true;
+}
+
 void SPRDAVCDecoder::findCodecConfigData(OMX_BUFFERHEADERTYPE *header) {
-        int nal_type, nal_ref_idc;
         int ret;
         uint8 *p = header->pBuffer + header->nOffset;
+        const uint8_t *nal;
+        size_t nalSize;
 
-        MMDecRet decRet = (*mH264DecGetNALType)(mHandle, p, header->nFilledLen, &nal_type, &nal_ref_idc);
+        // Only the NAL header is needed here, so look at it directly
+        // instead of going through the engine.
+        SprdNalIterator iter(p, header->nFilledLen);
+        if (!iter.next(&nal, &nalSize)) {
+            return;
+        }
+        int nal_type = SprdAvcNalType(nal);
 
         ALOGI("%s, header:%p, nal_type:%d, nal_ref_idc:%d, mSPSDataSize:%u, mPPSDataSize:%u",
-              __FUNCTION__, header, nal_type, nal_ref_idc, mSPSDataSize, mPPSDataSize);
-
-        if (decRet == MMDEC_OK) {
-            if (nal_type == 0x7/*SPS*/ &&
-                header->nFilledLen <= H264_HEADER_SIZE) {
-                mSPSDataSize = header->nFilledLen;
-                memcpy(mSPSData, p, mSPSDataSize);
-                if (!mCapability.support_1080i) {
-                    if ((ret = isInterlacedSequence(mSPSData, mSPSDataSize)) != 0) {
-                        if(!mDecoderSwFlag) {
-                            mChangeToSwDec = true;
-                            mIsInterlacedSequence = true;
-                            if (ret == 1){
-                                mNeedDeinterlace = true;
-                            }
+              __FUNCTION__, header, nal_type, (nal[0] >> 5) & 0x3, mSPSDataSize, mPPSDataSize);
+
+        if (nal_type == kAvcNalSps) {
+            storeCodecConfig(&mSPSData, &mSPSDataCapacity, &mSPSDataSize,
+                    p, header->nFilledLen);
+            if (!mCapability.support_1080i) {
+                if ((ret = isInterlacedSequence(p, header->nFilledLen)) != 0) {
+                    if(!mDecoderSwFlag) {
+                        mChangeToSwDec = true;
+                        mIsInterlacedSequence = true;
+                        if (ret == 1){
+                            mNeedDeinterlace = true;
                         }
                     }
                 }
-                if ((*mH264DecInitStructForNewSeq)(mHandle) != MMDEC_OK) {
-                    ALOGE("Failed to InitStructForNewSeq");
-                }
-            } else if (nal_type == 0x8/*PPS*/ &&
-                           header->nFilledLen <= H264_HEADER_SIZE) {
-                mPPSDataSize = header->nFilledLen;
-                memcpy(mPPSData, p, mPPSDataSize);
+            }
+            if ((*mH264DecInitStructForNewSeq)(mHandle) != MMDEC_OK) {
+                ALOGE("Failed to InitStructForNewSeq");
+            }
+        } else if (nal_type == kAvcNalPps) {
+            storeCodecConfig(&mPPSData, &mPPSDataCapacity, &mPPSDataSize,
+                    p, header->nFilledLen);
+        }
+}
+
+void SPRDAVCDecoder::freeInputBufferIOVA() {
+    PortInfo *port = editPortInfo(OMX_DirInput);
+
+    for (size_t i = 0; i < port->mBuffers.size(); ++i) {
+        BufferInfo *buffer = &port->mBuffers.editItemAt(i);
+        OMX_BUFFERHEADERTYPE *header = buffer->mHeader;
+
+        if(header->pInputPortPrivate != NULL) {
+            BufferCtrlStruct *pBufCtrl = (BufferCtrlStruct*)(header->pInputPortPrivate);
+            if (pBufCtrl->phyAddr > 0) {
+                ALOGI("%s, fd: %d, iova: 0x%lx", __FUNCTION__, pBufCtrl->bufferFd, pBufCtrl->phyAddr);
+                (*mH264DecFreeIOVA)(mHandle, pBufCtrl->phyAddr, pBufCtrl->bufferSize);
+                pBufCtrl->phyAddr = 0;
             }
         }
+    }
 }
 
 void SPRDAVCDecoder::freeOutputBufferIOVA() {
@@ -2436,6 +2504,7 @@ OMX_ERRORTYPE SPRDAVCDecoder::allocateDecOutputBuffer(H264SwDecInfo* pDecoderInf
         header->nAllocLen = mPictureSize;
         header->nFilledLen = 0;
         header->nOffset = 0;
+        header->pPlatformPrivate = NULL;
         header->pOutputPortPrivate = NULL;
         header->pMarkData = NULL;
         header->nTickCount = 0;
@@ -2460,6 +2529,7 @@ OMX_ERRORTYPE SPRDAVCDecoder::allocateDecOutputBuffer(H264SwDecInfo* pDecoderInf
             delete header;
             header = NULL;
             ALOGE("Failed to alloc outport pmem buffer");
+            delete pMem;
             return OMX_ErrorInsufficientResources;
         }
 
@@ -2477,6 +2547,7 @@ OMX_ERRORTYPE SPRDAVCDecoder::allocateDecOutputBuffer(H264SwDecInfo* pDecoderInf
             delete header;
             header = NULL;
             ALOGE("%s, get phy addr Failed: %d(%s)", __FUNCTION__, ret, strerror(errno));
+            delete pMem;
             return OMX_ErrorInsufficientResources;
         }
 
@@ -2634,7 +2705,7 @@ bool SPRDAVCDecoder::drainAllDecOutputBufferforDeintl() {
 }
 
 void SPRDAVCDecoder::signalDeintlThread() {
-    List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
+    PortQueue &outQueue = getPortQueue(kOutputPortIndex);
     if (mDeinterInputBufQueue.size() > 1 && !outQueue.empty()) {
         ALOGI("%s, %d,  send mDeinterReadyCondition signal\n", __FUNCTION__, __LINE__);
         mDeintl->mDeinterReadyCondition.signal();
@@ -18,8 +18,10 @@
 #define SPRD_AVC_DECODER_H_
 
 #include "SprdSimpleOMXComponent.h"
+#include "SprdDumpWriter.h"
 #include <utils/KeyedVector.h>
 #include "MemIon.h"
+#include "SprdIonArena.h"
 #include "avc_dec_api.h"
 #include "SPRDDeinterlace.h"
 #include <VideoAPI.h>
@@ -28,7 +30,7 @@
 
 #define H264_DECODER_INTERNAL_BUFFER_SIZE (0x100000)
 #define H264_DECODER_STREAM_BUFFER_SIZE (1024*1024*2)
-#define H264_HEADER_SIZE (1024)
+#define H264_HEADER_SIZE (1024)  // initial size of the SPS/PPS copies
 
 struct tagAVCHandle;
 
@@ -143,12 +145,11 @@ private:
     unsigned long mPbuf_stream_p;
     size_t mPbuf_stream_size;
 
-    sp<MemIon> mPmem_extra;
+    SprdIonArena *mIonArena;
     uint8_t *mPbuf_extra_v;
     unsigned long  mPbuf_extra_p;
     size_t  mPbuf_extra_size;
 
-    sp<MemIon> mPmem_mbinfo[17];
     uint8_t *mPbuf_mbinfo_v[17];
     unsigned long  mPbuf_mbinfo_p[17];
     size_t  mPbuf_mbinfo_size[17];
@@ -158,8 +159,10 @@ private:
     bool mDecoderSawPPS;
     uint8_t *mSPSData;
     uint32_t mSPSDataSize;
+    uint32_t mSPSDataCapacity;
     uint8_t *mPPSData;
     uint32_t mPPSDataSize;
+    uint32_t mPPSDataCapacity;
     bool mIsResume;
     bool mSecureFlag;
     bool mAllocInput;
@@ -191,8 +194,8 @@ private:
     OMX_BOOL iUseAndroidNativeBuffer[2];
     MMDecCapability mCapability;
 
-    FILE* mFile_yuv;
-    FILE* mFile_bs;
+    SprdDumpWriter *mFile_yuv;
+    SprdDumpWriter *mFile_bs;
 
     OMX_ERRORTYPE mInitCheck;
 
@@ -208,17 +211,21 @@ private:
     static int32_t MbinfoMemAllocWrapper(void* aUserData, unsigned int size_mbinfo, unsigned long *pPhyAddr);
     static int32_t ExtMemAllocWrapper(void* aUserData, unsigned int size_extra);
     static int32_t BindFrameWrapper(void *aUserData, void *pHeader);
+    static int IonArenaMapWrapper(void *cookie, int fd, unsigned long *iova, size_t *size);
+    static void IonArenaUnmapWrapper(void *cookie, unsigned long iova, size_t size);
     static int32_t UnbindFrameWrapper(void *aUserData, void *pHeader);
     static void  DrainOneOutputBuffercallback(void* decoder, int32_t picId, void* pBufferHeader, unsigned long long pts);
 
     int VSP_malloc_mbinfo_cb(unsigned int size_mbinfo, unsigned long *pPhyAddr);
     int VSP_malloc_cb(unsigned int size_extra);
+    SprdIonArena *getIonArena();
     int VSP_bind_cb(void *pHeader);
     int VSP_unbind_cb(void *pHeader);
     bool openDecoder(const char* libName);
     void findCodecConfigData(OMX_BUFFERHEADERTYPE *header);
     void dump_yuv(uint8 *pBuffer, int32 aInBufSize);
     void dump_strm(uint8 *pBuffer, int32 aInBufSize);
+    void freeInputBufferIOVA();
     void freeOutputBufferIOVA();
     bool outputBuffersNotEnough(const H264SwDecInfo *, OMX_U32 , OMX_U32 , OMX_BOOL);
     OMX_ERRORTYPE allocateDecOutputBuffer(H264SwDecInfo* pDecoderInfo);
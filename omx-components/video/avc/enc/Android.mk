@@ -38,6 +38,8 @@ LOCAL_SHARED_LIBRARIES := \
     liblog                     \
     libcutils
 
+LOCAL_STATIC_LIBRARIES := libsprd_colorconvert
+
 LOCAL_MODULE := libstagefright_sprd_h264enc
 LOCAL_MODULE_TAGS := optional
 LOCAL_PROPRIETARY_MODULE := true
@@ -62,11 +64,46 @@ ifeq ($(strip $(TARGET_BOARD_CAMERA_EIS)),true)
     LOCAL_CFLAGS += -DCONFIG_SPRD_RECORD_EIS
 endif
 
-ifeq ($(strip $(TARGET_BIA_SUPPORT)),true)
-    LOCAL_CFLAGS += -DCONFIG_BIA_SUPPORT
-endif
-
 ifeq ($(strip $(SUPPORT_RGB_ENC)),true)
     LOCAL_CFLAGS += -DCONFIG_RGB_ENC_SUPPORT
 endif
 include $(BUILD_SHARED_LIBRARY)
+
+# Host build against the engine, libmemion and libui of
+# omx-components/mock.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        SPRDAVCEncoder.cpp
+
+LOCAL_C_INCLUDES := \
+    frameworks/av/media/libstagefright/include                    \
+    frameworks/native/include/media/hardware                      \
+    frameworks/av/include                                     \
+    $(LOCAL_PATH)/../../../../libstagefrighthw/include            \
+    $(LOCAL_PATH)/../../../../libstagefrighthw/include/openmax    \
+    $(LOCAL_PATH)/../../../../../../external/kernel-headers
+
+LOCAL_C_INCLUDES += $(TOP)/vendor/sprd/external/drivers/gpu
+LOCAL_C_INCLUDES += $(TOP)/system/core/libion/kernel-headers
+
+LOCAL_CFLAGS := -DOSCL_EXPORT_REF= -DOSCL_IMPORT_REF=
+
+LOCAL_SHARED_LIBRARIES := \
+    libstagefright_foundation  \
+    libstagefrighthw           \
+    libutils                   \
+    libui                      \
+    libmemion                  \
+    liblog                     \
+    libcutils
+
+LOCAL_STATIC_LIBRARIES := libsprd_colorconvert
+
+LOCAL_LDLIBS := -ldl -lpthread
+
+LOCAL_MODULE := libstagefright_sprd_h264enc
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_SHARED_LIBRARY)
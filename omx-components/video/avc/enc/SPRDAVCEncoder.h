@@ -18,6 +18,9 @@
 #define SPRD_AVC_ENCODER_H_
 
 #include "SprdSimpleOMXComponent.h"
+#include "SprdDumpWriter.h"
+#include "SprdEncoderInputRing.h"
+#include "SprdIovaCache.h"
 
 #include "avc_enc_api.h"
 
@@ -50,6 +53,11 @@ struct SPRDAVCEncoder :  public SprdSimpleOMXComponent {
 protected:
     virtual ~SPRDAVCEncoder();
 
+    virtual void onReset();
+    virtual void onPortEnableCompleted(OMX_U32 portIndex, bool enabled);
+    virtual void onPortFlushPrepare(OMX_U32 portIndex);
+    virtual void onInputBufferArrived(OMX_BUFFERHEADERTYPE *header);
+
 private:
     enum {
         kNumBuffers = 4,
@@ -85,6 +93,7 @@ private:
     OMX_BOOL mStoreMetaData;
     OMX_BOOL mPrependSPSPPS;
     bool     mIOMMUEnabled;
+    SprdIovaCache *mIovaCache;
     int mIOMMUID;
     bool     mDumpYUVEnabled;
     bool     mDumpStrmEnabled;
@@ -98,10 +107,23 @@ private:
     bool     mUVExchange;
     uint8_t *mPbuf_inter;
 
-    sp<MemIon> mYUVInPmemHeap;
-    uint8_t *mPbuf_yuv_v;
-    unsigned long mPbuf_yuv_p;
-    size_t mPbuf_yuv_size;
+    // Staging buffer of the input ring and the frame prepared in it.
+    struct InputSlot {
+        InputSlot() : mVirt(NULL), mPhy(0), mSize(0) {}
+
+        sp<MemIon> mHeap;
+        uint8_t *mVirt;
+        unsigned long mPhy;
+        size_t mSize;
+        MMEncIn mIn;   // source address, format and crop
+    };
+
+    SprdEncoderInputRing *mInputRing;
+    InputSlot mInputSlots[SprdEncoderInputRing::kMaxSlots];
+
+    // The input ring thread maps and unmaps through the engine while the
+    // looper encodes; the engine takes neither call during an encode.
+    Mutex mEngineLock;
 
     sp<MemIon> mPmem_stream;
     uint8_t *mPbuf_stream_v;
@@ -146,8 +168,8 @@ private:
     MMEncVideoInfo mEncInfo;
     MMEncCapability mCapability;
 
-    FILE* mFile_yuv;
-    FILE* mFile_bs;
+    SprdDumpWriter *mFile_yuv;
+    SprdDumpWriter *mFile_bs;
 
     void initPorts();
     OMX_ERRORTYPE initEncParams();
@@ -159,6 +181,12 @@ private:
     static void FlushCacheWrapper(void* aUserData);
 
 
+    static int IovaCacheMapWrapper(void *cookie, int fd, unsigned long *iova, size_t *size);
+    static void IovaCacheUnmapWrapper(void *cookie, unsigned long iova, size_t size);
+
+    bool prepareInput(OMX_BUFFERHEADERTYPE *inHeader, InputSlot *slot);
+    static bool PrepareInputWrapper(void *cookie, OMX_BUFFERHEADERTYPE *header, int32_t slot);
+
     DISALLOW_EVIL_CONSTRUCTORS(SPRDAVCEncoder);
 };
 
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SprdBitstream.h"
+
+namespace android {
+
+SprdBitReader::SprdBitReader(const uint8_t *data, size_t size)
+    : mData(data),
+      mSize(size),
+      mOffset(0),
+      mStopByte(size),
+      mCache(0),
+      mCacheBits(0),
+      mZeros(0),
+      mOverflow(false) {
+    while (mStopByte > 0 && data[mStopByte - 1] == 0) {
+        --mStopByte;
+    }
+    if (mStopByte > 0) {
+        --mStopByte;
+    }
+}
+
+void SprdBitReader::refill() {
+    while (mCacheBits <= 56 && mOffset < mSize) {
+        uint8_t byte = mData[mOffset++];
+        if (mZeros >= 2 && byte == 3) {
+            // emulation_prevention_three_byte
+            mZeros = 0;
+            continue;
+        }
+        mZeros = byte == 0 ? mZeros + 1 : 0;
+        mCache |= (uint64_t)byte << (56 - mCacheBits);
+        mCacheBits += 8;
+    }
+}
+
+uint32_t SprdBitReader::getBits(uint32_t n) {
+    if (n == 0) {
+        return 0;
+    }
+    if (mCacheBits < n) {
+        refill();
+        if (mCacheBits < n) {
+            mOverflow = true;
+            mCache = 0;
+            mCacheBits = 0;
+            return 0;
+        }
+    }
+
+    uint32_t value = (uint32_t)(mCache >> (64 - n));
+    mCache <<= n;
+    mCacheBits -= n;
+    return value;
+}
+
+void SprdBitReader::skipBits(uint32_t n) {
+    while (n > 32) {
+        getBits(32);
+        n -= 32;
+    }
+    getBits(n);
+}
+
+uint32_t SprdBitReader::getUE() {
+    uint32_t zeros = 0;
+    while (getBit() == 0) {
+        if (mOverflow || ++zeros > 31) {
+            mOverflow = true;
+            return 0;
+        }
+    }
+    return ((1u << zeros) - 1) + getBits(zeros);
+}
+
+int32_t SprdBitReader::getSE() {
+    uint32_t code = getUE();
+    return (code & 1) ? (int32_t)((code >> 1) + 1) : -(int32_t)(code >> 1);
+}
+
+bool SprdBitReader::moreRbspData() {
+    refill();
+    if (mOffset <= mStopByte) {
+        // The cache is full and the stop bit is not even loaded yet.
+        return true;
+    }
+    // The stop bit is the last one set in the cache; anything before it
+    // is data.
+    return mCacheBits > 0 && mCache != 0 && mCache != (1ull << 63);
+}
+
+}  // namespace android
@@ -0,0 +1,670 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdParameterSets"
+#include <utils/Log.h>
+
+#include "SprdBitstream.h"
+
+#include <string.h>
+
+// Syntax element names follow ITU-T H.264 7.3.2 and H.265 7.3.2.
+
+namespace android {
+
+static void initVideoSignal(SprdVideoSignal *signal) {
+    signal->mFullRange = false;
+    signal->mPrimaries = 2;
+    signal->mTransfer = 2;
+    signal->mMatrixCoeffs = 2;
+}
+
+// aspect_ratio_info through video_signal_type, which both codecs share.
+static void parseVuiHead(SprdBitReader *br, uint32_t *sarWidth, uint32_t *sarHeight,
+        SprdVideoSignal *signal) {
+    static const uint8_t kSar[17][2] = {
+        { 0, 0 }, { 1, 1 }, { 12, 11 }, { 10, 11 }, { 16, 11 }, { 40, 33 },
+        { 24, 11 }, { 20, 11 }, { 32, 11 }, { 80, 33 }, { 18, 11 }, { 15, 11 },
+        { 64, 33 }, { 160, 99 }, { 4, 3 }, { 3, 2 }, { 2, 1 },
+    };
+
+    if (br->getBit()) {     // aspect_ratio_info_present_flag
+        uint32_t idc = br->getBits(8);
+        if (idc == 255) {   // Extended_SAR
+            *sarWidth = br->getBits(16);
+            *sarHeight = br->getBits(16);
+        } else if (idc < 17) {
+            *sarWidth = kSar[idc][0];
+            *sarHeight = kSar[idc][1];
+        }
+    }
+    if (br->getBit()) {     // overscan_info_present_flag
+        br->skipBits(1);    // overscan_appropriate_flag
+    }
+    if (br->getBit()) {     // video_signal_type_present_flag
+        br->skipBits(3);    // video_format
+        signal->mFullRange = br->getBit();
+        if (br->getBit()) { // colour_description_present_flag
+            signal->mPrimaries = br->getBits(8);
+            signal->mTransfer = br->getBits(8);
+            signal->mMatrixCoeffs = br->getBits(8);
+        }
+    }
+}
+
+static bool skipAvcScalingList(SprdBitReader *br, int size) {
+    int last = 8, next = 8;
+    for (int i = 0; i < size && next != 0; ++i) {
+        int32_t delta = br->getSE();
+        if (delta < -128 || delta > 127) {
+            return false;
+        }
+        next = (last + delta + 256) % 256;
+        last = next == 0 ? last : next;
+    }
+    return true;
+}
+
+static bool skipAvcScalingMatrices(SprdBitReader *br, int count) {
+    for (int i = 0; i < count; ++i) {
+        if (br->getBit() && !skipAvcScalingList(br, i < 6 ? 16 : 64)) {
+            return false;
+        }
+    }
+    return !br->overflowed();
+}
+
+static bool skipAvcHrd(SprdBitReader *br) {
+    uint32_t cpbCount = br->getUE() + 1;
+    if (cpbCount > 32) {
+        return false;
+    }
+    br->skipBits(8);        // bit_rate_scale, cpb_size_scale
+    for (uint32_t i = 0; i < cpbCount; ++i) {
+        br->getUE();        // bit_rate_value_minus1
+        br->getUE();        // cpb_size_value_minus1
+        br->skipBits(1);    // cbr_flag
+    }
+    br->skipBits(20);       // four delay/offset lengths
+    return !br->overflowed();
+}
+
+static bool parseAvcVui(SprdBitReader *br, SprdAvcSps *sps) {
+    parseVuiHead(br, &sps->mSarWidth, &sps->mSarHeight, &sps->mSignal);
+
+    if (br->getBit()) {     // chroma_loc_info_present_flag
+        br->getUE();
+        br->getUE();
+    }
+    if (br->getBit()) {     // timing_info_present_flag
+        sps->mNumUnitsInTick = br->getBits(32);
+        sps->mTimeScale = br->getBits(32);
+        sps->mFixedFrameRate = br->getBit();
+    }
+
+    bool nalHrd = br->getBit();
+    if (nalHrd && !skipAvcHrd(br)) {
+        return false;
+    }
+    bool vclHrd = br->getBit();
+    if (vclHrd && !skipAvcHrd(br)) {
+        return false;
+    }
+    if (nalHrd || vclHrd) {
+        br->skipBits(1);    // low_delay_hrd_flag
+    }
+    br->skipBits(1);        // pic_struct_present_flag
+
+    if (br->getBit()) {     // bitstream_restriction_flag
+        br->skipBits(1);    // motion_vectors_over_pic_boundaries_flag
+        br->getUE();        // max_bytes_per_pic_denom
+        br->getUE();        // max_bits_per_mb_denom
+        br->getUE();        // log2_max_mv_length_horizontal
+        br->getUE();        // log2_max_mv_length_vertical
+        sps->mMaxNumReorderFrames = br->getUE();
+        sps->mMaxDecFrameBuffering = br->getUE();
+    }
+    return !br->overflowed();
+}
+
+bool SprdParseAvcSps(const uint8_t *nal, size_t size, SprdAvcSps *sps) {
+    if (size < 4 || SprdAvcNalType(nal) != kAvcNalSps) {
+        return false;
+    }
+
+    memset(sps, 0, sizeof(*sps));
+    initVideoSignal(&sps->mSignal);
+    sps->mMaxNumReorderFrames = -1;
+    sps->mMaxDecFrameBuffering = -1;
+
+    SprdBitReader br(nal + 1, size - 1);
+
+    sps->mProfileIdc = br.getBits(8);
+    sps->mConstraintFlags = br.getBits(8);
+    sps->mLevelIdc = br.getBits(8);
+    sps->mSpsId = br.getUE();
+    if (sps->mSpsId > 31) {
+        return false;
+    }
+
+    sps->mChromaFormatIdc = 1;
+    sps->mBitDepthLuma = 8;
+    sps->mBitDepthChroma = 8;
+    switch (sps->mProfileIdc) {
+        case 100: case 110: case 122: case 244: case 44:
+        case 83: case 86: case 118: case 128: case 138:
+        case 139: case 134: case 135:
+            sps->mChromaFormatIdc = br.getUE();
+            if (sps->mChromaFormatIdc > 3) {
+                return false;
+            }
+            if (sps->mChromaFormatIdc == 3) {
+                sps->mSeparateColourPlane = br.getBit();
+            }
+            sps->mBitDepthLuma = br.getUE() + 8;
+            sps->mBitDepthChroma = br.getUE() + 8;
+            if (sps->mBitDepthLuma > 14 || sps->mBitDepthChroma > 14) {
+                return false;
+            }
+            br.skipBits(1); // qpprime_y_zero_transform_bypass_flag
+            sps->mScalingMatrixPresent = br.getBit();
+            if (sps->mScalingMatrixPresent
+                    && !skipAvcScalingMatrices(&br, sps->mChromaFormatIdc != 3 ? 8 : 12)) {
+                return false;
+            }
+            break;
+        default:
+            break;
+    }
+
+    sps->mLog2MaxFrameNum = br.getUE() + 4;
+    if (sps->mLog2MaxFrameNum > 16) {
+        return false;
+    }
+    sps->mPicOrderCntType = br.getUE();
+    if (sps->mPicOrderCntType == 0) {
+        sps->mLog2MaxPicOrderCntLsb = br.getUE() + 4;
+        if (sps->mLog2MaxPicOrderCntLsb > 16) {
+            return false;
+        }
+    } else if (sps->mPicOrderCntType == 1) {
+        br.skipBits(1);     // delta_pic_order_always_zero_flag
+        br.getSE();         // offset_for_non_ref_pic
+        br.getSE();         // offset_for_top_to_bottom_field
+        uint32_t cycle = br.getUE();
+        if (cycle > 255) {
+            return false;
+        }
+        for (uint32_t i = 0; i < cycle; ++i) {
+            br.getSE();     // offset_for_ref_frame
+        }
+    } else if (sps->mPicOrderCntType != 2) {
+        return false;
+    }
+
+    sps->mMaxNumRefFrames = br.getUE();
+    sps->mGapsInFrameNumAllowed = br.getBit();
+    sps->mWidthInMbs = br.getUE() + 1;
+    sps->mHeightInMapUnits = br.getUE() + 1;
+    sps->mFrameMbsOnly = br.getBit();
+    if (!sps->mFrameMbsOnly) {
+        sps->mMbAdaptiveFrameField = br.getBit();
+    }
+    sps->mDirect8x8Inference = br.getBit();
+
+    // Level 6.2 allows 139264 macroblocks; anything beyond 8192 on a side
+    // is corrupt.
+    if (sps->mWidthInMbs > 512 || sps->mHeightInMapUnits > 512) {
+        return false;
+    }
+    sps->mCodedWidth = sps->mWidthInMbs * 16;
+    sps->mCodedHeight = sps->mHeightInMapUnits * 16 * (sps->mFrameMbsOnly ? 1 : 2);
+
+    if (br.getBit()) {      // frame_cropping_flag
+        uint32_t chromaArrayType = sps->mSeparateColourPlane ? 0 : sps->mChromaFormatIdc;
+        uint32_t unitX = (chromaArrayType == 1 || chromaArrayType == 2) ? 2 : 1;
+        uint32_t unitY = (chromaArrayType == 1 ? 2 : 1) * (sps->mFrameMbsOnly ? 1 : 2);
+        sps->mCropLeft = br.getUE() * unitX;
+        sps->mCropRight = br.getUE() * unitX;
+        sps->mCropTop = br.getUE() * unitY;
+        sps->mCropBottom = br.getUE() * unitY;
+        if (sps->mCropLeft + sps->mCropRight >= sps->mCodedWidth
+                || sps->mCropTop + sps->mCropBottom >= sps->mCodedHeight) {
+            return false;
+        }
+    }
+
+    sps->mVuiPresent = br.getBit();
+    if (sps->mVuiPresent && !parseAvcVui(&br, sps)) {
+        // Some encoders write truncated VUI; what came before stands.
+        ALOGV("ignoring malformed VUI");
+        sps->mVuiPresent = false;
+        return true;
+    }
+
+    return !br.overflowed();
+}
+
+bool SprdParseAvcPps(const uint8_t *nal, size_t size, SprdAvcPps *pps,
+        uint32_t chromaFormatIdc) {
+    if (size < 2 || SprdAvcNalType(nal) != kAvcNalPps) {
+        return false;
+    }
+
+    memset(pps, 0, sizeof(*pps));
+    SprdBitReader br(nal + 1, size - 1);
+
+    pps->mPpsId = br.getUE();
+    pps->mSpsId = br.getUE();
+    if (pps->mPpsId > 255 || pps->mSpsId > 31) {
+        return false;
+    }
+    pps->mEntropyCodingMode = br.getBit();
+    pps->mBottomFieldPicOrderPresent = br.getBit();
+    pps->mNumSliceGroups = br.getUE() + 1;
+    if (pps->mNumSliceGroups > 8) {
+        return false;
+    }
+    if (pps->mNumSliceGroups > 1) {
+        uint32_t mapType = br.getUE();
+        if (mapType == 0) {
+            for (uint32_t i = 0; i < pps->mNumSliceGroups; ++i) {
+                br.getUE();     // run_length_minus1
+            }
+        } else if (mapType == 2) {
+            for (uint32_t i = 0; i + 1 < pps->mNumSliceGroups; ++i) {
+                br.getUE();     // top_left
+                br.getUE();     // bottom_right
+            }
+        } else if (mapType >= 3 && mapType <= 5) {
+            br.skipBits(1);     // slice_group_change_direction_flag
+            br.getUE();         // slice_group_change_rate_minus1
+        } else if (mapType == 6) {
+            uint32_t units = br.getUE() + 1;
+            uint32_t bits = 0;
+            while ((1u << bits) < pps->mNumSliceGroups) {
+                ++bits;
+            }
+            if (units > 139264) {
+                return false;
+            }
+            for (uint32_t i = 0; i < units; ++i) {
+                br.skipBits(bits);
+            }
+        } else if (mapType > 6) {
+            return false;
+        }
+    }
+
+    pps->mNumRefIdxL0Default = br.getUE() + 1;
+    pps->mNumRefIdxL1Default = br.getUE() + 1;
+    if (pps->mNumRefIdxL0Default > 32 || pps->mNumRefIdxL1Default > 32) {
+        return false;
+    }
+    pps->mWeightedPred = br.getBit();
+    pps->mWeightedBipredIdc = br.getBits(2);
+    pps->mPicInitQp = 26 + br.getSE();
+    pps->mPicInitQs = 26 + br.getSE();
+    pps->mChromaQpIndexOffset = br.getSE();
+    pps->mDeblockingFilterControlPresent = br.getBit();
+    pps->mConstrainedIntraPred = br.getBit();
+    pps->mRedundantPicCntPresent = br.getBit();
+    pps->mSecondChromaQpIndexOffset = pps->mChromaQpIndexOffset;
+
+    if (br.moreRbspData()) {
+        pps->mTransform8x8Mode = br.getBit();
+        pps->mScalingMatrixPresent = br.getBit();
+        if (pps->mScalingMatrixPresent) {
+            int count = 6 + (pps->mTransform8x8Mode ? (chromaFormatIdc != 3 ? 2 : 6) : 0);
+            if (!skipAvcScalingMatrices(&br, count)) {
+                return false;
+            }
+        }
+        pps->mSecondChromaQpIndexOffset = br.getSE();
+    }
+
+    return !br.overflowed();
+}
+
+static bool parseHevcProfileTierLevel(SprdBitReader *br, uint32_t maxSubLayers,
+        SprdHevcProfileTierLevel *ptl) {
+    ptl->mProfileSpace = br->getBits(2);
+    ptl->mTierFlag = br->getBit();
+    ptl->mProfileIdc = br->getBits(5);
+    ptl->mCompatibilityFlags = br->getBits(32);
+    ptl->mProgressiveSource = br->getBit();
+    ptl->mInterlacedSource = br->getBit();
+    br->skipBits(1);        // general_non_packed_constraint_flag
+    ptl->mFrameOnlyConstraint = br->getBit();
+    br->skipBits(44);       // general constraint and reserved bits
+    ptl->mLevelIdc = br->getBits(8);
+
+    bool profilePresent[8];
+    bool levelPresent[8];
+    for (uint32_t i = 0; i + 1 < maxSubLayers; ++i) {
+        profilePresent[i] = br->getBit();
+        levelPresent[i] = br->getBit();
+    }
+    if (maxSubLayers > 1) {
+        for (uint32_t i = maxSubLayers - 1; i < 8; ++i) {
+            br->skipBits(2);    // reserved_zero_2bits
+        }
+    }
+    for (uint32_t i = 0; i + 1 < maxSubLayers; ++i) {
+        if (profilePresent[i]) {
+            br->skipBits(88);
+        }
+        if (levelPresent[i]) {
+            br->skipBits(8);
+        }
+    }
+    return !br->overflowed();
+}
+
+static void skipHevcScalingListData(SprdBitReader *br) {
+    for (uint32_t sizeId = 0; sizeId < 4; ++sizeId) {
+        for (uint32_t matrixId = 0; matrixId < 6; matrixId += (sizeId == 3) ? 3 : 1) {
+            if (!br->getBit()) {    // scaling_list_pred_mode_flag
+                br->getUE();        // scaling_list_pred_matrix_id_delta
+                continue;
+            }
+            uint32_t coefs = 1u << (4 + (sizeId << 1));
+            if (coefs > 64) {
+                coefs = 64;
+            }
+            if (sizeId > 1) {
+                br->getSE();        // scaling_list_dc_coef_minus8
+            }
+            for (uint32_t i = 0; i < coefs; ++i) {
+                br->getSE();        // scaling_list_delta_coef
+            }
+        }
+    }
+}
+
+// st_ref_pic_set() as it appears in the SPS; numDeltaPocs holds the
+// counts of the sets before index and receives this one's.
+static bool skipHevcShortTermRefPicSet(SprdBitReader *br, uint32_t index,
+        uint32_t *numDeltaPocs) {
+    bool interPrediction = index != 0 && br->getBit();
+    if (interPrediction) {
+        br->skipBits(1);    // delta_rps_sign
+        br->getUE();        // abs_delta_rps_minus1
+        uint32_t count = 0;
+        for (uint32_t j = 0; j <= numDeltaPocs[index - 1]; ++j) {
+            bool used = br->getBit();
+            bool useDelta = used || br->getBit();
+            if (useDelta) {
+                ++count;
+            }
+        }
+        numDeltaPocs[index] = count;
+    } else {
+        uint32_t negative = br->getUE();
+        uint32_t positive = br->getUE();
+        if (negative > 16 || positive > 16 || negative + positive > 16) {
+            return false;
+        }
+        for (uint32_t j = 0; j < negative + positive; ++j) {
+            br->getUE();        // delta_poc_s0/s1_minus1
+            br->skipBits(1);    // used_by_curr_pic_s0/s1_flag
+        }
+        numDeltaPocs[index] = negative + positive;
+    }
+    return numDeltaPocs[index] <= 16 && !br->overflowed();
+}
+
+bool SprdParseHevcVps(const uint8_t *nal, size_t size, SprdHevcVps *vps) {
+    if (size < 3 || SprdHevcNalType(nal) != kHevcNalVps) {
+        return false;
+    }
+
+    memset(vps, 0, sizeof(*vps));
+    SprdBitReader br(nal + 2, size - 2);
+
+    vps->mVpsId = br.getBits(4);
+    br.skipBits(2);         // vps_base_layer_internal/available_flag
+    vps->mMaxLayers = br.getBits(6) + 1;
+    vps->mMaxSubLayers = br.getBits(3) + 1;
+    vps->mTemporalIdNesting = br.getBit();
+    br.skipBits(16);        // vps_reserved_0xffff_16bits
+    if (vps->mMaxSubLayers > 7
+            || !parseHevcProfileTierLevel(&br, vps->mMaxSubLayers, &vps->mPtl)) {
+        return false;
+    }
+
+    bool orderingInfoPresent = br.getBit();
+    for (uint32_t i = orderingInfoPresent ? 0 : vps->mMaxSubLayers - 1;
+            i < vps->mMaxSubLayers; ++i) {
+        vps->mMaxDecPicBuffering = br.getUE() + 1;
+        vps->mMaxNumReorderPics = br.getUE();
+        br.getUE();         // vps_max_latency_increase_plus1
+    }
+
+    uint32_t maxLayerId = br.getBits(6);
+    uint32_t numLayerSets = br.getUE() + 1;
+    if (numLayerSets > 1024) {
+        return false;
+    }
+    for (uint32_t i = 1; i < numLayerSets; ++i) {
+        br.skipBits(maxLayerId + 1);    // layer_id_included_flag
+    }
+    if (br.getBit()) {      // vps_timing_info_present_flag
+        vps->mNumUnitsInTick = br.getBits(32);
+        vps->mTimeScale = br.getBits(32);
+    }
+
+    return !br.overflowed();
+}
+
+bool SprdParseHevcSps(const uint8_t *nal, size_t size, SprdHevcSps *sps) {
+    if (size < 3 || SprdHevcNalType(nal) != kHevcNalSps) {
+        return false;
+    }
+
+    memset(sps, 0, sizeof(*sps));
+    initVideoSignal(&sps->mSignal);
+    SprdBitReader br(nal + 2, size - 2);
+
+    sps->mVpsId = br.getBits(4);
+    sps->mMaxSubLayers = br.getBits(3) + 1;
+    sps->mTemporalIdNesting = br.getBit();
+    if (sps->mMaxSubLayers > 7
+            || !parseHevcProfileTierLevel(&br, sps->mMaxSubLayers, &sps->mPtl)) {
+        return false;
+    }
+
+    sps->mSpsId = br.getUE();
+    sps->mChromaFormatIdc = br.getUE();
+    if (sps->mSpsId > 15 || sps->mChromaFormatIdc > 3) {
+        return false;
+    }
+    if (sps->mChromaFormatIdc == 3) {
+        sps->mSeparateColourPlane = br.getBit();
+    }
+    sps->mCodedWidth = br.getUE();
+    sps->mCodedHeight = br.getUE();
+    if (sps->mCodedWidth == 0 || sps->mCodedHeight == 0
+            || sps->mCodedWidth > 16888 || sps->mCodedHeight > 16888) {
+        return false;
+    }
+
+    if (br.getBit()) {      // conformance_window_flag
+        uint32_t chromaArrayType = sps->mSeparateColourPlane ? 0 : sps->mChromaFormatIdc;
+        uint32_t unitX = (chromaArrayType == 1 || chromaArrayType == 2) ? 2 : 1;
+        uint32_t unitY = chromaArrayType == 1 ? 2 : 1;
+        sps->mCropLeft = br.getUE() * unitX;
+        sps->mCropRight = br.getUE() * unitX;
+        sps->mCropTop = br.getUE() * unitY;
+        sps->mCropBottom = br.getUE() * unitY;
+        if (sps->mCropLeft + sps->mCropRight >= sps->mCodedWidth
+                || sps->mCropTop + sps->mCropBottom >= sps->mCodedHeight) {
+            return false;
+        }
+    }
+
+    sps->mBitDepthLuma = br.getUE() + 8;
+    sps->mBitDepthChroma = br.getUE() + 8;
+    sps->mLog2MaxPicOrderCntLsb = br.getUE() + 4;
+    if (sps->mBitDepthLuma > 16 || sps->mBitDepthChroma > 16
+            || sps->mLog2MaxPicOrderCntLsb > 16) {
+        return false;
+    }
+
+    bool orderingInfoPresent = br.getBit();
+    for (uint32_t i = orderingInfoPresent ? 0 : sps->mMaxSubLayers - 1;
+            i < sps->mMaxSubLayers; ++i) {
+        sps->mMaxDecPicBuffering = br.getUE() + 1;
+        sps->mMaxNumReorderPics = br.getUE();
+        sps->mMaxLatencyIncrease = br.getUE();
+    }
+
+    sps->mLog2MinCbSize = br.getUE() + 3;
+    sps->mLog2CtbSize = sps->mLog2MinCbSize + br.getUE();
+    sps->mLog2MinTbSize = br.getUE() + 2;
+    sps->mLog2MaxTbSize = sps->mLog2MinTbSize + br.getUE();
+    if (sps->mLog2CtbSize > 6 || sps->mLog2MaxTbSize > 5) {
+        return false;
+    }
+    sps->mMaxTransformHierarchyDepthInter = br.getUE();
+    sps->mMaxTransformHierarchyDepthIntra = br.getUE();
+
+    sps->mScalingListEnabled = br.getBit();
+    if (sps->mScalingListEnabled && br.getBit()) {  // sps_scaling_list_data_present_flag
+        skipHevcScalingListData(&br);
+    }
+    sps->mAmpEnabled = br.getBit();
+    sps->mSaoEnabled = br.getBit();
+    sps->mPcmEnabled = br.getBit();
+    if (sps->mPcmEnabled) {
+        br.skipBits(8);     // pcm_sample_bit_depth_luma/chroma_minus1
+        br.getUE();         // log2_min_pcm_luma_coding_block_size_minus3
+        br.getUE();         // log2_diff_max_min_pcm_luma_coding_block_size
+        br.skipBits(1);     // pcm_loop_filter_disabled_flag
+    }
+
+    sps->mNumShortTermRefPicSets = br.getUE();
+    if (sps->mNumShortTermRefPicSets > 64) {
+        return false;
+    }
+    uint32_t numDeltaPocs[64];
+    for (uint32_t i = 0; i < sps->mNumShortTermRefPicSets; ++i) {
+        if (!skipHevcShortTermRefPicSet(&br, i, numDeltaPocs)) {
+            return false;
+        }
+    }
+
+    sps->mLongTermRefPicsPresent = br.getBit();
+    if (sps->mLongTermRefPicsPresent) {
+        sps->mNumLongTermRefPicsSps = br.getUE();
+        if (sps->mNumLongTermRefPicsSps > 32) {
+            return false;
+        }
+        for (uint32_t i = 0; i < sps->mNumLongTermRefPicsSps; ++i) {
+            br.skipBits(sps->mLog2MaxPicOrderCntLsb + 1);  // lt_ref_pic_poc_lsb_sps, used flag
+        }
+    }
+    sps->mTemporalMvpEnabled = br.getBit();
+    sps->mStrongIntraSmoothing = br.getBit();
+
+    sps->mVuiPresent = br.getBit();
+    if (sps->mVuiPresent) {
+        parseVuiHead(&br, &sps->mSarWidth, &sps->mSarHeight, &sps->mSignal);
+        if (br.overflowed()) {
+            sps->mVuiPresent = false;
+            sps->mSarWidth = sps->mSarHeight = 0;
+            initVideoSignal(&sps->mSignal);
+            return true;
+        }
+    }
+
+    return !br.overflowed();
+}
+
+bool SprdParseHevcPps(const uint8_t *nal, size_t size, SprdHevcPps *pps) {
+    if (size < 3 || SprdHevcNalType(nal) != kHevcNalPps) {
+        return false;
+    }
+
+    memset(pps, 0, sizeof(*pps));
+    SprdBitReader br(nal + 2, size - 2);
+
+    pps->mPpsId = br.getUE();
+    pps->mSpsId = br.getUE();
+    if (pps->mPpsId > 63 || pps->mSpsId > 15) {
+        return false;
+    }
+    pps->mDependentSliceSegments = br.getBit();
+    pps->mOutputFlagPresent = br.getBit();
+    pps->mNumExtraSliceHeaderBits = br.getBits(3);
+    pps->mSignDataHiding = br.getBit();
+    pps->mCabacInitPresent = br.getBit();
+    pps->mNumRefIdxL0Default = br.getUE() + 1;
+    pps->mNumRefIdxL1Default = br.getUE() + 1;
+    if (pps->mNumRefIdxL0Default > 15 || pps->mNumRefIdxL1Default > 15) {
+        return false;
+    }
+    pps->mInitQp = 26 + br.getSE();
+    pps->mConstrainedIntraPred = br.getBit();
+    pps->mTransformSkip = br.getBit();
+    pps->mCuQpDeltaEnabled = br.getBit();
+    if (pps->mCuQpDeltaEnabled) {
+        pps->mDiffCuQpDeltaDepth = br.getUE();
+    }
+    pps->mCbQpOffset = br.getSE();
+    pps->mCrQpOffset = br.getSE();
+    pps->mSliceChromaQpOffsetsPresent = br.getBit();
+    pps->mWeightedPred = br.getBit();
+    pps->mWeightedBipred = br.getBit();
+    pps->mTransquantBypass = br.getBit();
+    pps->mTilesEnabled = br.getBit();
+    pps->mEntropyCodingSync = br.getBit();
+
+    pps->mNumTileColumns = 1;
+    pps->mNumTileRows = 1;
+    if (pps->mTilesEnabled) {
+        pps->mNumTileColumns = br.getUE() + 1;
+        pps->mNumTileRows = br.getUE() + 1;
+        if (pps->mNumTileColumns > 20 || pps->mNumTileRows > 22) {
+            return false;
+        }
+        if (!br.getBit()) {     // uniform_spacing_flag
+            for (uint32_t i = 0; i + 1 < pps->mNumTileColumns; ++i) {
+                br.getUE();     // column_width_minus1
+            }
+            for (uint32_t i = 0; i + 1 < pps->mNumTileRows; ++i) {
+                br.getUE();     // row_height_minus1
+            }
+        }
+        br.skipBits(1);         // loop_filter_across_tiles_enabled_flag
+    }
+
+    pps->mLoopFilterAcrossSlices = br.getBit();
+    pps->mDeblockingFilterControlPresent = br.getBit();
+    if (pps->mDeblockingFilterControlPresent) {
+        br.skipBits(1);         // deblocking_filter_override_enabled_flag
+        pps->mDeblockingFilterDisabled = br.getBit();
+        if (!pps->mDeblockingFilterDisabled) {
+            br.getSE();         // pps_beta_offset_div2
+            br.getSE();         // pps_tc_offset_div2
+        }
+    }
+
+    return !br.overflowed();
+}
+
+}  // namespace android
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SprdBitstream.h"
+
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SPRD_START_CODE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SPRD_START_CODE_SSE2
+#endif
+
+namespace android {
+
+// Compares 16 positions at a time: byte i, i + 1 and i + 2 against 0, 0
+// and 1. Returns the offset of the first block with a match, or the first
+// offset it did not look at.
+#if defined(SPRD_START_CODE_NEON)
+
+static size_t scanBlocks(const uint8_t *data, size_t offset, size_t end) {
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t one = vdupq_n_u8(1);
+
+    for (; offset + 18 <= end; offset += 16) {
+        uint8x16_t a = vld1q_u8(data + offset);
+        uint8x16_t b = vld1q_u8(data + offset + 1);
+        uint8x16_t c = vld1q_u8(data + offset + 2);
+        uint8x16_t hit = vandq_u8(vandq_u8(vceqq_u8(a, zero), vceqq_u8(b, zero)),
+                vceqq_u8(c, one));
+#if defined(__aarch64__)
+        if (vmaxvq_u8(hit) != 0) {
+            break;
+        }
+#else
+        uint32x2_t folded = vreinterpret_u32_u8(
+                vorr_u8(vget_low_u8(hit), vget_high_u8(hit)));
+        if ((vget_lane_u32(folded, 0) | vget_lane_u32(folded, 1)) != 0) {
+            break;
+        }
+#endif
+    }
+    return offset;
+}
+
+#elif defined(SPRD_START_CODE_SSE2)
+
+static size_t scanBlocks(const uint8_t *data, size_t offset, size_t end) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+
+    for (; offset + 18 <= end; offset += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(data + offset));
+        __m128i b = _mm_loadu_si128((const __m128i *)(data + offset + 1));
+        __m128i c = _mm_loadu_si128((const __m128i *)(data + offset + 2));
+        __m128i hit = _mm_and_si128(
+                _mm_and_si128(_mm_cmpeq_epi8(a, zero), _mm_cmpeq_epi8(b, zero)),
+                _mm_cmpeq_epi8(c, one));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask != 0) {
+            return offset + __builtin_ctz(mask);
+        }
+    }
+    return offset;
+}
+
+#else
+
+// Lets the C library's memchr, which is vectorised on every platform we
+// ship, look for the 01 and checks the two bytes before it.
+static size_t scanBlocks(const uint8_t *data, size_t offset, size_t end) {
+    while (offset + 3 <= end) {
+        const uint8_t *one = (const uint8_t *)memchr(data + offset + 2, 1, end - offset - 2);
+        if (one == NULL) {
+            return end - 2;
+        }
+        size_t at = one - data - 2;
+        if (data[at] == 0 && data[at + 1] == 0) {
+            return at;
+        }
+        offset = at + 1;
+    }
+    return offset;
+}
+
+#endif
+
+size_t SprdFindStartCode(const uint8_t *data, size_t size, size_t offset) {
+    if (offset >= size || size - offset < 3) {
+        return size;
+    }
+
+    for (size_t i = scanBlocks(data, offset, size); i + 3 <= size; ++i) {
+        if (data[i + 2] > 1) {
+            // Neither this nor the next position can match.
+            i += 2;
+        } else if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            return i;
+        }
+    }
+    return size;
+}
+
+SprdNalIterator::SprdNalIterator(const uint8_t *data, size_t size)
+    : mData(data),
+      mSize(size),
+      mOffset(0) {
+    size_t i = 0;
+    while (i < size && data[i] == 0) {
+        ++i;
+    }
+    if (i >= 2 && i < size && data[i] == 1) {
+        mOffset = i + 1;
+    }
+}
+
+bool SprdNalIterator::next(const uint8_t **nal, size_t *nalSize) {
+    while (mOffset < mSize) {
+        size_t start = mOffset;
+        size_t end = SprdFindStartCode(mData, mSize, start);
+
+        mOffset = end < mSize ? end + 3 : mSize;
+        while (end > start && mData[end - 1] == 0) {
+            --end;
+        }
+        if (end > start) {
+            *nal = mData + start;
+            *nalSize = end - start;
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace android
@@ -0,0 +1,32 @@
+LOCAL_PATH := $(call my-dir)
+
+# libFuzzer targets for libsprd_bitstream. Build with
+#   SANITIZE_TARGET=address mmma <this directory>
+# and run e.g. /data/fuzz/<arch>/sprd_startcode_fuzzer/sprd_startcode_fuzzer.
+# Annex B streams make a good seed corpus for both.
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := sprd_startcode_fuzzer.cpp
+
+LOCAL_STATIC_LIBRARIES := libsprd_bitstream
+
+LOCAL_SHARED_LIBRARIES := liblog
+
+LOCAL_MODULE := sprd_startcode_fuzzer
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_FUZZ_TEST)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := sprd_parameter_sets_fuzzer.cpp
+
+LOCAL_STATIC_LIBRARIES := libsprd_bitstream
+
+LOCAL_SHARED_LIBRARIES := liblog
+
+LOCAL_MODULE := sprd_parameter_sets_fuzzer
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_FUZZ_TEST)
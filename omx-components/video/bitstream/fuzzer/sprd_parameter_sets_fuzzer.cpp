@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Feeds every NAL unit of the input to all the parameter set parsers,
+// and the whole input to the bit reader, and checks what the parsers
+// accept against the limits they promise.
+
+#include <stdlib.h>
+
+#include "SprdBitstream.h"
+
+using namespace android;
+
+static void check(bool condition) {
+    if (!condition) {
+        abort();
+    }
+}
+
+static void parseNal(const uint8_t *nal, size_t size) {
+    SprdAvcSps avcSps;
+    if (SprdParseAvcSps(nal, size, &avcSps)) {
+        check(avcSps.mSpsId <= 31);
+        check(avcSps.mCodedWidth > 0 && avcSps.mCodedWidth <= 8192);
+        check(avcSps.mCodedHeight > 0 && avcSps.mCodedHeight <= 16384);
+        check(avcSps.mCropLeft + avcSps.mCropRight < avcSps.mCodedWidth);
+        check(avcSps.mCropTop + avcSps.mCropBottom < avcSps.mCodedHeight);
+    }
+
+    SprdAvcPps avcPps;
+    for (uint32_t chromaFormatIdc = 1; chromaFormatIdc <= 3; chromaFormatIdc += 2) {
+        if (SprdParseAvcPps(nal, size, &avcPps, chromaFormatIdc)) {
+            check(avcPps.mPpsId <= 255 && avcPps.mSpsId <= 31);
+            check(avcPps.mNumSliceGroups >= 1 && avcPps.mNumSliceGroups <= 8);
+        }
+    }
+
+    SprdHevcVps vps;
+    if (SprdParseHevcVps(nal, size, &vps)) {
+        check(vps.mMaxSubLayers >= 1 && vps.mMaxSubLayers <= 7);
+    }
+
+    SprdHevcSps hevcSps;
+    if (SprdParseHevcSps(nal, size, &hevcSps)) {
+        check(hevcSps.mSpsId <= 15);
+        check(hevcSps.mLog2CtbSize <= 6 && hevcSps.mLog2MaxTbSize <= 5);
+        check(hevcSps.mCropLeft + hevcSps.mCropRight < hevcSps.mCodedWidth);
+        check(hevcSps.mCropTop + hevcSps.mCropBottom < hevcSps.mCodedHeight);
+    }
+
+    SprdHevcPps hevcPps;
+    if (SprdParseHevcPps(nal, size, &hevcPps)) {
+        check(hevcPps.mPpsId <= 63 && hevcPps.mSpsId <= 15);
+        check(hevcPps.mNumTileColumns >= 1 && hevcPps.mNumTileColumns <= 20);
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    SprdNalIterator it(data, size);
+    const uint8_t *nal;
+    size_t nalSize;
+    while (it.next(&nal, &nalSize)) {
+        parseNal(nal, nalSize);
+    }
+
+    // Mixed reads until the data runs out; each one consumes at least a
+    // bit, so this ends.
+    SprdBitReader br(data, size);
+    uint32_t op = 0;
+    while (!br.overflowed()) {
+        switch (op++ % 4) {
+            case 0: br.getUE(); break;
+            case 1: br.getSE(); break;
+            case 2: br.getBits(op % 33); br.getBit(); break;
+            case 3: br.moreRbspData(); br.skipBits(op % 70 + 1); break;
+        }
+    }
+    return 0;
+}
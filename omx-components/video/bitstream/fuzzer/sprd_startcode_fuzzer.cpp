@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks the vectorised start code scan against a byte loop, and that
+// SprdNalIterator returns in-bounds NAL units without start codes inside.
+
+#include <stdlib.h>
+
+#include "SprdBitstream.h"
+
+using namespace android;
+
+static size_t naiveFindStartCode(const uint8_t *data, size_t size, size_t offset) {
+    for (size_t i = offset; i + 3 <= size; ++i) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            return i;
+        }
+    }
+    return size;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    // Every start code, as a scan from each one would find them.
+    size_t expected = naiveFindStartCode(data, size, 0);
+    for (size_t offset = 0; offset <= size; ++offset) {
+        if (offset > expected) {
+            expected = naiveFindStartCode(data, size, offset);
+        }
+        if (SprdFindStartCode(data, size, offset) != expected) {
+            abort();
+        }
+    }
+
+    SprdNalIterator it(data, size);
+    const uint8_t *nal;
+    size_t nalSize;
+    const uint8_t *last = data;
+    while (it.next(&nal, &nalSize)) {
+        if (nalSize == 0 || nal < last || nal + nalSize > data + size
+                || nal[nalSize - 1] == 0
+                || naiveFindStartCode(nal, nalSize, 0) != nalSize) {
+            abort();
+        }
+        last = nal + nalSize;
+    }
+    return 0;
+}
@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPRD_BITSTREAM_H_
+
+#define SPRD_BITSTREAM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// Offset of the first 00 00 01 at or after offset, size if there is none.
+// Vectorised with NEON or SSE2 where the target has it.
+size_t SprdFindStartCode(const uint8_t *data, size_t size, size_t offset = 0);
+
+// Walks the NAL units of an Annex B buffer. A buffer that does not begin
+// with a start code is taken to begin with a NAL unit, as some clients
+// send codec config that way.
+struct SprdNalIterator {
+    SprdNalIterator(const uint8_t *data, size_t size);
+
+    // The next NAL unit, header included, without its start code and the
+    // zero bytes that trail it.
+    bool next(const uint8_t **nal, size_t *nalSize);
+
+private:
+    const uint8_t *mData;
+    size_t mSize;
+    size_t mOffset;
+};
+
+// MSB first reader over the payload of one NAL unit. Emulation prevention
+// bytes are skipped as the bytes are loaded, so the NAL unit is never
+// copied. Reads past the end return zeros and set overflowed().
+struct SprdBitReader {
+    SprdBitReader(const uint8_t *data, size_t size);
+
+    // n <= 32.
+    uint32_t getBits(uint32_t n);
+    uint32_t getBit() { return getBits(1); }
+    void skipBits(uint32_t n);
+
+    // Exp-Golomb codes of up to 32 bits.
+    uint32_t getUE();
+    int32_t getSE();
+
+    // Whether anything but the rbsp_stop_one_bit and trailing zeros is left.
+    bool moreRbspData();
+
+    bool overflowed() const { return mOverflow; }
+
+private:
+    const uint8_t *mData;
+    size_t mSize;
+    size_t mOffset;     // next byte to load
+    size_t mStopByte;   // last non-zero byte, holding the stop bit
+    uint64_t mCache;    // MSB aligned
+    uint32_t mCacheBits;
+    uint32_t mZeros;    // zero bytes loaded in a row
+    bool mOverflow;
+
+    void refill();
+};
+
+enum {
+    kAvcNalSlice = 1,
+    kAvcNalIdrSlice = 5,
+    kAvcNalSei = 6,
+    kAvcNalSps = 7,
+    kAvcNalPps = 8,
+    kAvcNalAud = 9,
+
+    kHevcNalVps = 32,
+    kHevcNalSps = 33,
+    kHevcNalPps = 34,
+    kHevcNalAud = 35,
+};
+
+inline int SprdAvcNalType(const uint8_t *nal) { return nal[0] & 0x1f; }
+inline int SprdHevcNalType(const uint8_t *nal) { return (nal[0] >> 1) & 0x3f; }
+
+// Colour description of the VUI; 2 (unspecified) when absent.
+struct SprdVideoSignal {
+    bool mFullRange;
+    uint8_t mPrimaries;
+    uint8_t mTransfer;
+    uint8_t mMatrixCoeffs;
+};
+
+struct SprdAvcSps {
+    uint8_t mProfileIdc;
+    uint8_t mConstraintFlags;   // constraint_set0_flag in the MSB
+    uint8_t mLevelIdc;
+    uint32_t mSpsId;
+    uint32_t mChromaFormatIdc;
+    bool mSeparateColourPlane;
+    uint32_t mBitDepthLuma;
+    uint32_t mBitDepthChroma;
+    bool mScalingMatrixPresent;
+    uint32_t mLog2MaxFrameNum;
+    uint32_t mPicOrderCntType;
+    uint32_t mLog2MaxPicOrderCntLsb;
+    uint32_t mMaxNumRefFrames;
+    bool mGapsInFrameNumAllowed;
+    uint32_t mWidthInMbs;
+    uint32_t mHeightInMapUnits;
+    bool mFrameMbsOnly;
+    bool mMbAdaptiveFrameField;
+    bool mDirect8x8Inference;
+
+    // Decoded size and the cropping rectangle, in luma samples.
+    uint32_t mCodedWidth;
+    uint32_t mCodedHeight;
+    uint32_t mCropLeft;
+    uint32_t mCropRight;
+    uint32_t mCropTop;
+    uint32_t mCropBottom;
+
+    bool mVuiPresent;
+    uint32_t mSarWidth;         // 0 when not signalled
+    uint32_t mSarHeight;
+    SprdVideoSignal mSignal;
+    uint32_t mNumUnitsInTick;   // 0 when not signalled
+    uint32_t mTimeScale;
+    bool mFixedFrameRate;
+    // From bitstream_restriction; -1 when not signalled.
+    int32_t mMaxNumReorderFrames;
+    int32_t mMaxDecFrameBuffering;
+};
+
+struct SprdAvcPps {
+    uint32_t mPpsId;
+    uint32_t mSpsId;
+    bool mEntropyCodingMode;
+    bool mBottomFieldPicOrderPresent;
+    uint32_t mNumSliceGroups;
+    uint32_t mNumRefIdxL0Default;
+    uint32_t mNumRefIdxL1Default;
+    bool mWeightedPred;
+    uint32_t mWeightedBipredIdc;
+    int32_t mPicInitQp;
+    int32_t mPicInitQs;
+    int32_t mChromaQpIndexOffset;
+    bool mDeblockingFilterControlPresent;
+    bool mConstrainedIntraPred;
+    bool mRedundantPicCntPresent;
+    bool mTransform8x8Mode;
+    bool mScalingMatrixPresent;
+    int32_t mSecondChromaQpIndexOffset;
+};
+
+struct SprdHevcProfileTierLevel {
+    uint32_t mProfileSpace;
+    bool mTierFlag;
+    uint32_t mProfileIdc;
+    uint32_t mCompatibilityFlags;
+    bool mProgressiveSource;
+    bool mInterlacedSource;
+    bool mFrameOnlyConstraint;
+    uint32_t mLevelIdc;
+};
+
+struct SprdHevcVps {
+    uint32_t mVpsId;
+    uint32_t mMaxLayers;
+    uint32_t mMaxSubLayers;
+    bool mTemporalIdNesting;
+    SprdHevcProfileTierLevel mPtl;
+    uint32_t mMaxDecPicBuffering;   // of the highest sub-layer
+    uint32_t mMaxNumReorderPics;
+    uint32_t mNumUnitsInTick;       // 0 when not signalled
+    uint32_t mTimeScale;
+};
+
+struct SprdHevcSps {
+    uint32_t mVpsId;
+    uint32_t mMaxSubLayers;
+    bool mTemporalIdNesting;
+    SprdHevcProfileTierLevel mPtl;
+    uint32_t mSpsId;
+    uint32_t mChromaFormatIdc;
+    bool mSeparateColourPlane;
+    uint32_t mCodedWidth;
+    uint32_t mCodedHeight;
+    // Conformance window, in luma samples.
+    uint32_t mCropLeft;
+    uint32_t mCropRight;
+    uint32_t mCropTop;
+    uint32_t mCropBottom;
+    uint32_t mBitDepthLuma;
+    uint32_t mBitDepthChroma;
+    uint32_t mLog2MaxPicOrderCntLsb;
+    uint32_t mMaxDecPicBuffering;   // of the highest sub-layer
+    uint32_t mMaxNumReorderPics;
+    uint32_t mMaxLatencyIncrease;
+    uint32_t mLog2MinCbSize;
+    uint32_t mLog2CtbSize;
+    uint32_t mLog2MinTbSize;
+    uint32_t mLog2MaxTbSize;
+    uint32_t mMaxTransformHierarchyDepthInter;
+    uint32_t mMaxTransformHierarchyDepthIntra;
+    bool mScalingListEnabled;
+    bool mAmpEnabled;
+    bool mSaoEnabled;
+    bool mPcmEnabled;
+    uint32_t mNumShortTermRefPicSets;
+    bool mLongTermRefPicsPresent;
+    uint32_t mNumLongTermRefPicsSps;
+    bool mTemporalMvpEnabled;
+    bool mStrongIntraSmoothing;
+    bool mVuiPresent;
+    uint32_t mSarWidth;             // 0 when not signalled
+    uint32_t mSarHeight;
+    SprdVideoSignal mSignal;
+};
+
+struct SprdHevcPps {
+    uint32_t mPpsId;
+    uint32_t mSpsId;
+    bool mDependentSliceSegments;
+    bool mOutputFlagPresent;
+    uint32_t mNumExtraSliceHeaderBits;
+    bool mSignDataHiding;
+    bool mCabacInitPresent;
+    uint32_t mNumRefIdxL0Default;
+    uint32_t mNumRefIdxL1Default;
+    int32_t mInitQp;
+    bool mConstrainedIntraPred;
+    bool mTransformSkip;
+    bool mCuQpDeltaEnabled;
+    uint32_t mDiffCuQpDeltaDepth;
+    int32_t mCbQpOffset;
+    int32_t mCrQpOffset;
+    bool mSliceChromaQpOffsetsPresent;
+    bool mWeightedPred;
+    bool mWeightedBipred;
+    bool mTransquantBypass;
+    bool mTilesEnabled;
+    bool mEntropyCodingSync;
+    uint32_t mNumTileColumns;
+    uint32_t mNumTileRows;
+    bool mLoopFilterAcrossSlices;
+    bool mDeblockingFilterControlPresent;
+    bool mDeblockingFilterDisabled;
+};
+
+// Each parser takes one NAL unit as returned by SprdNalIterator, header
+// included, and fails on streams that are truncated or out of range. The
+// HEVC parsers stop after the fields listed above; the rest of the NAL
+// unit is not looked at.
+bool SprdParseAvcSps(const uint8_t *nal, size_t size, SprdAvcSps *sps);
+// chromaFormatIdc comes from the SPS the PPS refers to; it sizes the 8x8
+// scaling lists.
+bool SprdParseAvcPps(const uint8_t *nal, size_t size, SprdAvcPps *pps,
+        uint32_t chromaFormatIdc = 1);
+bool SprdParseHevcVps(const uint8_t *nal, size_t size, SprdHevcVps *vps);
+bool SprdParseHevcSps(const uint8_t *nal, size_t size, SprdHevcSps *sps);
+bool SprdParseHevcPps(const uint8_t *nal, size_t size, SprdHevcPps *pps);
+
+}  // namespace android
+
+#endif  // SPRD_BITSTREAM_H_
@@ -0,0 +1,73 @@
+LOCAL_PATH := $(call my-dir)
+
+# Start code scan, NAL iteration, bit reader and parameter set parsers
+# against hand-checked streams. The device build covers the NEON scan.
+# Run with: atest --host SprdBitstream_test
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := SprdBitstream_test.cpp
+
+LOCAL_STATIC_LIBRARIES := libsprd_bitstream
+
+LOCAL_SHARED_LIBRARIES := liblog
+
+LOCAL_MODULE := SprdBitstream_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := SprdBitstream_test.cpp
+
+LOCAL_STATIC_LIBRARIES := libsprd_bitstream
+
+LOCAL_SHARED_LIBRARIES := liblog
+
+LOCAL_MODULE := SprdBitstream_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_NATIVE_TEST)
+
+################################################################################
+
+# MB/s of the scan and NAL iteration: sprd_bitstream_bench [annexb-file [passes]]
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := SprdBitstream_bench.cpp
+
+LOCAL_STATIC_LIBRARIES := libsprd_bitstream
+
+LOCAL_SHARED_LIBRARIES := \
+    libutils            \
+    liblog
+
+LOCAL_CFLAGS := -O2
+
+LOCAL_MODULE := sprd_bitstream_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := SprdBitstream_bench.cpp
+
+LOCAL_STATIC_LIBRARIES := libsprd_bitstream
+
+LOCAL_SHARED_LIBRARIES := \
+    libutils            \
+    liblog
+
+LOCAL_CFLAGS := -O2
+
+LOCAL_MODULE := sprd_bitstream_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
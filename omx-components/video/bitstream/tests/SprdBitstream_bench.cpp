@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Throughput of the start code scan, NAL iteration and parameter set
+// parsing over an Annex B stream.
+//
+//   sprd_bitstream_bench [file.264|file.265 [passes]]
+//
+// Without a file, 64 MB of slice-like data with a parameter set every
+// 30 NAL units is generated.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <utils/Timers.h>
+
+#include "SprdBitstream.h"
+
+using namespace android;
+
+static size_t byteLoopFindStartCode(const uint8_t *data, size_t size, size_t offset) {
+    for (size_t i = offset; i + 3 <= size; ++i) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            return i;
+        }
+    }
+    return size;
+}
+
+static bool readFile(const char *path, std::vector<uint8_t> *data) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data->insert(data->end(), chunk, chunk + n);
+    }
+    fclose(file);
+    return true;
+}
+
+// The 1080p SPS and a PPS from SprdBitstream_test, then NAL units of
+// entropy-coded-looking bytes: random, with emulation prevention.
+static void generateStream(std::vector<uint8_t> *data, size_t size) {
+    static const uint8_t kSps[] = {
+        0x00, 0x00, 0x00, 0x01,
+        0x67, 0x64, 0x00, 0x28, 0xac, 0xd9, 0x40, 0x78, 0x02, 0x27, 0xe5, 0xc0,
+        0x5b, 0x80, 0x80, 0x80, 0xa0, 0x00, 0x00, 0x7d, 0x20, 0x00, 0x1d, 0x4c,
+        0x11, 0xb4, 0x11, 0x08, 0xb2, 0xc0,
+    };
+    static const uint8_t kPps[] = {
+        0x00, 0x00, 0x00, 0x01, 0x68, 0x5a, 0xf8, 0xf2, 0xc8, 0xd0,
+    };
+
+    srand(1);
+    for (int32_t n = 0; data->size() < size; ++n) {
+        if (n % 30 == 0) {
+            data->insert(data->end(), kSps, kSps + sizeof(kSps));
+            data->insert(data->end(), kPps, kPps + sizeof(kPps));
+        }
+        data->push_back(0);
+        data->push_back(0);
+        data->push_back(1);
+        data->push_back(n % 30 == 0 ? 0x65 : 0x41);
+
+        size_t nalSize = 2000 + rand() % 60000;
+        uint32_t zeros = 0;
+        for (size_t i = 0; i < nalSize; ++i) {
+            // Zero bytes are common in real slices.
+            uint8_t byte = rand() % 16 == 0 ? 0 : rand() & 0xff;
+            if (zeros >= 2 && byte <= 3) {
+                data->push_back(3);
+                zeros = 0;
+            }
+            data->push_back(byte);
+            zeros = byte == 0 ? zeros + 1 : 0;
+        }
+        if (data->back() == 0) {
+            data->push_back(0x80);
+        }
+    }
+}
+
+static double mbPerSecond(size_t bytes, int32_t passes, nsecs_t elapsed) {
+    return (double)bytes * passes / (1 << 20) / (elapsed / 1e9);
+}
+
+int main(int argc, char **argv) {
+    std::vector<uint8_t> data;
+    int32_t passes = 10;
+    if (argc >= 2) {
+        if (!readFile(argv[1], &data)) {
+            fprintf(stderr, "unable to read %s\n", argv[1]);
+            return 1;
+        }
+    } else {
+        generateStream(&data, 64 << 20);
+    }
+    if (argc >= 3) {
+        passes = atoi(argv[2]);
+    }
+    if (data.size() < 4 || passes <= 0) {
+        fprintf(stderr, "usage: %s [annexb-file [passes]]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%zu bytes, %d passes\n", data.size(), passes);
+
+    size_t codes = 0;
+    size_t checksum = 0;
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (int32_t pass = 0; pass < passes; ++pass) {
+        for (size_t i = byteLoopFindStartCode(&data[0], data.size(), 0); i < data.size();
+                i = byteLoopFindStartCode(&data[0], data.size(), i + 3)) {
+            checksum += i;
+        }
+    }
+    nsecs_t byteLoop = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    size_t vectorChecksum = 0;
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (int32_t pass = 0; pass < passes; ++pass) {
+        for (size_t i = SprdFindStartCode(&data[0], data.size()); i < data.size();
+                i = SprdFindStartCode(&data[0], data.size(), i + 3)) {
+            vectorChecksum += i;
+            ++codes;
+        }
+    }
+    nsecs_t vector = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    if (checksum != vectorChecksum) {
+        fprintf(stderr, "start code scans disagree\n");
+        return 1;
+    }
+
+    // The header bytes of one codec can look like parameter sets of the
+    // other, so go by the first NAL unit: H.264 streams start with an SPS
+    // (or an AUD), H.265 ones with a VPS.
+    bool hevc = false;
+    {
+        SprdNalIterator it(&data[0], data.size());
+        const uint8_t *nal;
+        size_t nalSize;
+        if (it.next(&nal, &nalSize) && nalSize >= 2) {
+            int type = SprdHevcNalType(nal);
+            hevc = (type >= kHevcNalVps && type <= kHevcNalAud) && nal[1] == 1;
+        }
+    }
+    printf("%s stream\n", hevc ? "H.265" : "H.264");
+
+    size_t nals = 0;
+    size_t parsed = 0;
+    size_t failed = 0;
+    nsecs_t parsing = 0;
+    start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (int32_t pass = 0; pass < passes; ++pass) {
+        SprdNalIterator it(&data[0], data.size());
+        const uint8_t *nal;
+        size_t nalSize;
+        while (it.next(&nal, &nalSize)) {
+            ++nals;
+
+            nsecs_t parseStart = systemTime(SYSTEM_TIME_MONOTONIC);
+            bool ok = true;
+            int avcType = hevc ? -1 : SprdAvcNalType(nal);
+            int hevcType = hevc ? SprdHevcNalType(nal) : -1;
+            if (avcType == kAvcNalSps) {
+                SprdAvcSps sps;
+                ok = SprdParseAvcSps(nal, nalSize, &sps);
+            } else if (avcType == kAvcNalPps) {
+                SprdAvcPps pps;
+                ok = SprdParseAvcPps(nal, nalSize, &pps);
+            } else if (hevcType == kHevcNalVps) {
+                SprdHevcVps vps;
+                ok = SprdParseHevcVps(nal, nalSize, &vps);
+            } else if (hevcType == kHevcNalSps) {
+                SprdHevcSps sps;
+                ok = SprdParseHevcSps(nal, nalSize, &sps);
+            } else if (hevcType == kHevcNalPps) {
+                SprdHevcPps pps;
+                ok = SprdParseHevcPps(nal, nalSize, &pps);
+            } else {
+                continue;
+            }
+            parsing += systemTime(SYSTEM_TIME_MONOTONIC) - parseStart;
+            ++parsed;
+            if (!ok) {
+                ++failed;
+            }
+        }
+    }
+    nsecs_t iterating = systemTime(SYSTEM_TIME_MONOTONIC) - start - parsing;
+
+    printf("start codes: %zu per pass\n", codes / passes);
+    printf("  byte loop  %9.1f MB/s\n", mbPerSecond(data.size(), passes, byteLoop));
+    printf("  vectorised %9.1f MB/s\n", mbPerSecond(data.size(), passes, vector));
+    printf("NAL iteration: %zu per pass, %.1f MB/s\n", nals / passes,
+            mbPerSecond(data.size(), passes, iterating));
+    if (parsed > 0) {
+        printf("parameter sets: %zu per pass, %zu rejected, %.2f us each\n",
+                parsed / passes, failed / passes, parsing / 1e3 / parsed);
+    }
+    return 0;
+}
@@ -0,0 +1,554 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdBitstream_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "SprdBitstream.h"
+
+namespace android {
+
+// Parameter sets written field by field, emulation prevention included,
+// by a bit writer that shares no code with the parsers. The comment above
+// each one lists the values the tests expect.
+
+// High@4.0, 1920x1088 cropped to 1080, POC type 0, 4 refs. VUI: 1:1 SAR,
+// full range BT.709, 1001/60000 fixed rate, 2 reorder frames, DPB of 4.
+static const uint8_t kAvcSpsHigh1080p[] = {
+    0x67, 0x64, 0x00, 0x28, 0xac, 0xd9, 0x40, 0x78, 0x02, 0x27, 0xe5, 0xc0,
+    0x5b, 0x80, 0x80, 0x80, 0xa0, 0x00, 0x00, 0x7d, 0x20, 0x00, 0x1d, 0x4c,
+    0x11, 0xb4, 0x11, 0x08, 0xb2, 0xc0,
+};
+
+// Constrained Baseline@1.1, id 3, 176x144, POC type 2, no VUI.
+static const uint8_t kAvcSpsBaselineQcif[] = {
+    0x67, 0x42, 0xc0, 0x0b, 0x21, 0x9a, 0x8b, 0x13, 0x10,
+};
+
+// Main@3.0, id 1, 720x576 MBAFF, POC type 1 with three ref offsets.
+// VUI: extended SAR 64:45 and nothing else.
+static const uint8_t kAvcSpsMain576i[] = {
+    0x67, 0x4d, 0x40, 0x1e, 0x54, 0x2a, 0x21, 0x0a, 0x20, 0x80, 0x5a, 0x12,
+    0x6f, 0xfc, 0x01, 0x00, 0x00, 0xb6, 0x01,
+};
+
+// id 1, CABAC, 3/1 refs, weighted bipred 2, QP 23, chroma offset -2,
+// 8x8 transform, second chroma offset 3.
+static const uint8_t kAvcPpsHigh[] = {
+    0x68, 0x5a, 0xf8, 0xf2, 0xc8, 0xd0,
+};
+
+// id 0 of SPS 3, CAVLC, QP 32, chroma offset -1, no High fields.
+static const uint8_t kAvcPpsBaseline[] = {
+    0x68, 0x90, 0xe0, 0x65, 0xc8,
+};
+
+// Three sub-layers, Main 10@5.1 with level 5.0 sub-layers, ordering info
+// of the top one only (DPB 6, 2 reorder), 1001/60000 timing.
+static const uint8_t kHevcVps[] = {
+    0x40, 0x01, 0x0c, 0x05, 0xff, 0xff, 0x02, 0x20, 0x00, 0x00, 0x03, 0x00,
+    0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x99, 0x50, 0x00, 0x96,
+    0x96, 0x19, 0xc0, 0xc0, 0x00, 0x00, 0xfa, 0x40, 0x00, 0x3a, 0x98, 0x14,
+};
+
+// Main 10@5.1, 1920x1088 cropped to 1080, 10 bit, 64x64 CTBs, AMP and
+// SAO, two short-term RPS (the second predicted), TMVP, strong intra
+// smoothing. VUI: extended SAR 4:3, BT.2020 PQ limited range.
+static const uint8_t kHevcSpsMain10[] = {
+    0x42, 0x01, 0x01, 0x02, 0x20, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00,
+    0x03, 0x00, 0x00, 0x03, 0x00, 0x99, 0xa0, 0x03, 0xc0, 0x80, 0x11, 0x07,
+    0xca, 0xd9, 0x65, 0x79, 0x24, 0x49, 0x9d, 0x76, 0xbf, 0xfc, 0x00, 0x10,
+    0x00, 0x0d, 0xa8, 0x48, 0x80, 0x48, 0x04,
+};
+
+// id 2, sign hiding, cabac_init, 3/1 refs, QP 22, transform skip, cu QP
+// delta depth 1, Cb/Cr offsets -1/2, weighted pred, 4x3 tiles with
+// explicit spacing, deblocking control with the filter on.
+static const uint8_t kHevcPpsTiles[] = {
+    0x44, 0x01, 0x70, 0x6e, 0x25, 0xa6, 0x44, 0x88, 0xc2, 0xc5, 0x8b, 0x31,
+    0xb8, 0x99, 0x20,
+};
+
+static size_t naiveFindStartCode(const uint8_t *data, size_t size, size_t offset) {
+    for (size_t i = offset; i + 3 <= size; ++i) {
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            return i;
+        }
+    }
+    return size;
+}
+
+TEST(SprdStartCodeTest, MatchesNaiveScan) {
+    srand(1);
+    for (int32_t round = 0; round < 200; ++round) {
+        std::vector<uint8_t> data(rand() % 300);
+        // Mostly zeros and ones, so near misses are common.
+        for (size_t i = 0; i < data.size(); ++i) {
+            int32_t r = rand() % 8;
+            data[i] = r < 4 ? 0 : r < 6 ? 1 : rand() & 0xff;
+        }
+        for (size_t offset = 0; offset <= data.size() + 1; ++offset) {
+            ASSERT_EQ(naiveFindStartCode(data.empty() ? NULL : &data[0], data.size(), offset),
+                    SprdFindStartCode(data.empty() ? NULL : &data[0], data.size(), offset))
+                    << "round " << round << " offset " << offset;
+        }
+    }
+}
+
+TEST(SprdStartCodeTest, EveryPositionInABlock) {
+    // One start code at each position of a buffer longer than two vector
+    // blocks, with no other zero bytes around it.
+    for (size_t at = 0; at + 3 <= 40; ++at) {
+        std::vector<uint8_t> data(40, 0x55);
+        data[at] = 0;
+        data[at + 1] = 0;
+        data[at + 2] = 1;
+        EXPECT_EQ(at, SprdFindStartCode(&data[0], data.size())) << "at " << at;
+        EXPECT_EQ(data.size(), SprdFindStartCode(&data[0], data.size(), at + 1)) << "at " << at;
+        // Cut off before the 01.
+        EXPECT_EQ(at + 2, SprdFindStartCode(&data[0], at + 2)) << "at " << at;
+    }
+}
+
+static std::vector<std::vector<uint8_t> > collectNals(const uint8_t *data, size_t size) {
+    std::vector<std::vector<uint8_t> > nals;
+    SprdNalIterator it(data, size);
+    const uint8_t *nal;
+    size_t nalSize;
+    while (it.next(&nal, &nalSize)) {
+        nals.push_back(std::vector<uint8_t>(nal, nal + nalSize));
+    }
+    return nals;
+}
+
+TEST(SprdNalIteratorTest, SplitsAnnexB) {
+    static const uint8_t kStream[] = {
+        0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00,   // trailing zero dropped
+        0x00, 0x00, 0x01, 0x68, 0xce,
+        0x00, 0x00, 0x00, 0x00, 0x01, 0x65, 0x88, 0x00, 0x00, 0x03, 0x01,
+        0x00, 0x00, 0x01,                           // empty NAL unit skipped
+        0x00, 0x00, 0x01, 0x41,
+    };
+    std::vector<std::vector<uint8_t> > nals = collectNals(kStream, sizeof(kStream));
+
+    ASSERT_EQ(4u, nals.size());
+    EXPECT_EQ(std::vector<uint8_t>({ 0x67, 0x42 }), nals[0]);
+    EXPECT_EQ(std::vector<uint8_t>({ 0x68, 0xce }), nals[1]);
+    EXPECT_EQ(std::vector<uint8_t>({ 0x65, 0x88, 0x00, 0x00, 0x03, 0x01 }), nals[2]);
+    EXPECT_EQ(std::vector<uint8_t>({ 0x41 }), nals[3]);
+}
+
+TEST(SprdNalIteratorTest, BufferWithoutLeadingStartCode) {
+    static const uint8_t kStream[] = {
+        0x67, 0x42, 0x00, 0x00, 0x01, 0x68, 0xce,
+    };
+    std::vector<std::vector<uint8_t> > nals = collectNals(kStream, sizeof(kStream));
+
+    ASSERT_EQ(2u, nals.size());
+    EXPECT_EQ(std::vector<uint8_t>({ 0x67, 0x42 }), nals[0]);
+    EXPECT_EQ(std::vector<uint8_t>({ 0x68, 0xce }), nals[1]);
+
+    EXPECT_TRUE(collectNals(kStream, 0).empty());
+}
+
+// Writes RBSP bits and inserts emulation prevention bytes as a NAL unit
+// does.
+struct NalWriter {
+    NalWriter() : mByte(0), mBits(0), mZeros(0) {}
+
+    void putBits(uint32_t value, uint32_t n) {
+        for (uint32_t i = n; i-- > 0;) {
+            mByte = (mByte << 1) | ((value >> i) & 1);
+            if (++mBits == 8) {
+                putByte(mByte);
+                mByte = 0;
+                mBits = 0;
+            }
+        }
+    }
+
+    void putUE(uint32_t value) {
+        uint64_t code = (uint64_t)value + 1;
+        uint32_t n = 0;
+        while ((code >> n) > 1) {
+            ++n;
+        }
+        putBits(0, n);
+        putBits(1, 1);
+        putBits((uint32_t)(code & ((1ull << n) - 1)), n);
+    }
+
+    void putSE(int32_t value) {
+        putUE(value > 0 ? 2 * (uint32_t)value - 1 : -2 * (int64_t)value);
+    }
+
+    void finish() {
+        putBits(1, 1);
+        while (mBits != 0) {
+            putBits(0, 1);
+        }
+    }
+
+    std::vector<uint8_t> mData;
+
+private:
+    uint32_t mByte;
+    uint32_t mBits;
+    uint32_t mZeros;
+
+    void putByte(uint8_t byte) {
+        if (mZeros >= 2 && byte <= 3) {
+            mData.push_back(3);
+            mZeros = 0;
+        }
+        mData.push_back(byte);
+        mZeros = byte == 0 ? mZeros + 1 : 0;
+    }
+};
+
+TEST(SprdBitReaderTest, SkipsEmulationPrevention) {
+    // 00 00 03 01 is 00 00 01 in the RBSP; a 03 not after two zeros stays.
+    static const uint8_t kNal[] = { 0x00, 0x00, 0x03, 0x01, 0x03, 0x00, 0x00, 0x03, 0x03 };
+    SprdBitReader br(kNal, sizeof(kNal));
+
+    EXPECT_EQ(0x000001u, br.getBits(24));
+    EXPECT_EQ(0x03u, br.getBits(8));
+    EXPECT_EQ(0x0000u, br.getBits(16));
+    EXPECT_EQ(0x03u, br.getBits(8));
+    EXPECT_FALSE(br.overflowed());
+
+    EXPECT_EQ(0u, br.getBits(1));
+    EXPECT_TRUE(br.overflowed());
+}
+
+TEST(SprdBitReaderTest, ExpGolombRoundTrip) {
+    static const uint32_t kUE[] = {
+        0, 1, 2, 3, 7, 8, 254, 255, 256, 65535, 1u << 20, 0x7ffffffe, 0xfffffffe,
+    };
+    static const int32_t kSE[] = {
+        0, 1, -1, 2, -2, 127, -128, 32767, -32768, 0x3fffffff, -0x3fffffff,
+    };
+
+    NalWriter writer;
+    for (size_t i = 0; i < sizeof(kUE) / sizeof(kUE[0]); ++i) {
+        writer.putUE(kUE[i]);
+        // Runs of zero bytes, so emulation prevention is exercised.
+        writer.putBits(0, 24);
+        writer.putBits(i & 3, 2);
+    }
+    for (size_t i = 0; i < sizeof(kSE) / sizeof(kSE[0]); ++i) {
+        writer.putSE(kSE[i]);
+        writer.putBits(0xa5, 8);
+    }
+    writer.finish();
+
+    SprdBitReader br(&writer.mData[0], writer.mData.size());
+    for (size_t i = 0; i < sizeof(kUE) / sizeof(kUE[0]); ++i) {
+        ASSERT_EQ(kUE[i], br.getUE()) << "ue " << i;
+        ASSERT_EQ(0u, br.getBits(24));
+        ASSERT_EQ(i & 3, br.getBits(2));
+    }
+    for (size_t i = 0; i < sizeof(kSE) / sizeof(kSE[0]); ++i) {
+        ASSERT_EQ(kSE[i], br.getSE()) << "se " << i;
+        ASSERT_EQ(0xa5u, br.getBits(8));
+    }
+    EXPECT_FALSE(br.moreRbspData());
+    EXPECT_FALSE(br.overflowed());
+}
+
+TEST(SprdBitReaderTest, MoreRbspData) {
+    // Every length of payload up to a few cache refills, each followed by
+    // the stop bit and a trailing zero byte.
+    for (uint32_t bits = 0; bits < 200; ++bits) {
+        NalWriter writer;
+        for (uint32_t i = 0; i < bits; ++i) {
+            writer.putBits(i % 3 == 0, 1);
+        }
+        writer.finish();
+        writer.mData.push_back(0);
+
+        SprdBitReader br(&writer.mData[0], writer.mData.size());
+        for (uint32_t i = 0; i < bits; ++i) {
+            ASSERT_TRUE(br.moreRbspData()) << bits << " bits, at " << i;
+            ASSERT_EQ(i % 3 == 0 ? 1u : 0u, br.getBit());
+        }
+        ASSERT_FALSE(br.moreRbspData()) << bits << " bits";
+    }
+}
+
+TEST(SprdBitReaderTest, OverlongExpGolombOverflows) {
+    static const uint8_t kZeros[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 };
+    SprdBitReader br(kZeros, sizeof(kZeros));
+    EXPECT_EQ(0u, br.getUE());
+    EXPECT_TRUE(br.overflowed());
+}
+
+TEST(SprdParameterSetsTest, AvcSpsHigh1080p) {
+    SprdAvcSps sps;
+    ASSERT_TRUE(SprdParseAvcSps(kAvcSpsHigh1080p, sizeof(kAvcSpsHigh1080p), &sps));
+
+    EXPECT_EQ(100, sps.mProfileIdc);
+    EXPECT_EQ(0, sps.mConstraintFlags);
+    EXPECT_EQ(40, sps.mLevelIdc);
+    EXPECT_EQ(0u, sps.mSpsId);
+    EXPECT_EQ(1u, sps.mChromaFormatIdc);
+    EXPECT_EQ(8u, sps.mBitDepthLuma);
+    EXPECT_EQ(8u, sps.mBitDepthChroma);
+    EXPECT_FALSE(sps.mScalingMatrixPresent);
+    EXPECT_EQ(4u, sps.mLog2MaxFrameNum);
+    EXPECT_EQ(0u, sps.mPicOrderCntType);
+    EXPECT_EQ(6u, sps.mLog2MaxPicOrderCntLsb);
+    EXPECT_EQ(4u, sps.mMaxNumRefFrames);
+    EXPECT_EQ(120u, sps.mWidthInMbs);
+    EXPECT_EQ(68u, sps.mHeightInMapUnits);
+    EXPECT_TRUE(sps.mFrameMbsOnly);
+    EXPECT_TRUE(sps.mDirect8x8Inference);
+    EXPECT_EQ(1920u, sps.mCodedWidth);
+    EXPECT_EQ(1088u, sps.mCodedHeight);
+    EXPECT_EQ(0u, sps.mCropLeft);
+    EXPECT_EQ(0u, sps.mCropRight);
+    EXPECT_EQ(0u, sps.mCropTop);
+    EXPECT_EQ(8u, sps.mCropBottom);
+
+    EXPECT_TRUE(sps.mVuiPresent);
+    EXPECT_EQ(1u, sps.mSarWidth);
+    EXPECT_EQ(1u, sps.mSarHeight);
+    EXPECT_TRUE(sps.mSignal.mFullRange);
+    EXPECT_EQ(1, sps.mSignal.mPrimaries);
+    EXPECT_EQ(1, sps.mSignal.mTransfer);
+    EXPECT_EQ(1, sps.mSignal.mMatrixCoeffs);
+    EXPECT_EQ(1001u, sps.mNumUnitsInTick);
+    EXPECT_EQ(60000u, sps.mTimeScale);
+    EXPECT_TRUE(sps.mFixedFrameRate);
+    EXPECT_EQ(2, sps.mMaxNumReorderFrames);
+    EXPECT_EQ(4, sps.mMaxDecFrameBuffering);
+}
+
+TEST(SprdParameterSetsTest, AvcSpsBaselineQcif) {
+    SprdAvcSps sps;
+    ASSERT_TRUE(SprdParseAvcSps(kAvcSpsBaselineQcif, sizeof(kAvcSpsBaselineQcif), &sps));
+
+    EXPECT_EQ(66, sps.mProfileIdc);
+    EXPECT_EQ(0xc0, sps.mConstraintFlags);
+    EXPECT_EQ(11, sps.mLevelIdc);
+    EXPECT_EQ(3u, sps.mSpsId);
+    EXPECT_EQ(1u, sps.mChromaFormatIdc);
+    EXPECT_EQ(9u, sps.mLog2MaxFrameNum);
+    EXPECT_EQ(2u, sps.mPicOrderCntType);
+    EXPECT_EQ(1u, sps.mMaxNumRefFrames);
+    EXPECT_TRUE(sps.mGapsInFrameNumAllowed);
+    EXPECT_EQ(176u, sps.mCodedWidth);
+    EXPECT_EQ(144u, sps.mCodedHeight);
+    EXPECT_FALSE(sps.mDirect8x8Inference);
+    EXPECT_EQ(0u, sps.mCropBottom);
+
+    EXPECT_FALSE(sps.mVuiPresent);
+    EXPECT_EQ(0u, sps.mSarWidth);
+    EXPECT_FALSE(sps.mSignal.mFullRange);
+    EXPECT_EQ(2, sps.mSignal.mPrimaries);
+    EXPECT_EQ(-1, sps.mMaxNumReorderFrames);
+    EXPECT_EQ(-1, sps.mMaxDecFrameBuffering);
+}
+
+TEST(SprdParameterSetsTest, AvcSpsMain576i) {
+    SprdAvcSps sps;
+    ASSERT_TRUE(SprdParseAvcSps(kAvcSpsMain576i, sizeof(kAvcSpsMain576i), &sps));
+
+    EXPECT_EQ(77, sps.mProfileIdc);
+    EXPECT_EQ(1u, sps.mSpsId);
+    EXPECT_EQ(1u, sps.mPicOrderCntType);
+    EXPECT_EQ(3u, sps.mMaxNumRefFrames);
+    EXPECT_EQ(45u, sps.mWidthInMbs);
+    EXPECT_EQ(18u, sps.mHeightInMapUnits);
+    EXPECT_FALSE(sps.mFrameMbsOnly);
+    EXPECT_TRUE(sps.mMbAdaptiveFrameField);
+    EXPECT_EQ(720u, sps.mCodedWidth);
+    EXPECT_EQ(576u, sps.mCodedHeight);
+
+    EXPECT_TRUE(sps.mVuiPresent);
+    EXPECT_EQ(64u, sps.mSarWidth);
+    EXPECT_EQ(45u, sps.mSarHeight);
+    EXPECT_EQ(0u, sps.mNumUnitsInTick);
+    EXPECT_EQ(-1, sps.mMaxNumReorderFrames);
+}
+
+TEST(SprdParameterSetsTest, AvcSpsTruncatedVuiKeepsTheRest) {
+    // Cut inside the timing info: the SPS still parses, without VUI.
+    SprdAvcSps sps;
+    ASSERT_TRUE(SprdParseAvcSps(kAvcSpsHigh1080p, 20, &sps));
+    EXPECT_FALSE(sps.mVuiPresent);
+    EXPECT_EQ(1920u, sps.mCodedWidth);
+    EXPECT_EQ(8u, sps.mCropBottom);
+
+    // Cut before the VUI: that is an error.
+    EXPECT_FALSE(SprdParseAvcSps(kAvcSpsHigh1080p, 8, &sps));
+}
+
+TEST(SprdParameterSetsTest, AvcPps) {
+    SprdAvcPps pps;
+    ASSERT_TRUE(SprdParseAvcPps(kAvcPpsHigh, sizeof(kAvcPpsHigh), &pps));
+    EXPECT_EQ(1u, pps.mPpsId);
+    EXPECT_EQ(0u, pps.mSpsId);
+    EXPECT_TRUE(pps.mEntropyCodingMode);
+    EXPECT_EQ(1u, pps.mNumSliceGroups);
+    EXPECT_EQ(3u, pps.mNumRefIdxL0Default);
+    EXPECT_EQ(1u, pps.mNumRefIdxL1Default);
+    EXPECT_TRUE(pps.mWeightedPred);
+    EXPECT_EQ(2u, pps.mWeightedBipredIdc);
+    EXPECT_EQ(23, pps.mPicInitQp);
+    EXPECT_EQ(26, pps.mPicInitQs);
+    EXPECT_EQ(-2, pps.mChromaQpIndexOffset);
+    EXPECT_TRUE(pps.mDeblockingFilterControlPresent);
+    EXPECT_TRUE(pps.mTransform8x8Mode);
+    EXPECT_FALSE(pps.mScalingMatrixPresent);
+    EXPECT_EQ(3, pps.mSecondChromaQpIndexOffset);
+
+    ASSERT_TRUE(SprdParseAvcPps(kAvcPpsBaseline, sizeof(kAvcPpsBaseline), &pps));
+    EXPECT_EQ(0u, pps.mPpsId);
+    EXPECT_EQ(3u, pps.mSpsId);
+    EXPECT_FALSE(pps.mEntropyCodingMode);
+    EXPECT_EQ(32, pps.mPicInitQp);
+    EXPECT_EQ(-1, pps.mChromaQpIndexOffset);
+    EXPECT_FALSE(pps.mTransform8x8Mode);
+    EXPECT_EQ(-1, pps.mSecondChromaQpIndexOffset);
+}
+
+TEST(SprdParameterSetsTest, HevcVps) {
+    SprdHevcVps vps;
+    ASSERT_TRUE(SprdParseHevcVps(kHevcVps, sizeof(kHevcVps), &vps));
+
+    EXPECT_EQ(0u, vps.mVpsId);
+    EXPECT_EQ(1u, vps.mMaxLayers);
+    EXPECT_EQ(3u, vps.mMaxSubLayers);
+    EXPECT_TRUE(vps.mTemporalIdNesting);
+    EXPECT_EQ(2u, vps.mPtl.mProfileIdc);
+    EXPECT_EQ(0x20000000u, vps.mPtl.mCompatibilityFlags);
+    EXPECT_TRUE(vps.mPtl.mProgressiveSource);
+    EXPECT_FALSE(vps.mPtl.mInterlacedSource);
+    EXPECT_TRUE(vps.mPtl.mFrameOnlyConstraint);
+    EXPECT_EQ(153u, vps.mPtl.mLevelIdc);
+    EXPECT_EQ(6u, vps.mMaxDecPicBuffering);
+    EXPECT_EQ(2u, vps.mMaxNumReorderPics);
+    EXPECT_EQ(1001u, vps.mNumUnitsInTick);
+    EXPECT_EQ(60000u, vps.mTimeScale);
+}
+
+TEST(SprdParameterSetsTest, HevcSps) {
+    SprdHevcSps sps;
+    ASSERT_TRUE(SprdParseHevcSps(kHevcSpsMain10, sizeof(kHevcSpsMain10), &sps));
+
+    EXPECT_EQ(1u, sps.mMaxSubLayers);
+    EXPECT_EQ(2u, sps.mPtl.mProfileIdc);
+    EXPECT_EQ(153u, sps.mPtl.mLevelIdc);
+    EXPECT_EQ(0u, sps.mSpsId);
+    EXPECT_EQ(1u, sps.mChromaFormatIdc);
+    EXPECT_EQ(1920u, sps.mCodedWidth);
+    EXPECT_EQ(1088u, sps.mCodedHeight);
+    EXPECT_EQ(8u, sps.mCropBottom);
+    EXPECT_EQ(10u, sps.mBitDepthLuma);
+    EXPECT_EQ(10u, sps.mBitDepthChroma);
+    EXPECT_EQ(8u, sps.mLog2MaxPicOrderCntLsb);
+    EXPECT_EQ(5u, sps.mMaxDecPicBuffering);
+    EXPECT_EQ(2u, sps.mMaxNumReorderPics);
+    EXPECT_EQ(3u, sps.mLog2MinCbSize);
+    EXPECT_EQ(6u, sps.mLog2CtbSize);
+    EXPECT_EQ(2u, sps.mLog2MinTbSize);
+    EXPECT_EQ(5u, sps.mLog2MaxTbSize);
+    EXPECT_EQ(1u, sps.mMaxTransformHierarchyDepthInter);
+    EXPECT_EQ(1u, sps.mMaxTransformHierarchyDepthIntra);
+    EXPECT_FALSE(sps.mScalingListEnabled);
+    EXPECT_TRUE(sps.mAmpEnabled);
+    EXPECT_TRUE(sps.mSaoEnabled);
+    EXPECT_FALSE(sps.mPcmEnabled);
+    EXPECT_EQ(2u, sps.mNumShortTermRefPicSets);
+    EXPECT_FALSE(sps.mLongTermRefPicsPresent);
+    EXPECT_TRUE(sps.mTemporalMvpEnabled);
+    EXPECT_TRUE(sps.mStrongIntraSmoothing);
+
+    EXPECT_TRUE(sps.mVuiPresent);
+    EXPECT_EQ(4u, sps.mSarWidth);
+    EXPECT_EQ(3u, sps.mSarHeight);
+    EXPECT_FALSE(sps.mSignal.mFullRange);
+    EXPECT_EQ(9, sps.mSignal.mPrimaries);
+    EXPECT_EQ(16, sps.mSignal.mTransfer);
+    EXPECT_EQ(9, sps.mSignal.mMatrixCoeffs);
+}
+
+TEST(SprdParameterSetsTest, HevcPps) {
+    SprdHevcPps pps;
+    ASSERT_TRUE(SprdParseHevcPps(kHevcPpsTiles, sizeof(kHevcPpsTiles), &pps));
+
+    EXPECT_EQ(2u, pps.mPpsId);
+    EXPECT_EQ(0u, pps.mSpsId);
+    EXPECT_TRUE(pps.mSignDataHiding);
+    EXPECT_TRUE(pps.mCabacInitPresent);
+    EXPECT_EQ(3u, pps.mNumRefIdxL0Default);
+    EXPECT_EQ(1u, pps.mNumRefIdxL1Default);
+    EXPECT_EQ(22, pps.mInitQp);
+    EXPECT_TRUE(pps.mTransformSkip);
+    EXPECT_TRUE(pps.mCuQpDeltaEnabled);
+    EXPECT_EQ(1u, pps.mDiffCuQpDeltaDepth);
+    EXPECT_EQ(-1, pps.mCbQpOffset);
+    EXPECT_EQ(2, pps.mCrQpOffset);
+    EXPECT_TRUE(pps.mWeightedPred);
+    EXPECT_FALSE(pps.mWeightedBipred);
+    EXPECT_TRUE(pps.mTilesEnabled);
+    EXPECT_EQ(4u, pps.mNumTileColumns);
+    EXPECT_EQ(3u, pps.mNumTileRows);
+    EXPECT_TRUE(pps.mLoopFilterAcrossSlices);
+    EXPECT_TRUE(pps.mDeblockingFilterControlPresent);
+    EXPECT_FALSE(pps.mDeblockingFilterDisabled);
+}
+
+TEST(SprdParameterSetsTest, RejectsOtherNalTypes) {
+    SprdAvcSps avcSps;
+    SprdAvcPps avcPps;
+    SprdHevcVps vps;
+    SprdHevcSps hevcSps;
+    SprdHevcPps hevcPps;
+
+    EXPECT_FALSE(SprdParseAvcSps(kAvcPpsHigh, sizeof(kAvcPpsHigh), &avcSps));
+    EXPECT_FALSE(SprdParseAvcPps(kAvcSpsHigh1080p, sizeof(kAvcSpsHigh1080p), &avcPps));
+    EXPECT_FALSE(SprdParseHevcVps(kHevcSpsMain10, sizeof(kHevcSpsMain10), &vps));
+    EXPECT_FALSE(SprdParseHevcSps(kHevcPpsTiles, sizeof(kHevcPpsTiles), &hevcSps));
+    EXPECT_FALSE(SprdParseHevcPps(kHevcVps, sizeof(kHevcVps), &hevcPps));
+}
+
+TEST(SprdParameterSetsTest, TruncatedHevcFails) {
+    // Every cut before the last field the parsers read.
+    SprdHevcVps vps;
+    SprdHevcSps sps;
+    SprdHevcPps pps;
+    for (size_t size = 0; size < 31; ++size) {
+        EXPECT_FALSE(SprdParseHevcVps(kHevcVps, size, &vps)) << "size " << size;
+    }
+    for (size_t size = 0; size < 30; ++size) {
+        EXPECT_FALSE(SprdParseHevcSps(kHevcSpsMain10, size, &sps)) << "size " << size;
+    }
+    for (size_t size = 0; size < 12; ++size) {
+        EXPECT_FALSE(SprdParseHevcPps(kHevcPpsTiles, size, &pps)) << "size " << size;
+    }
+}
+
+}  // namespace android
@@ -0,0 +1,47 @@
+LOCAL_PATH := $(call my-dir)
+
+sprd_colorconvert_src_files := \
+    SprdColorConvert.cpp       \
+    SprdColorConvertNeon.cpp   \
+    SprdColorConvertX86.cpp
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(sprd_colorconvert_src_files)
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/include
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/include
+
+LOCAL_SHARED_LIBRARIES := liblog
+
+LOCAL_CFLAGS := -O3
+
+LOCAL_ARM_MODE := arm
+LOCAL_ARM_NEON := true
+
+LOCAL_MODULE := libsprd_colorconvert
+LOCAL_MODULE_TAGS := optional
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_STATIC_LIBRARY)
+
+# The same kernels for x86 hosts, so they can be exercised off target.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := $(sprd_colorconvert_src_files)
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/include
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/include
+
+LOCAL_SHARED_LIBRARIES := liblog
+
+LOCAL_CFLAGS := -O3
+
+LOCAL_MODULE := libsprd_colorconvert
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_STATIC_LIBRARY)
+
+################################################################################
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
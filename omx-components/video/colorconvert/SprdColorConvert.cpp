@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdColorConvert"
+#include <utils/Log.h>
+
+#include "include/SprdColorConvert.h"
+#include "SprdColorConvertKernels.h"
+
+#include <pthread.h>
+#include <string.h>
+
+namespace android {
+
+// Coefficients scaled by 256. The full range chroma ones are capped at 127
+// so the sums fit in 16 bits (see kSprdChromaBias).
+static const struct {
+    int16_t mY[3];
+    int16_t mU[3];
+    int16_t mV[3];
+    uint8_t mYOffset;
+} kMatrices[] = {
+    // kSprdColorBT601Limited, the matrix the encoders always used.
+    { { 66, 129, 25 }, { -38, -74, 112 }, { 112, -94, -18 }, 16 },
+    // kSprdColorBT601Full
+    { { 77, 150, 29 }, { -43, -84, 127 }, { 127, -106, -21 }, 0 },
+    // kSprdColorBT709Limited
+    { { 47, 157, 16 }, { -26, -86, 112 }, { 112, -102, -10 }, 16 },
+    // kSprdColorBT709Full
+    { { 54, 183, 19 }, { -29, -98, 127 }, { 127, -115, -12 }, 0 },
+};
+
+// Byte offsets of R, G and B for each SprdRgbLayout.
+static const uint8_t kLayouts[][3] = {
+    { 0, 1, 2 },    // RGBA
+    { 2, 1, 0 },    // BGRA
+    { 1, 2, 3 },    // ARGB
+    { 3, 2, 1 },    // ABGR
+};
+
+static inline uint8_t luma(const uint8_t *p, const SprdColorCoeffs *c) {
+    return (c->mY[0] * p[c->mIndex[0]] + c->mY[1] * p[c->mIndex[1]]
+            + c->mY[2] * p[c->mIndex[2]] + c->mYBias) >> 8;
+}
+
+static inline uint8_t chroma(const int16_t *k, int32_t r, int32_t g, int32_t b) {
+    return (k[0] * r + k[1] * g + k[2] * b + kSprdChromaBias) >> 8;
+}
+
+// Converts pixels [x, width) of a row pair. An odd width repeats the last
+// column for the chroma average.
+static void rgbRowPairC(const uint8_t *src0, const uint8_t *src1,
+        uint8_t *dstY0, uint8_t *dstY1, uint8_t *dstUV,
+        int32_t x, int32_t width, const SprdColorCoeffs *c) {
+    for (; x < width; x += 2) {
+        const uint8_t *a0 = src0 + 4 * x;
+        const uint8_t *a1 = src1 + 4 * x;
+        const uint8_t *b0 = x + 1 < width ? a0 + 4 : a0;
+        const uint8_t *b1 = x + 1 < width ? a1 + 4 : a1;
+
+        dstY0[x] = luma(a0, c);
+        dstY1[x] = luma(a1, c);
+        if (x + 1 < width) {
+            dstY0[x + 1] = luma(b0, c);
+            dstY1[x + 1] = luma(b1, c);
+        }
+
+        int32_t avg[3];
+        for (int32_t i = 0; i < 3; ++i) {
+            int32_t k = c->mIndex[i];
+            avg[i] = (a0[k] + b0[k] + a1[k] + b1[k] + 2) >> 2;
+        }
+        dstUV[x] = chroma(c->mFirst, avg[0], avg[1], avg[2]);
+        dstUV[x + 1] = chroma(c->mSecond, avg[0], avg[1], avg[2]);
+    }
+}
+
+static void interleaveRowC(const uint8_t *first, const uint8_t *second,
+        uint8_t *dst, int32_t i, int32_t count) {
+    for (; i < count; ++i) {
+        dst[2 * i] = first[i];
+        dst[2 * i + 1] = second[i];
+    }
+}
+
+static void averageInterleaveRowC(const uint8_t *first0, const uint8_t *first1,
+        const uint8_t *second0, const uint8_t *second1,
+        uint8_t *dst, int32_t i, int32_t count) {
+    for (; i < count; ++i) {
+        dst[2 * i] = (first0[i] + first1[i] + 1) >> 1;
+        dst[2 * i + 1] = (second0[i] + second1[i] + 1) >> 1;
+    }
+}
+
+static void swapChromaC(uint8_t *uv, size_t i, size_t size) {
+    for (; i + 1 < size; i += 2) {
+        uint8_t tmp = uv[i];
+        uv[i] = uv[i + 1];
+        uv[i + 1] = tmp;
+    }
+}
+
+static int32_t rgbRowPairNone(const uint8_t *, const uint8_t *,
+        uint8_t *, uint8_t *, uint8_t *, int32_t, const SprdColorCoeffs *) {
+    return 0;
+}
+
+static int32_t interleaveRowNone(const uint8_t *, const uint8_t *, uint8_t *, int32_t) {
+    return 0;
+}
+
+static int32_t averageInterleaveRowNone(const uint8_t *, const uint8_t *,
+        const uint8_t *, const uint8_t *, uint8_t *, int32_t) {
+    return 0;
+}
+
+static size_t swapChromaNone(uint8_t *, size_t) {
+    return 0;
+}
+
+static const SprdColorKernels kCKernels = {
+    "c", rgbRowPairNone, interleaveRowNone, averageInterleaveRowNone, swapChromaNone,
+};
+
+static pthread_once_t gKernelsOnce = PTHREAD_ONCE_INIT;
+static const SprdColorKernels *gKernels = &kCKernels;
+
+static void selectKernels() {
+    const SprdColorKernels *kernels = SprdGetNeonColorKernels();
+    if (kernels == NULL) {
+        kernels = SprdGetAvx2ColorKernels();
+    }
+    if (kernels == NULL) {
+        kernels = SprdGetSsse3ColorKernels();
+    }
+    if (kernels != NULL) {
+        gKernels = kernels;
+    }
+    ALOGI("using %s kernels", gKernels->mName);
+}
+
+static const SprdColorKernels *getKernels() {
+    pthread_once(&gKernelsOnce, selectKernels);
+    return gKernels;
+}
+
+const char *SprdColorConvertKernelName() {
+    return getKernels()->mName;
+}
+
+const SprdColorKernels *SprdGetCColorKernels() {
+    return &kCKernels;
+}
+
+void SprdSetColorKernels(const SprdColorKernels *kernels) {
+    getKernels();
+    gKernels = kernels != NULL ? kernels : &kCKernels;
+}
+
+void SprdConvertI420ToSemiPlanar(
+        const uint8_t *srcY, size_t srcStrideY,
+        const uint8_t *srcU, const uint8_t *srcV, size_t srcStrideUV,
+        uint8_t *dstY, size_t dstStrideY, uint8_t *dstUV, size_t dstStrideUV,
+        int32_t width, int32_t height, SprdChromaOrder order) {
+    const SprdColorKernels *kernels = getKernels();
+
+    if (srcStrideY == dstStrideY && srcStrideY == (size_t)width) {
+        memcpy(dstY, srcY, (size_t)width * height);
+    } else {
+        for (int32_t y = 0; y < height; ++y) {
+            memcpy(dstY + y * dstStrideY, srcY + y * srcStrideY, width);
+        }
+    }
+
+    const uint8_t *first = order == kSprdChromaUV ? srcU : srcV;
+    const uint8_t *second = order == kSprdChromaUV ? srcV : srcU;
+    int32_t count = (width + 1) / 2;
+    for (int32_t y = 0; y < (height + 1) / 2; ++y) {
+        uint8_t *dst = dstUV + y * dstStrideUV;
+        int32_t done = (*kernels->interleaveRow)(first, second, dst, count);
+        interleaveRowC(first, second, dst, done, count);
+        first += srcStrideUV;
+        second += srcStrideUV;
+    }
+}
+
+void SprdConvertRGBToSemiPlanar(
+        const uint8_t *src, size_t srcStride, SprdRgbLayout layout,
+        SprdColorMatrix matrix,
+        uint8_t *dstY, size_t dstStrideY, uint8_t *dstUV, size_t dstStrideUV,
+        int32_t width, int32_t height, SprdChromaOrder order) {
+    const SprdColorKernels *kernels = getKernels();
+
+    SprdColorCoeffs coeffs;
+    const int16_t *first = order == kSprdChromaUV ? kMatrices[matrix].mU : kMatrices[matrix].mV;
+    const int16_t *second = order == kSprdChromaUV ? kMatrices[matrix].mV : kMatrices[matrix].mU;
+    for (int32_t i = 0; i < 3; ++i) {
+        coeffs.mY[i] = kMatrices[matrix].mY[i];
+        coeffs.mFirst[i] = first[i];
+        coeffs.mSecond[i] = second[i];
+        coeffs.mIndex[i] = kLayouts[layout][i];
+    }
+    coeffs.mYBias = (kMatrices[matrix].mYOffset << 8) + 128;
+
+    int32_t evenWidth = width & ~1;
+    for (int32_t y = 0; y < height; y += 2) {
+        const uint8_t *src0 = src + y * srcStride;
+        uint8_t *dstY0 = dstY + y * dstStrideY;
+        // An odd last row is paired with itself.
+        const uint8_t *src1 = y + 1 < height ? src0 + srcStride : src0;
+        uint8_t *dstY1 = y + 1 < height ? dstY0 + dstStrideY : dstY0;
+        uint8_t *uv = dstUV + (y / 2) * dstStrideUV;
+
+        int32_t done = (*kernels->rgbRowPair)(
+                src0, src1, dstY0, dstY1, uv, evenWidth, &coeffs);
+        rgbRowPairC(src0, src1, dstY0, dstY1, uv, done, width, &coeffs);
+    }
+}
+
+namespace {
+
+struct I420FrameJob {
+    const uint8_t *mSrc;
+    int32_t mWidth;
+    int32_t mHeight;
+    uint8_t *mDst;
+    int32_t mDstWidth;
+    int32_t mDstHeight;
+    SprdChromaOrder mOrder;
+};
+
+struct RGBFrameJob {
+    const uint8_t *mSrc;
+    SprdRgbLayout mLayout;
+    SprdColorMatrix mMatrix;
+    int32_t mWidth;
+    uint8_t *mDst;
+    int32_t mDstWidth;
+    int32_t mDstHeight;
+    SprdChromaOrder mOrder;
+};
+
+}  // namespace
+
+// Rows [begin, end) of a frame; begin is even.
+static void I420FrameStripe(void *cookie, int32_t begin, int32_t end) {
+    const I420FrameJob *job = static_cast<const I420FrameJob *>(cookie);
+    int32_t chromaWidth = job->mWidth / 2;
+    const uint8_t *srcU = job->mSrc + job->mWidth * job->mHeight;
+    const uint8_t *srcV = srcU + chromaWidth * (job->mHeight / 2);
+    uint8_t *dstUV = job->mDst + job->mDstWidth * job->mDstHeight;
+
+    SprdConvertI420ToSemiPlanar(
+            job->mSrc + begin * job->mWidth, job->mWidth,
+            srcU + (begin / 2) * chromaWidth, srcV + (begin / 2) * chromaWidth, chromaWidth,
+            job->mDst + begin * job->mDstWidth, job->mDstWidth,
+            dstUV + (begin / 2) * job->mDstWidth, job->mDstWidth,
+            job->mWidth, end - begin, job->mOrder);
+}
+
+static void RGBFrameStripe(void *cookie, int32_t begin, int32_t end) {
+    const RGBFrameJob *job = static_cast<const RGBFrameJob *>(cookie);
+    uint8_t *dstUV = job->mDst + job->mDstWidth * job->mDstHeight;
+
+    SprdConvertRGBToSemiPlanar(
+            job->mSrc + begin * job->mWidth * 4, job->mWidth * 4, job->mLayout, job->mMatrix,
+            job->mDst + begin * job->mDstWidth, job->mDstWidth,
+            dstUV + (begin / 2) * job->mDstWidth, job->mDstWidth,
+            job->mWidth, end - begin, job->mOrder);
+}
+
+void SprdConvertI420FrameToSemiPlanar(
+        const uint8_t *src, int32_t width, int32_t height,
+        uint8_t *dst, int32_t dstWidth, int32_t dstHeight, SprdChromaOrder order,
+        SprdStripeRunFunc run, void *runCookie) {
+    I420FrameJob job;
+    job.mSrc = src;
+    job.mWidth = width;
+    job.mHeight = height;
+    job.mDst = dst;
+    job.mDstWidth = dstWidth;
+    job.mDstHeight = dstHeight;
+    job.mOrder = order;
+
+    if (run == NULL) {
+        I420FrameStripe(&job, 0, height);
+    } else {
+        (*run)(runCookie, I420FrameStripe, &job, height, width * 3, 2);
+    }
+}
+
+void SprdConvertRGBFrameToSemiPlanar(
+        const uint8_t *src, SprdRgbLayout layout, SprdColorMatrix matrix,
+        int32_t width, int32_t height,
+        uint8_t *dst, int32_t dstWidth, int32_t dstHeight, SprdChromaOrder order,
+        SprdStripeRunFunc run, void *runCookie) {
+    RGBFrameJob job;
+    job.mSrc = src;
+    job.mLayout = layout;
+    job.mMatrix = matrix;
+    job.mWidth = width;
+    job.mDst = dst;
+    job.mDstWidth = dstWidth;
+    job.mDstHeight = dstHeight;
+    job.mOrder = order;
+
+    if (run == NULL) {
+        RGBFrameStripe(&job, 0, height);
+    } else {
+        (*run)(runCookie, RGBFrameStripe, &job, height, width * 4 + width * 3 / 2, 2);
+    }
+}
+
+void SprdMergeChromaPlanes(
+        const uint8_t *srcU, const uint8_t *srcV, size_t srcStride,
+        uint8_t *dstUV, size_t dstStride, int32_t count, int32_t dstRows,
+        int32_t vertical, SprdChromaOrder order) {
+    const SprdColorKernels *kernels = getKernels();
+
+    const uint8_t *first = order == kSprdChromaUV ? srcU : srcV;
+    const uint8_t *second = order == kSprdChromaUV ? srcV : srcU;
+    for (int32_t y = 0; y < dstRows; ++y) {
+        uint8_t *dst = dstUV + y * dstStride;
+        if (vertical == 2) {
+            const uint8_t *first1 = first + srcStride;
+            const uint8_t *second1 = second + srcStride;
+            int32_t done = (*kernels->averageInterleaveRow)(
+                    first, first1, second, second1, dst, count);
+            averageInterleaveRowC(first, first1, second, second1, dst, done, count);
+        } else {
+            int32_t done = (*kernels->interleaveRow)(first, second, dst, count);
+            interleaveRowC(first, second, dst, done, count);
+        }
+        first += vertical * srcStride;
+        second += vertical * srcStride;
+    }
+}
+
+void SprdSwapChromaOrder(uint8_t *uv, size_t size) {
+    size_t done = (*getKernels()->swapChroma)(uv, size);
+    swapChromaC(uv, done, size);
+}
+
+}  // namespace android
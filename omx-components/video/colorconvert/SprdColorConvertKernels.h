@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPRD_COLOR_CONVERT_KERNELS_H_
+
+#define SPRD_COLOR_CONVERT_KERNELS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// Added before the >> 8 of the chroma sums: the 128 offset plus rounding.
+// All coefficients are chosen so that every sum, biases included, stays
+// within [0, 65535]; the vector kernels rely on that to work in 16 bit
+// lanes with wrapping arithmetic.
+enum {
+    kSprdChromaBias = (128 << 8) + 128,
+};
+
+struct SprdColorCoeffs {
+    int16_t mY[3];          // R, G, B
+    int16_t mFirst[3];      // chroma sample stored first (U for NV12)
+    int16_t mSecond[3];
+    uint16_t mYBias;        // luma offset << 8, plus rounding
+    uint8_t mIndex[3];      // byte offset of R, G and B within a pixel
+};
+
+// Each row function converts the longest prefix of the row it has a
+// vector loop for and returns the number of pixels (chroma pairs for
+// interleave, bytes for swap) it handled; the caller finishes the rest
+// with the C version.
+struct SprdColorKernels {
+    const char *mName;
+
+    // Two rows of width pixels (width even) into two luma rows and one
+    // chroma row. src1/dstY1 may alias src0/dstY0 for the last odd row.
+    int32_t (*rgbRowPair)(const uint8_t *src0, const uint8_t *src1,
+            uint8_t *dstY0, uint8_t *dstY1, uint8_t *dstUV,
+            int32_t width, const SprdColorCoeffs *coeffs);
+
+    int32_t (*interleaveRow)(const uint8_t *first, const uint8_t *second,
+            uint8_t *dst, int32_t count);
+
+    // interleaveRow of the rounded averages of two rows per plane.
+    int32_t (*averageInterleaveRow)(const uint8_t *first0, const uint8_t *first1,
+            const uint8_t *second0, const uint8_t *second1,
+            uint8_t *dst, int32_t count);
+
+    size_t (*swapChroma)(uint8_t *uv, size_t size);
+};
+
+// NULL when the kernels are not built for this target or the CPU lacks
+// the instructions.
+const SprdColorKernels *SprdGetNeonColorKernels();
+const SprdColorKernels *SprdGetSsse3ColorKernels();
+const SprdColorKernels *SprdGetAvx2ColorKernels();
+
+// The plain C set, which leaves every pixel to the row tail code.
+const SprdColorKernels *SprdGetCColorKernels();
+
+// Replaces the kernels picked at run time, for tests and benchmarks.
+// NULL goes back to the C set. Not safe while conversions are running.
+void SprdSetColorKernels(const SprdColorKernels *kernels);
+
+}  // namespace android
+
+#endif  // SPRD_COLOR_CONVERT_KERNELS_H_
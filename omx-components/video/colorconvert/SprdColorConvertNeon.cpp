@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SprdColorConvertKernels.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace android {
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+static inline uint8x8_t lumaNeon(uint8x8_t r, uint8x8_t g, uint8x8_t b,
+        uint8x8_t kr, uint8x8_t kg, uint8x8_t kb, uint16x8_t bias) {
+    uint16x8_t y = vmlal_u8(bias, r, kr);
+    y = vmlal_u8(y, g, kg);
+    y = vmlal_u8(y, b, kb);
+    return vshrn_n_u16(y, 8);
+}
+
+// Signed coefficients in wrapping 16 bit arithmetic; the sum is known to
+// land in [0, 65535].
+static inline uint8x8_t chromaNeon(uint16x8_t r, uint16x8_t g, uint16x8_t b,
+        const int16_t *k, uint16x8_t bias) {
+    uint16x8_t c = vmlaq_n_u16(bias, r, (uint16_t)k[0]);
+    c = vmlaq_n_u16(c, g, (uint16_t)k[1]);
+    c = vmlaq_n_u16(c, b, (uint16_t)k[2]);
+    return vshrn_n_u16(c, 8);
+}
+
+static int32_t rgbRowPairNeon(const uint8_t *src0, const uint8_t *src1,
+        uint8_t *dstY0, uint8_t *dstY1, uint8_t *dstUV,
+        int32_t width, const SprdColorCoeffs *coeffs) {
+    const uint8x8_t kr = vdup_n_u8(coeffs->mY[0]);
+    const uint8x8_t kg = vdup_n_u8(coeffs->mY[1]);
+    const uint8x8_t kb = vdup_n_u8(coeffs->mY[2]);
+    const uint16x8_t yBias = vdupq_n_u16(coeffs->mYBias);
+    const uint16x8_t cBias = vdupq_n_u16(kSprdChromaBias);
+    const int ri = coeffs->mIndex[0];
+    const int gi = coeffs->mIndex[1];
+    const int bi = coeffs->mIndex[2];
+
+    int32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16x4_t p0 = vld4q_u8(src0 + 4 * x);
+        uint8x16x4_t p1 = vld4q_u8(src1 + 4 * x);
+
+        uint8x16_t r0 = p0.val[ri], g0 = p0.val[gi], b0 = p0.val[bi];
+        uint8x16_t r1 = p1.val[ri], g1 = p1.val[gi], b1 = p1.val[bi];
+
+        vst1q_u8(dstY0 + x, vcombine_u8(
+                lumaNeon(vget_low_u8(r0), vget_low_u8(g0), vget_low_u8(b0), kr, kg, kb, yBias),
+                lumaNeon(vget_high_u8(r0), vget_high_u8(g0), vget_high_u8(b0), kr, kg, kb, yBias)));
+        vst1q_u8(dstY1 + x, vcombine_u8(
+                lumaNeon(vget_low_u8(r1), vget_low_u8(g1), vget_low_u8(b1), kr, kg, kb, yBias),
+                lumaNeon(vget_high_u8(r1), vget_high_u8(g1), vget_high_u8(b1), kr, kg, kb, yBias)));
+
+        // 2x2 averages of the 8 chroma sites.
+        uint16x8_t r = vrshrq_n_u16(vpadalq_u8(vpaddlq_u8(r0), r1), 2);
+        uint16x8_t g = vrshrq_n_u16(vpadalq_u8(vpaddlq_u8(g0), g1), 2);
+        uint16x8_t b = vrshrq_n_u16(vpadalq_u8(vpaddlq_u8(b0), b1), 2);
+
+        uint8x8x2_t uv;
+        uv.val[0] = chromaNeon(r, g, b, coeffs->mFirst, cBias);
+        uv.val[1] = chromaNeon(r, g, b, coeffs->mSecond, cBias);
+        vst2_u8(dstUV + x, uv);
+    }
+    return x;
+}
+
+static int32_t interleaveRowNeon(const uint8_t *first, const uint8_t *second,
+        uint8_t *dst, int32_t count) {
+    int32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x2_t uv;
+        uv.val[0] = vld1q_u8(first + i);
+        uv.val[1] = vld1q_u8(second + i);
+        vst2q_u8(dst + 2 * i, uv);
+    }
+    return i;
+}
+
+static int32_t averageInterleaveRowNeon(const uint8_t *first0, const uint8_t *first1,
+        const uint8_t *second0, const uint8_t *second1,
+        uint8_t *dst, int32_t count) {
+    int32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x2_t uv;
+        uv.val[0] = vrhaddq_u8(vld1q_u8(first0 + i), vld1q_u8(first1 + i));
+        uv.val[1] = vrhaddq_u8(vld1q_u8(second0 + i), vld1q_u8(second1 + i));
+        vst2q_u8(dst + 2 * i, uv);
+    }
+    return i;
+}
+
+static size_t swapChromaNeon(uint8_t *uv, size_t size) {
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        vst1q_u8(uv + i, vrev16q_u8(vld1q_u8(uv + i)));
+    }
+    return i;
+}
+
+static const SprdColorKernels kNeonKernels = {
+    "neon", rgbRowPairNeon, interleaveRowNeon, averageInterleaveRowNeon, swapChromaNeon,
+};
+
+// NEON is mandatory on arm64 and on every ARMv7 target this is built for.
+const SprdColorKernels *SprdGetNeonColorKernels() {
+    return &kNeonKernels;
+}
+
+#else
+
+const SprdColorKernels *SprdGetNeonColorKernels() {
+    return NULL;
+}
+
+#endif
+
+}  // namespace android
@@ -0,0 +1,322 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SprdColorConvertKernels.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace android {
+
+#if defined(__i386__) || defined(__x86_64__)
+
+// The file is built for the baseline ABI; only these functions use the
+// newer instructions, and only after the CPU was checked for them.
+#define SPRD_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define SPRD_TARGET_AVX2 __attribute__((target("avx2")))
+
+//////////////////////////////////////////////////////////////////////////////
+// SSSE3: 16 pixels per row and iteration.
+
+// One channel of 8 pixels as 16 bit lanes.
+SPRD_TARGET_SSSE3
+static inline __m128i channelSsse3(__m128i lo, __m128i hi, __m128i shift) {
+    const __m128i mask = _mm_set1_epi32(0xff);
+    return _mm_packs_epi32(_mm_and_si128(_mm_srl_epi32(lo, shift), mask),
+            _mm_and_si128(_mm_srl_epi32(hi, shift), mask));
+}
+
+// (k0 * a + k1 * b + k2 * c + bias) >> 8 in wrapping 16 bit arithmetic.
+SPRD_TARGET_SSSE3
+static inline __m128i dotSsse3(__m128i a, __m128i b, __m128i c,
+        __m128i k0, __m128i k1, __m128i k2, __m128i bias) {
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a, k0), _mm_mullo_epi16(b, k1));
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(c, k2));
+    return _mm_srli_epi16(_mm_add_epi16(sum, bias), 8);
+}
+
+// Sums horizontally adjacent pixels of two 8 pixel groups: 8 sums.
+SPRD_TARGET_SSSE3
+static inline __m128i pairSumSsse3(__m128i lo, __m128i hi) {
+    const __m128i ones = _mm_set1_epi16(1);
+    return _mm_packs_epi32(_mm_madd_epi16(lo, ones), _mm_madd_epi16(hi, ones));
+}
+
+SPRD_TARGET_SSSE3
+static int32_t rgbRowPairSsse3(const uint8_t *src0, const uint8_t *src1,
+        uint8_t *dstY0, uint8_t *dstY1, uint8_t *dstUV,
+        int32_t width, const SprdColorCoeffs *coeffs) {
+    const __m128i shiftR = _mm_cvtsi32_si128(coeffs->mIndex[0] * 8);
+    const __m128i shiftG = _mm_cvtsi32_si128(coeffs->mIndex[1] * 8);
+    const __m128i shiftB = _mm_cvtsi32_si128(coeffs->mIndex[2] * 8);
+    const __m128i kyr = _mm_set1_epi16(coeffs->mY[0]);
+    const __m128i kyg = _mm_set1_epi16(coeffs->mY[1]);
+    const __m128i kyb = _mm_set1_epi16(coeffs->mY[2]);
+    const __m128i k1r = _mm_set1_epi16(coeffs->mFirst[0]);
+    const __m128i k1g = _mm_set1_epi16(coeffs->mFirst[1]);
+    const __m128i k1b = _mm_set1_epi16(coeffs->mFirst[2]);
+    const __m128i k2r = _mm_set1_epi16(coeffs->mSecond[0]);
+    const __m128i k2g = _mm_set1_epi16(coeffs->mSecond[1]);
+    const __m128i k2b = _mm_set1_epi16(coeffs->mSecond[2]);
+    const __m128i yBias = _mm_set1_epi16(coeffs->mYBias);
+    const __m128i cBias = _mm_set1_epi16((int16_t)kSprdChromaBias);
+    const __m128i two = _mm_set1_epi16(2);
+
+    int32_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        const __m128i *p0 = (const __m128i *)(src0 + 4 * x);
+        const __m128i *p1 = (const __m128i *)(src1 + 4 * x);
+        __m128i a0 = _mm_loadu_si128(p0), a1 = _mm_loadu_si128(p0 + 1);
+        __m128i a2 = _mm_loadu_si128(p0 + 2), a3 = _mm_loadu_si128(p0 + 3);
+        __m128i b0 = _mm_loadu_si128(p1), b1 = _mm_loadu_si128(p1 + 1);
+        __m128i b2 = _mm_loadu_si128(p1 + 2), b3 = _mm_loadu_si128(p1 + 3);
+
+        // Pixels 0-7 (lo) and 8-15 (hi) of both rows.
+        __m128i r0lo = channelSsse3(a0, a1, shiftR), r0hi = channelSsse3(a2, a3, shiftR);
+        __m128i g0lo = channelSsse3(a0, a1, shiftG), g0hi = channelSsse3(a2, a3, shiftG);
+        __m128i b0lo = channelSsse3(a0, a1, shiftB), b0hi = channelSsse3(a2, a3, shiftB);
+        __m128i r1lo = channelSsse3(b0, b1, shiftR), r1hi = channelSsse3(b2, b3, shiftR);
+        __m128i g1lo = channelSsse3(b0, b1, shiftG), g1hi = channelSsse3(b2, b3, shiftG);
+        __m128i b1lo = channelSsse3(b0, b1, shiftB), b1hi = channelSsse3(b2, b3, shiftB);
+
+        _mm_storeu_si128((__m128i *)(dstY0 + x), _mm_packus_epi16(
+                dotSsse3(r0lo, g0lo, b0lo, kyr, kyg, kyb, yBias),
+                dotSsse3(r0hi, g0hi, b0hi, kyr, kyg, kyb, yBias)));
+        _mm_storeu_si128((__m128i *)(dstY1 + x), _mm_packus_epi16(
+                dotSsse3(r1lo, g1lo, b1lo, kyr, kyg, kyb, yBias),
+                dotSsse3(r1hi, g1hi, b1hi, kyr, kyg, kyb, yBias)));
+
+        __m128i r = pairSumSsse3(_mm_add_epi16(r0lo, r1lo), _mm_add_epi16(r0hi, r1hi));
+        __m128i g = pairSumSsse3(_mm_add_epi16(g0lo, g1lo), _mm_add_epi16(g0hi, g1hi));
+        __m128i b = pairSumSsse3(_mm_add_epi16(b0lo, b1lo), _mm_add_epi16(b0hi, b1hi));
+        r = _mm_srli_epi16(_mm_add_epi16(r, two), 2);
+        g = _mm_srli_epi16(_mm_add_epi16(g, two), 2);
+        b = _mm_srli_epi16(_mm_add_epi16(b, two), 2);
+
+        __m128i first = dotSsse3(r, g, b, k1r, k1g, k1b, cBias);
+        __m128i second = dotSsse3(r, g, b, k2r, k2g, k2b, cBias);
+        _mm_storeu_si128((__m128i *)(dstUV + x),
+                _mm_or_si128(first, _mm_slli_epi16(second, 8)));
+    }
+    return x;
+}
+
+SPRD_TARGET_SSSE3
+static int32_t interleaveRowSsse3(const uint8_t *first, const uint8_t *second,
+        uint8_t *dst, int32_t count) {
+    int32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(first + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(second + i));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(a, b));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(a, b));
+    }
+    return i;
+}
+
+// _mm_avg_epu8 rounds up, like the C version.
+SPRD_TARGET_SSSE3
+static int32_t averageInterleaveRowSsse3(const uint8_t *first0, const uint8_t *first1,
+        const uint8_t *second0, const uint8_t *second1,
+        uint8_t *dst, int32_t count) {
+    int32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(first0 + i)),
+                _mm_loadu_si128((const __m128i *)(first1 + i)));
+        __m128i b = _mm_avg_epu8(_mm_loadu_si128((const __m128i *)(second0 + i)),
+                _mm_loadu_si128((const __m128i *)(second1 + i)));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(a, b));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(a, b));
+    }
+    return i;
+}
+
+SPRD_TARGET_SSSE3
+static size_t swapChromaSsse3(uint8_t *uv, size_t size) {
+    const __m128i swap = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m128i *p = (__m128i *)(uv + i);
+        _mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), swap));
+    }
+    return i;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// AVX2: 32 pixels per row and iteration. The packs work within 128 bit
+// lanes, which leaves the 4 byte groups of a result in the order
+// 0, 2, 4, 6, 1, 3, 5, 7; kUnscramble puts them back before storing.
+
+SPRD_TARGET_AVX2
+static inline __m256i channelAvx2(__m256i lo, __m256i hi, __m128i shift) {
+    const __m256i mask = _mm256_set1_epi32(0xff);
+    return _mm256_packs_epi32(_mm256_and_si256(_mm256_srl_epi32(lo, shift), mask),
+            _mm256_and_si256(_mm256_srl_epi32(hi, shift), mask));
+}
+
+SPRD_TARGET_AVX2
+static inline __m256i dotAvx2(__m256i a, __m256i b, __m256i c,
+        __m256i k0, __m256i k1, __m256i k2, __m256i bias) {
+    __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(a, k0), _mm256_mullo_epi16(b, k1));
+    sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(c, k2));
+    return _mm256_srli_epi16(_mm256_add_epi16(sum, bias), 8);
+}
+
+SPRD_TARGET_AVX2
+static inline __m256i pairSumAvx2(__m256i lo, __m256i hi) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    return _mm256_packs_epi32(_mm256_madd_epi16(lo, ones), _mm256_madd_epi16(hi, ones));
+}
+
+SPRD_TARGET_AVX2
+static int32_t rgbRowPairAvx2(const uint8_t *src0, const uint8_t *src1,
+        uint8_t *dstY0, uint8_t *dstY1, uint8_t *dstUV,
+        int32_t width, const SprdColorCoeffs *coeffs) {
+    const __m256i kUnscramble = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const __m128i shiftR = _mm_cvtsi32_si128(coeffs->mIndex[0] * 8);
+    const __m128i shiftG = _mm_cvtsi32_si128(coeffs->mIndex[1] * 8);
+    const __m128i shiftB = _mm_cvtsi32_si128(coeffs->mIndex[2] * 8);
+    const __m256i kyr = _mm256_set1_epi16(coeffs->mY[0]);
+    const __m256i kyg = _mm256_set1_epi16(coeffs->mY[1]);
+    const __m256i kyb = _mm256_set1_epi16(coeffs->mY[2]);
+    const __m256i k1r = _mm256_set1_epi16(coeffs->mFirst[0]);
+    const __m256i k1g = _mm256_set1_epi16(coeffs->mFirst[1]);
+    const __m256i k1b = _mm256_set1_epi16(coeffs->mFirst[2]);
+    const __m256i k2r = _mm256_set1_epi16(coeffs->mSecond[0]);
+    const __m256i k2g = _mm256_set1_epi16(coeffs->mSecond[1]);
+    const __m256i k2b = _mm256_set1_epi16(coeffs->mSecond[2]);
+    const __m256i yBias = _mm256_set1_epi16(coeffs->mYBias);
+    const __m256i cBias = _mm256_set1_epi16((int16_t)kSprdChromaBias);
+    const __m256i two = _mm256_set1_epi16(2);
+
+    int32_t x = 0;
+    for (; x + 32 <= width; x += 32) {
+        const __m256i *p0 = (const __m256i *)(src0 + 4 * x);
+        const __m256i *p1 = (const __m256i *)(src1 + 4 * x);
+        __m256i a0 = _mm256_loadu_si256(p0), a1 = _mm256_loadu_si256(p0 + 1);
+        __m256i a2 = _mm256_loadu_si256(p0 + 2), a3 = _mm256_loadu_si256(p0 + 3);
+        __m256i b0 = _mm256_loadu_si256(p1), b1 = _mm256_loadu_si256(p1 + 1);
+        __m256i b2 = _mm256_loadu_si256(p1 + 2), b3 = _mm256_loadu_si256(p1 + 3);
+
+        __m256i r0lo = channelAvx2(a0, a1, shiftR), r0hi = channelAvx2(a2, a3, shiftR);
+        __m256i g0lo = channelAvx2(a0, a1, shiftG), g0hi = channelAvx2(a2, a3, shiftG);
+        __m256i b0lo = channelAvx2(a0, a1, shiftB), b0hi = channelAvx2(a2, a3, shiftB);
+        __m256i r1lo = channelAvx2(b0, b1, shiftR), r1hi = channelAvx2(b2, b3, shiftR);
+        __m256i g1lo = channelAvx2(b0, b1, shiftG), g1hi = channelAvx2(b2, b3, shiftG);
+        __m256i b1lo = channelAvx2(b0, b1, shiftB), b1hi = channelAvx2(b2, b3, shiftB);
+
+        __m256i y0 = _mm256_packus_epi16(
+                dotAvx2(r0lo, g0lo, b0lo, kyr, kyg, kyb, yBias),
+                dotAvx2(r0hi, g0hi, b0hi, kyr, kyg, kyb, yBias));
+        __m256i y1 = _mm256_packus_epi16(
+                dotAvx2(r1lo, g1lo, b1lo, kyr, kyg, kyb, yBias),
+                dotAvx2(r1hi, g1hi, b1hi, kyr, kyg, kyb, yBias));
+        _mm256_storeu_si256((__m256i *)(dstY0 + x), _mm256_permutevar8x32_epi32(y0, kUnscramble));
+        _mm256_storeu_si256((__m256i *)(dstY1 + x), _mm256_permutevar8x32_epi32(y1, kUnscramble));
+
+        __m256i r = pairSumAvx2(_mm256_add_epi16(r0lo, r1lo), _mm256_add_epi16(r0hi, r1hi));
+        __m256i g = pairSumAvx2(_mm256_add_epi16(g0lo, g1lo), _mm256_add_epi16(g0hi, g1hi));
+        __m256i b = pairSumAvx2(_mm256_add_epi16(b0lo, b1lo), _mm256_add_epi16(b0hi, b1hi));
+        r = _mm256_srli_epi16(_mm256_add_epi16(r, two), 2);
+        g = _mm256_srli_epi16(_mm256_add_epi16(g, two), 2);
+        b = _mm256_srli_epi16(_mm256_add_epi16(b, two), 2);
+
+        __m256i first = dotAvx2(r, g, b, k1r, k1g, k1b, cBias);
+        __m256i second = dotAvx2(r, g, b, k2r, k2g, k2b, cBias);
+        __m256i uv = _mm256_or_si256(first, _mm256_slli_epi16(second, 8));
+        _mm256_storeu_si256((__m256i *)(dstUV + x), _mm256_permutevar8x32_epi32(uv, kUnscramble));
+    }
+    return x;
+}
+
+SPRD_TARGET_AVX2
+static int32_t interleaveRowAvx2(const uint8_t *first, const uint8_t *second,
+        uint8_t *dst, int32_t count) {
+    int32_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(first + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(second + i));
+        __m256i lo = _mm256_unpacklo_epi8(a, b);
+        __m256i hi = _mm256_unpackhi_epi8(a, b);
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    return i;
+}
+
+SPRD_TARGET_AVX2
+static int32_t averageInterleaveRowAvx2(const uint8_t *first0, const uint8_t *first1,
+        const uint8_t *second0, const uint8_t *second1,
+        uint8_t *dst, int32_t count) {
+    int32_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i a = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i *)(first0 + i)),
+                _mm256_loadu_si256((const __m256i *)(first1 + i)));
+        __m256i b = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i *)(second0 + i)),
+                _mm256_loadu_si256((const __m256i *)(second1 + i)));
+        __m256i lo = _mm256_unpacklo_epi8(a, b);
+        __m256i hi = _mm256_unpackhi_epi8(a, b);
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    return i;
+}
+
+SPRD_TARGET_AVX2
+static size_t swapChromaAvx2(uint8_t *uv, size_t size) {
+    const __m256i swap = _mm256_setr_epi8(
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+            1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i *p = (__m256i *)(uv + i);
+        _mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), swap));
+    }
+    return i;
+}
+
+static const SprdColorKernels kSsse3Kernels = {
+    "ssse3", rgbRowPairSsse3, interleaveRowSsse3, averageInterleaveRowSsse3, swapChromaSsse3,
+};
+
+static const SprdColorKernels kAvx2Kernels = {
+    "avx2", rgbRowPairAvx2, interleaveRowAvx2, averageInterleaveRowAvx2, swapChromaAvx2,
+};
+
+const SprdColorKernels *SprdGetSsse3ColorKernels() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3") ? &kSsse3Kernels : NULL;
+}
+
+const SprdColorKernels *SprdGetAvx2ColorKernels() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? &kAvx2Kernels : NULL;
+}
+
+#else
+
+const SprdColorKernels *SprdGetSsse3ColorKernels() {
+    return NULL;
+}
+
+const SprdColorKernels *SprdGetAvx2ColorKernels() {
+    return NULL;
+}
+
+#endif
+
+}  // namespace android
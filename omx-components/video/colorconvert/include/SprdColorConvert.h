@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SPRD_COLOR_CONVERT_H_
+
+#define SPRD_COLOR_CONVERT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// Colour conversions the encoders run on the CPU before handing a frame to
+// the engine. The kernels (NEON, SSSE3, AVX2 or plain C) are picked once at
+// run time and produce identical output.
+
+enum SprdColorMatrix {
+    kSprdColorBT601Limited,
+    kSprdColorBT601Full,
+    kSprdColorBT709Limited,
+    kSprdColorBT709Full,
+};
+
+// Byte order of a 32 bit RGB pixel in memory. HAL_PIXEL_FORMAT_RGBA_8888
+// and RGBX_8888 are kSprdRgbLayoutRGBA, BGRA_8888 is kSprdRgbLayoutBGRA.
+enum SprdRgbLayout {
+    kSprdRgbLayoutRGBA,
+    kSprdRgbLayoutBGRA,
+    kSprdRgbLayoutARGB,
+    kSprdRgbLayoutABGR,
+};
+
+// Order of the interleaved chroma samples: NV12 or NV21.
+enum SprdChromaOrder {
+    kSprdChromaUV,
+    kSprdChromaVU,
+};
+
+// I420 to NV12/NV21. Strides are in bytes; srcStrideUV applies to both
+// chroma planes.
+void SprdConvertI420ToSemiPlanar(
+        const uint8_t *srcY, size_t srcStrideY,
+        const uint8_t *srcU, const uint8_t *srcV, size_t srcStrideUV,
+        uint8_t *dstY, size_t dstStrideY, uint8_t *dstUV, size_t dstStrideUV,
+        int32_t width, int32_t height, SprdChromaOrder order);
+
+// 32 bit RGB to NV12/NV21. Each chroma sample is the average of its 2x2
+// block; odd widths and heights repeat the last column/row.
+void SprdConvertRGBToSemiPlanar(
+        const uint8_t *src, size_t srcStride, SprdRgbLayout layout,
+        SprdColorMatrix matrix,
+        uint8_t *dstY, size_t dstStrideY, uint8_t *dstUV, size_t dstStrideUV,
+        int32_t width, int32_t height, SprdChromaOrder order);
+
+// Separate chroma planes, as a JPEG decoder delivers them, to NV12/NV21
+// chroma. Each of the dstRows output rows is count pairs taken from one
+// row of each plane, or with vertical 2 (4:2:2 sources) from the rounded
+// average of two rows. srcStride applies to both planes.
+void SprdMergeChromaPlanes(
+        const uint8_t *srcU, const uint8_t *srcV, size_t srcStride,
+        uint8_t *dstUV, size_t dstStride, int32_t count, int32_t dstRows,
+        int32_t vertical, SprdChromaOrder order);
+
+// Turns NV12 chroma into NV21 and back, in place. size is in bytes.
+void SprdSwapChromaOrder(uint8_t *uv, size_t size);
+
+// Name of the kernel set in use, for logs.
+const char *SprdColorConvertKernelName();
+
+// Splits [0, rows) into ranges starting at multiples of align, calls func
+// on each, possibly on several threads, and returns when all are done.
+// rowBytes is the memory one row touches. SprdStripePool::Run is one.
+typedef void (*SprdStripeFunc)(void *cookie, int32_t begin, int32_t end);
+typedef void (*SprdStripeRunFunc)(void *runCookie, SprdStripeFunc func, void *cookie,
+        int32_t rows, size_t rowBytes, int32_t align);
+
+// Contiguous frames as the encoders keep them: the chroma plane follows a
+// dstWidth x dstHeight luma plane and both use dstWidth as stride. With a
+// run function the frame is converted in stripes through it.
+void SprdConvertI420FrameToSemiPlanar(
+        const uint8_t *src, int32_t width, int32_t height,
+        uint8_t *dst, int32_t dstWidth, int32_t dstHeight, SprdChromaOrder order,
+        SprdStripeRunFunc run = NULL, void *runCookie = NULL);
+
+void SprdConvertRGBFrameToSemiPlanar(
+        const uint8_t *src, SprdRgbLayout layout, SprdColorMatrix matrix,
+        int32_t width, int32_t height,
+        uint8_t *dst, int32_t dstWidth, int32_t dstHeight, SprdChromaOrder order,
+        SprdStripeRunFunc run = NULL, void *runCookie = NULL);
+
+}  // namespace android
+
+#endif  // SPRD_COLOR_CONVERT_H_
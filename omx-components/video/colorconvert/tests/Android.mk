@@ -0,0 +1,73 @@
+LOCAL_PATH := $(call my-dir)
+
+# Checks every kernel set the CPU can run against a per-pixel reference,
+# plus golden primaries. The device build covers NEON, the host one SSSE3
+# and AVX2. Run with: atest --host SprdColorConvert_test
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := SprdColorConvert_test.cpp
+
+LOCAL_STATIC_LIBRARIES := libsprd_colorconvert
+
+LOCAL_SHARED_LIBRARIES := liblog
+
+LOCAL_MODULE := SprdColorConvert_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := SprdColorConvert_test.cpp
+
+LOCAL_STATIC_LIBRARIES := libsprd_colorconvert
+
+LOCAL_SHARED_LIBRARIES := liblog
+
+LOCAL_MODULE := SprdColorConvert_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_NATIVE_TEST)
+
+################################################################################
+
+# ms per frame for each kernel set: sprd_colorconvert_bench [w h [frames]]
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := SprdColorConvert_bench.cpp
+
+LOCAL_STATIC_LIBRARIES := libsprd_colorconvert
+
+LOCAL_SHARED_LIBRARIES := \
+    libutils            \
+    liblog
+
+LOCAL_CFLAGS := -O2
+
+LOCAL_MODULE := sprd_colorconvert_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := SprdColorConvert_bench.cpp
+
+LOCAL_STATIC_LIBRARIES := libsprd_colorconvert
+
+LOCAL_SHARED_LIBRARIES := \
+    libutils            \
+    liblog
+
+LOCAL_CFLAGS := -O2
+
+LOCAL_MODULE := sprd_colorconvert_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
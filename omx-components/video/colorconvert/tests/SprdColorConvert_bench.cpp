@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Times whole-frame conversions with every kernel set this CPU can run.
+//
+//   sprd_colorconvert_bench [width height [frames]]
+//
+// The default is 1920x1080 over 200 frames. A 60 fps encoder has 16.6 ms
+// per frame for everything, conversion included.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utils/Timers.h>
+
+#include "SprdColorConvert.h"
+#include "../SprdColorConvertKernels.h"
+
+using namespace android;
+
+struct Case {
+    const char *mName;
+    void (*mRun)(const uint8_t *src, uint8_t *dst, int32_t width, int32_t height);
+};
+
+static void runRGB(const uint8_t *src, uint8_t *dst, int32_t width, int32_t height) {
+    SprdConvertRGBFrameToSemiPlanar(src, kSprdRgbLayoutRGBA, kSprdColorBT601Limited,
+            width, height, dst, width, height, kSprdChromaVU);
+}
+
+static void runI420(const uint8_t *src, uint8_t *dst, int32_t width, int32_t height) {
+    SprdConvertI420FrameToSemiPlanar(src, width, height, dst, width, height, kSprdChromaVU);
+}
+
+static void runSwap(const uint8_t *, uint8_t *dst, int32_t width, int32_t height) {
+    SprdSwapChromaOrder(dst + width * height, width * height / 2);
+}
+
+static const Case kCases[] = {
+    { "rgba->nv21", runRGB },
+    { "i420->nv21", runI420 },
+    { "nv12<->nv21", runSwap },
+};
+
+int main(int argc, char **argv) {
+    int32_t width = 1920;
+    int32_t height = 1080;
+    int32_t frames = 200;
+    if (argc >= 3) {
+        width = atoi(argv[1]);
+        height = atoi(argv[2]);
+    }
+    if (argc >= 4) {
+        frames = atoi(argv[3]);
+    }
+    if (width <= 0 || height <= 0 || frames <= 0 || (width & 1) || (height & 1)) {
+        fprintf(stderr, "usage: %s [width height [frames]], even sizes\n", argv[0]);
+        return 1;
+    }
+
+    const SprdColorKernels *kernels[] = {
+        SprdGetCColorKernels(),
+        SprdGetNeonColorKernels(),
+        SprdGetSsse3ColorKernels(),
+        SprdGetAvx2ColorKernels(),
+    };
+
+    uint8_t *src = (uint8_t *)malloc((size_t)width * height * 4);
+    uint8_t *dst = (uint8_t *)malloc((size_t)width * height * 3 / 2);
+    for (size_t i = 0; i < (size_t)width * height * 4; ++i) {
+        src[i] = (uint8_t)(i * 2654435761u >> 24);
+    }
+    memset(dst, 0, (size_t)width * height * 3 / 2);
+
+    printf("%dx%d, %d frames\n", width, height, frames);
+    printf("%-12s %-6s %10s\n", "pass", "kernel", "ms/frame");
+
+    for (size_t c = 0; c < sizeof(kCases) / sizeof(kCases[0]); ++c) {
+        for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+            if (kernels[k] == NULL) {
+                continue;
+            }
+            SprdSetColorKernels(kernels[k]);
+
+            // One untimed frame to fault the pages in.
+            (*kCases[c].mRun)(src, dst, width, height);
+
+            nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+            for (int32_t i = 0; i < frames; ++i) {
+                (*kCases[c].mRun)(src, dst, width, height);
+            }
+            nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+            printf("%-12s %-6s %10.3f\n", kCases[c].mName, kernels[k]->mName,
+                    elapsed / 1e6 / frames);
+        }
+    }
+
+    free(src);
+    free(dst);
+    return 0;
+}
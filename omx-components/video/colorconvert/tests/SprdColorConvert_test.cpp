@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "SprdColorConvert_test"
+#include <utils/Log.h>
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "SprdColorConvert.h"
+#include "../SprdColorConvertKernels.h"
+
+namespace android {
+
+// Written straight from the definition in SprdColorConvert.h, one pixel at
+// a time, so the kernels are checked against something that shares none
+// of their code.
+static const struct {
+    int32_t mY[3];
+    int32_t mU[3];
+    int32_t mV[3];
+    int32_t mYOffset;
+} kReferenceMatrices[] = {
+    { { 66, 129, 25 }, { -38, -74, 112 }, { 112, -94, -18 }, 16 },
+    { { 77, 150, 29 }, { -43, -84, 127 }, { 127, -106, -21 }, 0 },
+    { { 47, 157, 16 }, { -26, -86, 112 }, { 112, -102, -10 }, 16 },
+    { { 54, 183, 19 }, { -29, -98, 127 }, { 127, -115, -12 }, 0 },
+};
+
+static const int32_t kReferenceLayouts[][3] = {
+    { 0, 1, 2 }, { 2, 1, 0 }, { 1, 2, 3 }, { 3, 2, 1 },
+};
+
+static void referenceRGB(const uint8_t *src, size_t srcStride, SprdRgbLayout layout,
+        SprdColorMatrix matrix, uint8_t *dstY, size_t dstStrideY,
+        uint8_t *dstUV, size_t dstStrideUV, int32_t width, int32_t height,
+        SprdChromaOrder order) {
+    const int32_t *index = kReferenceLayouts[layout];
+    const int32_t *k = kReferenceMatrices[matrix].mY;
+
+    for (int32_t y = 0; y < height; ++y) {
+        for (int32_t x = 0; x < width; ++x) {
+            const uint8_t *p = src + y * srcStride + 4 * x;
+            int32_t sum = k[0] * p[index[0]] + k[1] * p[index[1]] + k[2] * p[index[2]];
+            dstY[y * dstStrideY + x] =
+                    (sum + (kReferenceMatrices[matrix].mYOffset << 8) + 128) >> 8;
+        }
+    }
+
+    for (int32_t y = 0; y < height; y += 2) {
+        for (int32_t x = 0; x < width; x += 2) {
+            int32_t avg[3];
+            for (int32_t c = 0; c < 3; ++c) {
+                int32_t sum = 0;
+                for (int32_t dy = 0; dy < 2; ++dy) {
+                    for (int32_t dx = 0; dx < 2; ++dx) {
+                        int32_t sy = y + dy < height ? y + dy : height - 1;
+                        int32_t sx = x + dx < width ? x + dx : width - 1;
+                        sum += src[sy * srcStride + 4 * sx + index[c]];
+                    }
+                }
+                avg[c] = (sum + 2) >> 2;
+            }
+
+            const int32_t *u = kReferenceMatrices[matrix].mU;
+            const int32_t *v = kReferenceMatrices[matrix].mV;
+            uint8_t cb = (u[0] * avg[0] + u[1] * avg[1] + u[2] * avg[2] + 32896) >> 8;
+            uint8_t cr = (v[0] * avg[0] + v[1] * avg[1] + v[2] * avg[2] + 32896) >> 8;
+            uint8_t *dst = dstUV + (y / 2) * dstStrideUV + x;
+            dst[0] = order == kSprdChromaUV ? cb : cr;
+            dst[1] = order == kSprdChromaUV ? cr : cb;
+        }
+    }
+}
+
+static void fillRandom(std::vector<uint8_t> *buffer, uint32_t seed) {
+    srand(seed);
+    for (size_t i = 0; i < buffer->size(); ++i) {
+        (*buffer)[i] = rand() & 0xff;
+    }
+}
+
+// Widths around the 16 and 32 pixel steps of the vector loops.
+static const int32_t kWidths[] = { 1, 2, 3, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 130, 257 };
+static const int32_t kHeights[] = { 1, 2, 3, 6 };
+
+// Every kernel set this CPU can run, the C one included.
+static std::vector<const SprdColorKernels *> availableKernels() {
+    std::vector<const SprdColorKernels *> kernels;
+    kernels.push_back(SprdGetCColorKernels());
+    if (SprdGetNeonColorKernels() != NULL) {
+        kernels.push_back(SprdGetNeonColorKernels());
+    }
+    if (SprdGetSsse3ColorKernels() != NULL) {
+        kernels.push_back(SprdGetSsse3ColorKernels());
+    }
+    if (SprdGetAvx2ColorKernels() != NULL) {
+        kernels.push_back(SprdGetAvx2ColorKernels());
+    }
+    return kernels;
+}
+
+class SprdColorConvertTest : public ::testing::TestWithParam<const SprdColorKernels *> {
+protected:
+    virtual void SetUp() {
+        SprdSetColorKernels(GetParam());
+        ASSERT_STREQ(GetParam()->mName, SprdColorConvertKernelName());
+    }
+
+    virtual void TearDown() {
+        SprdSetColorKernels(NULL);
+    }
+};
+
+TEST_P(SprdColorConvertTest, RGBMatchesReference) {
+    for (int32_t matrix = kSprdColorBT601Limited; matrix <= kSprdColorBT709Full; ++matrix) {
+    for (int32_t layout = kSprdRgbLayoutRGBA; layout <= kSprdRgbLayoutABGR; ++layout) {
+    for (int32_t order = kSprdChromaUV; order <= kSprdChromaVU; ++order) {
+    for (size_t w = 0; w < sizeof(kWidths) / sizeof(kWidths[0]); ++w) {
+    for (size_t h = 0; h < sizeof(kHeights) / sizeof(kHeights[0]); ++h) {
+        int32_t width = kWidths[w];
+        int32_t height = kHeights[h];
+        // Strides with slack, so writes past the width show up.
+        size_t srcStride = 4 * width + 12;
+        size_t strideY = width + 5;
+        size_t strideUV = (width + 1) / 2 * 2 + 7;
+
+        std::vector<uint8_t> src(srcStride * height);
+        fillRandom(&src, width * 131 + height);
+
+        std::vector<uint8_t> y(strideY * height, 0xa5);
+        std::vector<uint8_t> uv(strideUV * ((height + 1) / 2), 0xa5);
+        std::vector<uint8_t> refY(y);
+        std::vector<uint8_t> refUV(uv);
+
+        SprdConvertRGBToSemiPlanar(&src[0], srcStride, (SprdRgbLayout)layout,
+                (SprdColorMatrix)matrix, &y[0], strideY, &uv[0], strideUV,
+                width, height, (SprdChromaOrder)order);
+        referenceRGB(&src[0], srcStride, (SprdRgbLayout)layout,
+                (SprdColorMatrix)matrix, &refY[0], strideY, &refUV[0], strideUV,
+                width, height, (SprdChromaOrder)order);
+
+        ASSERT_TRUE(refY == y) << "luma, matrix " << matrix << " layout " << layout
+                << " order " << order << " " << width << "x" << height;
+        ASSERT_TRUE(refUV == uv) << "chroma, matrix " << matrix << " layout " << layout
+                << " order " << order << " " << width << "x" << height;
+    }
+    }
+    }
+    }
+    }
+}
+
+TEST_P(SprdColorConvertTest, I420MatchesReference) {
+    for (int32_t order = kSprdChromaUV; order <= kSprdChromaVU; ++order) {
+    for (size_t w = 0; w < sizeof(kWidths) / sizeof(kWidths[0]); ++w) {
+    for (size_t h = 0; h < sizeof(kHeights) / sizeof(kHeights[0]); ++h) {
+        int32_t width = kWidths[w];
+        int32_t height = kHeights[h];
+        int32_t chromaWidth = (width + 1) / 2;
+        int32_t chromaHeight = (height + 1) / 2;
+        size_t srcStrideY = width + 3;
+        size_t srcStrideUV = chromaWidth + 9;
+        size_t strideY = width + 5;
+        size_t strideUV = 2 * chromaWidth + 7;
+
+        std::vector<uint8_t> srcY(srcStrideY * height);
+        std::vector<uint8_t> srcU(srcStrideUV * chromaHeight);
+        std::vector<uint8_t> srcV(srcStrideUV * chromaHeight);
+        fillRandom(&srcY, width + 17 * height);
+        fillRandom(&srcU, width + 19 * height);
+        fillRandom(&srcV, width + 23 * height);
+
+        std::vector<uint8_t> y(strideY * height, 0xa5);
+        std::vector<uint8_t> uv(strideUV * chromaHeight, 0xa5);
+        std::vector<uint8_t> refY(y);
+        std::vector<uint8_t> refUV(uv);
+        for (int32_t row = 0; row < height; ++row) {
+            memcpy(&refY[row * strideY], &srcY[row * srcStrideY], width);
+        }
+        for (int32_t row = 0; row < chromaHeight; ++row) {
+            for (int32_t i = 0; i < chromaWidth; ++i) {
+                uint8_t u = srcU[row * srcStrideUV + i];
+                uint8_t v = srcV[row * srcStrideUV + i];
+                refUV[row * strideUV + 2 * i] = order == kSprdChromaUV ? u : v;
+                refUV[row * strideUV + 2 * i + 1] = order == kSprdChromaUV ? v : u;
+            }
+        }
+
+        SprdConvertI420ToSemiPlanar(&srcY[0], srcStrideY, &srcU[0], &srcV[0], srcStrideUV,
+                &y[0], strideY, &uv[0], strideUV, width, height, (SprdChromaOrder)order);
+
+        ASSERT_TRUE(refY == y) << width << "x" << height;
+        ASSERT_TRUE(refUV == uv) << "order " << order << " " << width << "x" << height;
+    }
+    }
+    }
+}
+
+TEST_P(SprdColorConvertTest, MergeChromaMatchesReference) {
+    for (int32_t vertical = 1; vertical <= 2; ++vertical) {
+    for (int32_t order = kSprdChromaUV; order <= kSprdChromaVU; ++order) {
+    for (size_t w = 0; w < sizeof(kWidths) / sizeof(kWidths[0]); ++w) {
+        int32_t count = kWidths[w];
+        int32_t rows = 5;
+        size_t srcStride = count + 11;
+        size_t dstStride = 2 * count + 3;
+
+        std::vector<uint8_t> srcU(srcStride * rows * vertical);
+        std::vector<uint8_t> srcV(srcStride * rows * vertical);
+        fillRandom(&srcU, count * 3 + vertical);
+        fillRandom(&srcV, count * 5 + vertical);
+
+        std::vector<uint8_t> dst(dstStride * rows, 0xa5);
+        std::vector<uint8_t> ref(dst);
+        for (int32_t row = 0; row < rows; ++row) {
+            const uint8_t *u0 = &srcU[row * vertical * srcStride];
+            const uint8_t *v0 = &srcV[row * vertical * srcStride];
+            const uint8_t *u1 = vertical == 2 ? u0 + srcStride : u0;
+            const uint8_t *v1 = vertical == 2 ? v0 + srcStride : v0;
+            for (int32_t i = 0; i < count; ++i) {
+                uint8_t u = (u0[i] + u1[i] + 1) >> 1;
+                uint8_t v = (v0[i] + v1[i] + 1) >> 1;
+                ref[row * dstStride + 2 * i] = order == kSprdChromaUV ? u : v;
+                ref[row * dstStride + 2 * i + 1] = order == kSprdChromaUV ? v : u;
+            }
+        }
+
+        SprdMergeChromaPlanes(&srcU[0], &srcV[0], srcStride, &dst[0], dstStride,
+                count, rows, vertical, (SprdChromaOrder)order);
+
+        ASSERT_TRUE(ref == dst) << "vertical " << vertical << " order " << order
+                << " count " << count;
+    }
+    }
+    }
+}
+
+TEST_P(SprdColorConvertTest, SwapMatchesReference) {
+    for (size_t size = 0; size < 300; ++size) {
+        std::vector<uint8_t> uv(size + 8);
+        fillRandom(&uv, size);
+        std::vector<uint8_t> ref(uv);
+        for (size_t i = 0; i + 1 < size; i += 2) {
+            uint8_t tmp = ref[i];
+            ref[i] = ref[i + 1];
+            ref[i + 1] = tmp;
+        }
+
+        SprdSwapChromaOrder(&uv[0], size);
+
+        ASSERT_TRUE(ref == uv) << "size " << size;
+    }
+}
+
+// Primaries through each matrix. The values are what the definition
+// gives; each is within one step of the textbook BT.601/709 value.
+TEST_P(SprdColorConvertTest, GoldenPrimaries) {
+    static const struct {
+        SprdColorMatrix mMatrix;
+        uint8_t mRGB[3];
+        uint8_t mYUV[3];
+    } kGolden[] = {
+        { kSprdColorBT601Limited, { 255, 255, 255 }, { 235, 128, 128 } },
+        { kSprdColorBT601Limited, {   0,   0,   0 }, {  16, 128, 128 } },
+        { kSprdColorBT601Limited, { 255,   0,   0 }, {  82,  90, 240 } },
+        { kSprdColorBT601Limited, {   0, 255,   0 }, { 144,  54,  34 } },
+        { kSprdColorBT601Limited, {   0,   0, 255 }, {  41, 240, 110 } },
+        { kSprdColorBT601Full,    { 255, 255, 255 }, { 255, 128, 128 } },
+        { kSprdColorBT601Full,    { 255,   0,   0 }, {  77,  85, 255 } },
+        { kSprdColorBT601Full,    {   0, 255,   0 }, { 149,  44,  22 } },
+        { kSprdColorBT601Full,    {   0,   0, 255 }, {  29, 255, 107 } },
+        { kSprdColorBT709Limited, { 255, 255, 255 }, { 235, 128, 128 } },
+        { kSprdColorBT709Limited, { 255,   0,   0 }, {  63, 102, 240 } },
+        { kSprdColorBT709Limited, {   0, 255,   0 }, { 172,  42,  26 } },
+        { kSprdColorBT709Limited, {   0,   0, 255 }, {  32, 240, 118 } },
+        { kSprdColorBT709Full,    {   0,   0,   0 }, {   0, 128, 128 } },
+        { kSprdColorBT709Full,    { 255,   0,   0 }, {  54,  99, 255 } },
+        { kSprdColorBT709Full,    {   0, 255,   0 }, { 182,  30,  13 } },
+        { kSprdColorBT709Full,    {   0,   0, 255 }, {  19, 255, 116 } },
+    };
+
+    // Wide enough for every vector loop.
+    const int32_t width = 64;
+    const int32_t height = 2;
+
+    for (size_t i = 0; i < sizeof(kGolden) / sizeof(kGolden[0]); ++i) {
+        std::vector<uint8_t> src(4 * width * height);
+        for (int32_t p = 0; p < width * height; ++p) {
+            src[4 * p] = 0xff;
+            src[4 * p + 1] = kGolden[i].mRGB[0];
+            src[4 * p + 2] = kGolden[i].mRGB[1];
+            src[4 * p + 3] = kGolden[i].mRGB[2];
+        }
+        std::vector<uint8_t> y(width * height);
+        std::vector<uint8_t> uv(width * height / 2);
+
+        SprdConvertRGBToSemiPlanar(&src[0], 4 * width, kSprdRgbLayoutARGB,
+                kGolden[i].mMatrix, &y[0], width, &uv[0], width,
+                width, height, kSprdChromaUV);
+
+        for (int32_t p = 0; p < width * height; ++p) {
+            ASSERT_EQ(kGolden[i].mYUV[0], y[p]) << "vector " << i << " pixel " << p;
+        }
+        for (int32_t p = 0; p < width / 2 * height / 2; ++p) {
+            ASSERT_EQ(kGolden[i].mYUV[1], uv[2 * p]) << "vector " << i << " pair " << p;
+            ASSERT_EQ(kGolden[i].mYUV[2], uv[2 * p + 1]) << "vector " << i << " pair " << p;
+        }
+    }
+}
+
+static std::string kernelName(const ::testing::TestParamInfo<const SprdColorKernels *> &info) {
+    return info.param->mName;
+}
+
+INSTANTIATE_TEST_CASE_P(Kernels, SprdColorConvertTest,
+        ::testing::ValuesIn(availableKernels()), kernelName);
+
+}  // namespace android
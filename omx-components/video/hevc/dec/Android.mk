@@ -50,3 +50,42 @@ LOCAL_PROPRIETARY_MODULE := true
 
 include $(BUILD_SHARED_LIBRARY)
 
+
+# Host build against the engine, libmemion and libui of
+# omx-components/mock.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    SPRDHEVCDecoder.cpp \
+
+LOCAL_C_INCLUDES := \
+    frameworks/av/media/libstagefright/include                    \
+    frameworks/av/include                                         \
+    frameworks/native/include/media/openmx                        \
+    frameworks/native/include/media/hardware                      \
+    frameworks/av/include/media/stagefright/foundation/           \
+    $(LOCAL_PATH)/../../../../libstagefrighthw/include         \
+    $(LOCAL_PATH)/../../../../libstagefrighthw/include/openmax \
+    $(LOCAL_PATH)/../../../../../../external/kernel-headers
+
+LOCAL_C_INCLUDES += $(TOP)/vendor/sprd/external/drivers/gpu
+LOCAL_C_INCLUDES += $(TOP)/system/core/libion/kernel-headers
+
+LOCAL_CFLAGS := -DOSCL_EXPORT_REF= -DOSCL_IMPORT_REF=
+
+LOCAL_SHARED_LIBRARIES := \
+    libstagefright_foundation  \
+    libstagefrighthw           \
+    libutils                   \
+    libui                      \
+    libmemion                  \
+    liblog                     \
+    libcutils
+
+LOCAL_LDLIBS := -ldl -lpthread
+
+LOCAL_MODULE := libstagefright_sprd_h265dec
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_SHARED_LIBRARY)
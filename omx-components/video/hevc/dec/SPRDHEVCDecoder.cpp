@@ -204,6 +204,7 @@ SPRDHEVCDecoder::SPRDHEVCDecoder(
       mDecoderSwFlag(false),
       mChangeToSwDec(false),
       mAllocateBuffers(false),
+      mAllocInput(false),
       mNeedIVOP(true),
       mIOMMUEnabled(false),
       mIOMMUID(-1),
@@ -217,7 +218,7 @@ SPRDHEVCDecoder::SPRDHEVCDecoder(
       mPbuf_stream_v(NULL),
       mPbuf_stream_p(0),
       mPbuf_stream_size(0),
-      mPmem_extra(NULL),
+      mIonArena(NULL),
       mPbuf_extra_v(NULL),
       mPbuf_extra_p(0),
       mPbuf_extra_size(0),
@@ -258,8 +259,19 @@ SPRDHEVCDecoder::SPRDHEVCDecoder(
     mDumpStrmEnabled = !strcmp(value_dump, "true");
     ALOGI("%s, mDumpYUVEnabled: %d, mDumpStrmEnabled: %d", __FUNCTION__, mDumpYUVEnabled, mDumpStrmEnabled);
 
+    property_get("vendor.h265dec.async", value_dump, "false");
+    if (!strcmp(value_dump, "true")) {
+        startDecodeThread();
+    }
+
+    enableVspScheduling(SprdVspScheduler::kCoreDecoder);
+
+    // Let the engine read the bitstream straight from the input buffers
+    // when the client asks us to allocate them.
+    property_get("vendor.h265dec.zerocopy", value_dump, "false");
+    mAllocInput = !strcmp(value_dump, "true");
+
     for (int i = 0; i < 17; i++) {
-        mPmem_mbinfo[i] = NULL;
         mPbuf_mbinfo_v[i] = NULL;
         mPbuf_mbinfo_p[i] = 0;
         mPbuf_mbinfo_size[i] = 0;
@@ -304,8 +316,8 @@ SPRDHEVCDecoder::~SPRDHEVCDecoder() {
     delete mHandle;
     mHandle = NULL;
 
-    List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
-    List<BufferInfo *> &inQueue = getPortQueue(kInputPortIndex);
+    PortQueue &outQueue = getPortQueue(kOutputPortIndex);
+    PortQueue &inQueue = getPortQueue(kInputPortIndex);
     CHECK(outQueue.empty());
     CHECK(inQueue.empty());
 
@@ -448,26 +460,20 @@ status_t SPRDHEVCDecoder::initDecoder() {
 void SPRDHEVCDecoder::releaseDecoder() {
     releaseStreamBuffer();
 
-    if (mPbuf_extra_v != NULL) {
-        if (mIOMMUEnabled) {
-            (*mH265DecFreeIOVA)(mHandle, mPbuf_extra_p, mPbuf_extra_size);
-        }
-        mPmem_extra.clear();
-        mPbuf_extra_v = NULL;
-        mPbuf_extra_p = 0;
-        mPbuf_extra_size = 0;
+    if (mIonArena != NULL) {
+        mIonArena->releaseAll();
+        delete mIonArena;
+        mIonArena = NULL;
     }
 
+    mPbuf_extra_v = NULL;
+    mPbuf_extra_p = 0;
+    mPbuf_extra_size = 0;
+
     for (int i = 0; i < 17; i++) {
-        if (mPbuf_mbinfo_v[i]) {
-            if (mIOMMUEnabled) {
-                (*mH265DecFreeIOVA)(mHandle, mPbuf_mbinfo_p[i], mPbuf_mbinfo_size[i]);
-            }
-            mPmem_mbinfo[i].clear();
-            mPbuf_mbinfo_v[i] = NULL;
-            mPbuf_mbinfo_p[i] = 0;
-            mPbuf_mbinfo_size[i] = 0;
-        }
+        mPbuf_mbinfo_v[i] = NULL;
+        mPbuf_mbinfo_p[i] = 0;
+        mPbuf_mbinfo_size[i] = 0;
     }
     mPbuf_mbinfo_idx = 0;
 
@@ -817,22 +823,20 @@ OMX_ERRORTYPE SPRDHEVCDecoder::internalUseBuffer(
                 pBufCtrl->phyAddr = 0;
                 pBufCtrl->bufferSize = 0;
         }
+    } else if (portIndex == OMX_DirInput && bufferPrivate != NULL) {
+        (*header)->pInputPortPrivate = new BufferCtrlStruct;
+        CHECK((*header)->pInputPortPrivate != NULL);
+        BufferCtrlStruct* pBufCtrl= (BufferCtrlStruct*)((*header)->pInputPortPrivate);
+        pBufCtrl->iRefCount = 1;
+        pBufCtrl->id = mIOMMUID;
+        pBufCtrl->pMem = ((BufferPrivateStruct*)bufferPrivate)->pMem;
+        pBufCtrl->bufferFd = ((BufferPrivateStruct*)bufferPrivate)->bufferFd;
+        pBufCtrl->phyAddr = ((BufferPrivateStruct*)bufferPrivate)->phyAddr;
+        pBufCtrl->bufferSize = ((BufferPrivateStruct*)bufferPrivate)->bufferSize;
     }
 
-    PortInfo *port = editPortInfo(portIndex);
-
-    port->mBuffers.push();
-
-    BufferInfo *buffer =
-        &port->mBuffers.editItemAt(port->mBuffers.size() - 1);
     ALOGI("internalUseBuffer, header=%p, pBuffer=%p, size=%d",*header, ptr, size);
-    buffer->mHeader = *header;
-    buffer->mOwnedByUs = false;
-
-    if (port->mBuffers.size() == port->mDef.nBufferCountActual) {
-        port->mDef.bPopulated = OMX_TRUE;
-        checkTransitions();
-    }
+    addBuffer(portIndex, *header);
 
     return OMX_ErrorNone;
 }
@@ -844,7 +848,60 @@ OMX_ERRORTYPE SPRDHEVCDecoder::allocateBuffer(
     OMX_U32 size) {
     switch (portIndex) {
     case OMX_DirInput:
-        return SprdSimpleOMXComponent::allocateBuffer(header, portIndex, appPrivate, size);
+    {
+        if (!mAllocInput) {
+            return SprdSimpleOMXComponent::allocateBuffer(header, portIndex, appPrivate, size);
+        }
+
+        MemIon* pMem = NULL;
+        unsigned long phyAddr = 0;
+        size_t bufferSize = 0;
+        OMX_U8* pBuffer = NULL;
+        size_t size64word = (size + 1024*4 - 1) & ~(1024*4 - 1);
+        int fd, ret;
+
+        if (mIOMMUEnabled) {
+            pMem = new MemIon(SPRD_ION_DEV, size64word, MemIon::NO_CACHING, ION_HEAP_ID_MASK_SYSTEM);
+        } else {
+            pMem = new MemIon(SPRD_ION_DEV, size64word, MemIon::NO_CACHING, ION_HEAP_ID_MASK_MM);
+        }
+
+        fd = pMem->getHeapID();
+        if(fd < 0) {
+            ALOGE("Failed to alloc input pmem buffer");
+            delete pMem;
+            return OMX_ErrorInsufficientResources;
+        }
+
+        if (mIOMMUEnabled) {
+            ret = (*mH265DecGetIOVA)(mHandle, fd, &phyAddr, &bufferSize);
+            if(ret) {
+                ALOGE("input H265DecGetIOVA Failed: %d(%s)", ret, strerror(errno));
+                delete pMem;
+                return OMX_ErrorInsufficientResources;
+            }
+        } else {
+            if(pMem->get_phy_addr_from_ion(&phyAddr, &bufferSize)) {
+                ALOGE("input get_phy_addr_from_ion fail");
+                delete pMem;
+                return OMX_ErrorInsufficientResources;
+            }
+        }
+
+        pBuffer = (OMX_U8 *)(pMem->getBase());
+        BufferPrivateStruct* bufferPrivate = new BufferPrivateStruct();
+        bufferPrivate->pMem = pMem;
+        bufferPrivate->bufferFd = fd;
+        bufferPrivate->phyAddr = phyAddr;
+        bufferPrivate->bufferSize = bufferSize;
+        ALOGI("allocateBuffer, allocate input buffer from pmem, pBuffer: %p, phyAddr: 0x%lx, size: %zd",
+                pBuffer, phyAddr, bufferSize);
+
+        SprdSimpleOMXComponent::useBuffer(header, portIndex, appPrivate, (OMX_U32)bufferSize, pBuffer, bufferPrivate);
+        delete bufferPrivate;
+
+        return OMX_ErrorNone;
+    }
 
     case OMX_DirOutput:
     {
@@ -868,6 +925,7 @@ OMX_ERRORTYPE SPRDHEVCDecoder::allocateBuffer(
             fd = pMem->getHeapID();
             if(fd < 0) {
                 ALOGE("Failed to alloc outport pmem buffer");
+                delete pMem;
                 return OMX_ErrorInsufficientResources;
             }
 
@@ -897,7 +955,19 @@ OMX_ERRORTYPE SPRDHEVCDecoder::freeBuffer(
     OMX_BUFFERHEADERTYPE *header) {
     switch (portIndex) {
     case OMX_DirInput:
+    {
+        BufferCtrlStruct* pBufCtrl= (BufferCtrlStruct*)(header->pInputPortPrivate);
+        if(pBufCtrl != NULL) {
+            ALOGV("freeBuffer, input phyAddr: 0x%lx", pBufCtrl->phyAddr);
+            if (mIOMMUEnabled && pBufCtrl->phyAddr > 0) {
+                (*mH265DecFreeIOVA)(mHandle, pBufCtrl->phyAddr, pBufCtrl->bufferSize);
+            }
+            if(pBufCtrl->pMem != NULL) {
+                pBufCtrl->pMem.clear();
+            }
+        }
         return SprdSimpleOMXComponent::freeBuffer(portIndex, header);
+    }
 
     case OMX_DirOutput:
     {
@@ -968,6 +1038,10 @@ OMX_ERRORTYPE SPRDHEVCDecoder::getConfig(
 
         return OMX_ErrorNone;
     }
+    case OMX_IndexConfigCodecMetrics:
+    case OMX_IndexConfigCallbackBatching:
+        return SprdSimpleOMXComponent::getConfig(index, params);
+
     default:
         return OMX_ErrorUnsupportedIndex;
     }
@@ -981,6 +1055,7 @@ OMX_ERRORTYPE SPRDHEVCDecoder::setConfig(
          OMX_BOOL *pEnable = (OMX_BOOL *)params;
          if (*pEnable == OMX_TRUE) {
               mThumbnailMode = OMX_TRUE;
+              setVspPriority(SprdVspScheduler::kPriorityBackground);
          }
 
          ALOGI("setConfig, mThumbnailMode = %d", mThumbnailMode);
@@ -1014,6 +1089,9 @@ OMX_ERRORTYPE SPRDHEVCDecoder::setConfig(
     case OMX_IndexConfigDecSceneMode:
     {
         int *pDecSceneMode = (int *)params;
+        if (*pDecSceneMode == 3) { // VoLTE
+            setVspPriority(SprdVspScheduler::kPriorityRealtime);
+        }
 #ifdef CONFIG_AFBC_SUPPORT
         if(*pDecSceneMode == 4) {
             mUsage = GRALLOC_USAGE_CURSOR | GRALLOC_USAGE_SW_WRITE_NEVER;
@@ -1037,8 +1115,8 @@ void SPRDHEVCDecoder::onQueueFilled(OMX_U32 portIndex) {
         return;
     }
 
-    List<BufferInfo *> &inQueue = getPortQueue(kInputPortIndex);
-    List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
+    PortQueue &inQueue = getPortQueue(kInputPortIndex);
+    PortQueue &outQueue = getPortQueue(kOutputPortIndex);
 
     while (!mStopDecode && (mEOSStatus != INPUT_DATA_AVAILABLE || !inQueue.empty())
             && outQueue.size() != 0) {
@@ -1051,13 +1129,13 @@ void SPRDHEVCDecoder::onQueueFilled(OMX_U32 portIndex) {
         BufferInfo *inInfo = *inQueue.begin();
         OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
 
-        List<BufferInfo *>::iterator itBuffer = outQueue.begin();
+        PortQueue::iterator itBuffer = outQueue.begin();
         OMX_BUFFERHEADERTYPE *outHeader = NULL;
         BufferCtrlStruct *pBufCtrl = NULL;
         size_t count = 0;
         do {
             if(count >= outQueue.size()) {
-                ALOGI("onQueueFilled, get outQueue buffer, return, count=%zd, queue_size=%d",count, outQueue.size());
+                SPRD_FRAME_LOGI("onQueueFilled, get outQueue buffer, return, count=%zd, queue_size=%d",count, outQueue.size());
                 return;
             }
 
@@ -1075,7 +1153,7 @@ void SPRDHEVCDecoder::onQueueFilled(OMX_U32 portIndex) {
         } while (pBufCtrl->iRefCount > 0);
 
 //        ALOGI("%s, %d, mBuffer=0x%x, outHeader=0x%x, iRefCount=%d", __FUNCTION__, __LINE__, *itBuffer, outHeader, pBufCtrl->iRefCount);
-        ALOGI("%s, %d, outHeader:%p, inHeader: %p, len: %d, nOffset: %d, time: %lld, EOS: %d",
+        SPRD_FRAME_LOGI("%s, %d, outHeader:%p, inHeader: %p, len: %d, nOffset: %d, time: %lld, EOS: %d",
               __FUNCTION__, __LINE__,outHeader,inHeader, inHeader->nFilledLen,inHeader->nOffset, inHeader->nTimeStamp,inHeader->nFlags & OMX_BUFFERFLAG_EOS);
 
         ++mPicId;
@@ -1105,8 +1183,20 @@ void SPRDHEVCDecoder::onQueueFilled(OMX_U32 portIndex) {
         uint32_t copyLen = 0;
         uint32_t add_startcode_len = 0;
 
-        dec_in.pStream = mPbuf_stream_v;
-        dec_in.pStream_phy = mPbuf_stream_p;
+        // Buffers we allocated ourselves are handed to the engine as they
+        // are; client memory and thumbnails go through the stream buffer.
+        unsigned long inPhyAddr = 0;
+        if (mAllocInput && !mThumbnailMode) {
+            inPhyAddr = getInputStreamAddr(inHeader);
+        }
+
+        if (inPhyAddr != 0) {
+            dec_in.pStream = bitstream;
+            dec_in.pStream_phy = inPhyAddr;
+        } else {
+            dec_in.pStream = mPbuf_stream_v;
+            dec_in.pStream_phy = mPbuf_stream_p;
+        }
         dec_in.beLastFrm = 0;
         dec_in.expected_IVOP = mNeedIVOP;
         dec_in.beDisplayed = 1;
@@ -1119,7 +1209,9 @@ void SPRDHEVCDecoder::onQueueFilled(OMX_U32 portIndex) {
             //(pBufCtrl->pMem)->flush_ion_buffer((void*)(outHeader->pBuffer + outHeader->nOffset), (void*)(pBufCtrl->phyAddr), pBufCtrl->bufferSize);
             (pBufCtrl->pMem)->invalid_ion_buffer();
 
-        if(mThumbnailMode) {
+        if (inPhyAddr != 0) {
+            copyLen = bufferSize;
+        } else if(mThumbnailMode) {
             if((bitstream[0] != 0x0) || (bitstream[1] != 0x0) || (bitstream[2] != 0x0) || (bitstream[3] != 0x1)) {
                 ALOGI("%s, %d, p[0]: %x, p[1]: %x, p[2]: %x, p[3]: %x", __FUNCTION__, __LINE__,
                         bitstream[0], bitstream[1], bitstream[2], bitstream[3]);
@@ -1143,8 +1235,9 @@ void SPRDHEVCDecoder::onQueueFilled(OMX_U32 portIndex) {
                 copyLen = mPbuf_stream_size;
         }
 
-        if (mPbuf_stream_v != NULL) {
+        if (inPhyAddr == 0 && mPbuf_stream_v != NULL) {
             memcpy(mPbuf_stream_v + add_startcode_len, bitstream, copyLen);
+            mMetrics.count(SprdCodecMetrics::kCounterCopyBytes, copyLen);
         }
 
         dec_in.dataLen = copyLen + add_startcode_len;
@@ -1169,7 +1262,7 @@ void SPRDHEVCDecoder::onQueueFilled(OMX_U32 portIndex) {
             dec_in.dataLen -= 1;
         }
 #endif
-        ALOGI("%s, %d, dec_in.dataLen: %d, mPicId: %d", __FUNCTION__, __LINE__, dec_in.dataLen, mPicId);
+        SPRD_FRAME_LOGI("%s, %d, dec_in.dataLen: %d, mPicId: %d", __FUNCTION__, __LINE__, dec_in.dataLen, mPicId);
 
         outHeader->nTimeStamp = inHeader->nTimeStamp;
         outHeader->nFlags = inHeader->nFlags;
@@ -1202,15 +1295,17 @@ void SPRDHEVCDecoder::onQueueFilled(OMX_U32 portIndex) {
         }
         if(mDumpStrmEnabled){
             if (mFile_bs != NULL) {
-                fwrite(mPbuf_stream_v, 1, dec_in.dataLen, mFile_bs);
+                fwrite(dec_in.pStream, 1, dec_in.dataLen, mFile_bs);
             }
         }
 //       dump_bs( mPbuf_stream_v, dec_in.dataLen);
 
-        int64_t start_decode = systemTime();
-        MMDecRet decRet = (*mH265DecDecode)(mHandle, &dec_in,&dec_out);
-        int64_t end_decode = systemTime();
-        ALOGI("%s, %d, decRet: %d, %dms, dec_out.frameEffective: %d, needIVOP: %d", __FUNCTION__, __LINE__, decRet, (unsigned int)((end_decode-start_decode) / 1000000L), dec_out.frameEffective, mNeedIVOP);
+        MMDecRet decRet;
+        {
+            HardwareSection section(this);
+            decRet = (*mH265DecDecode)(mHandle, &dec_in,&dec_out);
+        }
+        SPRD_FRAME_LOGI("%s, %d, decRet: %d, %dms, dec_out.frameEffective: %d, needIVOP: %d", __FUNCTION__, __LINE__, decRet, (unsigned int)(mMetrics.lastUs(SprdCodecMetrics::kHistogramEngineTime) / 1000), dec_out.frameEffective, mNeedIVOP);
 
         if(iUseAndroidNativeBuffer[OMX_DirOutput]) {
             if(mapper.unlock((const native_handle_t*)outHeader->pBuffer)) {
@@ -1222,6 +1317,7 @@ void SPRDHEVCDecoder::onQueueFilled(OMX_U32 portIndex) {
             mNeedIVOP = false;
         } else {
             mNeedIVOP = true;
+            mMetrics.count(SprdCodecMetrics::kCounterErrors);
             if (decRet == MMDEC_MEMORY_ERROR) {
                 ALOGE("failed to allocate memory.");
                 notify(OMX_EventError, OMX_ErrorInsufficientResources, 0, NULL);
@@ -1280,7 +1376,7 @@ void SPRDHEVCDecoder::onQueueFilled(OMX_U32 portIndex) {
         while (!outQueue.empty() &&
                 mHeadersDecoded &&
                 dec_out.frameEffective) {
-            ALOGI("%s, %d, dec_out.pBufferHeader: %p, dec_out.mPicId: %d", __FUNCTION__, __LINE__, dec_out.pBufferHeader, dec_out.mPicId);
+            SPRD_FRAME_LOGI("%s, %d, dec_out.pBufferHeader: %p, dec_out.mPicId: %d", __FUNCTION__, __LINE__, dec_out.pBufferHeader, dec_out.mPicId);
             int32_t picId = dec_out.mPicId;//decodedPicture.picId;
         if(mDumpYUVEnabled){
             if (mFile_yuv != NULL) {
@@ -1380,20 +1476,16 @@ bool SPRDHEVCDecoder::handleCropRectEvent(const CropParams *crop) {
 
 void SPRDHEVCDecoder::drainOneOutputBuffer(int32_t picId, void* pBufferHeader) {
 
-    List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
+    PortQueue &outQueue = getPortQueue(kOutputPortIndex);
 
-    List<BufferInfo *>::iterator it = outQueue.begin();
-    while ((*it)->mHeader != (OMX_BUFFERHEADERTYPE*)pBufferHeader && it != outQueue.end()) {
-        ++it;
-    }
-    CHECK((*it)->mHeader == (OMX_BUFFERHEADERTYPE*)pBufferHeader);
+    BufferInfo *outInfo = findBufferInfo(kOutputPortIndex, (OMX_BUFFERHEADERTYPE*)pBufferHeader);
+    CHECK(outInfo != NULL && outInfo->mQueued);
 
-    BufferInfo *outInfo = *it;
     OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
 
     outHeader->nFilledLen = mPictureSize;
 
-    ALOGI("%s, %d, outHeader: %p, outHeader->pBuffer: %p, outHeader->nOffset: %d, outHeader->nFlags: %d, outHeader->nTimeStamp: %lld",
+    SPRD_FRAME_LOGI("%s, %d, outHeader: %p, outHeader->pBuffer: %p, outHeader->nOffset: %d, outHeader->nFlags: %d, outHeader->nTimeStamp: %lld",
           __FUNCTION__, __LINE__, outHeader , outHeader->pBuffer, outHeader->nOffset, outHeader->nFlags, outHeader->nTimeStamp);
 
 //    LOGI("%s, %d, outHeader->nTimeStamp: %d, outHeader->nFlags: %d, mPictureSize: %d", __FUNCTION__, __LINE__, outHeader->nTimeStamp, outHeader->nFlags, mPictureSize);
@@ -1401,7 +1493,7 @@ void SPRDHEVCDecoder::drainOneOutputBuffer(int32_t picId, void* pBufferHeader) {
 
 //    dump_yuv(data, mPictureSize);
     outInfo->mOwnedByUs = false;
-    outQueue.erase(it);
+    outQueue.erase(outInfo);
     outInfo = NULL;
 
     BufferCtrlStruct* pOutBufCtrl= (BufferCtrlStruct*)(outHeader->pOutputPortPrivate);
@@ -1410,7 +1502,7 @@ void SPRDHEVCDecoder::drainOneOutputBuffer(int32_t picId, void* pBufferHeader) {
 }
 
 bool SPRDHEVCDecoder::drainAllOutputBuffers() {
-    List<BufferInfo *> &outQueue = getPortQueue(kOutputPortIndex);
+    PortQueue &outQueue = getPortQueue(kOutputPortIndex);
     BufferInfo *outInfo;
     OMX_BUFFERHEADERTYPE *outHeader;
 
@@ -1421,13 +1513,9 @@ bool SPRDHEVCDecoder::drainAllOutputBuffers() {
 
         if (mHeadersDecoded &&
                 MMDEC_OK == (*mH265Dec_GetLastDspFrm)(mHandle, &pBufferHeader, &picId) ) {
-            List<BufferInfo *>::iterator it = outQueue.begin();
-            while ((*it)->mHeader != (OMX_BUFFERHEADERTYPE*)pBufferHeader && it != outQueue.end()) {
-                ++it;
-            }
-            CHECK((*it)->mHeader == (OMX_BUFFERHEADERTYPE*)pBufferHeader);
-            outInfo = *it;
-            outQueue.erase(it);
+            outInfo = findBufferInfo(kOutputPortIndex, (OMX_BUFFERHEADERTYPE*)pBufferHeader);
+            CHECK(outInfo != NULL && outInfo->mQueued);
+            outQueue.erase(outInfo);
             outHeader = outInfo->mHeader;
             outHeader->nFilledLen = mPictureSize;
         } else {
@@ -1548,6 +1636,32 @@ int32_t SPRDHEVCDecoder::UnbindFrameWrapper(void *aUserData, void *pHeader, unsi
     return static_cast<SPRDHEVCDecoder *>(aUserData)->VSP_unbind_cb(pHeader, pPhyAddr);
 }
 
+// static
+int SPRDHEVCDecoder::IonArenaMapWrapper(
+    void *cookie, int fd, unsigned long *iova, size_t *size) {
+    SPRDHEVCDecoder *decoder = static_cast<SPRDHEVCDecoder *>(cookie);
+    return (*decoder->mH265DecGetIOVA)(decoder->mHandle, fd, iova, size);
+}
+
+// static
+void SPRDHEVCDecoder::IonArenaUnmapWrapper(
+    void *cookie, unsigned long iova, size_t size) {
+    SPRDHEVCDecoder *decoder = static_cast<SPRDHEVCDecoder *>(cookie);
+    (*decoder->mH265DecFreeIOVA)(decoder->mHandle, iova, size);
+}
+
+SprdIonArena *SPRDHEVCDecoder::getIonArena() {
+    if (mIonArena == NULL) {
+        if (mIOMMUEnabled) {
+            mIonArena = new SprdIonArena("hevc_dec", ION_HEAP_ID_MASK_SYSTEM,
+                    IonArenaMapWrapper, IonArenaUnmapWrapper, this);
+        } else {
+            mIonArena = new SprdIonArena("hevc_dec", ION_HEAP_ID_MASK_MM, NULL, NULL, this);
+        }
+    }
+    return mIonArena;
+}
+
 int SPRDHEVCDecoder::VSP_malloc_cb(unsigned int size_extra) {
 
     ALOGI("%s, %d, mDecoderSwFlag: %d, mPictureSize: %d, size_extra: %d", __FUNCTION__, __LINE__, mDecoderSwFlag, mPictureSize, size_extra);
@@ -1575,51 +1689,32 @@ int SPRDHEVCDecoder::VSP_malloc_cb(unsigned int size_extra) {
         extra_mem[SW_CACHABLE].common_buffer_ptr_phy = 0;
         extra_mem[SW_CACHABLE].size = size_extra;
     } else {
-        mPbuf_mbinfo_idx = 0;
+        // A new sequence: the engine is done with the previous extra and
+        // ctuinfo buffers, so their arena space is handed out again.
+        SprdIonArena *arena = getIonArena();
+        arena->reset();
 
-        if (mPbuf_extra_v != NULL) {
-            if (mIOMMUEnabled) {
-                (*mH265DecFreeIOVA)(mHandle, mPbuf_extra_p, mPbuf_extra_size);
-            }
-            mPmem_extra.clear();
-            mPbuf_extra_v = NULL;
-            mPbuf_extra_p = 0;
-            mPbuf_extra_size = 0;
+        for (int i = 0; i < 17; i++) {
+            mPbuf_mbinfo_v[i] = NULL;
+            mPbuf_mbinfo_p[i] = 0;
+            mPbuf_mbinfo_size[i] = 0;
         }
+        mPbuf_mbinfo_idx = 0;
 
-        if (mIOMMUEnabled) {
-            mPmem_extra = new MemIon(SPRD_ION_DEV, size_extra, MemIon::NO_CACHING, ION_HEAP_ID_MASK_SYSTEM);
-        } else {
-            mPmem_extra = new MemIon(SPRD_ION_DEV, size_extra, MemIon::NO_CACHING, ION_HEAP_ID_MASK_MM);
+        SprdIonArena::Region region;
+        if (arena->alloc(size_extra, &region) != OK) {
+            ALOGE("%s: unable to allocate extra buffer", __FUNCTION__);
+            return -1;
         }
-        int fd = mPmem_extra->getHeapID();
-        if(fd >= 0) {
-            int ret;
-            unsigned long phy_addr;
-            size_t buffer_size;
-
-            if (mIOMMUEnabled) {
-                ret = (*mH265DecGetIOVA)(mHandle, fd, &phy_addr, &buffer_size);
-            } else {
-                ret = mPmem_extra->get_phy_addr_from_ion(&phy_addr, &buffer_size);
-            }
-            if(ret < 0) {
-                ALOGE ("mPmem_extra: get phy addr fail %d(%s)", ret, strerror(errno));
-                return -1;
-            }
 
-            mPbuf_extra_p =phy_addr;
-            mPbuf_extra_size = buffer_size;
-            mPbuf_extra_v = (uint8_t *)mPmem_extra->getBase();
-            ALOGI("pmem 0x%lx - %p - %zd", mPbuf_extra_p, mPbuf_extra_v, mPbuf_extra_size);
+        mPbuf_extra_p = region.mPhy;
+        mPbuf_extra_size = region.mSize;
+        mPbuf_extra_v = region.mVirt;
+        ALOGI("pmem 0x%lx - %p - %zd", mPbuf_extra_p, mPbuf_extra_v, mPbuf_extra_size);
 
-            extra_mem[HW_NO_CACHABLE].common_buffer_ptr = mPbuf_extra_v;
-            extra_mem[HW_NO_CACHABLE].common_buffer_ptr_phy = mPbuf_extra_p;
-            extra_mem[HW_NO_CACHABLE].size = size_extra;
-        } else {
-            ALOGE ("mPmem_extra: getHeapID fail %d", fd);
-            return -1;
-        }
+        extra_mem[HW_NO_CACHABLE].common_buffer_ptr = mPbuf_extra_v;
+        extra_mem[HW_NO_CACHABLE].common_buffer_ptr_phy = mPbuf_extra_p;
+        extra_mem[HW_NO_CACHABLE].size = size_extra;
     }
     (*mH265DecMemInit)(((SPRDHEVCDecoder *)this)->mHandle, extra_mem);
 
@@ -1634,48 +1729,28 @@ int SPRDHEVCDecoder::VSP_malloc_ctuinfo_cb(unsigned int size_mbinfo, unsigned lo
 
     ALOGI("%s, %d, idx: %d, size_mbinfo: %d", __FUNCTION__, __LINE__, idx, size_mbinfo);
 
-    if (mPbuf_mbinfo_v[idx] != NULL) {
-        if (mIOMMUEnabled) {
-            (*mH265DecFreeIOVA)(mHandle, mPbuf_mbinfo_p[idx], mPbuf_mbinfo_size[idx]);
-        }
-        mPmem_mbinfo[idx].clear();
-        mPbuf_mbinfo_v[idx] = NULL;
-        mPbuf_mbinfo_p[idx] = 0;
-        mPbuf_mbinfo_size[idx] = 0;
-    }
-
-    if (mIOMMUEnabled) {
-        mPmem_mbinfo[idx] = new MemIon(SPRD_ION_DEV, size_mbinfo, MemIon::NO_CACHING, ION_HEAP_ID_MASK_SYSTEM);
-    } else {
-        mPmem_mbinfo[idx] = new MemIon(SPRD_ION_DEV, size_mbinfo, MemIon::NO_CACHING, ION_HEAP_ID_MASK_MM);
+    if (idx >= 17) {
+        ALOGE("%s: too many ctuinfo buffers", __FUNCTION__);
+        return -1;
     }
-    int fd = mPmem_mbinfo[idx]->getHeapID();
-    if(fd >= 0) {
-        int ret;
-        unsigned long phy_addr;
-        size_t buffer_size;
 
-        if (mIOMMUEnabled) {
-            ret = (*mH265DecGetIOVA)(mHandle, fd, &phy_addr, &buffer_size);
-        } else {
-            ret = mPmem_mbinfo[idx]->get_phy_addr_from_ion(&phy_addr, &buffer_size);
-        }
-        if(ret < 0) {
-            ALOGE ("mPmem_mbinfo[%d]: get phy addr fail %d", idx, ret);
+    // After a port reconfiguration or flush the slots are requested again
+    // from 0; a slot keeps its region if it is still large enough.
+    if (mPbuf_mbinfo_v[idx] == NULL || mPbuf_mbinfo_size[idx] < size_mbinfo) {
+        SprdIonArena::Region region;
+        if (getIonArena()->alloc(size_mbinfo, &region) != OK) {
+            ALOGE("ctuinfo[%d]: unable to allocate %u bytes", idx, size_mbinfo);
             return -1;
         }
 
-        mPbuf_mbinfo_p[idx] =phy_addr;
-        mPbuf_mbinfo_size[idx] = buffer_size;
-        mPbuf_mbinfo_v[idx] = (uint8_t *)mPmem_mbinfo[idx]->getBase();
+        mPbuf_mbinfo_p[idx] = region.mPhy;
+        mPbuf_mbinfo_size[idx] = region.mSize;
+        mPbuf_mbinfo_v[idx] = region.mVirt;
         ALOGI("pmem 0x%lx - %p - %zd", mPbuf_mbinfo_p[idx], mPbuf_mbinfo_v[idx], mPbuf_mbinfo_size[idx]);
-
-        *pPhyAddr = phy_addr;
-    } else {
-        ALOGE ("mPmem_mbinfo[%d]: getHeapID fail %d", idx, fd);
-        return -1;
     }
 
+    *pPhyAddr = mPbuf_mbinfo_p[idx];
+
     mPbuf_mbinfo_idx++;
 
     return 0;
@@ -1769,6 +1844,8 @@ OMX_ERRORTYPE SPRDHEVCDecoder::getExtensionIndex(
         ALOGI("getExtensionIndex:%s",SPRD_INDEX_CONFIG_DEC_SCENE_MODE);
         *index = (OMX_INDEXTYPE) OMX_IndexConfigDecSceneMode;
         return OMX_ErrorNone;
+    } else if (!strcmp(name, SPRD_INDEX_CONFIG_CODEC_METRICS)) {
+        return SprdSimpleOMXComponent::getExtensionIndex(name, index);
     }
 
     return OMX_ErrorNotImplemented;
@@ -20,6 +20,7 @@
 #include "SprdSimpleOMXComponent.h"
 #include <utils/KeyedVector.h>
 #include "MemIon.h"
+#include "SprdIonArena.h"
 #include "hevc_dec_api.h"
 #include <VideoAPI.h>
 #include <ColorUtils.h>
@@ -126,6 +127,7 @@ private:
     bool mDecoderSwFlag;
     bool mChangeToSwDec;
     bool mAllocateBuffers;
+    bool mAllocInput;
     bool mNeedIVOP;
     bool mIOMMUEnabled;
     int mIOMMUID;
@@ -142,12 +144,11 @@ private:
     unsigned long mPbuf_stream_p;
     size_t mPbuf_stream_size;
 
-    sp<MemIon> mPmem_extra;
+    SprdIonArena *mIonArena;
     uint8_t*  mPbuf_extra_v;
     unsigned long  mPbuf_extra_p;
     size_t  mPbuf_extra_size;
 
-    sp<MemIon> mPmem_mbinfo[17];
     uint8_t *mPbuf_mbinfo_v[17];
     unsigned long  mPbuf_mbinfo_p[17];
     size_t  mPbuf_mbinfo_size[17];
@@ -189,10 +190,13 @@ private:
     static int32_t CtuInfoMemAllocWrapper(void* aUserData, unsigned int size_mbinfo, unsigned long *pPhyAddr);
     static int32_t ExtMemAllocWrapper(void* aUserData, unsigned int size_extra) ;
     static int32_t BindFrameWrapper(void *aUserData, void *pHeader, unsigned long *pPhyAddr);
+    static int IonArenaMapWrapper(void *cookie, int fd, unsigned long *iova, size_t *size);
+    static void IonArenaUnmapWrapper(void *cookie, unsigned long iova, size_t size);
     static int32_t UnbindFrameWrapper(void *aUserData, void *pHeader, unsigned long *pPhyAddr);
 
     int VSP_malloc_ctuinfo_cb(unsigned int size_mbinfo, unsigned long *pPhyAddr);
     int VSP_malloc_cb(unsigned int size_extra);
+    SprdIonArena *getIonArena();
     int VSP_bind_cb(void *pHeader, unsigned long *pPhyAddr);
     int VSP_unbind_cb(void *pHeader, unsigned long *pPhyAddr);
     bool openDecoder(const char* libName);
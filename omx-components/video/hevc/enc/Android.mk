@@ -39,6 +39,8 @@ LOCAL_MODULE := libstagefright_sprd_h265enc
 LOCAL_MODULE_TAGS := optional
 LOCAL_PROPRIETARY_MODULE := true
 
+LOCAL_STATIC_LIBRARIES := libsprd_colorconvert
+
 ifeq ($(strip $(TARGET_BOARD_CAMERA_ANTI_SHAKE)),true)
 LOCAL_CFLAGS += -DANTI_SHAKE
 endif
@@ -47,10 +49,6 @@ ifeq ($(strip $(TARGET_BOARD_CAMERA_EIS)),true)
     LOCAL_CFLAGS += -DCONFIG_SPRD_RECORD_EIS
 endif
 
-ifeq ($(strip $(TARGET_BIA_SUPPORT)),true)
-    LOCAL_CFLAGS += -DCONFIG_BIA_SUPPORT
-endif
-
 ifeq ($(strip $(SUPPORT_RGB_ENC)),true)
     LOCAL_CFLAGS += -DCONFIG_RGB_ENC_SUPPORT
 endif
@@ -18,6 +18,9 @@
 #define SPRD_HEVC_ENCODER_H_
 
 #include "SprdSimpleOMXComponent.h"
+#include "SprdDumpWriter.h"
+#include "SprdEncoderInputRing.h"
+#include "SprdIovaCache.h"
 
 #include "hevc_enc_api.h"
 
@@ -51,6 +54,11 @@ struct SPRDHEVCEncoder :  public SprdSimpleOMXComponent {
 protected:
     virtual ~SPRDHEVCEncoder();
 
+    virtual void onReset();
+    virtual void onPortEnableCompleted(OMX_U32 portIndex, bool enabled);
+    virtual void onPortFlushPrepare(OMX_U32 portIndex);
+    virtual void onInputBufferArrived(OMX_BUFFERHEADERTYPE *header);
+
 private:
     enum {
         kNumBuffers = 4,
@@ -83,6 +91,7 @@ private:
     OMX_BOOL mStoreMetaData;
     OMX_BOOL mPrependSPSPPS;
     bool     mIOMMUEnabled;
+    SprdIovaCache *mIovaCache;
     int mIOMMUID;
     bool     mDumpYUVEnabled;
     bool     mDumpStrmEnabled;
@@ -96,10 +105,23 @@ private:
 
     uint8_t *mPbuf_inter;
 
-    sp<MemIon> mYUVInPmemHeap;
-    uint8_t *mPbuf_yuv_v;
-    unsigned long mPbuf_yuv_p;
-    size_t mPbuf_yuv_size;
+    // Staging buffer of the input ring and the frame prepared in it.
+    struct InputSlot {
+        InputSlot() : mVirt(NULL), mPhy(0), mSize(0) {}
+
+        sp<MemIon> mHeap;
+        uint8_t *mVirt;
+        unsigned long mPhy;
+        size_t mSize;
+        MMEncIn mIn;   // source address, format and crop
+    };
+
+    SprdEncoderInputRing *mInputRing;
+    InputSlot mInputSlots[SprdEncoderInputRing::kMaxSlots];
+
+    // The input ring thread maps and unmaps through the engine while the
+    // looper encodes; the engine takes neither call during an encode.
+    Mutex mEngineLock;
 
     sp<MemIon> mPmem_stream;
     sp<MemIon> mPmem_streamPn;
@@ -145,8 +167,8 @@ private:
     MMEncVideoInfo mEncInfo;
     MMEncCapability mCapability;
 
-    FILE* mFile_yuv;
-    FILE* mFile_bs;
+    SprdDumpWriter *mFile_yuv;
+    SprdDumpWriter *mFile_bs;
 
     void initPorts();
     OMX_ERRORTYPE initEncParams();
@@ -157,6 +179,12 @@ private:
     void flushCacheforBSBuf();
     static void FlushCacheWrapper(void* aUserData);
 
+    static int IovaCacheMapWrapper(void *cookie, int fd, unsigned long *iova, size_t *size);
+    static void IovaCacheUnmapWrapper(void *cookie, unsigned long iova, size_t size);
+
+    bool prepareInput(OMX_BUFFERHEADERTYPE *inHeader, InputSlot *slot);
+    static bool PrepareInputWrapper(void *cookie, OMX_BUFFERHEADERTYPE *header, int32_t slot);
+
     DISALLOW_EVIL_CONSTRUCTORS(SPRDHEVCEncoder);
 };
 
@@ -175,6 +175,10 @@ SPRDMPEG4Decoder::SPRDMPEG4Decoder(
         }
     }
 
+    if (!mDecoderSwFlag) {
+        enableVspScheduling(SprdVspScheduler::kCoreDecoder);
+    }
+
     char value_dump[PROPERTY_VALUE_MAX];
 
     property_get("vendor.m4vdec.yuv.dump", value_dump, "false");
@@ -183,6 +187,12 @@ SPRDMPEG4Decoder::SPRDMPEG4Decoder(
     property_get("vendor.m4vdec.strm.dump", value_dump, "false");
     mDumpStrmEnabled = !strcmp(value_dump, "true");
     ALOGI("%s, mDumpYUVEnabled: %d, mDumpStrmEnabled: %d", __FUNCTION__, mDumpYUVEnabled, mDumpStrmEnabled);
+
+    property_get("vendor.m4vdec.async", value_dump, "false");
+    if (!strcmp(value_dump, "true")) {
+        startDecodeThread();
+    }
+
     mPVolHeader = (uint8_t *)malloc(MPEG4_VOL_HEADER_SIZE);
     CHECK(mPVolHeader);
 
@@ -604,6 +614,7 @@ OMX_ERRORTYPE SPRDMPEG4Decoder::internalSetParameter(
         }
         if(defParams->nBufferCountActual == 1) {
              mThumbnailMode = OMX_TRUE;
+             setVspPriority(SprdVspScheduler::kPriorityBackground);
         } else {
             if (defParams->nBufferCountActual < port->mDef.nBufferCountMin) {
                 ALOGW("component requires at least %u buffers (%u requested)",
@@ -720,20 +731,8 @@ OMX_ERRORTYPE SPRDMPEG4Decoder::internalUseBuffer(
         }
     }
 
-    PortInfo *port = editPortInfo(portIndex);
-
-    port->mBuffers.push();
-
-    BufferInfo *buffer =
-        &port->mBuffers.editItemAt(port->mBuffers.size() - 1);
     ALOGI("internalUseBuffer, header=0x%p, pBuffer=0x%p, size=%d",*header, ptr, size);
-    buffer->mHeader = *header;
-    buffer->mOwnedByUs = false;
-
-    if (port->mBuffers.size() == port->mDef.nBufferCountActual) {
-        port->mDef.bPopulated = OMX_TRUE;
-        checkTransitions();
-    }
+    addBuffer(portIndex, *header);
 
     return OMX_ErrorNone;
 }
@@ -769,6 +768,7 @@ OMX_ERRORTYPE SPRDMPEG4Decoder::allocateBuffer(
             fd = pMem->getHeapID();
             if(fd < 0) {
                 ALOGE("Failed to alloc outport pmem buffer");
+                delete pMem;
                 return OMX_ErrorInsufficientResources;
             }
 
@@ -776,11 +776,13 @@ OMX_ERRORTYPE SPRDMPEG4Decoder::allocateBuffer(
                 ret = (*mMP4DecGetIOVA)(mHandle, fd, &phyAddr, &bufferSize);
                 if(ret) {
                     ALOGE("MP4DecGetIOVA Failed: %d(%s)", ret, strerror(errno));
+                    delete pMem;
                     return OMX_ErrorInsufficientResources;
                 }
             } else {
                 if(pMem->get_phy_addr_from_ion(&phyAddr, &bufferSize)) {
                     ALOGE("get_phy_addr_from_ion fail");
+                    delete pMem;
                     return OMX_ErrorInsufficientResources;
                 }
             }
@@ -856,6 +858,10 @@ OMX_ERRORTYPE SPRDMPEG4Decoder::getConfig(
         return OMX_ErrorNone;
     }
 
+    case OMX_IndexConfigCodecMetrics:
+    case OMX_IndexConfigCallbackBatching:
+        return SprdSimpleOMXComponent::getConfig(index, params);
+
     default:
         return OMX_ErrorUnsupportedIndex;
     }
@@ -870,6 +876,7 @@ OMX_ERRORTYPE SPRDMPEG4Decoder::setConfig(
 
         if (*pEnable == OMX_TRUE) {
             mThumbnailMode = OMX_TRUE;
+            setVspPriority(SprdVspScheduler::kPriorityBackground);
         }
 
         ALOGI("setConfig, mThumbnailMode = %d", mThumbnailMode);
@@ -889,6 +896,9 @@ OMX_ERRORTYPE SPRDMPEG4Decoder::setConfig(
     case OMX_IndexConfigDecSceneMode:
     {
         int *pDecSceneMode = (int *)params;
+        if (*pDecSceneMode == 3) { // VoLTE
+            setVspPriority(SprdVspScheduler::kPriorityRealtime);
+        }
 #ifdef CONFIG_AFBC_SUPPORT
         if(*pDecSceneMode == 4) {
             mUsage = GRALLOC_USAGE_CURSOR | GRALLOC_USAGE_SW_WRITE_NEVER;
@@ -916,6 +926,7 @@ void SPRDMPEG4Decoder::onQueueFilled(OMX_U32 portIndex) {
     if(mChangeToSwDec) {
 
         mChangeToSwDec = false;
+        mMetrics.count(SprdCodecMetrics::kCounterSwFallbacks);
 
         ALOGI("%s, %d, change to sw decoder", __FUNCTION__, __LINE__);
 
@@ -935,6 +946,7 @@ void SPRDMPEG4Decoder::onQueueFilled(OMX_U32 portIndex) {
         }
 
         mDecoderSwFlag = true;
+        disableVspScheduling();
 
         if(initDecoder() != OK) {
             ALOGE("onQueueFilled, init sw decoder failed.");
@@ -944,8 +956,8 @@ void SPRDMPEG4Decoder::onQueueFilled(OMX_U32 portIndex) {
         }
     }
 
-    List<BufferInfo *> &inQueue = getPortQueue(0);
-    List<BufferInfo *> &outQueue = getPortQueue(1);
+    PortQueue &inQueue = getPortQueue(0);
+    PortQueue &outQueue = getPortQueue(1);
 
     while (!mStopDecode && (mEOSStatus != INPUT_DATA_AVAILABLE || !inQueue.empty())
             && outQueue.size() != 0) {
@@ -958,13 +970,13 @@ void SPRDMPEG4Decoder::onQueueFilled(OMX_U32 portIndex) {
         BufferInfo *inInfo = *inQueue.begin();
         OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
 
-        List<BufferInfo *>::iterator itBuffer = outQueue.begin();
+        PortQueue::iterator itBuffer = outQueue.begin();
         OMX_BUFFERHEADERTYPE *outHeader = NULL;
         BufferCtrlStruct *pBufCtrl = NULL;
         size_t count = 0;
         do {
             if(count >= outQueue.size()) {
-                ALOGI("onQueueFilled, get outQueue buffer, return, count=%d, queue_size=%d",count, outQueue.size());
+                SPRD_FRAME_LOGI("onQueueFilled, get outQueue buffer, return, count=%d, queue_size=%d",count, outQueue.size());
                 return;
             }
 
@@ -981,7 +993,7 @@ void SPRDMPEG4Decoder::onQueueFilled(OMX_U32 portIndex) {
             count++;
         } while (pBufCtrl->iRefCount > 0);
 
-        ALOGI("%s, %d, outHeader:0x%p, inHeader: 0x%p, len: %d, time: %lld, EOS: %d, cfg:%d",
+        SPRD_FRAME_LOGI("%s, %d, outHeader:0x%p, inHeader: 0x%p, len: %d, time: %lld, EOS: %d, cfg:%d",
                 __FUNCTION__, __LINE__,outHeader, inHeader, inHeader->nFilledLen, inHeader->nTimeStamp,
                 inHeader->nFlags & OMX_BUFFERFLAG_EOS, inHeader->nFlags & OMX_BUFFERFLAG_CODECCONFIG);
 
@@ -1150,6 +1162,7 @@ void SPRDMPEG4Decoder::onQueueFilled(OMX_U32 portIndex) {
 
         if (mPbuf_stream_v != NULL) {
             memcpy(mPbuf_stream_v, bitstream, bufferSize);
+            mMetrics.count(SprdCodecMetrics::kCounterCopyBytes, bufferSize);
         }
         dec_in.pStream= mPbuf_stream_v;
         dec_in.pStream_phy= mPbuf_stream_p;
@@ -1168,11 +1181,13 @@ void SPRDMPEG4Decoder::onQueueFilled(OMX_U32 portIndex) {
                 fwrite(mPbuf_stream_v, 1, dec_in.dataLen, mFile_bs);
             }
         }
-        int64_t start_decode = systemTime();
-        MMDecRet decRet = (*mMP4DecDecode)(mHandle, &dec_in, &dec_out);
-        int64_t end_decode = systemTime();
-        ALOGI("%s, %d, decRet: %d, %dms, frameEffective: %d, pOutFrameY: %0x, pBufferHeader: %0x, needIVOP: %d, error_flag: %0x",
-              __FUNCTION__, __LINE__, decRet, (unsigned int)((end_decode-start_decode) / 1000000L),dec_out.frameEffective,
+        MMDecRet decRet;
+        {
+            HardwareSection section(this);
+            decRet = (*mMP4DecDecode)(mHandle, &dec_in, &dec_out);
+        }
+        SPRD_FRAME_LOGI("%s, %d, decRet: %d, %dms, frameEffective: %d, pOutFrameY: %0x, pBufferHeader: %0x, needIVOP: %d, error_flag: %0x",
+              __FUNCTION__, __LINE__, decRet, (unsigned int)(mMetrics.lastUs(SprdCodecMetrics::kHistogramEngineTime) / 1000),dec_out.frameEffective,
               dec_out.pOutFrameY, dec_out.pBufferHeader,mNeedIVOP, mHandle->g_mpeg4_dec_err_flag);
 
         if(iUseAndroidNativeBuffer[OMX_DirOutput]) {
@@ -1215,8 +1230,10 @@ void SPRDMPEG4Decoder::onQueueFilled(OMX_U32 portIndex) {
             return;
         } else if (decRet == MMDEC_STREAM_ERROR) {
             ALOGE("failed to decode video frame, stream error");
+            mMetrics.count(SprdCodecMetrics::kCounterErrors);
         } else if (decRet == MMDEC_HW_ERROR) {
             ALOGE("failed to decode video frame, hardware error");
+            mMetrics.count(SprdCodecMetrics::kCounterErrors);
         } else if (decRet == MMDEC_NOT_SUPPORTED) {
             ALOGE("failed to decode video frame, unsupported");
             notify(OMX_EventError, OMX_ErrorUnsupportedSetting, 0, NULL);
@@ -1250,7 +1267,7 @@ void SPRDMPEG4Decoder::onQueueFilled(OMX_U32 portIndex) {
             if(mThumbnailMode) {
                 mStopDecode = true;
             }
-            ALOGI("%s, %d, dec_out.pBufferHeader: 0x%p, time: %lld", __FUNCTION__, __LINE__, outHeader, outHeader->nTimeStamp);
+            SPRD_FRAME_LOGI("%s, %d, dec_out.pBufferHeader: 0x%p, time: %lld", __FUNCTION__, __LINE__, outHeader, outHeader->nTimeStamp);
         if(mDumpYUVEnabled){
             if (mFile_yuv != NULL) {
                 fwrite(dec_out.pOutFrameY, 1, outHeader->nFilledLen, mFile_yuv);
@@ -1261,15 +1278,11 @@ void SPRDMPEG4Decoder::onQueueFilled(OMX_U32 portIndex) {
         }
 
 
-        List<BufferInfo *>::iterator it = outQueue.begin();
-        while ((*it)->mHeader != outHeader && it != outQueue.end()) {
-            ++it;
-        }
-        CHECK((*it)->mHeader == outHeader);
+        BufferInfo *outInfo = findBufferInfo(kOutputPortIndex, outHeader);
+        CHECK(outInfo != NULL && outInfo->mQueued);
 
-        BufferInfo *outInfo = *it;
         outInfo->mOwnedByUs = false;
-        outQueue.erase(it);
+        outQueue.erase(outInfo);
         outInfo = NULL;
 
         BufferCtrlStruct* pOutBufCtrl= (BufferCtrlStruct*)(outHeader->pOutputPortPrivate);
@@ -1283,7 +1296,7 @@ void SPRDMPEG4Decoder::onQueueFilled(OMX_U32 portIndex) {
 bool SPRDMPEG4Decoder::drainAllOutputBuffers() {
     ALOGI("%s, %d", __FUNCTION__, __LINE__);
 
-    List<BufferInfo *> &outQueue = getPortQueue(1);
+    PortQueue &outQueue = getPortQueue(1);
     BufferInfo *outInfo;
     OMX_BUFFERHEADERTYPE *outHeader;
     void *pBufferHeader;
@@ -1291,13 +1304,9 @@ bool SPRDMPEG4Decoder::drainAllOutputBuffers() {
     while (!outQueue.empty() && mEOSStatus != OUTPUT_FRAMES_FLUSHED) {
         if (mHeadersDecoded &&(*mMP4DecGetLastDspFrm)(mHandle, &pBufferHeader) ) {
             ALOGI("%s, %d, MP4DecGetLastDspFrm, pBufferHeader: 0x%p", __FUNCTION__, __LINE__, pBufferHeader);
-            List<BufferInfo *>::iterator it = outQueue.begin();
-            while ((*it)->mHeader != (OMX_BUFFERHEADERTYPE*)pBufferHeader && it != outQueue.end()) {
-                ++it;
-            }
-            CHECK((*it)->mHeader == (OMX_BUFFERHEADERTYPE*)pBufferHeader);
-            outInfo = *it;
-            outQueue.erase(it);
+            outInfo = findBufferInfo(kOutputPortIndex, (OMX_BUFFERHEADERTYPE*)pBufferHeader);
+            CHECK(outInfo != NULL && outInfo->mQueued);
+            outQueue.erase(outInfo);
             outHeader = outInfo->mHeader;
             outHeader->nFilledLen = (mWidth * mHeight * 3) / 2;
         } else {
@@ -1601,6 +1610,8 @@ OMX_ERRORTYPE SPRDMPEG4Decoder::getExtensionIndex(
         ALOGI("getExtensionIndex:%s",SPRD_INDEX_CONFIG_DEC_SCENE_MODE);
         *index = (OMX_INDEXTYPE) OMX_IndexConfigDecSceneMode;
         return OMX_ErrorNone;
+    } else if (!strcmp(name, SPRD_INDEX_CONFIG_CODEC_METRICS)) {
+        return SprdSimpleOMXComponent::getExtensionIndex(name, index);
     }
 
     return OMX_ErrorNotImplemented;
@@ -37,6 +37,8 @@ LOCAL_SHARED_LIBRARIES := \
     liblog                     \
     libcutils
 
+LOCAL_STATIC_LIBRARIES := libsprd_colorconvert
+
 LOCAL_MODULE := libstagefright_sprd_mpeg4enc
 LOCAL_MODULE_TAGS := optional
 LOCAL_PROPRIETARY_MODULE := true
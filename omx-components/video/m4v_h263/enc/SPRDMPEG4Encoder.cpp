@@ -35,6 +35,8 @@
 #include "MemIon.h"
 
 #include "SPRDMPEG4Encoder.h"
+#include "SprdColorConvert.h"
+#include "SprdStripePool.h"
 #include "sprd_ion.h"
 #include "gralloc_public.h"
 #include <cutils/properties.h>
@@ -59,125 +61,6 @@ void dump_yuv(uint8 * pBuffer, uint32 aInBufSize) {
     fclose(fp);
 }
 
-/*
- * In case of orginal input height_org is not 16 aligned, we shoud copy original data to a larger space
- * Example: width_org = 640, height_org = 426,
- * We have to copy this data to a width_dst = 640 height_dst = 432 buffer which is 16 aligned.
- * Be careful, when doing this convert we MUST keep UV in their right position.
- *
- * FIXME: If width_org is not 16 aligned also, this would be much complicate
- *
- */
-inline static void ConvertYUV420PlanarToYVU420SemiPlanar(
-    uint8_t *inyuv, uint8_t* outyuv,
-    int32_t width_org, int32_t height_org,
-    int32_t width_dst, int32_t height_dst) {
-
-    int32_t inYsize = width_org * height_org;
-    uint32_t *outy = (uint32_t *) outyuv;
-    uint16_t *incb = (uint16_t *) (inyuv + inYsize);
-    uint16_t *incr = (uint16_t *) (inyuv + inYsize + (inYsize >> 2));
-
-    /* Y copying */
-    memcpy(outy, inyuv, inYsize);
-
-    /* U & V copying */
-    uint32_t *outUV = (uint32_t *) (outyuv + width_dst * height_dst);
-    for (int32_t i = height_org >> 1; i > 0; --i) {
-        for (int32_t j = width_org >> 2; j > 0; --j) {
-            uint32_t tempU = *incb++;
-            uint32_t tempV = *incr++;
-
-            tempU = (tempU & 0xFF) | ((tempU & 0xFF00) << 8);
-            tempV = (tempV & 0xFF) | ((tempV & 0xFF00) << 8);
-            uint32_t temp = tempV | (tempU << 8);
-
-            // Flip U and V
-            *outUV++ = temp;
-        }
-    }
-}
-static int RGB_r_y[256];
-static int RGB_r_cb[256];
-static int RGB_r_cr_b_cb[256];
-static int RGB_g_y[256];
-static int RGB_g_cb[256];
-static int RGB_g_cr[256];
-static int RGB_b_y[256];
-static int RGB_b_cr[256];
-static  bool mConventFlag = false;
-
-// init the convert table, the Transformation matrix is as:
-// Y  =  ((66 * (_r)  + 129 * (_g)  + 25    * (_b)) >> 8) + 16
-// Cb = ((-38 * (_r) - 74   * (_g)  + 112  * (_b)) >> 8) + 128
-// Cr =  ((112 * (_r) - 94   * (_g)  - 18    * (_b)) >> 8) + 128
-inline static void inittable() {
-    ALOGI("init table");
-    int i = 0;
-    for (i = 0; i < 256; i++) {
-        RGB_r_y[i] =  ((66 * i) >> 8);
-        RGB_r_cb[i] = ((38 * i) >> 8);
-        RGB_r_cr_b_cb[i] = ((112 * i) >> 8);
-        RGB_g_y[i] = ((129 * i) >> 8) + 16;
-        RGB_g_cb[i] = ((74 * i) >> 8) + 128;
-        RGB_g_cr[i] = ((94 * i) >> 8) + 128;
-        RGB_b_y[i] =  ((25 * i) >> 8);
-        RGB_b_cr[i] = ((18 * i) >> 8);
-    }
-}
-inline static void ConvertARGB888ToYVU420SemiPlanar(uint8_t *inrgb, uint8_t* outyuv,
-        int32_t width_org, int32_t height_org, int32_t width_dst, int32_t height_dst) {
-#define RGB2Y(_r, _g, _b)    (*(RGB_r_y +_r)      +   *(RGB_g_y+_g)   +    *(RGB_b_y+_b))
-#define RGB2CB(_r, _g, _b)   (-*(RGB_r_cb +_r)     -   *(RGB_g_cb+_g)  +    *(RGB_r_cr_b_cb+_b))
-#define RGB2CR(_r, _g, _b)   (*(RGB_r_cr_b_cb +_r) -   *(RGB_g_cr+_g)  -    *(RGB_b_cr+_b))
-    uint8_t *argb_ptr = inrgb;
-    uint8_t *y_p = outyuv;
-    uint8_t *vu_p = outyuv + width_dst * height_dst;
-
-    if (NULL == inrgb || NULL ==  outyuv)
-        return;
-    if (0 != (width_org & 1) || 0 != (height_org & 1))
-        return;
-    if (!mConventFlag) {
-        mConventFlag = true;
-        inittable();
-    }
-    ALOGI("rgb2yuv start");
-    uint8_t *y_ptr;
-    uint8_t *vu_ptr;
-    int64_t start_encode = systemTime();
-    uint32 i;
-    uint32 j = height_org + 1;
-    while (--j) {
-        // the width_dst may be bigger than width_org,
-        // make start byte in every line of Y and CbCr align
-        y_ptr = y_p;
-        y_p += width_dst;
-        if (!(j & 1))  {
-            vu_ptr = vu_p;
-            vu_p += width_dst;
-            i  = width_org / 2 + 1;
-            while (--i) {
-                // format abgr, litter endian
-                *y_ptr++    = RGB2Y(*argb_ptr, *(argb_ptr+1), *(argb_ptr+2));
-                *vu_ptr++ =  RGB2CR(*argb_ptr, *(argb_ptr+1), *(argb_ptr+2));
-                *vu_ptr++  = RGB2CB(*argb_ptr, *(argb_ptr+1), *(argb_ptr+2));
-                *y_ptr++    = RGB2Y(*(argb_ptr + 4), *(argb_ptr+5), *(argb_ptr+6));
-                argb_ptr += 8;
-            }
-        } else {
-            i  = width_org + 1;
-            while (--i) {
-                // format abgr, litter endian
-                *y_ptr++ = RGB2Y(*argb_ptr, *(argb_ptr+1), *(argb_ptr+2));
-                argb_ptr += 4;
-            }
-        }
-    }
-    int64_t end_encode = systemTime();
-    ALOGI("rgb2yuv time: %d", (unsigned int)((end_encode-start_encode) / 1000000L));
-}
-
 SPRDMPEG4Encoder::SPRDMPEG4Encoder(
     const char *name,
     const OMX_CALLBACKTYPE *callbacks,
@@ -197,6 +80,7 @@ SPRDMPEG4Encoder::SPRDMPEG4Encoder(
       mNeedAlign(true),
       mStoreMetaData(OMX_FALSE),
       mIOMMUEnabled(false),
+      mIovaCache(NULL),
       mIOMMUID(-1),
       mDumpYUVEnabled(false),
       mDumpStrmEnabled(false),
@@ -206,9 +90,7 @@ SPRDMPEG4Encoder::SPRDMPEG4Encoder(
       mKeyFrameRequested(false),
       mIsH263(0),
       mPbuf_inter(NULL),
-      mPbuf_yuv_v(NULL),
-      mPbuf_yuv_p(0),
-      mPbuf_yuv_size(0),
+      mInputRing(NULL),
       mPbuf_stream_v(NULL),
       mPbuf_stream_p(0),
       mPbuf_stream_size(0),
@@ -257,6 +139,7 @@ SPRDMPEG4Encoder::SPRDMPEG4Encoder(
         mCacheType = MemIon::NO_CACHING;
         mCacheMask = 0;
         mEncoderSwFlag = false;
+        enableVspScheduling(SprdVspScheduler::kCoreEncoder);
     }
     if (!strcmp(name, "OMX.sprd.h263.encoder")) {
         mIsH263 = 1;
@@ -277,6 +160,13 @@ SPRDMPEG4Encoder::SPRDMPEG4Encoder(
     mDumpStrmEnabled = !strcmp(value_dump, "true");
     ALOGI("%s, mDumpYUVEnabled: %d, mDumpStrmEnabled: %d", __FUNCTION__, mDumpYUVEnabled, mDumpStrmEnabled);
 
+    // Encode on a thread of our own, so the looper keeps taking buffers
+    // while the engine is busy.
+    property_get("vendor.m4venc.async", value_dump, "false");
+    if (!strcmp(value_dump, "true")) {
+        startDecodeThread();
+    }
+
     MMCodecBuffer InterMemBfr;
     uint32_t size_inter = MP4ENC_INTERNAL_BUFFER_SIZE;
 
@@ -305,6 +195,15 @@ SPRDMPEG4Encoder::SPRDMPEG4Encoder(
     } else {
         mIOMMUEnabled = true;
     }
+    if (mIOMMUEnabled) {
+        mIovaCache = new SprdIovaCache("mpeg4_enc", IovaCacheMapWrapper, IovaCacheUnmapWrapper, this);
+    }
+    mInputRing = new SprdEncoderInputRing("mpeg4_enc", PrepareInputWrapper, this);
+    if (mIovaCache != NULL) {
+        // Every slot may hold a frame the engine reads through a cached
+        // mapping; evicting one would unmap it under the engine.
+        mIovaCache->reserve(mInputRing->slotCount() + 1);
+    }
 
    instances++;
     if (instances > MAX_INSTANCES) {
@@ -316,7 +215,7 @@ SPRDMPEG4Encoder::SPRDMPEG4Encoder(
     if(mDumpYUVEnabled){
         char s1[100];
         sprintf(s1,"/data/misc/media/video_in_%p_%lld.yuv",(void *)this,start_encode);
-        mFile_yuv = fopen(s1, "wb");
+        mFile_yuv = new SprdDumpWriter(s1);
         ALOGI("yuv file name %s",s1);
     }
 
@@ -324,7 +223,7 @@ SPRDMPEG4Encoder::SPRDMPEG4Encoder(
         char s2[100];
         sprintf(s2,"/data/misc/media/video_es_%p_%lld.m4v",(void *)this,start_encode);
         ALOGI("bs file name %s",s2);
-        mFile_bs = fopen(s2, "wb");
+        mFile_bs = new SprdDumpWriter(s2);
     }
 }
 
@@ -333,8 +232,14 @@ SPRDMPEG4Encoder::~SPRDMPEG4Encoder() {
 
     releaseEncoder();
 
-    List<BufferInfo *> &outQueue = getPortQueue(1);
-    List<BufferInfo *> &inQueue = getPortQueue(0);
+    delete mIovaCache;
+    mIovaCache = NULL;
+
+    delete mInputRing;
+    mInputRing = NULL;
+
+    PortQueue &outQueue = getPortQueue(1);
+    PortQueue &inQueue = getPortQueue(0);
     CHECK(outQueue.empty());
     CHECK(inQueue.empty());
 
@@ -344,17 +249,13 @@ SPRDMPEG4Encoder::~SPRDMPEG4Encoder() {
     }
     instances--;
     if(mDumpYUVEnabled){
-        if (mFile_yuv) {
-            fclose(mFile_yuv);
-            mFile_yuv = NULL;
-        }
+        delete mFile_yuv;
+        mFile_yuv = NULL;
     }
 
     if(mDumpStrmEnabled){
-        if (mFile_bs) {
-            fclose(mFile_bs);
-            mFile_bs = NULL;
-        }
+        delete mFile_bs;
+        mFile_bs = NULL;
     }
 }
 
@@ -506,8 +407,63 @@ OMX_ERRORTYPE SPRDMPEG4Encoder::initEncoder() {
     return OMX_ErrorNone;
 }
 
+// static
+int SPRDMPEG4Encoder::IovaCacheMapWrapper(
+    void *cookie, int fd, unsigned long *iova, size_t *size) {
+    SPRDMPEG4Encoder *encoder = static_cast<SPRDMPEG4Encoder *>(cookie);
+    encoder->mMetrics.count(SprdCodecMetrics::kCounterIovaMaps);
+    Mutex::Autolock autoLock(encoder->mEngineLock);
+    return (*encoder->mMP4EncGetIOVA)(encoder->mHandle, fd, iova, size);
+}
+
+// static
+void SPRDMPEG4Encoder::IovaCacheUnmapWrapper(
+    void *cookie, unsigned long iova, size_t size) {
+    SPRDMPEG4Encoder *encoder = static_cast<SPRDMPEG4Encoder *>(cookie);
+    Mutex::Autolock autoLock(encoder->mEngineLock);
+    (*encoder->mMP4EncFreeIOVA)(encoder->mHandle, iova, size);
+}
+
+void SPRDMPEG4Encoder::onReset() {
+    // Idle -> Loaded: the client may now free the buffers it sent us.
+    mInputRing->discard();
+    if (mIovaCache != NULL) {
+        mIovaCache->flush();
+    }
+}
+
+void SPRDMPEG4Encoder::onPortEnableCompleted(OMX_U32 portIndex, bool enabled) {
+    if (portIndex != kInputPortIndex || enabled) {
+        return;
+    }
+
+    mInputRing->discard();
+    if (mIovaCache != NULL) {
+        mIovaCache->flush();
+    }
+}
+
+void SPRDMPEG4Encoder::onPortFlushPrepare(OMX_U32 portIndex) {
+    if (portIndex == kInputPortIndex) {
+        // Stop reading the inputs before they go back to the client.
+        mInputRing->discard();
+    }
+}
+
+// Starts preparing the frame while the engine may still be busy with the
+// previous one; onQueueFilled() only runs once that one is done.
+void SPRDMPEG4Encoder::onInputBufferArrived(OMX_BUFFERHEADERTYPE *header) {
+    if (header->nFilledLen > 0) {
+        mInputRing->prefetch(header);
+    }
+}
+
 OMX_ERRORTYPE SPRDMPEG4Encoder::releaseEncoder() {
 
+    if (mIovaCache != NULL) {
+        mIovaCache->flush();
+    }
+
     if(mEncoderSwFlag==true)
         (*mMP4EncRelease)(mHandle);
 
@@ -531,14 +487,20 @@ OMX_ERRORTYPE SPRDMPEG4Encoder::releaseEncoder() {
         mPbuf_stream_size = 0;
     }
 
-    if (mPbuf_yuv_v != NULL) {
-        if (mIOMMUEnabled) {
-            (*mMP4EncFreeIOVA)(mHandle, mPbuf_yuv_p, mPbuf_yuv_size);
+    if (mInputRing != NULL) {
+        mInputRing->discard();
+    }
+    for (int32_t i = 0; i < SprdEncoderInputRing::kMaxSlots; ++i) {
+        InputSlot *slot = &mInputSlots[i];
+        if (slot->mVirt != NULL) {
+            if (mIOMMUEnabled) {
+                (*mMP4EncFreeIOVA)(mHandle, slot->mPhy, slot->mSize);
+            }
+            slot->mHeap.clear();
+            slot->mVirt = NULL;
+            slot->mPhy = 0;
+            slot->mSize = 0;
         }
-        mYUVInPmemHeap.clear();
-        mPbuf_yuv_v = NULL;
-        mPbuf_yuv_p = 0;
-        mPbuf_yuv_size = 0;
     }
     if(mEncoderSwFlag==false)
         (*mMP4EncRelease)(mHandle);
@@ -1133,6 +1095,315 @@ OMX_ERRORTYPE SPRDMPEG4Encoder::getExtensionIndex(
     return SprdSimpleOMXComponent::getExtensionIndex(name, index);
 }
 
+// static
+bool SPRDMPEG4Encoder::PrepareInputWrapper(
+        void *cookie, OMX_BUFFERHEADERTYPE *header, int32_t slot) {
+    SPRDMPEG4Encoder *encoder = static_cast<SPRDMPEG4Encoder *>(cookie);
+    return encoder->prepareInput(header, &encoder->mInputSlots[slot]);
+}
+
+// Maps or converts the frame in inHeader into slot. Runs on the input
+// ring thread while the engine encodes the previous frame, or inline.
+bool SPRDMPEG4Encoder::prepareInput(OMX_BUFFERHEADERTYPE *inHeader, InputSlot *slot) {
+    const void *inData = inHeader->pBuffer + inHeader->nOffset;
+    uint8_t *inputData = (uint8_t *) inData;
+    CHECK(inputData != NULL);
+
+    MMEncIn vid_in;
+    memset(&vid_in, 0, sizeof(vid_in));
+    uint8_t* py = NULL;
+    uint8_t* py_phy = NULL;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t x = 0;
+    uint32_t y = 0;
+    int bufFd = -1;
+
+    if (mVideoColorFormat == OMX_COLOR_FormatYUV420SemiPlanar) {
+        vid_in.yuv_format = MMENC_YUV420SP_NV12;
+    } else {
+        vid_in.yuv_format = MMENC_YUV420SP_NV21;
+    }
+
+    if (mStoreMetaData) {
+        unsigned int *mataData = (unsigned int *)inputData;
+        unsigned int type = *mataData++;
+        if (type == kMetadataBufferTypeCameraSource) {
+            py_phy = (uint8_t*)(*(unsigned long *)mataData);
+            mataData += sizeof(unsigned long)/sizeof(unsigned int);
+            py = (uint8_t*)(*(unsigned long *)mataData);
+            mataData += sizeof(unsigned long)/sizeof(unsigned int);
+            width = (uint32_t)(*((uint32_t *) mataData++));
+            height = (uint32_t)(*((uint32_t *) mataData++));
+            x = (uint32_t)(*((uint32_t *) mataData++));
+            y = (uint32_t)(*((uint32_t *) mataData++));
+            int fd = (int32)(*((int32*) mataData));
+            unsigned long py_addr=0;
+            size_t buf_size=0;
+            int ret = 0;
+            if (mIOMMUEnabled) {
+                ret = mIovaCache->map(fd, &py_addr, &buf_size);
+            } else {
+                ret = MemIon::Get_phy_addr_from_ion(fd, &py_addr, &buf_size);
+            }
+            if(ret) {
+                ALOGE("Failed to Get_iova or Get_phy_addr_from_ion %d", ret);
+                return false;
+            }
+            if (mIOMMUEnabled) {
+                bufFd = fd;
+            }
+            py_phy = (uint8_t*)py_addr;
+        } else if (type == kMetadataBufferTypeGrallocSource) {
+            buffer_handle_t buf = *((buffer_handle_t *)(inputData + sizeof(void *)));
+
+            ALOGI("format:0x%x, usage:0x%x", ADP_FORMAT(buf), ADP_USAGE(buf));
+
+            if (slot->mVirt == NULL) {
+                size_t yuv_size;
+                if ((ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_RGBA_8888) && mSupportRGBEnc) {
+                    yuv_size = ((mVideoWidth+15)&(~15)) * ((mVideoHeight+15)&(~15)) * 4;
+                    vid_in.yuv_format = MMENC_RGBA32;
+                } else {
+                    yuv_size = mVideoWidth * mVideoHeight *3/2;
+                }
+
+                if (mIOMMUEnabled) {
+                    slot->mHeap = new MemIon("/dev/ion", yuv_size,mCacheType, mCacheMask | ION_HEAP_ID_MASK_SYSTEM);
+                } else {
+                    slot->mHeap = new MemIon("/dev/ion", yuv_size,mCacheType, mCacheMask | ION_HEAP_ID_MASK_MM);
+                }
+
+                int fd = slot->mHeap->getHeapID();
+                if (fd < 0) {
+                    ALOGE("Failed to alloc yuv buffer");
+                    return false;
+                }
+                int ret;
+                unsigned long phy_addr;
+                size_t buffer_size;
+
+                if (mIOMMUEnabled) {
+                    Mutex::Autolock autoLock(mEngineLock);
+                    ret = (*mMP4EncGetIOVA)(mHandle, fd, &phy_addr, &buffer_size);
+                } else {
+                    ret = slot->mHeap->get_phy_addr_from_ion(&phy_addr, &buffer_size);
+                }
+                if (ret) {
+                    ALOGE("Failed to get_phy_addr_from_ion %d", ret);
+                    return false;
+                }
+                slot->mVirt =(uint8_t *) slot->mHeap->getBase();
+                slot->mPhy = phy_addr;
+                slot->mSize = buffer_size;
+            }
+
+
+            py = slot->mVirt;
+            py_phy = (uint8_t *)slot->mPhy;
+
+            GraphicBufferMapper &mapper = GraphicBufferMapper::get();
+            Rect bounds(mVideoWidth, mVideoHeight);
+
+            void* vaddr = NULL;
+            struct android_ycbcr ycbcr;
+            ycbcr.chroma_step = 0;
+            if (ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_YCBCR_420_888){
+                if (mapper.lockYCbCr(buf, GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_NEVER, bounds, &ycbcr)) {
+                    ALOGE("%s, line:%d, mapper.lockYCbCr failed", __FUNCTION__, __LINE__);
+                    return false;
+                }
+                vaddr = malloc(mVideoWidth * mVideoHeight * 3 / 2);
+                SprdSimpleOMXComponent::ConvertFlexYUVToPlanar((uint8_t*)vaddr, mVideoWidth, mVideoHeight, &ycbcr, mVideoWidth, mVideoHeight);
+            } else {
+                if (mapper.lock(buf, GRALLOC_USAGE_SW_READ_OFTEN|GRALLOC_USAGE_SW_WRITE_NEVER, bounds, &vaddr)) {
+                    return false;
+                }
+            }
+
+            if (mVideoColorFormat == OMX_COLOR_FormatYUV420Planar) {
+                SprdConvertI420FrameToSemiPlanar((uint8_t*)vaddr, mVideoWidth, mVideoHeight, py, mVideoWidth, mVideoHeight, kSprdChromaVU,
+                        SprdStripePool::Run, SprdStripePool::getInstance());
+            } else if (mVideoColorFormat == OMX_COLOR_FormatAndroidOpaque) {
+                if (ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_YCbCr_420_SP || ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_YCBCR_420_888)
+                    vid_in.yuv_format = MMENC_YUV420SP_NV12;
+                else if ((ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_RGBA_8888) && mSupportRGBEnc)
+                    vid_in.yuv_format = MMENC_RGBA32;
+                else
+                    vid_in.yuv_format = MMENC_YUV420SP_NV21;
+
+                if(ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_YCrCb_420_SP ||
+                     ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_YCbCr_420_SP ||
+                     ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED ||
+                     ((ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_RGBA_8888) && mSupportRGBEnc)) {
+                    if (ADP_USAGE(buf) & GRALLOC_USAGE_HW_VIDEO_ENCODER) {
+                        unsigned long py_addr = 0;
+                        size_t buf_size = 0;
+                        int fd = ADP_BUFFD(buf);
+                        int ret = 0;
+
+                        if (mIOMMUEnabled) {
+                            ret = mIovaCache->map(fd, &py_addr, &buf_size);
+                        } else {
+                            ret = MemIon::Get_phy_addr_from_ion(fd, &py_addr, &buf_size);
+                        }
+                        if (ret) {
+                            ALOGE("Failed to Get_iova or Get_phy_addr_from_ion %d", ret);
+                            return false;
+                        }
+                        if (mIOMMUEnabled) {
+                            bufFd = fd;
+                        }
+
+                        py = (uint8_t*)vaddr;
+                        py_phy = (uint8_t*)py_addr;
+                    } else {
+                        SprdStripePool::getInstance()->copy(py, vaddr, mVideoWidth * mVideoHeight * 3/2);
+                    }
+                } else if (ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_YCbCr_420_P || ycbcr.chroma_step == 1) {
+                    SprdConvertI420FrameToSemiPlanar((uint8_t*)vaddr, mVideoWidth, mVideoHeight, py, mVideoWidth, mVideoHeight, kSprdChromaVU,
+                            SprdStripePool::Run, SprdStripePool::getInstance());
+                    free (vaddr);
+                } else if (ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_YCBCR_420_888 && ycbcr.chroma_step == 2) {
+                    SprdStripePool::getInstance()->copy(py, vaddr, mVideoWidth * mVideoHeight * 3/2);
+                    free (vaddr);
+                } else {
+                    SprdConvertRGBFrameToSemiPlanar((uint8_t*)vaddr, kSprdRgbLayoutRGBA, kSprdColorBT601Limited,
+                            mVideoWidth, mVideoHeight, py, mVideoWidth, mVideoHeight, kSprdChromaVU,
+                            SprdStripePool::Run, SprdStripePool::getInstance());
+                }
+            } else {
+                if (ADP_USAGE(buf) & GRALLOC_USAGE_HW_VIDEO_ENCODER) {
+                    unsigned long ion_addr = 0;
+                    size_t ion_size = 0;
+                    int fd = ADP_BUFFD(buf);
+
+                    if (mIOMMUEnabled) {
+                        if (mIovaCache->map(fd, &ion_addr, &ion_size)) {
+                            ALOGE("%s, %d, mMP4EncGetIOVA error", __FUNCTION__, __LINE__);
+                            return false;
+                        }
+                        bufFd = fd;
+                    } else {
+                        if (0 != MemIon::Get_phy_addr_from_ion(fd, &ion_addr, &ion_size)) {
+                            ALOGE("%s, %d, Get_phy_addr_from_ion error", __FUNCTION__, __LINE__);
+                            return false;
+                        }
+                    }
+
+                    py = (uint8_t*)vaddr;
+                    py_phy = (uint8_t*)ion_addr;
+                } else {
+                    SprdStripePool::getInstance()->copy(py, vaddr, mVideoWidth * mVideoHeight * 3/2);
+                }
+            }
+
+            if (mapper.unlock(buf)) {
+                return false;
+            }
+        } else {
+            ALOGE("Error MetadataBufferType %d", type);
+            return false;
+        }
+    } else {
+        if (slot->mVirt == NULL) {
+            size_t yuv_size;
+            if (mVideoColorFormat == OMX_COLOR_FormatAndroidOpaque && mSupportRGBEnc)
+                yuv_size = ((mVideoWidth+15)&(~15)) * ((mVideoHeight+15)&(~15)) * 4;
+            else
+                yuv_size = mVideoWidth * mVideoHeight * 3/2;
+            if (mIOMMUEnabled) {
+                slot->mHeap = new MemIon("/dev/ion", yuv_size,mCacheType, mCacheMask | ION_HEAP_ID_MASK_SYSTEM);
+            } else {
+                slot->mHeap = new MemIon("/dev/ion", yuv_size, mCacheType, mCacheMask | ION_HEAP_ID_MASK_MM);
+            }
+
+            int fd = slot->mHeap->getHeapID();
+            if (fd < 0) {
+                ALOGE("Failed to alloc yuv buffer");
+                return false;
+            }
+            int ret;
+            unsigned long phy_addr;
+            size_t buffer_size;
+
+            if (mIOMMUEnabled) {
+                Mutex::Autolock autoLock(mEngineLock);
+                ret = (*mMP4EncGetIOVA)(mHandle, fd, &phy_addr, &buffer_size);
+            } else {
+                ret = slot->mHeap->get_phy_addr_from_ion(&phy_addr, &buffer_size);
+            }
+            if (ret) {
+                ALOGE("Failed to get_phy_addr_from_ion %d", ret);
+                return false;
+            }
+            slot->mVirt =(uint8_t *) slot->mHeap->getBase();
+            slot->mPhy = phy_addr;
+            slot->mSize = buffer_size;
+        }
+
+
+        py = slot->mVirt;
+        py_phy = (uint8_t*)slot->mPhy;
+
+        if (mVideoColorFormat == OMX_COLOR_FormatYUV420Planar) {
+            SprdConvertI420FrameToSemiPlanar(inputData, mVideoWidth, mVideoHeight, py, mVideoWidth, mVideoHeight, kSprdChromaVU,
+                    SprdStripePool::Run, SprdStripePool::getInstance());
+        } else if (mVideoColorFormat == OMX_COLOR_FormatAndroidOpaque) {
+            if (mSupportRGBEnc) {
+                SprdStripePool::getInstance()->copy(py, inputData, ((mVideoWidth+15)&(~15)) * ((mVideoHeight+15)&(~15)) * 4);
+                vid_in.yuv_format = MMENC_RGBA32;
+            } else {
+                SprdConvertRGBFrameToSemiPlanar(inputData, kSprdRgbLayoutRGBA, kSprdColorBT601Limited,
+                        mVideoWidth, mVideoHeight, py, mVideoWidth, mVideoHeight, kSprdChromaVU,
+                        SprdStripePool::Run, SprdStripePool::getInstance());
+            }
+        } else {
+            SprdStripePool::getInstance()->copy(py, inputData, mVideoWidth * mVideoHeight * 3/2);
+        }
+    }
+#ifdef CONFIG_SPRD_RECORD_EIS
+    if (mEISMode) {
+        char *parameter = (char *)py+mVideoWidth * mVideoHeight * 3/2;
+        double *warp = (double *)parameter;
+        if (*warp++ == 16171225) {
+            for (int i=0;i<3;i++) {
+                for (int j=0;j<3;j++) {
+                    vid_in.matrix[i][j]=*warp++;
+                }
+            }
+        } else {
+            vid_in.matrix[0][0] = vid_in.matrix[1][1] = vid_in.matrix[2][2] = 1.0;
+            vid_in.matrix[0][1] = vid_in.matrix[0][2] = vid_in.matrix[1][0] = 0.0;
+            vid_in.matrix[1][2] = vid_in.matrix[2][0] = vid_in.matrix[2][1] = 0.0;
+        }
+        ALOGV("EISLib2record:%f %f %f %f %f %f %f %f %f",
+            vid_in.matrix[0][0], vid_in.matrix[0][1], vid_in.matrix[0][2],
+            vid_in.matrix[1][0], vid_in.matrix[1][1], vid_in.matrix[1][2],
+            vid_in.matrix[2][0], vid_in.matrix[2][1], vid_in.matrix[2][2]);
+    }
+#endif
+
+    vid_in.p_src_y = py;
+    vid_in.p_src_v = 0;
+    vid_in.p_src_y_phy = py_phy;
+    vid_in.p_src_v_phy = 0;
+    if (width != 0 && height != 0) {
+        vid_in.p_src_u = py + width*height;
+        vid_in.p_src_u_phy = py_phy + width*height;
+    } else {
+        vid_in.p_src_u = py + mVideoWidth*mVideoHeight;
+        vid_in.p_src_u_phy = py_phy + mVideoWidth*mVideoHeight;
+    }
+    vid_in.org_img_width = (int32_t)width;
+    vid_in.org_img_height = (int32_t)height;
+    vid_in.crop_x = (int32_t)x;
+    vid_in.crop_y = (int32_t)y;
+
+    slot->mIn = vid_in;
+    return true;
+}
+
 void SPRDMPEG4Encoder::onQueueFilled(OMX_U32 portIndex) {
     if (mSignalledError || mSawInputEOS) {
         return;
@@ -1142,9 +1413,10 @@ void SPRDMPEG4Encoder::onQueueFilled(OMX_U32 portIndex) {
             return;
         }
     }
-    List<BufferInfo *> &inQueue = getPortQueue(0);
-    List<BufferInfo *> &outQueue = getPortQueue(1);
-    ALOGI("%s,%d,in queue size %d,out queue size %d",__FUNCTION__,__LINE__,inQueue.size(),outQueue.size());
+    PortQueue &inQueue = getPortQueue(0);
+    PortQueue &outQueue = getPortQueue(1);
+    mInputRing->open();
+    SPRD_FRAME_LOGI("%s,%d,in queue size %d,out queue size %d",__FUNCTION__,__LINE__,inQueue.size(),outQueue.size());
     while (!mSawInputEOS && !inQueue.empty() && !outQueue.empty()) {
         BufferInfo *inInfo = *inQueue.begin();
         OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
@@ -1173,7 +1445,7 @@ void SPRDMPEG4Encoder::onQueueFilled(OMX_U32 portIndex) {
 
             if(mDumpStrmEnabled){
                 if (mFile_bs != NULL) {
-                    fwrite(encOut.pOutBuf, 1, encOut.strmSize, mFile_bs);
+                    mFile_bs->write(encOut.pOutBuf, encOut.strmSize, SprdDumpWriter::kFlagCodecConfig);
                 }
             }
 
@@ -1203,292 +1475,24 @@ void SPRDMPEG4Encoder::onQueueFilled(OMX_U32 portIndex) {
         }
 
         if (inHeader->nFilledLen > 0) {
-            const void *inData = inHeader->pBuffer + inHeader->nOffset;
-            uint8_t *inputData = (uint8_t *) inData;
-            CHECK(inputData != NULL);
-
-
-            MMEncIn vid_in;
-            MMEncOut vid_out;
-            memset(&vid_in, 0, sizeof(vid_in));
-            memset(&vid_out, 0, sizeof(vid_out));
-            uint8_t* py = NULL;
-            uint8_t* py_phy = NULL;
-            uint32_t width = 0;
-            uint32_t height = 0;
-            uint32_t x = 0;
-            uint32_t y = 0;
-            bool needUnmap = false;
-            int bufFd = -1;
-            unsigned long iova = 0;
-            size_t iovaLen = 0;
-
-            if (mVideoColorFormat == OMX_COLOR_FormatYUV420SemiPlanar) {
-                vid_in.yuv_format = MMENC_YUV420SP_NV12;
-            } else {
-                vid_in.yuv_format = MMENC_YUV420SP_NV21;
+            int32_t slotIndex = mInputRing->acquire(inHeader);
+            if (slotIndex < 0) {
+                return;
             }
 
-            if (mStoreMetaData) {
-                unsigned int *mataData = (unsigned int *)inputData;
-                unsigned int type = *mataData++;
-                if (type == kMetadataBufferTypeCameraSource) {
-                    py_phy = (uint8_t*)(*(unsigned long *)mataData);
-                    mataData += sizeof(unsigned long)/sizeof(unsigned int);
-                    py = (uint8_t*)(*(unsigned long *)mataData);
-                    mataData += sizeof(unsigned long)/sizeof(unsigned int);
-                    width = (uint32_t)(*((uint32_t *) mataData++));
-                    height = (uint32_t)(*((uint32_t *) mataData++));
-                    x = (uint32_t)(*((uint32_t *) mataData++));
-                    y = (uint32_t)(*((uint32_t *) mataData++));
-                    int fd = (int32)(*((int32*) mataData));
-                    unsigned long py_addr=0;
-                    size_t buf_size=0;
-                    int ret = 0;
-                    if (mIOMMUEnabled) {
-                        ret = (*mMP4EncGetIOVA)(mHandle, fd, &py_addr, &buf_size);
-                    } else {
-                        ret = MemIon::Get_phy_addr_from_ion(fd, &py_addr, &buf_size);
-                    }
-                    if(ret) {
-                        ALOGE("Failed to Get_iova or Get_phy_addr_from_ion %d", ret);
-                        return;
-                    }
-                    if (mIOMMUEnabled) {
-                        needUnmap = true;
-                        bufFd = fd;
-                        iova = py_addr;
-                        iovaLen = buf_size;
-                    }
-                    py_phy = (uint8_t*)py_addr;
-                } else if (type == kMetadataBufferTypeGrallocSource) {
-                    buffer_handle_t buf = *((buffer_handle_t *)(inputData + sizeof(void *)));
-
-                    ALOGI("format:0x%x, usage:0x%x", ADP_FORMAT(buf), ADP_USAGE(buf));
-
-                    if (mPbuf_yuv_v == NULL) {
-                        size_t yuv_size;
-                        if ((ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_RGBA_8888) && mSupportRGBEnc) {
-                            yuv_size = ((mVideoWidth+15)&(~15)) * ((mVideoHeight+15)&(~15)) * 4;
-                            vid_in.yuv_format = MMENC_RGBA32;
-                        } else {
-                            yuv_size = mVideoWidth * mVideoHeight *3/2;
-                        }
-
-                        if (mIOMMUEnabled) {
-                            mYUVInPmemHeap = new MemIon("/dev/ion", yuv_size,mCacheType, mCacheMask | ION_HEAP_ID_MASK_SYSTEM);
-                        } else {
-                            mYUVInPmemHeap = new MemIon("/dev/ion", yuv_size,mCacheType, mCacheMask | ION_HEAP_ID_MASK_MM);
-                        }
-
-                        int fd = mYUVInPmemHeap->getHeapID();
-                        if (fd < 0) {
-                            ALOGE("Failed to alloc yuv buffer");
-                            return;
-                        }
-                        int ret;
-                        unsigned long phy_addr;
-                        size_t buffer_size;
-
-                        if (mIOMMUEnabled) {
-                            ret = (*mMP4EncGetIOVA)(mHandle, fd, &phy_addr, &buffer_size);
-                        } else {
-                            ret = mYUVInPmemHeap->get_phy_addr_from_ion(&phy_addr, &buffer_size);
-                        }
-                        if (ret) {
-                            ALOGE("Failed to get_phy_addr_from_ion %d", ret);
-                            return;
-                        }
-                        mPbuf_yuv_v =(uint8_t *) mYUVInPmemHeap->getBase();
-                        mPbuf_yuv_p = phy_addr;
-                        mPbuf_yuv_size = buffer_size;
-                    }
-
-
-                    py = mPbuf_yuv_v;
-                    py_phy = (uint8_t *)mPbuf_yuv_p;
-
-                    GraphicBufferMapper &mapper = GraphicBufferMapper::get();
-                    Rect bounds(mVideoWidth, mVideoHeight);
-
-                    void* vaddr = NULL;
-                    struct android_ycbcr ycbcr;
-                    ycbcr.chroma_step = 0;
-                    if (ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_YCBCR_420_888){
-                        if (mapper.lockYCbCr(buf, GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_NEVER, bounds, &ycbcr)) {
-                            ALOGE("%s, line:%d, mapper.lockYCbCr failed", __FUNCTION__, __LINE__);
-                            return;
-                        }
-                        vaddr = malloc(mVideoWidth * mVideoHeight * 3 / 2);
-                        SprdSimpleOMXComponent::ConvertFlexYUVToPlanar((uint8_t*)vaddr, mVideoWidth, mVideoHeight, &ycbcr, mVideoWidth, mVideoHeight);
-                    } else {
-                        if (mapper.lock(buf, GRALLOC_USAGE_SW_READ_OFTEN|GRALLOC_USAGE_SW_WRITE_NEVER, bounds, &vaddr)) {
-                            return;
-                        }
-                    }
-
-                    if (mVideoColorFormat == OMX_COLOR_FormatYUV420Planar) {
-                        ConvertYUV420PlanarToYVU420SemiPlanar((uint8_t*)vaddr, py, mVideoWidth, mVideoHeight,
-                                                             mVideoWidth, mVideoHeight);
-                    } else if (mVideoColorFormat == OMX_COLOR_FormatAndroidOpaque) {
-                        if (ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_YCbCr_420_SP || ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_YCBCR_420_888)
-                            vid_in.yuv_format = MMENC_YUV420SP_NV12;
-                        else if ((ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_RGBA_8888) && mSupportRGBEnc)
-                            vid_in.yuv_format = MMENC_RGBA32;
-                        else
-                            vid_in.yuv_format = MMENC_YUV420SP_NV21;
-
-                        if(ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_YCrCb_420_SP ||
-                             ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_YCbCr_420_SP ||
-                             ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_IMPLEMENTATION_DEFINED ||
-                             ((ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_RGBA_8888) && mSupportRGBEnc)) {
-                            if (ADP_USAGE(buf) & GRALLOC_USAGE_HW_VIDEO_ENCODER) {
-                                unsigned long py_addr = 0;
-                                size_t buf_size = 0;
-                                int fd = ADP_BUFFD(buf);
-                                int ret = 0;
-
-                                if (mIOMMUEnabled) {
-                                    ret = (*mMP4EncGetIOVA)(mHandle, fd, &py_addr, &buf_size);
-                                } else {
-                                    ret = MemIon::Get_phy_addr_from_ion(fd, &py_addr, &buf_size);
-                                }
-                                if (ret) {
-                                    ALOGE("Failed to Get_iova or Get_phy_addr_from_ion %d", ret);
-                                    return;
-                                }
-                                if (mIOMMUEnabled) {
-                                    needUnmap = true;
-                                    bufFd = fd;
-                                    iova = py_addr;
-                                    iovaLen = buf_size;
-                                }
-
-                                py = (uint8_t*)vaddr;
-                                py_phy = (uint8_t*)py_addr;
-                            } else {
-                                memcpy(py, vaddr, mVideoWidth * mVideoHeight * 3/2);
-                            }
-                        } else if (ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_YCbCr_420_P || ycbcr.chroma_step == 1) {
-                            ConvertYUV420PlanarToYVU420SemiPlanar((uint8_t*)vaddr, py, mVideoWidth, mVideoHeight,mVideoWidth, mVideoHeight);
-                            free (vaddr);
-                        } else if (ADP_FORMAT(buf) == HAL_PIXEL_FORMAT_YCBCR_420_888 && ycbcr.chroma_step == 2) {
-                            memcpy(py, vaddr, mVideoWidth * mVideoHeight * 3/2);
-                            free (vaddr);
-                        } else {
-                            ConvertARGB888ToYVU420SemiPlanar((uint8_t*)vaddr, py, mVideoWidth, mVideoHeight, mVideoWidth, mVideoHeight);
-                        }
-                    } else {
-                        if (ADP_USAGE(buf) & GRALLOC_USAGE_HW_VIDEO_ENCODER) {
-                            unsigned long ion_addr = 0;
-                            size_t ion_size = 0;
-                            int fd = ADP_BUFFD(buf);
-
-                            if (mIOMMUEnabled) {
-                                if ((*mMP4EncGetIOVA)(mHandle, fd, &ion_addr, &ion_size)) {
-                                    ALOGE("%s, %d, mMP4EncGetIOVA error", __FUNCTION__, __LINE__);
-                                    return;
-                                }
-                                needUnmap = true;
-                                bufFd = fd;
-                                iova = ion_addr;
-                                iovaLen = ion_size;
-                            } else {
-                                if (0 != MemIon::Get_phy_addr_from_ion(fd, &ion_addr, &ion_size)) {
-                                    ALOGE("%s, %d, Get_phy_addr_from_ion error", __FUNCTION__, __LINE__);
-                                    return;
-                                }
-                            }
-
-                            py = (uint8_t*)vaddr;
-                            py_phy = (uint8_t*)ion_addr;
-                        } else {
-                            memcpy(py, vaddr, mVideoWidth * mVideoHeight * 3/2);
-                        }
-                    }
-
-                    if (mapper.unlock(buf)) {
-                        return;
-                    }
-                } else {
-                    ALOGE("Error MetadataBufferType %d", type);
-                    return;
+            // Have the next inputs prepared while the engine encodes this one.
+            PortQueue::iterator next = inQueue.begin();
+            for (++next; next != inQueue.end() && (*next)->mHeader->nFilledLen > 0; ++next) {
+                if (!mInputRing->prefetch((*next)->mHeader)) {
+                    break;
                 }
-            } else {
-                if (mPbuf_yuv_v == NULL) {
-                    size_t yuv_size;
-                    if (mVideoColorFormat == OMX_COLOR_FormatAndroidOpaque && mSupportRGBEnc)
-                        yuv_size = ((mVideoWidth+15)&(~15)) * ((mVideoHeight+15)&(~15)) * 4;
-                    else
-                        yuv_size = mVideoWidth * mVideoHeight * 3/2;
-                    if (mIOMMUEnabled) {
-                        mYUVInPmemHeap = new MemIon("/dev/ion", yuv_size,mCacheType, mCacheMask | ION_HEAP_ID_MASK_SYSTEM);
-                    } else {
-                        mYUVInPmemHeap = new MemIon("/dev/ion", yuv_size, mCacheType, mCacheMask | ION_HEAP_ID_MASK_MM);
-                    }
-
-                    int fd = mYUVInPmemHeap->getHeapID();
-                    if (fd < 0) {
-                        ALOGE("Failed to alloc yuv buffer");
-                        return;
-                    }
-                    int ret;
-                    unsigned long phy_addr;
-                    size_t buffer_size;
-
-                    if (mIOMMUEnabled) {
-                        ret = (*mMP4EncGetIOVA)(mHandle, fd, &phy_addr, &buffer_size);
-                    } else {
-                        ret = mYUVInPmemHeap->get_phy_addr_from_ion(&phy_addr, &buffer_size);
-                    }
-                    if (ret) {
-                        ALOGE("Failed to get_phy_addr_from_ion %d", ret);
-                        return;
-                    }
-                    mPbuf_yuv_v =(uint8_t *) mYUVInPmemHeap->getBase();
-                    mPbuf_yuv_p = phy_addr;
-                    mPbuf_yuv_size = buffer_size;
-                }
-
-
-                py = mPbuf_yuv_v;
-                py_phy = (uint8_t*)mPbuf_yuv_p;
-
-                if (mVideoColorFormat == OMX_COLOR_FormatYUV420Planar) {
-                    ConvertYUV420PlanarToYVU420SemiPlanar(inputData, py, mVideoWidth, mVideoHeight,
-                                                         mVideoWidth, mVideoHeight);
-                } else if (mVideoColorFormat == OMX_COLOR_FormatAndroidOpaque) {
-                    if (mSupportRGBEnc) {
-                        memcpy(py, inputData, ((mVideoWidth+15)&(~15)) * ((mVideoHeight+15)&(~15)) * 4);
-                        vid_in.yuv_format = MMENC_RGBA32;
-                    } else {
-                        ConvertARGB888ToYVU420SemiPlanar(inputData, py, mVideoWidth, mVideoHeight, mVideoWidth, mVideoHeight);
-                    }
-                } else {
-                    memcpy(py, inputData, mVideoWidth * mVideoHeight * 3/2);
-                }
-            }
-#ifdef CONFIG_SPRD_RECORD_EIS
-            if (mEISMode) {
-                char *parameter = (char *)py+mVideoWidth * mVideoHeight * 3/2;
-                double *warp = (double *)parameter;
-                if (*warp++ == 16171225) {
-                    for (int i=0;i<3;i++) {
-                        for (int j=0;j<3;j++) {
-                            vid_in.matrix[i][j]=*warp++;
-                        }
-                    }
-                } else {
-                    vid_in.matrix[0][0] = vid_in.matrix[1][1] = vid_in.matrix[2][2] = 1.0;
-                    vid_in.matrix[0][1] = vid_in.matrix[0][2] = vid_in.matrix[1][0] = 0.0;
-                    vid_in.matrix[1][2] = vid_in.matrix[2][0] = vid_in.matrix[2][1] = 0.0;
-                }
-                ALOGV("EISLib2record:%f %f %f %f %f %f %f %f %f",
-                    vid_in.matrix[0][0], vid_in.matrix[0][1], vid_in.matrix[0][2],
-                    vid_in.matrix[1][0], vid_in.matrix[1][1], vid_in.matrix[1][2],
-                    vid_in.matrix[2][0], vid_in.matrix[2][1], vid_in.matrix[2][2]);
             }
-#endif
+
+            MMEncIn vid_in = mInputSlots[slotIndex].mIn;
+            MMEncOut vid_out;
+            memset(&vid_out, 0, sizeof(MMEncOut));
+            uint8_t *py = vid_in.p_src_y;
+            uint8_t *py_phy = vid_in.p_src_y_phy;
 
             vid_in.time_stamp = (inHeader->nTimeStamp + 500) / 1000;  // in ms;
             vid_in.channel_quality = 1;
@@ -1499,56 +1503,54 @@ void SPRDMPEG4Encoder::onQueueFilled(OMX_U32 portIndex) {
                 ALOGI("Request an IDR frame");
             }
 
-            vid_in.p_src_y = py;
-            vid_in.p_src_v = 0;
-            vid_in.p_src_y_phy = py_phy;
-            vid_in.p_src_v_phy = 0;
-            if (width != 0 && height != 0) {
-                vid_in.p_src_u = py + width*height;
-                vid_in.p_src_u_phy = py_phy + width*height;
-            } else {
-                vid_in.p_src_u = py + mVideoWidth*mVideoHeight;
-                vid_in.p_src_u_phy = py_phy + mVideoWidth*mVideoHeight;
-            }
-            vid_in.org_img_width = (int32_t)width;
-            vid_in.org_img_height = (int32_t)height;
-            vid_in.crop_x = (int32_t)x;
-            vid_in.crop_y = (int32_t)y;
             if(mDumpYUVEnabled){
                 if (mFile_yuv != NULL) {
-                    fwrite(py, 1, mVideoWidth * mVideoHeight * 3/2, mFile_yuv);
+                    mFile_yuv->write(py, mVideoWidth * mVideoHeight * 3/2);
                 }
             }
             //mPmem_stream->flush_ion_buffer((void*)mPbuf_stream_v, (void*)mPbuf_stream_p, mPbuf_stream_size);
             mPmem_stream->invalid_ion_buffer();
 
-            int64_t start_encode = systemTime();
-            int ret = (*mMP4EncStrmEncode)(mHandle, &vid_in, &vid_out);
-            int64_t end_encode = systemTime();
-            ALOGI("%s,%d,MP4EncStrmEncode[%lld] %dms, in {%p-%p, %dx%d, %d}, out {%p-%d, %d}, wh{%d, %d}, xy{%d, %d}",__FUNCTION__,__LINE__,
-                  mNumInputFrames, (unsigned int)((end_encode-start_encode) / 1000000L), py, py_phy,
-                  mVideoWidth, mVideoHeight, vid_in.yuv_format, vid_out.pOutBuf, vid_out.strmSize, vid_out.vopType, width, height, x, y);
-
-            if (needUnmap) {
-                ALOGV("Free_iova, fd: %d, iova: 0x%lx, size: %zd", bufFd, iova, iovaLen);
-                (*mMP4EncFreeIOVA)(mHandle, iova, iovaLen);
+            int ret;
+            {
+                HardwareSection section(this);
+                Mutex::Autolock engineLock(mEngineLock);
+                ret = (*mMP4EncStrmEncode)(mHandle, &vid_in, &vid_out);
             }
+            mInputRing->release(slotIndex);
+            SPRD_FRAME_LOGI("%s,%d,MP4EncStrmEncode[%lld] %dms, in {%p-%p, %dx%d, %d}, out {%p-%d, %d}, wh{%d, %d}, xy{%d, %d}",__FUNCTION__,__LINE__,
+                  mNumInputFrames, (unsigned int)(mMetrics.lastUs(SprdCodecMetrics::kHistogramEngineTime) / 1000), py, py_phy,
+                  mVideoWidth, mVideoHeight, vid_in.yuv_format, vid_out.pOutBuf, vid_out.strmSize, vid_out.vopType,
+                  vid_in.org_img_width, vid_in.org_img_height, vid_in.crop_x, vid_in.crop_y);
 
             if ((vid_out.strmSize < 0) || (ret != MMENC_OK)) {
                 ALOGE("Failed to encode frame %lld, ret=%d", mNumInputFrames, ret);
+                mMetrics.count(SprdCodecMetrics::kCounterErrors);
                 mSignalledError = true;
                 notify(OMX_EventError, OMX_ErrorUndefined, 0, 0);
             }
 
             if(mDumpStrmEnabled){
                 if (mFile_bs != NULL) {
-                    fwrite(vid_out.pOutBuf, 1, vid_out.strmSize, mFile_bs);
+                    mFile_bs->write(vid_out.pOutBuf, vid_out.strmSize);
                 }
             }
 
             if (vid_out.strmSize > 0) {
+                outPtr = mOutputPacker.frameTarget(outHeader, vid_out.strmSize);
+            }
+
+            if (vid_out.strmSize > 0 && outPtr == NULL) {
+                ALOGE("Frame %lld of %d bytes does not fit an output buffer of %u bytes",
+                      mNumInputFrames, vid_out.strmSize, outHeader->nAllocLen);
+                mMetrics.count(SprdCodecMetrics::kCounterErrors);
+                // The frames after it refer to it.
+                mKeyFrameRequested = true;
+                dataLength = 0;
+            } else if (vid_out.strmSize > 0) {
                 dataLength = vid_out.strmSize;
-                memcpy(outPtr, vid_out.pOutBuf, dataLength);
+                SprdStripePool::getInstance()->copy(outPtr, vid_out.pOutBuf, dataLength);
+                mMetrics.count(SprdCodecMetrics::kCounterCopyBytes, dataLength);
 
                 if (vid_out.vopType == 0) {  // I VOP
                     mKeyFrameRequested = false;
@@ -1583,7 +1585,7 @@ void SPRDMPEG4Encoder::onQueueFilled(OMX_U32 portIndex) {
         mInputBufferInfoVec.erase(mInputBufferInfoVec.begin());
         outInfo->mOwnedByUs = false;
         notifyFillBufferDone(outHeader);
-        ALOGI("%s,%d,in queue size %d,out queue size %d",__FUNCTION__,__LINE__,inQueue.size(),outQueue.size());
+        SPRD_FRAME_LOGI("%s,%d,in queue size %d,out queue size %d",__FUNCTION__,__LINE__,inQueue.size(),outQueue.size());
 
     }
 }
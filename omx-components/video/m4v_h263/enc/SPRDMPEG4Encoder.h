@@ -18,6 +18,9 @@
 #define SPRD_MPEG4_ENCODER_H_
 
 #include "SprdSimpleOMXComponent.h"
+#include "SprdDumpWriter.h"
+#include "SprdEncoderInputRing.h"
+#include "SprdIovaCache.h"
 #include "m4v_h263_enc_api.h"
 
 #define MP4ENC_INTERNAL_BUFFER_SIZE  (0x200000)
@@ -50,6 +53,11 @@ struct SPRDMPEG4Encoder : public SprdSimpleOMXComponent {
 
 protected:
     virtual ~SPRDMPEG4Encoder();
+
+    virtual void onReset();
+    virtual void onPortEnableCompleted(OMX_U32 portIndex, bool enabled);
+    virtual void onPortFlushPrepare(OMX_U32 portIndex);
+    virtual void onInputBufferArrived(OMX_BUFFERHEADERTYPE *header);
     OMX_ERRORTYPE mInitCheck;
 
 private:
@@ -80,6 +88,7 @@ private:
 
     OMX_BOOL mStoreMetaData;
     bool     mIOMMUEnabled;
+    SprdIovaCache *mIovaCache;
     int mIOMMUID;
     bool     mDumpYUVEnabled;
     bool     mDumpStrmEnabled;
@@ -92,10 +101,23 @@ private:
 
     uint8_t *mPbuf_inter;
 
-    sp<MemIon> mYUVInPmemHeap;
-    uint8_t *mPbuf_yuv_v;
-    unsigned long mPbuf_yuv_p;
-    size_t mPbuf_yuv_size;
+    // Staging buffer of the input ring and the frame prepared in it.
+    struct InputSlot {
+        InputSlot() : mVirt(NULL), mPhy(0), mSize(0) {}
+
+        sp<MemIon> mHeap;
+        uint8_t *mVirt;
+        unsigned long mPhy;
+        size_t mSize;
+        MMEncIn mIn;   // source address, format and crop
+    };
+
+    SprdEncoderInputRing *mInputRing;
+    InputSlot mInputSlots[SprdEncoderInputRing::kMaxSlots];
+
+    // The input ring thread maps and unmaps through the engine while the
+    // looper encodes; the engine takes neither call during an encode.
+    Mutex mEngineLock;
 
     sp<MemIon> mPmem_stream;
     uint8_t *mPbuf_stream_v;
@@ -135,8 +157,8 @@ private:
     MMEncVideoInfo mEncInfo;
     MMEncCapability mCapability;
 
-    FILE* mFile_yuv;
-    FILE* mFile_bs;
+    SprdDumpWriter *mFile_yuv;
+    SprdDumpWriter *mFile_bs;
 
     void initPorts();
     OMX_ERRORTYPE initEncParams();
@@ -144,6 +166,12 @@ private:
     OMX_ERRORTYPE releaseEncoder();
     bool openEncoder(const char* libName);
 
+    static int IovaCacheMapWrapper(void *cookie, int fd, unsigned long *iova, size_t *size);
+    static void IovaCacheUnmapWrapper(void *cookie, unsigned long iova, size_t size);
+
+    bool prepareInput(OMX_BUFFERHEADERTYPE *inHeader, InputSlot *slot);
+    static bool PrepareInputWrapper(void *cookie, OMX_BUFFERHEADERTYPE *header, int32_t slot);
+
     DISALLOW_EVIL_CONSTRUCTORS(SPRDMPEG4Encoder);
 };
 
@@ -16,6 +16,8 @@ LOCAL_CFLAGS := -DOSCL_EXPORT_REF= -DOSCL_IMPORT_REF=
 
 LOCAL_MULTILIB := 32
 
+LOCAL_STATIC_LIBRARIES := libsprd_colorconvert
+
 LOCAL_SHARED_LIBRARIES := \
         libstagefright_omx libstagefright_omx_utils libstagefright_foundation libutils libdl liblog libstagefrighthw
 
@@ -24,3 +26,32 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_PROPRIETARY_MODULE := true
 
 include $(BUILD_SHARED_LIBRARY)
+
+# Host build. libjpeg is loaded at run time, as on the device.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        SoftMJPG.cpp
+
+LOCAL_C_INCLUDES := \
+        frameworks/av/media/libstagefright/include \
+        external/libjpeg-turbo \
+        $(LOCAL_PATH)/../../../../libstagefrighthw/include/ \
+        $(LOCAL_PATH)/../../../../libstagefrighthw/include/openmax
+
+LOCAL_CFLAGS := -DOSCL_EXPORT_REF= -DOSCL_IMPORT_REF=
+
+LOCAL_STATIC_LIBRARIES := libsprd_colorconvert
+
+LOCAL_SHARED_LIBRARIES := \
+        libstagefright_foundation libutils liblog libcutils libstagefrighthw
+
+LOCAL_REQUIRED_MODULES := libjpeg
+
+LOCAL_LDLIBS := -ldl -lpthread
+
+LOCAL_MODULE := libstagefright_soft_mjpgdec
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_SHARED_LIBRARY)
@@ -19,15 +19,20 @@
 #include <utils/Log.h>
 
 #include "SoftMJPG.h"
+#include "SprdColorConvert.h"
 
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
+#include <cutils/properties.h>
 
 #include <dlfcn.h>
+#include <unistd.h>
 
 namespace android {
 
+// Smaller frames decode quickly enough in one piece.
+static const int32_t kMinSplitPixels = 1280 * 720;
 
 template<class T>
 static void InitOMXParams(T *params) {
@@ -49,10 +54,14 @@ SoftMJPG::SoftMJPG(
       mHeight(144),
       mCropWidth(mWidth),
       mCropHeight(mHeight),
+      mScaleDenom(1),
       mSignalledError(false),
-      mFramesConfigured(false),
       mNumSamplesOutput(0),
       mOutputPortSettingsChange(NONE),
+      mFrameHead(0),
+      mFrameCount(0),
+      mNumWorkers(0),
+      mWorkersExit(false),
       mLibHandle(NULL),
       mjpeg_std_error(NULL),
       mjpeg_create_decompress(NULL),
@@ -60,17 +69,26 @@ SoftMJPG::SoftMJPG(
       mjpeg_read_header(NULL),
       mjpeg_start_decompress(NULL),
       mjpeg_read_scanlines(NULL),
+      mjpeg_read_raw_data(NULL),
       mjpeg_finish_decompress(NULL),
-      mjpeg_destroy_decompress(NULL) {
+      mjpeg_destroy_decompress(NULL),
+      mjpeg_abort_decompress(NULL),
+      mjpeg_alloc_huff_table(NULL),
+      mjpeg_alloc_quant_table(NULL),
+      mjpeg_calc_output_dimensions(NULL) {
     CHECK(!strcmp(name, "OMX.google.mjpg.decoder"));
 
     CHECK_EQ(openDecoder("libjpeg.so"), true);
 
     initPorts();
     CHECK_EQ(initDecoder(), (status_t)OK);
+    startWorkers();
 }
 
 SoftMJPG::~SoftMJPG() {
+    stopWorkers();
+    releaseDecoder();
+
     if (mLibHandle) {
         dlclose(mLibHandle);
         mLibHandle = NULL;
@@ -140,12 +158,374 @@ void SoftMJPG::initPorts() {
 }
 
 status_t SoftMJPG::initDecoder() {
-    memset(&cinfo, 0, sizeof(cinfo));
-    memset(&jerr, 0, sizeof(jerr));
+    memset(&mDecompressor, 0, sizeof(mDecompressor));
+    memset(mWorkerDecompressors, 0, sizeof(mWorkerDecompressors));
+    memset(mBandDecompressors, 0, sizeof(mBandDecompressors));
+
+    return createDecompressor(&mDecompressor);
+}
+
+void SoftMJPG::releaseDecoder() {
+    destroyDecompressor(&mDecompressor);
+    for (int32_t i = 0; i < kMaxWorkers; ++i) {
+        destroyDecompressor(&mWorkerDecompressors[i]);
+    }
+    for (int32_t i = 0; i < kMaxBands; ++i) {
+        destroyDecompressor(&mBandDecompressors[i]);
+    }
+}
+
+status_t SoftMJPG::createDecompressor(Decompressor *d) {
+    d->mOwner = this;
+    d->cinfo.err = mjpeg_std_error(&d->jerr.pub);
+    d->jerr.pub.error_exit = notify_jpeg_error;
+    if (setjmp(d->jerr.setjmp_buffer)) {
+        return UNKNOWN_ERROR;
+    }
+
+    mjpeg_create_decompress(&d->cinfo, JPEG_LIB_VERSION, sizeof(d->cinfo));
+    d->mCreated = true;
+
+    installDefaultHuffmanTables(d);
 
     return OK;
 }
 
+void SoftMJPG::destroyDecompressor(Decompressor *d) {
+    if (d->mCreated) {
+        mjpeg_destroy_decompress(&d->cinfo);
+        d->mCreated = false;
+    }
+
+    free(d->mRows);
+    d->mRows = NULL;
+    free(d->mRowBuffer);
+    d->mRowBuffer = NULL;
+    d->mRowBufferSize = 0;
+    d->mMaxRows = 0;
+    free(d->mStream);
+    d->mStream = NULL;
+    d->mStreamCapacity = 0;
+}
+
+// Motion JPEG from UVC cameras and AVI files usually leaves out the DHT
+// segment and expects the example tables of ITU-T T.81 Annex K.3. They
+// are loaded once; a stream that does carry tables replaces them, and the
+// replacement stays in effect for the frames after it.
+void SoftMJPG::installDefaultHuffmanTables(Decompressor *d) {
+    static const UINT8 kDcLuminanceBits[17] =
+        { 0, 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+    static const UINT8 kDcChrominanceBits[17] =
+        { 0, 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 };
+    static const UINT8 kDcValues[12] =
+        { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+    static const UINT8 kAcLuminanceBits[17] =
+        { 0, 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d };
+    static const UINT8 kAcLuminanceValues[162] = {
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12,
+        0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+        0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16,
+        0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39,
+        0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+        0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+        0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+        0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79,
+        0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98,
+        0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+        0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+        0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+        0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4,
+        0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+        0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea,
+        0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa
+    };
+
+    static const UINT8 kAcChrominanceBits[17] =
+        { 0, 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 };
+    static const UINT8 kAcChrominanceValues[162] = {
+        0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21,
+        0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+        0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+        0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+        0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34,
+        0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+        0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38,
+        0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+        0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+        0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+        0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78,
+        0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+        0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96,
+        0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+        0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+        0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+        0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2,
+        0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+        0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9,
+        0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa
+    };
+
+    static const struct {
+        bool dc;
+        int slot;
+        const UINT8 *bits;
+        const UINT8 *values;
+        size_t numValues;
+    } kTables[] = {
+        { true,  0, kDcLuminanceBits,   kDcValues,            sizeof(kDcValues) },
+        { true,  1, kDcChrominanceBits, kDcValues,            sizeof(kDcValues) },
+        { false, 0, kAcLuminanceBits,   kAcLuminanceValues,   sizeof(kAcLuminanceValues) },
+        { false, 1, kAcChrominanceBits, kAcChrominanceValues, sizeof(kAcChrominanceValues) },
+    };
+
+    if (mjpeg_alloc_huff_table == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < sizeof(kTables) / sizeof(kTables[0]); ++i) {
+        JHUFF_TBL **slot = kTables[i].dc
+                ? &d->cinfo.dc_huff_tbl_ptrs[kTables[i].slot]
+                : &d->cinfo.ac_huff_tbl_ptrs[kTables[i].slot];
+        if (*slot == NULL) {
+            *slot = mjpeg_alloc_huff_table((j_common_ptr)&d->cinfo);
+        }
+        memcpy((*slot)->bits, kTables[i].bits, sizeof((*slot)->bits));
+        memset((*slot)->huffval, 0, sizeof((*slot)->huffval));
+        memcpy((*slot)->huffval, kTables[i].values, kTables[i].numValues);
+        (*slot)->sent_table = FALSE;
+    }
+}
+
+bool SoftMJPG::allocRows(Decompressor *d, size_t rows, size_t rowBytes) {
+    if (rows > d->mMaxRows) {
+        JSAMPROW *newRows = (JSAMPROW *)realloc(d->mRows, rows * sizeof(JSAMPROW));
+        if (newRows == NULL) {
+            return false;
+        }
+        d->mRows = newRows;
+        d->mMaxRows = rows;
+    }
+    if (rows * rowBytes > d->mRowBufferSize) {
+        free(d->mRowBuffer);
+        d->mRowBuffer = (uint8_t *)malloc(rows * rowBytes);
+        if (d->mRowBuffer == NULL) {
+            d->mRowBufferSize = 0;
+            return false;
+        }
+        d->mRowBufferSize = rows * rowBytes;
+    }
+    for (size_t i = 0; i < rows; ++i) {
+        d->mRows[i] = d->mRowBuffer + i * rowBytes;
+    }
+    return true;
+}
+
+// Frames do not depend on each other, so with more than one core several
+// are decoded at once, each by a worker with its own decompressor.
+// vendor.mjpgdec.threads sets the number of workers; 1 decodes on the
+// component's thread as before.
+void SoftMJPG::startWorkers() {
+    char value[PROPERTY_VALUE_MAX];
+    property_get("vendor.mjpgdec.threads", value, "");
+    int32_t count = value[0] ? atoi(value) : (int32_t)sysconf(_SC_NPROCESSORS_ONLN);
+    if (count > kMaxWorkers) {
+        count = kMaxWorkers;
+    }
+    if (count < 2) {
+        return;
+    }
+
+    // A worker starts from the tables of the frames before its own.
+    if (mjpeg_mem_src == NULL || mjpeg_alloc_huff_table == NULL
+            || mjpeg_alloc_quant_table == NULL) {
+        ALOGW("can't hand tables to decode threads, decoding on one thread");
+        return;
+    }
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    for (int32_t i = 0; i < count; ++i) {
+        Decompressor *d = &mWorkerDecompressors[i];
+        if (createDecompressor(d) != OK
+                || pthread_create(&mWorkers[i], &attr, WorkerWrapper, d) != 0) {
+            ALOGW("unable to start decode thread %d", i);
+            break;
+        }
+        ++mNumWorkers;
+    }
+
+    pthread_attr_destroy(&attr);
+    ALOGI("%d decode threads", mNumWorkers);
+}
+
+void SoftMJPG::stopWorkers() {
+    {
+        Mutex::Autolock autoLock(mFrameLock);
+        mWorkersExit = true;
+        mFrameCondition.broadcast();
+    }
+
+    for (int32_t i = 0; i < mNumWorkers; ++i) {
+        void *dummy;
+        pthread_join(mWorkers[i], &dummy);
+    }
+    mNumWorkers = 0;
+}
+
+// static
+void *SoftMJPG::WorkerWrapper(void *arg) {
+    Decompressor *d = static_cast<Decompressor *>(arg);
+    d->mOwner->workerLoop(d);
+    return NULL;
+}
+
+void SoftMJPG::workerLoop(Decompressor *d) {
+    Mutex::Autolock autoLock(mFrameLock);
+    while (!mWorkersExit) {
+        Frame *frame = NULL;
+        for (size_t i = 0; i < mFrameCount; ++i) {
+            Frame *f = &mFrames[(mFrameHead + i) % kMaxFrames];
+            if (f->mState == Frame::QUEUED) {
+                frame = f;
+                break;
+            }
+        }
+        if (frame == NULL) {
+            mFrameCondition.wait(mFrameLock);
+            continue;
+        }
+
+        // The slot and its buffers are left alone until the frame is DONE.
+        frame->mState = Frame::DECODING;
+        mFrameLock.unlock();
+
+        OMX_BUFFERHEADERTYPE *inHeader = frame->mInInfo->mHeader;
+        const uint8_t *data = inHeader->pBuffer + inHeader->nOffset;
+        uint8_t *yuv = frame->mOutInfo->mHeader->pBuffer;
+        bool ok = readHeader(d, data, inHeader->nFilledLen, &frame->mTables,
+                frame->mScaleDenom);
+        if (ok && frame->mSplit) {
+            ok = decodeSplitFrame(d, data, inHeader->nFilledLen, &frame->mTables,
+                    yuv, frame->mWidth, frame->mHeight);
+        } else if (ok) {
+            ok = decodeFrame(d, yuv, yuv + frame->mWidth * frame->mHeight,
+                    frame->mWidth, frame->mHeight);
+        }
+
+        mFrameLock.lock();
+        frame->mError = !ok;
+        frame->mState = Frame::DONE;
+        mFrameDoneCondition.broadcast();
+
+        signalQueueFilled(kOutputPortIndex);
+    }
+}
+
+// Drops the frames in flight, e.g. before a flush returns their buffers.
+// Frames a worker is decoding are waited for.
+void SoftMJPG::cancelFrames() {
+    Mutex::Autolock autoLock(mFrameLock);
+    for (;;) {
+        bool decoding = false;
+        for (size_t i = 0; i < mFrameCount; ++i) {
+            Frame *frame = &mFrames[(mFrameHead + i) % kMaxFrames];
+            if (frame->mState == Frame::QUEUED) {
+                frame->mState = Frame::DONE;
+            } else if (frame->mState == Frame::DECODING) {
+                decoding = true;
+            }
+        }
+        if (!decoding) {
+            break;
+        }
+        mFrameDoneCondition.wait(mFrameLock);
+    }
+    mFrameHead = 0;
+    mFrameCount = 0;
+}
+
+// Returns the frames at the head of mFrames that are done, so buffers go
+// back in the order they came in even when the workers finish out of
+// order. MJPEG has no reordering, so this is timestamp order as well.
+// False once a frame failed to decode.
+bool SoftMJPG::drainFrames() {
+    mFrameLock.lock();
+    while (mFrameCount > 0 && mFrames[mFrameHead].mState == Frame::DONE) {
+        const Frame *frame = &mFrames[mFrameHead];
+        bool error = frame->mError;
+        BufferInfo *inInfo = frame->mInInfo;
+        BufferInfo *outInfo = frame->mOutInfo;
+        int64_t timeStamp = frame->mTimeStamp;
+
+        mFrameHead = (mFrameHead + 1) % kMaxFrames;
+        --mFrameCount;
+        mFrameLock.unlock();
+
+        if (error) {
+            notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+            mSignalledError = true;
+            return false;
+        }
+        returnFrame(inInfo, outInfo, timeStamp);
+
+        mFrameLock.lock();
+    }
+    mFrameLock.unlock();
+    return true;
+}
+
+// Any output buffer we hold that no frame in flight is decoded into.
+SprdSimpleOMXComponent::BufferInfo *SoftMJPG::findFreeOutputBuffer() {
+    PortQueue &outQueue = getPortQueue(kOutputPortIndex);
+
+    for (PortQueue::iterator it = outQueue.begin(); it != outQueue.end(); ++it) {
+        bool busy = false;
+        for (size_t i = 0; i < mFrameCount && !busy; ++i) {
+            busy = mFrames[(mFrameHead + i) % kMaxFrames].mOutInfo == *it;
+        }
+        if (!busy) {
+            return *it;
+        }
+    }
+    return NULL;
+}
+
+void SoftMJPG::returnFrame(BufferInfo *inInfo, BufferInfo *outInfo, int64_t timeStamp) {
+    PortQueue &inQueue = getPortQueue(0);
+    PortQueue &outQueue = getPortQueue(1);
+
+    OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
+    inHeader->nOffset += inHeader->nFilledLen;
+    inHeader->nFilledLen = 0;
+
+    inInfo->mOwnedByUs = false;
+    inQueue.erase(inInfo);
+    notifyEmptyBufferDone(inHeader);
+
+    ++mInputBufferCount;
+
+    OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+    outHeader->nTimeStamp = timeStamp;
+    outHeader->nOffset = 0;
+    outHeader->nFilledLen = (mWidth * mHeight * 3) / 2;
+    outHeader->nFlags = 0;
+
+    outInfo->mOwnedByUs = false;
+    outQueue.erase(outInfo);
+    notifyFillBufferDone(outHeader);
+
+    ++mNumSamplesOutput;
+}
+
 OMX_ERRORTYPE SoftMJPG::internalGetParameter(
     OMX_INDEXTYPE index, OMX_PTR params) {
     switch (index) {
@@ -178,6 +558,20 @@ OMX_ERRORTYPE SoftMJPG::internalGetParameter(
         return OMX_ErrorNone;
     }
 
+    case OMX_IndexParamDecodeScale:
+    {
+        SprdDecodeScaleParams *scaleParams = (SprdDecodeScaleParams *)params;
+
+        if (scaleParams->nSize < sizeof(SprdDecodeScaleParams)
+                || scaleParams->nPortIndex != kOutputPortIndex) {
+            return OMX_ErrorBadParameter;
+        }
+
+        scaleParams->nScaleDenom = mScaleDenom;
+
+        return OMX_ErrorNone;
+    }
+
     default:
         return SprdSimpleOMXComponent::internalGetParameter(index, params);
     }
@@ -257,6 +651,30 @@ OMX_ERRORTYPE SoftMJPG::internalSetParameter(
         return OMX_ErrorNone;
     }
 
+    case OMX_IndexParamDecodeScale:
+    {
+        const SprdDecodeScaleParams *scaleParams =
+            (const SprdDecodeScaleParams *)params;
+
+        if (scaleParams->nSize < sizeof(SprdDecodeScaleParams)
+                || scaleParams->nPortIndex != kOutputPortIndex) {
+            return OMX_ErrorBadParameter;
+        }
+
+        OMX_U32 denom = scaleParams->nScaleDenom;
+        if (denom != 1 && denom != 2 && denom != 4 && denom != 8) {
+            return OMX_ErrorUnsupportedSetting;
+        }
+        if (denom != 1 && mjpeg_calc_output_dimensions == NULL) {
+            return OMX_ErrorUnsupportedSetting;
+        }
+
+        ALOGI("decode at 1/%u scale", denom);
+        mScaleDenom = denom;
+
+        return OMX_ErrorNone;
+    }
+
     default:
         return SprdSimpleOMXComponent::internalSetParameter(index, params);
     }
@@ -286,24 +704,55 @@ OMX_ERRORTYPE SoftMJPG::getConfig(
     }
 }
 
+OMX_ERRORTYPE SoftMJPG::getExtensionIndex(
+    const char *name, OMX_INDEXTYPE *index) {
+    if (!strcmp(name, SPRD_INDEX_PARAM_DECODE_SCALE)) {
+        *index = (OMX_INDEXTYPE)OMX_IndexParamDecodeScale;
+        return OMX_ErrorNone;
+    }
+
+    return SprdSimpleOMXComponent::getExtensionIndex(name, index);
+}
+
 void SoftMJPG::onQueueFilled(OMX_U32 portIndex) {
-    if (mSignalledError || mOutputPortSettingsChange != NONE) {
+    if (mSignalledError) {
         return;
     }
 
-    List<BufferInfo *> &inQueue = getPortQueue(0);
-    List<BufferInfo *> &outQueue = getPortQueue(1);
+    if (!drainFrames() || mOutputPortSettingsChange != NONE) {
+        return;
+    }
 
-    while (!inQueue.empty() && outQueue.size() == kNumOutputBuffers) {
-        BufferInfo *inInfo = *inQueue.begin();
-        OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
+    PortQueue &inQueue = getPortQueue(0);
+    PortQueue &outQueue = getPortQueue(1);
 
-        PortInfo *port = editPortInfo(1);
+    // Only this thread adds or removes frames, so mFrameCount and the
+    // buffers of the frames in flight can be read without mFrameLock. Their
+    // inputs are the first mFrameCount entries of inQueue.
+    for (;;) {
+        PortQueue::iterator it = inQueue.begin();
+        for (size_t i = 0; i < mFrameCount && it != inQueue.end(); ++i) {
+            ++it;
+        }
+        if (it == inQueue.end()) {
+            break;
+        }
 
-        OMX_BUFFERHEADERTYPE *outHeader =
-            port->mBuffers.editItemAt(mNumSamplesOutput & 1).mHeader;
+        BufferInfo *inInfo = *it;
+        OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
 
         if ((inHeader->nFlags & OMX_BUFFERFLAG_EOS) || (inHeader->nFilledLen == 0)) {
+            // Goes out after the frames before it.
+            if (mFrameCount > 0) {
+                break;
+            }
+
+            BufferInfo *outInfo = findFreeOutputBuffer();
+            if (outInfo == NULL) {
+                break;
+            }
+            OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+
             inQueue.erase(inQueue.begin());
             inInfo->mOwnedByUs = false;
             notifyEmptyBufferDone(inHeader);
@@ -315,14 +764,8 @@ void SoftMJPG::onQueueFilled(OMX_U32 portIndex) {
                 outHeader->nFlags = OMX_BUFFERFLAG_EOS;
             }
 
-            List<BufferInfo *>::iterator it = outQueue.begin();
-            while ((*it)->mHeader != outHeader) {
-                ++it;
-            }
-
-            BufferInfo *outInfo = *it;
             outInfo->mOwnedByUs = false;
-            outQueue.erase(it);
+            outQueue.erase(outInfo);
             outInfo = NULL;
 
             notifyFillBufferDone(outHeader);
@@ -330,110 +773,109 @@ void SoftMJPG::onQueueFilled(OMX_U32 portIndex) {
             return;
         }
 
-        uint8_t *bitstream = inHeader->pBuffer + inHeader->nOffset;
-
-        if (!mFramesConfigured) {
-            PortInfo *port = editPortInfo(1);
-            OMX_BUFFERHEADERTYPE *outHeader = port->mBuffers.editItemAt(1).mHeader;
+        if (mFrameCount == kMaxFrames) {
+            break;
+        }
 
-            mFramesConfigured = true;
+        BufferInfo *outInfo = findFreeOutputBuffer();
+        if (outInfo == NULL) {
+            break;
         }
+        OMX_BUFFERHEADERTYPE *outHeader = outInfo->mHeader;
+
+        uint8_t *bitstream = inHeader->pBuffer + inHeader->nOffset;
 
         // decoder deals in ms, OMX in us.
         uint32_t timestamp = ((inHeader->nOffset == 0)) ? (inHeader->nTimeStamp + 500) / 1000 : 0xFFFFFFFF;
         int32_t bufferSize = inHeader->nFilledLen;
 
-
-        /* allocate and initialize JPEG decompression object */
-        cinfo.err = mjpeg_std_error(&jerr.pub);
-        jerr.pub.error_exit = notify_jpeg_error;
-        if (setjmp(jerr.setjmp_buffer)) {
-            mjpeg_destroy_decompress(&cinfo);
-
+        if (mjpeg_mem_src == NULL) {
             notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
             mSignalledError = true;
             return;
         }
 
-        mjpeg_create_decompress(&cinfo, JPEG_LIB_VERSION, sizeof(cinfo));
-
-        if (mjpeg_mem_src == NULL) {
+        if (!readHeader(&mDecompressor, bitstream, bufferSize, NULL, mScaleDenom)) {
             notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
             mSignalledError = true;
             return;
         }
-        /* specify data source */
-        mjpeg_mem_src(&cinfo, bitstream, bufferSize);
 
-        /* read parameters with jpeg_read_header() */
-        mjpeg_read_header(&cinfo, TRUE);
+        struct jpeg_decompress_struct &cinfo = mDecompressor.cinfo;
 
-        cinfo.dct_method = JDCT_IFAST;
-        cinfo.do_fancy_upsampling = FALSE;
-        cinfo.do_block_smoothing = FALSE;
-        cinfo.dither_mode = JDITHER_NONE;
-        cinfo.two_pass_quantize = FALSE;
+        ALOGI("jpeg %dx%d, output %dx%d", cinfo.image_width, cinfo.image_height,
+                cinfo.output_width, cinfo.output_height);
 
-        ALOGI("jpeg %dx%d", cinfo.image_width, cinfo.image_height);
+        if (((cinfo.output_width+15)&(~15)) != mWidth || ((cinfo.output_height+15)&(~15)) != mHeight) {
+            mjpeg_abort_decompress(&cinfo);
 
-        if (((cinfo.image_width+15)&(~15)) != mWidth || ((cinfo.image_height+15)&(~15)) != mHeight) {
-            mWidth = (cinfo.image_width+15)&(~15);
-            mHeight = (cinfo.image_height+15)&(~15);
+            // The frames before it are decoded at the old size first; the
+            // header is read again once they are out.
+            if (mFrameCount > 0) {
+                break;
+            }
 
-            mCropWidth = (int32_t)cinfo.image_width;
-            mCropHeight = (int32_t)cinfo.image_height;
+            mWidth = (cinfo.output_width+15)&(~15);
+            mHeight = (cinfo.output_height+15)&(~15);
 
-            updatePortDefinitions();
+            mCropWidth = (int32_t)cinfo.output_width;
+            mCropHeight = (int32_t)cinfo.output_height;
 
-            mFramesConfigured = false;
+            updatePortDefinitions();
 
             notify(OMX_EventPortSettingsChanged, 1, 0, NULL);
             mOutputPortSettingsChange = AWAITING_DISABLED;
 
-            mjpeg_destroy_decompress(&cinfo);
-
             return;
         }
 
-        decode_jpeg_frame(outHeader->pBuffer);
-
-        // decoder deals in ms, OMX in us.
-        outHeader->nTimeStamp = timestamp * 1000;
-
-        inHeader->nOffset += bufferSize;
-        inHeader->nFilledLen = 0;
-
-        if (inHeader->nFilledLen == 0) {
-            inInfo->mOwnedByUs = false;
-            inQueue.erase(inQueue.begin());
-            inInfo = NULL;
-            notifyEmptyBufferDone(inHeader);
-            inHeader = NULL;
-        }
-
-        ++mInputBufferCount;
-
-        outHeader->nOffset = 0;
-        outHeader->nFilledLen = (mWidth * mHeight * 3) / 2;
-        outHeader->nFlags = 0;
+        if (mNumWorkers == 0) {
+            JpegTables tables;
+            saveTables(&cinfo, &tables);
+            if (!decodeSplitFrame(&mDecompressor, bitstream, bufferSize, &tables,
+                    outHeader->pBuffer, mWidth, mHeight)) {
+                notify(OMX_EventError, OMX_ErrorUndefined, 0, NULL);
+                mSignalledError = true;
+                return;
+            }
 
-        List<BufferInfo *>::iterator it = outQueue.begin();
-        while ((*it)->mHeader != outHeader) {
-            ++it;
+            // decoder deals in ms, OMX in us.
+            returnFrame(inInfo, outInfo, timestamp * 1000);
+            continue;
         }
 
-        BufferInfo *outInfo = *it;
-        outInfo->mOwnedByUs = false;
-        outQueue.erase(it);
-        outInfo = NULL;
-
-        notifyFillBufferDone(outHeader);
-        outHeader = NULL;
-
-        ++mNumSamplesOutput;
+        Frame *frame = &mFrames[(mFrameHead + mFrameCount) % kMaxFrames];
+        frame->mError = false;
+        frame->mInInfo = inInfo;
+        frame->mOutInfo = outInfo;
+        // decoder deals in ms, OMX in us.
+        frame->mTimeStamp = timestamp * 1000;
+        frame->mWidth = mWidth;
+        frame->mHeight = mHeight;
+        frame->mScaleDenom = cinfo.scale_denom;
+        // Alone in flight, the frame gets the stripe pool to itself.
+        frame->mSplit = mFrameCount == 0;
+        saveTables(&cinfo, &frame->mTables);
+
+        mjpeg_abort_decompress(&cinfo);
+
+        Mutex::Autolock autoLock(mFrameLock);
+        frame->mState = Frame::QUEUED;
+        ++mFrameCount;
+        mFrameCondition.signal();
     }
 }
 
+void SoftMJPG::onPortFlushPrepare(OMX_U32 portIndex) {
+    cancelFrames();
+}
+
+// The workers write into the output buffers as well, so they are stopped
+// before either port gives its buffers back. The inputs of the dropped
+// frames stay queued and are decoded again once the port is back.
+void SoftMJPG::onPortDisablePrepare(OMX_U32 portIndex) {
+    cancelFrames();
+}
 
 void SoftMJPG::onPortEnableCompleted(OMX_U32 portIndex, bool enabled) {
     if (portIndex != 1) {
@@ -490,60 +932,459 @@ void SoftMJPG::notify_jpeg_error(j_common_ptr cinfo) {
     longjmp(myerr->setjmp_buffer, 1);
 }
 
-void SoftMJPG::decode_jpeg_frame(unsigned char * yuv_buffer) {
+// Points d at the next frame and reads its header. tables, when given,
+// are what the stream had defined up to this frame. The output size is
+// known on return, scaled down by scaleDenom.
+bool SoftMJPG::readHeader(Decompressor *d, const uint8_t *data, size_t size,
+        const JpegTables *tables, int32_t scaleDenom) {
+    if (setjmp(d->jerr.setjmp_buffer)) {
+        mjpeg_abort_decompress(&d->cinfo);
+        return false;
+    }
+
+    if (tables != NULL) {
+        restoreTables(d, tables);
+    }
+
+    /* specify data source */
+    mjpeg_mem_src(&d->cinfo, const_cast<unsigned char *>(data), size);
+
+    /* read parameters with jpeg_read_header() */
+    mjpeg_read_header(&d->cinfo, TRUE);
+
+    d->cinfo.dct_method = JDCT_IFAST;
+    d->cinfo.do_fancy_upsampling = FALSE;
+    d->cinfo.do_block_smoothing = FALSE;
+    d->cinfo.dither_mode = JDITHER_NONE;
+    d->cinfo.two_pass_quantize = FALSE;
+
+    d->cinfo.scale_num = 1;
+    d->cinfo.scale_denom = scaleDenom;
+    if (mjpeg_calc_output_dimensions != NULL) {
+        mjpeg_calc_output_dimensions(&d->cinfo);
+    } else {
+        // Only full size is offered without it.
+        d->cinfo.output_width = d->cinfo.image_width;
+        d->cinfo.output_height = d->cinfo.image_height;
+        d->cinfo.min_DCT_scaled_size = DCTSIZE;
+        for (int i = 0; i < d->cinfo.num_components; ++i) {
+            d->cinfo.comp_info[i].DCT_scaled_size = DCTSIZE;
+        }
+    }
+
+    return true;
+}
+
+// static
+void SoftMJPG::saveTables(const jpeg_decompress_struct *cinfo, JpegTables *tables) {
+    for (int i = 0; i < NUM_HUFF_TBLS; ++i) {
+        tables->mHasDc[i] = cinfo->dc_huff_tbl_ptrs[i] != NULL;
+        if (tables->mHasDc[i]) {
+            tables->mDc[i] = *cinfo->dc_huff_tbl_ptrs[i];
+        }
+        tables->mHasAc[i] = cinfo->ac_huff_tbl_ptrs[i] != NULL;
+        if (tables->mHasAc[i]) {
+            tables->mAc[i] = *cinfo->ac_huff_tbl_ptrs[i];
+        }
+    }
+    for (int i = 0; i < NUM_QUANT_TBLS; ++i) {
+        tables->mHasQuant[i] = cinfo->quant_tbl_ptrs[i] != NULL;
+        if (tables->mHasQuant[i]) {
+            tables->mQuant[i] = *cinfo->quant_tbl_ptrs[i];
+        }
+    }
+}
+
+// Table slots are never freed once allocated, so a slot the snapshot does
+// not have can only be one this decompressor has not needed yet either.
+void SoftMJPG::restoreTables(Decompressor *d, const JpegTables *tables) {
+    j_common_ptr common = (j_common_ptr)&d->cinfo;
+
+    for (int i = 0; i < NUM_HUFF_TBLS; ++i) {
+        if (tables->mHasDc[i]) {
+            if (d->cinfo.dc_huff_tbl_ptrs[i] == NULL) {
+                d->cinfo.dc_huff_tbl_ptrs[i] = mjpeg_alloc_huff_table(common);
+            }
+            *d->cinfo.dc_huff_tbl_ptrs[i] = tables->mDc[i];
+        }
+        if (tables->mHasAc[i]) {
+            if (d->cinfo.ac_huff_tbl_ptrs[i] == NULL) {
+                d->cinfo.ac_huff_tbl_ptrs[i] = mjpeg_alloc_huff_table(common);
+            }
+            *d->cinfo.ac_huff_tbl_ptrs[i] = tables->mAc[i];
+        }
+    }
+    for (int i = 0; i < NUM_QUANT_TBLS; ++i) {
+        if (tables->mHasQuant[i]) {
+            if (d->cinfo.quant_tbl_ptrs[i] == NULL) {
+                d->cinfo.quant_tbl_ptrs[i] = mjpeg_alloc_quant_table(common);
+            }
+            *d->cinfo.quant_tbl_ptrs[i] = tables->mQuant[i];
+        }
+    }
+}
+
+// Decodes the frame whose header d has just read, in bands side by side
+// when it has restart markers to cut it at. tables are the ones in effect
+// for the frame.
+bool SoftMJPG::decodeSplitFrame(Decompressor *d, const uint8_t *data, size_t size,
+        const JpegTables *tables, unsigned char * yuv_buffer,
+        int32_t width, int32_t height) {
+    BandJob job;
+    job.mTables = tables;
+    job.mYuv = yuv_buffer;
+    job.mWidth = width;
+    job.mHeight = height;
+
+    if (planBands(&d->cinfo, data, size, &job)) {
+        mjpeg_abort_decompress(&d->cinfo);
+
+        SprdStripePool::getInstance()->run(DecodeBands, &job, job.mCount,
+                (size_t)width * height * 3 / 2 / job.mCount);
+
+        bool decoded = true;
+        for (int32_t i = 0; i < job.mCount; ++i) {
+            decoded = decoded && job.mDecoded[i];
+        }
+        if (decoded) {
+            return true;
+        }
+
+        ALOGW("band decode failed, decoding the frame whole");
+        if (!readHeader(d, data, size, tables, 1)) {
+            return false;
+        }
+    }
+
+    return decodeFrame(d, yuv_buffer, yuv_buffer + width * height, width, height);
+}
+
+// Offset of the height field of the frame header, 0 if there is none.
+static size_t findFrameHeight(const uint8_t *data, size_t size) {
+    size_t i = 2;
+    while (i + 4 <= size && data[i] == 0xff) {
+        uint8_t marker = data[i + 1];
+        if (marker == 0xff) {
+            ++i;
+            continue;
+        }
+        if (marker >= 0xc0 && marker <= 0xcf
+                && marker != 0xc4 && marker != 0xc8 && marker != 0xcc) {
+            return i + 7 <= size ? i + 5 : 0;
+        }
+        i += 2 + ((data[i + 2] << 8) | data[i + 3]);
+    }
+    return 0;
+}
+
+// Cuts a sequential frame with restart markers into bands of whole iMCU
+// rows. Each band is decoded as a JPEG of its own: the frame's header with
+// the height patched, followed by the band's entropy-coded data. Bands
+// only start at every eighth restart interval, so each begins with RST0
+// like a whole frame; restarts reset the DC predictors, so nothing else
+// carries over from one band to the next.
+bool SoftMJPG::planBands(const jpeg_decompress_struct *cinfo, const uint8_t *data,
+        size_t size, BandJob *job) {
+    int32_t numBands = SprdStripePool::getInstance()->threadCount();
+    if (numBands > kMaxBands) {
+        numBands = kMaxBands;
+    }
+    // Scaled frames are cheap enough to decode whole, and their band
+    // boundaries would not fall on even output rows.
+    if (numBands < 2 || cinfo->restart_interval == 0 || cinfo->scale_denom != 1
+            || cinfo->progressive_mode || cinfo->arith_code
+            || cinfo->comps_in_scan != cinfo->num_components
+            || job->mWidth * job->mHeight < kMinSplitPixels) {
+        return false;
+    }
+
+    int32_t mcuWidth = DCTSIZE;
+    int32_t mcuHeight = DCTSIZE;
+    if (cinfo->comps_in_scan > 1) {
+        mcuWidth *= cinfo->max_h_samp_factor;
+        mcuHeight *= cinfo->max_v_samp_factor;
+    }
+    int32_t iMcuHeight = cinfo->max_v_samp_factor * DCTSIZE;
+    size_t mcusPerRow = (cinfo->image_width + mcuWidth - 1) / mcuWidth;
+    int32_t mcuRows = (cinfo->image_height + mcuHeight - 1) / mcuHeight;
+    size_t interval = cinfo->restart_interval;
+
+    // Interval each band starts with.
+    size_t firstInterval[kMaxBands];
+    job->mCount = 1;
+    job->mFirstRow[0] = 0;
+    firstInterval[0] = 0;
+    for (int32_t row = 1; row < mcuRows && job->mCount < numBands; ++row) {
+        size_t mcu = row * mcusPerRow;
+        if (row < job->mCount * mcuRows / numBands
+                || mcu % (8 * interval) != 0 || (row * mcuHeight) % iMcuHeight != 0) {
+            continue;
+        }
+        job->mFirstRow[job->mCount] = row * mcuHeight;
+        firstInterval[job->mCount] = mcu / interval;
+        ++job->mCount;
+    }
+    if (job->mCount < 2) {
+        return false;
+    }
+    job->mFirstRow[job->mCount] = cinfo->image_height;
+
+    job->mHeaderSize = cinfo->src->next_input_byte - data;
+    job->mHeightOffset = findFrameHeight(data, job->mHeaderSize);
+    if (job->mHeightOffset == 0) {
+        return false;
+    }
+
+    // Walk the markers of the entropy-coded data, checking there is one
+    // after every interval but the last.
+    size_t restarts = 0;
+    int32_t band = 1;
+    size_t i = job->mHeaderSize;
+    job->mBegin[0] = i;
+    while (i + 1 < size) {
+        const uint8_t *ff = (const uint8_t *)memchr(data + i, 0xff, size - 1 - i);
+        if (ff == NULL) {
+            i = size;
+            break;
+        }
+        i = ff - data;
+        uint8_t marker = data[i + 1];
+        if (marker == 0xff) {
+            ++i;
+        } else if (marker == 0x00) {
+            i += 2;
+        } else if (marker >= 0xd0 && marker <= 0xd7) {
+            ++restarts;
+            if (band < job->mCount && restarts == firstInterval[band]) {
+                job->mEnd[band - 1] = i;
+                job->mBegin[band] = i + 2;
+                ++band;
+            }
+            i += 2;
+        } else {
+            break;
+        }
+    }
+    job->mEnd[job->mCount - 1] = i;
+
+    size_t intervals = (mcusPerRow * mcuRows + interval - 1) / interval;
+    if (band != job->mCount || restarts + 1 != intervals) {
+        ALOGV("%zu restart markers for %zu intervals, not splitting", restarts, intervals);
+        return false;
+    }
+
+    job->mOwner = this;
+    job->mData = data;
+    return true;
+}
+
+// static
+void SoftMJPG::DecodeBands(void *cookie, int32_t begin, int32_t end) {
+    BandJob *job = static_cast<BandJob *>(cookie);
+    for (int32_t i = begin; i < end; ++i) {
+        job->mDecoded[i] = job->mOwner->decodeBand(job, i);
+    }
+}
+
+bool SoftMJPG::decodeBand(BandJob *job, int32_t index) {
+    Decompressor *d = &mBandDecompressors[index];
+    if (!d->mCreated && createDecompressor(d) != OK) {
+        return false;
+    }
+
+    int32_t firstRow = job->mFirstRow[index];
+    int32_t rows = job->mFirstRow[index + 1] - firstRow;
+    size_t dataSize = job->mEnd[index] - job->mBegin[index];
+    size_t size = job->mHeaderSize + dataSize + 2;
+
+    if (size > d->mStreamCapacity) {
+        free(d->mStream);
+        d->mStream = (uint8_t *)malloc(size);
+        if (d->mStream == NULL) {
+            d->mStreamCapacity = 0;
+            return false;
+        }
+        d->mStreamCapacity = size;
+    }
+    memcpy(d->mStream, job->mData, job->mHeaderSize);
+    d->mStream[job->mHeightOffset] = rows >> 8;
+    d->mStream[job->mHeightOffset + 1] = rows & 0xff;
+    memcpy(d->mStream + job->mHeaderSize, job->mData + job->mBegin[index], dataSize);
+    d->mStream[size - 2] = 0xff;
+    d->mStream[size - 1] = 0xd9;    // EOI
+
+    // The last band also covers the rows the output is padded with.
+    int32_t outputRows = index + 1 < job->mCount ? rows : job->mHeight - firstRow;
+    uint8_t *py = job->mYuv + firstRow * job->mWidth;
+    uint8_t *puv = job->mYuv + job->mWidth * job->mHeight + (firstRow / 2) * job->mWidth;
+
+    return readHeader(d, d->mStream, size, job->mTables, 1)
+            && decodeFrame(d, py, puv, job->mWidth, outputRows);
+}
+
+// Decodes the frame whose header d has just read into the luma and chroma
+// planes at py and puv.
+bool SoftMJPG::decodeFrame(Decompressor *d, unsigned char * py, unsigned char * puv,
+        int32_t width, int32_t height) {
+    if (setjmp(d->jerr.setjmp_buffer)) {
+        mjpeg_abort_decompress(&d->cinfo);
+        return false;
+    }
+
+    decode_jpeg_frame(d, py, puv, width, height);
+    return true;
+}
+
+void SoftMJPG::decode_jpeg_frame(Decompressor *d, unsigned char * py, unsigned char * puv,
+        int32_t width, int32_t height) {
+    struct jpeg_decompress_struct &cinfo = d->cinfo;
+
     cinfo.out_color_space = cinfo.jpeg_color_space;
+    cinfo.raw_data_out = canReadRawData(&cinfo) ? TRUE : FALSE;
 
     /* Start decompressor */
     mjpeg_start_decompress(&cinfo);
 
-    unsigned char* py = yuv_buffer;
-    unsigned char* puv = yuv_buffer +mWidth *mHeight;
-    JSAMPARRAY buffer = (*cinfo.mem->alloc_sarray) ((j_common_ptr) &cinfo, JPOOL_IMAGE, mWidth * cinfo.output_components, 1);
-    while (cinfo.output_scanline < cinfo.output_height) {
-        /* jpeg_read_scanlines expects an array of pointers to scanlines.
-         * Here the array is only one element long, but you could ask for
-         * more than one scanline at a time if that's more convenient.
-         */
-        mjpeg_read_scanlines(&cinfo, buffer, 1);
-
-        /* Assume put_scanline_someplace wants a pointer and sample count. */
-        unsigned char* pbuf = buffer[0];
-        if (cinfo.out_color_space == JCS_YCbCr) {
-            if (cinfo.output_scanline & 1) {
-                for (int i=mWidth/2; i>0; i--) {
-                    *py ++ = * pbuf ++;
-                    *puv ++ = * pbuf ++;
-                    *puv ++ = * pbuf ++;
-
-                    *py ++ = * pbuf ++;
-                    pbuf ++;
-                    pbuf ++;
-                }
-            } else {
-                for (int i=mWidth/2; i>0; i--) {
-                    *py ++ = * pbuf ++;
-                    pbuf ++;
-                    pbuf ++;
-
-                    *py ++ = * pbuf ++;
-                    pbuf ++;
-                    pbuf ++;
-                }
-            }
-        } else { // JCS_GRAYSCALE
-            memcpy(py, pbuf, mWidth);
-            py += mWidth;
-            memset(puv, 0x80, mWidth/2);
-            puv += mWidth/2;
+    if (cinfo.raw_data_out) {
+        readRawData(d, py, puv, width, height);
+    } else {
+        readScanlines(d, py, puv, width);
+    }
+
+    // Every scanline is out; skip jpeg_finish_decompress()'s search for
+    // EOI and return the decompressor to its idle state for the next frame.
+    mjpeg_abort_decompress(&cinfo);
+}
+
+// 4:2:0 and 4:2:2 YCbCr and greyscale come out of the IDCT in the layout
+// NV12 needs, so libjpeg's upsampling and colour stages can be skipped.
+// Scaled down, libjpeg decodes 4:2:0 chroma at luma resolution instead,
+// and 4:2:2 at 1/8 yields one row per pass; those take the scanline path,
+// which is cheap at those sizes.
+bool SoftMJPG::canReadRawData(const jpeg_decompress_struct *cinfo) const {
+    if (mjpeg_read_raw_data == NULL || cinfo->max_v_samp_factor > 2) {
+        return false;
+    }
+
+    if (cinfo->jpeg_color_space == JCS_GRAYSCALE) {
+        return cinfo->num_components == 1;
+    }
+    if (cinfo->jpeg_color_space != JCS_YCbCr || cinfo->num_components != 3
+            || (cinfo->max_v_samp_factor * cinfo->min_DCT_scaled_size) % 2 != 0) {
+        return false;
+    }
+
+    const jpeg_component_info *comp = cinfo->comp_info;
+    return comp[1].DCT_scaled_size == cinfo->min_DCT_scaled_size
+            && comp[0].h_samp_factor == 2
+            && comp[1].h_samp_factor == 1 && comp[1].v_samp_factor == 1
+            && comp[2].h_samp_factor == 1 && comp[2].v_samp_factor == 1;
+}
+
+// Luma is decoded straight into the output buffer. Chroma lands in one
+// iMCU row of planar buffers and is interleaved from there, averaging row
+// pairs for 4:2:2.
+void SoftMJPG::readRawData(Decompressor *d, unsigned char * py, unsigned char * puv,
+        int32_t width, int32_t height) {
+    struct jpeg_decompress_struct &cinfo = d->cinfo;
+
+    // Every block comes out as min_DCT_scaled_size rows, DCTSIZE unscaled.
+    int32_t rowsPerPass = cinfo.max_v_samp_factor * cinfo.min_DCT_scaled_size;
+    int32_t chromaRows = cinfo.min_DCT_scaled_size;
+    int32_t chromaCount = width / 2;
+    size_t chromaStride = 0;
+
+    JSAMPROW lumaRows[2 * DCTSIZE];
+    JSAMPARRAY planes[3] = { lumaRows, NULL, NULL };
+
+    if (cinfo.num_components == 3) {
+        chromaStride = cinfo.comp_info[1].width_in_blocks * cinfo.min_DCT_scaled_size;
+        if (chromaStride < (size_t)chromaCount) {
+            chromaStride = chromaCount;
         }
+        chromaStride = (chromaStride + 31) & ~31;
+        if (!allocRows(d, 2 * chromaRows, chromaStride)) {
+            ALOGE("failed to allocate %d chroma rows of %zu bytes", 2 * chromaRows, chromaStride);
+            longjmp(d->jerr.setjmp_buffer, 1);
+        }
+        planes[1] = d->mRows;
+        planes[2] = d->mRows + chromaRows;
+    } else {
+        memset(puv, 0x80, width * height / 2);
     }
 
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JDIMENSION row = cinfo.output_scanline;
+        for (int32_t i = 0; i < rowsPerPass; ++i) {
+            lumaRows[i] = py + (row + i) * width;
+        }
+
+        if (mjpeg_read_raw_data(&cinfo, planes, rowsPerPass) == 0) {
+            break;
+        }
 
-    /* Finish decompression */
-    mjpeg_finish_decompress(&cinfo);
+        if (cinfo.num_components == 3) {
+            SprdMergeChromaPlanes(
+                    d->mRows[0], d->mRows[chromaRows], chromaStride,
+                    puv + (row / 2) * width, width, chromaCount, rowsPerPass / 2,
+                    cinfo.comp_info[0].v_samp_factor == 1 ? 2 : 1, kSprdChromaUV);
+        }
+    }
+}
+
+// Everything else goes through libjpeg's upsampler at full resolution.
+void SoftMJPG::readScanlines(Decompressor *d, unsigned char * py, unsigned char * puv,
+        int32_t width) {
+    struct jpeg_decompress_struct &cinfo = d->cinfo;
+
+    // Ask for as many rows as one pass of the upsampler produces, so the
+    // library hands back whole iMCU rows instead of one line per call.
+    size_t rowBytes = width * cinfo.output_components;
+    size_t maxRows = cinfo.rec_outbuf_height * cinfo.max_v_samp_factor;
+    if (maxRows < 1) {
+        maxRows = 1;
+    }
+    if (!allocRows(d, maxRows, rowBytes)) {
+        ALOGE("failed to allocate %zu rows of %zu bytes", maxRows, rowBytes);
+        longjmp(d->jerr.setjmp_buffer, 1);
+    }
 
-    /* Release JPEG decompression object */
-    mjpeg_destroy_decompress(&cinfo);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JDIMENSION row = cinfo.output_scanline;
+        JDIMENSION numRows = mjpeg_read_scanlines(&cinfo, d->mRows, maxRows);
+
+        for (JDIMENSION n = 0; n < numRows; ++n, ++row) {
+            unsigned char* pbuf = d->mRows[n];
+            if (cinfo.out_color_space == JCS_YCbCr) {
+                if (!(row & 1)) {
+                    for (int i=width/2; i>0; i--) {
+                        *py ++ = * pbuf ++;
+                        *puv ++ = * pbuf ++;
+                        *puv ++ = * pbuf ++;
+
+                        *py ++ = * pbuf ++;
+                        pbuf ++;
+                        pbuf ++;
+                    }
+                } else {
+                    for (int i=width/2; i>0; i--) {
+                        *py ++ = * pbuf ++;
+                        pbuf ++;
+                        pbuf ++;
+
+                        *py ++ = * pbuf ++;
+                        pbuf ++;
+                        pbuf ++;
+                    }
+                }
+            } else { // JCS_GRAYSCALE
+                memcpy(py, pbuf, width);
+                py += width;
+                memset(puv, 0x80, width/2);
+                puv += width/2;
+            }
+        }
+    }
 }
 
 
@@ -606,6 +1447,11 @@ bool SoftMJPG::openDecoder(const char* libName) {
         return false;
     }
 
+    mjpeg_read_raw_data = (jpeg_read_raw_data_ptr)dlsym(mLibHandle, "jpeg_read_raw_data");
+    if(mjpeg_read_raw_data == NULL) {
+        ALOGW("Can't find jpeg_read_raw_data in %s, decoding through the upsampler",libName);
+    }
+
     mjpeg_finish_decompress = (jpeg_finish_decompress_ptr)dlsym(mLibHandle, "jpeg_finish_decompress");
     if(mjpeg_finish_decompress == NULL) {
         ALOGE("Can't find jpeg_finish_decompress in %s",libName);
@@ -622,6 +1468,29 @@ bool SoftMJPG::openDecoder(const char* libName) {
         return false;
     }
 
+    mjpeg_abort_decompress = (jpeg_abort_decompress_ptr)dlsym(mLibHandle, "jpeg_abort_decompress");
+    if(mjpeg_abort_decompress == NULL) {
+        ALOGE("Can't find jpeg_abort_decompress in %s",libName);
+        dlclose(mLibHandle);
+        mLibHandle = NULL;
+        return false;
+    }
+
+    mjpeg_alloc_huff_table = (jpeg_alloc_huff_table_ptr)dlsym(mLibHandle, "jpeg_alloc_huff_table");
+    if(mjpeg_alloc_huff_table == NULL) {
+        ALOGW("Can't find jpeg_alloc_huff_table in %s, streams without DHT may fail",libName);
+    }
+
+    mjpeg_alloc_quant_table = (jpeg_alloc_quant_table_ptr)dlsym(mLibHandle, "jpeg_alloc_quant_table");
+    if(mjpeg_alloc_quant_table == NULL) {
+        ALOGW("Can't find jpeg_alloc_quant_table in %s",libName);
+    }
+
+    mjpeg_calc_output_dimensions = (jpeg_calc_output_dimensions_ptr)dlsym(mLibHandle, "jpeg_calc_output_dimensions");
+    if(mjpeg_calc_output_dimensions == NULL) {
+        ALOGW("Can't find jpeg_calc_output_dimensions in %s, no scaled decoding",libName);
+    }
+
     return true;
 }
 
@@ -19,6 +19,7 @@
 #define SOFT_MJPG_H_
 
 #include "SprdSimpleOMXComponent.h"
+#include "SprdStripePool.h"
 
 #include "jpeglib.h"
 
@@ -33,13 +34,29 @@ typedef void (*jpeg_mem_src_ptr)(j_decompress_ptr cinfo, unsigned char * inbuffe
 typedef int (*jpeg_read_header_ptr)(j_decompress_ptr cinfo, boolean require_image);
 typedef boolean (*jpeg_start_decompress_ptr)(j_decompress_ptr cinfo);
 typedef JDIMENSION (*jpeg_read_scanlines_ptr)(j_decompress_ptr cinfo, JSAMPARRAY scanlines, JDIMENSION max_lines);
+typedef JDIMENSION (*jpeg_read_raw_data_ptr)(j_decompress_ptr cinfo, JSAMPIMAGE data, JDIMENSION max_lines);
 typedef boolean (*jpeg_finish_decompress_ptr)(j_decompress_ptr cinfo);
 typedef void (*jpeg_destroy_decompress_ptr)(j_decompress_ptr cinfo);
+typedef void (*jpeg_abort_decompress_ptr)(j_decompress_ptr cinfo);
+typedef JHUFF_TBL* (*jpeg_alloc_huff_table_ptr)(j_common_ptr cinfo);
+typedef JQUANT_TBL* (*jpeg_alloc_quant_table_ptr)(j_common_ptr cinfo);
+typedef void (*jpeg_calc_output_dimensions_ptr)(j_decompress_ptr cinfo);
 
 
 
 namespace android {
 
+// Payload of OMX_IndexParamDecodeScale on the output port. Frames are
+// decoded at 1/nScaleDenom of their size, 1, 2, 4 or 8, by the scaled
+// IDCT. A change takes effect at the next frame and goes through the
+// output port settings change like a change of picture size.
+struct SprdDecodeScaleParams {
+    OMX_U32 nSize;
+    OMX_VERSIONTYPE nVersion;
+    OMX_U32 nPortIndex;
+    OMX_U32 nScaleDenom;
+};
+
 struct SoftMJPG : public SprdSimpleOMXComponent {
     SoftMJPG(const char *name,
              const OMX_CALLBACKTYPE *callbacks,
@@ -57,16 +74,95 @@ protected:
 
     virtual OMX_ERRORTYPE getConfig(OMX_INDEXTYPE index, OMX_PTR params);
 
+    virtual OMX_ERRORTYPE getExtensionIndex(
+        const char *name, OMX_INDEXTYPE *index);
+
     virtual void onQueueFilled(OMX_U32 portIndex);
     virtual void onPortEnableCompleted(OMX_U32 portIndex, bool enabled);
-
-    void decode_jpeg_frame(unsigned char* yuv_buffer);
+    virtual void onPortFlushPrepare(OMX_U32 portIndex);
+    virtual void onPortDisablePrepare(OMX_U32 portIndex);
 
     static void notify_jpeg_error(j_common_ptr cinfo);
 private:
     enum {
         kNumInputBuffers  = 4,
         kNumOutputBuffers = 4,
+        kMaxWorkers       = 4,
+        kMaxFrames        = 2 * kMaxWorkers,
+        kMaxBands         = SprdStripePool::kMaxThreads,
+    };
+
+    struct my_jpeg_error_mgr {
+        struct jpeg_error_mgr pub;
+        jmp_buf setjmp_buffer;
+    };
+
+    // One libjpeg decompressor and its scratch rows. It lives as long as
+    // the component and is put back to its idle state with
+    // jpeg_abort_decompress() after every frame, so Huffman and
+    // quantization tables carry over to frames that omit them.
+    struct Decompressor {
+        SoftMJPG *mOwner;
+        struct jpeg_decompress_struct cinfo;
+        struct my_jpeg_error_mgr jerr;
+        bool mCreated;
+
+        // Rows handed to jpeg_read_scanlines() in one call, or the chroma
+        // rows of one jpeg_read_raw_data() call.
+        JSAMPROW *mRows;
+        uint8_t *mRowBuffer;
+        size_t mRowBufferSize;
+        size_t mMaxRows;
+
+        // The JPEG a band decompressor decodes.
+        uint8_t *mStream;
+        size_t mStreamCapacity;
+    };
+
+    // The Huffman and quantization tables in effect when a frame's header
+    // was read, so a worker decodes it as if it had seen every frame before.
+    struct JpegTables {
+        bool mHasDc[NUM_HUFF_TBLS];
+        bool mHasAc[NUM_HUFF_TBLS];
+        bool mHasQuant[NUM_QUANT_TBLS];
+        JHUFF_TBL mDc[NUM_HUFF_TBLS];
+        JHUFF_TBL mAc[NUM_HUFF_TBLS];
+        JQUANT_TBL mQuant[NUM_QUANT_TBLS];
+    };
+
+    // A frame handed to the workers. Its input and output buffers stay in
+    // their port queues until the frame is returned, in order, by
+    // onQueueFilled().
+    struct Frame {
+        enum {
+            QUEUED,
+            DECODING,
+            DONE,
+        } mState;
+        bool mError;
+        BufferInfo *mInInfo;
+        BufferInfo *mOutInfo;
+        int64_t mTimeStamp;
+        int32_t mWidth, mHeight;
+        int32_t mScaleDenom;
+        bool mSplit;    // may be decoded in restart interval bands
+        JpegTables mTables;
+    };
+
+    // One frame cut into bands of whole MCU rows at restart markers.
+    struct BandJob {
+        SoftMJPG *mOwner;
+        const uint8_t *mData;
+        size_t mHeaderSize;     // up to the entropy-coded data
+        size_t mHeightOffset;   // of the SOF height field
+        const JpegTables *mTables;
+        uint8_t *mYuv;
+        int32_t mWidth, mHeight;
+        int32_t mCount;
+        int32_t mFirstRow[kMaxBands + 1];
+        size_t mBegin[kMaxBands];
+        size_t mEnd[kMaxBands];
+        bool mDecoded[kMaxBands];
     };
 
     size_t mInputBufferCount;
@@ -74,8 +170,11 @@ private:
     int32_t mWidth, mHeight;
     int32_t mCropWidth, mCropHeight;
 
+    // Requested through OMX_IndexParamDecodeScale, applied from the next
+    // frame header on.
+    int32_t mScaleDenom;
+
     bool mSignalledError;
-    bool mFramesConfigured;
 
     int32_t mNumSamplesOutput;
 
@@ -85,13 +184,27 @@ private:
         AWAITING_ENABLED
     } mOutputPortSettingsChange;
 
+    // Reads every frame header, in stream order, and decodes the frames
+    // itself when there are no workers.
+    Decompressor mDecompressor;
 
+    // Frames in flight, oldest at mFrameHead. Workers take QUEUED frames
+    // in order but may finish them out of order.
+    Mutex mFrameLock;
+    Condition mFrameCondition;
+    Condition mFrameDoneCondition;
+    Frame mFrames[kMaxFrames];
+    size_t mFrameHead;
+    size_t mFrameCount;
 
-    struct jpeg_decompress_struct cinfo;
-    struct my_jpeg_error_mgr {
-        struct jpeg_error_mgr pub;
-        jmp_buf setjmp_buffer;
-    } jerr;
+    int32_t mNumWorkers;
+    bool mWorkersExit;
+    pthread_t mWorkers[kMaxWorkers];
+    Decompressor mWorkerDecompressors[kMaxWorkers];
+
+    // One per band. Frames are only split while no other frame is being
+    // decoded, so one set is enough.
+    Decompressor mBandDecompressors[kMaxBands];
 
     void* mLibHandle;
     jpeg_std_error_ptr       mjpeg_std_error;
@@ -100,12 +213,54 @@ private:
     jpeg_read_header_ptr mjpeg_read_header;
     jpeg_start_decompress_ptr mjpeg_start_decompress;
     jpeg_read_scanlines_ptr mjpeg_read_scanlines;
+    jpeg_read_raw_data_ptr mjpeg_read_raw_data;
     jpeg_finish_decompress_ptr mjpeg_finish_decompress;
     jpeg_destroy_decompress_ptr mjpeg_destroy_decompress;
+    jpeg_abort_decompress_ptr mjpeg_abort_decompress;
+    jpeg_alloc_huff_table_ptr mjpeg_alloc_huff_table;
+    jpeg_alloc_quant_table_ptr mjpeg_alloc_quant_table;
+    jpeg_calc_output_dimensions_ptr mjpeg_calc_output_dimensions;
 
 
     void initPorts();
     status_t initDecoder();
+    void releaseDecoder();
+    status_t createDecompressor(Decompressor *d);
+    void destroyDecompressor(Decompressor *d);
+    void installDefaultHuffmanTables(Decompressor *d);
+    bool allocRows(Decompressor *d, size_t rows, size_t rowBytes);
+
+    bool readHeader(Decompressor *d, const uint8_t *data, size_t size,
+            const JpegTables *tables, int32_t scaleDenom);
+    void restoreTables(Decompressor *d, const JpegTables *tables);
+    static void saveTables(const jpeg_decompress_struct *cinfo, JpegTables *tables);
+
+    bool decodeSplitFrame(Decompressor *d, const uint8_t *data, size_t size,
+            const JpegTables *tables, unsigned char* yuv_buffer,
+            int32_t width, int32_t height);
+    bool planBands(const jpeg_decompress_struct *cinfo, const uint8_t *data,
+            size_t size, BandJob *job);
+    static void DecodeBands(void *cookie, int32_t begin, int32_t end);
+    bool decodeBand(BandJob *job, int32_t index);
+
+    bool decodeFrame(Decompressor *d, unsigned char* py, unsigned char* puv,
+            int32_t width, int32_t height);
+    void decode_jpeg_frame(Decompressor *d, unsigned char* py, unsigned char* puv,
+            int32_t width, int32_t height);
+    bool canReadRawData(const jpeg_decompress_struct *cinfo) const;
+    void readRawData(Decompressor *d, unsigned char* py, unsigned char* puv,
+            int32_t width, int32_t height);
+    void readScanlines(Decompressor *d, unsigned char* py, unsigned char* puv,
+            int32_t width);
+
+    void startWorkers();
+    void stopWorkers();
+    static void *WorkerWrapper(void *arg);
+    void workerLoop(Decompressor *d);
+    void cancelFrames();
+    bool drainFrames();
+    BufferInfo *findFreeOutputBuffer();
+    void returnFrame(BufferInfo *inInfo, BufferInfo *outInfo, int64_t timeStamp);
 
     void updatePortDefinitions();
     bool portSettingsChanged();
@@ -79,12 +79,13 @@ SPRDVP9Decoder::SPRDVP9Decoder(
       mDumpYUVEnabled(false),
       mDumpStrmEnabled(false),
       mAllocateBuffers(false),
+      mAllocInput(false),
       mPbuf_inter(NULL),
       mPmem_stream(NULL),
       mPbuf_stream_v(NULL),
       mPbuf_stream_p(0),
       mPbuf_stream_size(0),
-      mPmem_extra(NULL),
+      mIonArena(NULL),
       mPbuf_extra_v(NULL),
       mPbuf_extra_p(0),
       mPbuf_extra_size(0),
@@ -119,6 +120,18 @@ SPRDVP9Decoder::SPRDVP9Decoder(
     mDumpStrmEnabled = !strcmp(value_dump, "true");
     ALOGI("%s, mDumpYUVEnabled: %d, mDumpStrmEnabled: %d", __FUNCTION__, mDumpYUVEnabled, mDumpStrmEnabled);
 
+    property_get("vendor.vp9dec.async", value_dump, "false");
+    if (!strcmp(value_dump, "true")) {
+        startDecodeThread();
+    }
+
+    enableVspScheduling(SprdVspScheduler::kCoreDecoder);
+
+    // Let the engine read the bitstream straight from the input buffers
+    // when the client asks us to allocate them.
+    property_get("vendor.vp9dec.zerocopy", value_dump, "false");
+    mAllocInput = !strcmp(value_dump, "true");
+
     CHECK_EQ(initDecoder(), (status_t)OK);
 
     initPorts();
@@ -327,15 +340,14 @@ void SPRDVP9Decoder::releaseDecoder() {
         mPbuf_stream_size = 0;
     }
 
-    if(mPbuf_extra_v != NULL) {
-        if (mIOMMUEnabled) {
-            (*mVP9DecFreeIOVA)(mHandle, mPbuf_extra_p, mPbuf_extra_size);
-        }
-        mPmem_extra.clear();
-        mPbuf_extra_v = NULL;
-        mPbuf_extra_p = 0;
-        mPbuf_extra_size = 0;
+    if (mIonArena != NULL) {
+        mIonArena->releaseAll();
+        delete mIonArena;
+        mIonArena = NULL;
     }
+    mPbuf_extra_v = NULL;
+    mPbuf_extra_p = 0;
+    mPbuf_extra_size = 0;
 
     (*mVP9DecRelease)(mHandle);
 
@@ -624,22 +636,20 @@ OMX_ERRORTYPE SPRDVP9Decoder::internalUseBuffer(
                 pBufCtrl->bufferSize = 0;
             }
         }
+    } else if (portIndex == OMX_DirInput && bufferPrivate != NULL) {
+        (*header)->pInputPortPrivate = new BufferCtrlStruct;
+        CHECK((*header)->pInputPortPrivate != NULL);
+        BufferCtrlStruct* pBufCtrl= (BufferCtrlStruct*)((*header)->pInputPortPrivate);
+        pBufCtrl->iRefCount = 1;
+        pBufCtrl->id = mIOMMUID;
+        pBufCtrl->pMem = ((BufferPrivateStruct*)bufferPrivate)->pMem;
+        pBufCtrl->bufferFd = ((BufferPrivateStruct*)bufferPrivate)->bufferFd;
+        pBufCtrl->phyAddr = ((BufferPrivateStruct*)bufferPrivate)->phyAddr;
+        pBufCtrl->bufferSize = ((BufferPrivateStruct*)bufferPrivate)->bufferSize;
     }
 
-    PortInfo *port = editPortInfo(portIndex);
-
-    port->mBuffers.push();
-
-    BufferInfo *buffer =
-        &port->mBuffers.editItemAt(port->mBuffers.size() - 1);
     ALOGI("internalUseBuffer, header=%p, pBuffer=%p, size=%d",*header, ptr, size);
-    buffer->mHeader = *header;
-    buffer->mOwnedByUs = false;
-
-    if (port->mBuffers.size() == port->mDef.nBufferCountActual) {
-        port->mDef.bPopulated = OMX_TRUE;
-        checkTransitions();
-    }
+    addBuffer(portIndex, *header);
 
     return OMX_ErrorNone;
 }
@@ -651,7 +661,60 @@ OMX_ERRORTYPE SPRDVP9Decoder::allocateBuffer(
     OMX_U32 size) {
     switch (portIndex) {
     case OMX_DirInput:
-        return SprdSimpleOMXComponent::allocateBuffer(header, portIndex, appPrivate, size);
+    {
+        if (!mAllocInput) {
+            return SprdSimpleOMXComponent::allocateBuffer(header, portIndex, appPrivate, size);
+        }
+
+        MemIon* pMem = NULL;
+        unsigned long phyAddr = 0;
+        size_t bufferSize = 0;
+        OMX_U8* pBuffer = NULL;
+        size_t size64word = (size + 1024*4 - 1) & ~(1024*4 - 1);
+        int fd, ret;
+
+        if (mIOMMUEnabled) {
+            pMem = new MemIon(SPRD_ION_DEV, size64word, MemIon::NO_CACHING, ION_HEAP_ID_MASK_SYSTEM);
+        } else {
+            pMem = new MemIon(SPRD_ION_DEV, size64word, MemIon::NO_CACHING, ION_HEAP_ID_MASK_MM);
+        }
+
+        fd = pMem->getHeapID();
+        if(fd < 0) {
+            ALOGE("Failed to alloc input pmem buffer");
+            delete pMem;
+            return OMX_ErrorInsufficientResources;
+        }
+
+        if (mIOMMUEnabled) {
+            ret = (*mVP9DecGetIOVA)(mHandle, fd, &phyAddr, &bufferSize);
+            if(ret) {
+                ALOGE("input VP9DecGetIOVA Failed: %d(%s)", ret, strerror(errno));
+                delete pMem;
+                return OMX_ErrorInsufficientResources;
+            }
+        } else {
+            if(pMem->get_phy_addr_from_ion(&phyAddr, &bufferSize)) {
+                ALOGE("input get_phy_addr_from_ion fail");
+                delete pMem;
+                return OMX_ErrorInsufficientResources;
+            }
+        }
+
+        pBuffer = (OMX_U8 *)(pMem->getBase());
+        BufferPrivateStruct* bufferPrivate = new BufferPrivateStruct();
+        bufferPrivate->pMem = pMem;
+        bufferPrivate->bufferFd = fd;
+        bufferPrivate->phyAddr = phyAddr;
+        bufferPrivate->bufferSize = bufferSize;
+        ALOGI("allocateBuffer, allocate input buffer from pmem, pBuffer: %p, phyAddr: 0x%lx, size: %zd",
+                pBuffer, phyAddr, bufferSize);
+
+        SprdSimpleOMXComponent::useBuffer(header, portIndex, appPrivate, (OMX_U32)bufferSize, pBuffer, bufferPrivate);
+        delete bufferPrivate;
+
+        return OMX_ErrorNone;
+    }
 
     case OMX_DirOutput:
     {
@@ -672,6 +735,7 @@ OMX_ERRORTYPE SPRDVP9Decoder::allocateBuffer(
         fd = pMem->getHeapID();
         if(fd < 0) {
             ALOGE("Failed to alloc outport pmem buffer");
+            delete pMem;
             return OMX_ErrorInsufficientResources;
         }
 
@@ -679,11 +743,13 @@ OMX_ERRORTYPE SPRDVP9Decoder::allocateBuffer(
             ret = (*mVP9DecGetIOVA)(mHandle, fd, &phyAddr, &bufferSize);
             if(ret) {
                 ALOGE("VP9DecGetIOVA Failed: %d(%s)", ret, strerror(errno));
+                delete pMem;
                 return OMX_ErrorInsufficientResources;
             }
         } else {
             if(pMem->get_phy_addr_from_ion(&phyAddr, &bufferSize)) {
                 ALOGE("get_phy_addr_from_ion fail");
+                delete pMem;
                 return OMX_ErrorInsufficientResources;
             }
         }
@@ -712,7 +778,19 @@ OMX_ERRORTYPE SPRDVP9Decoder::freeBuffer(
     OMX_BUFFERHEADERTYPE *header) {
     switch (portIndex) {
     case OMX_DirInput:
+    {
+        BufferCtrlStruct* pBufCtrl= (BufferCtrlStruct*)(header->pInputPortPrivate);
+        if(pBufCtrl != NULL) {
+            ALOGV("freeBuffer, input phyAddr: 0x%lx", pBufCtrl->phyAddr);
+            if (mIOMMUEnabled && pBufCtrl->phyAddr > 0) {
+                (*mVP9DecFreeIOVA)(mHandle, pBufCtrl->phyAddr, pBufCtrl->bufferSize);
+            }
+            if(pBufCtrl->pMem != NULL) {
+                pBufCtrl->pMem.clear();
+            }
+        }
         return SprdSimpleOMXComponent::freeBuffer(portIndex, header);
+    }
 
     case OMX_DirOutput:
     {
@@ -750,8 +828,8 @@ void SPRDVP9Decoder::onQueueFilled(OMX_U32 portIndex) {
         return;
     }
 
-    List<BufferInfo *> &inQueue = getPortQueue(0);
-    List<BufferInfo *> &outQueue = getPortQueue(1);
+    PortQueue &inQueue = getPortQueue(0);
+    PortQueue &outQueue = getPortQueue(1);
 
     while ((mEOSStatus != INPUT_DATA_AVAILABLE || !inQueue.empty())
             && !outQueue.empty()) {
@@ -764,13 +842,13 @@ void SPRDVP9Decoder::onQueueFilled(OMX_U32 portIndex) {
         BufferInfo *inInfo = *inQueue.begin();
         OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
 
-        List<BufferInfo *>::iterator itBuffer = outQueue.begin();
+        PortQueue::iterator itBuffer = outQueue.begin();
         OMX_BUFFERHEADERTYPE *outHeader = NULL;
         BufferCtrlStruct *pBufCtrl = NULL;
         size_t count = 0;
         do {
             if(count >= outQueue.size()) {
-                ALOGI("%s, %d, get outQueue buffer fail, return, count=%zd, queue_size=%d",__FUNCTION__, __LINE__, count, outQueue.size());
+                SPRD_FRAME_LOGI("%s, %d, get outQueue buffer fail, return, count=%zd, queue_size=%d",__FUNCTION__, __LINE__, count, outQueue.size());
                 return;
             }
 
@@ -787,7 +865,7 @@ void SPRDVP9Decoder::onQueueFilled(OMX_U32 portIndex) {
             count++;
         } while (pBufCtrl->iRefCount > 0);
 
-        ALOGI("%s, %d, outHeader:%p, inHeader: %p, len: %d, nOffset: %d, time: %lld, EOS: %d",
+        SPRD_FRAME_LOGI("%s, %d, outHeader:%p, inHeader: %p, len: %d, nOffset: %d, time: %lld, EOS: %d",
               __FUNCTION__, __LINE__,outHeader,inHeader, inHeader->nFilledLen,inHeader->nOffset, inHeader->nTimeStamp,inHeader->nFlags & OMX_BUFFERFLAG_EOS);
 
         mFrameDecoded = false;
@@ -813,11 +891,20 @@ void SPRDVP9Decoder::onQueueFilled(OMX_U32 portIndex) {
         uint8_t *bitstream = inHeader->pBuffer + inHeader->nOffset;
         uint32_t bufferSize = inHeader->nFilledLen;
 
-        if (mPbuf_stream_v != NULL) {
-            memcpy(mPbuf_stream_v, bitstream, bufferSize);
+        // Buffers we allocated ourselves are handed to the engine as they
+        // are; client memory goes through the stream buffer.
+        unsigned long inPhyAddr = mAllocInput ? getInputStreamAddr(inHeader) : 0;
+        if (inPhyAddr != 0) {
+            dec_in.pStream = bitstream;
+            dec_in.pStream_phy = inPhyAddr;
+        } else {
+            if (mPbuf_stream_v != NULL) {
+                memcpy(mPbuf_stream_v, bitstream, bufferSize);
+                mMetrics.count(SprdCodecMetrics::kCounterCopyBytes, bufferSize);
+            }
+            dec_in.pStream=  mPbuf_stream_v;
+            dec_in.pStream_phy= mPbuf_stream_p;
         }
-        dec_in.pStream=  mPbuf_stream_v;
-        dec_in.pStream_phy= mPbuf_stream_p;
         dec_in.dataLen = bufferSize;
         dec_in.beLastFrm = 0;
         dec_in.expected_IVOP = mNeedIVOP;
@@ -878,13 +965,15 @@ void SPRDVP9Decoder::onQueueFilled(OMX_U32 portIndex) {
                 fwrite(& dec_in.dataLen, 1,4, mFile_bs);
                 fwrite(&tmp, 1,4, mFile_bs);
                 fwrite(&tmp, 1,4, mFile_bs);
-                fwrite(mPbuf_stream_v, 1, dec_in.dataLen, mFile_bs);
+                fwrite(dec_in.pStream, 1, dec_in.dataLen, mFile_bs);
             }
         }
-        int64_t start_decode = systemTime();
-        MMDecRet decRet = (*mVP9DecDecode)(mHandle, &dec_in,&dec_out);
-        int64_t end_decode = systemTime();
-        ALOGI("%s, %d, decRet: %d, %dms, dec_out.frameEffective: %d", __FUNCTION__, __LINE__, decRet, (unsigned int)((end_decode-start_decode) / 1000000L), dec_out.frameEffective);
+        MMDecRet decRet;
+        {
+            HardwareSection section(this);
+            decRet = (*mVP9DecDecode)(mHandle, &dec_in,&dec_out);
+        }
+        SPRD_FRAME_LOGI("%s, %d, decRet: %d, %dms, dec_out.frameEffective: %d", __FUNCTION__, __LINE__, decRet, (unsigned int)(mMetrics.lastUs(SprdCodecMetrics::kHistogramEngineTime) / 1000), dec_out.frameEffective);
 
         if(iUseAndroidNativeBuffer[OMX_DirOutput]) {
             if(mapper.unlock((const native_handle_t*)outHeader->pBuffer)) {
@@ -944,6 +1033,7 @@ void SPRDVP9Decoder::onQueueFilled(OMX_U32 portIndex) {
         } else {
             ALOGE("failed to decode video frame.");
             mNeedIVOP = true;
+            mMetrics.count(SprdCodecMetrics::kCounterErrors);
             if (decRet == MMDEC_NOT_SUPPORTED) {
                 ALOGE("failed to support this format.");
                 notify(OMX_EventError, OMX_ErrorFormatNotDetected, 0, NULL);
@@ -982,7 +1072,7 @@ void SPRDVP9Decoder::onQueueFilled(OMX_U32 portIndex) {
             outHeader->nOffset = 0;
             outHeader->nFilledLen = (mStride * mSliceHeight * 3) / 2;
             outHeader->nFlags = 0;
-            ALOGI("%s, %d, drainOneOutputBuffer, dec_out.pBufferHeader: %p, nTimeStamp: %lld mStride: %d, mSliceHeight: %d",
+            SPRD_FRAME_LOGI("%s, %d, drainOneOutputBuffer, dec_out.pBufferHeader: %p, nTimeStamp: %lld mStride: %d, mSliceHeight: %d",
                 __FUNCTION__, __LINE__, outHeader, outHeader->nTimeStamp,mStride, mSliceHeight);
         if(mDumpYUVEnabled){
             if (mFile_yuv != NULL) {
@@ -993,14 +1083,11 @@ void SPRDVP9Decoder::onQueueFilled(OMX_U32 portIndex) {
             continue;
         }
 
-        List<BufferInfo *>::iterator it = outQueue.begin();
-        while ((*it)->mHeader != outHeader && it != outQueue.end()) {
-            ++it;
-        }
+        BufferInfo *outInfo = findBufferInfo(kOutputPortIndex, outHeader);
+        CHECK(outInfo != NULL && outInfo->mQueued);
 
-        BufferInfo *outInfo = *it;
         outInfo->mOwnedByUs = false;
-        outQueue.erase(it);
+        outQueue.erase(outInfo);
         outInfo = NULL;
 
         BufferCtrlStruct* pOutBufCtrl= (BufferCtrlStruct*)(outHeader->pOutputPortPrivate);
@@ -1014,7 +1101,7 @@ void SPRDVP9Decoder::onQueueFilled(OMX_U32 portIndex) {
 bool SPRDVP9Decoder::drainAllOutputBuffers() {
     ALOGI("%s, %d", __FUNCTION__, __LINE__);
 
-    List<BufferInfo *> &outQueue = getPortQueue(1);
+    PortQueue &outQueue = getPortQueue(1);
     BufferInfo *outInfo;
     OMX_BUFFERHEADERTYPE *outHeader;
     void *pBufferHeader;
@@ -1023,13 +1110,9 @@ bool SPRDVP9Decoder::drainAllOutputBuffers() {
 
         if (mHeadersDecoded && (*mVP9DecGetLastDspFrm)(mHandle, &pBufferHeader) ) {
             ALOGI("%s, %d, VP9DecGetLastDspFrm, pBufferHeader: %p", __FUNCTION__, __LINE__, pBufferHeader);
-            List<BufferInfo *>::iterator it = outQueue.begin();
-            while ((*it)->mHeader != (OMX_BUFFERHEADERTYPE*)pBufferHeader && it != outQueue.end()) {
-                ++it;
-            }
-            CHECK((*it)->mHeader == (OMX_BUFFERHEADERTYPE*)pBufferHeader);
-            outInfo = *it;
-            outQueue.erase(it);
+            outInfo = findBufferInfo(kOutputPortIndex, (OMX_BUFFERHEADERTYPE*)pBufferHeader);
+            CHECK(outInfo != NULL && outInfo->mQueued);
+            outQueue.erase(outInfo);
             outHeader = outInfo->mHeader;
             outHeader->nFilledLen = (mStride * mSliceHeight * 3) / 2;
         } else {
@@ -1111,6 +1194,10 @@ OMX_ERRORTYPE SPRDVP9Decoder::getConfig(
         return OMX_ErrorNone;
     }
 
+    case OMX_IndexConfigCodecMetrics:
+    case OMX_IndexConfigCallbackBatching:
+        return SprdSimpleOMXComponent::getConfig(index, params);
+
     default:
         return OMX_ErrorUnsupportedIndex;
     }
@@ -1122,6 +1209,9 @@ OMX_ERRORTYPE SPRDVP9Decoder::setConfig(
     case OMX_IndexConfigDecSceneMode:
     {
         int *pDecSceneMode = (int *)params;
+        if (*pDecSceneMode == 3) { // VoLTE
+            setVspPriority(SprdVspScheduler::kPriorityRealtime);
+        }
 #ifdef CONFIG_AFBC_SUPPORT
         if(*pDecSceneMode == 4) {
             mUsage = GRALLOC_USAGE_CURSOR | GRALLOC_USAGE_SW_WRITE_NEVER;
@@ -1202,6 +1292,8 @@ OMX_ERRORTYPE SPRDVP9Decoder::getExtensionIndex(
         ALOGI("getExtensionIndex:%s",SPRD_INDEX_CONFIG_DEC_SCENE_MODE);
         *index = (OMX_INDEXTYPE) OMX_IndexConfigDecSceneMode;
         return OMX_ErrorNone;
+    } else if (!strcmp(name, SPRD_INDEX_CONFIG_CODEC_METRICS)) {
+        return SprdSimpleOMXComponent::getExtensionIndex(name, index);
     }
 
     return OMX_ErrorNotImplemented;
@@ -1247,54 +1339,59 @@ int SPRDVP9Decoder::VSP_unbind_cb(void *pHeader,int flag) {
     return 0;
 }
 
-int SPRDVP9Decoder::extMemoryAlloc(unsigned int extra_mem_size) {
+// static
+int SPRDVP9Decoder::IonArenaMapWrapper(
+    void *cookie, int fd, unsigned long *iova, size_t *size) {
+    SPRDVP9Decoder *decoder = static_cast<SPRDVP9Decoder *>(cookie);
+    return (*decoder->mVP9DecGetIOVA)(decoder->mHandle, fd, iova, size);
+}
 
-    MMCodecBuffer extra_mem[MAX_MEM_TYPE];
-    ALOGI("%s, %d, extra_mem_size: %d", __FUNCTION__, __LINE__, extra_mem_size);
+// static
+void SPRDVP9Decoder::IonArenaUnmapWrapper(
+    void *cookie, unsigned long iova, size_t size) {
+    SPRDVP9Decoder *decoder = static_cast<SPRDVP9Decoder *>(cookie);
+    (*decoder->mVP9DecFreeIOVA)(decoder->mHandle, iova, size);
+}
 
-    if (mPbuf_extra_v != NULL) {
+SprdIonArena *SPRDVP9Decoder::getIonArena() {
+    if (mIonArena == NULL) {
         if (mIOMMUEnabled) {
-            (*mVP9DecFreeIOVA)(mHandle, mPbuf_extra_p, mPbuf_extra_size);
+            mIonArena = new SprdIonArena("vp9_dec", ION_HEAP_ID_MASK_SYSTEM,
+                    IonArenaMapWrapper, IonArenaUnmapWrapper, this);
+        } else {
+            mIonArena = new SprdIonArena("vp9_dec", ION_HEAP_ID_MASK_MM, NULL, NULL, this);
         }
-        mPmem_extra.clear();
-        mPbuf_extra_v = NULL;
-        mPbuf_extra_p = 0;
-        mPbuf_extra_size = 0;
     }
+    return mIonArena;
+}
 
-    if (mIOMMUEnabled) {
-        mPmem_extra = new MemIon(SPRD_ION_DEV, extra_mem_size, MemIon::NO_CACHING, ION_HEAP_ID_MASK_SYSTEM);
-    } else {
-        mPmem_extra = new MemIon(SPRD_ION_DEV, extra_mem_size, MemIon::NO_CACHING, ION_HEAP_ID_MASK_MM);
-    }
-    int fd = mPmem_extra->getHeapID();
-    if(fd >= 0) {
-        int ret;
-        unsigned long phy_addr;
-        size_t buffer_size;
+int SPRDVP9Decoder::extMemoryAlloc(unsigned int extra_mem_size) {
 
-        if (mIOMMUEnabled) {
-            ret = (*mVP9DecGetIOVA)(mHandle, fd, &phy_addr, &buffer_size);
-        } else {
-            ret = mPmem_extra->get_phy_addr_from_ion(&phy_addr, &buffer_size);
-        }
-        if(ret < 0) {
-            ALOGE ("mPmem_extra: get phy addr fail %d",ret);
-            return -1;
-        }
+    MMCodecBuffer extra_mem[MAX_MEM_TYPE];
+    ALOGI("%s, %d, extra_mem_size: %d", __FUNCTION__, __LINE__, extra_mem_size);
 
-        mPbuf_extra_p = phy_addr;
-        mPbuf_extra_size = buffer_size;
-        mPbuf_extra_v = (uint8_t *)mPmem_extra->getBase();
-        ALOGI("pmem 0x%lx - %p - %zd", mPbuf_extra_p, mPbuf_extra_v, mPbuf_extra_size);
-        extra_mem[HW_NO_CACHABLE].common_buffer_ptr = mPbuf_extra_v;
-        extra_mem[HW_NO_CACHABLE].common_buffer_ptr_phy = mPbuf_extra_p;
-        extra_mem[HW_NO_CACHABLE].size = extra_mem_size;
-    } else {
-        ALOGE ("mPmem_extra: getHeapID fail %d", fd);
+    // A new sequence: the engine is done with the previous extra buffer,
+    // so its arena space is handed out again.
+    SprdIonArena *arena = getIonArena();
+    arena->reset();
+
+    SprdIonArena::Region region;
+    if (arena->alloc(extra_mem_size, &region) != OK) {
+        ALOGE("%s: unable to allocate extra buffer", __FUNCTION__);
+        mPbuf_extra_v = NULL;
+        mPbuf_extra_p = 0;
+        mPbuf_extra_size = 0;
         return -1;
     }
 
+    mPbuf_extra_p = region.mPhy;
+    mPbuf_extra_size = region.mSize;
+    mPbuf_extra_v = region.mVirt;
+    ALOGI("pmem 0x%lx - %p - %zd", mPbuf_extra_p, mPbuf_extra_v, mPbuf_extra_size);
+    extra_mem[HW_NO_CACHABLE].common_buffer_ptr = mPbuf_extra_v;
+    extra_mem[HW_NO_CACHABLE].common_buffer_ptr_phy = mPbuf_extra_p;
+    extra_mem[HW_NO_CACHABLE].size = extra_mem_size;
+
     (*mVP9DecMemInit)(((SPRDVP9Decoder *)this)->mHandle, extra_mem);
 
     mHeadersDecoded = true;
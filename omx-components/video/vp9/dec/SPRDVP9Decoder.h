@@ -19,6 +19,7 @@
 
 #include "SprdSimpleOMXComponent.h"
 #include "MemIon.h"
+#include "SprdIonArena.h"
 
 #include "vp9_dec_api.h"
 
@@ -120,6 +121,7 @@ private:
     bool mDumpYUVEnabled;
     bool mDumpStrmEnabled;
     bool mAllocateBuffers;
+    bool mAllocInput;
     uint8_t *mPbuf_inter;
 
     sp<MemIon> mPmem_stream;
@@ -127,7 +129,7 @@ private:
     unsigned long mPbuf_stream_p;
     size_t mPbuf_stream_size;
 
-    sp<MemIon> mPmem_extra;
+    SprdIonArena *mIonArena;
     uint8_t*  mPbuf_extra_v;
     unsigned long  mPbuf_extra_p;
     size_t  mPbuf_extra_size;
@@ -157,10 +159,13 @@ private:
     static int32_t BindFrameWrapper(void *aUserData, void *pHeader, int flag);
     static int32_t UnbindFrameWrapper(void *aUserData, void *pHeader, int flag);
     static int32_t extMemoryAllocWrapper(void *userData, unsigned int extra_mem_size);
+    static int IonArenaMapWrapper(void *cookie, int fd, unsigned long *iova, size_t *size);
+    static void IonArenaUnmapWrapper(void *cookie, unsigned long iova, size_t size);
 
     int VSP_bind_cb(void *pHeader,int flag);
     int VSP_unbind_cb(void *pHeader,int flag);
     int extMemoryAlloc(unsigned int extra_mem_size);
+    SprdIonArena *getIonArena();
 
     void initPorts();
     status_t initDecoder();
@@ -38,6 +38,8 @@ LOCAL_SHARED_LIBRARIES := \
     liblog                     \
     libmedia
 
+LOCAL_STATIC_LIBRARIES := libsprd_colorconvert
+
 LOCAL_MODULE := libstagefright_sprd_vp9enc
 LOCAL_MODULE_TAGS := optional
 LOCAL_PROPRIETARY_MODULE := true
@@ -46,8 +48,4 @@ ifeq ($(strip $(TARGET_BOARD_CAMERA_ANTI_SHAKE)),true)
 LOCAL_CFLAGS += -DANTI_SHAKE
 endif
 
-ifeq ($(strip $(TARGET_BIA_SUPPORT)),true)
-    LOCAL_CFLAGS += -DCONFIG_BIA_SUPPORT
-endif
-
 include $(BUILD_SHARED_LIBRARY)
@@ -68,3 +68,41 @@ LOCAL_PROPRIETARY_MODULE := true
 
 include $(BUILD_SHARED_LIBRARY)
 
+
+# Host build with the mock deinterlacer core of omx-components/mock in
+# place of core/vsp.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+    component/SPRDDeinterlace.cpp
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/core/vsp                                     \
+    $(LOCAL_PATH)/../../../../libstagefrighthw/include         \
+    $(LOCAL_PATH)/../../../../libstagefrighthw/include/openmax \
+    $(LOCAL_PATH)/../../../../../../external/kernel-headers    \
+    $(LOCAL_PATH)/../../avc/dec/hw                             \
+    $(LOCAL_PATH)/component                                    \
+    frameworks/av/include/
+
+LOCAL_C_INCLUDES += $(TOP)/vendor/sprd/external/drivers/gpu
+LOCAL_C_INCLUDES += $(TOP)/system/core/libion/kernel-headers
+
+LOCAL_CFLAGS := -DOSCL_EXPORT_REF= -DOSCL_IMPORT_REF=
+
+LOCAL_STATIC_LIBRARIES := libsprd_deint_mock
+
+LOCAL_SHARED_LIBRARIES := \
+    libstagefrighthw           \
+    libutils                   \
+    libui                      \
+    libmemion                  \
+    liblog
+
+LOCAL_LDLIBS := -lpthread
+
+LOCAL_MODULE := libstagefright_sprd_deintl
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_SHARED_LIBRARY)
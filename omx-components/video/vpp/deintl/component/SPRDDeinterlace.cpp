@@ -35,9 +35,10 @@ SPRDDeinterlace::SPRDDeinterlace(void* decOutputBufQueue, void* deinterInputBufQ
     mDeintlFrameNum(0),
     mIOMMU_VPP_Enabled(false),
     mIOMMU_VPP_ID(-1),
+    mIovaCache(NULL),
     mDecOutputBufQueue((List<BufferInfoBase *>*)decOutputBufQueue),
     mDeinterInputBufQueue((List<BufferInfoBase *>*)deinterInputBufQueue),
-    mOutQueue((List<BufferInfoBase *>*)outQueue){
+    mOutQueue((SprdSimpleOMXComponent::PortQueue*)outQueue){
 
     ALOGI("Construct SPRDDeinterlace, this: %p", (void *)this);
     //mComponent = component;
@@ -59,6 +60,9 @@ SPRDDeinterlace::SPRDDeinterlace(void* decOutputBufQueue, void* deinterInputBufQ
         ALOGI("VSP IOMMU is enabled");
         mIOMMU_VPP_Enabled = true;
     }
+    if (mIOMMU_VPP_Enabled) {
+        mIovaCache = new SprdIovaCache("deintl", IovaCacheMapWrapper, IovaCacheUnmapWrapper, this);
+    }
     ALOGI("%s, is mIOMMU_VPP_Enabled : %d, ID: %d", __FUNCTION__, mIOMMU_VPP_Enabled, mIOMMU_VPP_ID);
 
 }
@@ -72,6 +76,12 @@ SPRDDeinterlace::~SPRDDeinterlace() {
 
     //delete mDispBufferCtrl;
 
+    if (mIovaCache != NULL) {
+        mIovaCache->flush();
+        delete mIovaCache;
+        mIovaCache = NULL;
+    }
+
     vpp_deint_release(mVPPHeader);
     if (mVPPHeader) {
         delete mVPPHeader;
@@ -93,6 +103,26 @@ int32 SPRDDeinterlace::VspGetIova(int fd, unsigned long *iova, size_t *size) {
     return  ret;
 }
 
+void SPRDDeinterlace::invalidateIova(int fd) {
+    if (mIovaCache != NULL) {
+        mIovaCache->invalidate(fd);
+    }
+}
+
+// static
+int SPRDDeinterlace::IovaCacheMapWrapper(
+        void *cookie, int fd, unsigned long *iova, size_t *size) {
+    SPRDDeinterlace *deintl = static_cast<SPRDDeinterlace *>(cookie);
+    return vpp_deint_get_iova(deintl->mVPPHeader, fd, iova, size);
+}
+
+// static
+void SPRDDeinterlace::IovaCacheUnmapWrapper(
+        void *cookie, unsigned long iova, size_t size) {
+    SPRDDeinterlace *deintl = static_cast<SPRDDeinterlace *>(cookie);
+    vpp_deint_free_iova(deintl->mVPPHeader, iova, size);
+}
+
 #if 0
 int SPRDDeinterlace::remapDispBuffer(OMX_BUFFERHEADERTYPE * header,  unsigned long* phyAddr) {
     size_t bufferSize = 0;
@@ -249,8 +279,7 @@ void SPRDDeinterlace::deintlThreadFunc() {
         }
 
         //find an available display buffer from native window buffer queue
-        List<BufferInfoBase *>::iterator itBuffer = mOutQueue->begin();
-        OMX_BUFFERHEADERTYPE *outHeader = (*itBuffer)->mHeader;
+        OMX_BUFFERHEADERTYPE *outHeader = (*mOutQueue->begin())->mHeader;
         pBufCtrl= (BufferCtrlStruct*)(outHeader->pOutputPortPrivate);
 
         if(pBufCtrl->phyAddr != 0) {
@@ -258,11 +287,14 @@ void SPRDDeinterlace::deintlThreadFunc() {
             ALOGV("%s, %d, pBufCtrl %p, DstPhyAddr 0x%lx",__FUNCTION__,__LINE__,pBufCtrl,DstPhyAddr);
         } else {
             if (mIOMMU_VPP_Enabled) {
-                ret = vpp_deint_get_iova(mVPPHeader, pBufCtrl->bufferFd, &(pBufCtrl->phyAddr), &(pBufCtrl->bufferSize));
+                // The VPP mapping stays in the cache rather than in pBufCtrl,
+                // which the decoder unmaps from its own IOMMU.
+                size_t bufferSize = 0;
+                DstPhyAddr = 0;
+                ret = mIovaCache->map(pBufCtrl->bufferFd, &DstPhyAddr, &bufferSize);
                 ALOGV("%s, %d, bufferFd : %d, phy_addr : 0x%lx, ret : %d", __FUNCTION__,__LINE__,
-                              pBufCtrl->bufferFd, pBufCtrl->phyAddr, ret);
-                DstPhyAddr = pBufCtrl->phyAddr;
-                if (DstPhyAddr == 0){
+                              pBufCtrl->bufferFd, DstPhyAddr, ret);
+                if (ret < 0 || DstPhyAddr == 0){
                     return;
                 }
             } else {
@@ -378,6 +410,12 @@ void SPRDDeinterlace::stopDeinterlaceThread() {
 
     void *dummy;
     pthread_join(mThread, &dummy);
+
+    // Restarts follow flushes and port reconfigurations, after which the
+    // display buffers may be replaced.
+    if (mIovaCache != NULL) {
+        mIovaCache->flush();
+    }
     ALOGI("stopDeinterlaceThread E");
 
 }
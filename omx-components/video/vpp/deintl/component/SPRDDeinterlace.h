@@ -18,8 +18,11 @@
 #define SPRD_DEINTERLACE_H_
 #include "SprdSimpleOMXComponent.h"
 
+#include <stddef.h>
+
 #include "vpp_drv_interface.h"
 #include "MemIon.h"
+#include "SprdIovaCache.h"
 #include <media/stagefright/foundation/ABase.h>
 
 namespace android {
@@ -34,7 +37,33 @@ struct BufferInfoBase {   //must be same to SprdSimpleOMXComponent::BufferInfo
 
         int32_t mPicId;
         int32_t mNodeId;
+
+        int64_t mQueuedUs;
+
+        BufferInfoBase *mQueuePrev;
+        BufferInfoBase *mQueueNext;
+        bool mQueued;
 };
+
+// The deinterlacer walks the decoder's queues through these casts.
+#define SPRD_CHECK_BUFFER_INFO_FIELD(field) \
+    static_assert(offsetof(BufferInfoBase, field) \
+            == offsetof(SprdSimpleOMXComponent::BufferInfo, field), \
+            "BufferInfoBase::" #field " is out of step with SprdSimpleOMXComponent::BufferInfo")
+static_assert(sizeof(BufferInfoBase) == sizeof(SprdSimpleOMXComponent::BufferInfo),
+        "BufferInfoBase is out of step with SprdSimpleOMXComponent::BufferInfo");
+SPRD_CHECK_BUFFER_INFO_FIELD(mHeader);
+SPRD_CHECK_BUFFER_INFO_FIELD(mOwnedByUs);
+SPRD_CHECK_BUFFER_INFO_FIELD(DeintlWidth);
+SPRD_CHECK_BUFFER_INFO_FIELD(DeintlHeight);
+SPRD_CHECK_BUFFER_INFO_FIELD(mPicId);
+SPRD_CHECK_BUFFER_INFO_FIELD(mNodeId);
+SPRD_CHECK_BUFFER_INFO_FIELD(mQueuedUs);
+SPRD_CHECK_BUFFER_INFO_FIELD(mQueuePrev);
+SPRD_CHECK_BUFFER_INFO_FIELD(mQueueNext);
+SPRD_CHECK_BUFFER_INFO_FIELD(mQueued);
+#undef SPRD_CHECK_BUFFER_INFO_FIELD
+
 struct BufferInfo: public BufferInfoBase {   //for the intel deintelace function only
         OMX_BUFFERHEADERTYPE *mDecHeader;
 };
@@ -76,11 +105,14 @@ public:
     void stopDeinterlaceThread();
     int32 VspFreeIova(unsigned long iova, size_t size);
     int32 VspGetIova(int fd, unsigned long *iova, size_t *size);
+    // Drops the cached VPP mapping of a display buffer that is being freed.
+    void invalidateIova(int fd);
 
 private:
 
     bool mIOMMU_VPP_Enabled;
     int32_t  mIOMMU_VPP_ID;
+    SprdIovaCache *mIovaCache;
 
     pthread_t   mThread;                // Thread id for deinterlace
 
@@ -88,7 +120,7 @@ private:
     //void* mComponent;
     List<BufferInfoBase *>* mDecOutputBufQueue;
     List<BufferInfoBase *>* mDeinterInputBufQueue;
-    List<BufferInfoBase *>* mOutQueue;
+    SprdSimpleOMXComponent::PortQueue* mOutQueue;
     DeinterlaceInfo mDeinterlaceInfo;
 
     //BufferCtrlStruct * mDispBufferCtrl;
@@ -97,6 +129,8 @@ private:
 
     void deintlThreadFunc();
     static void * ThreadWrapper(void *me);
+    static int IovaCacheMapWrapper(void *cookie, int fd, unsigned long *iova, size_t *size);
+    static void IovaCacheUnmapWrapper(void *cookie, unsigned long iova, size_t size);
     int remapDispBuffer(OMX_BUFFERHEADERTYPE * header, unsigned long* phyAddr);
     int remapDeintlSrcBuffer(BufferInfoBase * itBuffer,  unsigned long* phyAddr);
     void unmapDeintlSrcBuffer(BufferInfoBase * itBuffer);
@@ -111,6 +111,13 @@ SPRDVPXDecoder::SPRDVPXDecoder(
     mDumpStrmEnabled = !strcmp(value_dump, "true");
     ALOGI("%s, mDumpYUVEnabled: %d, mDumpStrmEnabled: %d", __FUNCTION__, mDumpYUVEnabled, mDumpStrmEnabled);
 
+    property_get("vendor.vpxdec.async", value_dump, "false");
+    if (!strcmp(value_dump, "true")) {
+        startDecodeThread();
+    }
+
+    enableVspScheduling(SprdVspScheduler::kCoreDecoder);
+
     CHECK_EQ(initDecoder(), (status_t)OK);
 
     iUseAndroidNativeBuffer[OMX_DirInput] = OMX_FALSE;
@@ -591,20 +598,8 @@ OMX_ERRORTYPE SPRDVPXDecoder::internalUseBuffer(
         }
     }
 
-    PortInfo *port = editPortInfo(portIndex);
-
-    port->mBuffers.push();
-
-    BufferInfo *buffer =
-        &port->mBuffers.editItemAt(port->mBuffers.size() - 1);
     ALOGI("internalUseBuffer, header=%p, pBuffer=%p, size=%d",*header, ptr, size);
-    buffer->mHeader = *header;
-    buffer->mOwnedByUs = false;
-
-    if (port->mBuffers.size() == port->mDef.nBufferCountActual) {
-        port->mDef.bPopulated = OMX_TRUE;
-        checkTransitions();
-    }
+    addBuffer(portIndex, *header);
 
     return OMX_ErrorNone;
 }
@@ -637,6 +632,7 @@ OMX_ERRORTYPE SPRDVPXDecoder::allocateBuffer(
         fd = pMem->getHeapID();
         if(fd < 0) {
             ALOGE("Failed to alloc outport pmem buffer");
+            delete pMem;
             return OMX_ErrorInsufficientResources;
         }
 
@@ -644,11 +640,13 @@ OMX_ERRORTYPE SPRDVPXDecoder::allocateBuffer(
             ret = (*mVPXDecGetIOVA)(mHandle, fd, &phyAddr, &bufferSize);
             if(ret) {
                 ALOGE("MP4DecGetIOVA Failed: %d(%s)", ret, strerror(errno));
+                delete pMem;
                 return OMX_ErrorInsufficientResources;
             }
         } else {
             if(pMem->get_phy_addr_from_ion(&phyAddr, &bufferSize)) {
                 ALOGE("get_phy_addr_from_ion fail");
+                delete pMem;
                 return OMX_ErrorInsufficientResources;
             }
         }
@@ -715,8 +713,8 @@ void SPRDVPXDecoder::onQueueFilled(OMX_U32 portIndex) {
         return;
     }
 
-    List<BufferInfo *> &inQueue = getPortQueue(0);
-    List<BufferInfo *> &outQueue = getPortQueue(1);
+    PortQueue &inQueue = getPortQueue(0);
+    PortQueue &outQueue = getPortQueue(1);
 
     while ((mEOSStatus != INPUT_DATA_AVAILABLE || !inQueue.empty())
             && !outQueue.empty()) {
@@ -729,13 +727,13 @@ void SPRDVPXDecoder::onQueueFilled(OMX_U32 portIndex) {
         BufferInfo *inInfo = *inQueue.begin();
         OMX_BUFFERHEADERTYPE *inHeader = inInfo->mHeader;
 
-        List<BufferInfo *>::iterator itBuffer = outQueue.begin();
+        PortQueue::iterator itBuffer = outQueue.begin();
         OMX_BUFFERHEADERTYPE *outHeader = NULL;
         BufferCtrlStruct *pBufCtrl = NULL;
         size_t count = 0;
         do {
             if(count >= outQueue.size()) {
-                ALOGI("%s, %d, get outQueue buffer fail, return, count=%zd, queue_size=%d",__FUNCTION__, __LINE__, count, outQueue.size());
+                SPRD_FRAME_LOGI("%s, %d, get outQueue buffer fail, return, count=%zd, queue_size=%d",__FUNCTION__, __LINE__, count, outQueue.size());
                 return;
             }
 
@@ -752,7 +750,7 @@ void SPRDVPXDecoder::onQueueFilled(OMX_U32 portIndex) {
             count++;
         } while (pBufCtrl->iRefCount > 0);
 
-        ALOGI("%s, %d, outHeader:%p, inHeader: %p, len: %d, nOffset: %d, time: %lld, EOS: %d",
+        SPRD_FRAME_LOGI("%s, %d, outHeader:%p, inHeader: %p, len: %d, nOffset: %d, time: %lld, EOS: %d",
               __FUNCTION__, __LINE__,outHeader,inHeader, inHeader->nFilledLen,inHeader->nOffset, inHeader->nTimeStamp,inHeader->nFlags & OMX_BUFFERFLAG_EOS);
 
         mFrameDecoded = false;
@@ -780,6 +778,7 @@ void SPRDVPXDecoder::onQueueFilled(OMX_U32 portIndex) {
 
         if (mPbuf_stream_v != NULL) {
             memcpy(mPbuf_stream_v, bitstream, bufferSize);
+            mMetrics.count(SprdCodecMetrics::kCounterCopyBytes, bufferSize);
         }
         dec_in.pStream=  mPbuf_stream_v;
         dec_in.pStream_phy= mPbuf_stream_p;
@@ -845,10 +844,12 @@ void SPRDVPXDecoder::onQueueFilled(OMX_U32 portIndex) {
                 fwrite(mPbuf_stream_v, 1, dec_in.dataLen, mFile_bs);
             }
         }
-        int64_t start_decode = systemTime();
-        MMDecRet decRet = (*mVPXDecDecode)(mHandle, &dec_in,&dec_out);
-        int64_t end_decode = systemTime();
-        ALOGI("%s, %d, decRet: %d, %dms, dec_out.frameEffective: %d", __FUNCTION__, __LINE__, decRet, (unsigned int)((end_decode-start_decode) / 1000000L), dec_out.frameEffective);
+        MMDecRet decRet;
+        {
+            HardwareSection section(this);
+            decRet = (*mVPXDecDecode)(mHandle, &dec_in,&dec_out);
+        }
+        SPRD_FRAME_LOGI("%s, %d, decRet: %d, %dms, dec_out.frameEffective: %d", __FUNCTION__, __LINE__, decRet, (unsigned int)(mMetrics.lastUs(SprdCodecMetrics::kHistogramEngineTime) / 1000), dec_out.frameEffective);
 
         if(iUseAndroidNativeBuffer[OMX_DirOutput]) {
             if(mapper.unlock((const native_handle_t*)outHeader->pBuffer)) {
@@ -915,6 +916,7 @@ void SPRDVPXDecoder::onQueueFilled(OMX_U32 portIndex) {
             return;
         } else {
             ALOGE("failed to decode video frame.");
+            mMetrics.count(SprdCodecMetrics::kCounterErrors);
         }
 
         CHECK_LE(bufferSize, inHeader->nFilledLen);
@@ -936,7 +938,7 @@ void SPRDVPXDecoder::onQueueFilled(OMX_U32 portIndex) {
             outHeader->nOffset = 0;
             outHeader->nFilledLen = (mStride * mSliceHeight * 3) / 2;
             outHeader->nFlags = 0;
-            ALOGI("%s, %d, drainOneOutputBuffer, dec_out.pBufferHeader: %p, nTimeStamp: %lld", __FUNCTION__, __LINE__,
+            SPRD_FRAME_LOGI("%s, %d, drainOneOutputBuffer, dec_out.pBufferHeader: %p, nTimeStamp: %lld", __FUNCTION__, __LINE__,
                     outHeader, outHeader->nTimeStamp);
         if(mDumpYUVEnabled){
             if (mFile_yuv != NULL) {
@@ -947,14 +949,11 @@ void SPRDVPXDecoder::onQueueFilled(OMX_U32 portIndex) {
             continue;
         }
 
-        List<BufferInfo *>::iterator it = outQueue.begin();
-        while ((*it)->mHeader != outHeader) {
-            ++it;
-        }
+        BufferInfo *outInfo = findBufferInfo(kOutputPortIndex, outHeader);
+        CHECK(outInfo != NULL && outInfo->mQueued);
 
-        BufferInfo *outInfo = *it;
         outInfo->mOwnedByUs = false;
-        outQueue.erase(it);
+        outQueue.erase(outInfo);
         outInfo = NULL;
 
         BufferCtrlStruct* pOutBufCtrl= (BufferCtrlStruct*)(outHeader->pOutputPortPrivate);
@@ -968,7 +967,7 @@ void SPRDVPXDecoder::onQueueFilled(OMX_U32 portIndex) {
 bool SPRDVPXDecoder::drainAllOutputBuffers() {
     ALOGI("%s, %d", __FUNCTION__, __LINE__);
 
-    List<BufferInfo *> &outQueue = getPortQueue(1);
+    PortQueue &outQueue = getPortQueue(1);
     BufferInfo *outInfo;
     OMX_BUFFERHEADERTYPE *outHeader;
     void *pBufferHeader;
@@ -977,13 +976,9 @@ bool SPRDVPXDecoder::drainAllOutputBuffers() {
 
         if (mHeadersDecoded && (*mVPXDecGetLastDspFrm)(mHandle, &pBufferHeader) ) {
             ALOGI("%s, %d, VPXDecGetLastDspFrm, pBufferHeader: %p", __FUNCTION__, __LINE__, pBufferHeader);
-            List<BufferInfo *>::iterator it = outQueue.begin();
-            while ((*it)->mHeader != (OMX_BUFFERHEADERTYPE*)pBufferHeader && it != outQueue.end()) {
-                ++it;
-            }
-            CHECK((*it)->mHeader == (OMX_BUFFERHEADERTYPE*)pBufferHeader);
-            outInfo = *it;
-            outQueue.erase(it);
+            outInfo = findBufferInfo(kOutputPortIndex, (OMX_BUFFERHEADERTYPE*)pBufferHeader);
+            CHECK(outInfo != NULL && outInfo->mQueued);
+            outQueue.erase(outInfo);
             outHeader = outInfo->mHeader;
             outHeader->nFilledLen = (mStride * mSliceHeight * 3) / 2;
         } else {
@@ -1064,6 +1059,10 @@ OMX_ERRORTYPE SPRDVPXDecoder::getConfig(
         return OMX_ErrorNone;
     }
 
+    case OMX_IndexConfigCodecMetrics:
+    case OMX_IndexConfigCallbackBatching:
+        return SprdSimpleOMXComponent::getConfig(index, params);
+
     default:
         return OMX_ErrorUnsupportedIndex;
     }
@@ -1075,6 +1074,9 @@ OMX_ERRORTYPE SPRDVPXDecoder::setConfig(
     case OMX_IndexConfigDecSceneMode:
     {
         int *pDecSceneMode = (int *)params;
+        if (*pDecSceneMode == 3) { // VoLTE
+            setVspPriority(SprdVspScheduler::kPriorityRealtime);
+        }
 #ifdef CONFIG_AFBC_SUPPORT
         if(*pDecSceneMode == 4) {
             mUsage = GRALLOC_USAGE_CURSOR | GRALLOC_USAGE_SW_WRITE_NEVER;
@@ -1155,6 +1157,8 @@ OMX_ERRORTYPE SPRDVPXDecoder::getExtensionIndex(
         ALOGI("getExtensionIndex:%s",SPRD_INDEX_CONFIG_DEC_SCENE_MODE);
         *index = (OMX_INDEXTYPE) OMX_IndexConfigDecSceneMode;
         return OMX_ErrorNone;
+    } else if (!strcmp(name, SPRD_INDEX_CONFIG_CODEC_METRICS)) {
+        return SprdSimpleOMXComponent::getExtensionIndex(name, index);
     }
 
     return OMX_ErrorNotImplemented;
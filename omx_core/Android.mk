@@ -46,6 +46,36 @@ LOCAL_MODULE:= libsprd_omx_core
 LOCAL_PROPRIETARY_MODULE := true
 include $(BUILD_SHARED_LIBRARY)
 
+# Host build for the mock engines of omx-components/mock. It lists the
+# components of the newest platform, so every component that has a host
+# build can be loaded.
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=                     \
+        sprd_omx_core.cpp              \
+
+LOCAL_C_INCLUDES += \
+        $(LOCAL_PATH)/../libstagefrighthw/include         \
+        $(LOCAL_PATH)/../libstagefrighthw/include/openmax
+
+LOCAL_SHARED_LIBRARIES :=               \
+        libstagefright_foundation       \
+        libstagefrighthw                \
+        libmemion                       \
+        libcutils                       \
+        libutils                        \
+        liblog
+
+LOCAL_LDLIBS := -ldl -lpthread
+
+LOCAL_CFLAGS += -DPLATFORM_SHARKL5PRO
+
+LOCAL_MODULE:= libsprd_omx_core
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
 ################################################################################
 
 include $(call all-makefiles-under,$(LOCAL_PATH))
@@ -0,0 +1,57 @@
+LOCAL_PATH:= $(call my-dir)
+
+sprd_omx_bench_src_files :=           \
+        sprd_omx_bench.cpp             \
+        stream_reader.cpp
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= $(sprd_omx_bench_src_files)
+
+LOCAL_C_INCLUDES += \
+        vendor/sprd/modules/libmemion                        \
+        $(LOCAL_PATH)/../../libstagefrighthw/include         \
+        $(LOCAL_PATH)/../../libstagefrighthw/include/openmax
+
+LOCAL_SHARED_LIBRARIES :=               \
+        libsprd_omx_core                \
+        libstagefrighthw                \
+        libstagefright_foundation       \
+        libcutils                       \
+        libutils                        \
+        liblog
+
+LOCAL_MODULE := sprd_omx_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_PROPRIETARY_MODULE := true
+
+include $(BUILD_EXECUTABLE)
+
+# The host build runs the components on the engines of
+# omx-components/mock, e.g. from the top of the tree:
+#   LD_LIBRARY_PATH=$ANDROID_HOST_OUT/lib64 VSPMOCK_LATENCY_US=8000 \
+#       $ANDROID_HOST_OUT/bin/sprd_omx_bench -c OMX.sprd.h264.decoder -i in.264
+# SoftMJPG needs input buffers that hold a whole JPEG:
+#   LD_LIBRARY_PATH=$ANDROID_HOST_OUT/lib64 $ANDROID_HOST_OUT/bin/sprd_omx_bench \
+#       -c OMX.google.mjpg.decoder -i in.mjpeg --input-size 262144
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= $(sprd_omx_bench_src_files)
+
+LOCAL_C_INCLUDES += \
+        $(LOCAL_PATH)/../../libstagefrighthw/include         \
+        $(LOCAL_PATH)/../../libstagefrighthw/include/openmax
+
+LOCAL_SHARED_LIBRARIES :=               \
+        libsprd_omx_core                \
+        libstagefrighthw                \
+        libstagefright_foundation       \
+        libcutils                       \
+        libutils                        \
+        liblog
+
+LOCAL_MODULE := sprd_omx_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_MODULE_HOST_OS := linux
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,983 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+// Drives one component through sprd_omx_core outside the media framework
+// and reports its throughput: frames per second, per-frame latency from
+// EmptyThisBuffer to FillBufferDone, CPU time per frame and peak memory.
+// With the mock engine libraries on the library path it runs on a host.
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "sprd_omx_bench"
+#include <utils/Log.h>
+
+#include "stream_reader.h"
+#include "SprdCodecMetrics.h"
+
+#include <OMX_Audio.h>
+#include <OMX_Component.h>
+#include <OMX_Core.h>
+#include <OMX_Index.h>
+#include <OMX_Video.h>
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <utils/List.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+#include <utils/threads.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+namespace android {
+
+static const OMX_U32 kInputPort = 0;
+static const OMX_U32 kOutputPort = 1;
+
+struct BenchOptions {
+    BenchOptions()
+        : mComponent(NULL),
+          mInput(NULL),
+          mOutput(NULL),
+          mWidth(0),
+          mHeight(0),
+          mFrameRate(30),
+          mBitrate(0),
+          mChannels(0),
+          mSampleRate(0),
+          mInputBuffers(0),
+          mOutputBuffers(0),
+          mInputSize(0),
+          mOutputSize(0),
+          mChunkSize(0),
+          mUseBuffer(false),
+          mSemiPlanar(false),
+          mRepeat(1),
+          mMaxFrames(0),
+          mTimeoutSec(5) {
+    }
+
+    const char *mComponent;
+    const char *mInput;
+    const char *mOutput;
+    int32_t mWidth;
+    int32_t mHeight;
+    int32_t mFrameRate;
+    int32_t mBitrate;
+    int32_t mChannels;
+    int32_t mSampleRate;
+    int32_t mInputBuffers;      // 0: the component's count
+    int32_t mOutputBuffers;
+    size_t mInputSize;          // 0: the component's size
+    size_t mOutputSize;
+    size_t mChunkSize;          // raw input unit, 0: derived from the format
+    bool mUseBuffer;            // OMX_UseBuffer on client memory
+    bool mSemiPlanar;           // encoder input is NV12 rather than I420
+    int32_t mRepeat;
+    int64_t mMaxFrames;         // 0: the whole stream
+    int32_t mTimeoutSec;
+};
+
+template<class T>
+static void InitOMXParams(T *params) {
+    memset(params, 0, sizeof(T));
+    params->nSize = sizeof(T);
+    params->nVersion.s.nVersionMajor = 1;
+    params->nVersion.s.nVersionMinor = 0;
+    params->nVersion.s.nRevision = 0;
+    params->nVersion.s.nStep = 0;
+}
+
+static int64_t nowUs() {
+    return systemTime(SYSTEM_TIME_MONOTONIC) / 1000ll;
+}
+
+static int64_t cpuUs(const struct rusage &usage) {
+    return (int64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ll
+            + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static int compareInt64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+struct OMXBench {
+    explicit OMXBench(const BenchOptions &options);
+    ~OMXBench();
+
+    status_t run();
+
+private:
+    struct Buffer {
+        OMX_BUFFERHEADERTYPE *mHeader;
+        void *mData;                // our memory in UseBuffer mode
+        bool mOwnedByComponent;
+    };
+
+    struct Event {
+        OMX_EVENTTYPE mEvent;
+        OMX_U32 mData1;
+        OMX_U32 mData2;
+    };
+
+    struct Submission {
+        OMX_TICKS mTimeUs;
+        int64_t mSubmitUs;
+    };
+
+    const BenchOptions &mOptions;
+    OMX_HANDLETYPE mHandle;
+    bool mIsEncoder;
+    bool mIsVideo;
+    StreamReader mReader;
+    FILE *mOutputFile;
+
+    // Filled by the component's threads, drained by pump().
+    Mutex mLock;
+    Condition mCondition;
+    List<Event> mEvents;
+    List<OMX_BUFFERHEADERTYPE *> mEmptied;
+    List<OMX_BUFFERHEADERTYPE *> mFilled;
+
+    Vector<Buffer> mBuffers[2];
+    List<size_t> mFreeInputs;
+    List<size_t> mReturnedOutputs;
+    Vector<Event> mCompleted;
+    bool mPortSettingsChanged;
+    bool mInputDone;
+    bool mSentInputEOS;
+    bool mSawOutputEOS;
+    OMX_ERRORTYPE mError;
+
+    List<Submission> mSubmissions;
+    Vector<int64_t> mLatencies;
+    int64_t mInputFrames;
+    int64_t mOutputFrames;
+    int64_t mOutputBytes;
+    int64_t mFrameDurationUs;
+    int32_t mRepeatsLeft;
+
+    static OMX_ERRORTYPE OnEvent(
+            OMX_HANDLETYPE component, OMX_PTR appData, OMX_EVENTTYPE event,
+            OMX_U32 data1, OMX_U32 data2, OMX_PTR eventData);
+    static OMX_ERRORTYPE OnEmptyBufferDone(
+            OMX_HANDLETYPE component, OMX_PTR appData, OMX_BUFFERHEADERTYPE *header);
+    static OMX_ERRORTYPE OnFillBufferDone(
+            OMX_HANDLETYPE component, OMX_PTR appData, OMX_BUFFERHEADERTYPE *header);
+
+    static const OMX_CALLBACKTYPE kCallbacks;
+
+    status_t detectRole();
+    status_t configurePorts();
+    status_t getPortDefinition(OMX_U32 port, OMX_PARAM_PORTDEFINITIONTYPE *def);
+    void applyBufferOverrides(OMX_PARAM_PORTDEFINITIONTYPE *def);
+    status_t allocateBuffers(OMX_U32 port);
+    void freeBuffers(OMX_U32 port);
+    ssize_t findBuffer(OMX_U32 port, OMX_BUFFERHEADERTYPE *header) const;
+
+    bool pump(int64_t timeoutUs);
+    status_t waitForCommand(OMX_COMMANDTYPE command, OMX_U32 data);
+    status_t waitForBuffersReturned(OMX_U32 port);
+
+    void onOutput(OMX_BUFFERHEADERTYPE *header);
+    status_t fillInputs();
+    status_t submitOutputs();
+    status_t reconfigureOutput();
+    void teardown();
+
+    void printMetrics();
+    void printReport(int64_t wallUs, int64_t cpuUs, long maxRssKb);
+
+    DISALLOW_EVIL_CONSTRUCTORS(OMXBench);
+};
+
+const OMX_CALLBACKTYPE OMXBench::kCallbacks = {
+    OMXBench::OnEvent, OMXBench::OnEmptyBufferDone, OMXBench::OnFillBufferDone
+};
+
+OMXBench::OMXBench(const BenchOptions &options)
+    : mOptions(options),
+      mHandle(NULL),
+      mIsEncoder(false),
+      mIsVideo(false),
+      mOutputFile(NULL),
+      mPortSettingsChanged(false),
+      mInputDone(false),
+      mSentInputEOS(false),
+      mSawOutputEOS(false),
+      mError(OMX_ErrorNone),
+      mInputFrames(0),
+      mOutputFrames(0),
+      mOutputBytes(0),
+      mFrameDurationUs(0),
+      mRepeatsLeft(options.mRepeat) {
+}
+
+OMXBench::~OMXBench() {
+    if (mOutputFile != NULL) {
+        fclose(mOutputFile);
+    }
+}
+
+// static
+OMX_ERRORTYPE OMXBench::OnEvent(
+        OMX_HANDLETYPE, OMX_PTR appData, OMX_EVENTTYPE event,
+        OMX_U32 data1, OMX_U32 data2, OMX_PTR) {
+    OMXBench *me = static_cast<OMXBench *>(appData);
+    Event e;
+    e.mEvent = event;
+    e.mData1 = data1;
+    e.mData2 = data2;
+
+    Mutex::Autolock autoLock(me->mLock);
+    me->mEvents.push_back(e);
+    me->mCondition.signal();
+    return OMX_ErrorNone;
+}
+
+// static
+OMX_ERRORTYPE OMXBench::OnEmptyBufferDone(
+        OMX_HANDLETYPE, OMX_PTR appData, OMX_BUFFERHEADERTYPE *header) {
+    OMXBench *me = static_cast<OMXBench *>(appData);
+    Mutex::Autolock autoLock(me->mLock);
+    me->mEmptied.push_back(header);
+    me->mCondition.signal();
+    return OMX_ErrorNone;
+}
+
+// static
+OMX_ERRORTYPE OMXBench::OnFillBufferDone(
+        OMX_HANDLETYPE, OMX_PTR appData, OMX_BUFFERHEADERTYPE *header) {
+    OMXBench *me = static_cast<OMXBench *>(appData);
+    Mutex::Autolock autoLock(me->mLock);
+    me->mFilled.push_back(header);
+    me->mCondition.signal();
+    return OMX_ErrorNone;
+}
+
+status_t OMXBench::detectRole() {
+    OMX_U32 numRoles = 0;
+    if (OMX_GetRolesOfComponent((OMX_STRING)mOptions.mComponent, &numRoles, NULL)
+            != OMX_ErrorNone || numRoles == 0) {
+        fprintf(stderr, "unknown component %s\n", mOptions.mComponent);
+        return NAME_NOT_FOUND;
+    }
+
+    Vector<OMX_U8 *> roles;
+    for (OMX_U32 i = 0; i < numRoles; ++i) {
+        roles.push_back(new OMX_U8[OMX_MAX_STRINGNAME_SIZE]);
+    }
+    OMX_GetRolesOfComponent((OMX_STRING)mOptions.mComponent, &numRoles, roles.editArray());
+
+    const char *role = (const char *)roles[0];
+    mIsEncoder = strstr(role, "_encoder.") != NULL;
+    mIsVideo = !strncmp(role, "video_", 6);
+
+    size_t chunkSize = mOptions.mChunkSize;
+    if (chunkSize == 0) {
+        if (mIsEncoder && mIsVideo) {
+            chunkSize = mOptions.mWidth * mOptions.mHeight * 3 / 2;
+        } else if (mIsEncoder) {
+            // One MPEG audio frame of 16 bit samples.
+            chunkSize = 1152 * 2 * (mOptions.mChannels > 0 ? mOptions.mChannels : 2);
+        } else {
+            chunkSize = 4096;
+        }
+    }
+
+    StreamReader::Format format = StreamReader::formatForRole(role);
+    printf("component   %s (%s), input as %s\n",
+            mOptions.mComponent, role, StreamReader::formatName(format));
+
+    for (size_t i = 0; i < roles.size(); ++i) {
+        delete[] roles[i];
+    }
+
+    if (mIsEncoder && mIsVideo && (mOptions.mWidth <= 0 || mOptions.mHeight <= 0)) {
+        fprintf(stderr, "video encoders need --width and --height\n");
+        return BAD_VALUE;
+    }
+
+    mFrameDurationUs = mIsVideo ? 1000000ll / mOptions.mFrameRate : 1000;
+    return mReader.open(mOptions.mInput, format, chunkSize);
+}
+
+status_t OMXBench::getPortDefinition(OMX_U32 port, OMX_PARAM_PORTDEFINITIONTYPE *def) {
+    InitOMXParams(def);
+    def->nPortIndex = port;
+    OMX_ERRORTYPE err = OMX_GetParameter(mHandle, OMX_IndexParamPortDefinition, def);
+    if (err != OMX_ErrorNone) {
+        fprintf(stderr, "unable to get port %u definition: 0x%x\n", port, err);
+        return UNKNOWN_ERROR;
+    }
+    return OK;
+}
+
+void OMXBench::applyBufferOverrides(OMX_PARAM_PORTDEFINITIONTYPE *def) {
+    bool input = def->nPortIndex == kInputPort;
+    int32_t count = input ? mOptions.mInputBuffers : mOptions.mOutputBuffers;
+    size_t size = input ? mOptions.mInputSize : mOptions.mOutputSize;
+
+    if (count > 0) {
+        def->nBufferCountActual = (OMX_U32)count < def->nBufferCountMin
+                ? def->nBufferCountMin : count;
+    }
+    if (size > def->nBufferSize) {
+        def->nBufferSize = size;
+    }
+}
+
+status_t OMXBench::configurePorts() {
+    OMX_PARAM_PORTDEFINITIONTYPE def;
+
+    if (getPortDefinition(kInputPort, &def) != OK) {
+        return UNKNOWN_ERROR;
+    }
+    if (mIsVideo && mOptions.mWidth > 0 && mOptions.mHeight > 0) {
+        def.format.video.nFrameWidth = mOptions.mWidth;
+        def.format.video.nFrameHeight = mOptions.mHeight;
+        if (mIsEncoder) {
+            def.format.video.nStride = mOptions.mWidth;
+            def.format.video.nSliceHeight = mOptions.mHeight;
+            def.format.video.xFramerate = mOptions.mFrameRate << 16;
+            def.format.video.eColorFormat = mOptions.mSemiPlanar
+                    ? OMX_COLOR_FormatYUV420SemiPlanar : OMX_COLOR_FormatYUV420Planar;
+            def.nBufferSize = mOptions.mWidth * mOptions.mHeight * 3 / 2;
+        }
+    }
+    applyBufferOverrides(&def);
+    if (OMX_SetParameter(mHandle, OMX_IndexParamPortDefinition, &def) != OMX_ErrorNone) {
+        fprintf(stderr, "input port settings rejected\n");
+        return BAD_VALUE;
+    }
+
+    if (mIsEncoder && !mIsVideo && (mOptions.mChannels > 0 || mOptions.mSampleRate > 0)) {
+        OMX_AUDIO_PARAM_PCMMODETYPE pcm;
+        InitOMXParams(&pcm);
+        pcm.nPortIndex = kInputPort;
+        if (OMX_GetParameter(mHandle, OMX_IndexParamAudioPcm, &pcm) == OMX_ErrorNone) {
+            if (mOptions.mChannels > 0) {
+                pcm.nChannels = mOptions.mChannels;
+            }
+            if (mOptions.mSampleRate > 0) {
+                pcm.nSamplingRate = mOptions.mSampleRate;
+            }
+            if (OMX_SetParameter(mHandle, OMX_IndexParamAudioPcm, &pcm) != OMX_ErrorNone) {
+                fprintf(stderr, "PCM settings rejected\n");
+                return BAD_VALUE;
+            }
+        }
+    }
+
+    if (getPortDefinition(kOutputPort, &def) != OK) {
+        return UNKNOWN_ERROR;
+    }
+    if (mIsEncoder && mIsVideo) {
+        def.format.video.nFrameWidth = mOptions.mWidth;
+        def.format.video.nFrameHeight = mOptions.mHeight;
+        def.format.video.xFramerate = mOptions.mFrameRate << 16;
+        if (mOptions.mBitrate > 0) {
+            def.format.video.nBitrate = mOptions.mBitrate;
+        }
+    }
+    applyBufferOverrides(&def);
+    if (OMX_SetParameter(mHandle, OMX_IndexParamPortDefinition, &def) != OMX_ErrorNone) {
+        fprintf(stderr, "output port settings rejected\n");
+        return BAD_VALUE;
+    }
+
+    if (mIsEncoder && mIsVideo && mOptions.mBitrate > 0) {
+        OMX_VIDEO_PARAM_BITRATETYPE bitrate;
+        InitOMXParams(&bitrate);
+        bitrate.nPortIndex = kOutputPort;
+        bitrate.eControlRate = OMX_Video_ControlRateVariable;
+        bitrate.nTargetBitrate = mOptions.mBitrate;
+        if (OMX_SetParameter(mHandle, OMX_IndexParamVideoBitrate, &bitrate) != OMX_ErrorNone) {
+            ALOGW("OMX_IndexParamVideoBitrate not supported");
+        }
+    }
+    return OK;
+}
+
+status_t OMXBench::allocateBuffers(OMX_U32 port) {
+    OMX_PARAM_PORTDEFINITIONTYPE def;
+    if (getPortDefinition(port, &def) != OK) {
+        return UNKNOWN_ERROR;
+    }
+
+    for (OMX_U32 i = 0; i < def.nBufferCountActual; ++i) {
+        Buffer buffer;
+        buffer.mHeader = NULL;
+        buffer.mData = NULL;
+        buffer.mOwnedByComponent = false;
+
+        OMX_ERRORTYPE err;
+        if (mOptions.mUseBuffer) {
+            buffer.mData = malloc(def.nBufferSize);
+            if (buffer.mData == NULL) {
+                return NO_MEMORY;
+            }
+            err = OMX_UseBuffer(mHandle, &buffer.mHeader, port, this,
+                    def.nBufferSize, (OMX_U8 *)buffer.mData);
+        } else {
+            err = OMX_AllocateBuffer(mHandle, &buffer.mHeader, port, this, def.nBufferSize);
+        }
+        if (err != OMX_ErrorNone) {
+            fprintf(stderr, "unable to get buffer %u of port %u: 0x%x\n", i, port, err);
+            free(buffer.mData);
+            return NO_MEMORY;
+        }
+
+        if (port == kInputPort) {
+            mFreeInputs.push_back(mBuffers[port].size());
+        }
+        mBuffers[port].push_back(buffer);
+    }
+
+    printf("port %u      %u x %u bytes (%s)\n", port, def.nBufferCountActual,
+            def.nBufferSize, mOptions.mUseBuffer ? "useBuffer" : "allocateBuffer");
+    return OK;
+}
+
+void OMXBench::freeBuffers(OMX_U32 port) {
+    for (size_t i = 0; i < mBuffers[port].size(); ++i) {
+        Buffer *buffer = &mBuffers[port].editItemAt(i);
+        OMX_FreeBuffer(mHandle, port, buffer->mHeader);
+        free(buffer->mData);
+    }
+    mBuffers[port].clear();
+    if (port == kInputPort) {
+        mFreeInputs.clear();
+    } else {
+        mReturnedOutputs.clear();
+    }
+}
+
+ssize_t OMXBench::findBuffer(OMX_U32 port, OMX_BUFFERHEADERTYPE *header) const {
+    for (size_t i = 0; i < mBuffers[port].size(); ++i) {
+        if (mBuffers[port][i].mHeader == header) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Waits up to timeoutUs for callbacks and applies them; false if none came.
+bool OMXBench::pump(int64_t timeoutUs) {
+    List<Event> events;
+    List<OMX_BUFFERHEADERTYPE *> emptied;
+    List<OMX_BUFFERHEADERTYPE *> filled;
+
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (mEvents.empty() && mEmptied.empty() && mFilled.empty()) {
+            mCondition.waitRelative(mLock, timeoutUs * 1000ll);
+        }
+        events = mEvents;
+        emptied = mEmptied;
+        filled = mFilled;
+        mEvents.clear();
+        mEmptied.clear();
+        mFilled.clear();
+    }
+
+    for (List<Event>::iterator it = events.begin(); it != events.end(); ++it) {
+        switch (it->mEvent) {
+            case OMX_EventCmdComplete:
+                mCompleted.push_back(*it);
+                break;
+            case OMX_EventError:
+                fprintf(stderr, "component error 0x%x\n", it->mData1);
+                mError = (OMX_ERRORTYPE)it->mData1;
+                break;
+            case OMX_EventPortSettingsChanged:
+                if (it->mData1 == kOutputPort
+                        && (it->mData2 == 0 || it->mData2 == OMX_IndexParamPortDefinition)) {
+                    mPortSettingsChanged = true;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    for (List<OMX_BUFFERHEADERTYPE *>::iterator it = emptied.begin(); it != emptied.end(); ++it) {
+        ssize_t index = findBuffer(kInputPort, *it);
+        CHECK_GE(index, 0);
+        mBuffers[kInputPort].editItemAt(index).mOwnedByComponent = false;
+        mFreeInputs.push_back(index);
+    }
+
+    for (List<OMX_BUFFERHEADERTYPE *>::iterator it = filled.begin(); it != filled.end(); ++it) {
+        ssize_t index = findBuffer(kOutputPort, *it);
+        CHECK_GE(index, 0);
+        mBuffers[kOutputPort].editItemAt(index).mOwnedByComponent = false;
+        onOutput(*it);
+        mReturnedOutputs.push_back(index);
+    }
+
+    return !events.empty() || !emptied.empty() || !filled.empty();
+}
+
+status_t OMXBench::waitForCommand(OMX_COMMANDTYPE command, OMX_U32 data) {
+    int64_t deadlineUs = nowUs() + mOptions.mTimeoutSec * 1000000ll;
+    for (;;) {
+        for (size_t i = 0; i < mCompleted.size(); ++i) {
+            if (mCompleted[i].mData1 == (OMX_U32)command && mCompleted[i].mData2 == data) {
+                mCompleted.removeAt(i);
+                return OK;
+            }
+        }
+        if (mError != OMX_ErrorNone) {
+            return UNKNOWN_ERROR;
+        }
+        int64_t leftUs = deadlineUs - nowUs();
+        if (leftUs <= 0) {
+            fprintf(stderr, "timed out waiting for command %d(%u)\n", command, data);
+            return TIMED_OUT;
+        }
+        pump(leftUs);
+    }
+}
+
+status_t OMXBench::waitForBuffersReturned(OMX_U32 port) {
+    int64_t deadlineUs = nowUs() + mOptions.mTimeoutSec * 1000000ll;
+    for (;;) {
+        bool owned = false;
+        for (size_t i = 0; i < mBuffers[port].size() && !owned; ++i) {
+            owned = mBuffers[port][i].mOwnedByComponent;
+        }
+        if (!owned) {
+            return OK;
+        }
+        int64_t leftUs = deadlineUs - nowUs();
+        if (leftUs <= 0) {
+            fprintf(stderr, "timed out waiting for port %u buffers\n", port);
+            return TIMED_OUT;
+        }
+        pump(leftUs);
+    }
+}
+
+void OMXBench::onOutput(OMX_BUFFERHEADERTYPE *header) {
+    if (header->nFlags & OMX_BUFFERFLAG_EOS) {
+        mSawOutputEOS = true;
+    }
+    if (header->nFilledLen == 0 || (header->nFlags & OMX_BUFFERFLAG_CODECCONFIG)) {
+        return;
+    }
+
+    mOutputFrames++;
+    mOutputBytes += header->nFilledLen;
+
+    // Match the input by timestamp; codecs that make up their own output
+    // timestamps are matched in order.
+    List<Submission>::iterator match = mSubmissions.end();
+    for (List<Submission>::iterator it = mSubmissions.begin(); it != mSubmissions.end(); ++it) {
+        if (it->mTimeUs == header->nTimeStamp) {
+            match = it;
+            break;
+        }
+    }
+    if (match == mSubmissions.end() && !mSubmissions.empty()) {
+        match = mSubmissions.begin();
+    }
+    if (match != mSubmissions.end()) {
+        mLatencies.push_back(nowUs() - match->mSubmitUs);
+        mSubmissions.erase(match);
+    }
+
+    if (mOutputFile != NULL && header->pBuffer != NULL) {
+        fwrite(header->pBuffer + header->nOffset, 1, header->nFilledLen, mOutputFile);
+    }
+}
+
+status_t OMXBench::fillInputs() {
+    while (!mFreeInputs.empty() && !mSentInputEOS) {
+        size_t index = *mFreeInputs.begin();
+        OMX_BUFFERHEADERTYPE *header = mBuffers[kInputPort][index].mHeader;
+
+        const uint8_t *data = NULL;
+        size_t size = 0;
+        bool codecConfig = false;
+
+        if (!mInputDone && mOptions.mMaxFrames > 0 && mInputFrames >= mOptions.mMaxFrames) {
+            mInputDone = true;
+        }
+        while (!mInputDone && !mReader.next(&data, &size, &codecConfig)) {
+            if (--mRepeatsLeft > 0) {
+                mReader.rewind();
+            } else {
+                mInputDone = true;
+            }
+        }
+
+        header->nOffset = 0;
+        header->nFilledLen = 0;
+        header->nFlags = 0;
+        header->nTimeStamp = mInputFrames * mFrameDurationUs;
+
+        if (mInputDone) {
+            header->nFlags = OMX_BUFFERFLAG_EOS;
+            mSentInputEOS = true;
+        } else {
+            if (size > header->nAllocLen) {
+                fprintf(stderr, "input unit of %zu bytes exceeds the %u byte buffers, "
+                        "raise --input-size\n", size, header->nAllocLen);
+                return BAD_VALUE;
+            }
+            memcpy(header->pBuffer, data, size);
+            header->nFilledLen = size;
+            header->nFlags = OMX_BUFFERFLAG_ENDOFFRAME
+                    | (codecConfig ? OMX_BUFFERFLAG_CODECCONFIG : 0);
+
+            if (!codecConfig) {
+                Submission submission;
+                submission.mTimeUs = header->nTimeStamp;
+                submission.mSubmitUs = nowUs();
+                mSubmissions.push_back(submission);
+                mInputFrames++;
+            }
+        }
+
+        mFreeInputs.erase(mFreeInputs.begin());
+        mBuffers[kInputPort].editItemAt(index).mOwnedByComponent = true;
+        OMX_ERRORTYPE err = OMX_EmptyThisBuffer(mHandle, header);
+        if (err != OMX_ErrorNone) {
+            fprintf(stderr, "EmptyThisBuffer failed: 0x%x\n", err);
+            return UNKNOWN_ERROR;
+        }
+    }
+    return OK;
+}
+
+status_t OMXBench::submitOutputs() {
+    while (!mReturnedOutputs.empty()) {
+        size_t index = *mReturnedOutputs.begin();
+        mReturnedOutputs.erase(mReturnedOutputs.begin());
+
+        Buffer *buffer = &mBuffers[kOutputPort].editItemAt(index);
+        buffer->mHeader->nFilledLen = 0;
+        buffer->mHeader->nOffset = 0;
+        buffer->mHeader->nFlags = 0;
+        buffer->mOwnedByComponent = true;
+        OMX_ERRORTYPE err = OMX_FillThisBuffer(mHandle, buffer->mHeader);
+        if (err != OMX_ErrorNone) {
+            fprintf(stderr, "FillThisBuffer failed: 0x%x\n", err);
+            return UNKNOWN_ERROR;
+        }
+    }
+    return OK;
+}
+
+status_t OMXBench::reconfigureOutput() {
+    mPortSettingsChanged = false;
+
+    OMX_SendCommand(mHandle, OMX_CommandPortDisable, kOutputPort, NULL);
+    status_t err = waitForBuffersReturned(kOutputPort);
+    if (err != OK) {
+        return err;
+    }
+    freeBuffers(kOutputPort);
+    if ((err = waitForCommand(OMX_CommandPortDisable, kOutputPort)) != OK) {
+        return err;
+    }
+
+    OMX_PARAM_PORTDEFINITIONTYPE def;
+    if (getPortDefinition(kOutputPort, &def) != OK) {
+        return UNKNOWN_ERROR;
+    }
+    if (mIsVideo) {
+        printf("output      %ux%u, stride %d, slice height %u\n",
+                def.format.video.nFrameWidth, def.format.video.nFrameHeight,
+                def.format.video.nStride, def.format.video.nSliceHeight);
+    }
+    applyBufferOverrides(&def);
+    OMX_SetParameter(mHandle, OMX_IndexParamPortDefinition, &def);
+
+    OMX_SendCommand(mHandle, OMX_CommandPortEnable, kOutputPort, NULL);
+    if ((err = allocateBuffers(kOutputPort)) != OK) {
+        return err;
+    }
+    if ((err = waitForCommand(OMX_CommandPortEnable, kOutputPort)) != OK) {
+        return err;
+    }
+
+    for (size_t i = 0; i < mBuffers[kOutputPort].size(); ++i) {
+        mReturnedOutputs.push_back(i);
+    }
+    return submitOutputs();
+}
+
+void OMXBench::teardown() {
+    if (OMX_SendCommand(mHandle, OMX_CommandStateSet, OMX_StateIdle, NULL) == OMX_ErrorNone) {
+        waitForCommand(OMX_CommandStateSet, OMX_StateIdle);
+    }
+    waitForBuffersReturned(kInputPort);
+    waitForBuffersReturned(kOutputPort);
+
+    if (OMX_SendCommand(mHandle, OMX_CommandStateSet, OMX_StateLoaded, NULL) == OMX_ErrorNone) {
+        freeBuffers(kInputPort);
+        freeBuffers(kOutputPort);
+        waitForCommand(OMX_CommandStateSet, OMX_StateLoaded);
+    }
+}
+
+void OMXBench::printMetrics() {
+    OMX_INDEXTYPE index;
+    if (OMX_GetExtensionIndex(mHandle, (OMX_STRING)SPRD_INDEX_CONFIG_CODEC_METRICS, &index)
+            != OMX_ErrorNone) {
+        return;
+    }
+
+    SprdCodecMetricsParams metrics;
+    InitOMXParams(&metrics);
+    if (OMX_GetConfig(mHandle, index, &metrics) != OMX_ErrorNone) {
+        return;
+    }
+
+    static const char *kHistograms[SprdCodecMetrics::kNumHistograms] = {
+        "engine", "engine wait", "queue wait"
+    };
+    for (int i = 0; i < SprdCodecMetrics::kNumHistograms; ++i) {
+        if (metrics.nSamples[i] == 0) {
+            continue;
+        }
+        printf("%-11s avg %lld, p50 %lld, p95 %lld, max %lld us (%lld samples)\n",
+                kHistograms[i], (long long)metrics.nAvgUs[i], (long long)metrics.nP50Us[i],
+                (long long)metrics.nP95Us[i], (long long)metrics.nMaxUs[i],
+                (long long)metrics.nSamples[i]);
+    }
+    printf("copies      %lld bytes, %lld iova maps, %lld errors\n",
+            (long long)metrics.nCounters[SprdCodecMetrics::kCounterCopyBytes],
+            (long long)metrics.nCounters[SprdCodecMetrics::kCounterIovaMaps],
+            (long long)metrics.nCounters[SprdCodecMetrics::kCounterErrors]);
+}
+
+void OMXBench::printReport(int64_t wallUs, int64_t cpuTimeUs, long maxRssKb) {
+    printf("frames      in %lld, out %lld, %lld bytes out\n",
+            (long long)mInputFrames, (long long)mOutputFrames, (long long)mOutputBytes);
+    printf("wall        %.3f s, %.2f fps\n", wallUs / 1E6,
+            wallUs > 0 ? mOutputFrames * 1E6 / wallUs : 0.0);
+    if (mOutputFrames > 0) {
+        printf("cpu         %.3f ms/frame\n", cpuTimeUs / 1E3 / mOutputFrames);
+    }
+
+    size_t count = mLatencies.size();
+    if (count > 0) {
+        int64_t *sorted = mLatencies.editArray();
+        qsort(sorted, count, sizeof(int64_t), compareInt64);
+        printf("latency     p50 %lld, p90 %lld, p99 %lld, max %lld us\n",
+                (long long)sorted[count * 50 / 100], (long long)sorted[count * 90 / 100],
+                (long long)sorted[count * 99 / 100], (long long)sorted[count - 1]);
+    }
+    printf("peak rss    %ld KB\n", maxRssKb);
+}
+
+status_t OMXBench::run() {
+    if (OMX_Init() != OMX_ErrorNone) {
+        fprintf(stderr, "OMX_Init failed\n");
+        return UNKNOWN_ERROR;
+    }
+
+    status_t err = detectRole();
+    if (err != OK) {
+        OMX_Deinit();
+        return err;
+    }
+
+    OMX_ERRORTYPE omxErr = OMX_GetHandle(&mHandle, (OMX_STRING)mOptions.mComponent,
+            this, const_cast<OMX_CALLBACKTYPE *>(&kCallbacks));
+    if (omxErr != OMX_ErrorNone) {
+        fprintf(stderr, "OMX_GetHandle(%s) failed: 0x%x\n", mOptions.mComponent, omxErr);
+        OMX_Deinit();
+        return UNKNOWN_ERROR;
+    }
+
+    if (mOptions.mOutput != NULL) {
+        mOutputFile = fopen(mOptions.mOutput, "wb");
+        if (mOutputFile == NULL) {
+            fprintf(stderr, "unable to create %s\n", mOptions.mOutput);
+        }
+    }
+
+    if ((err = configurePorts()) != OK) {
+        OMX_FreeHandle(mHandle);
+        OMX_Deinit();
+        return err;
+    }
+
+    OMX_SendCommand(mHandle, OMX_CommandStateSet, OMX_StateIdle, NULL);
+    if ((err = allocateBuffers(kInputPort)) == OK
+            && (err = allocateBuffers(kOutputPort)) == OK
+            && (err = waitForCommand(OMX_CommandStateSet, OMX_StateIdle)) == OK) {
+        OMX_SendCommand(mHandle, OMX_CommandStateSet, OMX_StateExecuting, NULL);
+        err = waitForCommand(OMX_CommandStateSet, OMX_StateExecuting);
+    }
+
+    struct rusage startUsage, endUsage;
+    getrusage(RUSAGE_SELF, &startUsage);
+    int64_t startUs = nowUs();
+    int64_t lastProgressUs = startUs;
+
+    if (err == OK) {
+        for (size_t i = 0; i < mBuffers[kOutputPort].size(); ++i) {
+            mReturnedOutputs.push_back(i);
+        }
+    }
+
+    while (err == OK && !mSawOutputEOS) {
+        if (mError != OMX_ErrorNone) {
+            err = UNKNOWN_ERROR;
+            break;
+        }
+        if (mPortSettingsChanged) {
+            err = reconfigureOutput();
+            continue;
+        }
+        if ((err = submitOutputs()) != OK || (err = fillInputs()) != OK) {
+            break;
+        }
+
+        if (pump(100000ll)) {
+            lastProgressUs = nowUs();
+        } else if (nowUs() - lastProgressUs > mOptions.mTimeoutSec * 1000000ll) {
+            fprintf(stderr, "no progress for %d s, %lld frames in, %lld out\n",
+                    mOptions.mTimeoutSec, (long long)mInputFrames, (long long)mOutputFrames);
+            err = TIMED_OUT;
+        }
+    }
+
+    int64_t wallUs = nowUs() - startUs;
+    getrusage(RUSAGE_SELF, &endUsage);
+
+    printMetrics();
+    teardown();
+    OMX_FreeHandle(mHandle);
+    mHandle = NULL;
+    OMX_Deinit();
+
+    printReport(wallUs, cpuUs(endUsage) - cpuUs(startUsage), endUsage.ru_maxrss);
+    return err;
+}
+
+}  // namespace android
+
+using namespace android;
+
+static void usage(const char *me) {
+    fprintf(stderr,
+            "usage: %s -c <component> -i <input> [options]\n"
+            "  -c, --component NAME      e.g. OMX.sprd.h264.decoder\n"
+            "  -i, --input FILE          elementary stream, IVF, or raw YUV/PCM\n"
+            "  -o, --output FILE         write the output buffers\n"
+            "  -w, --width N, -t, --height N\n"
+            "  -f, --fps N               input frame rate (default 30)\n"
+            "  -b, --bitrate N           encoder bitrate in bit/s\n"
+            "      --channels N, --sample-rate N   PCM input of audio encoders\n"
+            "      --input-buffers N, --output-buffers N\n"
+            "      --input-size N, --output-size N  buffer sizes in bytes\n"
+            "      --chunk-size N        unit of raw input files\n"
+            "      --use-buffer          OMX_UseBuffer instead of OMX_AllocateBuffer\n"
+            "      --nv12                encoder input is NV12 rather than I420\n"
+            "  -r, --repeat N            play the input N times\n"
+            "  -n, --frames N            stop after N input frames\n"
+            "      --timeout S           give up after S seconds without progress\n",
+            me);
+}
+
+int main(int argc, char **argv) {
+    enum {
+        kOptChannels = 256,
+        kOptSampleRate,
+        kOptInputBuffers,
+        kOptOutputBuffers,
+        kOptInputSize,
+        kOptOutputSize,
+        kOptChunkSize,
+        kOptUseBuffer,
+        kOptNv12,
+        kOptTimeout,
+        kOptHelp,
+    };
+
+    static const struct option kOptions[] = {
+        { "component", required_argument, NULL, 'c' },
+        { "input", required_argument, NULL, 'i' },
+        { "output", required_argument, NULL, 'o' },
+        { "width", required_argument, NULL, 'w' },
+        { "height", required_argument, NULL, 't' },
+        { "fps", required_argument, NULL, 'f' },
+        { "bitrate", required_argument, NULL, 'b' },
+        { "repeat", required_argument, NULL, 'r' },
+        { "frames", required_argument, NULL, 'n' },
+        { "channels", required_argument, NULL, kOptChannels },
+        { "sample-rate", required_argument, NULL, kOptSampleRate },
+        { "input-buffers", required_argument, NULL, kOptInputBuffers },
+        { "output-buffers", required_argument, NULL, kOptOutputBuffers },
+        { "input-size", required_argument, NULL, kOptInputSize },
+        { "output-size", required_argument, NULL, kOptOutputSize },
+        { "chunk-size", required_argument, NULL, kOptChunkSize },
+        { "use-buffer", no_argument, NULL, kOptUseBuffer },
+        { "nv12", no_argument, NULL, kOptNv12 },
+        { "timeout", required_argument, NULL, kOptTimeout },
+        { "help", no_argument, NULL, kOptHelp },
+        { NULL, 0, NULL, 0 },
+    };
+
+    BenchOptions options;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "c:i:o:w:t:f:b:r:n:", kOptions, NULL)) != -1) {
+        switch (opt) {
+            case 'c': options.mComponent = optarg; break;
+            case 'i': options.mInput = optarg; break;
+            case 'o': options.mOutput = optarg; break;
+            case 'w': options.mWidth = atoi(optarg); break;
+            case 't': options.mHeight = atoi(optarg); break;
+            case 'f': options.mFrameRate = atoi(optarg); break;
+            case 'b': options.mBitrate = atoi(optarg); break;
+            case 'r': options.mRepeat = atoi(optarg); break;
+            case 'n': options.mMaxFrames = atoll(optarg); break;
+            case kOptChannels: options.mChannels = atoi(optarg); break;
+            case kOptSampleRate: options.mSampleRate = atoi(optarg); break;
+            case kOptInputBuffers: options.mInputBuffers = atoi(optarg); break;
+            case kOptOutputBuffers: options.mOutputBuffers = atoi(optarg); break;
+            case kOptInputSize: options.mInputSize = strtoul(optarg, NULL, 0); break;
+            case kOptOutputSize: options.mOutputSize = strtoul(optarg, NULL, 0); break;
+            case kOptChunkSize: options.mChunkSize = strtoul(optarg, NULL, 0); break;
+            case kOptUseBuffer: options.mUseBuffer = true; break;
+            case kOptNv12: options.mSemiPlanar = true; break;
+            case kOptTimeout: options.mTimeoutSec = atoi(optarg); break;
+            default:
+                usage(argv[0]);
+                return opt == kOptHelp ? 0 : 1;
+        }
+    }
+
+    if (options.mComponent == NULL || options.mInput == NULL
+            || options.mFrameRate <= 0 || options.mRepeat <= 0 || options.mTimeoutSec <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    OMXBench bench(options);
+    return bench.run() == OK ? 0 : 1;
+}
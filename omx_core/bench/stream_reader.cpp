@@ -0,0 +1,410 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "StreamReader"
+#include <utils/Log.h>
+
+#include "stream_reader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace android {
+
+// Offset of the next 00 00 01 at or after offset, extended to a preceding
+// zero byte for four byte start codes; size if there is none.
+static size_t findStartCode(const uint8_t *data, size_t size, size_t offset) {
+    for (size_t i = offset; i + 3 <= size; ++i) {
+        if (data[i + 2] > 1) {
+            i += 2;
+        } else if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+            return (i > offset && data[i - 1] == 0) ? i - 1 : i;
+        }
+    }
+    return size;
+}
+
+// Offset of the NAL header behind the start code at offset.
+static size_t skipStartCode(const uint8_t *data, size_t size, size_t offset) {
+    while (offset < size && data[offset] == 0) {
+        ++offset;
+    }
+    return offset < size ? offset + 1 : size;
+}
+
+// static
+StreamReader::Format StreamReader::formatForRole(const char *role) {
+    static const struct {
+        const char *mRole;
+        Format mFormat;
+    } kRoles[] = {
+        { "video_decoder.avc", kFormatAvc },
+        { "video_decoder.hevc", kFormatHevc },
+        { "video_decoder.mpeg4", kFormatMpeg4 },
+        { "video_decoder.h263", kFormatH263 },
+        { "video_decoder.vp8", kFormatIvf },
+        { "video_decoder.vp9", kFormatIvf },
+        { "video_decoder.av1", kFormatIvf },
+        { "video_decoder.mjpg", kFormatJpeg },
+        { "audio_decoder.mp3", kFormatMp3 },
+        { "audio_decoder.mp1", kFormatMp3 },
+        { "audio_decoder.mp2", kFormatMp3 },
+    };
+
+    for (size_t i = 0; i < sizeof(kRoles) / sizeof(kRoles[0]); ++i) {
+        if (!strcmp(role, kRoles[i].mRole)) {
+            return kRoles[i].mFormat;
+        }
+    }
+    return kFormatChunk;
+}
+
+// static
+const char *StreamReader::formatName(Format format) {
+    switch (format) {
+        case kFormatAvc:   return "h264";
+        case kFormatHevc:  return "h265";
+        case kFormatMpeg4: return "mpeg4";
+        case kFormatH263:  return "h263";
+        case kFormatIvf:   return "ivf";
+        case kFormatMp3:   return "mp3";
+        case kFormatJpeg:  return "mjpeg";
+        default:           return "chunks";
+    }
+}
+
+StreamReader::StreamReader()
+    : mFormat(kFormatChunk),
+      mChunkSize(0),
+      mData(NULL),
+      mSize(0),
+      mStart(0),
+      mOffset(0),
+      mSawPicture(false) {
+}
+
+StreamReader::~StreamReader() {
+    if (mData != NULL) {
+        munmap(mData, mSize);
+    }
+}
+
+status_t StreamReader::open(const char *path, Format format, size_t chunkSize) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        ALOGE("unable to open %s: %s", path, strerror(errno));
+        return -errno;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ALOGE("%s is empty or unreadable", path);
+        close(fd);
+        return BAD_VALUE;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        ALOGE("unable to map %s: %s", path, strerror(errno));
+        return NO_MEMORY;
+    }
+
+    mFormat = format;
+    mChunkSize = chunkSize;
+    mData = (uint8_t *)data;
+    mSize = st.st_size;
+    mStart = 0;
+
+    if (format == kFormatChunk && chunkSize == 0) {
+        return BAD_VALUE;
+    }
+
+    if (format == kFormatIvf) {
+        if (mSize < 32 || memcmp(mData, "DKIF", 4)) {
+            ALOGE("%s is not an IVF file", path);
+            return BAD_VALUE;
+        }
+        mStart = mData[6] | (mData[7] << 8);
+    } else if (format == kFormatMp3 && mSize >= 10 && !memcmp(mData, "ID3", 3)) {
+        mStart = 10 + ((mData[6] & 0x7f) << 21 | (mData[7] & 0x7f) << 14
+                | (mData[8] & 0x7f) << 7 | (mData[9] & 0x7f));
+    }
+
+    rewind();
+    return OK;
+}
+
+void StreamReader::rewind() {
+    mOffset = mStart;
+    mSawPicture = false;
+}
+
+bool StreamReader::next(const uint8_t **data, size_t *size, bool *codecConfig) {
+    *codecConfig = false;
+    if (mOffset >= mSize) {
+        return false;
+    }
+
+    if (mFormat == kFormatIvf) {
+        return nextIvf(data, size);
+    }
+
+    size_t end;
+    switch (mFormat) {
+        case kFormatAvc:
+        case kFormatHevc:
+            end = nextAnnexB(codecConfig);
+            break;
+        case kFormatMpeg4:
+            end = nextMpeg4(codecConfig);
+            break;
+        case kFormatH263:
+            end = nextH263();
+            break;
+        case kFormatMp3:
+            end = nextMp3();
+            break;
+        case kFormatJpeg:
+            end = nextJpeg();
+            break;
+        default:
+            end = mOffset + mChunkSize;
+            if (end > mSize) {
+                // A partial raw frame is of no use to an encoder.
+                mOffset = mSize;
+                return false;
+            }
+            break;
+    }
+
+    if (end <= mOffset) {
+        return false;
+    }
+
+    *data = mData + mOffset;
+    *size = end - mOffset;
+    mOffset = end;
+    return true;
+}
+
+// An access unit ends before the first slice of the next picture or the
+// parameter sets, SEI or delimiter that lead it.
+size_t StreamReader::nextAnnexB(bool *codecConfig) {
+    bool hevc = mFormat == kFormatHevc;
+    bool sawVcl = false;
+    bool sawParams = false;
+
+    size_t sc = findStartCode(mData, mSize, mOffset);
+    while (sc < mSize) {
+        size_t nal = skipStartCode(mData, mSize, sc);
+        if (nal + (hevc ? 2 : 1) >= mSize) {
+            break;
+        }
+
+        bool vcl, firstSlice, leader;
+        if (hevc) {
+            int type = (mData[nal] >> 1) & 0x3f;
+            vcl = type < 32;
+            firstSlice = vcl && (mData[nal + 2] & 0x80);
+            leader = type >= 32 && type <= 39;
+        } else {
+            int type = mData[nal] & 0x1f;
+            vcl = type >= 1 && type <= 5;
+            firstSlice = vcl && (mData[nal + 1] & 0x80);
+            leader = type >= 6 && type <= 9;
+        }
+
+        if (sawVcl && (firstSlice || leader)) {
+            return sc;
+        }
+        if (vcl && !mSawPicture && sawParams) {
+            // Parameter sets at the head of the stream go in a buffer of
+            // their own, as the framework passes csd-0/csd-1.
+            *codecConfig = true;
+            return sc;
+        }
+
+        sawVcl = sawVcl || vcl;
+        sawParams = sawParams || leader;
+        if (vcl) {
+            mSawPicture = true;
+        }
+        sc = findStartCode(mData, mSize, nal);
+    }
+    return mSize;
+}
+
+// A unit ends before the start code that follows a VOP, or before the
+// first VOP if only headers precede it.
+size_t StreamReader::nextMpeg4(bool *codecConfig) {
+    bool sawVop = false;
+    bool sawHeaders = false;
+
+    size_t sc = findStartCode(mData, mSize, mOffset);
+    while (sc < mSize) {
+        size_t code = skipStartCode(mData, mSize, sc);
+        if (code >= mSize) {
+            break;
+        }
+
+        bool vop = mData[code] == 0xb6;
+        if (sawVop) {
+            return sc;
+        }
+        if (vop && !mSawPicture && sawHeaders) {
+            *codecConfig = true;
+            return sc;
+        }
+
+        sawVop = vop;
+        sawHeaders = sawHeaders || !vop;
+        mSawPicture = mSawPicture || vop;
+        sc = findStartCode(mData, mSize, code);
+    }
+    return mSize;
+}
+
+// Pictures start with the 22 bit picture start code 0000 0000 0000 0000
+// 1000 00.
+size_t StreamReader::nextH263() {
+    for (size_t i = mOffset + 3; i + 3 <= mSize; ++i) {
+        if (mData[i] == 0 && mData[i + 1] == 0 && (mData[i + 2] & 0xfc) == 0x80) {
+            return i;
+        }
+    }
+    return mSize;
+}
+
+// Length of the MPEG audio frame whose header is at p, 0 if there is no
+// valid header.
+static size_t mp3FrameLength(const uint8_t *p) {
+    static const int kBitrateV1[3][16] = {
+        { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0 },
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 0 },
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 },
+    };
+    static const int kBitrateV2[3][16] = {
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, 0 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 },
+    };
+    static const int kSampleRate[3] = { 44100, 48000, 32000 };
+
+    if (p[0] != 0xff || (p[1] & 0xe0) != 0xe0) {
+        return 0;
+    }
+
+    int version = (p[1] >> 3) & 3;    // 0: 2.5, 2: 2, 3: 1
+    int layer = 4 - ((p[1] >> 1) & 3);
+    int bitrateIndex = p[2] >> 4;
+    int rateIndex = (p[2] >> 2) & 3;
+    int padding = (p[2] >> 1) & 1;
+    if (version == 1 || layer == 4 || rateIndex == 3) {
+        return 0;
+    }
+
+    int bitrate = (version == 3 ? kBitrateV1 : kBitrateV2)[layer - 1][bitrateIndex] * 1000;
+    int sampleRate = kSampleRate[rateIndex] >> (version == 3 ? 0 : version == 2 ? 1 : 2);
+    if (bitrate == 0) {
+        return 0;
+    }
+
+    if (layer == 1) {
+        return (12 * bitrate / sampleRate + padding) * 4;
+    }
+    int coefficient = (layer == 3 && version != 3) ? 72 : 144;
+    return coefficient * bitrate / sampleRate + padding;
+}
+
+size_t StreamReader::nextMp3() {
+    // Resynchronise over garbage between frames.
+    while (mOffset + 4 <= mSize && mp3FrameLength(mData + mOffset) == 0) {
+        ++mOffset;
+    }
+    if (mOffset + 4 > mSize) {
+        return mOffset;
+    }
+
+    size_t end = mOffset + mp3FrameLength(mData + mOffset);
+    return end > mSize ? mSize : end;
+}
+
+// Walks the marker segments so that an EOI inside an EXIF thumbnail does
+// not end the picture; entropy coded data only has stuffed 0xff bytes.
+size_t StreamReader::nextJpeg() {
+    size_t i = mOffset;
+    while (i + 1 < mSize && !(mData[i] == 0xff && mData[i + 1] == 0xd8)) {
+        ++i;
+    }
+    mOffset = i;
+    i += 2;
+
+    while (i + 4 <= mSize) {
+        if (mData[i] != 0xff) {
+            ++i;
+            continue;
+        }
+
+        uint8_t marker = mData[i + 1];
+        if (marker == 0xd9) {
+            return i + 2;
+        } else if (marker == 0xff || (marker >= 0xd0 && marker <= 0xd7) || marker == 0x00) {
+            i += marker == 0xff ? 1 : 2;
+            continue;
+        }
+
+        size_t length = (mData[i + 2] << 8) | mData[i + 3];
+        i += 2 + length;
+        if (marker == 0xda) {
+            // Scan data runs up to the next marker that is neither
+            // stuffing nor a restart marker.
+            while (i + 1 < mSize && !(mData[i] == 0xff && mData[i + 1] != 0x00
+                    && !(mData[i + 1] >= 0xd0 && mData[i + 1] <= 0xd7))) {
+                ++i;
+            }
+        }
+    }
+    return mSize;
+}
+
+bool StreamReader::nextIvf(const uint8_t **data, size_t *size) {
+    if (mOffset + 12 > mSize) {
+        mOffset = mSize;
+        return false;
+    }
+
+    const uint8_t *p = mData + mOffset;
+    size_t frameSize = p[0] | (p[1] << 8) | (p[2] << 16) | ((size_t)p[3] << 24);
+    if (mOffset + 12 + frameSize > mSize) {
+        ALOGW("truncated IVF frame at %zu", mOffset);
+        mOffset = mSize;
+        return false;
+    }
+
+    *data = p + 12;
+    *size = frameSize;
+    mOffset += 12 + frameSize;
+    return true;
+}
+
+}  // namespace android
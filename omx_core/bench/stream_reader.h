@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2011 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+
+#ifndef STREAM_READER_H_
+
+#define STREAM_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+// Splits an input file into the access units a component expects in one
+// input buffer. The whole file is mapped up front so that file I/O stays
+// out of the measurements.
+struct StreamReader {
+    enum Format {
+        kFormatChunk,       // fixed size chunks: raw YUV/PCM, ADPCM blocks
+        kFormatAvc,         // H.264 Annex B
+        kFormatHevc,        // H.265 Annex B
+        kFormatMpeg4,       // MPEG-4 part 2 elementary stream
+        kFormatH263,        // H.263 elementary stream
+        kFormatIvf,         // VP8/VP9/AV1 in IVF
+        kFormatMp3,         // MPEG audio frames, ID3v2 tag skipped
+        kFormatJpeg,        // concatenated JPEG pictures (MJPEG)
+    };
+
+    // The format for an OMX role such as "video_decoder.avc"; encoders
+    // read raw chunks.
+    static Format formatForRole(const char *role);
+    static const char *formatName(Format format);
+
+    StreamReader();
+    ~StreamReader();
+
+    // chunkSize is the unit of kFormatChunk and ignored otherwise.
+    status_t open(const char *path, Format format, size_t chunkSize);
+
+    // The next access unit; false at the end of the stream. codecConfig is
+    // set for parameter sets that precede the first picture.
+    bool next(const uint8_t **data, size_t *size, bool *codecConfig);
+
+    void rewind();
+
+private:
+    Format mFormat;
+    size_t mChunkSize;
+    uint8_t *mData;
+    size_t mSize;
+    size_t mStart;      // first byte of the stream proper
+    size_t mOffset;
+    bool mSawPicture;
+
+    size_t nextAnnexB(bool *codecConfig);
+    size_t nextMpeg4(bool *codecConfig);
+    size_t nextH263();
+    size_t nextMp3();
+    size_t nextJpeg();
+    bool nextIvf(const uint8_t **data, size_t *size);
+
+    DISALLOW_EVIL_CONSTRUCTORS(StreamReader);
+};
+
+}  // namespace android
+
+#endif  // STREAM_READER_H_
@@ -25,6 +25,9 @@
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/foundation/ABase.h>
+#include <utils/KeyedVector.h>
+#include <utils/String8.h>
+#include <cutils/properties.h>
 #include <pthread.h>
 #include <dlfcn.h>
 
@@ -33,6 +36,10 @@ using namespace android;
 // created components array
 static OMXCore* g_OMX_Core = NULL;
 static bool g_bInitialized = false;
+// Libraries still backing live handles when the core was torn down. They
+// are taken back by the next OMX_Init, or closed once their last handle
+// is freed.
+static Vector<OMXLibraryEntry> g_DetachedLibraries;
 // mfx OMX IL Core thread safety
 static pthread_mutex_t g_OMXCoreLock = PTHREAD_MUTEX_INITIALIZER;
 
@@ -52,33 +59,41 @@ static pthread_mutex_t g_OMXCoreLock = PTHREAD_MUTEX_INITIALIZER;
 #define SPRD_OMX_LOG_D(msg,value) ALOGV("%s: %s = %d"   ,__FUNCTION__, msg, value)
 #define SPRD_OMX_LOG_S(msg,value) ALOGV("%s: %s = %s"   ,__FUNCTION__, msg, value)
 
+// Roles beyond the first are only listed for components whose
+// OMX_IndexParamStandardComponentRole handling accepts them. For a given
+// role, components that list it first come ahead of those that list it
+// as an extra one, so adding a role never changes which component the
+// framework picks first.
+#define SPRD_OMX_MAX_COMPONENT_ROLES 3
+
 static const struct {
     const char *mName;
     const char *mLibNameSuffix;
-    const char *mRole;
+    const char *mRoles[SPRD_OMX_MAX_COMPONENT_ROLES];
 
 } kComponents[] = {
-    { "OMX.sprd.h263.decoder", "sprd_mpeg4dec", "video_decoder.h263" },
-    { "OMX.sprd.mpeg4.decoder", "sprd_mpeg4dec", "video_decoder.mpeg4" },
-    { "OMX.sprd.h264.decoder", "sprd_h264dec", "video_decoder.avc" },
-    { "OMX.sprd.mp3.decoder", "sprd_mp3dec", "audio_decoder.mp3" },
-    { "OMX.sprd.mp3l1.decoder", "sprd_mp3dec", "audio_decoder.mp1" },
-    { "OMX.sprd.mp3l2.decoder", "sprd_mp3dec", "audio_decoder.mp2" },
-    { "OMX.sprd.mp3.encoder", "sprd_mp3enc", "audio_encoder.mp3" },
-    { "OMX.sprd.h264.encoder", "sprd_h264enc", "video_encoder.avc" },
-    { "OMX.google.mjpg.decoder", "soft_mjpgdec", "video_decoder.mjpg" },
-    { "OMX.google.imaadpcm.decoder", "soft_imaadpcmdec", "audio_decoder.imaadpcm" },
+    { "OMX.sprd.h263.decoder", "sprd_mpeg4dec", { "video_decoder.h263" } },
+    { "OMX.sprd.mpeg4.decoder", "sprd_mpeg4dec", { "video_decoder.mpeg4" } },
+    { "OMX.sprd.h264.decoder", "sprd_h264dec", { "video_decoder.avc" } },
+    { "OMX.sprd.mp3.decoder", "sprd_mp3dec",
+        { "audio_decoder.mp3", "audio_decoder.mp1", "audio_decoder.mp2" } },
+    { "OMX.sprd.mp3l1.decoder", "sprd_mp3dec", { "audio_decoder.mp1" } },
+    { "OMX.sprd.mp3l2.decoder", "sprd_mp3dec", { "audio_decoder.mp2" } },
+    { "OMX.sprd.mp3.encoder", "sprd_mp3enc", { "audio_encoder.mp3" } },
+    { "OMX.sprd.h264.encoder", "sprd_h264enc", { "video_encoder.avc" } },
+    { "OMX.google.mjpg.decoder", "soft_mjpgdec", { "video_decoder.mjpg" } },
+    { "OMX.google.imaadpcm.decoder", "soft_imaadpcmdec", { "audio_decoder.imaadpcm" } },
 #ifndef PLATFORM_SHARKLE
-    { "OMX.sprd.mpeg4.encoder", "sprd_mpeg4enc", "video_encoder.mpeg4" },
-    { "OMX.sprd.h263.encoder", "sprd_mpeg4enc", "video_encoder.h263" },
+    { "OMX.sprd.mpeg4.encoder", "sprd_mpeg4enc", { "video_encoder.mpeg4" } },
+    { "OMX.sprd.h263.encoder", "sprd_mpeg4enc", { "video_encoder.h263" } },
 #if (defined PLATFORM_SHARKL3 || defined PLATFORM_SHARKL2 || defined PLATFORM_ISHARKL2 || defined PLATFORM_SHARKL5 || defined PLATFORM_ROC1 || defined PLATFORM_SHARKL5PRO)
-    { "OMX.sprd.vpx.decoder", "sprd_vpxdec", "video_decoder.vp8" },
+    { "OMX.sprd.vpx.decoder", "sprd_vpxdec", { "video_decoder.vp8" } },
 #endif
 #if (defined PLATFORM_SHARKL3 || defined PLATFORM_SHARKL5 || defined PLATFORM_ROC1 || defined PLATFORM_SHARKL5PRO)
-    { "OMX.sprd.hevc.decoder", "sprd_h265dec", "video_decoder.hevc" },
-    { "OMX.sprd.vp9.decoder", "sprd_vp9dec", "video_decoder.vp9" },
-    { "OMX.sprd.h265.encoder", "sprd_h265enc", "video_encoder.hevc" },
-    { "OMX.sprd.av1.decoder", "sprd_av1dec", "video_decoder.av1" },
+    { "OMX.sprd.hevc.decoder", "sprd_h265dec", { "video_decoder.hevc" } },
+    { "OMX.sprd.vp9.decoder", "sprd_vp9dec", { "video_decoder.vp9" } },
+    { "OMX.sprd.h265.encoder", "sprd_h265enc", { "video_encoder.hevc" } },
+    { "OMX.sprd.av1.decoder", "sprd_av1dec", { "video_decoder.av1" } },
 #endif
 
 #endif
@@ -87,6 +102,356 @@ static const struct {
 static const size_t kNumComponents =
     sizeof(kComponents) / sizeof(kComponents[0]);
 
+// Name and role lookups into kComponents, built once on first use.
+static pthread_once_t g_RegistryOnce = PTHREAD_ONCE_INIT;
+static KeyedVector<String8, size_t> g_ComponentsByName;
+static KeyedVector<String8, Vector<size_t> > g_ComponentsByRole;
+
+static void addComponentRole(const char *roleName, size_t component) {
+    String8 role(roleName);
+    ssize_t index = g_ComponentsByRole.indexOfKey(role);
+    if (index < 0) {
+        index = g_ComponentsByRole.add(role, Vector<size_t>());
+    }
+    g_ComponentsByRole.editValueAt(index).push_back(component);
+}
+
+static void buildRegistry() {
+    for (size_t i = 0; i < kNumComponents; ++i) {
+        g_ComponentsByName.add(String8(kComponents[i].mName), i);
+        addComponentRole(kComponents[i].mRoles[0], i);
+    }
+
+    for (size_t i = 0; i < kNumComponents; ++i) {
+        for (size_t j = 1; j < SPRD_OMX_MAX_COMPONENT_ROLES; ++j) {
+            if (kComponents[i].mRoles[j] == NULL) {
+                break;
+            }
+            addComponentRole(kComponents[i].mRoles[j], i);
+        }
+    }
+}
+
+static ssize_t findComponentIndex(const char *name) {
+    pthread_once(&g_RegistryOnce, buildRegistry);
+    ssize_t index = g_ComponentsByName.indexOfKey(String8(name));
+    return index < 0 ? -1 : (ssize_t)g_ComponentsByName.valueAt(index);
+}
+
+static const Vector<size_t> *findComponentsOfRole(const char *role) {
+    pthread_once(&g_RegistryOnce, buildRegistry);
+    ssize_t index = g_ComponentsByRole.indexOfKey(String8(role));
+    return index < 0 ? NULL : &g_ComponentsByRole.valueAt(index);
+}
+
+
+/*------------------------------------------------------------------------------*/
+
+// Unreferenced component libraries kept loaded when
+// vendor.omx.core.lib_cache_idle is not set.
+static const int kDefaultMaxIdleLibraries = 4;
+
+static const char *kCreateSprdOMXComponentSymbol =
+    "_Z22createSprdOMXComponentPKcPK16OMX_CALLBACKTYPE"
+    "PvPP17OMX_COMPONENTTYPE";
+
+static OMX_ERRORTYPE PrewarmEventHandler(
+        OMX_HANDLETYPE, OMX_PTR, OMX_EVENTTYPE event,
+        OMX_U32, OMX_U32, OMX_PTR) {
+    ALOGW("pre-warmed component raised event %d before being claimed", event);
+    return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE PrewarmBufferDone(
+        OMX_HANDLETYPE, OMX_PTR, OMX_BUFFERHEADERTYPE *) {
+    ALOGW("pre-warmed component returned a buffer before being claimed");
+    return OMX_ErrorNone;
+}
+
+static OMX_CALLBACKTYPE kPrewarmCallbacks = {
+    PrewarmEventHandler, PrewarmBufferDone, PrewarmBufferDone
+};
+
+// Called with g_OMXCoreLock held.
+static ssize_t findLibraryLocked(const char *suffix) {
+    for (size_t i = 0; i < g_OMX_Core->m_Libraries.size(); ++i) {
+        if (!strcmp(g_OMX_Core->m_Libraries[i].m_Suffix.c_str(), suffix)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Called with g_OMXCoreLock held. Removes least recently used idle libraries
+// beyond the configured limit and returns their handles; the caller
+// dlcloses them once the lock is dropped.
+static void evictIdleLibrariesLocked(Vector<void *> *toClose) {
+    if (g_OMX_Core->m_MaxIdleLibraries < 0) {
+        return;
+    }
+
+    for (;;) {
+        int idle = 0;
+        ssize_t lru = -1;
+        for (size_t i = 0; i < g_OMX_Core->m_Libraries.size(); ++i) {
+            const OMXLibraryEntry &entry = g_OMX_Core->m_Libraries[i];
+            if (entry.m_RefCount > 0) {
+                continue;
+            }
+            ++idle;
+            if (lru < 0 || entry.m_LastUsed < g_OMX_Core->m_Libraries[lru].m_LastUsed) {
+                lru = i;
+            }
+        }
+
+        if (idle <= g_OMX_Core->m_MaxIdleLibraries) {
+            return;
+        }
+
+        ALOGV("evicting %s", g_OMX_Core->m_Libraries[lru].m_Suffix.c_str());
+        toClose->push_back(g_OMX_Core->m_Libraries[lru].m_LibHandle);
+        g_OMX_Core->m_Libraries.removeAt(lru);
+    }
+}
+
+// Returns a referenced, resident library for |suffix|. Only the cache lookup
+// runs under g_OMXCoreLock; dlopen and symbol resolution of a library that is
+// not resident yet happen outside of it.
+static OMX_ERRORTYPE acquireLibrary(
+        const char *suffix, void **libHandle, CreateSprdOMXComponentFunc *create) {
+    {
+        SPRD_OMX_CORE_LOCK();
+        if (!g_bInitialized) {
+            SPRD_OMX_CORE_UNLOCK();
+            return OMX_ErrorNotReady;
+        }
+        ssize_t index = findLibraryLocked(suffix);
+        if (index >= 0) {
+            OMXLibraryEntry &entry = g_OMX_Core->m_Libraries.editItemAt(index);
+            entry.m_RefCount++;
+            entry.m_LastUsed = ++g_OMX_Core->m_LibraryUseSerial;
+            *libHandle = entry.m_LibHandle;
+            *create = entry.m_Create;
+            SPRD_OMX_CORE_UNLOCK();
+            return OMX_ErrorNone;
+        }
+        SPRD_OMX_CORE_UNLOCK();
+    }
+
+    AString libName = "libstagefright_";
+    libName.append(suffix);
+    libName.append(".so");
+
+    void *handle = dlopen(libName.c_str(), RTLD_NOW);
+
+    if (handle == NULL) {
+        ALOGE("unable to dlopen %s: %s", libName.c_str(), dlerror());
+        return OMX_ErrorComponentNotFound;
+    }
+
+    CreateSprdOMXComponentFunc createSprdOMXComponent =
+        (CreateSprdOMXComponentFunc)dlsym(handle, kCreateSprdOMXComponentSymbol);
+
+    if (createSprdOMXComponent == NULL) {
+        SPRD_OMX_LOG("createSoftOMXComponent == NULL");
+        dlclose(handle);
+        return OMX_ErrorComponentNotFound;
+    }
+
+    void *duplicate = NULL;
+    {
+        SPRD_OMX_CORE_LOCK();
+        if (!g_bInitialized) {
+            SPRD_OMX_CORE_UNLOCK();
+            dlclose(handle);
+            return OMX_ErrorNotReady;
+        }
+        // Another thread may have loaded the same library meanwhile.
+        ssize_t index = findLibraryLocked(suffix);
+        if (index >= 0) {
+            OMXLibraryEntry &entry = g_OMX_Core->m_Libraries.editItemAt(index);
+            duplicate = handle;
+            handle = entry.m_LibHandle;
+            createSprdOMXComponent = entry.m_Create;
+            entry.m_RefCount++;
+            entry.m_LastUsed = ++g_OMX_Core->m_LibraryUseSerial;
+        } else {
+            OMXLibraryEntry entry;
+            entry.m_Suffix = suffix;
+            entry.m_LibHandle = handle;
+            entry.m_Create = createSprdOMXComponent;
+            entry.m_RefCount = 1;
+            entry.m_LastUsed = ++g_OMX_Core->m_LibraryUseSerial;
+            g_OMX_Core->m_Libraries.push_back(entry);
+        }
+        SPRD_OMX_CORE_UNLOCK();
+    }
+
+    if (duplicate != NULL) {
+        dlclose(duplicate);
+    }
+
+    *libHandle = handle;
+    *create = createSprdOMXComponent;
+    return OMX_ErrorNone;
+}
+
+// Called with g_OMXCoreLock held. Drops a reference to the library with
+// |libHandle| in |libraries|; false if it is not there.
+static bool unrefLibraryLocked(Vector<OMXLibraryEntry> *libraries, void *libHandle,
+        bool *unused) {
+    for (size_t i = 0; i < libraries->size(); ++i) {
+        OMXLibraryEntry &entry = libraries->editItemAt(i);
+        if (entry.m_LibHandle != libHandle) {
+            continue;
+        }
+        CHECK_GT(entry.m_RefCount, 0);
+        *unused = --entry.m_RefCount == 0;
+        return true;
+    }
+    return false;
+}
+
+static OMX_ERRORTYPE releaseLibrary(void *libHandle) {
+    Vector<void *> toClose;
+    {
+        SPRD_OMX_CORE_LOCK();
+        bool unused = false;
+        if (g_bInitialized
+                && unrefLibraryLocked(&g_OMX_Core->m_Libraries, libHandle, &unused)) {
+            if (unused) {
+                evictIdleLibrariesLocked(&toClose);
+            }
+        } else if (unrefLibraryLocked(&g_DetachedLibraries, libHandle, &unused)) {
+            // The core was torn down while the component was alive.
+            if (unused) {
+                for (size_t i = 0; i < g_DetachedLibraries.size(); ++i) {
+                    if (g_DetachedLibraries[i].m_LibHandle == libHandle) {
+                        g_DetachedLibraries.removeAt(i);
+                        break;
+                    }
+                }
+                toClose.push_back(libHandle);
+            }
+        } else {
+            ALOGE("releasing unknown library handle %p", libHandle);
+        }
+        SPRD_OMX_CORE_UNLOCK();
+    }
+
+    for (size_t i = 0; i < toClose.size(); ++i) {
+        dlclose(toClose[i]);
+    }
+    return OMX_ErrorNone;
+}
+
+// Builds one instance of every configured pre-warm component that does not
+// have an idle instance in the pool yet.
+static void *prewarmThread(void *) {
+    for (;;) {
+        const char *name = NULL;
+        pthread_mutex_lock(&g_OMXCoreLock);
+        if (!g_OMX_Core->m_PrewarmStopping) {
+            for (size_t i = 0; i < g_OMX_Core->m_PrewarmNames.size() && name == NULL; ++i) {
+                name = g_OMX_Core->m_PrewarmNames[i];
+                for (size_t j = 0; j < g_OMX_Core->m_Prewarmed.size(); ++j) {
+                    if (g_OMX_Core->m_Prewarmed[j].m_Name == name) {
+                        name = NULL;
+                        break;
+                    }
+                }
+            }
+        }
+        if (name == NULL) {
+            g_OMX_Core->m_PrewarmThreadRunning = false;
+            pthread_mutex_unlock(&g_OMXCoreLock);
+            return NULL;
+        }
+        pthread_mutex_unlock(&g_OMXCoreLock);
+
+        ssize_t index = findComponentIndex(name);
+        void *libHandle = NULL;
+        CreateSprdOMXComponentFunc create = NULL;
+        sp<SprdOMXComponent> codec;
+        OMX_COMPONENTTYPE *handle = NULL;
+
+        if (acquireLibrary(kComponents[index].mLibNameSuffix, &libHandle, &create) == OMX_ErrorNone) {
+            codec = (*create)(name, &kPrewarmCallbacks, NULL, &handle);
+            if (codec != NULL && codec->initCheck() != OMX_ErrorNone) {
+                codec->prepareForDestruction();
+                codec.clear();
+            }
+            if (codec == NULL) {
+                releaseLibrary(libHandle);
+            } else {
+                codec->setLibHandle(libHandle);
+            }
+        }
+
+        pthread_mutex_lock(&g_OMXCoreLock);
+        if (codec == NULL) {
+            ALOGW("unable to pre-warm %s, dropping it from the pool", name);
+            for (size_t i = 0; i < g_OMX_Core->m_PrewarmNames.size(); ++i) {
+                if (g_OMX_Core->m_PrewarmNames[i] == name) {
+                    g_OMX_Core->m_PrewarmNames.removeAt(i);
+                    break;
+                }
+            }
+        } else if (!g_OMX_Core->m_PrewarmStopping) {
+            OMXPrewarmedEntry entry;
+            entry.m_Name = name;
+            entry.m_Codec = codec;
+            g_OMX_Core->m_Prewarmed.push_back(entry);
+            codec.clear();
+            ALOGI("Pre-warmed OMXPlugin : %s", name);
+        }
+        pthread_mutex_unlock(&g_OMXCoreLock);
+
+        if (codec != NULL) {
+            codec->prepareForDestruction();
+            codec.clear();
+            releaseLibrary(libHandle);
+        }
+    }
+}
+
+// Called with g_OMXCoreLock held.
+static void schedulePrewarmLocked() {
+    if (g_OMX_Core->m_PrewarmNames.isEmpty()
+            || g_OMX_Core->m_PrewarmThreadRunning
+            || g_OMX_Core->m_PrewarmStopping) {
+        return;
+    }
+
+    if (g_OMX_Core->m_PrewarmThreadJoinable) {
+        // The previous run has already left its loop.
+        pthread_join(g_OMX_Core->m_PrewarmThread, NULL);
+        g_OMX_Core->m_PrewarmThreadJoinable = false;
+    }
+
+    if (pthread_create(&g_OMX_Core->m_PrewarmThread, NULL, prewarmThread, NULL) == 0) {
+        g_OMX_Core->m_PrewarmThreadRunning = true;
+        g_OMX_Core->m_PrewarmThreadJoinable = true;
+    } else {
+        ALOGE("unable to start the pre-warm thread");
+    }
+}
+
+// vendor.omx.core.prewarm holds a comma separated list of roles, e.g.
+// "video_decoder.avc,video_encoder.avc".
+static void parsePrewarmRoles(OMXCore *core) {
+    char value[PROPERTY_VALUE_MAX];
+    property_get("vendor.omx.core.prewarm", value, "");
+
+    char *saveptr = NULL;
+    for (char *role = strtok_r(value, ",", &saveptr); role != NULL;
+            role = strtok_r(NULL, ",", &saveptr)) {
+        const Vector<size_t> *components = findComponentsOfRole(role);
+        if (components != NULL) {
+            core->m_PrewarmNames.push_back(kComponents[components->itemAt(0)].mName);
+        }
+    }
+}
 
 /*------------------------------------------------------------------------------*/
 
@@ -101,9 +466,16 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_Init(void)
     if (!g_bInitialized)
     {
         g_OMX_Core = new OMXCore();
+        g_OMX_Core->m_MaxIdleLibraries = property_get_int32(
+                "vendor.omx.core.lib_cache_idle", kDefaultMaxIdleLibraries);
+        g_OMX_Core->m_Libraries = g_DetachedLibraries;
+        g_DetachedLibraries.clear();
+        parsePrewarmRoles(g_OMX_Core);
         g_bInitialized = true;
     }
     g_OMX_Core->m_OMXCoreRefCount++;
+    g_OMX_Core->m_PrewarmStopping = false;
+    schedulePrewarmLocked();
 
     SPRD_OMX_CORE_UNLOCK();
     SPRD_OMX_LOG("-");
@@ -114,23 +486,73 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_Init(void)
 
 OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_Deinit(void)
 {
-    SPRD_OMX_CORE_LOCK();
+    // Torn down once the lock is dropped: idle pre-warmed components
+    // first, then the libraries nothing refers to any more.
+    Vector<sp<SprdOMXComponent> > toDestroy;
+    Vector<void *> toClose;
 
-    SPRD_OMX_LOG_D("g_bInitialized", g_bInitialized);
-    if (g_bInitialized)
     {
-        --g_OMX_Core->m_OMXCoreRefCount;
-        SPRD_OMX_LOG_D("g_OMXCoreRefCount", g_OMX_Core->m_OMXCoreRefCount);
+        SPRD_OMX_CORE_LOCK();
 
-        if(0 == g_OMX_Core->m_OMXCoreRefCount)
+        SPRD_OMX_LOG_D("g_bInitialized", g_bInitialized);
+        if (g_bInitialized)
         {
-            delete g_OMX_Core;
-            g_bInitialized = false;
+            --g_OMX_Core->m_OMXCoreRefCount;
+            SPRD_OMX_LOG_D("g_OMXCoreRefCount", g_OMX_Core->m_OMXCoreRefCount);
+
+            if(0 == g_OMX_Core->m_OMXCoreRefCount)
+            {
+                // Let a running pre-warm pass finish before tearing down.
+                g_OMX_Core->m_PrewarmStopping = true;
+                if (g_OMX_Core->m_PrewarmThreadJoinable) {
+                    pthread_t thread = g_OMX_Core->m_PrewarmThread;
+                    g_OMX_Core->m_PrewarmThreadJoinable = false;
+                    pthread_mutex_unlock(&g_OMXCoreLock);
+                    pthread_join(thread, NULL);
+                    pthread_mutex_lock(&g_OMXCoreLock);
+                }
+            }
+
+            if(0 == g_OMX_Core->m_OMXCoreRefCount)
+            {
+                for (size_t i = 0; i < g_OMX_Core->m_Prewarmed.size(); ++i) {
+                    sp<SprdOMXComponent> codec = g_OMX_Core->m_Prewarmed[i].m_Codec;
+                    bool unused;
+                    unrefLibraryLocked(&g_OMX_Core->m_Libraries, codec->libHandle(), &unused);
+                    toDestroy.push_back(codec);
+                }
+                g_OMX_Core->m_Prewarmed.clear();
+
+                for (size_t i = 0; i < g_OMX_Core->m_Libraries.size(); ++i) {
+                    const OMXLibraryEntry &entry = g_OMX_Core->m_Libraries[i];
+                    if (entry.m_RefCount > 0) {
+                        // Still backing live handles; kept until the last
+                        // of them is freed.
+                        ALOGW("%s still referenced at deinit", entry.m_Suffix.c_str());
+                        g_DetachedLibraries.push_back(entry);
+                    } else {
+                        toClose.push_back(entry.m_LibHandle);
+                    }
+                }
+
+                delete g_OMX_Core;
+                g_OMX_Core = NULL;
+                g_bInitialized = false;
+            }
         }
+
+        SPRD_OMX_LOG_D("g_bInitialized", g_bInitialized);
+        SPRD_OMX_CORE_UNLOCK();
     }
 
-    SPRD_OMX_LOG_D("g_bInitialized", g_bInitialized);
-    SPRD_OMX_CORE_UNLOCK();
+    for (size_t i = 0; i < toDestroy.size(); ++i) {
+        toDestroy[i]->prepareForDestruction();
+    }
+    toDestroy.clear();
+
+    for (size_t i = 0; i < toClose.size(); ++i) {
+        dlclose(toClose[i]);
+    }
     return OMX_ErrorNone;
 }
 
@@ -140,85 +562,78 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_GetHandle(
     OMX_IN  OMX_PTR pAppData,
     OMX_IN  OMX_CALLBACKTYPE* pCallBacks) {
     SPRD_OMX_LOG("+");
-    SPRD_OMX_CORE_LOCK();
     SPRD_OMX_LOG_S("makeComponentInstance", cComponentName);
 
-    for (size_t i = 0; i < kNumComponents; ++i) {
-        if (strcmp(cComponentName, kComponents[i].mName)) {
-            continue;
-        }
-
-        AString libName = "libstagefright_";
-        libName.append(kComponents[i].mLibNameSuffix);
-        libName.append(".so");
-
-        void *libHandle = dlopen(libName.c_str(), RTLD_NOW);
+    ssize_t i = findComponentIndex(cComponentName);
+    if (i < 0) {
+        return OMX_ErrorInvalidComponentName;
+    }
 
-        if (libHandle == NULL) {
-            ALOGE("unable to dlopen %s: %s", libName.c_str(), dlerror());
-            SPRD_OMX_CORE_UNLOCK();
-            return OMX_ErrorComponentNotFound;
+    sp<SprdOMXComponent> codec;
+    {
+        SPRD_OMX_CORE_LOCK();
+        if (g_bInitialized) {
+            for (size_t j = 0; j < g_OMX_Core->m_Prewarmed.size(); ++j) {
+                if (g_OMX_Core->m_Prewarmed[j].m_Name == kComponents[i].mName) {
+                    codec = g_OMX_Core->m_Prewarmed[j].m_Codec;
+                    g_OMX_Core->m_Prewarmed.removeAt(j);
+                    schedulePrewarmLocked();
+                    break;
+                }
+            }
         }
+        SPRD_OMX_CORE_UNLOCK();
+    }
 
-        typedef SprdOMXComponent *(*CreateSprdOMXComponentFunc)(
-                const char *, const OMX_CALLBACKTYPE *,
-                OMX_PTR, OMX_COMPONENTTYPE **);
-
-        CreateSprdOMXComponentFunc createSprdOMXComponent =
-            (CreateSprdOMXComponentFunc)dlsym(
-                    libHandle,
-                    "_Z22createSprdOMXComponentPKcPK16OMX_CALLBACKTYPE"
-                    "PvPP17OMX_COMPONENTTYPE");
+    if (codec != NULL) {
+        codec->rebindClient(pCallBacks, pAppData,
+                reinterpret_cast<OMX_COMPONENTTYPE **>(pHandle));
+        codec->incStrong(g_OMX_Core);
+        ALOGI("Created OMXPlugin : %s (pre-warmed)", kComponents[i].mName);
+        SPRD_OMX_LOG("-");
+        return OMX_ErrorNone;
+    }
 
-        if (createSprdOMXComponent == NULL) {
-            dlclose(libHandle);
-            libHandle = NULL;
-            SPRD_OMX_LOG("createSoftOMXComponent == NULL");
-            SPRD_OMX_LOG("-");
-            SPRD_OMX_CORE_UNLOCK();
-            return OMX_ErrorComponentNotFound;
-        }
+    void *libHandle = NULL;
+    CreateSprdOMXComponentFunc createSprdOMXComponent = NULL;
+    OMX_ERRORTYPE err = acquireLibrary(
+            kComponents[i].mLibNameSuffix, &libHandle, &createSprdOMXComponent);
+    if (err != OMX_ErrorNone) {
+        SPRD_OMX_LOG("-");
+        return err;
+    }
 
-        sp<SprdOMXComponent> codec =
-            (*createSprdOMXComponent)(cComponentName, pCallBacks, pAppData, reinterpret_cast<OMX_COMPONENTTYPE **>(pHandle));
+    codec = (*createSprdOMXComponent)(cComponentName, pCallBacks, pAppData,
+            reinterpret_cast<OMX_COMPONENTTYPE **>(pHandle));
 
-        if (codec == NULL) {
-            dlclose(libHandle);
-            libHandle = NULL;
-            SPRD_OMX_LOG("createSoftOMXComponent == NULL");
-            SPRD_OMX_LOG("-");
-            SPRD_OMX_CORE_UNLOCK();
-            return OMX_ErrorInsufficientResources;
-        }
+    if (codec == NULL) {
+        releaseLibrary(libHandle);
+        SPRD_OMX_LOG("createSoftOMXComponent == NULL");
+        SPRD_OMX_LOG("-");
+        return OMX_ErrorInsufficientResources;
+    }
 
-        OMX_ERRORTYPE err = codec->initCheck();
-        if (err != OMX_ErrorNone) {
-            SPRD_OMX_LOG("codec->initCheck() returned an error");
-            dlclose(libHandle);
-            libHandle = NULL;
+    err = codec->initCheck();
+    if (err != OMX_ErrorNone) {
+        SPRD_OMX_LOG("codec->initCheck() returned an error");
+        codec.clear();
+        releaseLibrary(libHandle);
 
-            SPRD_OMX_LOG("-");
-            SPRD_OMX_CORE_UNLOCK();
-            return err;
-        }
-        SPRD_OMX_LOG("realloc");
-
-        codec->incStrong(g_OMX_Core);
-        codec->setLibHandle(libHandle);
-        ALOGI("Created OMXPlugin : %s", kComponents[i].mName);
         SPRD_OMX_LOG("-");
-        SPRD_OMX_CORE_UNLOCK();
-        return OMX_ErrorNone;
+        return err;
     }
-    SPRD_OMX_CORE_UNLOCK();
-    return OMX_ErrorInvalidComponentName;
+
+    codec->incStrong(g_OMX_Core);
+    codec->setLibHandle(libHandle);
+    ALOGI("Created OMXPlugin : %s", kComponents[i].mName);
+    SPRD_OMX_LOG("-");
+    return OMX_ErrorNone;
 }
 
 OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_FreeHandle(
     OMX_IN  OMX_HANDLETYPE hComponent)
  {
     SPRD_OMX_LOG("+");
-    SPRD_OMX_CORE_LOCK();
     SprdOMXComponent* omx_component =
        (SprdOMXComponent*)(((OMX_COMPONENTTYPE *)hComponent)->pComponentPrivate);
 
@@ -229,10 +644,9 @@ OMX_API OMX_ERRORTYPE OMX_APIENTRY OMX_FreeHandle(
     omx_component->decStrong(g_OMX_Core);
     omx_component = NULL;
 
-    dlclose(libHandle);
+    releaseLibrary(libHandle);
 
     SPRD_OMX_LOG("-");
-    SPRD_OMX_CORE_UNLOCK();
     return OMX_ErrorNone;
 }
 
@@ -257,20 +671,30 @@ OMX_API OMX_ERRORTYPE OMX_GetRolesOfComponent(
     if (!pNumRoles) {
         return OMX_ErrorBadParameter;
     }
-    else {
-        for (size_t i = 0; i < kNumComponents; ++i) {
-            if (strcmp(compName, kComponents[i].mName)) {
-                continue;
-            }
 
-            if (roles) strcpy((char*)roles[0],kComponents[i].mRole);
-            (*pNumRoles) = 1;
+    ssize_t i = findComponentIndex(compName);
+    if (i < 0) {
+        SPRD_OMX_LOG("-");
+        return OMX_ErrorInvalidComponentName;
+    }
+
+    OMX_U32 numRoles = 0;
+    while (numRoles < SPRD_OMX_MAX_COMPONENT_ROLES && kComponents[i].mRoles[numRoles]) {
+        ++numRoles;
+    }
+
+    if (roles) {
+        if (*pNumRoles < numRoles) {
             SPRD_OMX_LOG("-");
-            return OMX_ErrorNone;
+            return OMX_ErrorBadParameter;
+        }
+        for (OMX_U32 j = 0; j < numRoles; ++j) {
+            strcpy((char*)roles[j], kComponents[i].mRoles[j]);
         }
     }
+    (*pNumRoles) = numRoles;
     SPRD_OMX_LOG("-");
-    return OMX_ErrorInvalidComponentName;
+    return OMX_ErrorNone;
 }
 
 OMX_API OMX_ERRORTYPE OMX_GetComponentsOfRole(
@@ -280,7 +704,6 @@ OMX_API OMX_ERRORTYPE OMX_GetComponentsOfRole(
 {
     SPRD_OMX_LOG("+");
     OMX_ERRORTYPE omx_res = OMX_ErrorNone;
-    size_t component_index = 0, role_index = 0;
 
     // errors checking
     if (!role)
@@ -296,28 +719,22 @@ OMX_API OMX_ERRORTYPE OMX_GetComponentsOfRole(
     // getting components os requested role
     if ((OMX_ErrorNone == omx_res) && g_bInitialized)
     {
-        // searching for the component in the registry
-        if (OMX_ErrorNone == omx_res)
-        {
-            OMX_U32 num_comps = *pNumComps;
+        const Vector<size_t> *components = findComponentsOfRole(role);
+        OMX_U32 num_comps = *pNumComps;
 
-            *pNumComps = 0;
-            for (component_index = 0; component_index < kNumComponents; ++component_index)
+        *pNumComps = 0;
+        for (size_t j = 0; components != NULL && j < components->size(); ++j)
+        {
+            if (compNames)
             {
-                if (!strcmp(role, kComponents[component_index].mRole))
+                if (num_comps <= *pNumComps)
                 {
-                    if (compNames)
-                    {
-                        if (num_comps <= *pNumComps)
-                            omx_res = OMX_ErrorBadParameter;
-                        else
-                            strcpy((char*)compNames[*pNumComps], kComponents[component_index].mName);
-                    }
-                    ++(*pNumComps);
+                    omx_res = OMX_ErrorBadParameter;
                     break;
                 }
-                if (OMX_ErrorNone != omx_res) break;
+                strcpy((char*)compNames[*pNumComps], kComponents[components->itemAt(j)].mName);
             }
+            ++(*pNumComps);
         }
     }
 
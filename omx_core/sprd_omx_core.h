@@ -18,14 +18,61 @@
 
 #define SPRD_OMX_CORE_H_
 
+#include <pthread.h>
+#include <stdint.h>
+
+#include <media/stagefright/foundation/AString.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+#include "SprdOMXComponent.h"
+
+typedef android::SprdOMXComponent *(*CreateSprdOMXComponentFunc)(
+        const char *, const OMX_CALLBACKTYPE *,
+        OMX_PTR, OMX_COMPONENTTYPE **);
+
+// A component library kept resident between OMX_GetHandle calls.
+// m_RefCount counts the live and pre-warmed components created from it;
+// libraries at zero stay loaded until evicted in least-recently-used order.
+struct OMXLibraryEntry {
+    android::AString m_Suffix;
+    void *m_LibHandle;
+    CreateSprdOMXComponentFunc m_Create;
+    int m_RefCount;
+    uint64_t m_LastUsed;
+};
+
+// An idle component constructed ahead of time, waiting for OMX_GetHandle.
+struct OMXPrewarmedEntry {
+    const char *m_Name;
+    android::sp<android::SprdOMXComponent> m_Codec;
+};
 
 struct OMXCore {
     int m_OMXCoreRefCount;
+
+    android::Vector<OMXLibraryEntry> m_Libraries;
+    uint64_t m_LibraryUseSerial;
+    // Number of unreferenced libraries kept loaded, -1 for no limit.
+    int m_MaxIdleLibraries;
+
+    android::Vector<const char *> m_PrewarmNames;
+    android::Vector<OMXPrewarmedEntry> m_Prewarmed;
+    pthread_t m_PrewarmThread;
+    bool m_PrewarmThreadRunning;
+    bool m_PrewarmThreadJoinable;
+    bool m_PrewarmStopping;
+
     OMXCore()
     {
         m_OMXCoreRefCount = 0;
+        m_LibraryUseSerial = 0;
+        m_MaxIdleLibraries = 0;
+        m_PrewarmThreadRunning = false;
+        m_PrewarmThreadJoinable = false;
+        m_PrewarmStopping = false;
     }
     ~OMXCore() {}
 };
 
-#endif  // SPRD_OMX_CORE_H_
\ No newline at end of file
+#endif  // SPRD_OMX_CORE_H_